@@ -0,0 +1,123 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "outputs.h"
+#include "relay_task.h"
+
+// --------------------------------------------------
+// Shared firmware state and entry points (src/main.cpp)
+// --------------------------------------------------
+
+struct WiFiSettings
+{
+    String ssid;
+    String password;
+    IPAddress gatewayIP;
+    IPAddress staticIP;      // 0.0.0.0 = DHCP
+    IPAddress subnet;
+};
+
+struct MqttSettings
+{
+    bool    enabled;
+    String  broker;
+    uint16_t port;
+    String  user;
+    String  password;
+    String  topicCmd;
+    String  topicState;
+};
+
+struct RelaySettings
+{
+    uint16_t deadTimeMs;     // break-before-make gap
+    String   outputMap;      // outputs.h spec; applied at boot
+    uint16_t windowMs;       // command coalescing window, 0 = none (relay_task.h)
+    uint8_t  priority[RELAY_SOURCES];   // per source, 0..RELAY_PRIORITY_MAX
+};
+
+struct BandSettings
+{
+    IPAddress radioIP;       // FlexRadio to follow, 0.0.0.0 = none
+    uint8_t   slice;
+    uint32_t  hysteresisHz;
+};
+
+struct TxSettings
+{
+    int8_t pttPin;           // -1 = no interlock
+    bool   pttActiveLow;
+    int8_t ampKeyPin;        // -1 = none
+};
+
+struct SwrSettings
+{
+    int8_t   fwdPin;         // ADC1 pin, -1 = no SWR monitor
+    int8_t   reflPin;
+    uint16_t tripSwr;        // x100, 0 = never trip
+    uint16_t fullScaleW;     // forward power at ADC full scale
+};
+
+struct UdpSettings
+{
+    uint16_t  port;          // 0 = off
+    String    key;           // MAC key, "" = none
+    IPAddress beaconGroup;   // multicast, 224.0.0.0/4
+    uint16_t  beaconPort;    // 0 = no state beacons
+    uint16_t  beaconHeartbeatS;
+};
+
+// Startup milestones, us after setup() began; 0 = not reached yet
+struct BootTimes
+{
+    uint32_t relaysUs;       // last selection back on the outputs
+    uint32_t servicesUs;     // setup() done: HTTP, UDP, schedule listening
+    uint32_t wifiUs;         // first time online
+    uint32_t mqttUs;         // first broker session
+};
+
+extern WiFiSettings wifiCfg;
+extern MqttSettings mqttCfg;
+extern RelaySettings relayCfg;
+extern BandSettings bandCfg;
+extern TxSettings txCfg;
+extern UdpSettings udpCfg;
+extern SwrSettings swrCfg;
+extern int currentAntenna;   // 0 = off, n = antenna, -1 = several; loop()'s view of the relay snapshot
+extern uint32_t currentOutputs;
+extern uint32_t relayStateVersion;
+extern BootTimes bootTimes;
+
+void applyRelayState();
+// False if refused: relay queue full, locked or outranked (relay_task.h)
+bool setAntenna(int ant, RelaySource source, RelayPostResult* result = nullptr);
+bool setOutputs(uint32_t outputs, RelaySource source, RelayPostResult* result = nullptr);
+// {"antenna":N,"outputs":M,"count":C}
+void relayStateJson(const RelaySnapshot& s, char* buf, size_t size);
+void serviceRelayState();
+void restartDevice();
+
+struct MqttCommand;
+
+void mqttCallback(char* topic, byte* payload, unsigned int length);
+void handleMqttCommand(const MqttCommand& cmd);
+void handleMqttSchedule(const uint8_t* payload, unsigned int length);
+void handleMqttFrequency(const uint8_t* payload, unsigned int length);
+void reconnectMqtt();
+
+void handleRoot();
+void handleSet();
+void handleState();
+void handleStats();
+void handleMetrics();
+void handleEvents();
+void handleScheduleGet();
+void handleSchedulePost();
+void handleBandPlanGet();
+void handleBandPlanPost();
+void handleSettingsGet();
+void handleSettingsPost();
+void handleUpdatePage();
+void handleUpdateUpload();
+void handleUpdateResult();
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "text_buffer.h"
+
+// --------------------------------------------------
+// Band decoder
+//
+// Follows the radio's frequency and selects the antenna for its band, so
+// a band change switches here without a round trip through an automation
+// host. The band plan is a table of frequency ranges, each with an
+// output selection, sorted by its lower edge; a frequency is found by
+// binary search. Hysteresis widens the band in use on both sides, so a
+// VFO parked on a shared edge or jittering across it does not toggle the
+// relays. Outside every band the selection stays where it is.
+//
+// The decoder posts only when the band changes; a manual selection made
+// while the radio stays in one band is left alone. A band change the
+// arbiter refuses (manual lock, outranked) counts as handled and is not
+// retried until the next band change. Frequencies come from
+// loop() (MQTT <cmd topic>/freq, the FlexRadio client); each carries its
+// arrival time and the relay task measures it as RELAY_SRC_BAND.
+//
+// Band plan text, one band per line or ';'-separated, '#' starts a
+// comment:
+//   <from>-<to> <selection>        e.g. 14.000-14.350 2   or  7000k-7300k 1+3
+// Edges are inclusive. A bare integer is Hz, a number with a decimal
+// point is MHz; k or M may follow either. selection is as for /set
+// ("off", "3", "1+3"). Bands may touch but not overlap. A loaded plan
+// replaces the previous one and is stored in NVS as one blob, 12 bytes
+// per band.
+// --------------------------------------------------
+
+const int      BAND_MAX             = 32;
+const size_t   BAND_TEXT_MAX        = 1024;     // one plan, as sent
+const uint32_t BAND_HYSTERESIS_HZ   = 2000;     // default
+
+struct Band
+{
+    uint32_t lowHz;          // inclusive
+    uint32_t highHz;         // inclusive
+    uint32_t outputs;        // selection mask, 0 = off
+};
+
+struct BandPlan
+{
+    uint8_t bands;
+    Band    band[BAND_MAX];  // sorted by lowHz, no overlaps
+};
+
+struct BandDecoderStats
+{
+    uint8_t  bands;
+    int8_t   band;           // index of the band the radio is in, -1 = none yet
+    uint32_t lastHz;         // 0 = no frequency yet
+    uint32_t hysteresisHz;
+    uint32_t updates;        // frequencies received
+    uint32_t changes;        // band changes posted to the relay task
+    uint32_t held;           // ... kept on the current band by the hysteresis
+    uint32_t unmapped;       // ... outside every band
+    uint32_t dropped;        // band changes refused by a full relay queue
+    uint32_t refused;        // ... refused by the arbiter (lock, priority)
+    uint32_t lookups;
+    uint8_t  maxProbes;      // deepest binary search so far
+    uint32_t blobBytes;      // NVS size of the plan
+};
+
+// false with a "line N: ..." message in error.
+bool bandPlanParse(const char* text, size_t len, BandPlan* out, char* error, size_t errorSize);
+// Canonical text (in k where whole kHz), a band per call; parses back to
+// the same plan. false past the last band.
+bool bandPlanFormat(const BandPlan& p, uint32_t line, TextBuffer& out);
+// Index of the band holding hz, or -1. probes: table entries looked at.
+int bandPlanFind(const BandPlan& p, uint32_t hz, int* probes);
+
+// "14074000", "14.074", "14074k", "14.074000M" -> Hz. False if malformed
+// or above 4.29 GHz.
+bool bandParseFrequency(const char* s, size_t n, uint32_t* hz);
+
+void bandDecoderBegin(uint32_t hysteresisHz);    // NVS plan; nothing posted until a frequency arrives
+void bandDecoderSetHysteresis(uint32_t hz);
+bool bandDecoderLoad(const BandPlan& p);         // replace, persist, re-decode; false if NVS refused it
+const BandPlan& bandDecoderPlan();
+void bandDecoderFrequency(uint32_t hz, uint64_t arrivedUs);   // loop() only
+BandDecoderStats bandDecoderStats();
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --------------------------------------------------
+// Settings record
+//
+// All of /settings (wifiCfg, mqttCfg, relayCfg, bandCfg, txCfg, udpCfg,
+// swrCfg) in one NVS blob, CONFIG_KEY, read with a single lookup at boot and
+// rewritten only when its bytes change. Little-endian:
+//   0  u8   'C'
+//   1  u8   version
+//   2  u16  payload length
+//   4  u32  CRC-32 of the payload
+//   8  payload: the fields in declaration order, strings as u8 length
+//      + bytes
+//
+// A new version only appends fields: an older record decodes with the
+// defaults for what it lacks, and one written by newer firmware (read
+// after an OTA rollback) keeps the fields this one knows. Firmware from
+// before the record kept one NVS key per setting; those are read once,
+// written as a record and left in place for a rollback to that firmware.
+// A record that fails its CRC falls back to them, or to the defaults.
+// --------------------------------------------------
+
+const char     CONFIG_KEY[]      = "config";
+const uint8_t  CONFIG_VERSION    = 5;        // 2: static IP and subnet; 3: SWR monitor; 4: arbiter; 5: beacons
+const size_t   CONFIG_STRING_MAX = 128;      // per text setting
+const size_t   CONFIG_HEADER     = 8;
+const size_t   CONFIG_FIXED      = 53;       // bytes of the numeric fields
+const size_t   CONFIG_STRINGS    = 9;
+const size_t   CONFIG_BLOB_MAX   = CONFIG_HEADER + CONFIG_FIXED + CONFIG_STRINGS * (1 + CONFIG_STRING_MAX);
+
+enum ConfigSource : uint8_t { CONFIG_DEFAULTS, CONFIG_LEGACY, CONFIG_RECORD };
+
+struct ConfigStats
+{
+    ConfigSource source;     // where this boot's settings came from
+    uint8_t  version;        // of the record read, 0 = none
+    bool     corrupt;        // a record was there but failed its checks
+    uint16_t bytes;          // record size in flash
+    uint32_t loadUs;         // configLoad(), NVS included
+    uint32_t saves;          // records written
+    uint32_t unchanged;      // saves skipped, flash already had the content
+    uint32_t bytesWritten;
+};
+
+// Fills the settings globals; once, first thing in setup().
+void configLoad();
+
+// Writes the settings globals if they differ from flash. False if the
+// NVS write failed; the settings stay in effect until a reboot.
+bool configSave();
+
+ConfigStats configStats();
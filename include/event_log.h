@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --------------------------------------------------
+// Event log
+//
+// What the switch did, for when it is up the tower and nobody is on
+// Serial: commands with their source, relay changes, WiFi and MQTT
+// coming and going, SWR trips, clock sync and boots, as fixed 16-byte
+// records. eventLog() copies one into a RAM ring under halCritical,
+// from any task, without allocating. Once EVENT_LOG_BATCH are waiting,
+// or the oldest has waited EVENT_LOG_FLUSH_MS, loop() wakes a
+// low-priority task that appends them to the log flash partition, so
+// the 18 ms sector erases never stall loop(); eventLogFlush() writes
+// the rest before a deliberate reboot. Flash keeps the newest
+// EVENT_LOG_FLASH_BYTES; entering a sector erases it, dropping the
+// oldest 256 records.
+//
+// GET /log?since=N streams the records after seq N, oldest first, as
+// they are stored (application/octet-stream, chunked), so a client that
+// keeps the last seq it saw pulls only what is new. Little-endian:
+//   0  u32 seq      +1 per record; a gap is records lost (RAM ring
+//                   overrun, power cut before a flush)
+//   4  u32 ms       since that boot
+//   8  u8  type     EventType
+//   9  u8  source   RelaySource for commands and relays, else 0
+//  10  u8  flags    per type
+//  11  u8  crc      CRC-8 (poly 0x07) of the other 15 bytes, in order
+//  12  u32 value    per type
+// /log serves nothing more than EVENT_LOG_RAM_RECORDS past the newest
+// seq in flash, and a boot continues from there, so no seq a client saw
+// before a power cut is handed out again.
+// tools/event_log.py fetches and decodes them.
+// --------------------------------------------------
+
+const size_t   EVENT_LOG_RECORD      = 16;
+const size_t   EVENT_LOG_RAM_RECORDS = 128;
+const size_t   EVENT_LOG_BATCH       = 32;       // records per flash write (512 bytes)
+const uint32_t EVENT_LOG_FLUSH_MS    = 10000;
+const size_t   EVENT_LOG_FLASH_BYTES = 65536;    // 16 sectors, 4096 records
+const int      EVENT_LOG_TASK_CORE     = 0;      // beside WiFi, away from loop() and the relay task
+const int      EVENT_LOG_TASK_PRIORITY = 1;
+
+enum EventType : uint8_t {
+    EVENT_BOOT = 1,          // value: halResetReason()
+    EVENT_COMMAND,           // flags: RelayAction | EVENT_REFUSED; value: outputs it resolved to
+    EVENT_RELAY,             // value: outputs now selected
+    EVENT_WIFI,              // flags: 1 up, 0 down; value: IP when up
+    EVENT_MQTT,              // flags: 1 up, 0 down; value: PubSubClient state() when down
+    EVENT_CLOCK,             // first SNTP sync this boot; value: UTC seconds at ms
+    EVENT_SWR,               // high-SWR trip; flags: antenna; value: SWR x100
+    EVENT_LOCK,              // manual lock; flags: 1 on, 0 off
+    EVENT_TYPES
+};
+
+const uint8_t EVENT_REFUSED = 0x80;      // EVENT_COMMAND: relay queue full, locked or outranked
+
+struct EventLogStats
+{
+    uint32_t nextSeq;
+    uint32_t firstSeq;       // oldest record /log can serve
+    uint32_t logged;         // since boot
+    uint32_t pending;        // in RAM, not yet in flash
+    uint32_t lost;           // overwritten in RAM before they reached flash
+    uint32_t flashRecords;
+    uint32_t flushes;        // flash writes
+    uint32_t flashBytes;     // ... their bytes
+    uint32_t erases;
+    uint32_t damaged;        // records in flash failing their CRC (torn writes)
+};
+
+// Finds the newest record in flash and logs EVENT_BOOT; first thing in
+// setup(), before anything else can log.
+void eventLogBegin();
+
+// Any task, not interrupts. When the RAM ring is full the oldest record
+// not yet in flash goes.
+void eventLog(EventType type, uint8_t source, uint8_t flags, uint32_t value);
+
+// loop(): wakes the writer task when a flush is due, logs EVENT_CLOCK.
+void eventLogService();
+
+// Writes everything in RAM to flash before returning; from loop(),
+// before a reboot.
+void eventLogFlush();
+
+// /log body, an HttpServer::ChunkFiller: whole records from seq *cursor
+// on, flash first, then RAM.
+size_t eventLogFill(char* buf, size_t size, uint32_t* cursor);
+
+EventLogStats eventLogStats();
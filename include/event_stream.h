@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "http_server.h"
+
+// --------------------------------------------------
+// Server-Sent Events fan-out (/events)
+//
+// Each dashboard keeps one connection open; a state change is formatted
+// once and written to every subscriber. Subscribers that stop accepting
+// data are dropped and their browser falls back to polling /state until
+// EventSource reconnects. Streams share the HTTP server's connection
+// slots; EVENT_MAX_CLIENTS leaves at least one for ordinary requests.
+// --------------------------------------------------
+
+const int EVENT_MAX_CLIENTS = HTTP_MAX_CONNECTIONS - 1;
+const unsigned long EVENT_HEARTBEAT_MS = 15000;
+
+bool eventStreamFull();
+// Turns the request being handled into a subscriber: sends the response
+// header and the initial state.
+bool eventStreamAdd(HttpServer& server, const char* initialData);
+void eventStreamBroadcast(const char* data);
+void eventStreamService();      // heartbeat + pruning, from loop()
+int eventStreamClients();
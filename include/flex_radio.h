@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+// --------------------------------------------------
+// FlexRadio status client
+//
+// Connects to a FlexRadio (SmartSDR TCP API, port 4992), subscribes to
+// slice status and feeds the RF frequency of one slice to the band
+// decoder. Status lines look like
+//   S<handle>|slice <n> ... RF_frequency=14.074000 ...
+// and are parsed in place from a fixed line buffer. Everything runs from
+// loop() without blocking: the connect is polled, and a lost or refused
+// connection is retried every FLEX_RETRY_MS while WiFi is online.
+// --------------------------------------------------
+
+const uint16_t FLEX_PORT              = 4992;
+const uint32_t FLEX_RETRY_MS          = 5000;
+const uint32_t FLEX_CONNECT_TIMEOUT_MS = 3000;
+const size_t   FLEX_LINE_MAX          = 512;       // longer status lines are skipped
+const int      FLEX_SLICES            = 8;
+
+struct FlexRadioStats
+{
+    bool     connected;
+    uint32_t connects;       // subscriptions sent
+    uint32_t failures;       // connects refused or timed out, connections lost
+    uint32_t lines;
+    uint32_t frequencies;    // RF_frequency updates for the followed slice
+    uint32_t skipped;        // lines longer than FLEX_LINE_MAX
+};
+
+// ip in IPAddress byte order, 0 = off. Drops any open connection.
+void flexRadioBegin(uint32_t ip, uint8_t slice);
+void flexRadioService(bool online);      // loop()
+FlexRadioStats flexRadioStats();
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --------------------------------------------------
+// Hardware abstraction layer
+//
+// The firmware talks to the board through this header plus the
+// Arduino/ESP32 classes it already uses (Preferences for NVS, WiFi and
+// PubSubClient for the network). On the ESP32 these are
+// backed by the Arduino core (src/hal_esp32.cpp); in the native build
+// lib/sim provides a simulated board with a virtual clock.
+// --------------------------------------------------
+
+// Clock: monotonic microseconds since boot.
+uint64_t halMicros();
+
+// Wall clock: UTC microseconds since 1970, kept by SNTP on the ESP32.
+// False until the first sync. It may step whenever SNTP corrects it.
+void halClockSyncBegin(const char* server);
+bool halUtcMicros(uint64_t* us);
+
+// GPIO: relay outputs.
+void halGpioOutput(int pin);
+void halGpioWrite(int pin, bool level);
+
+// Masked output write, bit n = GPIOn. All bits in clearMask drop in one
+// register write, then all bits in setMask rise in a second one.
+void halGpioWriteMask(uint64_t clearMask, uint64_t setMask);
+
+// GPIO inputs. fn runs in interrupt context on every edge of pin with the
+// level read in the interrupt (IRAM on the ESP32): it may only use
+// halMicros, halCritical*, halGpioWriteMask and halWorkerNotifyFromIsr.
+typedef void (*HalGpioIsr)(bool level);
+
+void halGpioInput(int pin, bool pullUp);
+bool halGpioRead(int pin);
+void halGpioOnChange(int pin, HalGpioIsr fn);
+
+// Continuous ADC: the DMA engine samples pins (ADC1 only) round-robin
+// at sampleHz in total, and a task of its own, pinned to core at
+// priority, calls fn with each frame of up to HAL_ADC_FRAME samples as
+// it completes; loop() is not involved. A sample is the pin's index in
+// pins << 12 | the 12-bit reading. Once per boot.
+const size_t HAL_ADC_FRAME = 64;
+const size_t HAL_ADC_PINS  = 8;
+
+typedef void (*HalAdcFn)(const uint16_t* samples, size_t count);
+
+bool halAdcStart(const int* pins, size_t count, uint32_t sampleHz, HalAdcFn fn, int core, int priority);
+
+// Output expanders. halShiftOut clocks bytes out MSB first and pulses
+// latch once at the end, so a whole 74HC595 chain changes together;
+// bytes[0] ends up in the register furthest from the MCU. halI2cWrite is
+// one START..STOP transfer, false if the device did not acknowledge.
+void halShiftOut(int dataPin, int clockPin, int latchPin, const uint8_t* bytes, size_t len);
+bool halI2cBegin(int sda, int scl, uint32_t hz);
+bool halI2cWrite(uint8_t addr, const uint8_t* data, size_t len);
+
+// One-shot microsecond timers. Callbacks run outside loop() (esp_timer
+// task on the ESP32), so shared state must be guarded with halCritical*.
+typedef void (*HalTimerFn)();
+typedef struct HalTimer* HalTimerHandle;
+
+HalTimerHandle halTimerCreate(const char* name, HalTimerFn fn);
+void halTimerArm(HalTimerHandle timer, uint32_t us);
+void halTimerCancel(HalTimerHandle timer);
+
+void halCriticalEnter();
+void halCriticalExit();
+
+// Worker tasks: fn runs on its own task, pinned to core, each time the
+// worker is notified. Notifications that arrive while fn is pending or
+// running fold into one more run. Notify from any task with
+// halWorkerNotify, from an interrupt with halWorkerNotifyFromIsr.
+// Created once per boot from a fixed pool; halWorkerCreate() returns
+// nullptr past HAL_WORKERS_MAX. A module that adds a worker counts it
+// here.
+const int HAL_WORKERS_MAX = 3;           // relay task, event log writer, OTA
+
+typedef void (*HalWorkerFn)();
+typedef struct HalWorker* HalWorkerHandle;
+
+HalWorkerHandle halWorkerCreate(const char* name, HalWorkerFn fn, int core, int priority);
+void halWorkerNotify(HalWorkerHandle worker);
+void halWorkerNotifyFromIsr(HalWorkerHandle worker);
+
+// OTA images. After an update the new image boots pending:
+// halOtaConfirm() keeps it, halOtaRollback() marks it bad and reboots
+// into the previous one. A reset before either also rolls back.
+size_t halOtaPartitionSize();        // slot the next update goes to, 0 = none
+bool halOtaPending();                // running image awaits confirmation
+void halOtaConfirm();
+void halOtaRollback();               // does not return
+
+// Event log flash: a raw data partition (the default table's "spiffs",
+// unused by this firmware). NOR: erase sets a whole HAL_LOG_SECTOR to
+// 0xff, writes only clear bits. Offsets are from the partition start;
+// size 0 = no partition. Read and written from loop() only.
+const size_t HAL_LOG_SECTOR = 4096;
+
+size_t halLogFlashSize();
+bool halLogFlashErase(size_t offset);                          // the sector at offset
+bool halLogFlashWrite(size_t offset, const void* data, size_t len);
+bool halLogFlashRead(size_t offset, void* data, size_t len);
+
+// Why the chip last started, as esp_reset_reason_t: 1 power-on,
+// 3 software restart, 4 panic, 5-7 watchdogs, 9 brownout.
+uint8_t halResetReason();
+
+// 32 random bits (the hardware RNG on the ESP32), for nonces.
+uint32_t halRandom();
+
+// Non-blocking TCP sockets (lwIP on the ESP32). Handles are >= 0.
+int  halTcpListen(uint16_t port, int backlog);                 // -1 on failure
+int  halTcpAccept(int listener);                               // -1 if none pending
+int  halTcpRecv(int sock, void* buf, size_t len);              // 0 = nothing yet, -1 = closed
+int  halTcpSend(int sock, const void* buf, size_t len);        // bytes queued, may be short; -1 = closed
+void halTcpClose(int sock);
+// Outgoing connection, ip in IPAddress byte order. Returns at once; poll
+// halTcpConnectState() until it leaves 0 (1 = connected, -1 = failed).
+int  halTcpConnect(uint32_t ip, uint16_t port);                // -1 on failure
+int  halTcpConnectState(int sock);
+// Sleeps until one of socks is readable (or has a connection to accept)
+// or timeoutUs has passed; readable[i] reports socks[i].
+void halTcpWait(const int* socks, int count, uint32_t timeoutUs, bool* readable);
+
+// UDP. halUdpListen() binds port and starts a task of its own, pinned to
+// core at priority, that calls fn for every datagram as it arrives; loop()
+// is not involved. halUdpSend() goes out from the same port, from fn or
+// any other task. ip in IPAddress byte order. One listener per boot.
+const size_t HAL_UDP_MAX = 512;                                // longer datagrams are cut
+
+typedef void (*HalUdpFn)(const uint8_t* data, size_t len, uint32_t ip, uint16_t port);
+
+bool halUdpListen(uint16_t port, HalUdpFn fn, int core, int priority);
+bool halUdpSend(uint32_t ip, uint16_t port, const void* data, size_t len);
+// To a multicast group (TTL 1, the LAN). Goes out from the listener's
+// socket when there is one; without, from a send-only socket opened on
+// first use, so never more than one UDP socket is open. Call
+// halUdpListen() first if at all. Never blocks: a datagram the stack
+// cannot take at once is dropped and false returned.
+bool halUdpMulticast(uint32_t group, uint16_t port, const void* data, size_t len);
+
+// ICMP echo (esp_ping on the ESP32). One probe is out at a time; start it,
+// then poll the result from loop(). ip is in IPAddress byte order.
+enum HalPingResult { HAL_PING_IDLE, HAL_PING_PENDING, HAL_PING_OK, HAL_PING_TIMEOUT };
+
+bool halPingStart(uint32_t ip, uint32_t timeoutMs);            // false if a probe is pending
+HalPingResult halPingResult(uint32_t* rttMs);                  // OK/TIMEOUT once, then IDLE
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+// --------------------------------------------------
+// Heap watermarks
+//
+// The request and publish paths run on fixed buffers (HttpServer's
+// connection heads and slots, the MQTT outbox, TextBuffer responses), so
+// once setup() is done the heap should hold still. heapMonitorService()
+// samples it from loop() every HEAP_SAMPLE_MS and keeps the high and low
+// water marks of free heap and of the largest free block; a largest
+// block that keeps shrinking is fragmentation, which free bytes alone do
+// not show. minFree is the allocator's own low-water mark, so it also
+// catches peaks between samples.
+// --------------------------------------------------
+
+const uint32_t HEAP_SAMPLE_MS = 1000;
+
+struct HeapStats
+{
+    uint32_t size;           // heap in total
+    uint32_t free;
+    uint32_t minFree;        // since boot
+    uint32_t maxFree;        // sampled, since heapMonitorBegin()
+    uint32_t largest;        // largest free block
+    uint32_t minLargest;     // sampled, since heapMonitorBegin()
+    uint32_t bootFree;       // at heapMonitorBegin(), end of setup()
+    uint32_t bootLargest;
+    uint32_t samples;
+};
+
+void heapMonitorBegin();
+void heapMonitorService();
+HeapStats heapMonitorStats();     // sampled now
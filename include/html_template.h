@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --------------------------------------------------
+// Streaming HTML templates
+//
+// Expands %NAME% placeholders of a flash template into a caller's buffer
+// a piece at a time, as HttpServer::sendChunked() asks for it, so a page
+// never exists whole in RAM. Values are HTML-escaped and may straddle
+// pieces: the cursor holds the template offset and how much of the
+// current value is already out, and the value is looked up again on the
+// next call. A '%' not starting a %NAME% is literal text ("width:100%").
+// --------------------------------------------------
+
+const size_t TEMPLATE_NAME_MAX  = 24;
+const size_t TEMPLATE_VALUE_MAX = 160;   // before escaping; longer values are cut
+
+// Writes the value of name into out (size bytes, NUL-terminated); unknown
+// names leave it empty.
+typedef void (*TemplateLookup)(const char* name, char* out, size_t size);
+
+// Fills up to size bytes (at least 6, the longest escape) from *cursor,
+// 0 on the first call. Returns 0 at the end. Templates up to 64 KiB.
+size_t templateRender(const char* tmpl, TemplateLookup lookup, char* buf, size_t size, uint32_t* cursor);
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WebServer.h>   // HTTPMethod, HTTPUpload
+
+// --------------------------------------------------
+// Non-blocking HTTP/1.1 server
+//
+// Serves up to HTTP_MAX_CONNECTIONS sockets from loop(). Each
+// handleClient() pass reads what has arrived on every connection, runs
+// the handler for at most one complete request per connection and sends
+// as much pending response as each socket takes, so a slow client never
+// holds up the others, MQTT or the WiFi watchdog. Connections are kept
+// alive; when the last free slot is taken, the longest-idle keep-alive
+// connection is closed, and while clients still queue behind a full
+// pool the busiest connections are ended after their current response
+// so the slots turn over.
+//
+// Buffers are fixed per connection: headers are parsed a line at a time
+// and only the request target and the headers named in collectHeaders()
+// are kept, a request body must fit HTTP_RX_BUFFER, and multipart uploads
+// stream through HTTPUpload.buf (the upload handler can read the query
+// with arg()). A longer form body goes to the one shared HTTP_FORM_MAX
+// buffer, 503 while another request has it. A response's status line and headers, and a body that
+// fits after them, are kept in the connection's HTTP_HEAD_MAX bytes;
+// longer send() bodies are copied to one of HTTP_BODY_SLOTS shared
+// buffers, 503 while every one is busy. Generated pages are pulled chunk
+// by chunk into one of HTTP_CHUNK_SLOTS shared buffers as the socket
+// drains. Nothing is allocated per request.
+// Handlers use the same calls as the Arduino WebServer.
+// --------------------------------------------------
+
+// lwIP has LWIP_SOCKETS in all (CONFIG_LWIP_MAX_SOCKETS); the pool gets
+// what the permanent ones leave: the listener, MQTT, the gateway ping,
+// the FlexRadio status feed and UDP (control, or the beacons without it,
+// never both). A module that opens another
+// one counts it here.
+const int      LWIP_SOCKETS            = 16;
+const int      HTTP_RESERVED_SOCKETS   = 5;
+const int      HTTP_MAX_CONNECTIONS    = LWIP_SOCKETS - HTTP_RESERVED_SOCKETS;
+const int      HTTP_MAX_ROUTES         = 16;
+const size_t   HTTP_RX_BUFFER          = 1024;   // header line or request body
+const size_t   HTTP_FORM_MAX           = 4096;   // form body: /settings with every field at its longest, encoded
+const size_t   HTTP_TARGET_MAX         = 256;    // path + query
+const uint32_t HTTP_REQUEST_TIMEOUT_MS = 5000;   // a started request must finish
+const uint32_t HTTP_IDLE_TIMEOUT_MS    = 15000;  // keep-alive
+const uint32_t HTTP_EVICT_IDLE_MS      = 1000;   // idle this long before a new client may take the slot
+const uint32_t HTTP_POLL_US            = 1000;   // handleClient() sleep when idle
+const int      HTTP_MAX_HEADERS        = 2;      // collectHeaders()
+const size_t   HTTP_HEADER_VALUE_MAX   = 48;     // longer values are not kept
+const size_t   HTTP_HEAD_MAX           = 384;    // status line + headers + a short body
+const size_t   HTTP_HEADERS_MAX        = 192;    // sendHeader() lines of one response
+const size_t   HTTP_BODY_MAX           = 1024;   // longest send() body; longer pages go chunked
+const int      HTTP_BODY_SLOTS         = 2;      // send() bodies longer than the head takes
+const size_t   HTTP_CHUNK_SIZE         = 1536;   // sendChunked() payload per chunk; one /metrics histogram
+const int      HTTP_CHUNK_SLOTS        = 2;      // chunked responses in flight
+
+struct HttpServerStats
+{
+    uint32_t accepted;
+    uint32_t requests;
+    uint32_t evicted;        // idle keep-alive closed for a new client
+    uint32_t timedOut;
+    uint32_t rejected;       // 400/413/503 from the engine itself
+    uint8_t  open;           // connections in use, streams included
+    uint8_t  peak;
+};
+
+class HttpServer
+{
+public:
+    typedef void (*Handler)();
+    // Writes up to size bytes of a generated body at *cursor (0 on the
+    // first call) and advances it; returns 0 at the end.
+    typedef size_t (*ChunkFiller)(char* buf, size_t size, uint32_t* cursor);
+
+    explicit HttpServer(uint16_t port = 80) : port_(port) {}
+
+    void begin();
+    void handleClient();
+
+    void on(const char* uri, HTTPMethod method, Handler fn, Handler uploadFn = nullptr);
+    void onNotFound(Handler fn) { notFound_ = fn; }
+    void collectHeaders(const char* const names[], size_t count);
+
+    // Request being handled
+    String uri() const;
+    HTTPMethod method() const;
+    bool hasArg(const char* name) const;
+    String arg(const char* name) const;
+    bool hasHeader(const char* name) const;
+    String header(const char* name) const;
+    HTTPUpload& upload() { return upload_; }
+    // Without a String: the value decoded into buf, false if absent or
+    // longer than size - 1; a collected header in place, null if absent.
+    bool arg(const char* name, char* buf, size_t size) const;
+    const char* collectedHeader(const char* name) const { return findHeader(name); }
+
+    // Response: queued and sent from handleClient(). send_P() keeps a
+    // pointer to the flash content instead of copying it; with a length
+    // it may be binary. sendChunked() pulls the body from fill() as the
+    // socket takes it, 503 while every chunk slot is busy; cursor is what
+    // the first call to fill() sees.
+    void sendHeader(const char* name, const char* value);
+    void send(int code, const char* contentType = nullptr, const char* content = "");
+    void send(int code, const char* contentType, const String& content)
+    {
+        sendCopy(code, contentType, content.c_str(), content.length());
+    }
+    void send_P(int code, const char* contentType, const char* content);
+    void send_P(int code, const char* contentType, const char* content, size_t contentLength);
+    void sendChunked(int code, const char* contentType, ChunkFiller fill, uint32_t cursor = 0);
+
+    // Turns the current connection into a raw stream (Server-Sent
+    // Events): header is written now and the engine stops reading
+    // requests from it. Returns a handle, or -1.
+    int beginStream(const char* header);
+    bool streamWrite(int stream, const char* data, size_t len);   // false: dropped
+    void streamClose(int stream);
+    bool streamOpen(int stream) { return streamConn(stream) != nullptr; }
+
+    HttpServerStats stats() const;
+
+private:
+    enum State : uint8_t { FREE, HEAD, BODY, MULTIPART, SENDING, STREAM };
+
+    struct Conn
+    {
+        int      sock;
+        State    state;
+        uint8_t  generation;
+        bool     keepAlive;
+        bool     http10;
+        HTTPMethod method;
+        uint32_t lastActivityMs;
+        uint32_t requestStartMs;
+        uint16_t served;          // responses completed on this connection
+        bool     retiring;        // close after the current response
+
+        char     target[HTTP_TARGET_MAX];
+        char     headers[HTTP_MAX_HEADERS][HTTP_HEADER_VALUE_MAX];   // collectHeaders() values
+        char     boundary[72];
+        uint32_t contentLength;
+        uint32_t bodyRead;
+        bool     formBody;
+        uint8_t  multipartState;
+        bool     partIsFile;
+
+        uint8_t  rx[HTTP_RX_BUFFER];
+        size_t   rxLen;
+        size_t   bodyLen;         // body bytes at the front of rx (or formBuf_) after dispatch
+
+        char     head[HTTP_HEAD_MAX];   // status line, headers, a short body
+        size_t   headLen;
+        const char* txStatic;     // send_P body, a body slot or the current chunk
+        size_t   txLen;
+        size_t   txSent;          // across head + body
+        bool     closeAfterSend;
+
+        ChunkFiller chunkFill;    // null: not chunked
+        char*    chunk;           // slot in chunkBuf_
+        uint32_t chunkCursor;
+        bool     chunkLast;       // terminating chunk queued
+    };
+
+    struct Route
+    {
+        const char* uri;
+        HTTPMethod method;
+        Handler fn;
+        Handler uploadFn;
+    };
+
+    void acceptClients();
+    void evictIdle();
+    void retireBusiest();
+    void service(Conn& c, bool readable, uint32_t now);
+    bool readHead(Conn& c);
+    bool parseRequestLine(Conn& c, char* line);
+    void parseHeader(Conn& c, char* line);
+    bool readMultipart(Conn& c);
+    void multipartData(Conn& c, const uint8_t* data, size_t len);
+    void runUpload(Conn& c);
+    void dispatch(Conn& c);
+    void reject(Conn& c, int code);
+    bool responding() const;
+    void startResponse(Conn& c, int code, const char* contentType, size_t bodyLen);
+    void sendCopy(int code, const char* contentType, const char* content, size_t len);
+    bool flush(Conn& c);
+    bool flushSegment(Conn& c);
+    bool nextChunk(Conn& c);
+    void releaseBuffers(Conn& c);
+    const uint8_t* body(const Conn& c) const { return formOwner_ == &c ? formBuf_ : c.rx; }
+    void finishResponse(Conn& c);
+    void resetRequest(Conn& c);
+    void closeConn(Conn& c);
+    const Route* findRoute(const Conn& c) const;
+    bool findArgValue(const char* name, const char** value, size_t* len, bool* encoded) const;
+    const char* findHeader(const char* name) const;
+    Conn* streamConn(int stream);
+
+    uint16_t port_;
+    int      listener_ = -1;
+    Conn     conns_[HTTP_MAX_CONNECTIONS];
+    Route    routes_[HTTP_MAX_ROUTES];
+    int      routeCount_ = 0;
+    Handler  notFound_ = nullptr;
+    const char* collect_[HTTP_MAX_HEADERS] = {};
+    int      collectCount_ = 0;
+    char     chunkBuf_[HTTP_CHUNK_SLOTS][HTTP_CHUNK_SIZE + 7];   // size line + data + CRLF
+    Conn*    chunkOwner_[HTTP_CHUNK_SLOTS] = {};
+    char     bodyBuf_[HTTP_BODY_SLOTS][HTTP_BODY_MAX];
+    Conn*    bodyOwner_[HTTP_BODY_SLOTS] = {};
+    uint8_t  formBuf_[HTTP_FORM_MAX];
+    Conn*    formOwner_ = nullptr;
+
+    Conn*    current_ = nullptr;
+    Conn*    uploading_ = nullptr;
+    HTTPUpload upload_;
+    char     headers_[HTTP_HEADERS_MAX];   // sendHeader() lines for the current response
+    size_t   headersLen_ = 0;
+
+    HttpServerStats stats_ = {};
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// --------------------------------------------------
+// Lock-free building blocks for passing data between tasks
+//
+// Both are fixed-size and never allocate. T must be trivially copyable.
+// --------------------------------------------------
+
+// Bounded single-producer / single-consumer ring. One push() at a time:
+// several tasks may produce if they serialise under a lock of their own
+// (the relay arbiter pushes under halCritical, so the ring holds commands
+// in the order they were arbitrated). The consumer takes no lock and
+// never blocks a producer; push() fails if the ring is full.
+template <typename T, uint32_t N>
+class SpscRing
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+public:
+    SpscRing() { reset(); }
+
+    // Only while no producer or consumer is running.
+    void reset()
+    {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    // Producer side.
+    bool push(const T& item)
+    {
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == N) return false;
+        slots_[head & (N - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer task only.
+    bool pop(T* item)
+    {
+        const uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail) return false;
+        *item = slots_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Pushed and not yet consumed; consumer task only.
+    uint32_t depth() const
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_relaxed);
+    }
+
+private:
+    T slots_[N];
+    std::atomic<uint32_t> head_;
+    std::atomic<uint32_t> tail_;
+};
+
+// Single-writer snapshot (seqlock). The writer never waits; a reader
+// copies the value and retries if a write overlapped the copy, so it
+// always returns a value that was published as a whole. The payload is
+// stored as relaxed atomic words, which keeps the overlapping copy
+// well-defined.
+template <typename T>
+class SeqLock
+{
+public:
+    SeqLock() : seq_(0) {}
+
+    // Writer task only.
+    void write(const T& value)
+    {
+        uint32_t buf[WORDS] = {};
+        memcpy(buf, &value, sizeof(T));
+
+        const uint32_t s = seq_.load(std::memory_order_relaxed);
+        seq_.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++) words_[i].store(buf[i], std::memory_order_relaxed);
+        seq_.store(s + 2, std::memory_order_release);
+    }
+
+    // Any task.
+    T read() const
+    {
+        uint32_t buf[WORDS];
+        for (;;) {
+            const uint32_t s = seq_.load(std::memory_order_acquire);
+            if (s & 1) continue;
+            for (size_t i = 0; i < WORDS; i++) buf[i] = words_[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == s) break;
+        }
+        T value;
+        memcpy(&value, buf, sizeof(T));
+        return value;
+    }
+
+private:
+    static const size_t WORDS = (sizeof(T) + 3) / 4;
+
+    std::atomic<uint32_t> seq_;
+    std::atomic<uint32_t> words_[WORDS] = {};
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "relay_task.h"
+#include "text_buffer.h"
+
+// --------------------------------------------------
+// Instrumentation: fixed-bucket histograms
+//
+// Every histogram has its own static bucket table; an observation is a
+// bucket scan and three increments under halCritical, callable from any
+// task and allocation-free. Values are recorded in microseconds and
+// exposed in seconds in the Prometheus text format on /metrics, where
+// main.cpp adds the counters and gauges it already keeps. The exposition
+// is streamed an item at a time (see textRenderItems), one histogram per
+// item, so its buckets always agree with its count.
+// --------------------------------------------------
+
+// The command latency entries follow RelaySource.
+enum MetricHistogram : uint8_t {
+    METRIC_CMD_LOCAL,        // command arrival -> relay sequencer request
+    METRIC_CMD_HTTP,
+    METRIC_CMD_MQTT,
+    METRIC_CMD_SCHEDULE,     // measured from the due time, not arrival
+    METRIC_CMD_BAND,         // from the frequency update
+    METRIC_CMD_UDP,
+    METRIC_CMD_SWR,          // from the frame that tripped
+    METRIC_LOOP,             // loop() entry to the next loop() entry
+    METRIC_HTTP_SERVICE,     // one server.handleClient() pass
+    METRIC_MQTT_CONNECT,     // one reconnect attempt, successful or not
+    METRIC_GATEWAY_RTT,      // WiFi supervisor probe echo
+    METRIC_HISTOGRAMS
+};
+
+const int METRIC_BUCKETS_MAX = 12;       // finite bounds; +Inf comes on top
+
+static_assert(METRIC_CMD_LOCAL + RELAY_SRC_HTTP == METRIC_CMD_HTTP &&
+              METRIC_CMD_LOCAL + RELAY_SRC_MQTT == METRIC_CMD_MQTT &&
+              METRIC_CMD_LOCAL + RELAY_SRC_SCHEDULE == METRIC_CMD_SCHEDULE &&
+              METRIC_CMD_LOCAL + RELAY_SRC_BAND == METRIC_CMD_BAND &&
+              METRIC_CMD_LOCAL + RELAY_SRC_UDP == METRIC_CMD_UDP &&
+              METRIC_CMD_LOCAL + RELAY_SRC_SWR == METRIC_CMD_SWR, "command histograms follow RelaySource");
+
+struct MetricHistogramData
+{
+    uint32_t buckets[METRIC_BUCKETS_MAX + 1];   // not cumulative; [bound count] is +Inf
+    uint32_t count;
+    uint64_t sumUs;
+};
+
+void metricsBegin();         // clears every histogram
+void metricsObserve(MetricHistogram h, uint32_t us);
+MetricHistogramData metricsHistogram(MetricHistogram h);
+
+// A counter or gauge kept elsewhere, read when its turn comes
+struct MetricValue
+{
+    const char* name;        // no prefix gets added
+    const char* help;
+    bool        counter;     // else a gauge
+    int64_t   (*read)();
+};
+
+// Exposition items for handleMetrics(): histogram h, up to ~1.1 KB with
+// its HELP/TYPE lines; false past the last one.
+bool metricsWriteHistogram(uint32_t h, TextBuffer& out);
+void metricsWriteValue(const MetricValue& v, TextBuffer& out);
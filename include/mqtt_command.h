@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --------------------------------------------------
+// MQTT command fast path
+//
+// Topics are routed by length + FNV-1a hash, computed once when the route
+// is added and once per message, with a memcmp only on a hit. Payloads
+// are parsed in place; nothing on the path allocates.
+//
+// Command grammar (surrounding whitespace ignored, keywords any case):
+//   0..N | 1+3 | off | next | prev
+//   {"ant": <n> | "<selection or keyword>", "id": "<text>" | <number>}
+//   {"mask": <outputs, bit 0 = antenna 1>, ...}
+// Other JSON keys are skipped; nested objects and arrays are rejected.
+//
+// Commands carry the time mqttDispatch() was entered; the relay task
+// measures each one from there to the relay sequencer request.
+//
+// Payload routes hand the raw payload to their handler unparsed and
+// without the MQTT_PAYLOAD_MAX limit (batch uploads such as a schedule).
+// --------------------------------------------------
+
+const int      MQTT_MAX_ROUTES     = 4;
+const size_t   MQTT_TOPIC_MAX      = 128;
+const size_t   MQTT_PAYLOAD_MAX    = 256;
+const size_t   MQTT_CMD_ID_MAX     = 32;
+
+enum MqttCommandAction : uint8_t { MQTT_CMD_SELECT, MQTT_CMD_NEXT, MQTT_CMD_PREV };
+
+struct MqttCommand
+{
+    MqttCommandAction action;
+    uint32_t outputs;                    // SELECT: selection mask, 0 = off
+    char     id[MQTT_CMD_ID_MAX + 1];    // "" if the command carried none
+    uint64_t receivedUs;                 // halMicros() at mqttDispatch() entry
+};
+
+struct MqttCommandStats
+{
+    uint32_t received;       // messages on a routed topic
+    uint32_t rejected;       // payload did not parse
+    uint32_t unmatched;      // topic not routed
+};
+
+typedef void (*MqttCommandHandler)(const MqttCommand& cmd);
+typedef void (*MqttPayloadHandler)(const uint8_t* payload, unsigned int length);
+
+void mqttRoutesClear();
+bool mqttRouteAdd(const char* topic, MqttCommandHandler fn);    // false: table full or topic too long
+bool mqttRouteAddPayload(const char* topic, MqttPayloadHandler fn);
+
+// From the PubSubClient callback.
+void mqttDispatch(const char* topic, const uint8_t* payload, unsigned int length);
+
+// count bounds the selection. False if the payload is not a command.
+bool mqttParseCommand(const uint8_t* payload, size_t length, int count, MqttCommand* cmd);
+
+MqttCommandStats mqttCommandStats();
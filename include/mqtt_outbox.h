@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Arduino.h>
+
+class PubSubClient;
+
+// --------------------------------------------------
+// MQTT outbox
+//
+// Everything the switch publishes goes through one slot per key: a new
+// value replaces the one still waiting, so a burst of switches turns into
+// at most one publish per key, and loop() sends dirty slots through a
+// token bucket (MQTT_PUBLISH_BURST, then one per MQTT_PUBLISH_INTERVAL_MS).
+// Broker traffic stays bounded however fast commands arrive.
+//
+// PubSubClient publishes at QoS 0 only, so delivery is checked end to
+// end instead: the outbox subscribes to its own topics and a publish
+// counts as delivered when the broker routes it back. Without that echo
+// within MQTT_ACK_TIMEOUT_MS, or if the session drops first, the latest
+// value for the key is sent again, up to MQTT_ACK_ATTEMPTS times. After
+// a reconnect every retained key is flushed, so subscribers catch up on
+// what changed while the broker was unreachable.
+//
+// Replies to commands that carried an id are messages to one caller,
+// not state, so they do not coalesce: they wait in a FIFO of
+// MQTT_REPLY_QUEUE and go out in order through the same bucket, once
+// each (no echo check), after the keys. Past the queue the newest is
+// refused and counted.
+// --------------------------------------------------
+
+const size_t   MQTT_OUTBOX_PAYLOAD_MAX   = 224;
+const uint8_t  MQTT_PUBLISH_BURST        = 4;
+const uint32_t MQTT_PUBLISH_INTERVAL_MS  = 100;
+const uint32_t MQTT_ACK_TIMEOUT_MS       = 5000;
+const uint8_t  MQTT_ACK_ATTEMPTS         = 3;
+const uint32_t MQTT_TELEMETRY_INTERVAL_MS = 60000;
+const size_t   MQTT_REPLY_MAX            = 192;   // {"id":...} and a /set reply
+const uint8_t  MQTT_REPLY_QUEUE          = 16;
+
+// Topics are the state topic plus a suffix.
+enum MqttKey : uint8_t {
+    MQTT_KEY_STATE,          // <state>            selection, retained
+    MQTT_KEY_TELEMETRY,      // <state>/telemetry  batched counters, retained
+    MQTT_KEY_SCHEDULE,       // <state>/schedule   schedule upload result
+    MQTT_KEYS
+};
+
+struct MqttOutboxStats
+{
+    uint32_t queued;         // mqttOutboxSet() calls
+    uint32_t coalesced;      // ... that replaced a value not yet sent
+    uint32_t published;
+    uint32_t failed;         // publish() refused (no session, too large)
+    uint32_t delivered;      // echoed back by the broker
+    uint32_t resent;         // no echo in time, or the session dropped
+    uint32_t undelivered;    // values given up after MQTT_ACK_ATTEMPTS
+    uint32_t throttled;      // loop() passes with dirty keys and no token
+    uint32_t pending;        // keys sent or waiting, not delivered yet
+    uint32_t replied;        // replies published
+    uint32_t replyDropped;   // refused, the FIFO full
+    uint8_t  replyQueued;
+    uint32_t lastAckUs;      // publish -> echo
+    uint32_t maxAckUs;
+};
+
+// stateTopic is kept by reference (it lives in mqttCfg).
+void mqttOutboxBegin(PubSubClient& client, const String& stateTopic);
+
+// loop() only. False if the payload does not fit.
+bool mqttOutboxSet(MqttKey key, const char* payload);
+
+// <state>/reply; loop() only. False if it does not fit or the FIFO is full.
+bool mqttOutboxReply(const char* payload);
+
+// After connect(): subscribes to the echo topics and marks every key for
+// a flush.
+void mqttOutboxConnected();
+
+// Sends what the bucket allows and re-arms unacknowledged keys; every
+// loop() pass while connected.
+void mqttOutboxService();
+
+// From the PubSubClient callback first. True if the topic is one of the
+// outbox's own (an echo), which is then not a command.
+bool mqttOutboxEcho(const char* topic, const uint8_t* payload, unsigned int length);
+
+MqttOutboxStats mqttOutboxStats();
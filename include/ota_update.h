@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sha256.h"
+
+// --------------------------------------------------
+// OTA update pipeline
+//
+// The upload handler copies the body into one of OTA_BUFFERS sector-sized
+// buffers from loop(); a full buffer is handed to the OTA task, which
+// hashes it and writes it to the update partition while loop() receives
+// into the other one. loop() only waits when both buffers are queued.
+//
+// Checked before anything is erased: the declared size against the
+// update partition, then the image header (magic, chip). At the end the
+// image's appended SHA-256 (esptool's hash_appended) and, if the client
+// sent one, the digest of the whole file must match, otherwise the
+// update is aborted and the running image stays the boot image.
+//
+// A new image boots pending (see halOtaConfirm()). It is kept once WiFi
+// has been online for OTA_HEALTHY_MS in a row; if that has not happened
+// OTA_CONFIRM_TIMEOUT_MS after boot, or the device resets first, the
+// previous image comes back.
+// --------------------------------------------------
+
+const size_t   OTA_BUFFER_SIZE        = 4096;     // one flash sector
+const int      OTA_BUFFERS            = 2;
+const int      OTA_TASK_CORE          = 0;        // beside lwIP; loop() and the relay task keep core 1
+const int      OTA_TASK_PRIORITY      = 5;        // above loop() (1), below lwIP (18)
+const uint32_t OTA_HEALTHY_MS         = 30000;
+const uint32_t OTA_CONFIRM_TIMEOUT_MS = 5UL * 60 * 1000;
+const size_t   OTA_HEADER_SIZE        = 24;       // esp_image_header_t
+
+enum OtaState : uint8_t { OTA_IDLE, OTA_RECEIVING, OTA_DONE, OTA_FAILED };
+
+struct OtaStats
+{
+    OtaState state;
+    uint16_t httpCode;       // for the upload's response: 200, or why it failed
+    uint32_t size;           // declared, 0 = unknown
+    uint32_t received;
+    uint32_t written;        // by the OTA task
+    uint32_t totalUs;        // otaBegin() -> otaEnd()
+    uint32_t flashUs;        // OTA task in Update.write()
+    uint32_t hashUs;         // OTA task hashing
+    uint32_t waitUs;         // loop() waiting for a free buffer
+    uint32_t waits;
+    uint32_t kbPerS;         // received / totalUs
+    uint8_t  sha256[SHA256_SIZE];   // of the whole file, once done
+    bool     pending;        // running image not confirmed yet
+    bool     confirmed;      // ... and confirmed since boot
+    char     error[64];
+};
+
+// size = 0 if the client did not say; sha256Hex (64 digits) may be empty.
+// False if refused; otaStats() says why.
+bool otaBegin(size_t size, const char* sha256Hex);
+bool otaWrite(const uint8_t* data, size_t len);
+bool otaEnd();               // true: the image boots next
+void otaAbort();             // client went away
+OtaStats otaStats();
+
+// Boot health of a pending image, from setup() and every loop() pass.
+// otaHealthService() returns true once the image has to be rolled back.
+void otaHealthBegin();
+bool otaHealthService(bool online);
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --------------------------------------------------
+// Output map
+//
+// Antenna n is logical output n-1 of a table built from a text spec, so
+// one firmware drives 4-, 8- or 16-port switches. Outputs sit on banks:
+// native GPIOs, a daisy chain of 74HC595 shift registers, or MCP23017
+// I2C expanders. Selections are masks of logical outputs (bit 0 =
+// antenna 1); several bits at once feed a combiner or phased array.
+//
+// outputsWrite() takes the whole new pattern and writes each bank that
+// changes exactly once: one masked register write for GPIOs, one
+// shift-and-latch for a 595 chain, one OLATA/OLATB write per expander.
+// It is bus I/O, so it runs on the relay task only (through the relay
+// sequencer), never inside a critical section.
+//
+// Spec: one bank per statement, ';' or newline between statements;
+// outputs are numbered in the order they appear.
+//   gpio <pin> [<pin> ...]
+//   595 <data> <clock> <latch> <outputs>      chain of ceil(outputs/8)
+//   i2c <sda> <scl>                           bus for the expanders (21 22)
+//   mcp23017 <0x20..0x27> [<outputs>]         16 by default, GPA0 first
+// --------------------------------------------------
+
+const int      OUTPUTS_MAX        = 32;
+const int      OUTPUT_BANKS_MAX   = 4;
+const size_t   OUTPUT_MAP_MAX     = 128;        // spec text
+const size_t   OUTPUT_SELECTION_MAX = 88;       // "1+2+...+32" and its NUL
+const uint32_t OUTPUT_I2C_HZ      = 400000;
+const char     OUTPUT_MAP_DEFAULT[] = "gpio 16 17 18 19";
+
+enum OutputBankType : uint8_t { BANK_GPIO, BANK_HC595, BANK_MCP23017 };
+
+struct OutputBank
+{
+    OutputBankType type;
+    uint8_t  first;          // logical index of its first output
+    uint8_t  count;
+    uint8_t  pin[3];         // 595: data, clock, latch; MCP23017: address
+};
+
+struct OutputMap
+{
+    uint8_t    count;        // logical outputs
+    uint8_t    banks;
+    OutputBank bank[OUTPUT_BANKS_MAX];
+    uint8_t    gpio[OUTPUTS_MAX];   // BANK_GPIO: pin per logical output
+    uint8_t    sda, scl;
+};
+
+struct OutputStats
+{
+    uint32_t writes;         // outputsWrite() calls that changed something
+    uint32_t transactions;   // bank writes (register write, latch or I2C transfer)
+    uint32_t failures;       // expander writes that were not acknowledged
+};
+
+// false with a "statement N: ..." message in error.
+bool outputMapParse(const char* spec, OutputMap* map, char* error, size_t errorSize);
+
+// Configures every bank and drives all outputs off. False if an expander
+// does not answer; its outputs stay in the map and are retried on each write.
+bool outputsBegin(const OutputMap& map);
+int outputCount();
+uint32_t outputsAll();                   // mask of every mapped output
+void outputsWrite(uint32_t pattern);     // relay task only
+uint32_t outputsDriven();
+OutputStats outputsStats();
+
+inline uint32_t outputBit(int antenna)
+{
+    return antenna >= 1 && antenna <= OUTPUTS_MAX ? 1u << (antenna - 1) : 0;
+}
+
+// 0 = off, n = the one antenna selected, -1 = several.
+int outputsAntenna(uint32_t mask);
+
+// "off", "0", "3", "1+3" ('+', ',' or ' ' between antennas) -> mask.
+// False if malformed or an antenna is above count.
+bool outputsParseSelection(const char* s, size_t n, int count, uint32_t* mask);
+// The inverse: "off", "3" or "1+3".
+void outputsFormatSelection(uint32_t mask, char* buf, size_t size);
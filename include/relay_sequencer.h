@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+// --------------------------------------------------
+// Break-before-make relay sequencer
+//
+// A request drops every energised output in one outputsWrite(), then sets
+// the new pattern once the dead time has passed. Nothing blocks: a
+// one-shot timer calls wake when the dead time is over and the owner runs
+// relaySequencerService(); a request that arrives during the dead time
+// just retargets the pending make. Output writes may be bus transfers to
+// an expander, so requests and service calls all come from one task (the
+// relay task), never from the timer itself. Masks are logical outputs
+// (see outputs.h).
+//
+// The TX interlock holds the sequencer from its interrupt: from then on
+// no output is written, requests only retarget (the latest wins), and
+// a break in progress waits to make. relaySequencerService() after the
+// release picks up where it stopped. A write that began before the hold
+// finishes; relaySequencerSettleUs() tells the interlock when the
+// contacts will have settled.
+// --------------------------------------------------
+
+struct RelaySequencerStats
+{
+    uint32_t transitions;    // break/make cycles started
+    uint32_t retargets;      // requests folded into a running cycle
+    uint32_t deferred;       // requests that arrived while held
+};
+
+typedef void (*RelaySequencerWake)();
+
+void relaySequencerBegin(uint32_t deadTimeUs, RelaySequencerWake wake);
+void relaySequencerSetDeadTime(uint32_t deadTimeUs);
+void relaySequencerRequest(uint32_t target);
+void relaySequencerService();        // makes the pending pattern once the dead time is over
+
+// Any context, interrupts included.
+void relaySequencerHold(bool hold);
+// 0 once the outputs have been still for a dead time; UINT32_MAX while
+// nothing is connected (every output off, or a break waiting to make).
+uint32_t relaySequencerSettleUs();
+
+bool relaySequencerBusy();
+uint32_t relaySequencerOutputs();    // pattern currently driven
+RelaySequencerStats relaySequencerStats();
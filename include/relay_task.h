@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdint.h>
+
+// --------------------------------------------------
+// Relay task
+//
+// Relay control runs in its own task, pinned to the application core at
+// a priority above loop(); WiFi and lwIP keep the protocol core, so a
+// socket call stuck in loop() cannot hold up a switch. Any task posts
+// commands through the arbiter (below), which queues each one it applies
+// in the same halCritical section as its verdict: posters are
+// serialised there, and the ring holds commands in the order they were
+// decided. The relay task drains the ring without a lock, drives the
+// relay sequencer and publishes the result as a snapshot. Readers copy
+// the snapshot without taking a lock.
+//
+// Nothing here touches the network or NVS: loop() picks up each new
+// snapshot version and does the journal, dashboard and MQTT side effects
+// (see serviceRelayState()).
+// --------------------------------------------------
+
+const int      RELAY_TASK_CORE     = 1;      // APP_CPU; WiFi/lwIP run on core 0
+const int      RELAY_TASK_PRIORITY = 20;     // above loop() (1), below the WiFi task (23)
+const uint32_t RELAY_QUEUE_LEN     = 16;
+const uint32_t RELAY_BUDGET_US     = 100;    // command arrival -> sequencer request
+const uint16_t RELAY_WINDOW_MAX_MS = 1000;
+const uint8_t  RELAY_PRIORITY_MAX  = 9;
+
+enum RelayAction : uint8_t { RELAY_SELECT, RELAY_NEXT, RELAY_PREV };
+enum RelaySource : uint8_t {
+    RELAY_SRC_LOCAL, RELAY_SRC_HTTP, RELAY_SRC_MQTT, RELAY_SRC_SCHEDULE, RELAY_SRC_BAND, RELAY_SRC_UDP,
+    RELAY_SRC_SWR, RELAY_SOURCES
+};
+
+// --------------------------------------------------
+// Arbitration
+//
+// Decided in the poster's task, under halCritical, so the caller gets
+// the verdict back at once and can put it in its reply. next/prev
+// resolve here against the latest accepted selection.
+//
+// Coalescing: a command applied at once opens a window of windowMs.
+// What arrives inside it is held instead, the newest replacing (and
+// superseding) the one held before, and the relay task applies the
+// survivor when the window ends, which opens the next window. A burst
+// of any length costs at most one switch per window, and the relays
+// never visit the antennas in between. windowMs 0 applies every command
+// as it comes.
+//
+// Priority (0..RELAY_PRIORITY_MAX per source): inside a window, a
+// command from a source ranked below the one that owns the window (that
+// opened it, or is held) is refused as outranked; equal or higher takes
+// over. So with automation ranked above the web UI, a click landing in
+// the middle of a band change does not undo it.
+//
+// Manual lock: while on, only RELAY_SRC_HTTP and RELAY_SRC_LOCAL are
+// taken, whoever owns the window. RELAY_SRC_SWR passes every rule,
+// cancels a held command and closes the window: a trip is never delayed.
+// --------------------------------------------------
+enum RelayVerdict : uint8_t {
+    RELAY_APPLIED,           // posted to the relay task
+    RELAY_HELD,              // applied when the window ends, unless superseded first
+    RELAY_BUSY,              // ring full
+    RELAY_LOCKED,            // manual lock on
+    RELAY_OUTRANKED,         // a higher-ranked source owns the window
+};
+
+struct RelayPostResult
+{
+    RelayVerdict verdict;
+    bool         superseded; // replaced a held command that will now never apply
+    RelaySource  by;         // RELAY_OUTRANKED: the window's owner; superseded: the held command's source
+    uint32_t     outputs;    // the selection it resolved to
+};
+
+struct RelaySnapshot
+{
+    uint32_t version;        // bumped for every applied command
+    uint32_t outputs;        // selection mask, bit 0 = antenna 1
+    int8_t   antenna;        // 0 = off, -1 = several outputs (outputsAntenna())
+    RelaySource source;      // of the command that set it
+};
+
+struct RelayLatency
+{
+    uint32_t count;
+    uint32_t overBudget;     // ... taking longer than RELAY_BUDGET_US
+    uint32_t lastUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+};
+
+struct RelayTaskStats
+{
+    uint32_t posted;
+    uint32_t dropped;        // ring full
+    uint32_t held;           // commands that arrived inside a window
+    uint32_t superseded;     // held commands replaced before their window ended
+    uint32_t outranked;
+    uint32_t lockedOut;      // refused, or dropped from hold, by the manual lock
+    bool     locked;
+    uint32_t applied;
+    uint32_t wakeups;
+    uint32_t peakDepth;      // most commands waiting at one wake-up
+    RelayLatency latency[RELAY_SOURCES];
+};
+
+// Creates the task on first call and starts the relay sequencer with
+// every output off; outputs is the state before the first command.
+void relayTaskBegin(uint32_t outputs, uint32_t deadTimeUs);
+
+// Any task. arrivedUs is halMicros() when the command reached the device
+// and is where its latency is measured from. False unless applied or
+// held; result (optional) says why. next/prev step from the lowest
+// selected antenna.
+bool relayPost(RelayAction action, int antenna, RelaySource source, uint64_t arrivedUs,
+               RelayPostResult* result = nullptr);
+bool relayPostOutputs(uint32_t outputs, RelaySource source, uint64_t arrivedUs,     // multi-select
+                      RelayPostResult* result = nullptr);
+
+// Any task; from the next post on. priority has RELAY_SOURCES entries
+// (RELAY_SRC_SWR's is not used).
+void relayArbiterConfigure(uint16_t windowMs, const uint8_t* priority);
+void relayArbiterLock(bool on);      // on drops a held command the lock would refuse
+bool relayArbiterLocked();
+const char* relaySourceName(RelaySource source);
+const char* relayVerdictName(RelayVerdict verdict);
+
+// Runs the relay task without a command: timers and the TX interlock.
+void relayTaskWake();
+void relayTaskWakeFromIsr();
+
+RelaySnapshot relaySnapshot();
+RelayTaskStats relayTaskStats();
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "text_buffer.h"
+
+// --------------------------------------------------
+// On-device scheduler and switching macros
+//
+// Entries fire at a UTC time of day on chosen weekdays. Each one selects
+// an antenna or starts a macro, which is a list of antenna/duration
+// steps ("2 for 90 s, then 3"). Whatever is due next sits in a min-heap
+// keyed on halMicros(). One timer is armed for the top of the heap and
+// its callback posts straight to the relay task, so firings keep their
+// time whatever loop() is doing. The wall clock (SNTP) only places
+// entries on the monotonic clock; loop() rebuilds the heap when it first
+// syncs or steps.
+//
+// One macro runs at a time: starting a macro, or an entry selecting an
+// antenna, ends the one running. /set and MQTT commands do not.
+//
+// Schedule text, one statement per line or ';'-separated, '#' starts a
+// comment:
+//   macro <1..8> <ant>[/<duration>] ...     a step without a duration holds
+//   at <hh:mm[:ss[.mmm]]> [<days>] <ant> | m<1..8>
+// ant is 0..N or off; duration is <n>ms|s|m|h (seconds without a unit);
+// days is daily (default), weekdays, weekends or a list such as
+// mon,wed,fri or mon-fri. A loaded schedule replaces the previous one
+// and is stored in NVS as one blob: 6 bytes per entry, 4 per macro step.
+// --------------------------------------------------
+
+const int      SCHED_MAX_ENTRIES  = 32;
+const int      SCHED_MAX_MACROS   = 8;
+const int      SCHED_MAX_STEPS    = 8;          // per macro
+const size_t   SCHED_TEXT_MAX     = 1024;       // one batch, as sent
+const uint32_t SCHED_STEP_MAX_MS  = 0x03ffffff; // ~18 h
+const uint32_t SCHED_RESYNC_US    = 2000;       // wall clock moves this far -> replan
+
+const uint8_t  SCHED_DAILY = 0x7f;              // bit 0 = Sunday
+const uint8_t  SCHED_MACRO = 0x80;              // action: SCHED_MACRO | macro number
+
+struct SchedEntry
+{
+    uint32_t msOfDay;        // UTC
+    uint8_t  days;
+    uint8_t  action;         // antenna, or SCHED_MACRO | 1..SCHED_MAX_MACROS
+};
+
+struct SchedStep
+{
+    uint8_t  antenna;
+    uint32_t ms;             // 0 = hold
+};
+
+struct SchedMacro
+{
+    uint8_t   steps;         // 0 = not defined
+    SchedStep step[SCHED_MAX_STEPS];
+};
+
+struct Schedule
+{
+    uint8_t    entries;
+    SchedEntry entry[SCHED_MAX_ENTRIES];
+    SchedMacro macro[SCHED_MAX_MACROS];  // [0] is m1
+};
+
+struct SchedulerStats
+{
+    uint8_t  entries;
+    uint8_t  macros;
+    uint8_t  running;        // macro number, 0 = none
+    bool     clockSynced;
+    uint32_t fired;          // entry actions and macro steps posted
+    uint32_t dropped;        // ... refused by the relay task (queue full, locked, outranked)
+    uint32_t replans;
+    uint32_t blobBytes;      // NVS size of the schedule
+    int32_t  nextInMs;       // -1 if nothing is pending
+};
+
+// false with a "line N: ..." message in error.
+bool scheduleParse(const char* text, size_t len, Schedule* out, char* error, size_t errorSize);
+// Canonical text, a line per call (macros first); parses back to the
+// same schedule. false past the last line.
+bool scheduleFormat(const Schedule& s, uint32_t line, TextBuffer& out);
+
+void schedulerBegin();                   // NVS schedule; entries wait for the wall clock
+bool schedulerLoad(const Schedule& s);   // replace, persist, replan; false if NVS refused it
+const Schedule& schedulerCurrent();      // loop() only
+void schedulerService();                 // loop(): wall clock synced or stepped
+SchedulerStats schedulerStats();
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --------------------------------------------------
+// SHA-256 (FIPS 180-4), incremental
+//
+// Plain C++ so the OTA pipeline hashes the same way on the board and in
+// the native build. The context is copyable: hash a prefix, copy, and
+// both copies can be finished separately.
+// --------------------------------------------------
+
+const size_t SHA256_SIZE = 32;
+
+struct Sha256
+{
+    uint32_t state[8];
+    uint64_t bytes;
+    uint8_t  block[64];
+};
+
+void sha256Begin(Sha256* ctx);
+void sha256Update(Sha256* ctx, const void* data, size_t len);
+void sha256Finish(Sha256* ctx, uint8_t digest[SHA256_SIZE]);
+
+// 64 hex digits, either case -> digest. False if malformed.
+bool sha256ParseHex(const char* hex, size_t len, uint8_t digest[SHA256_SIZE]);
+void sha256FormatHex(const uint8_t digest[SHA256_SIZE], char out[2 * SHA256_SIZE + 1]);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+// --------------------------------------------------
+// Write-behind antenna journal
+//
+// Selections (output masks) go to a RAM shadow; journalService() writes
+// the latest one after the switch has been quiet for JOURNAL_QUIET_MS (or
+// at most every JOURNAL_MAX_DELAY_MS while it keeps switching). Records
+// are 8 bytes and rotate through JOURNAL_SLOTS NVS keys so no single
+// entry takes every write; 4-byte records from older firmware (one
+// antenna number) still restore. Call journalFlush() before a reboot or
+// OTA.
+// --------------------------------------------------
+
+const uint32_t JOURNAL_QUIET_MS     = 5000;
+const uint32_t JOURNAL_MAX_DELAY_MS = 30000;
+const int      JOURNAL_SLOTS        = 16;
+
+struct JournalStats
+{
+    uint32_t recorded;       // selections handed to the journal
+    uint32_t flushes;        // NVS records written
+    uint32_t bytesWritten;
+    uint16_t seq;            // sequence number of the last record
+    bool     pending;        // shadow differs from flash
+};
+
+// Opens the journal and returns the newest valid record, or fallback if
+// the ring is empty.
+uint32_t journalBegin(uint32_t fallback);
+void journalRecord(uint32_t outputs);
+void journalService();
+void journalFlush();
+JournalStats journalStats();
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "outputs.h"
+
+// --------------------------------------------------
+// SWR monitor
+//
+// Forward and reflected detector voltages from the coupler are sampled
+// by the ADC's DMA engine and handed over a frame at a time on a task
+// of their own (see halAdcStart), beside the relay task; loop() never
+// sees a sample. Detector readings are taken as proportional to RF
+// voltage, so power goes with their square and the reflection
+// coefficient is reflected / forward.
+//
+// Each detector is decimated by summing SWR_DECIMATE samples into one
+// point; everything after that is integer arithmetic on the sums, with
+// no division per point. A point counts only while the relays are
+// still (relaySequencerSettleUs() == 0) and forward is above
+// SWR_MIN_FWD, i.e. something is transmitting into a connected
+// antenna. SWR_TRIP_POINTS points in a row above the trip SWR post
+// "every output off" to the relay task as RELAY_SRC_SWR, once per
+// fault, and log EVENT_SWR; a one-sample spike cannot trip it. Under
+// the TX interlock the relays still wait for PTT release: they never
+// switch under power.
+//
+// Per antenna, a rolling average (single pole, 2^SWR_FILTER_SHIFT
+// points) of both detectors gives power and SWR for /stats, with the
+// peak and the time spent transmitting.
+// --------------------------------------------------
+
+const uint32_t SWR_SAMPLE_HZ      = 20000;   // both detectors together; the ESP32's continuous-mode floor
+const uint32_t SWR_DECIMATE       = 8;       // samples per detector per point: 1.25 kHz, 0.8 ms
+const uint32_t SWR_TRIP_POINTS    = 2;
+const uint32_t SWR_MIN_FWD        = SWR_DECIMATE * 160;    // a point's forward sum; ~0.15 % of full scale power
+const uint32_t SWR_FULL_SCALE     = SWR_DECIMATE * 4095;
+const uint8_t  SWR_FILTER_SHIFT   = 7;       // ~100 ms
+const uint16_t SWR_MAX            = 9999;    // x100; reflected >= forward
+const int      SWR_TASK_CORE      = 1;       // with the relay task, away from WiFi
+const int      SWR_TASK_PRIORITY  = 19;      // just below the relay task
+
+struct SwrConfig
+{
+    int8_t   fwdPin;         // ADC1 pins (32-39); -1 = no monitor
+    int8_t   reflPin;
+    uint16_t tripSwr;        // x100, 0 = never trip
+    uint16_t fullScaleW;     // forward power that reads full scale
+};
+
+struct SwrAntennaStats
+{
+    uint32_t txMs;           // transmitting into it, since boot
+    uint32_t fwdMw;          // rolling average, as of its last transmission
+    uint32_t reflMw;
+    uint16_t swr;            // x100, from the rolling averages
+    uint16_t peakSwr;        // highest rolling SWR since boot
+    uint32_t trips;
+};
+
+struct SwrStats
+{
+    bool     enabled;
+    int8_t   antenna;        // being measured: 0 = none, -1 = several outputs
+    bool     transmitting;   // last point above SWR_MIN_FWD
+    uint32_t frames;         // from the ADC, HAL_ADC_FRAME samples each
+    uint32_t points;
+    uint32_t skipped;        // points with the relays moving or all off
+    uint32_t trips;
+    uint32_t tripsRefused;   // relay queue full; retried on the next point
+    uint16_t lastTripSwr;    // x100, the point that tripped
+    int8_t   lastTripAntenna;
+    uint32_t maxFrameUs;     // handler time per frame
+    SwrAntennaStats antennas[OUTPUTS_MAX];
+};
+
+// After relayTaskBegin(); starts sampling. Once per boot.
+void swrMonitorBegin(const SwrConfig& cfg);
+// Trip SWR and scale take effect on the next frame.
+void swrMonitorSetLimits(uint16_t tripSwr, uint16_t fullScaleW);
+SwrStats swrMonitorStats();
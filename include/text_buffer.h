@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --------------------------------------------------
+// Fixed-buffer text
+//
+// printf-style appends into a caller's buffer, for responses that used to
+// be built up in a String. An append that does not fit writes nothing
+// and sets full(); what came before stays intact.
+//
+// textRenderItems() streams a body made of items (a JSON section, one
+// metric) through HttpServer::sendChunked(): each call writes whole items
+// from *cursor on while they fit, so every item is formatted from live
+// values when its turn comes and nothing is held between chunks. An item
+// must fit one chunk on its own.
+// --------------------------------------------------
+
+class TextBuffer
+{
+public:
+    TextBuffer(char* buf, size_t size) : buf_(buf), size_(size) { if (size) buf[0] = '\0'; }
+
+    TextBuffer& printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+    TextBuffer& add(const char* s);
+
+    const char* c_str() const { return buf_; }
+    size_t length() const { return len_; }
+    bool full() const { return full_; }
+    void truncate(size_t len);   // back to an earlier length(); clears full()
+
+private:
+    char*  buf_;
+    size_t size_;
+    size_t len_ = 0;
+    bool   full_ = false;
+};
+
+// Appends item index to out; false past the last one.
+typedef bool (*TextItemFn)(uint32_t index, TextBuffer& out);
+
+// A HttpServer::ChunkFiller body; *cursor is the next item.
+size_t textRenderItems(TextItemFn item, char* buf, size_t size, uint32_t* cursor);
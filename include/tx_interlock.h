@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+// --------------------------------------------------
+// TX interlock
+//
+// Keeps the relays from switching while the station transmits. The
+// radio's PTT (or TX-inhibit) line is wired to an input whose change
+// interrupt holds the relay sequencer a few microseconds after the edge,
+// wherever the firmware happens to be. Commands keep arriving and being
+// acknowledged while held; the sequencer only keeps the latest, and the
+// relay task applies it as one switch once PTT has been released for
+// TX_RELEASE_HOLD_US (the amplifier and the radio's own T/R relay drop
+// out in that time).
+//
+// The optional amplifier key output follows PTT, but only onto a settled
+// antenna: it rises in the interrupt if the relays have been still for a
+// dead time, otherwise from the relay task once they have, and never
+// while every output is off or a break waits to make. It drops in the
+// interrupt on release, before the hold starts.
+// --------------------------------------------------
+
+const uint32_t TX_RELEASE_HOLD_US = 20000;
+
+struct TxInterlockConfig
+{
+    int8_t pttPin;           // -1 = no interlock
+    bool   activeLow;        // PTT pulls the line to ground (internal pull-up on)
+    int8_t ampKeyPin;        // -1 = none; high keys the amplifier
+};
+
+struct TxInterlockStats
+{
+    bool     enabled;
+    bool     transmitting;   // PTT asserted
+    bool     held;           // relays held: transmitting or in the release hold
+    bool     keyed;
+    uint32_t transmissions;
+    uint32_t keyedLate;      // keys delayed until the relays settled
+    uint32_t inhibited;      // transmissions left unkeyed: no antenna connected
+    uint32_t lastKeyDelayUs; // PTT edge -> key
+    uint32_t maxKeyDelayUs;
+};
+
+// After relayTaskBegin(); picks up the level PTT has now. Once per boot.
+void txInterlockBegin(const TxInterlockConfig& cfg);
+void txInterlockService();           // relay task, after relaySequencerService()
+TxInterlockStats txInterlockStats();
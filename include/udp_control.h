@@ -0,0 +1,152 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --------------------------------------------------
+// UDP control protocol
+//
+// For logging software that wants a switch in a few milliseconds: no
+// connection, no text to parse, no broker. Datagrams are handled on
+// their own task on the protocol core as they arrive, posted straight
+// into the relay ring (RELAY_SRC_UDP) and acknowledged at once with the
+// accepted state, so a busy loop() never delays them.
+//
+// Little-endian, 12 bytes, then UDP_MAC_SIZE bytes of MAC when a key is
+// set (otherwise nothing):
+//   0  'A' 'S'
+//   2  u8   UDP_VERSION
+//   3  u8   op: UDP_OP_SELECT, UDP_OP_STATE
+//   4  u32  seq, increasing per client (ip and port)
+//   8  u32  outputs for SELECT, bit 0 = antenna 1; 0 = all off
+// The ack is 20 bytes, then the MAC:
+//   0  'A' 'S' UDP_VERSION op|0x80, seq as sent
+//   8  u8   status (UdpStatus)
+//   9  i8   antenna: 0 = off, -1 = several
+//  10  u8   output count
+//  11  u8   UDP_ACK_HELD | UDP_ACK_SUPERSEDED (SELECT), else 0
+//  12  u32  outputs: the accepted selection (SELECT) or the applied one
+//  16  u32  session: the client's, for the next request's MAC
+//
+// A SELECT the arbiter refuses (relay_task.h) gets UDP_LOCKED or
+// UDP_OUTRANKED with the applied state; an accepted one may be held
+// for the coalescing window, or replace a command held before it.
+//
+// A retry carries the same seq and is answered from the cached ack
+// without posting again; a seq older than the client's last one (a late
+// duplicate) is not applied and gets UDP_STALE with the current state.
+// Clients should start seq from a clock so a restart does not go back.
+//
+// MAC: the first UDP_MAC_SIZE bytes of HMAC-SHA256(key, ...). On an ack,
+// over its 20 bytes. On a request, over its 12 bytes and then the u32
+// session the switch gave this client (ip and port), or 0 before it has
+// one. Sessions are random, new for every client entry and every boot,
+// so a captured request verifies only for the entry it was made for, and
+// seq stops it being replayed there. After a reboot, an eviction or from
+// another port it fails the MAC. A SELECT signed with session 0 is not
+// applied: it gets UDP_SESSION and a new session, and the client sends
+// it again with a new seq. Datagrams that are malformed or fail the MAC
+// are dropped without an answer, so a client that gets no ack after its
+// retries starts over with session 0. A replayed session-0 request can
+// still reset a client's session (and cost it that round trip); it
+// cannot switch anything. Without a key there is no MAC and no session
+// check.
+// --------------------------------------------------
+
+const uint16_t UDP_CONTROL_PORT  = 4210;
+const uint8_t  UDP_VERSION       = 2;        // 2: sessions
+const size_t   UDP_REQUEST_SIZE  = 12;
+const size_t   UDP_ACK_SIZE      = 20;
+const size_t   UDP_MAC_SIZE      = 8;
+const size_t   UDP_KEY_MAX       = 64;       // one HMAC block
+const int      UDP_CLIENTS       = 8;        // session, seq and last ack, least recently seen replaced
+const int      UDP_TASK_CORE     = 0;        // with lwIP
+const int      UDP_TASK_PRIORITY = 15;       // above loop(), below lwIP (18) and WiFi (23)
+
+enum UdpOp : uint8_t { UDP_OP_SELECT = 1, UDP_OP_STATE = 2 };
+enum UdpStatus : uint8_t { UDP_OK, UDP_BAD_REQUEST, UDP_BUSY, UDP_STALE, UDP_LOCKED, UDP_OUTRANKED, UDP_SESSION };
+const uint8_t UDP_ACK_HELD       = 0x01;     // applied when the window ends, unless superseded
+const uint8_t UDP_ACK_SUPERSEDED = 0x02;     // replaced a held command
+
+struct UdpControlStats
+{
+    uint32_t received;
+    uint32_t selects;        // posted to the relay task
+    uint32_t queries;
+    uint32_t duplicates;     // answered from the cache
+    uint32_t stale;
+    uint32_t busy;           // relay ring full; the retry is posted again
+    uint32_t refused;        // locked or outranked
+    uint32_t invalid;        // malformed, unknown op, outputs out of range
+    uint32_t badMac;
+    uint32_t sessions;       // handed out: new clients, and requests signed without one
+    uint32_t lastAckUs;      // datagram read -> ack sent
+    uint32_t maxAckUs;
+};
+
+// Starts the receive task; once per boot. False if the port is taken.
+bool udpControlBegin(uint16_t port);
+
+// Any task; "" turns the MAC off.
+void udpControlSetKey(const char* key);
+
+UdpControlStats udpControlStats();
+
+// MAC over len bytes (a request's 12 and its session, or an ack's 20);
+// exposed for host tools and tests.
+void udpControlMac(const char* key, const uint8_t* data, size_t len, uint8_t mac[UDP_MAC_SIZE]);
+
+// --------------------------------------------------
+// State beacons
+//
+// For observers that only watch (loggers, panels, dashboards): rather
+// than each polling /state or holding an MQTT subscription, they join a
+// multicast group and the switch sends one datagram per state change and
+// a heartbeat while nothing changes, the same cost for one listener as
+// for fifty. Sent from loop() when it picks up a new relay snapshot, at
+// most one per UDP_BEACON_GAP_MS: changes inside the gap go out together
+// at its end, with the latest state. With UDP control on they go out
+// from its socket (and port); udpControlBegin() comes first.
+//
+// 24 bytes, then the MAC (as above, with the control key) when one is
+// set:
+//   0  'A' 'S' UDP_VERSION UDP_OP_BEACON
+//   4  u32  seq, 1 for the first beacon after boot; a gap is a loss
+//   8  i8   antenna: 0 = off, -1 = several
+//   9  u8   output count
+//  10  u8   UDP_BEACON_CHANGE | UDP_BEACON_LOCKED
+//  11  u8   source of the last change (RelaySource)
+//  12  u32  outputs, bit 0 = antenna 1
+//  16  u32  state version: changes applied since boot
+//  20  u32  uptime, s
+// --------------------------------------------------
+
+const uint32_t UDP_BEACON_GROUP       = 0x012AFFEF;   // 239.255.42.1, IPAddress byte order
+const uint16_t UDP_BEACON_PORT        = 4211;
+const uint16_t UDP_BEACON_HEARTBEAT_S = 10;
+const uint32_t UDP_BEACON_GAP_MS      = 20;
+const size_t   UDP_BEACON_SIZE        = 24;
+const uint8_t  UDP_OP_BEACON          = 0x40;
+const uint8_t  UDP_BEACON_CHANGE      = 0x01;     // else a heartbeat
+const uint8_t  UDP_BEACON_LOCKED      = 0x02;     // manual lock on (relay_task.h)
+
+struct UdpBeaconStats
+{
+    uint32_t seq;            // of the last beacon sent
+    uint32_t changes;        // beacons sent for a change
+    uint32_t heartbeats;
+    uint32_t failed;         // the stack refused the datagram (no WiFi, no buffer)
+    uint32_t coalesced;      // state versions that went out in a later beacon
+};
+
+// Once per boot, from setup(); seq starts again from 1.
+void udpBeaconBegin(uint32_t group, uint16_t port, uint16_t heartbeatS);
+
+// loop() only. port 0 stops beacons; heartbeatS 0 sends changes only. A
+// new group or port starts with a beacon of the current state.
+void udpBeaconConfigure(uint32_t group, uint16_t port, uint16_t heartbeatS);
+
+// loop(): a beacon for a new relay snapshot or a heartbeat due.
+void udpBeaconService();
+
+UdpBeaconStats udpBeaconStats();
@@ -0,0 +1,267 @@
+// Generated by tools/embed_web.py from web/ -- edit the sources there.
+#pragma once
+
+#include <Arduino.h>
+
+// web/index.html
+const uint32_t WEB_INDEX_RAW_LEN = 4440;
+const uint32_t WEB_INDEX_GZ_LEN = 1865;
+const char WEB_INDEX_ETAG[] = "\"b5db23a2ea86117a\"";
+const uint8_t WEB_INDEX_GZ[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xad, 0x58, 0x6d, 0x6f, 0xdb, 0x38,
+    0x12, 0xfe, 0xee, 0x5f, 0xc1, 0xa8, 0xd8, 0xb3, 0x84, 0xc4, 0xf2, 0x4b, 0x9a, 0x76, 0x21, 0xcb,
+    0x2e, 0x72, 0xd9, 0x14, 0xed, 0x21, 0xdb, 0x14, 0xeb, 0xdc, 0x01, 0x87, 0xc5, 0x1e, 0x40, 0x4b,
+    0x94, 0xcd, 0x84, 0x26, 0x75, 0x24, 0x1d, 0xd7, 0xd7, 0xed, 0x7f, 0xdf, 0x19, 0x92, 0x92, 0x95,
+    0x34, 0xe9, 0x76, 0x81, 0xeb, 0x87, 0x5a, 0x22, 0x87, 0xf3, 0xf2, 0xcc, 0xcc, 0xc3, 0x51, 0xf2,
+    0xa3, 0x9f, 0xae, 0x2f, 0x6e, 0xfe, 0xfd, 0xf1, 0x92, 0xac, 0xed, 0x46, 0xcc, 0x7b, 0x79, 0xf3,
+    0xc3, 0x68, 0x09, 0x3f, 0x96, 0x5b, 0xc1, 0xe6, 0x0b, 0x4b, 0x2d, 0x57, 0xf2, 0x23, 0x17, 0xca,
+    0x92, 0x73, 0x69, 0x99, 0x94, 0x94, 0x2c, 0x76, 0xdc, 0x16, 0xeb, 0x7c, 0xe8, 0x45, 0x7a, 0xf9,
+    0x86, 0x59, 0x4a, 0x24, 0xdd, 0xb0, 0x59, 0x74, 0xcf, 0xd9, 0xae, 0x56, 0xda, 0x46, 0xa4, 0x50,
+    0x28, 0x6d, 0x67, 0xd1, 0x8e, 0x97, 0x76, 0x3d, 0x2b, 0xd9, 0x3d, 0x2f, 0xd8, 0xc0, 0xbd, 0x9c,
+    0x10, 0x2e, 0xb9, 0xe5, 0x54, 0x0c, 0x4c, 0x41, 0x05, 0x9b, 0x8d, 0x23, 0x50, 0x62, 0xec, 0x1e,
+    0x95, 0x2d, 0x55, 0xb9, 0x27, 0x9f, 0x7b, 0x84, 0x54, 0x70, 0x7e, 0x50, 0xd1, 0x0d, 0x17, 0xfb,
+    0x8c, 0x9c, 0x6b, 0x90, 0x3e, 0x31, 0x54, 0x9a, 0x81, 0x61, 0x9a, 0x57, 0x53, 0x10, 0x58, 0xd2,
+    0xe2, 0x6e, 0xa5, 0xd5, 0x56, 0x96, 0xd9, 0x8b, 0xf1, 0x78, 0x8c, 0x4b, 0x85, 0x12, 0x4a, 0x67,
+    0x2f, 0x18, 0x63, 0xf8, 0x66, 0xd9, 0x27, 0x3b, 0xa0, 0x82, 0xaf, 0x64, 0x56, 0x80, 0x27, 0x4c,
+    0xe3, 0x62, 0x4d, 0xcb, 0x92, 0xcb, 0x55, 0x36, 0x19, 0xd5, 0x9f, 0xa6, 0xbd, 0x2f, 0xbd, 0xf5,
+    0x98, 0x7c, 0x26, 0x1b, 0xaa, 0x57, 0x5c, 0x0e, 0x96, 0xca, 0x5a, 0xb5, 0xc9, 0xce, 0x60, 0x87,
+    0x7c, 0xe9, 0x51, 0xd8, 0x08, 0x0a, 0x5f, 0xbd, 0x5c, 0x9e, 0x55, 0xaf, 0xa6, 0x5e, 0x63, 0xc9,
+    0x0a, 0xa5, 0x1d, 0x2a, 0x99, 0x54, 0x92, 0xa1, 0x68, 0x6a, 0x00, 0xa6, 0xad, 0x39, 0xf8, 0x6d,
+    0xf8, 0xff, 0x58, 0x30, 0x41, 0x82, 0xf6, 0x6c, 0x7c, 0xe6, 0x5f, 0x1b, 0x0f, 0xc6, 0xb0, 0x4d,
+    0xc6, 0x3f, 0xfa, 0xc5, 0xa5, 0xd2, 0x25, 0xd3, 0x03, 0x4d, 0x4b, 0xbe, 0x35, 0x6e, 0xeb, 0x71,
+    0x88, 0x93, 0xc9, 0x04, 0x97, 0x4a, 0x6e, 0x6a, 0x41, 0xf7, 0x19, 0x97, 0x82, 0x4b, 0x36, 0x58,
+    0x0a, 0x55, 0xdc, 0x61, 0x1c, 0xcb, 0x2d, 0xf8, 0x2e, 0x9d, 0x07, 0xad, 0x81, 0x57, 0x0f, 0xed,
+    0x07, 0xa5, 0x07, 0x07, 0x1b, 0xe3, 0x2e, 0x29, 0xd9, 0xa4, 0xf1, 0xd7, 0xfb, 0xe2, 0x83, 0x7b,
+    0xd6, 0xb5, 0x62, 0xab, 0x0d, 0x40, 0x53, 0x2b, 0xde, 0x20, 0xdb, 0x75, 0xf6, 0xf4, 0xf4, 0xf4,
+    0x90, 0x8f, 0xdd, 0x9a, 0x5b, 0x9f, 0x10, 0x0d, 0x09, 0xe4, 0x0e, 0xb9, 0x51, 0x3a, 0x31, 0x07,
+    0xb7, 0xb3, 0xb5, 0xba, 0x67, 0x1a, 0xf0, 0xee, 0xea, 0x78, 0xf9, 0xf2, 0x25, 0x62, 0xdb, 0x4b,
+    0x69, 0x61, 0xf9, 0x3d, 0x73, 0xa1, 0x75, 0xf7, 0x47, 0xa3, 0xe2, 0xc7, 0xb3, 0x53, 0x72, 0xc4,
+    0x37, 0x58, 0x70, 0x54, 0xda, 0x83, 0xc5, 0xa5, 0xa0, 0x88, 0x4a, 0x88, 0x75, 0xc7, 0xf8, 0x6a,
+    0x6d, 0xb3, 0xa5, 0x12, 0xa5, 0x8f, 0xe7, 0xd3, 0xc0, 0xac, 0x69, 0xa9, 0x76, 0xd9, 0x88, 0x8c,
+    0x08, 0x46, 0x4d, 0x40, 0x59, 0x55, 0x8d, 0x46, 0x9d, 0xe8, 0x27, 0xb0, 0x6a, 0x94, 0xe0, 0x25,
+    0x79, 0x41, 0xab, 0xaa, 0xa2, 0x15, 0x7a, 0x9b, 0xaa, 0xaa, 0x3a, 0x7f, 0xda, 0x9b, 0xaa, 0x3a,
+    0x9b, 0x9c, 0x4d, 0xfe, 0x4f, 0xde, 0xa0, 0x2f, 0xcf, 0x79, 0x03, 0xbe, 0xc0, 0x3f, 0xe7, 0x4d,
+    0xa5, 0x94, 0x45, 0xd8, 0xda, 0x1c, 0x0f, 0xac, 0xaa, 0xdb, 0xb2, 0xeb, 0xe4, 0x79, 0x12, 0x72,
+    0xe6, 0xab, 0xf9, 0xf5, 0xeb, 0xd7, 0xee, 0x38, 0x14, 0xd0, 0x9d, 0x56, 0xbb, 0xc7, 0xe7, 0xc7,
+    0xa1, 0x33, 0xf2, 0x61, 0x68, 0xc9, 0xdc, 0x14, 0x9a, 0xd7, 0x76, 0xde, 0x13, 0xcc, 0x92, 0x5a,
+    0x09, 0x71, 0xc3, 0x37, 0x60, 0x76, 0x46, 0xe4, 0x56, 0x88, 0xa9, 0x5b, 0x2d, 0x00, 0x04, 0x0b,
+    0x2b, 0x23, 0xff, 0xaa, 0xb6, 0xb6, 0xde, 0x5a, 0xe3, 0x17, 0x7a, 0xc3, 0x21, 0xb9, 0x96, 0x8c,
+    0x84, 0x0a, 0xad, 0xe1, 0xa8, 0xdf, 0x3f, 0x81, 0x25, 0x2e, 0x2c, 0xa9, 0xb4, 0xda, 0x10, 0xbb,
+    0x66, 0x41, 0x0b, 0x97, 0xee, 0x05, 0x5b, 0x8a, 0xa5, 0xbd, 0x6a, 0x2b, 0x0b, 0xac, 0x18, 0x27,
+    0x5b, 0xc6, 0x32, 0xf9, 0xec, 0x02, 0x91, 0xc6, 0x22, 0x74, 0x60, 0xa1, 0x54, 0xc5, 0x76, 0x03,
+    0xed, 0x9d, 0xae, 0x98, 0xbd, 0x14, 0x0c, 0x1f, 0xff, 0xbe, 0x7f, 0x5f, 0xc6, 0x91, 0xb7, 0x67,
+    0xa2, 0x24, 0xc0, 0x9c, 0x72, 0x29, 0x99, 0x7e, 0x77, 0xf3, 0xf3, 0x15, 0x9c, 0x8a, 0x22, 0x0f,
+    0x91, 0x8e, 0xd1, 0x5f, 0x3e, 0x1b, 0x4f, 0x79, 0x3e, 0x93, 0x53, 0x7e, 0x7c, 0xec, 0x0c, 0xb4,
+    0x26, 0xba, 0x06, 0x0a, 0xcd, 0xc0, 0xa5, 0x60, 0xa3, 0xd1, 0xef, 0xd5, 0x83, 0x81, 0x14, 0x92,
+    0x03, 0x7a, 0x97, 0x56, 0x46, 0xc7, 0xbc, 0x59, 0x43, 0xc2, 0xb8, 0xf0, 0x44, 0x88, 0x9b, 0x0d,
+    0x81, 0x76, 0x24, 0x94, 0x2c, 0x04, 0x2f, 0xee, 0x60, 0x37, 0x4e, 0xc8, 0x6c, 0x4e, 0x6a, 0x78,
+    0x89, 0x79, 0xa3, 0x14, 0xbc, 0xa6, 0x75, 0xcd, 0x64, 0x79, 0xb1, 0xc6, 0xe8, 0x97, 0xcf, 0xac,
+    0x3f, 0xeb, 0xa2, 0x8e, 0x12, 0x77, 0xe4, 0x8b, 0x03, 0xcd, 0xe7, 0x48, 0x62, 0x72, 0x0f, 0xb8,
+    0x6a, 0xd0, 0xc2, 0x74, 0x7c, 0xeb, 0xe2, 0xe6, 0x55, 0x7c, 0x9b, 0x7a, 0xc1, 0xa3, 0xd9, 0xcc,
+    0x1f, 0x49, 0x02, 0xf4, 0x61, 0xc3, 0xe9, 0x3b, 0x24, 0xf8, 0x36, 0x0d, 0xcf, 0xd3, 0x36, 0x2f,
+    0x81, 0x0c, 0xbf, 0x91, 0x1a, 0x2f, 0xe1, 0xa1, 0xf3, 0x67, 0xc0, 0x91, 0x19, 0xf9, 0xf5, 0xb7,
+    0x27, 0x92, 0xe2, 0x8c, 0x7e, 0x95, 0x98, 0xc0, 0x09, 0x80, 0x5a, 0xe3, 0xca, 0x7c, 0x4e, 0x62,
+    0x3e, 0x18, 0x27, 0x09, 0xf9, 0x1b, 0x19, 0x7b, 0x98, 0x9e, 0x2f, 0x0d, 0x97, 0xa4, 0x24, 0x2d,
+    0x04, 0x35, 0xe6, 0x8a, 0x1b, 0x9b, 0x5a, 0xb5, 0x5a, 0x09, 0x16, 0x47, 0x5e, 0x6f, 0x74, 0x42,
+    0x8e, 0x8e, 0xfc, 0x63, 0x40, 0x1c, 0x80, 0x09, 0xef, 0xe0, 0x6a, 0x5a, 0x6f, 0xcd, 0x3a, 0x24,
+    0x09, 0x91, 0xfd, 0x96, 0x9d, 0x51, 0xf4, 0x94, 0x99, 0x96, 0x47, 0xc0, 0x12, 0xe8, 0x13, 0x4c,
+    0xae, 0xec, 0x9a, 0xcc, 0x00, 0xf2, 0x91, 0xd3, 0x0a, 0xe6, 0x1e, 0x2f, 0xfb, 0xe8, 0x3d, 0x72,
+    0xbe, 0x94, 0x6f, 0xa0, 0xb8, 0xb0, 0xaa, 0x16, 0x6e, 0x2d, 0x23, 0xd7, 0x6f, 0xdf, 0x46, 0xd3,
+    0xae, 0x94, 0xeb, 0xdf, 0xf4, 0xc0, 0x52, 0x28, 0x0c, 0xd4, 0x8c, 0xdc, 0xe2, 0x04, 0xbf, 0x10,
+    0x26, 0x8c, 0xa7, 0xb2, 0x6f, 0x6b, 0x3e, 0xff, 0x70, 0x73, 0xf9, 0xe1, 0xc3, 0x39, 0x89, 0xc8,
+    0x31, 0xba, 0x7b, 0x0b, 0xa4, 0x1f, 0xe3, 0x73, 0x94, 0xe0, 0x7f, 0xe4, 0xfc, 0xe2, 0xe6, 0xfd,
+    0xbf, 0x2e, 0xbf, 0xc3, 0xf6, 0x68, 0x84, 0xd6, 0xbd, 0x6d, 0x2c, 0x42, 0x6a, 0xf6, 0xb2, 0x20,
+    0x6d, 0x29, 0x1a, 0x28, 0xc5, 0xf8, 0xbf, 0x5b, 0xa6, 0xf7, 0x2e, 0x5a, 0xab, 0xf7, 0xa4, 0x9b,
+    0x73, 0xa4, 0x1c, 0xba, 0xa3, 0x1c, 0x18, 0x83, 0xc1, 0xfc, 0x11, 0xf7, 0x87, 0x86, 0xd9, 0x37,
+    0xfd, 0x63, 0x7f, 0x62, 0xda, 0x91, 0xbc, 0x6d, 0x25, 0x75, 0x7a, 0x6b, 0x94, 0x8c, 0x0f, 0x59,
+    0xbc, 0x4d, 0x99, 0xd6, 0x4a, 0x27, 0x7f, 0x5e, 0x9c, 0x0f, 0xa1, 0xf8, 0x85, 0x55, 0x5b, 0xc3,
+    0xca, 0xcc, 0x61, 0x10, 0x94, 0xc0, 0x13, 0xe8, 0x5b, 0xee, 0xc9, 0x1b, 0x58, 0x8d, 0xfd, 0x06,
+    0xbc, 0x21, 0x2e, 0x11, 0x01, 0xc9, 0x86, 0x1b, 0x1c, 0xca, 0x6d, 0x9f, 0x79, 0xe4, 0x0b, 0x8a,
+    0x21, 0x40, 0x39, 0x1d, 0x22, 0x54, 0x00, 0x98, 0xd3, 0x1b, 0xb3, 0xa4, 0x85, 0x08, 0xc8, 0xf3,
+    0x0a, 0xae, 0xf8, 0x0c, 0x70, 0x17, 0x7b, 0x20, 0x46, 0x6e, 0xe0, 0x7e, 0x5f, 0x31, 0x42, 0x01,
+    0x52, 0xa4, 0x49, 0x20, 0x4f, 0x68, 0xd6, 0x9a, 0x4a, 0x26, 0x40, 0x27, 0x60, 0xe8, 0x66, 0x33,
+    0x02, 0x3d, 0xc3, 0x05, 0xd8, 0x14, 0x8c, 0x82, 0xd7, 0xe9, 0xd7, 0x48, 0x5b, 0xd4, 0x0a, 0x45,
+    0xf6, 0x9d, 0x48, 0xe3, 0x98, 0xd1, 0xc7, 0x78, 0xb1, 0x51, 0xa1, 0x1e, 0x21, 0xa3, 0xac, 0x82,
+    0x01, 0xa4, 0x84, 0xd8, 0xfb, 0x7d, 0x08, 0xb6, 0xff, 0x46, 0xc9, 0x59, 0x23, 0xf1, 0x86, 0x8c,
+    0x61, 0x69, 0x94, 0x24, 0xc9, 0x9f, 0x34, 0x22, 0xaa, 0xc5, 0x06, 0x59, 0xb3, 0xe2, 0x8e, 0x61,
+    0x8d, 0xc4, 0x0f, 0xd3, 0x96, 0xa4, 0x28, 0xc1, 0xca, 0xbf, 0x8c, 0xd9, 0x85, 0xda, 0x2c, 0xc1,
+    0xbd, 0x8c, 0x30, 0x0a, 0x68, 0x84, 0xab, 0xc7, 0x77, 0x9f, 0x21, 0x1c, 0xe8, 0xc2, 0xd3, 0x06,
+    0x89, 0x0b, 0x2f, 0xa8, 0xcd, 0x09, 0xa9, 0xd7, 0x88, 0x15, 0xa1, 0x5a, 0xd3, 0xbd, 0x49, 0x3a,
+    0x57, 0x8f, 0xe3, 0x64, 0xd9, 0x10, 0xe4, 0xb3, 0xc1, 0x04, 0x55, 0x87, 0x78, 0x12, 0x5f, 0xd1,
+    0xfd, 0x0d, 0x35, 0x77, 0xb3, 0xfe, 0x71, 0x4b, 0x55, 0xff, 0x21, 0xf1, 0x98, 0xe4, 0x39, 0x89,
+    0x25, 0xf2, 0x95, 0x07, 0xc9, 0xd5, 0x88, 0x17, 0x87, 0xe1, 0x01, 0xa4, 0x65, 0x32, 0x7d, 0xa2,
+    0x45, 0xb6, 0x75, 0x09, 0x04, 0x1f, 0x7f, 0x6f, 0x7f, 0xe0, 0x1d, 0xda, 0x0f, 0x49, 0x08, 0x05,
+    0xf8, 0x08, 0xe0, 0xbf, 0x8c, 0xec, 0x47, 0x18, 0x00, 0x88, 0xd7, 0xec, 0x6b, 0x12, 0xc6, 0x3b,
+    0xc1, 0x5c, 0x2d, 0x22, 0x2d, 0x92, 0x62, 0x4d, 0x25, 0x16, 0x23, 0x14, 0x2a, 0x0c, 0x35, 0xb2,
+    0x03, 0x23, 0x9c, 0xd1, 0x16, 0x8f, 0xc3, 0x70, 0x1a, 0x37, 0x68, 0x1e, 0xb5, 0x03, 0x45, 0xf2,
+    0x60, 0xb6, 0x80, 0x0a, 0x7d, 0x8f, 0x93, 0xe5, 0x3d, 0x15, 0xb1, 0x0f, 0xfa, 0x84, 0x8c, 0xcf,
+    0x46, 0xa3, 0xe4, 0xe1, 0xed, 0x65, 0x60, 0x62, 0x79, 0xac, 0xf2, 0xa0, 0x11, 0x06, 0x78, 0x68,
+    0x00, 0xdd, 0x2a, 0x3a, 0xec, 0x4c, 0xbf, 0x1e, 0x64, 0x7c, 0x84, 0xad, 0x66, 0xc0, 0x40, 0xb2,
+    0xc2, 0x5e, 0xde, 0x43, 0x7e, 0xcd, 0xc1, 0xdd, 0x1d, 0x97, 0x10, 0x56, 0xea, 0x96, 0x17, 0x6a,
+    0xab, 0x0b, 0x06, 0x56, 0x1e, 0x46, 0x36, 0x05, 0xa8, 0xed, 0x56, 0xcb, 0x69, 0xb8, 0x76, 0x31,
+    0x37, 0x0c, 0xef, 0x43, 0xc9, 0x76, 0xa4, 0x73, 0x10, 0x12, 0xc4, 0x9c, 0x76, 0x9f, 0x21, 0x66,
+    0x60, 0x18, 0x50, 0x70, 0xa9, 0x63, 0xf4, 0x87, 0xb0, 0xda, 0xad, 0x0d, 0x33, 0x06, 0x3b, 0x1f,
+    0x9a, 0x84, 0xb9, 0x51, 0x21, 0x24, 0xf4, 0x1f, 0x8b, 0xeb, 0x0f, 0x69, 0x4d, 0xb5, 0x61, 0x31,
+    0x4b, 0x01, 0x28, 0x9a, 0x1c, 0xd4, 0x79, 0x9a, 0x6a, 0x66, 0x8b, 0x96, 0xe8, 0xbb, 0xce, 0x36,
+    0xc4, 0x08, 0xf2, 0x30, 0x3c, 0x94, 0xfb, 0x85, 0xcb, 0x2c, 0xf6, 0x78, 0xc7, 0xd5, 0xf4, 0xe2,
+    0xea, 0x7a, 0x71, 0xf9, 0x13, 0x16, 0xb4, 0x45, 0xd0, 0xa0, 0x92, 0xe3, 0x07, 0x00, 0x41, 0x72,
+    0xf0, 0x5a, 0xf1, 0x95, 0x12, 0xa6, 0xc7, 0x30, 0x35, 0xe6, 0xc3, 0xf0, 0x45, 0xe9, 0x3e, 0xed,
+    0xa0, 0x64, 0x14, 0x2d, 0x67, 0x51, 0x53, 0xc8, 0xd3, 0x96, 0x8b, 0xe0, 0xf1, 0x11, 0xe6, 0xf0,
+    0x59, 0x08, 0x9f, 0xa3, 0xe3, 0x6f, 0x7f, 0x84, 0xc2, 0x7e, 0x2f, 0x2f, 0xf9, 0x3d, 0xe1, 0xa0,
+    0x35, 0x70, 0x37, 0x71, 0x37, 0x6e, 0xfb, 0x3a, 0xbf, 0x02, 0x93, 0x10, 0x6d, 0x9a, 0xa6, 0xf9,
+    0x10, 0x44, 0x51, 0xad, 0xfb, 0x21, 0xa4, 0x3d, 0xd9, 0x4c, 0x8b, 0xf3, 0x20, 0x01, 0x5b, 0x81,
+    0x35, 0xdc, 0x2e, 0x5e, 0xe4, 0x24, 0xcc, 0x6a, 0xa0, 0xb7, 0xed, 0xd3, 0x51, 0x1f, 0xbc, 0x3c,
+    0xbf, 0xba, 0xc2, 0xcb, 0x37, 0x1f, 0xfa, 0x13, 0xf3, 0x7c, 0xa9, 0x9d, 0x02, 0x41, 0x97, 0x4c,
+    0xcc, 0x73, 0x2e, 0x91, 0x69, 0xec, 0xbe, 0x86, 0xef, 0x63, 0xc7, 0x0c, 0x30, 0xbe, 0x45, 0x4e,
+    0x6d, 0xc3, 0x18, 0xf3, 0x86, 0xaf, 0x80, 0xd6, 0x5d, 0x74, 0x26, 0x1f, 0xfa, 0xc3, 0xdf, 0xa5,
+    0xc6, 0xb1, 0x28, 0x7a, 0x07, 0xad, 0xb7, 0x62, 0xe8, 0x9e, 0x47, 0x14, 0x6f, 0x8b, 0x96, 0x8b,
+    0xc0, 0x08, 0x2e, 0x02, 0x09, 0xc2, 0xb0, 0x2f, 0xb7, 0x54, 0xb4, 0x26, 0xba, 0x98, 0x34, 0xc8,
+    0x85, 0x6f, 0x83, 0xc8, 0x39, 0x40, 0xc9, 0x5a, 0xb3, 0x6a, 0x16, 0xe1, 0x7d, 0x6b, 0x01, 0x47,
+    0x40, 0x69, 0x11, 0x9e, 0xf2, 0x21, 0x9d, 0x93, 0xdf, 0x1f, 0x08, 0xf9, 0xcc, 0x46, 0xf3, 0xb7,
+    0x5c, 0x6f, 0x76, 0x54, 0x33, 0xf2, 0x4f, 0xb7, 0x80, 0x92, 0x4f, 0x9a, 0xf2, 0x5f, 0x31, 0xce,
+    0xd2, 0x83, 0x44, 0x5f, 0x2e, 0x3e, 0x9e, 0x4e, 0xda, 0x74, 0xe3, 0x14, 0xad, 0xa1, 0x68, 0x99,
+    0x06, 0x74, 0x87, 0x28, 0xfc, 0x4e, 0x19, 0x9b, 0x91, 0xdc, 0xc0, 0xdd, 0xe7, 0x50, 0x58, 0xc3,
+    0x7b, 0x34, 0xff, 0xe1, 0xdd, 0xf5, 0xe2, 0xe6, 0x07, 0xa8, 0x3e, 0x58, 0xee, 0xd8, 0x6b, 0x8a,
+    0xf1, 0x59, 0xf2, 0x76, 0xa7, 0x93, 0x47, 0x03, 0x7b, 0x68, 0x76, 0xc0, 0xd7, 0xf9, 0x95, 0xa2,
+    0x10, 0xfe, 0x9d, 0x63, 0xda, 0x29, 0x6f, 0x78, 0xc4, 0xc2, 0x76, 0x75, 0xee, 0xfe, 0x80, 0xf2,
+    0x07, 0x16, 0x94, 0x19, 0xd0, 0x58, 0x11, 0x00, 0x00,
+};
+
+// web/update.html
+const uint32_t WEB_UPDATE_RAW_LEN = 1199;
+const uint32_t WEB_UPDATE_GZ_LEN = 737;
+const char WEB_UPDATE_ETAG[] = "\"9904e152093a1b88\"";
+const uint8_t WEB_UPDATE_GZ[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x75, 0x54, 0x5d, 0x8f, 0xd3, 0x3a,
+    0x10, 0x7d, 0xcf, 0xaf, 0x18, 0x84, 0xc0, 0xad, 0xd8, 0xa6, 0x1f, 0xc0, 0x15, 0xdb, 0x26, 0x45,
+    0x0b, 0x17, 0xc4, 0x3e, 0x2d, 0xba, 0xec, 0x3e, 0x5c, 0x21, 0x1e, 0xa6, 0xf1, 0xa4, 0xb1, 0xd6,
+    0xb1, 0x2d, 0xdb, 0xe9, 0xc7, 0xad, 0xfa, 0xdf, 0x19, 0x27, 0x05, 0x5d, 0x81, 0x78, 0x69, 0xe3,
+    0xc9, 0x9c, 0x33, 0x33, 0xe7, 0x8c, 0x53, 0x3c, 0xf9, 0xfb, 0xee, 0xfd, 0xfd, 0xbf, 0x9f, 0x3f,
+    0x40, 0x13, 0x5b, 0xbd, 0x2e, 0x2e, 0xbf, 0x84, 0x72, 0x5d, 0x44, 0x15, 0x35, 0xad, 0x3f, 0x2a,
+    0xdf, 0xee, 0xd1, 0x13, 0x3c, 0x38, 0x89, 0x91, 0x8a, 0xe9, 0x10, 0xce, 0x8a, 0x96, 0x22, 0x82,
+    0xc1, 0x96, 0x4a, 0xb1, 0x53, 0xb4, 0x77, 0xd6, 0x47, 0x01, 0x95, 0x35, 0x91, 0x4c, 0x2c, 0xc5,
+    0x5e, 0xc9, 0xd8, 0x94, 0x92, 0x76, 0xaa, 0xa2, 0x49, 0x7f, 0xb8, 0x52, 0x46, 0x45, 0x85, 0x7a,
+    0x12, 0x2a, 0xd4, 0x54, 0xce, 0x05, 0x73, 0x84, 0x78, 0x64, 0xae, 0x8d, 0x95, 0xc7, 0x53, 0xcd,
+    0xc8, 0x49, 0x8d, 0xad, 0xd2, 0xc7, 0xe5, 0x8d, 0xe7, 0xbc, 0xd5, 0x06, 0xab, 0xc7, 0xad, 0xb7,
+    0x9d, 0x91, 0xcb, 0xa7, 0xf3, 0xf9, 0x7c, 0x55, 0x59, 0x6d, 0xfd, 0xf2, 0x29, 0x11, 0xad, 0x1c,
+    0x4a, 0xa9, 0xcc, 0x76, 0xb9, 0x98, 0xb9, 0xc3, 0x39, 0xcb, 0x37, 0xf6, 0x70, 0xfa, 0x7f, 0xf6,
+    0x62, 0xb1, 0xf8, 0x99, 0x32, 0x7f, 0xed, 0x0e, 0xab, 0x8d, 0xf5, 0x92, 0xfc, 0xc4, 0xa3, 0x54,
+    0x5d, 0x58, 0xce, 0x19, 0xb5, 0x6a, 0xf1, 0x30, 0xf4, 0xb5, 0x7c, 0xf5, 0x66, 0x38, 0xfb, 0xad,
+    0x32, 0xcb, 0x19, 0x60, 0x17, 0xed, 0x39, 0x53, 0xc6, 0x75, 0xf1, 0x34, 0x04, 0x27, 0xd1, 0xba,
+    0x1e, 0x74, 0xee, 0xa3, 0x5f, 0xe3, 0xd1, 0x51, 0x19, 0xe9, 0x10, 0xbf, 0x9d, 0x06, 0x86, 0xf9,
+    0x6c, 0xf6, 0x8c, 0x6b, 0x1c, 0x26, 0x41, 0xfd, 0x97, 0x6a, 0x5e, 0xca, 0x71, 0xe4, 0x9c, 0x85,
+    0x16, 0xb5, 0x3e, 0x5d, 0x7a, 0xbf, 0xbe, 0xbe, 0x3e, 0x17, 0xd3, 0x61, 0xea, 0x62, 0x3a, 0xc8,
+    0x9c, 0xa6, 0x67, 0x29, 0x9a, 0xc5, 0xef, 0x52, 0x73, 0x2c, 0x2b, 0xa4, 0xda, 0x41, 0xa5, 0x31,
+    0x84, 0x52, 0x30, 0x61, 0x52, 0xad, 0xb6, 0xbe, 0x05, 0x25, 0x4b, 0x51, 0x0b, 0x60, 0x17, 0x1a,
+    0xcb, 0x8f, 0x9f, 0xef, 0xbe, 0xdc, 0x0b, 0xc0, 0x2a, 0x2a, 0x6b, 0x4a, 0x31, 0xed, 0x7a, 0x06,
+    0x01, 0x64, 0xaa, 0xbe, 0x5b, 0xd1, 0x76, 0x3a, 0x2a, 0x87, 0x3e, 0x4e, 0x13, 0x7a, 0xc2, 0x6f,
+    0x31, 0x51, 0xf5, 0x03, 0xc1, 0x90, 0x52, 0x2b, 0xcd, 0x88, 0xc1, 0xd1, 0xfa, 0xd2, 0x8a, 0x18,
+    0xea, 0xa4, 0x37, 0xdc, 0xa9, 0xff, 0x05, 0x91, 0x34, 0x18, 0x32, 0x42, 0x83, 0x02, 0x9c, 0xc6,
+    0x8a, 0x1a, 0xab, 0x79, 0xf6, 0x52, 0x7c, 0xf9, 0x74, 0x33, 0x59, 0xbc, 0xfe, 0x0b, 0x6c, 0x0d,
+    0xb1, 0x21, 0x48, 0x14, 0x30, 0xb2, 0x2e, 0xf5, 0x87, 0x7a, 0xfc, 0x83, 0xad, 0x57, 0x67, 0x7d,
+    0xcf, 0x09, 0x2c, 0x1d, 0x81, 0x0a, 0x50, 0x35, 0x54, 0x3d, 0x92, 0x04, 0xdc, 0xa2, 0x32, 0x21,
+    0xf6, 0xe0, 0x61, 0x1a, 0x48, 0xed, 0xab, 0x44, 0x00, 0x1b, 0xe2, 0x29, 0x08, 0xd0, 0x1c, 0x63,
+    0xc3, 0x82, 0x33, 0x2e, 0x23, 0x8f, 0x81, 0x64, 0x0e, 0x37, 0x60, 0x68, 0x0f, 0xaa, 0xc5, 0x6d,
+    0x4f, 0xf7, 0x48, 0x2e, 0x82, 0x35, 0x15, 0x1f, 0x22, 0x34, 0x18, 0x18, 0x4a, 0x86, 0x03, 0x5a,
+    0x19, 0x6e, 0xca, 0x7a, 0x78, 0x39, 0x83, 0x70, 0x05, 0x96, 0xcb, 0xf8, 0xbd, 0x0a, 0x94, 0xea,
+    0x65, 0xce, 0xf3, 0xde, 0xda, 0x2e, 0x70, 0x1e, 0xf1, 0x4a, 0xb7, 0xc4, 0x30, 0x5e, 0xaf, 0x9c,
+    0xad, 0xeb, 0xfb, 0xfd, 0x5d, 0x89, 0xd0, 0x6d, 0x5a, 0xc5, 0x5a, 0xec, 0x50, 0x77, 0x7c, 0x7c,
+    0x70, 0xda, 0xa2, 0x84, 0xe7, 0xf0, 0x91, 0x8d, 0x6b, 0x92, 0xd0, 0xbd, 0xec, 0xec, 0x39, 0xbb,
+    0xb9, 0x2e, 0xdc, 0xba, 0x40, 0x68, 0x3c, 0xd5, 0xec, 0x94, 0x58, 0xbf, 0x63, 0x6a, 0x88, 0x16,
+    0xc2, 0x5e, 0xc5, 0xaa, 0x29, 0xa6, 0xc8, 0x69, 0x2e, 0x69, 0x53, 0x79, 0xe5, 0xe2, 0x3a, 0x93,
+    0xb6, 0xea, 0x5a, 0xbe, 0x54, 0xf9, 0x96, 0xe2, 0x07, 0x4d, 0xe9, 0xf1, 0xdd, 0xf1, 0x56, 0x8e,
+    0xd8, 0xfe, 0x71, 0x6e, 0xcd, 0x50, 0xba, 0xac, 0x3b, 0xd3, 0x9b, 0x3f, 0x1a, 0x9f, 0xb2, 0x1d,
+    0x7a, 0xa8, 0xcb, 0x3f, 0xe3, 0x92, 0x9d, 0xe3, 0x3c, 0xfd, 0x85, 0xaf, 0xb3, 0x6f, 0x57, 0xe1,
+    0xcf, 0xa9, 0xc9, 0xd7, 0x71, 0xde, 0x4f, 0x95, 0x47, 0xaf, 0xda, 0xd1, 0x78, 0x95, 0xa9, 0x7a,
+    0xf4, 0xa4, 0x1e, 0x7b, 0x8a, 0x9d, 0x37, 0x50, 0xa3, 0x0e, 0xb4, 0xca, 0xd8, 0x86, 0x90, 0xff,
+    0xb2, 0x7d, 0x6f, 0x93, 0xa5, 0xa5, 0x78, 0x51, 0xe7, 0xe9, 0xe1, 0xc5, 0x28, 0xbc, 0x15, 0xcf,
+    0x99, 0x8f, 0x97, 0x82, 0x83, 0xbc, 0x98, 0x56, 0xd2, 0xc3, 0x3f, 0xb7, 0xef, 0x6d, 0xeb, 0x58,
+    0x66, 0x13, 0x47, 0x61, 0xbc, 0x14, 0x82, 0xf9, 0xcf, 0x2b, 0x96, 0xeb, 0x32, 0x7c, 0x31, 0xed,
+    0xaf, 0x07, 0x5f, 0x85, 0xf4, 0x61, 0xca, 0xbe, 0x03, 0xa5, 0x61, 0x77, 0x5b, 0xaf, 0x04, 0x00,
+    0x00,
+};
+
+// web/settings.html
+const char WEB_SETTINGS_TEMPLATE[] PROGMEM =
+    "<!DOCTYPE html><html><head><title>Settings</title>\n"
+    "<meta name='viewport' content='width=device-width,initial-scale=1'>\n"
+    "<style>body{font-family:Arial;background:#111;color:#eee;padding:20px}\n"
+    "label{display:block;margin-top:10px}\n"
+    "input[type=text],input[type=number],input[type=password]{width:100%;padding:6px;margin-top:4px;border-radius:4px;border:1px solid #555;background:#222;color:#eee}\n"
+    ".box{background:#222;padding:15px;border-radius:10px;max-width:480px;margin:10px auto}\n"
+    "h3{margin-top:0;color:#64b5f6;border-bottom:1px solid #444;padding-bottom:8px}\n"
+    "button{margin-top:15px;padding:10px 18px;border:none;border-radius:6px;font-size:16px;cursor:pointer;background:#1e88e5;color:white}\n"
+    ".warn{background:#332200;border:1px solid #664400;padding:8px;border-radius:4px;margin-top:10px;font-size:12px}\n"
+    "a{color:#64b5f6}</style></head><body><h2>Settings</h2>\n"
+    "<form method='POST' action='/settings'>\n"
+    "\n"
+    "<div class='box'><h3>WiFi Settings</h3>\n"
+    "<label>SSID</label><input type='text' name='wifiSSID' value='%WIFI_SSID%'>\n"
+    "<label>Password</label><input type='password' name='wifiPass' value='%WIFI_PASS%'>\n"
+    "<label>Gateway IP (for ping check)</label><input type='text' name='gatewayIP' value='%GATEWAY_IP%'>\n"
+    "<label>Static IP (blank = DHCP; reconnects faster)</label><input type='text' name='staticIP' value='%STATIC_IP%'>\n"
+    "<label>Subnet mask (static IP)</label><input type='text' name='subnet' value='%SUBNET%'>\n"
+    "<div class='warn'>Changing WiFi settings requires a reboot to take effect.</div>\n"
+    "</div>\n"
+    "\n"
+    "<div class='box'><h3>MQTT Settings</h3>\n"
+    "<label><input type='checkbox' name='mqttEnabled' %MQTT_CHECKED%> Enable MQTT</label>\n"
+    "<label>Broker</label><input type='text' name='mqttBroker' value='%MQTT_BROKER%'>\n"
+    "<label>Port</label><input type='number' name='mqttPort' value='%MQTT_PORT%'>\n"
+    "<label>User (optional)</label><input type='text' name='mqttUser' value='%MQTT_USER%'>\n"
+    "<label>Password (optional)</label><input type='password' name='mqttPass' value='%MQTT_PASS%'>\n"
+    "<label>Command topic</label><input type='text' name='mqttCmd' value='%MQTT_CMD%'>\n"
+    "<label>State topic</label><input type='text' name='mqttState' value='%MQTT_STATE%'>\n"
+    "</div>\n"
+    "\n"
+    "<div class='box'><h3>Relay Settings</h3>\n"
+    "<label>Break-before-make dead time (ms)</label><input type='number' name='relayDeadMs' min='0' max='1000' value='%RELAY_DEAD_MS%'>\n"
+    "<label>Output map (%OUTPUT_COUNT% outputs; reboots on change)</label><input type='text' name='outputMap' maxlength='127' value='%OUTPUT_MAP%'>\n"
+    "<p style='font-size:12px;color:#999'>gpio &lt;pin&gt; ... ; 595 &lt;data&gt; &lt;clock&gt; &lt;latch&gt; &lt;outputs&gt; ; i2c &lt;sda&gt; &lt;scl&gt; ; mcp23017 &lt;0x20..0x27&gt; [&lt;outputs&gt;]</p>\n"
+    "</div>\n"
+    "\n"
+    "<div class='box'><h3>Command Arbitration</h3>\n"
+    "<label>Coalescing window (ms, 0 = apply every command)</label><input type='number' name='cmdWindowMs' min='0' max='1000' value='%CMD_WINDOW_MS%'>\n"
+    "<p style='font-size:12px;color:#999'>Priority 0-9 per source: inside the window, a lower one is refused</p>\n"
+    "<label>Web UI / HTTP</label><input type='number' name='prioHttp' min='0' max='9' value='%PRIO_HTTP%'>\n"
+    "<label>Front panel</label><input type='number' name='prioLocal' min='0' max='9' value='%PRIO_LOCAL%'>\n"
+    "<label>MQTT</label><input type='number' name='prioMqtt' min='0' max='9' value='%PRIO_MQTT%'>\n"
+    "<label>UDP</label><input type='number' name='prioUdp' min='0' max='9' value='%PRIO_UDP%'>\n"
+    "<label>Schedule</label><input type='number' name='prioSchedule' min='0' max='9' value='%PRIO_SCHEDULE%'>\n"
+    "<label>Band decoder</label><input type='number' name='prioBand' min='0' max='9' value='%PRIO_BAND%'>\n"
+    "</div>\n"
+    "\n"
+    "<div class='box'><h3>Band Decoder</h3>\n"
+    "<label>FlexRadio IP (blank = off)</label><input type='text' name='radioIP' value='%RADIO_IP%'>\n"
+    "<label>Slice to follow</label><input type='number' name='radioSlice' min='0' max='7' value='%RADIO_SLICE%'>\n"
+    "<label>Hysteresis (Hz)</label><input type='number' name='bandHystHz' min='0' max='100000' value='%BAND_HYST_HZ%'>\n"
+    "<p style='font-size:12px;color:#999'>Band plan: <a href='/bandplan'>/bandplan</a> (POST to change); frequencies also on &lt;command topic&gt;/freq</p>\n"
+    "</div>\n"
+    "\n"
+    "<div class='box'><h3>TX Interlock</h3>\n"
+    "<label>PTT input pin (-1 = none; reboots on change)</label><input type='number' name='pttPin' min='-1' max='39' value='%PTT_PIN%'>\n"
+    "<label><input type='checkbox' name='pttActiveLow' %PTT_LOW_CHECKED%> PTT active low</label>\n"
+    "<label>Amplifier key output pin (-1 = none)</label><input type='number' name='ampKeyPin' min='-1' max='33' value='%AMP_KEY_PIN%'>\n"
+    "<p style='font-size:12px;color:#999'>Relays do not switch while PTT is asserted; commands received meanwhile apply on release</p>\n"
+    "</div>\n"
+    "\n"
+    "<div class='box'><h3>SWR Monitor</h3>\n"
+    "<label>Forward detector pin (ADC1: 32-39, -1 = none; reboots on change)</label><input type='number' name='swrFwdPin' min='-1' max='39' value='%SWR_FWD_PIN%'>\n"
+    "<label>Reflected detector pin</label><input type='number' name='swrReflPin' min='-1' max='39' value='%SWR_REFL_PIN%'>\n"
+    "<label>Trip at SWR (0 = never)</label><input type='number' name='swrTrip' min='0' max='99' step='0.1' value='%SWR_TRIP%'>\n"
+    "<label>Forward power at full scale (W)</label><input type='number' name='swrFullW' min='1' max='10000' value='%SWR_FULL_W%'>\n"
+    "<p style='font-size:12px;color:#999'>A trip turns every output off; readings per antenna in /stats</p>\n"
+    "</div>\n"
+    "\n"
+    "<div class='box'><h3>UDP Control</h3>\n"
+    "<label>Port (0 = off; reboots on change)</label><input type='number' name='udpPort' min='0' max='65535' value='%UDP_PORT%'>\n"
+    "<label>Shared key (optional, up to 64 characters)</label><input type='password' name='udpKey' maxlength='64' value='%UDP_KEY%'>\n"
+    "<p style='font-size:12px;color:#999'>Binary protocol for logging software; see tools/udp_switch.py</p>\n"
+    "<label>State beacon group (multicast)</label><input type='text' name='beaconGroup' value='%BEACON_GROUP%'>\n"
+    "<label>State beacon port (0 = off, e.g. 4211)</label><input type='number' name='beaconPort' min='0' max='65535' value='%BEACON_PORT%'>\n"
+    "<label>Heartbeat (s, 0 = changes only)</label><input type='number' name='beaconHeartbeatS' min='0' max='3600' value='%BEACON_HEARTBEAT_S%'>\n"
+    "<p style='font-size:12px;color:#999'>State on every change to any number of listeners; see tools/udp_beacon.py</p>\n"
+    "</div>\n"
+    "\n"
+    "<div style='text-align:center'><button type='submit'>Save Settings</button></div>\n"
+    "</form><p style='text-align:center'><a href='/'>Back to switch</a></p></body></html>\n";
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+
+// --------------------------------------------------
+// WiFi supervision
+//
+// A state machine run from loop(): WiFi events (delivered on the event
+// task) only set flags, and the gateway is probed with asynchronous ICMP,
+// so no pass blocks for more than a socket call. While online the
+// gateway is pinged every WIFI_PROBE_INTERVAL_MS; WIFI_PROBE_FAILURES
+// misses in a row count as a lost link even if still associated. After
+// a reconnect the link only counts as recovered once the gateway answers.
+//
+// Recovery is tiered, with exponential backoff between attempts:
+//   1. WiFi.reconnect() to the same AP
+//   2. after WIFI_RESET_AFTER failed attempts: disconnect and begin()
+//      again with a fresh scan
+//   3. reboot once offline for WIFI_REBOOT_AFTER_MS (the journal is
+//      flushed and the antenna restored, see restartDevice())
+//
+// The AP last joined (BSSID and channel) is kept in NVS under
+// WIFI_AP_CACHE_KEY, rewritten only when it changes. Boot joins it
+// directly, which skips the all-channel scan; if it is not there any
+// more a full scan follows at once, without backoff. A static address
+// skips DHCP as well.
+// --------------------------------------------------
+
+const uint32_t WIFI_CONNECT_TIMEOUT_MS = 20000;   // one association attempt
+const uint32_t WIFI_PROBE_INTERVAL_MS  = 30000;
+const uint32_t WIFI_PROBE_RETRY_MS     = 2000;    // after a missed echo
+const uint32_t WIFI_PROBE_TIMEOUT_MS   = 1000;
+const uint8_t  WIFI_PROBE_FAILURES     = 3;
+const uint32_t WIFI_BACKOFF_MIN_MS     = 1000;
+const uint32_t WIFI_BACKOFF_MAX_MS     = 30000;
+const uint8_t  WIFI_RESET_AFTER        = 3;
+const uint32_t WIFI_REBOOT_AFTER_MS    = 15UL * 60 * 1000;
+const uint32_t WIFI_CACHED_TIMEOUT_MS  = 3000;    // cached AP: scan and join, DHCP not included
+const char     WIFI_AP_CACHE_KEY[]     = "wifiAp";
+
+enum WifiLinkState : uint8_t { WIFI_LINK_CONNECTING, WIFI_LINK_ONLINE, WIFI_LINK_BACKOFF };
+
+struct WifiSupervisorStats
+{
+    WifiLinkState state;
+    uint8_t  failures;       // consecutive failed attempts
+    uint32_t attempts;       // reconnects started (tier 1 and 2)
+    uint32_t resets;         // tier 2
+    uint32_t outages;        // online -> offline
+    uint32_t probes;
+    uint32_t probeMisses;
+    uint32_t lastRttMs;
+    uint32_t offlineMs;      // length of the current outage, 0 when online
+    uint32_t joinMs;         // last attempt -> online
+    uint32_t cacheMisses;    // cached AP not found, scanned instead
+    bool     cachedJoin;     // the last attempt went to the cached AP
+};
+
+// Starts the first association and returns at once. ssid and pass are
+// kept by reference (they live in wifiCfg); staticIP 0.0.0.0 = DHCP.
+void wifiSupervisorBegin(const char* hostname, const String& ssid, const String& pass, IPAddress gateway,
+                         IPAddress staticIP, IPAddress subnet);
+void wifiSupervisorService();
+bool wifiOnline();
+WifiSupervisorStats wifiSupervisorStats();
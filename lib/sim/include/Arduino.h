@@ -0,0 +1,72 @@
+#pragma once
+
+// --------------------------------------------------
+// Simulated board: the slice of the Arduino-ESP32 core the firmware uses.
+// GPIO and clock calls go to the virtual board in sim.cpp.
+// --------------------------------------------------
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH         0x1
+#define LOW          0x0
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+#define PROGMEM
+#define IRAM_ATTR
+#define PGM_P const char*
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+class __FlashStringHelper;
+
+#include "WString.h"
+#include "IPAddress.h"
+#include "Print.h"
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int  digitalRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+class HardwareSerial : public Print
+{
+public:
+    void begin(unsigned long baud);
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buf, size_t len) override;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass
+{
+public:
+    [[noreturn]] void restart();
+    uint64_t getEfuseMac();
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();      // largest free block
+};
+
+extern EspClass ESP;
+
+// Provided by the firmware.
+void setup();
+void loop();
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "WString.h"
+
+// Same in-memory layout as the ESP32 core: first octet in the low byte.
+class IPAddress
+{
+public:
+    IPAddress() : addr_(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : addr_((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+    IPAddress(uint32_t addr) : addr_(addr) {}
+
+    operator uint32_t() const { return addr_; }
+    uint8_t operator[](int i) const { return (uint8_t)(addr_ >> (8 * i)); }
+
+    bool fromString(const char* s);
+    bool fromString(const String& s) { return fromString(s.c_str()); }
+    String toString() const;
+
+private:
+    uint32_t addr_;
+};
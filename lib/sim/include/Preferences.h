@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+
+#include <Arduino.h>
+
+// NVS namespace handle over the simulated flash in sim.cpp. Every put is a
+// commit, as with the ESP32 core, and costs simNvs.writeUs of virtual time.
+class Preferences
+{
+public:
+    bool begin(const char* name, bool readOnly = false);
+    void end();
+
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putInt(const char* key, int32_t value);
+    size_t putUInt(const char* key, uint32_t value);
+    size_t putUShort(const char* key, uint16_t value);
+    size_t putUChar(const char* key, uint8_t value);
+    size_t putChar(const char* key, int8_t value);
+    size_t putBool(const char* key, bool value);
+    size_t putString(const char* key, const char* value);
+    size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+    size_t putBytes(const char* key, const void* value, size_t len);
+
+    int32_t  getInt(const char* key, int32_t defaultValue = 0);
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+    uint16_t getUShort(const char* key, uint16_t defaultValue = 0);
+    uint8_t  getUChar(const char* key, uint8_t defaultValue = 0);
+    int8_t   getChar(const char* key, int8_t defaultValue = 0);
+    bool     getBool(const char* key, bool defaultValue = false);
+    String   getString(const char* key, const String& defaultValue = String());
+    size_t   getBytesLength(const char* key);
+    size_t   getBytes(const char* key, void* buf, size_t maxLen);
+
+private:
+    size_t put(const char* key, const void* data, size_t len);
+    bool get(const char* key, void* data, size_t len);
+
+    std::string ns_;
+    bool open_ = false;
+    bool readOnly_ = true;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "WString.h"
+#include "IPAddress.h"
+
+class __FlashStringHelper;
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t len);
+
+    size_t print(const char* s);
+    size_t print(const __FlashStringHelper* s) { return print(reinterpret_cast<const char*>(s)); }
+    size_t print(const String& s) { return print(s.c_str()); }
+    size_t print(const IPAddress& ip) { return print(ip.toString()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v);
+    size_t print(unsigned int v);
+    size_t print(long v);
+    size_t print(unsigned long v);
+
+    template <typename T>
+    size_t println(const T& v) { size_t n = print(v); return n + println(); }
+    size_t println() { return print("\n"); }
+
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
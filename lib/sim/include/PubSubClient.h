@@ -0,0 +1,45 @@
+#pragma once
+
+#include <functional>
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#define MQTT_CONNECTION_TIMEOUT     -4
+#define MQTT_CONNECTION_LOST        -3
+#define MQTT_CONNECT_FAILED         -2
+#define MQTT_DISCONNECTED           -1
+#define MQTT_CONNECTED               0
+
+#define MQTT_MAX_PACKET_SIZE        256
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+// Client of the in-process virtual broker (sim.h, simMqtt*).
+class PubSubClient
+{
+public:
+    explicit PubSubClient(WiFiClient& client) { (void)client; }
+
+    PubSubClient& setServer(const char* domain, uint16_t port);
+    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+    bool setBufferSize(uint16_t size);
+
+    bool connect(const char* id);
+    bool connect(const char* id, const char* user, const char* pass);
+    void disconnect();
+
+    bool publish(const char* topic, const char* payload, bool retained = false);
+    bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained = false);
+    bool subscribe(const char* topic, uint8_t qos = 0);
+
+    bool loop();
+    bool connected();
+    int state() { return state_; }
+
+private:
+    std::function<void(char*, uint8_t*, unsigned int)> callback_;
+    int state_ = MQTT_DISCONNECTED;
+    uint32_t session_ = 0;
+    uint16_t bufferSize_ = MQTT_MAX_PACKET_SIZE;   // inbound packets that do not fit are dropped
+};
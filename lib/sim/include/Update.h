@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+
+#define UPDATE_ERROR_OK          0
+#define UPDATE_ERROR_WRITE       1
+#define UPDATE_ERROR_SIZE        4
+#define UPDATE_ERROR_MAGIC_BYTE  7
+#define UPDATE_ERROR_ACTIVATE    8
+#define UPDATE_ERROR_NO_PARTITION 9
+#define UPDATE_ERROR_ABORT       12
+
+// Writes an image into the simulated OTA slot that is not running (see
+// sim.h): buffered a flash sector at a time, each sector costing an erase
+// and its program time. end() makes it the boot image.
+class UpdateClass
+{
+public:
+    bool begin(size_t size = UPDATE_SIZE_UNKNOWN);
+    size_t write(uint8_t* data, size_t len);
+    bool end(bool evenIfRemaining = false);
+    void abort();
+    bool hasError() { return error_ != UPDATE_ERROR_OK; }
+    uint8_t getError() { return error_; }
+    void printError(Print& out);
+
+private:
+    void flush();
+
+    size_t size_ = 0;
+    size_t buffered_ = 0;        // bytes of the current sector not programmed yet
+    bool active_ = false;
+    uint8_t error_ = UPDATE_ERROR_OK;
+};
+
+extern UpdateClass Update;
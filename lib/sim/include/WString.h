@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+class __FlashStringHelper;
+
+#define DEC 10
+#define HEX 16
+
+// Arduino String on top of std::string; only the members the firmware uses.
+class String
+{
+public:
+    String(const char* s = "") : s_(s ? s : "") {}
+    String(const __FlashStringHelper* s) : s_(reinterpret_cast<const char*>(s)) {}
+    String(const String& o) = default;
+    String(String&& o) = default;
+    explicit String(char c) : s_(1, c) {}
+    explicit String(int v, unsigned char base = DEC);
+    explicit String(unsigned int v, unsigned char base = DEC);
+    explicit String(long v, unsigned char base = DEC);
+    explicit String(unsigned long v, unsigned char base = DEC);
+
+    String& operator=(const String& o) = default;
+    // Frees the old buffer like Arduino's move(); std::string would keep it.
+    String& operator=(String&& o) { std::string(std::move(o.s_)).swap(s_); return *this; }
+    String& operator=(const char* s) { s_ = s ? s : ""; return *this; }
+
+    bool reserve(unsigned int size) { s_.reserve(size); return true; }
+    unsigned int length() const { return (unsigned int)s_.size(); }
+    const char* c_str() const { return s_.c_str(); }
+
+    String& operator+=(const String& o) { s_ += o.s_; return *this; }
+    String& operator+=(const char* s) { if (s) s_ += s; return *this; }
+    String& operator+=(const __FlashStringHelper* s) { return *this += reinterpret_cast<const char*>(s); }
+    String& operator+=(char c) { s_ += c; return *this; }
+    bool concat(const String& o) { s_ += o.s_; return true; }
+    bool concat(const char* s, unsigned int len) { s_.append(s, len); return true; }
+
+    bool operator==(const String& o) const { return s_ == o.s_; }
+    bool operator==(const char* s) const { return s_ == (s ? s : ""); }
+    bool operator!=(const String& o) const { return s_ != o.s_; }
+    bool operator!=(const char* s) const { return !(*this == s); }
+    char operator[](unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+
+    long toInt() const;
+    void trim();
+    bool equalsIgnoreCase(const String& o) const;
+    bool startsWith(const String& prefix) const { return s_.compare(0, prefix.s_.size(), prefix.s_) == 0; }
+    int indexOf(char c, unsigned int from = 0) const;
+    String substring(unsigned int from) const { return substring(from, length()); }
+    String substring(unsigned int from, unsigned int to) const;
+
+    friend String operator+(const String& a, const String& b) { String r(a); r += b; return r; }
+    friend String operator+(const String& a, const char* b) { String r(a); r += b; return r; }
+    friend String operator+(const char* a, const String& b) { String r(a); r += b; return r; }
+
+private:
+    std::string s_;
+};
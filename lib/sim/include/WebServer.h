@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Request types shared with the Arduino WebServer. The firmware serves
+// HTTP with its own engine (include/http_server.h) over the simulated
+// sockets in sim_tcp.cpp, so only the types are provided here.
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+enum HTTPUploadStatus { UPLOAD_FILE_START, UPLOAD_FILE_WRITE, UPLOAD_FILE_END, UPLOAD_FILE_ABORTED };
+
+#define HTTP_UPLOAD_BUFLEN 1436
+
+struct HTTPUpload
+{
+    HTTPUploadStatus status;
+    String  filename;
+    String  name;
+    String  type;
+    unsigned int totalSize;     // size_t on the 32-bit ESP32
+    unsigned int currentSize;
+    uint8_t buf[HTTP_UPLOAD_BUFLEN];
+};
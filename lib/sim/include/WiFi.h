@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+
+typedef enum {
+    WL_IDLE_STATUS     = 0,
+    WL_NO_SSID_AVAIL   = 1,
+    WL_CONNECTED       = 3,
+    WL_CONNECT_FAILED  = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED    = 6
+} wl_status_t;
+
+typedef enum {
+    WIFI_OFF   = 0,
+    WIFI_STA   = 1,
+    WIFI_AP    = 2,
+    WIFI_AP_STA = 3
+} wifi_mode_t;
+
+// The subset of station events the firmware listens for.
+typedef enum {
+    ARDUINO_EVENT_WIFI_STA_CONNECTED    = 4,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP       = 7,
+    ARDUINO_EVENT_MAX                   = 46
+} arduino_event_id_t;
+
+typedef void (*WiFiEventCb)(arduino_event_id_t event);
+typedef size_t wifi_event_id_t;
+
+// The simulated access point accepts any credentials. A join scans all
+// channels (simCosts.wifiScanUs), or only the given one when begin() has
+// a channel and BSSID, then joins and runs DHCP unless config() set a
+// static IP (see sim.h); it fails if the AP is down or not on a pinned
+// channel. Events are delivered from the simulated event task.
+class WiFiClass
+{
+public:
+    bool mode(wifi_mode_t m);
+    bool setHostname(const char* name);
+    wl_status_t begin(const char* ssid, const char* pass = nullptr, int32_t channel = 0, const uint8_t* bssid = nullptr,
+                      bool connect = true);
+    bool config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1 = IPAddress(),
+                IPAddress dns2 = IPAddress());
+    wl_status_t status();
+    bool disconnect(bool wifioff = false);
+    bool reconnect();
+    bool setAutoReconnect(bool autoReconnect);
+    wifi_event_id_t onEvent(WiFiEventCb cb, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+    IPAddress localIP();
+    uint8_t* BSSID();
+    int32_t channel();
+    int8_t RSSI();
+};
+
+extern WiFiClass WiFi;
+
+// Stream handle to a TCP peer. The network is simulated at the protocol
+// level, so this only carries what the firmware writes to it.
+class WiFiClient : public Print
+{
+public:
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t len) override;
+    bool connected() { return false; }
+    void stop() {}
+};
@@ -0,0 +1,407 @@
+#pragma once
+
+// --------------------------------------------------
+// Simulated board control – used by the native scenarios (sim_main.cpp)
+//
+// Time is virtual: nothing advances it except firmware calls that would
+// take time on the ESP32 (delay, NVS commits, blocking network calls)
+// and the loop runner. Costs are a rough model of the real board and live
+// in simCosts so a scenario can tune them.
+// --------------------------------------------------
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <WebServer.h>
+
+struct SimCosts
+{
+    uint32_t loopPassUs      = 20;       // loop() bookkeeping per pass
+    uint32_t mqttLoopUs      = 30;
+    uint32_t mqttPublishUs   = 250;
+    uint32_t mqttConnectUs   = 40000;
+    uint32_t nvsOpenUs       = 150;
+    uint32_t nvsReadUs       = 40;
+    uint32_t nvsWriteUs      = 6000;     // nvs_set_* + nvs_commit
+    uint32_t wifiScanUs      = 1560000;  // all 13 channels, ~120 ms each
+    uint32_t wifiChannelScanUs = 120000; // one channel, for a known AP
+    uint32_t wifiJoinUs      = 300000;   // authenticate, associate, 4-way handshake
+    uint32_t wifiDhcpUs      = 640000;   // DISCOVER -> ACK; none with a static IP
+    uint32_t pingRttUs       = 4000;
+    uint32_t timerDispatchUs = 30;       // esp_timer task wake-up
+    uint32_t isrLatencyUs    = 2;        // GPIO edge -> interrupt handler
+    uint32_t taskWakeUs      = 10;       // notify -> higher-priority task on the same core
+    uint32_t tcpLatencyUs    = 1500;     // one way, WiFi client <-> device
+    uint32_t tcpCallUs       = 40;       // any socket call (message to the tcpip task)
+    uint32_t tcpAcceptUs     = 400;      // accept() of a new connection
+    uint32_t tcpByteNs       = 100;      // copy + checksum per byte sent or received
+    uint32_t tcpSendBuffer   = 5744;     // TCP_SND_BUF
+    uint32_t tcpRecvWindow   = 5744;     // TCP_WND: streamed uploads wait for the device to read
+    uint32_t wifiByteNs      = 2000;     // streamed uploads: ~500 KB/s over the air
+    uint32_t flashEraseUs    = 18000;    // one 4 KB sector
+    uint32_t flashWriteByteNs = 1500;    // page program
+    uint32_t flashReadByteNs = 50;       // SPI flash read, cache bypassed
+    uint32_t fleetLatencyUs  = 1000;     // fleet: one way, any client <-> broker
+    uint32_t brokerConnectUs = 5000;     // fleet: broker work per CONNECT (TLS, auth), one at a time
+};
+
+extern SimCosts simCosts;
+extern bool simVerbose;                  // echo Serial output to stdout
+
+// Thrown by ESP.restart(); the loop runner catches it and boots again.
+struct SimRestart {};
+
+// --------------------------------------------------
+// Clock and events
+// --------------------------------------------------
+uint64_t simNow();
+void simAdvance(uint64_t us);
+void simAt(uint64_t atUs, std::function<void()> fn);
+
+// Wall clock behind halUtcMicros(): steps it to us (UTC) now, like an
+// SNTP correction; 0 makes it unsynced.
+void simSetUtcMicros(uint64_t us);
+
+// --------------------------------------------------
+// Firmware runner
+// --------------------------------------------------
+struct SimLoopStats
+{
+    static const int BUCKETS = 20;
+    static const uint32_t STALL_US = 5000;
+    static const uint32_t BOUNDS_US[BUCKETS];   // upper bound per bucket, last is +inf
+
+    uint64_t passes = 0;
+    uint64_t maxUs = 0;
+    uint64_t stallUs = 0;        // total time in passes longer than STALL_US
+    uint64_t counts[BUCKETS] = {};
+
+    uint64_t percentileUs(double p) const;
+};
+
+void simBoot();                  // setup() after a power cycle; halResetReason() 1
+void simRunFor(uint64_t us);     // loop() until the clock has advanced by us
+void simRunUntil(std::function<bool()> done, uint64_t timeoutUs);
+const SimLoopStats& simLoopStats();
+void simResetLoopStats();
+uint32_t simRestarts();          // ESP.restart() reboots; halResetReason() 3
+// Forgets the GPIO edges, TCP segments and MQTT publishes recorded so
+// far, for runs too long to keep them all.
+void simDropRecords();
+
+// --------------------------------------------------
+// Heap: every operator new in the process is counted, so a scenario can
+// check that a firmware path does not allocate. Live and peak bytes only
+// cover what setup(), loop(), timers and workers allocated. Those blocks
+// are also placed in a 200 KiB first-fit arena behind ESP.getFreeHeap(),
+// getMinFreeHeap() and getMaxAllocHeap(), so fragmentation shows as a
+// shrinking largest free block.
+// --------------------------------------------------
+uint64_t simHeapAllocs();
+size_t simHeapLive();
+size_t simHeapPeak();            // since simHeapResetPeak()
+void simHeapResetPeak();
+size_t simHeapLargestFree();     // arena block, header included
+uint32_t simHeapFailures();      // firmware blocks no free arena block could take
+
+// --------------------------------------------------
+// GPIO
+// --------------------------------------------------
+struct SimGpioEdge
+{
+    uint64_t atUs;
+    uint8_t  pin;
+    uint8_t  level;
+};
+
+const std::vector<SimGpioEdge>& simGpioEdges();
+int simGpioLevel(int pin);
+
+// Inputs are driven by the scenario and keep their level across reboots.
+// An edge reaches the pin's change interrupt simCosts.isrLatencyUs later.
+void simGpioSetInput(int pin, int level);
+
+// --------------------------------------------------
+// Output expanders: a 74HC595 chain (any latch pin) and MCP23017s at
+// 0x20..0x27 on the I2C bus. What they latch shows up in simGpioEdges()
+// and simGpioLevel() as virtual pins. Transfers take no virtual time;
+// they are counted so a scenario can price them.
+// --------------------------------------------------
+const int SIM_HC595_PIN_BASE    = 64;    // + output along the chain (Q0 of the first register = 0)
+const int SIM_MCP23017_PIN_BASE = 128;   // + (addr - 0x20) * 16 + GPA0..7, GPB0..7
+
+struct SimBusStats
+{
+    uint64_t shiftTransfers = 0;         // latch pulses
+    uint64_t shiftBits = 0;
+    uint64_t i2cTransfers = 0;
+    uint64_t i2cBytes = 0;               // address byte included
+    uint64_t i2cNacks = 0;
+};
+
+const SimBusStats& simBusStats();
+void simBusResetStats();
+void simI2cSetPresent(uint8_t addr, bool present);   // all of 0x20..0x27 answer by default
+
+// --------------------------------------------------
+// Continuous ADC behind halAdcStart(): samples are taken at sampleHz,
+// round-robin over the pins, and each frame of HAL_ADC_FRAME goes to
+// the handler the moment its last sample is taken, outside loop() (the
+// ADC task). The scenario supplies the readings. The handler takes no
+// virtual time; its host time is measured instead.
+// --------------------------------------------------
+struct SimAdcStats
+{
+    uint64_t frames = 0;
+    uint64_t samples = 0;
+    uint64_t handlerNs = 0;              // host wall time inside the handler
+};
+
+// reading(pin, atUs) -> 0..4095 for the sample of pin taken at atUs;
+// without one every reading is 0.
+void simAdcSetSource(std::function<uint16_t(int pin, uint64_t atUs)> reading);
+const SimAdcStats& simAdcStats();
+void simAdcResetStats();
+
+// --------------------------------------------------
+// TCP: the scenario is the remote end of the device's sockets. Every
+// segment and close takes simCosts.tcpLatencyUs to arrive.
+// --------------------------------------------------
+struct SimTcpSegment
+{
+    uint64_t    atUs;                    // arrival at the peer
+    std::string data;
+};
+
+struct SimTcpStats
+{
+    uint64_t accepted = 0;
+    uint64_t bytesIn = 0;                // peer -> device
+    uint64_t bytesOut = 0;
+    uint64_t busyUs = 0;                 // device time in socket calls, waits excluded
+};
+
+int  simTcpConnect(uint16_t port);       // -1 if the device is not listening
+// Accepts the device's halTcpConnect() calls to port (any address) and
+// hands each new connection to onAccept; nullptr stops serving, so later
+// connects are refused.
+void simTcpServe(uint16_t port, std::function<void(int conn)> onAccept);
+void simTcpSend(int conn, const std::string& data);
+// Like a bulk sender: segments go out at simCosts.wifiByteNs per byte
+// while the device's receive window (simCosts.tcpRecvWindow) has room.
+void simTcpStream(int conn, const std::string& data);
+void simTcpClose(int conn);
+void simTcpOnReceive(int conn, std::function<void(const std::string&)> fn);
+void simTcpOnClose(int conn, std::function<void()> fn);
+void simTcpSetReading(int conn, bool reading);   // false: device send buffer fills up
+bool simTcpOpen(int conn);               // peer has seen no close from either side
+const std::vector<SimTcpSegment>& simTcpReceived(int conn);
+const SimTcpStats& simTcpStats();
+void simTcpResetStats();
+
+// --------------------------------------------------
+// UDP: the scenario is a host on the LAN. Datagrams take
+// simCosts.tcpLatencyUs each way and are never lost or reordered. A
+// multicast datagram costs the device one send however many hosts the
+// scenario has listening.
+// --------------------------------------------------
+const uint32_t SIM_UDP_HOST_IP   = 0x3201A8C0;   // 192.168.1.50, IPAddress byte order
+const uint16_t SIM_UDP_HOST_PORT = 50000;
+
+struct SimUdpDatagram
+{
+    uint64_t    atUs;                    // arrival at the host
+    uint16_t    port;                    // host port it was sent to
+    std::string data;
+    uint32_t    group;                   // multicast group, 0 = sent to the host
+};
+
+// Dropped if the device does not listen on port when it arrives.
+void simUdpSend(uint16_t port, const std::string& data, uint16_t fromPort = SIM_UDP_HOST_PORT);
+void simUdpOnReceive(std::function<void(const SimUdpDatagram&)> fn);   // at arrival; nullptr = none
+const std::vector<SimUdpDatagram>& simUdpReceived();
+
+// --------------------------------------------------
+// HTTP client: one request per connection to port 80
+// --------------------------------------------------
+struct SimHttpRequest
+{
+    uint32_t    id = 0;
+    int         conn = -1;
+    HTTPMethod  method = HTTP_GET;
+    std::string uri;                     // path and query
+
+    uint64_t    queuedUs = 0;            // sent by the client
+    uint64_t    startedUs = 0;           // first read by the device
+    uint64_t    respondedUs = 0;         // complete response at the client
+    int         code = 0;                // -1: connection refused or reset
+    std::string contentType;
+    std::string response;
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    std::string raw;                     // response bytes not parsed yet
+    size_t      contentLength = 0;
+    bool        chunked = false;
+    uint32_t    chunks = 0;              // chunked body: chunks received, last one included
+};
+
+// headers: extra request header lines, each ending in \r\n; a body is sent
+// as a form unless they include a Content-Type
+uint32_t simHttpRequest(HTTPMethod method, const std::string& uri, const std::string& body = "",
+                        const std::string& headers = "");
+// Multipart upload; the body is streamed at simCosts.wifiByteNs with at
+// most simCosts.tcpRecvWindow bytes in flight or unread at the device.
+uint32_t simHttpUpload(const std::string& uri, const std::string& filename, const std::vector<uint8_t>& data);
+const SimHttpRequest* simHttpResult(uint32_t id);
+size_t simHttpPending();                 // requests without a status line yet
+
+// --------------------------------------------------
+// MQTT: in-process broker
+// --------------------------------------------------
+struct SimMqttMessage
+{
+    std::string topic;
+    std::string payload;
+    bool        retained;
+    uint64_t    atUs;
+};
+
+void simMqttSetBrokerUp(bool up);
+void simMqttInject(const std::string& topic, const std::string& payload);
+const std::vector<SimMqttMessage>& simMqttPublished();
+uint32_t simMqttConnects();
+
+// --------------------------------------------------
+// WiFi / gateway
+// --------------------------------------------------
+struct SimWifiStats
+{
+    uint64_t associations = 0;           // begin()/reconnect() and core auto-reconnects
+    uint64_t fullScans = 0;
+    uint64_t channelScans = 0;           // begin() with a channel and BSSID
+    uint64_t dhcp = 0;
+    uint64_t pings = 0;
+};
+
+void simWifiSetApUp(bool up);
+void simWifiSetApChannel(int channel);   // the AP moves (default 6); a join pinned to the old one fails
+void simNetSetGatewayUp(bool up);        // false: associated, but echoes go unanswered
+const SimWifiStats& simWifiStats();
+
+// --------------------------------------------------
+// OTA: two app slots behind Update and halOta*. An image that Update
+// ends successfully boots on the next restart as pending; restarting
+// again before halOtaConfirm() rolls back to the other slot, like the
+// ESP-IDF bootloader with rollback enabled. Survives simBoot().
+// --------------------------------------------------
+const size_t SIM_OTA_PARTITION_SIZE = 0x140000;     // default partition table: 1.25 MiB per app
+
+enum SimOtaImageState { SIM_OTA_VALID, SIM_OTA_NEW, SIM_OTA_PENDING, SIM_OTA_INVALID, SIM_OTA_ABORTED };
+
+struct SimOtaStats
+{
+    int      running = 0;                // slot
+    SimOtaImageState state = SIM_OTA_VALID;   // of the running image
+    uint32_t boots = 0;
+    uint32_t begins = 0;
+    uint32_t aborts = 0;
+    uint32_t images = 0;                 // Update.end() that set a new boot image
+    uint32_t sectors = 0;                // erased and programmed
+    uint32_t confirms = 0;
+    uint32_t rollbacks = 0;              // by the firmware or the bootloader
+};
+
+SimOtaStats simOtaStats();
+const std::vector<uint8_t>& simOtaImage(int slot);
+void simOtaReset();                      // slot 0 valid and running, slot 1 empty
+
+// --------------------------------------------------
+// Event log partition behind halLogFlash*: NOR flash, erased to 0xff, a
+// write only clears bits. Starts erased and survives simBoot().
+// --------------------------------------------------
+const size_t SIM_LOG_PARTITION_SIZE = 0x170000;     // default partition table's spiffs
+
+struct SimLogFlashStats
+{
+    uint64_t erases = 0;
+    uint64_t writes = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t reads = 0;
+    uint64_t bytesRead = 0;
+    uint64_t blockingUs = 0;             // erasing and writing outside a worker task
+};
+
+const SimLogFlashStats& simLogFlashStats();
+void simLogFlashResetStats();
+void simLogFlashErase();                 // the whole partition
+// Programs bytes as a write would, without time or stats: a write torn
+// by a power cut, or junk left by earlier firmware.
+void simLogFlashPoke(size_t offset, const void* data, size_t len);
+
+// --------------------------------------------------
+// NVS
+// --------------------------------------------------
+struct SimNvsStats
+{
+    uint64_t commits = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t reads = 0;
+};
+
+const SimNvsStats& simNvsStats();
+void simNvsResetStats();
+void simNvsErase();
+uint64_t simNvsKeyWrites(const std::string& ns, const std::string& key);   // since erase
+bool simNvsRead(const std::string& ns, const std::string& key, std::vector<uint8_t>* value);
+void simNvsWrite(const std::string& ns, const std::string& key, const std::vector<uint8_t>& value);
+
+// --------------------------------------------------
+// Fleet: many boards against one broker
+//
+// simFleetStart() forks one process per member; each runs member(index)
+// on its own simulated board (firmware globals, NVS, virtual clock) and
+// exits when it returns. The parent moves every member's clock forward
+// in lockstep, SIM_FLEET_STEP_US per simFleetStep(), and is the MQTT
+// broker between them: the members' PubSubClients connect, subscribe
+// and publish there instead of to the in-process broker, and the parent
+// can take part as one more client (the automation host). CONNECTs are
+// served one at a time, simCosts.brokerConnectUs each, so a reconnect
+// storm queues. Retained messages survive a broker restart.
+// --------------------------------------------------
+const uint32_t SIM_FLEET_STEP_US = 1000;     // < 2 * simCosts.fleetLatencyUs, or messages land in the past
+
+struct SimFleetBrokerStats
+{
+    uint32_t connects = 0;
+    uint32_t refused = 0;                // CONNECT while the broker was down
+    uint32_t publishes = 0;              // accepted from members and the host
+    uint32_t deliveries = 0;             // routed to subscribers
+    uint64_t maxConnectWaitUs = 0;       // CONNECT queued behind others
+};
+
+struct SimFleetMemberStats
+{
+    bool     active = false;             // member() still running
+    bool     connected = false;
+    uint32_t connects = 0;
+    uint32_t refused = 0;
+    uint64_t lastConnectUs = 0;          // CONNACK sent
+};
+
+// Parent side
+bool simFleetStart(int members, std::function<void(int index)> member);
+bool simFleetStep();                     // false once every member has returned
+uint64_t simFleetNow();
+void simFleetSetBrokerUp(bool up);       // down: every session drops
+void simFleetPublish(const std::string& topic, const std::string& payload, bool retained = false);
+void simFleetSubscribe(const std::string& filter);
+std::vector<SimMqttMessage> simFleetReceive();   // host messages due by now, in order
+bool simFleetRetained(const std::string& topic, std::string* payload);
+const SimFleetBrokerStats& simFleetBrokerStats();
+SimFleetMemberStats simFleetMemberStats(int index);
+const std::string& simFleetReportOf(int index);
+
+// Member side: text handed back to the parent when member() returns.
+void simFleetReport(const std::string& text);
@@ -0,0 +1,52 @@
+#pragma once
+
+// Machine-readable scenario output: a small streaming JSON writer and
+// latency summaries; and the pass/fail lines scenarios print.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+class SimJson
+{
+public:
+    explicit SimJson(FILE* out) : out_(out) {}
+
+    SimJson& beginObject(const char* key = nullptr);
+    SimJson& endObject();
+    SimJson& beginArray(const char* key = nullptr);
+    SimJson& endArray();
+
+    SimJson& field(const char* key, const char* v);
+    SimJson& field(const char* key, const std::string& v) { return field(key, v.c_str()); }
+    SimJson& field(const char* key, double v);
+    SimJson& field(const char* key, int64_t v);
+    SimJson& field(const char* key, uint64_t v);
+    SimJson& field(const char* key, int v) { return field(key, (int64_t)v); }
+    SimJson& field(const char* key, uint32_t v) { return field(key, (uint64_t)v); }
+    SimJson& field(const char* key, bool v);
+
+    SimJson& value(double v) { return field(nullptr, v); }
+    SimJson& value(uint64_t v) { return field(nullptr, v); }
+
+private:
+    void prefix(const char* key);
+
+    FILE* out_;
+    std::vector<bool> first_;
+};
+
+struct SimSummary
+{
+    size_t count = 0;
+    double min = 0, mean = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;
+};
+
+SimSummary simSummarize(std::vector<double> values);
+double simPercentile(const std::vector<double>& sorted, double p);
+void simWriteSummary(SimJson& json, const char* key, const SimSummary& s);
+void simPrintSummary(const char* label, const char* unit, const SimSummary& s);
+
+// Prints "  [ok] what" or "  [FAIL] what", counting failures; returns ok.
+bool simCheck(bool ok, const char* what, int* failures);
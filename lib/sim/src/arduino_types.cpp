@@ -0,0 +1,117 @@
+#include <ctype.h>
+#include <algorithm>
+
+#include <Arduino.h>
+
+// --------------------------------------------------
+// String
+// --------------------------------------------------
+static std::string formatUnsigned(unsigned long long v, unsigned char base)
+{
+    if (base < 2 || base > 36) base = 10;
+    if (v == 0) return "0";
+    std::string out;
+    while (v) {
+        int d = (int)(v % base);
+        out.insert(out.begin(), (char)(d < 10 ? '0' + d : 'a' + d - 10));
+        v /= base;
+    }
+    return out;
+}
+
+static std::string formatSigned(long long v, unsigned char base)
+{
+    if (base == 10 && v < 0) return "-" + formatUnsigned((unsigned long long)(-v), base);
+    return formatUnsigned((unsigned long long)v, base);
+}
+
+String::String(int v, unsigned char base) : s_(formatSigned(v, base)) {}
+String::String(unsigned int v, unsigned char base) : s_(formatUnsigned(v, base)) {}
+String::String(long v, unsigned char base) : s_(formatSigned(v, base)) {}
+String::String(unsigned long v, unsigned char base) : s_(formatUnsigned(v, base)) {}
+
+long String::toInt() const
+{
+    return strtol(s_.c_str(), nullptr, 10);
+}
+
+void String::trim()
+{
+    size_t b = 0, e = s_.size();
+    while (b < e && isspace((unsigned char)s_[b])) b++;
+    while (e > b && isspace((unsigned char)s_[e - 1])) e--;
+    s_ = s_.substr(b, e - b);
+}
+
+bool String::equalsIgnoreCase(const String& o) const
+{
+    if (s_.size() != o.s_.size()) return false;
+    for (size_t i = 0; i < s_.size(); i++) {
+        if (tolower((unsigned char)s_[i]) != tolower((unsigned char)o.s_[i])) return false;
+    }
+    return true;
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+    size_t p = s_.find(c, from);
+    return p == std::string::npos ? -1 : (int)p;
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+    if (from > to) std::swap(from, to);
+    if (from >= s_.size()) return String();
+    return String(s_.substr(from, to - from).c_str());
+}
+
+// --------------------------------------------------
+// IPAddress
+// --------------------------------------------------
+bool IPAddress::fromString(const char* s)
+{
+    unsigned a, b, c, d;
+    char tail;
+    if (!s || sscanf(s, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4) return false;
+    if (a > 255 || b > 255 || c > 255 || d > 255) return false;
+    *this = IPAddress((uint8_t)a, (uint8_t)b, (uint8_t)c, (uint8_t)d);
+    return true;
+}
+
+String IPAddress::toString() const
+{
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(buf);
+}
+
+// --------------------------------------------------
+// Print
+// --------------------------------------------------
+size_t Print::write(const uint8_t* buf, size_t len)
+{
+    size_t n = 0;
+    while (len--) n += write(*buf++);
+    return n;
+}
+
+size_t Print::print(const char* s)
+{
+    return s ? write((const uint8_t*)s, strlen(s)) : 0;
+}
+
+size_t Print::print(int v)           { return print(String(v)); }
+size_t Print::print(unsigned int v)  { return print(String(v)); }
+size_t Print::print(long v)          { return print(String(v)); }
+size_t Print::print(unsigned long v) { return print(String(v)); }
+
+size_t Print::printf(const char* fmt, ...)
+{
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    return write((const uint8_t*)buf, std::min((size_t)n, sizeof(buf) - 1));
+}
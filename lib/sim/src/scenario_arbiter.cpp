@@ -0,0 +1,328 @@
+// --------------------------------------------------
+// Scenario: command arbiter
+//
+// A burst of MQTT selections 5 ms apart, first with no coalescing
+// window (every command reaches the relays, as before the arbiter),
+// then with one: at most two switches, the last target wins and the
+// relays never rest on an antenna in between. Then priorities (a web
+// click inside an automation window is outranked, a band change takes
+// over a web window), the held/superseded fields of the /set and MQTT
+// replies, and the manual lock: MQTT and the band decoder refused, the
+// web UI taken, an SWR trip passing straight through.
+// --------------------------------------------------
+
+#include <set>
+
+#include "antenna_switch.h"
+#include "band_decoder.h"
+#include "hal.h"
+#include "mqtt_outbox.h"
+#include "outputs.h"
+#include "relay_sequencer.h"
+#include "relay_task.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+
+namespace {
+
+const int      BURST        = 20;
+const uint64_t BURST_GAP_US = 5000;
+const int      WINDOW_MS    = 250;
+
+const SimHttpRequest* request(HTTPMethod method, const std::string& uri, const std::string& body = "",
+                              const std::string& headers = "")
+{
+    const uint32_t id = simHttpRequest(method, uri, body, headers);
+    simRunUntil([id] { return simHttpResult(id)->respondedUs != 0 || simHttpResult(id)->code < 0; }, 5000000);
+    return simHttpResult(id);
+}
+
+// Settings that apply without a reboot; MQTT stays on.
+void postSettings(const std::string& fields)
+{
+    request(HTTP_POST, "/settings", "mqttEnabled=on&" + fields);
+}
+
+void mqttCommand(const std::string& payload)
+{
+    simMqttInject(mqttCfg.topicCmd.c_str(), payload);
+}
+
+bool contains(const std::string& s, const char* what)
+{
+    return s.find(what) != std::string::npos;
+}
+
+// Antennas the relays rested on (one output driven) from fromUs on
+std::vector<int> visited(uint64_t fromUs)
+{
+    std::vector<int> v;
+    uint32_t on = 0;
+    for (const SimGpioEdge& e : simGpioEdges()) {
+        if (e.pin < 16 || e.pin > 19) continue;      // OUTPUT_MAP_DEFAULT: gpio 16 17 18 19
+        on = e.level ? on | 1u << (e.pin - 16) : on & ~(1u << (e.pin - 16));
+        if (e.atUs < fromUs || !on || (on & (on - 1))) continue;
+        v.push_back(__builtin_ctz(on) + 1);
+    }
+    return v;
+}
+
+struct Burst
+{
+    std::vector<int> visited;
+    uint32_t applied;
+    uint32_t switches;
+    uint32_t held;
+    uint32_t superseded;
+    uint64_t settledMs;      // last command -> relays idle
+};
+
+// BURST MQTT selections BURST_GAP_US apart, cycling 1..4 and ending on 3
+Burst burst()
+{
+    setAntenna(1, RELAY_SRC_LOCAL);
+    simRunFor(1000000);
+    const RelayTaskStats r0 = relayTaskStats();
+    const uint32_t s0 = relaySequencerStats().transitions;
+    const uint64_t startUs = simNow();
+    for (int i = 0; i < BURST; i++) {
+        const int ant = i == BURST - 1 ? 3 : 1 + (i + 1) % 4;
+        simAt(startUs + i * BURST_GAP_US, [ant] { mqttCommand(std::to_string(ant)); });
+    }
+    const uint64_t lastUs = startUs + (BURST - 1) * BURST_GAP_US;
+    simRunFor((BURST - 1) * BURST_GAP_US + 1000);
+    simRunUntil([] { return relaySnapshot().antenna == 3 && outputsDriven() == 0x4; }, 2000000);
+    Burst b;
+    b.settledMs = (simNow() - lastUs) / 1000;
+    simRunFor(500000);
+    const RelayTaskStats r = relayTaskStats();
+    b.visited = visited(startUs);
+    b.applied = r.applied - r0.applied;
+    b.switches = relaySequencerStats().transitions - s0;
+    b.held = r.held - r0.held;
+    b.superseded = r.superseded - r0.superseded;
+    return b;
+}
+
+void printBurst(const char* label, const Burst& b)
+{
+    printf("%s: %u applied, %u switches, %u held, %u superseded, settled %llu ms after the last; rested on",
+           label, b.applied, b.switches, b.held, b.superseded, (unsigned long long)b.settledMs);
+    for (int a : b.visited) printf(" %d", a);
+    printf("\n");
+}
+
+std::string lastReply()
+{
+    const std::string topic = std::string(mqttCfg.topicState.c_str()) + "/reply";
+    const std::vector<SimMqttMessage>& pub = simMqttPublished();
+    for (size_t i = pub.size(); i-- > 0;) {
+        if (pub[i].topic == topic) return pub[i].payload;
+    }
+    return "";
+}
+
+} // namespace
+
+int scenarioArbiter(const SimOptions& opt)
+{
+    int failures = 0;
+
+    simNvsErase();
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    simRunFor(500000);
+    simCheck(relayCfg.windowMs == 0 && !relayTaskStats().locked, "no window and no lock by default", &failures);
+
+    // ---- Burst: window 0 vs. a coalescing window ----
+    const Burst plain = burst();
+    printBurst("window 0", plain);
+    simCheck(plain.applied == BURST && plain.held == 0 && plain.visited.back() == 3,
+             "window 0: every command applied, as without the arbiter", &failures);
+
+    postSettings("cmdWindowMs=" + std::to_string(WINDOW_MS));
+    simCheck(relayCfg.windowMs == WINDOW_MS &&
+                 contains(request(HTTP_GET, "/stats")->response, "\"windowMs\":250"),
+             "window set in /settings, shown in /stats", &failures);
+    const Burst coalesced = burst();
+    printBurst("window 250 ms", coalesced);
+    const std::set<int> rested(coalesced.visited.begin(), coalesced.visited.end());
+    simCheck(coalesced.applied == 2 && coalesced.held == BURST - 1 && coalesced.superseded == BURST - 2,
+             "one applied at once, the rest held, all but the last superseded", &failures);
+    simCheck(coalesced.switches <= 2 && rested.size() <= 2 && !coalesced.visited.empty() &&
+                 coalesced.visited.back() == 3,
+             "at most two switches, ending on the last target, nothing in between", &failures);
+    simCheck(coalesced.settledMs <= WINDOW_MS + 50, "... within a window of the last command", &failures);
+
+    // A lone command after a quiet spell is not delayed
+    simRunFor(1000000);
+    const uint32_t lone = relayTaskStats().latency[RELAY_SRC_MQTT].count;
+    mqttCommand("2");
+    simRunFor(50000);
+    const RelayLatency mqttLatency = relayTaskStats().latency[RELAY_SRC_MQTT];
+    printf("lone MQTT command: %u us to the sequencer\n", mqttLatency.lastUs);
+    simCheck(mqttLatency.count == lone + 1 && mqttLatency.lastUs <= RELAY_BUDGET_US && relaySnapshot().antenna == 2,
+             "a lone command applies at once, inside the latency budget", &failures);
+
+    // ---- Replies: held and superseded ----
+    simRunFor(1000000);
+    const SimHttpRequest* r1 = request(HTTP_GET, "/set?ant=1");
+    const SimHttpRequest* r2 = request(HTTP_GET, "/set?ant=2");
+    const SimHttpRequest* r3 = request(HTTP_GET, "/set?ant=4");
+    printf("/set inside a window:\n  %s\n  %s\n  %s\n", r1->response.c_str(), r2->response.c_str(),
+           r3->response.c_str());
+    simCheck(r1->code == 200 && contains(r1->response, "\"result\":\"applied\",\"superseded\":null"),
+             "first /set applied", &failures);
+    simCheck(r2->code == 200 && contains(r2->response, "\"antenna\":2") &&
+                 contains(r2->response, "\"result\":\"held\",\"superseded\":null"),
+             "second held", &failures);
+    simCheck(r3->code == 200 && contains(r3->response, "\"result\":\"held\",\"superseded\":\"http\""),
+             "third held, superseding the second", &failures);
+    simRunFor((WINDOW_MS + 50) * 1000);
+    simCheck(relaySnapshot().antenna == 4, "the third applied when the window ended", &failures);
+
+    simRunFor(1000000);
+    mqttCommand("{\"ant\":1,\"id\":\"a1\"}");
+    simRunFor(20000);
+    mqttCommand("{\"ant\":3,\"id\":\"a2\"}");
+    simRunFor((WINDOW_MS + 50) * 1000 + MQTT_PUBLISH_INTERVAL_MS * 1000);
+    const std::string reply = lastReply();
+    printf("MQTT reply: %s\n", reply.c_str());
+    simCheck(contains(reply, "{\"id\":\"a2\",\"antenna\":3") && contains(reply, "\"result\":\"held\"") &&
+                 contains(reply, "\"superseded\":null"),
+             "MQTT command with an id: <state>/reply says held", &failures);
+
+    // A burst of them past the publish bucket: every caller gets its own
+    simRunFor(1000000);
+    const std::string replyTopic = std::string(mqttCfg.topicState.c_str()) + "/reply";
+    const size_t seen = simMqttPublished().size();
+    const int BURST_IDS = 12;
+    for (int i = 0; i < BURST_IDS; i++) {
+        mqttCommand("{\"ant\":" + std::to_string(i % 4 + 1) + ",\"id\":\"r" + std::to_string(i) + "\"}");
+        simRunFor(5000);
+    }
+    simRunFor((WINDOW_MS + 50) * 1000 + BURST_IDS * MQTT_PUBLISH_INTERVAL_MS * 1000);
+    int answered = 0;
+    const std::vector<SimMqttMessage>& pub = simMqttPublished();
+    for (size_t i = seen; i < pub.size(); i++) {
+        if (pub[i].topic == replyTopic && contains(pub[i].payload, ("{\"id\":\"r" + std::to_string(answered) + "\"").c_str())) {
+            answered++;
+        }
+    }
+    printf("burst of %d commands with ids: %d replies in order, %lu throttled passes\n", BURST_IDS, answered,
+           (unsigned long)mqttOutboxStats().throttled);
+    simCheck(answered == BURST_IDS && mqttOutboxStats().replyDropped == 0, "... and a burst of them: one reply each",
+             &failures);
+
+    // ---- Priority ----
+    // MQTT (2) over HTTP (1): a click inside an automation window is refused
+    simRunFor(1000000);
+    mqttCommand("2");
+    simRunFor(20000);
+    const SimHttpRequest* refused = request(HTTP_GET, "/set?ant=4");
+    printf("/set inside an MQTT window: %d %s\n", refused->code, refused->response.c_str());
+    simCheck(refused->code == 409 && refused->response == "{\"error\":\"outranked\",\"by\":\"mqtt\"}",
+             "/set outranked by MQTT: 409", &failures);
+    simRunFor((WINDOW_MS + 50) * 1000);
+    simCheck(relaySnapshot().antenna == 2, "... the MQTT selection stands", &failures);
+    simCheck(request(HTTP_GET, "/set?ant=4")->code == 200 && (simRunFor(50000), relaySnapshot().antenna == 4),
+             "after the window the same click is taken", &failures);
+
+    // Band (2) takes over a web window, and the web cannot undo it
+    request(HTTP_POST, "/bandplan", "14.000-14.350 3\n7.000-7.300 1", "Content-Type: text/plain\r\n");
+    const std::string freqTopic = std::string(mqttCfg.topicCmd.c_str()) + "/freq";
+    simRunFor(1000000);
+    request(HTTP_GET, "/set?ant=2");
+    simMqttInject(freqTopic, "14.074");
+    simRunFor(20000);
+    const SimHttpRequest* undo = request(HTTP_GET, "/set?ant=2");
+    simRunFor((WINDOW_MS + 50) * 1000);
+    simCheck(undo->code == 409 && contains(undo->response, "\"by\":\"band\"") && relaySnapshot().antenna == 3,
+             "band change inside a web window: held, then the web outranked", &failures);
+
+    // Equal priorities: the later one takes over
+    postSettings("prioHttp=2");
+    simRunFor(1000000);
+    mqttCommand("1");
+    simRunFor(20000);
+    const SimHttpRequest* equal = request(HTTP_GET, "/set?ant=4");
+    simRunFor((WINDOW_MS + 50) * 1000);
+    simCheck(equal->code == 200 && contains(equal->response, "\"superseded\":null") && relaySnapshot().antenna == 4,
+             "HTTP ranked with MQTT: the later one wins", &failures);
+    postSettings("prioHttp=1");
+
+    // ---- Manual lock ----
+    const RelayTaskStats l0 = relayTaskStats();
+    const BandDecoderStats b0 = bandDecoderStats();
+    simCheck(request(HTTP_GET, "/lock?on=1")->response == "{\"locked\":true}", "/lock?on=1", &failures);
+    simRunFor(1000000);
+    mqttCommand("{\"ant\":1,\"id\":\"b1\"}");
+    simMqttInject(freqTopic, "7.074");
+    simRunFor(MQTT_PUBLISH_INTERVAL_MS * 1000);
+    printf("MQTT reply while locked: %s\n", lastReply().c_str());
+    simCheck(relaySnapshot().antenna == 4 && relayTaskStats().lockedOut - l0.lockedOut == 2,
+             "locked: MQTT and the band decoder refused", &failures);
+    simCheck(lastReply() == "{\"id\":\"b1\",\"error\":\"locked\",\"by\":\"lock\"}", "... the MQTT reply says so",
+             &failures);
+    simCheck(bandDecoderStats().refused == b0.refused + 1 && bandDecoderStats().dropped == b0.dropped,
+             "... the band counts it handled, not dropped", &failures);
+    simMqttInject(freqTopic, "7.080");
+    simRunFor(100000);
+    simCheck(relayTaskStats().lockedOut - l0.lockedOut == 2, "... and does not retry inside the band", &failures);
+    simCheck(request(HTTP_GET, "/set?ant=2")->code == 200 && (simRunFor(50000), relaySnapshot().antenna == 2),
+             "locked: the web UI is taken", &failures);
+
+    // SWR cancels a held command and passes the lock
+    simRunFor(1000000);
+    request(HTTP_GET, "/set?ant=1");
+    request(HTTP_GET, "/set?ant=3");
+    RelayPostResult trip;
+    relayPostOutputs(0, RELAY_SRC_SWR, halMicros(), &trip);
+    simRunFor((WINDOW_MS + 50) * 1000);
+    simCheck(trip.verdict == RELAY_APPLIED && trip.superseded && trip.by == RELAY_SRC_HTTP &&
+                 relaySnapshot().outputs == 0 && outputsDriven() == 0,
+             "SWR trip inside a window, while locked: applied at once, the held command dropped", &failures);
+    const std::string stats = request(HTTP_GET, "/stats")->response;
+    simCheck(contains(stats, "\"locked\":true") && contains(stats, "\"lockedOut\":"), "/stats shows the lock",
+             &failures);
+    simCheck(request(HTTP_GET, "/lock?on=0")->response == "{\"locked\":false}", "/lock?on=0", &failures);
+    mqttCommand("2");
+    simRunFor(50000);
+    simCheck(relaySnapshot().antenna == 2, "unlocked: MQTT taken again", &failures);
+
+    const RelayTaskStats end = relayTaskStats();
+    printf("relay task: %u posted, %u applied, %u held, %u superseded, %u outranked, %u locked out\n", end.posted,
+           end.applied, end.held, end.superseded, end.outranked, end.lockedOut);
+    simCheck(contains(request(HTTP_GET, "/metrics")->response, "antswitch_relay_commands_superseded_total "),
+             "/metrics counts superseded commands", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "arbiter")
+            .field("burst", BURST)
+            .field("burst_gap_us", BURST_GAP_US)
+            .field("window_ms", WINDOW_MS);
+        const Burst* runs[] = {&plain, &coalesced};
+        const char* names[] = {"window_0", "window"};
+        for (int i = 0; i < 2; i++) {
+            json.beginObject(names[i])
+                .field("applied", runs[i]->applied)
+                .field("switches", runs[i]->switches)
+                .field("held", runs[i]->held)
+                .field("superseded", runs[i]->superseded)
+                .field("antennas_visited", (uint32_t)runs[i]->visited.size())
+                .endObject();
+        }
+        json.field("failures", failures).endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
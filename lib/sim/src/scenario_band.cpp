@@ -0,0 +1,400 @@
+// --------------------------------------------------
+// Scenario: band decoder
+//
+// Loads an HF band plan over HTTP, then checks the lookup itself: the
+// binary search agrees with a linear scan over a full 32-band table at
+// every edge and at random frequencies, in at most log2 probes. Then the
+// radio's frequency arrives over MQTT (<cmd topic>/freq) and, from a
+// stand-in FlexRadio, over the TCP status stream: every band change must
+// reach the relays, and the time from the frequency update to the relay
+// edges is reported. Also: a VFO jittering on the edge between two bands
+// does not switch with hysteresis and switches on every crossing without; a
+// manual selection is left alone while the radio stays in its band; a
+// frequency outside every band holds the selection; the status client
+// follows only its slice, reassembles split lines and reconnects after
+// the radio drops it; the plan comes back from NVS after a reboot.
+// --------------------------------------------------
+
+#include <algorithm>
+#include <string.h>
+
+#include "antenna_switch.h"
+#include "band_decoder.h"
+#include "flex_radio.h"
+#include "relay_sequencer.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+
+namespace {
+
+const uint64_t DEAD_US = 10000;          // default relayDeadMs
+
+const char HF_PLAN[] =
+    "# HF, four antennas\n"
+    "1.800-2.000 1         # 160 m\n"
+    "3500k-3800k 1\n"
+    "14.000-14.350 3; 7.000-7.200 2\n"
+    "10100000-10150000 2\n"
+    "18068k-18168k 3\n"
+    "21.000-21.450 4\n"
+    "24890k-24990k 4\n"
+    "28.000-29.700 4\n"
+    "50.000-52.000 off\n";
+
+const char HF_CANONICAL[] =
+    "1800k-2000k 1\n"
+    "3500k-3800k 1\n"
+    "7000k-7200k 2\n"
+    "10100k-10150k 2\n"
+    "14000k-14350k 3\n"
+    "18068k-18168k 3\n"
+    "21000k-21450k 4\n"
+    "24890k-24990k 4\n"
+    "28000k-29700k 4\n"
+    "50000k-52000k off\n";
+
+const SimHttpRequest* request(HTTPMethod method, const std::string& uri, const std::string& body = "",
+                              const std::string& headers = "")
+{
+    const uint32_t id = simHttpRequest(method, uri, body, headers);
+    simRunUntil([id] { return simHttpResult(id)->respondedUs != 0 || simHttpResult(id)->code < 0; }, 5000000);
+    return simHttpResult(id);
+}
+
+const SimHttpRequest* postPlan(const std::string& text)
+{
+    return request(HTTP_POST, "/bandplan", text, "Content-Type: text/plain\r\n");
+}
+
+// Settings that apply without a reboot; MQTT stays on.
+void postSettings(const std::string& fields)
+{
+    request(HTTP_POST, "/settings", "mqttEnabled=on&" + fields);
+}
+
+uint32_t levels()
+{
+    uint32_t m = 0;
+    for (int i = 0; i < 4; i++) {
+        if (simGpioLevel(16 + i) == HIGH) m |= 1u << i;   // OUTPUT_MAP_DEFAULT: gpio 16 17 18 19
+    }
+    return m;
+}
+
+// First output edge at or after fromUs, and the edge that left the
+// outputs at want (0 if they never got there).
+struct Edges
+{
+    uint64_t firstUs;
+    uint64_t settledUs;
+};
+
+Edges edgesAfter(uint64_t fromUs, uint32_t want)
+{
+    Edges r = {0, 0};
+    uint32_t on = 0;
+    bool started = false;
+    for (const SimGpioEdge& e : simGpioEdges()) {
+        if (e.pin < 16 || e.pin > 19) continue;
+        const uint32_t bit = 1u << (e.pin - 16);
+        if (e.atUs >= fromUs && !started) {
+            started = true;
+            r.firstUs = e.atUs;
+        }
+        on = e.level ? on | bit : on & ~bit;
+        if (started && on == want && !r.settledUs) r.settledUs = e.atUs;
+        if (started && on != want) r.settledUs = 0;
+    }
+    return r;
+}
+
+uint32_t lcg(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+struct Hop
+{
+    const char* freq;            // as sent
+    int         antenna;
+};
+
+} // namespace
+
+int scenarioBand(const SimOptions& opt)
+{
+    int failures = 0;
+
+    simNvsErase();
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    simRunFor(500000);
+
+    // ---- Band plan text ----
+    const SimHttpRequest* post = postPlan(HF_PLAN);
+    printf("band: POST /bandplan %d \"%s\"\n", post->code, post->response.c_str());
+    simCheck(post->code == 200 && post->response == "10 bands", "HF plan loaded over HTTP", &failures);
+    simCheck(request(HTTP_GET, "/bandplan")->response == HF_CANONICAL, "GET /bandplan returns it sorted and canonical",
+             &failures);
+
+    struct BadPlan
+    {
+        const char* text;
+        const char* error;
+    };
+    const BadPlan bad[] = {
+        {"7.000-7.200 2\n7.150-7.300 3\n", "line 2: overlaps another band"},
+        {"7.300-7.000 2", "line 1: bad range '7.300-7.000'"},
+        {"14.000-14.350 5", "line 1: bad selection '5'"},
+        {"14.000 3", "line 1: bad range '14.000'"},
+        {"14.000-14.350 3 4", "line 1: expected: <from>-<to> <selection>"},
+    };
+    int wrongErrors = 0;
+    for (const BadPlan& b : bad) {
+        const SimHttpRequest* r = postPlan(b.text);
+        if (r->code != 400 || r->response != b.error) {
+            printf("  '%s': %d %s\n", b.text, r->code, r->response.c_str());
+            wrongErrors++;
+        }
+    }
+    simCheck(wrongErrors == 0 && bandDecoderPlan().bands == 10, "bad plans refused with the line at fault", &failures);
+
+    // ---- Lookup: binary search against a linear scan ----
+    BandPlan full = {};
+    uint32_t seed = opt.seed;
+    uint32_t hz = 1000000;
+    for (int i = 0; i < BAND_MAX; i++) {
+        hz += lcg(&seed) % 2 ? 0 : 1 + lcg(&seed) % 50000;   // some bands touch
+        full.band[i] = Band{hz, hz + lcg(&seed) % 300000, outputBit(1 + i % 4)};
+        hz = full.band[i].highHz + 1;
+    }
+    full.bands = BAND_MAX;
+
+    std::vector<uint32_t> probesAt;
+    for (int i = 0; i < BAND_MAX; i++) {
+        const Band& b = full.band[i];
+        probesAt.insert(probesAt.end(), {b.lowHz - 1, b.lowHz, b.lowHz + 1, b.highHz - 1, b.highHz, b.highHz + 1});
+    }
+    for (int i = 0; i < 20000; i++) probesAt.push_back(900000 + lcg(&seed) % (hz - 800000));
+    int mismatches = 0, maxProbes = 0;
+    for (uint32_t f : probesAt) {
+        int linear = -1;
+        for (int i = 0; i < full.bands; i++) {
+            if (f >= full.band[i].lowHz && f <= full.band[i].highHz) linear = i;
+        }
+        int probes;
+        if (bandPlanFind(full, f, &probes) != linear) mismatches++;
+        maxProbes = std::max(maxProbes, probes);
+    }
+    printf("band: %zu lookups in %d bands, at most %d probes\n", probesAt.size(), full.bands, maxProbes);
+    simCheck(mismatches == 0, "binary search agrees with a linear scan", &failures);
+    simCheck(maxProbes <= 6, "at most ceil(log2(bands + 1)) probes", &failures);
+
+    struct FreqCase
+    {
+        const char* s;
+        uint32_t hz;                     // 0 = rejected
+    };
+    const FreqCase freqs[] = {
+        {"14074000", 14074000}, {"14.074", 14074000}, {"14.074000", 14074000}, {"14074k", 14074000},
+        {"14.0745M", 14074500}, {"1296.2", 1296200000}, {"0.1375", 137500}, {"", 0}, {"14,074", 0},
+        {"14.074 MHz", 0}, {"5000M", 0},
+    };
+    int wrongFreqs = 0;
+    for (const FreqCase& c : freqs) {
+        uint32_t v = 0;
+        const bool ok = bandParseFrequency(c.s, strlen(c.s), &v);
+        if (ok != (c.hz != 0) || (ok && v != c.hz)) wrongFreqs++;
+    }
+    simCheck(wrongFreqs == 0, "frequency formats", &failures);
+
+    // ---- MQTT frequency feed -> relays ----
+    const std::string freqTopic = std::string(mqttCfg.topicCmd.c_str()) + "/freq";
+    const Hop hops[] = {
+        {"14.074000", 3}, {"7074000", 2}, {"3573k", 1}, {"21.074", 4}, {"10.136", 2}, {"28.074", 4},
+        {"1.840", 1}, {"18.100", 3}, {"24.915", 4}, {"14.200", 3}, {"7.150", 2}, {"50.313", 0},
+    };
+    std::vector<double> firstMs, settledMs;
+    int wrongHops = 0;
+    for (const Hop& h : hops) {
+        const uint64_t sentUs = simNow();
+        simMqttInject(freqTopic, h.freq);
+        simRunFor(100000);
+        const Edges e = edgesAfter(sentUs, outputBit(h.antenna));
+        if (levels() != outputBit(h.antenna) || !e.settledUs) {
+            printf("  %s: outputs 0x%x, want antenna %d\n", h.freq, levels(), h.antenna);
+            wrongHops++;
+            continue;
+        }
+        firstMs.push_back((e.firstUs - sentUs) / 1000.0);
+        settledMs.push_back((e.settledUs - sentUs) / 1000.0);
+    }
+    const SimSummary mqttFirst = simSummarize(firstMs);
+    const SimSummary mqttSettled = simSummarize(settledMs);
+    printf("band: %zu band changes over MQTT\n", sizeof(hops) / sizeof(hops[0]));
+    simPrintSummary("freq->break", "ms", mqttFirst);
+    simPrintSummary("freq->settled", "ms", mqttSettled);
+    simCheck(wrongHops == 0, "every band change switches to its antenna", &failures);
+    const RelayLatency bandLatency = relayTaskStats().latency[RELAY_SRC_BAND];
+    printf("  device: frequency handled -> relay sequencer request max %u us\n", bandLatency.maxUs);
+    simCheck(bandLatency.overBudget == 0, "decoder to relay sequencer within RELAY_BUDGET_US", &failures);
+    simCheck(mqttFirst.max < 2.0, "relays start moving within 2 ms of the broker delivering the update", &failures);
+    simCheck(mqttSettled.max < DEAD_US / 1000.0 + 2.0, "settled within a dead time + 2 ms", &failures);
+    simCheck(bandDecoderStats().changes == sizeof(hops) / sizeof(hops[0]), "one relay command per band change",
+             &failures);
+
+    // ---- Tuning inside a band, manual override, gaps ----
+    simMqttInject(freqTopic, "14.074");
+    simRunFor(50000);
+    request(HTTP_GET, "/set?ant=1");
+    simRunFor(50000);
+    const uint32_t changes = bandDecoderStats().changes;
+    const uint32_t lookups = bandDecoderStats().lookups;
+    for (int i = 0; i < 20; i++) {
+        simMqttInject(freqTopic, std::to_string(14070000 + i * 1000));
+        simRunFor(20000);
+    }
+    simCheck(levels() == outputBit(1) && bandDecoderStats().changes == changes,
+             "manual selection kept while tuning inside the band", &failures);
+    simCheck(bandDecoderStats().lookups == lookups, "tuning inside the band needs no table lookup", &failures);
+    simMqttInject(freqTopic, "12.000");
+    simRunFor(50000);
+    simCheck(levels() == outputBit(1) && bandDecoderStats().unmapped > 0, "outside every band the selection holds",
+             &failures);
+    simMqttInject(freqTopic, "21.300");
+    simRunFor(50000);
+    simCheck(levels() == outputBit(4), "next band change switches again", &failures);
+
+    // ---- Hysteresis on a shared edge ----
+    postPlan("14000000-14099999 3; 14.1-14.35 2");
+    struct Jitter
+    {
+        uint32_t hysteresisHz;
+        uint32_t changes;
+        uint32_t relaySwitches;
+    } jitter[2] = {{BAND_HYSTERESIS_HZ, 0, 0}, {0, 0, 0}};
+    for (Jitter& j : jitter) {
+        postSettings("bandHystHz=" + std::to_string(j.hysteresisHz));
+        simMqttInject(freqTopic, "14.095");
+        simRunFor(50000);
+        const uint32_t c0 = bandDecoderStats().changes;
+        const uint32_t s0 = relaySequencerStats().transitions;
+        for (int i = 0; i < 40; i++) {
+            simMqttInject(freqTopic, std::to_string(i % 2 ? 14100300 : 14099700));
+            simRunFor(30000);
+        }
+        j.changes = bandDecoderStats().changes - c0;
+        j.relaySwitches = relaySequencerStats().transitions - s0;
+        printf("band: 40 updates jittering 300 Hz around the edge, hysteresis %u Hz: %u band changes\n",
+               j.hysteresisHz, j.changes);
+    }
+    simCheck(jitter[0].changes == 0 && jitter[0].relaySwitches == 0, "with hysteresis: no switching", &failures);
+    simCheck(jitter[1].changes == 39 && jitter[1].relaySwitches == 39, "without: a switch on every crossing",
+             &failures);
+    postSettings("bandHystHz=" + std::to_string(BAND_HYSTERESIS_HZ));
+    postPlan(HF_PLAN);
+
+    // ---- FlexRadio status stream ----
+    struct Radio
+    {
+        int conn = -1;
+        int accepts = 0;
+        std::string received;
+    };
+    static Radio radio;
+    radio = Radio();
+    simTcpServe(FLEX_PORT, [](int conn) {
+        radio.conn = conn;
+        radio.accepts++;
+        simTcpOnReceive(conn, [](const std::string& data) { radio.received += data; });
+        simTcpSend(conn, "V1.4.0.0\nH2A7F10B3\n");
+    });
+    postSettings("radioIP=192.168.1.50&radioSlice=1");
+    simRunUntil([] { return flexRadioStats().connected && radio.received.size() > 0; }, 2000000);
+    simRunFor(50000);
+    simCheck(radio.received == "C1|sub slice all\n", "status client subscribes to slices", &failures);
+
+    const uint32_t beforeFlex = levels();
+    simTcpSend(radio.conn, "R1|0|\nS2A7F10B3|slice 0 in_use=1 RF_frequency=7.074000 mode=DIGU\n");
+    simRunFor(100000);
+    simCheck(levels() == beforeFlex && flexRadioStats().lines == 4 && flexRadioStats().frequencies == 0,
+             "other slices ignored", &failures);
+
+    const Hop flexHops[] = {{"7.040000", 2}, {"14.074000", 3}, {"28.500000", 4}, {"3.650000", 1}, {"18.110000", 3}};
+    std::vector<double> flexSettled, flexDevice;
+    int wrongFlex = 0;
+    for (const Hop& h : flexHops) {
+        const uint64_t sentUs = simNow();
+        const std::string line = std::string("S2A7F10B3|slice 1 in_use=1 RF_frequency=") + h.freq +
+                                 " mode=USB filter_lo=100 filter_hi=2900\n";
+        // Split mid-line, as a TCP segment boundary may
+        simTcpSend(radio.conn, line.substr(0, 20));
+        simTcpSend(radio.conn, line.substr(20));
+        simRunFor(100000);
+        const Edges e = edgesAfter(sentUs, outputBit(h.antenna));
+        if (levels() != outputBit(h.antenna) || !e.settledUs) {
+            wrongFlex++;
+            continue;
+        }
+        flexSettled.push_back((e.settledUs - sentUs) / 1000.0);
+        flexDevice.push_back((e.firstUs - sentUs - simCosts.tcpLatencyUs) / 1000.0);
+    }
+    const SimSummary flexDev = simSummarize(flexDevice);
+    const SimSummary flexSum = simSummarize(flexSettled);
+    printf("band: %zu band changes from the FlexRadio stream\n", sizeof(flexHops) / sizeof(flexHops[0]));
+    simPrintSummary("arrival->break", "ms", flexDev);
+    simPrintSummary("radio->settled", "ms", flexSum);
+    simCheck(wrongFlex == 0, "slice status lines switch bands, split lines reassembled", &failures);
+    simCheck(flexDev.max < 1.0, "relays start moving within 1 ms of the status line arriving", &failures);
+
+    // Radio drops the connection: retried after FLEX_RETRY_MS
+    const uint64_t droppedUs = simNow();
+    simTcpClose(radio.conn);
+    simRunUntil([] { return radio.accepts == 2 && flexRadioStats().connected; }, 10000000);
+    const double reconnectS = (simNow() - droppedUs) / 1e6;
+    printf("band: reconnected %.2f s after the radio closed the stream\n", reconnectS);
+    simCheck(radio.accepts == 2 && flexRadioStats().connects == 2 && reconnectS < FLEX_RETRY_MS / 1000.0 + 1,
+             "status client reconnects", &failures);
+
+    // Switched off in settings: the stream closes and stays closed
+    postSettings("radioIP=");
+    simRunFor(FLEX_RETRY_MS * 2000ULL);
+    simCheck(!flexRadioStats().connected && radio.accepts == 2 && !simTcpOpen(radio.conn), "blank radio IP stops it",
+             &failures);
+    simTcpServe(FLEX_PORT, nullptr);
+
+    // ---- Plan from NVS ----
+    std::vector<uint8_t> blob;
+    simNvsRead("antSwitch", "bandplan", &blob);
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    const uint64_t writesBefore = simNvsKeyWrites("antSwitch", "bandplan");
+    postPlan(HF_PLAN);
+    simCheck(request(HTTP_GET, "/bandplan")->response == HF_CANONICAL && blob.size() == 4 + 10 * 12,
+             "plan restored after a reboot (124 byte blob)", &failures);
+    simCheck(simNvsKeyWrites("antSwitch", "bandplan") == writesBefore, "same plan again: no NVS write", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject().field("scenario", "band");
+        json.field("max_probes", maxProbes);
+        simWriteSummary(json, "mqtt_freq_to_break_ms", mqttFirst);
+        simWriteSummary(json, "mqtt_freq_to_settled_ms", mqttSettled);
+        simWriteSummary(json, "flex_arrival_to_break_ms", flexDev);
+        simWriteSummary(json, "flex_radio_to_settled_ms", flexSum);
+        json.field("jitter_changes_hysteresis", jitter[0].changes)
+            .field("jitter_changes_none", jitter[1].changes)
+            .field("failures", failures)
+            .endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,355 @@
+// --------------------------------------------------
+// Scenario: multicast state beacons
+//
+// Off by default; turned on in /settings. Then the protocol: a beacon
+// of the current state at once, heartbeats while idle, one beacon per
+// change within a loop pass, a burst folded into the gap with the final
+// state and no seq gap, the lock flag, the MAC with a key set, and seq
+// back to 1 after a reboot. Last the benchmark: 1 to 64 observers
+// following a switch that changes every 2 s, either polling /state
+// once a second or listening to beacons, and the device time in
+// sockets for each (as in the events scenario).
+// --------------------------------------------------
+
+#include "antenna_switch.h"
+#include "hal.h"
+#include "relay_task.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+#include "udp_control.h"
+
+namespace {
+
+const uint16_t PORT        = UDP_BEACON_PORT;
+const uint16_t HEARTBEAT_S = 5;
+const uint64_t CHANGE_US   = 2000000;    // benchmark: one change every 2 s
+const uint64_t POLL_US     = 1000000;    // ... a /state poll per observer every 1 s
+const int      OBSERVERS[] = {1, 4, 16, 64};
+
+const SimHttpRequest* request(HTTPMethod method, const std::string& uri, const std::string& body = "")
+{
+    const uint32_t id = simHttpRequest(method, uri, body);
+    simRunUntil([id] { return simHttpResult(id)->respondedUs != 0 || simHttpResult(id)->code < 0; }, 5000000);
+    return simHttpResult(id);
+}
+
+// Settings that apply without a reboot; MQTT stays on.
+void postSettings(const std::string& fields)
+{
+    request(HTTP_POST, "/settings", "mqttEnabled=on&" + fields);
+}
+
+uint32_t get32(const std::string& d, size_t at)
+{
+    const uint8_t* p = (const uint8_t*)d.data() + at;
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+struct Beacon
+{
+    uint64_t atUs;
+    uint32_t seq;
+    int      antenna;
+    uint8_t  flags;
+    uint8_t  source;
+    uint32_t outputs;
+    uint32_t version;
+    uint32_t uptime;
+    size_t   size;
+};
+
+// Beacons the host received since from (index into simUdpReceived())
+std::vector<Beacon> beaconsSince(size_t from)
+{
+    std::vector<Beacon> v;
+    const std::vector<SimUdpDatagram>& all = simUdpReceived();
+    for (size_t i = from; i < all.size(); i++) {
+        const SimUdpDatagram& d = all[i];
+        if (d.group != UDP_BEACON_GROUP || d.port != PORT || d.data.size() < UDP_BEACON_SIZE) continue;
+        if (d.data[0] != 'A' || d.data[1] != 'S' || (uint8_t)d.data[3] != UDP_OP_BEACON) continue;
+        v.push_back(Beacon{d.atUs, get32(d.data, 4), (int8_t)d.data[8], (uint8_t)d.data[10], (uint8_t)d.data[11],
+                           get32(d.data, 12), get32(d.data, 16), get32(d.data, 20), d.data.size()});
+    }
+    return v;
+}
+
+bool seqContiguous(const std::vector<Beacon>& v)
+{
+    for (size_t i = 1; i < v.size(); i++) {
+        if (v[i].seq != v[i - 1].seq + 1) return false;
+    }
+    return true;
+}
+
+uint32_t lcg(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+struct Run
+{
+    int      observers;
+    double   pollMsPerS;     // device time in sockets over the idle run, per second
+    double   beaconMsPerS;
+    double   pollStaleMs;    // change -> an observer has it, mean
+    double   beaconStaleMs;
+    uint64_t polls;
+    uint64_t beacons;
+};
+
+// Changes every CHANGE_US for seconds; observers poll /state, or just
+// listen. Returns the device time in sockets, ms per second.
+double follow(int observers, bool poll, int seconds, uint32_t* rng, double* staleMs, uint64_t* messages)
+{
+    const uint64_t startUs = simNow();
+    const uint64_t endUs = startUs + seconds * 1000000ULL;
+    const size_t udpFrom = simUdpReceived().size();
+    std::vector<uint64_t> changes;
+    std::vector<std::vector<uint32_t>> polls(observers);
+    int ant = relaySnapshot().antenna;
+    for (uint64_t t = startUs + CHANGE_US / 2; t < endUs; t += CHANGE_US) {
+        ant = ant % 4 + 1;
+        changes.push_back(t);
+        simAt(t, [ant] { setAntenna(ant, RELAY_SRC_LOCAL); });
+    }
+    if (poll) {
+        for (int o = 0; o < observers; o++) {
+            for (uint64_t t = startUs + lcg(rng) % POLL_US; t < endUs; t += POLL_US) {
+                simAt(t, [&polls, o] { polls[o].push_back(simHttpRequest(HTTP_GET, "/state")); });
+            }
+        }
+    }
+    simTcpResetStats();
+    simRunFor(endUs - startUs);
+    const double busyMsPerS = simTcpStats().busyUs / 1000.0 / seconds;
+    simRunUntil([] { return simHttpPending() == 0; }, 5000000);
+
+    // Staleness: from each change to the first answer (poll) or beacon
+    // (every listener gets the same datagram) carrying it
+    double totalMs = 0;
+    uint64_t seen = 0;
+    *messages = 0;
+    if (poll) {
+        for (int o = 0; o < observers; o++) {
+            *messages += polls[o].size();
+            for (uint64_t c : changes) {
+                for (uint32_t id : polls[o]) {
+                    const SimHttpRequest* r = simHttpResult(id);
+                    if (r->startedUs > c + 1000 && r->respondedUs) {
+                        totalMs += (r->respondedUs - c) / 1000.0;
+                        seen++;
+                        break;
+                    }
+                }
+            }
+        }
+    } else {
+        const std::vector<Beacon> b = beaconsSince(udpFrom);
+        *messages = b.size();
+        for (uint64_t c : changes) {
+            for (const Beacon& x : b) {
+                if (x.atUs > c && (x.flags & UDP_BEACON_CHANGE)) {
+                    totalMs += observers * (x.atUs - c) / 1000.0;
+                    seen += observers;
+                    break;
+                }
+            }
+        }
+    }
+    *staleMs = seen ? totalMs / seen : 0;
+    return busyMsPerS;
+}
+
+} // namespace
+
+int scenarioBeacon(const SimOptions& opt)
+{
+    int failures = 0;
+    const int seconds = opt.count ? (int)opt.count : 60;
+    uint32_t rng = opt.seed;
+
+    simNvsErase();
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    size_t from = simUdpReceived().size();
+    setAntenna(2, RELAY_SRC_LOCAL);
+    simRunFor(15000000);
+    simCheck(beaconsSince(from).empty() && udpBeaconStats().seq == 0, "off by default: nothing sent", &failures);
+
+    // ---- On: the current state at once ----
+    from = simUdpReceived().size();
+    const uint64_t onUs = simNow();
+    postSettings("beaconPort=" + std::to_string(PORT) + "&beaconHeartbeatS=" + std::to_string(HEARTBEAT_S));
+    simRunFor(50000);
+    std::vector<Beacon> b = beaconsSince(from);
+    const RelaySnapshot s = relaySnapshot();
+    simCheck(udpCfg.beaconPort == PORT && (uint32_t)udpCfg.beaconGroup == UDP_BEACON_GROUP,
+             "port set in /settings, default group", &failures);
+    simCheck(b.size() == 1 && b[0].seq == 1 && b[0].antenna == 2 && b[0].outputs == 2 && b[0].version == s.version &&
+                 b[0].size == UDP_BEACON_SIZE && b[0].atUs - onUs < 50000,
+             "first beacon at once: seq 1, the current state", &failures);
+    simCheck(b.size() == 1 && b[0].uptime == (uint32_t)(b[0].atUs / 1000000), "... uptime in seconds", &failures);
+
+    // ---- Heartbeats while idle ----
+    from = simUdpReceived().size();
+    simRunFor(31000000);
+    b = beaconsSince(from);
+    bool even = !b.empty();
+    for (size_t i = 1; i < b.size(); i++) {
+        const uint64_t gap = b[i].atUs - b[i - 1].atUs;
+        even = even && gap >= HEARTBEAT_S * 1000000ULL && gap < HEARTBEAT_S * 1000000ULL + 20000;
+        even = even && !(b[i].flags & UDP_BEACON_CHANGE);
+    }
+    printf("idle 31 s: %zu heartbeats\n", b.size());
+    simCheck(b.size() == 6 && even, "a heartbeat every 5 s, nothing else", &failures);
+
+    // ---- One beacon per change, within a loop pass ----
+    from = simUdpReceived().size();
+    std::vector<double> latencyMs;
+    std::vector<uint64_t> changedUs;
+    for (int i = 0; i < 50; i++) {
+        simRunFor(200000 + lcg(&rng) % 300000);
+        changedUs.push_back(simNow());
+        setAntenna(i % 4 + 1, RELAY_SRC_LOCAL);
+    }
+    simRunFor(200000);
+    b = beaconsSince(from);
+    int changeBeacons = 0;
+    for (const Beacon& x : b) changeBeacons += (x.flags & UDP_BEACON_CHANGE) != 0;
+    for (uint64_t c : changedUs) {
+        for (const Beacon& x : b) {
+            if (x.atUs > c && (x.flags & UDP_BEACON_CHANGE)) {
+                latencyMs.push_back((x.atUs - c) / 1000.0);
+                break;
+            }
+        }
+    }
+    const SimSummary change = simSummarize(latencyMs);
+    simPrintSummary("change -> beacon", "ms", change);
+    simCheck(changeBeacons == 50 && seqContiguous(b) && b.back().antenna == 2 && b.back().source == RELAY_SRC_LOCAL,
+             "50 changes, 50 change beacons, seq without gaps", &failures);
+    simCheck(change.count == 50 && change.max < 10, "each on the LAN within 10 ms", &failures);
+
+    // ---- A burst folds into the gap ----
+    simRunFor(1000000);
+    from = simUdpReceived().size();
+    const uint32_t coalesced = udpBeaconStats().coalesced;
+    const uint64_t burstUs = simNow();
+    for (int i = 0; i < 20; i++) simAt(burstUs + i * 500, [i] { setAntenna(i % 4 + 1, RELAY_SRC_UDP); });
+    simRunFor(200000);
+    b = beaconsSince(from);
+    printf("20 changes in 10 ms: %zu beacons, %u folded\n", b.size(), udpBeaconStats().coalesced - coalesced);
+    simCheck(b.size() >= 1 && b.size() <= 2 && b.back().antenna == 4 && b.back().version == relaySnapshot().version &&
+                 udpBeaconStats().coalesced > coalesced && seqContiguous(b),
+             "burst: at most one beacon per gap, ending on the final state", &failures);
+
+    // ---- Lock flag ----
+    simRunFor(1000000);
+    from = simUdpReceived().size();
+    request(HTTP_GET, "/lock?on=1");
+    simRunFor(50000);
+    b = beaconsSince(from);
+    simCheck(b.size() == 1 && (b[0].flags & UDP_BEACON_LOCKED), "lock on: a beacon with the flag", &failures);
+    request(HTTP_GET, "/lock?on=0");
+    simRunFor(50000);
+
+    // ---- MAC ----
+    postSettings("udpKey=beacon-key");
+    simRunFor(1000000);
+    from = simUdpReceived().size();
+    setAntenna(3, RELAY_SRC_LOCAL);
+    simRunFor(50000);
+    bool macOk = false;
+    const std::vector<SimUdpDatagram>& all = simUdpReceived();
+    for (size_t i = from; i < all.size(); i++) {
+        const SimUdpDatagram& d = all[i];
+        if (d.group != UDP_BEACON_GROUP || d.data.size() != UDP_BEACON_SIZE + UDP_MAC_SIZE) continue;
+        uint8_t mac[UDP_MAC_SIZE];
+        udpControlMac("beacon-key", (const uint8_t*)d.data.data(), UDP_BEACON_SIZE, mac);
+        macOk = !memcmp(mac, d.data.data() + UDP_BEACON_SIZE, UDP_MAC_SIZE);
+    }
+    simCheck(macOk, "with a key set, beacons carry the MAC", &failures);
+    postSettings("udpKey=");
+
+    // ---- Reboot ----
+    simRunFor(10000000);     // the journal has antenna 3
+    const uint32_t before = udpBeaconStats().seq;
+    from = simUdpReceived().size();
+    simBoot();
+    simRunFor(3000000);
+    b = beaconsSince(from);
+    // (The virtual clock, halMicros() included, runs on across a reboot, so
+    // uptime does not start again here as it does on the board.)
+    simCheck(before > 50 && !b.empty() && b[0].seq == 1 && b[0].antenna == 3,
+             "after a reboot: seq 1, the restored state", &failures);
+    simRunUntil([] { return simMqttConnects() > 1; }, 30000000);
+
+    // ---- Benchmark: observers polling /state vs. listening ----
+    // The idle run (no observers, no beacons) is the floor: loop() polls
+    // its sockets whoever is watching.
+    double staleMs;
+    uint64_t messages;
+    postSettings("beaconPort=0");
+    simRunFor(2000000);
+    const double idleMsPerS = follow(0, true, seconds, &rng, &staleMs, &messages);
+    std::vector<Run> runs;
+    for (int n : OBSERVERS) {
+        Run r = {n, 0, 0, 0, 0, 0, 0};
+        simRunFor(2000000);
+        r.pollMsPerS = follow(n, true, seconds, &rng, &r.pollStaleMs, &r.polls) - idleMsPerS;
+        runs.push_back(r);
+    }
+    postSettings("beaconPort=" + std::to_string(PORT));
+    for (Run& r : runs) {
+        simRunFor(2000000);
+        r.beaconMsPerS = follow(r.observers, false, seconds, &rng, &r.beaconStaleMs, &r.beacons) - idleMsPerS;
+    }
+    printf("%d s per run, a change every %.0f s; device time in sockets above idle (%.2f ms/s):\n", seconds,
+           CHANGE_US / 1e6, idleMsPerS);
+    printf("  observers   poll: ms/s  stale ms  requests   beacon: ms/s  stale ms  beacons\n");
+    for (const Run& r : runs) {
+        printf("  %9d  %10.3f %9.1f %9llu  %12.3f %9.1f %8llu\n", r.observers, r.pollMsPerS, r.pollStaleMs,
+               (unsigned long long)r.polls, r.beaconMsPerS, r.beaconStaleMs, (unsigned long long)r.beacons);
+    }
+    const Run& one = runs.front();
+    const Run& most = runs.back();
+    simCheck(most.beaconMsPerS <= one.beaconMsPerS * 1.05 + 0.001,
+             "beacons: device time flat from 1 to 64 observers", &failures);
+    simCheck(most.pollMsPerS >= one.pollMsPerS * 32, "polling: it grows with the observers", &failures);
+    simCheck(most.beaconMsPerS < one.pollMsPerS, "64 listeners cost less than one poller", &failures);
+    simCheck(most.beaconStaleMs < 10 && most.beaconStaleMs * 20 < most.pollStaleMs,
+             "... and see each change sooner", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "beacon")
+            .field("seconds", seconds)
+            .field("heartbeat_s", HEARTBEAT_S)
+            .field("idle_ms_per_s", idleMsPerS);
+        simWriteSummary(json, "change_ms", change);
+        json.beginArray("observers");
+        for (const Run& r : runs) {
+            json.beginObject()
+                .field("observers", r.observers)
+                .field("poll_ms_per_s", r.pollMsPerS)
+                .field("poll_stale_ms", r.pollStaleMs)
+                .field("polls", r.polls)
+                .field("beacon_ms_per_s", r.beaconMsPerS)
+                .field("beacon_stale_ms", r.beaconStaleMs)
+                .field("beacons", r.beacons)
+                .endObject();
+        }
+        json.endArray().field("failures", failures).endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,161 @@
+// --------------------------------------------------
+// Scenario: boot
+//
+// Power-cycles a switch left on antenna 3 and times each startup from
+// setup(): relays restored, services listening, WiFi up, MQTT up. The
+// first boot has no cached AP and scans every channel; the next joins
+// the cached AP directly, then with a static IP as well (no DHCP); last
+// the AP has moved channel, so the cached join misses and a full scan
+// follows.
+// --------------------------------------------------
+
+#include <Preferences.h>
+
+#include "antenna_switch.h"
+#include "config_store.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+#include "state_journal.h"
+#include "wifi_supervisor.h"
+
+namespace {
+
+const int ANTENNA = 3;
+const int ANTENNA_PIN = 18;          // OUTPUT_MAP_DEFAULT: gpio 16 17 18 19
+
+struct Boot
+{
+    const char* name;
+    BootTimes times;
+    uint64_t edgeUs;             // antenna pin high, after power-on
+    WifiSupervisorStats wifi;
+    uint64_t fullScans;
+    uint64_t dhcp;
+    uint64_t cacheWrites;
+};
+
+Boot powerCycle(const char* name)
+{
+    Boot b = {name, {}, 0, {}, 0, 0, 0};
+    const SimWifiStats before = simWifiStats();
+    const uint64_t cacheBefore = simNvsKeyWrites("antSwitch", WIFI_AP_CACHE_KEY);
+    const size_t edges = simGpioEdges().size();
+    const uint64_t t0 = simNow();
+    simBoot();
+    simRunUntil([] { return bootTimes.mqttUs != 0; }, 30000000);
+    for (size_t i = edges; i < simGpioEdges().size(); i++) {
+        const SimGpioEdge& e = simGpioEdges()[i];
+        if (e.pin == ANTENNA_PIN && e.level == HIGH) {
+            b.edgeUs = e.atUs - t0;
+            break;
+        }
+    }
+    b.times = bootTimes;
+    b.wifi = wifiSupervisorStats();
+    b.fullScans = simWifiStats().fullScans - before.fullScans;
+    b.dhcp = simWifiStats().dhcp - before.dhcp;
+    b.cacheWrites = simNvsKeyWrites("antSwitch", WIFI_AP_CACHE_KEY) - cacheBefore;
+    simRunFor(1000000);
+    return b;
+}
+
+void printBoot(const Boot& b)
+{
+    printf("  %-16s relays %5.1f ms  services %5.1f ms  wifi %7.1f ms  mqtt %7.1f ms  (%llu full scan%s, %s)\n",
+           b.name, b.times.relaysUs / 1000.0, b.times.servicesUs / 1000.0, b.times.wifiUs / 1000.0,
+           b.times.mqttUs / 1000.0, (unsigned long long)b.fullScans, b.fullScans == 1 ? "" : "s",
+           b.dhcp ? "DHCP" : "static IP");
+}
+
+} // namespace
+
+int scenarioBoot(const SimOptions& opt)
+{
+    int failures = 0;
+    std::vector<Boot> boots;
+
+    // Antenna 3 in the journal, no cached AP
+    simNvsErase();
+    simWifiSetApChannel(6);
+    simBoot();
+    simRunUntil([] { return wifiOnline(); }, 30000000);
+    setAntenna(ANTENNA, RELAY_SRC_LOCAL);
+    simRunFor(100000);
+    journalFlush();
+    {
+        Preferences p;
+        p.begin("antSwitch", false);
+        p.remove(WIFI_AP_CACHE_KEY);
+        p.end();
+    }
+
+    boots.push_back(powerCycle("scan + DHCP"));
+    boots.push_back(powerCycle("cached AP"));
+
+    wifiCfg.staticIP = IPAddress(192, 168, 1, 40);
+    configSave();
+    boots.push_back(powerCycle("cached + static"));
+
+    simWifiSetApChannel(11);
+    boots.push_back(powerCycle("AP moved"));
+
+    printf("boot (from setup()):\n");
+    for (const Boot& b : boots) printBoot(b);
+
+    const Boot& cold = boots[0];
+    const Boot& cached = boots[1];
+    const Boot& fixed = boots[2];
+    const Boot& moved = boots[3];
+    bool relaysFirst = true, restored = true, mqttAtOnce = true;
+    for (const Boot& b : boots) {
+        relaysFirst = relaysFirst && b.times.relaysUs > 0 && b.times.relaysUs < 20000;
+        restored = restored && b.edgeUs > 0 && b.edgeUs < 20000 + relayCfg.deadTimeMs * 1000ULL;
+        mqttAtOnce = mqttAtOnce && b.times.mqttUs > b.times.wifiUs &&
+                     b.times.mqttUs - b.times.wifiUs < simCosts.mqttConnectUs + 100000;
+    }
+    simCheck(relaysFirst, "relays restored within 20 ms of setup()", &failures);
+    simCheck(restored, "... antenna 3 back on its pin", &failures);
+    simCheck(boots.back().times.servicesUs < 50000, "services up within 50 ms", &failures);
+    simCheck(mqttAtOnce, "MQTT connects as soon as WiFi is up", &failures);
+    simCheck(cold.fullScans == 1 && cold.cacheWrites == 1, "first boot scans and caches the AP", &failures);
+    simCheck(cached.wifi.cachedJoin && cached.fullScans == 0 && cached.cacheWrites == 0,
+             "next boot joins the cached AP without a scan or a write", &failures);
+    simCheck(cached.times.wifiUs + simCosts.wifiScanUs - simCosts.wifiChannelScanUs <= cold.times.wifiUs + 50000,
+             "... and is up a full scan sooner", &failures);
+    simCheck(fixed.dhcp == 0 && fixed.times.wifiUs + simCosts.wifiDhcpUs <= cached.times.wifiUs + 50000,
+             "a static IP skips DHCP", &failures);
+    simCheck(moved.wifi.cacheMisses == 1 && moved.fullScans == 1 && moved.cacheWrites == 1 && moved.times.wifiUs > 0,
+             "AP on a new channel: cached join misses, scans, caches the new one", &failures);
+    simCheck(moved.times.wifiUs < cold.times.wifiUs + WIFI_CACHED_TIMEOUT_MS * 1000ULL,
+             "... without waiting out a backoff", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject().field("scenario", "boot");
+        json.beginArray("boots");
+        for (const Boot& b : boots) {
+            json.beginObject()
+                .field("name", b.name)
+                .field("relays_us", b.times.relaysUs)
+                .field("services_us", b.times.servicesUs)
+                .field("wifi_us", b.times.wifiUs)
+                .field("mqtt_us", b.times.mqttUs)
+                .field("full_scans", b.fullScans)
+                .field("dhcp", b.dhcp)
+                .endObject();
+        }
+        json.endArray();
+        json.field("failures", failures).endObject();
+        fclose(f);
+    }
+
+    // Leave the simulated world as other scenarios expect it
+    simWifiSetApChannel(6);
+    return failures ? 1 : 0;
+}
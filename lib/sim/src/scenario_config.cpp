@@ -0,0 +1,350 @@
+// --------------------------------------------------
+// Scenario: settings record
+//
+// Boots on the per-key settings older firmware left in NVS and times
+// that layout's reads against the single record they are converted to,
+// then saves /settings the way a user does (nothing changed, one field
+// changed) and counts NVS writes and bytes against the old
+// every-key-on-every-save. Last, the record's edges: longest strings,
+// records from older and newer firmware (after a rollback) and a
+// corrupt one, and the whole form posted with every field at its
+// longest.
+// --------------------------------------------------
+
+#include <Preferences.h>
+
+#include "antenna_switch.h"
+#include "config_store.h"
+#include "http_server.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+#include "udp_control.h"
+
+namespace {
+
+const SimHttpRequest* request(HTTPMethod method, const std::string& uri, const std::string& body = "")
+{
+    const uint32_t id = simHttpRequest(method, uri, body);
+    simRunUntil([id] { return simHttpResult(id)->respondedUs != 0 || simHttpResult(id)->code < 0; }, 5000000);
+    return simHttpResult(id);
+}
+
+// The form as the page posts it, with the settings in effect
+std::string form()
+{
+    return "wifiSSID=" + std::string(wifiCfg.ssid.c_str()) + "&wifiPass=" + wifiCfg.password.c_str() +
+           "&mqttEnabled=on&mqttBroker=" + mqttCfg.broker.c_str() + "&mqttPort=" + std::to_string(mqttCfg.port) +
+           "&mqttUser=" + mqttCfg.user.c_str() + "&mqttPass=" + mqttCfg.password.c_str() +
+           "&mqttCmd=" + mqttCfg.topicCmd.c_str() + "&mqttState=" + mqttCfg.topicState.c_str() +
+           "&relayDeadMs=" + std::to_string(relayCfg.deadTimeMs) + "&radioSlice=" + std::to_string(bandCfg.slice) +
+           "&bandHystHz=" + std::to_string(bandCfg.hysteresisHz) + "&pttPin=" + std::to_string(txCfg.pttPin) +
+           (txCfg.pttActiveLow ? "&pttActiveLow=on" : "") + "&ampKeyPin=" + std::to_string(txCfg.ampKeyPin) +
+           "&udpPort=" + std::to_string(udpCfg.port) + "&udpKey=" + udpCfg.key.c_str();
+}
+
+// Every field of the page at its longest, each text character one that
+// is sent as %XX
+std::string longestForm()
+{
+    const std::string text(CONFIG_STRING_MAX, '&');
+    std::string map = OUTPUT_MAP_DEFAULT;
+    map.resize(OUTPUT_MAP_MAX - 1, '\n');
+    const std::pair<const char*, std::string> fields[] = {
+        {"wifiSSID", text}, {"wifiPass", text}, {"gatewayIP", "192.168.100.200"}, {"staticIP", "192.168.100.200"},
+        {"subnet", "255.255.255.0"}, {"mqttEnabled", "on"}, {"mqttBroker", text}, {"mqttPort", "65535"},
+        {"mqttUser", text}, {"mqttPass", text}, {"mqttCmd", text}, {"mqttState", text}, {"relayDeadMs", "1000"},
+        {"outputMap", map}, {"cmdWindowMs", std::to_string(RELAY_WINDOW_MAX_MS)}, {"prioHttp", "9"},
+        {"prioLocal", "9"}, {"prioMqtt", "9"}, {"prioUdp", "9"}, {"prioSchedule", "9"}, {"prioBand", "9"},
+        {"radioIP", "192.168.100.200"}, {"radioSlice", "7"}, {"bandHystHz", "100000"}, {"pttPin", "-1"},
+        {"pttActiveLow", "on"}, {"ampKeyPin", "-1"}, {"swrFwdPin", "-1"}, {"swrReflPin", "-1"},
+        {"swrTrip", "99.0"}, {"swrFullW", "10000"}, {"udpPort", "65535"},
+        {"udpKey", std::string(UDP_KEY_MAX, '&')}, {"beaconGroup", "239.255.255.255"}, {"beaconPort", "65535"},
+        {"beaconHeartbeatS", "3600"}};
+    std::string form;
+    char hex[4];
+    for (const auto& f : fields) {
+        form += (form.empty() ? "" : "&") + std::string(f.first) + "=";
+        for (char ch : f.second) {
+            snprintf(hex, sizeof(hex), "%%%02X", (uint8_t)ch);
+            form += ch == '&' || ch == '\n' ? hex : std::string(1, ch);
+        }
+    }
+    return form;
+}
+
+// What firmware before the record wrote on every save
+void legacySave(Preferences& p)
+{
+    p.putString("wifiSSID", wifiCfg.ssid);
+    p.putString("wifiPass", wifiCfg.password);
+    p.putUInt("gatewayIP", (uint32_t)wifiCfg.gatewayIP);
+    p.putBool("mqttEnabled", mqttCfg.enabled);
+    p.putString("mqttBroker", mqttCfg.broker);
+    p.putUShort("mqttPort", mqttCfg.port);
+    p.putString("mqttUser", mqttCfg.user);
+    p.putString("mqttPass", mqttCfg.password);
+    p.putString("mqttCmd", mqttCfg.topicCmd);
+    p.putString("mqttState", mqttCfg.topicState);
+    p.putUShort("relayDeadMs", relayCfg.deadTimeMs);
+    p.putString("outputMap", relayCfg.outputMap);
+    p.putUInt("radioIP", (uint32_t)bandCfg.radioIP);
+    p.putUChar("radioSlice", bandCfg.slice);
+    p.putUInt("bandHystHz", bandCfg.hysteresisHz);
+    p.putChar("pttPin", txCfg.pttPin);
+    p.putBool("pttActiveLow", txCfg.pttActiveLow);
+    p.putChar("ampKeyPin", txCfg.ampKeyPin);
+    p.putUShort("udpPort", udpCfg.port);
+    p.putString("udpKey", udpCfg.key);
+}
+
+// ... and read at boot
+void legacyLoad(Preferences& p)
+{
+    p.getString("wifiSSID", "");
+    p.getString("wifiPass", "");
+    p.getUInt("gatewayIP", 0);
+    p.getBool("mqttEnabled", true);
+    p.getString("mqttBroker", "");
+    p.getUShort("mqttPort", 0);
+    p.getString("mqttUser", "");
+    p.getString("mqttPass", "");
+    p.getString("mqttCmd", "");
+    p.getString("mqttState", "");
+    p.getUShort("relayDeadMs", 0);
+    p.getString("outputMap", "");
+    p.getUInt("radioIP", 0);
+    p.getUChar("radioSlice", 0);
+    p.getUInt("bandHystHz", 0);
+    p.getChar("pttPin", -1);
+    p.getBool("pttActiveLow", true);
+    p.getChar("ampKeyPin", -1);
+    p.getUShort("udpPort", 0);
+    p.getString("udpKey", "");
+}
+
+struct Snapshot
+{
+    std::string ssid, password, broker, user, mqttPassword, cmd, state, map, key;
+    uint32_t gateway, radio, hyst;
+    uint16_t mqttPort, dead, udpPort;
+    uint8_t slice;
+    int8_t ptt, amp;
+    bool enabled, activeLow;
+
+    bool operator==(const Snapshot& o) const
+    {
+        return ssid == o.ssid && password == o.password && broker == o.broker && user == o.user &&
+               mqttPassword == o.mqttPassword && cmd == o.cmd && state == o.state && map == o.map && key == o.key &&
+               gateway == o.gateway && radio == o.radio && hyst == o.hyst && mqttPort == o.mqttPort &&
+               dead == o.dead && udpPort == o.udpPort && slice == o.slice && ptt == o.ptt && amp == o.amp &&
+               enabled == o.enabled && activeLow == o.activeLow;
+    }
+};
+
+Snapshot snapshot()
+{
+    return Snapshot{wifiCfg.ssid.c_str(), wifiCfg.password.c_str(), mqttCfg.broker.c_str(), mqttCfg.user.c_str(),
+                    mqttCfg.password.c_str(), mqttCfg.topicCmd.c_str(), mqttCfg.topicState.c_str(),
+                    relayCfg.outputMap.c_str(), udpCfg.key.c_str(), (uint32_t)wifiCfg.gatewayIP,
+                    (uint32_t)bandCfg.radioIP, bandCfg.hysteresisHz, mqttCfg.port, relayCfg.deadTimeMs, udpCfg.port,
+                    bandCfg.slice, txCfg.pttPin, txCfg.ampKeyPin, mqttCfg.enabled, txCfg.pttActiveLow};
+}
+
+uint32_t crc32(const uint8_t* p, size_t n)
+{
+    uint32_t crc = 0xffffffff;
+    while (n--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+// Rewrites the stored record's header after its payload was edited
+void reseal(std::vector<uint8_t>* b, uint8_t version)
+{
+    const uint32_t payload = (uint32_t)(b->size() - CONFIG_HEADER);
+    const uint32_t crc = crc32(b->data() + CONFIG_HEADER, payload);
+    (*b)[1] = version;
+    (*b)[2] = (uint8_t)payload;
+    (*b)[3] = (uint8_t)(payload >> 8);
+    for (int i = 0; i < 4; i++) (*b)[4 + i] = (uint8_t)(crc >> (8 * i));
+}
+
+struct Cost
+{
+    uint64_t us;
+    uint64_t reads;
+    uint64_t commits;
+    uint64_t bytes;
+};
+
+template <typename F> Cost measure(F f)
+{
+    const SimNvsStats before = simNvsStats();
+    const uint64_t t0 = simNow();
+    f();
+    const SimNvsStats& after = simNvsStats();
+    return Cost{simNow() - t0, after.reads - before.reads, after.commits - before.commits,
+                after.bytesWritten - before.bytesWritten};
+}
+
+} // namespace
+
+int scenarioConfig(const SimOptions& opt)
+{
+    int failures = 0;
+
+    // ---- Upgrade from per-key settings ----
+    simNvsErase();
+    simBoot();
+    wifiCfg.ssid = "shack-ap";
+    wifiCfg.password = "correct-horse-battery";
+    mqttCfg.broker = "10.0.0.20";
+    mqttCfg.port = 8883;
+    mqttCfg.user = "switch";
+    mqttCfg.password = "s3cret";
+    mqttCfg.topicCmd = "shack/antenna/cmd";
+    mqttCfg.topicState = "shack/antenna/state";
+    relayCfg.deadTimeMs = 25;
+    bandCfg.radioIP = IPAddress(10, 0, 0, 30);
+    bandCfg.slice = 1;
+    txCfg.pttPin = 27;
+    udpCfg.key = "key-for-udp";
+    const Snapshot wanted = snapshot();
+
+    simNvsErase();
+    Cost legacyWrite;
+    {
+        Preferences p;
+        p.begin("antSwitch", false);
+        legacyWrite = measure([&] { legacySave(p); });
+        p.end();
+    }
+    const Cost legacyRead = measure([] {
+        Preferences p;
+        p.begin("antSwitch", true);
+        legacyLoad(p);
+        p.end();
+    });
+
+    simBoot();
+    const ConfigStats upgraded = configStats();
+    simCheck(upgraded.source == CONFIG_LEGACY && snapshot() == wanted, "per-key settings converted at the first boot",
+             &failures);
+    simCheck(simNvsKeyWrites("antSwitch", CONFIG_KEY) == 1, "... written once as a record", &failures);
+
+    simBoot();
+    const ConfigStats booted = configStats();
+    const Cost recordRead = measure([] { configLoad(); });
+    simCheck(booted.source == CONFIG_RECORD && snapshot() == wanted, "next boot reads the record", &failures);
+    simCheck(recordRead.reads == 1 && recordRead.commits == 0, "... in one NVS read", &failures);
+
+    // ---- Saves ----
+    const uint64_t recordWrites = simNvsKeyWrites("antSwitch", CONFIG_KEY);
+    const Cost unchanged = measure([] { request(HTTP_POST, "/settings", form()); });
+    simCheck(simNvsKeyWrites("antSwitch", CONFIG_KEY) == recordWrites && unchanged.commits == 0,
+             "saving an unchanged form writes nothing", &failures);
+
+    mqttCfg.user = "operator";
+    const std::string oneField = form();
+    mqttCfg.user = "switch";
+    const Cost changed = measure([&] { request(HTTP_POST, "/settings", oneField); });
+    simCheck(changed.commits == 1 && changed.bytes == configStats().bytes, "one changed field: one record write",
+             &failures);
+    simCheck(std::string(mqttCfg.user.c_str()) == "operator", "... and the field applied", &failures);
+
+    // ---- Edges ----
+    const std::string longest(CONFIG_STRING_MAX, 't');
+    request(HTTP_POST, "/settings", "mqttEnabled=on&mqttCmd=" + longest + "&mqttState=" + longest);
+    const Snapshot full = snapshot();
+    simBoot();
+    simCheck(snapshot() == full && full.cmd == longest, "longest topics round-trip", &failures);
+    const uint16_t fullBytes = configStats().bytes;
+    const SimHttpRequest* tooLong = request(HTTP_POST, "/settings", "mqttEnabled=on&mqttCmd=" + longest + "x");
+    simCheck(tooLong->code == 400 && full.cmd == mqttCfg.topicCmd.c_str(), "a longer one is refused", &failures);
+
+    std::vector<uint8_t> blob;
+    simNvsRead("antSwitch", CONFIG_KEY, &blob);
+    std::vector<uint8_t> newer = blob;
+    newer.insert(newer.end(), {0x01, 0x02, 0x03, 0x04});
+    reseal(&newer, CONFIG_VERSION + 1);
+    simNvsWrite("antSwitch", CONFIG_KEY, newer);
+    configLoad();
+    simCheck(configStats().source == CONFIG_RECORD && configStats().version == CONFIG_VERSION + 1 && snapshot() == full,
+             "a record from newer firmware keeps the fields this one knows", &failures);
+
+    std::vector<uint8_t> older(blob.begin(), blob.end() - 14);    // without the static IP, subnet and SWR fields
+    reseal(&older, 1);
+    simNvsWrite("antSwitch", CONFIG_KEY, older);
+    configLoad();
+    simCheck(configStats().source == CONFIG_RECORD && configStats().version == 1 && snapshot() == full &&
+                 (uint32_t)wifiCfg.staticIP == 0,
+             "a version 1 record reads, DHCP for the fields it lacks", &failures);
+
+    std::vector<uint8_t> corrupt = blob;
+    corrupt[CONFIG_HEADER + 5] ^= 0x40;
+    simNvsWrite("antSwitch", CONFIG_KEY, corrupt);
+    simBoot();
+    simCheck(configStats().corrupt && configStats().source == CONFIG_LEGACY && snapshot() == wanted,
+             "a corrupt record falls back to the per-key settings", &failures);
+
+    simNvsErase();
+    simNvsWrite("antSwitch", CONFIG_KEY, corrupt);
+    simBoot();
+    simCheck(configStats().corrupt && configStats().source == CONFIG_DEFAULTS && mqttCfg.port == 1883,
+             "... or to the defaults without them", &failures);
+
+    const std::string longestPost = longestForm();
+    const uint32_t restarts = simRestarts();
+    const SimHttpRequest* saved = request(HTTP_POST, "/settings", longestPost);
+    simRunUntil([restarts] { return simRestarts() > restarts; }, 5000000);
+    simRunFor(100000);
+    printf("  longest settings form: %u bytes\n", (unsigned)longestPost.size());
+    simCheck(longestPost.size() > HTTP_RX_BUFFER && saved->code == 200 && simRestarts() == restarts + 1 &&
+                 mqttCfg.topicState == std::string(CONFIG_STRING_MAX, '&').c_str() &&
+                 udpCfg.key == std::string(UDP_KEY_MAX, '&').c_str() &&
+                 relayCfg.outputMap.length() == OUTPUT_MAP_MAX - 1,
+             "the whole form at its longest saved", &failures);
+
+    printf("boot read: per-key %llu reads %.2f ms, record %llu read %.2f ms (%u bytes, %u at the longest)\n",
+           (unsigned long long)legacyRead.reads, legacyRead.us / 1000.0, (unsigned long long)recordRead.reads,
+           recordRead.us / 1000.0, booted.bytes, fullBytes);
+    printf("save: per-key %llu writes %llu bytes %.1f ms; record unchanged %llu writes, one field %llu write %llu "
+           "bytes %.1f ms\n",
+           (unsigned long long)legacyWrite.commits, (unsigned long long)legacyWrite.bytes, legacyWrite.us / 1000.0,
+           (unsigned long long)unchanged.commits, (unsigned long long)changed.commits,
+           (unsigned long long)changed.bytes, changed.commits * simCosts.nvsWriteUs / 1000.0);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "config")
+            .beginObject("boot_read")
+            .field("per_key_reads", legacyRead.reads)
+            .field("per_key_us", legacyRead.us)
+            .field("record_reads", recordRead.reads)
+            .field("record_us", recordRead.us)
+            .field("record_bytes", booted.bytes)
+            .endObject()
+            .beginObject("save")
+            .field("per_key_writes", legacyWrite.commits)
+            .field("per_key_bytes", legacyWrite.bytes)
+            .field("per_key_us", legacyWrite.us)
+            .field("unchanged_writes", unchanged.commits)
+            .field("one_field_writes", changed.commits)
+            .field("one_field_bytes", changed.bytes)
+            .endObject()
+            .field("failures", failures)
+            .endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+// --------------------------------------------------
+// Scenario: dashboard updates, polling vs. /events
+//
+// A shack with EVENT_MAX_CLIENTS dashboards open while antennas are
+// switched over HTTP. First every tab polls /state every 1.5 s (the old
+// page), then every tab holds an SSE stream. Reports how long each tab
+// takes to show a change and what the dashboards cost the device, then
+// checks the fan-out cap, a vanished peer and the heartbeat.
+// --------------------------------------------------
+
+#include <random>
+
+#include "antenna_switch.h"
+#include "event_stream.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+
+namespace {
+
+const uint64_t POLL_US = 1500000;
+
+struct Command
+{
+    uint64_t at;
+    int      ant;
+    uint32_t id = 0;
+};
+
+// Commands at 2..6 s intervals, never repeating the current antenna.
+std::vector<Command> makeCommands(uint32_t count, uint64_t start, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<Command> cmds;
+    uint64_t t = start;
+    int last = -1;
+    for (uint32_t i = 0; i < count; i++) {
+        t += 2000000 + rng() % 4000000;
+        int ant;
+        do {
+            ant = (int)(rng() % 5);
+        } while (ant == last);
+        last = ant;
+        cmds.push_back(Command{t, ant});
+    }
+    return cmds;
+}
+
+void schedule(std::vector<Command>& cmds)
+{
+    for (Command& c : cmds) {
+        Command* p = &c;
+        simAt(c.at, [p] { p->id = simHttpRequest(HTTP_GET, "/set?ant=" + std::to_string(p->ant)); });
+    }
+}
+
+std::string stateData(int ant)
+{
+    return "data: {\"antenna\":" + std::to_string(ant) + ",\"outputs\":" + std::to_string(ant ? 1 << (ant - 1) : 0) +
+           ",\"count\":4}";
+}
+
+// Device-side socket work between two points in time.
+struct Load
+{
+    uint64_t busyUs = 0;
+    uint64_t bytes = 0;
+    double   seconds = 0;
+
+    double busyPct() const { return 100.0 * busyUs / (seconds * 1e6); }
+};
+
+Load measure(uint64_t sinceUs)
+{
+    Load l;
+    l.busyUs = simTcpStats().busyUs;
+    l.bytes = simTcpStats().bytesIn + simTcpStats().bytesOut;
+    l.seconds = (simNow() - sinceUs) / 1e6;
+    return l;
+}
+
+} // namespace
+
+int scenarioEvents(const SimOptions& opt)
+{
+    const uint32_t count = opt.count ? opt.count : 100;
+    const int tabs = EVENT_MAX_CLIENTS;
+    int failures = 0;
+
+    simNvsErase();
+    simBoot();
+    simRunFor(3000000);
+
+    // ---- Polling: every tab fetches /state every 1.5 s ----
+    std::vector<Command> polled = makeCommands(count, simNow(), opt.seed);
+    const uint64_t pollStart = simNow();
+    simTcpResetStats();
+    const uint64_t pollEnd = polled.back().at + 2 * POLL_US;
+    std::vector<std::vector<uint32_t>> polls(tabs);
+    std::mt19937 phase(opt.seed + 1);
+    for (int tab = 0; tab < tabs; tab++) {
+        for (uint64_t t = pollStart + phase() % POLL_US; t < pollEnd; t += POLL_US) {
+            simAt(t, [&polls, tab] { polls[tab].push_back(simHttpRequest(HTTP_GET, "/state")); });
+        }
+    }
+    schedule(polled);
+    simRunFor(pollEnd - simNow());
+    const Load pollLoad = measure(pollStart);
+    simRunFor(500000);
+
+    std::vector<double> pollLatencyMs;
+    uint64_t pollRequests = 0;
+    for (int tab = 0; tab < tabs; tab++) {
+        pollRequests += polls[tab].size();
+        for (const Command& c : polled) {
+            const SimHttpRequest* set = simHttpResult(c.id);
+            for (uint32_t id : polls[tab]) {
+                const SimHttpRequest* r = simHttpResult(id);
+                if (r->startedUs > set->startedUs) {
+                    pollLatencyMs.push_back((r->respondedUs - c.at) / 1000.0);
+                    break;
+                }
+            }
+        }
+    }
+
+    // ---- Server-Sent Events: one stream per tab ----
+    simRunFor(1000000);
+    std::vector<uint32_t> streams;
+    for (int tab = 0; tab < tabs; tab++) streams.push_back(simHttpRequest(HTTP_GET, "/events"));
+    simRunUntil([] { return simHttpPending() == 0; }, 5000000);
+    const uint32_t extra = simHttpRequest(HTTP_GET, "/events");
+    simRunUntil([] { return simHttpPending() == 0; }, 5000000);
+
+    bool allOpen = true;
+    for (uint32_t id : streams) {
+        const SimHttpRequest* r = simHttpResult(id);
+        allOpen = allOpen && simTcpOpen(r->conn) && r->contentType == "text/event-stream";
+    }
+    simCheck(allOpen, "every tab gets an open event stream", &failures);
+    simCheck(simHttpResult(extra)->code == 503, "stream past the cap is refused with 503", &failures);
+
+    std::vector<Command> pushed = makeCommands(count, simNow(), opt.seed);
+    const uint64_t pushStart = simNow();
+    simTcpResetStats();
+    schedule(pushed);
+    simRunFor(pushed.back().at + 2 * POLL_US - simNow());
+    const Load pushLoad = measure(pushStart);
+
+    std::vector<double> pushLatencyMs;
+    uint64_t pushEvents = 0;
+    for (uint32_t id : streams) {
+        const std::vector<SimTcpSegment>& segs = simTcpReceived(simHttpResult(id)->conn);
+        for (const SimTcpSegment& seg : segs) {
+            if (seg.atUs >= pushStart) pushEvents++;
+        }
+        for (const Command& c : pushed) {
+            const std::string want = stateData(c.ant);
+            for (const SimTcpSegment& seg : segs) {
+                if (seg.atUs >= c.at && seg.data.find(want) != std::string::npos) {
+                    pushLatencyMs.push_back((seg.atUs - c.at) / 1000.0);
+                    break;
+                }
+            }
+        }
+    }
+
+    const SimSummary pollSum = simSummarize(pollLatencyMs);
+    const SimSummary pushSum = simSummarize(pushLatencyMs);
+    printf("events: %d tabs, %u commands per mode\n", tabs, count);
+    simPrintSummary("poll  visible", "ms", pollSum);
+    simPrintSummary("push  visible", "ms", pushSum);
+    printf("  poll: %.1f req/s, %.2f%% device time in sockets, %.0f B/s\n", pollRequests / pollLoad.seconds,
+           pollLoad.busyPct(), pollLoad.bytes / pollLoad.seconds);
+    printf("  push: %.1f events/s, %.2f%% device time in sockets, %.0f B/s\n", pushEvents / pushLoad.seconds,
+           pushLoad.busyPct(), pushLoad.bytes / pushLoad.seconds);
+
+    simCheck(pushSum.count == (size_t)tabs * count, "every tab saw every change", &failures);
+    simCheck(pushSum.p99 < pollSum.p50, "push p99 beats poll p50", &failures);
+
+    // A tab that went away is pruned once its close arrives; the slot is reusable.
+    simTcpClose(simHttpResult(streams[0])->conn);
+    simHttpRequest(HTTP_GET, "/set?ant=" + std::to_string(currentAntenna == 1 ? 2 : 1));
+    simRunFor(200000);
+    simCheck(eventStreamClients() == tabs - 1, "closed peer dropped", &failures);
+    const uint32_t again = simHttpRequest(HTTP_GET, "/events");
+    simRunFor(200000);
+    simCheck(simTcpOpen(simHttpResult(again)->conn), "freed slot accepts a new stream", &failures);
+
+    // Quiet switch: heartbeats keep the streams alive.
+    const std::vector<SimTcpSegment>& quiet = simTcpReceived(simHttpResult(streams[1])->conn);
+    const size_t before = quiet.size();
+    simRunFor((EVENT_HEARTBEAT_MS + 1000) * 1000ULL);
+    simCheck(quiet.size() > before && quiet.back().data == ": ping\n\n",
+             "heartbeat sent while idle", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "events")
+            .field("seed", opt.seed)
+            .field("tabs", tabs)
+            .field("commands", count);
+        json.beginObject("poll");
+        simWriteSummary(json, "visible_ms", pollSum);
+        json.field("requests_per_s", pollRequests / pollLoad.seconds)
+            .field("busy_pct", pollLoad.busyPct())
+            .field("bytes_per_s", pollLoad.bytes / pollLoad.seconds)
+            .endObject();
+        json.beginObject("push");
+        simWriteSummary(json, "visible_ms", pushSum);
+        json.field("events_per_s", pushEvents / pushLoad.seconds)
+            .field("busy_pct", pushLoad.busyPct())
+            .field("bytes_per_s", pushLoad.bytes / pushLoad.seconds)
+            .endObject();
+        json.field("failures", failures).endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,260 @@
+// --------------------------------------------------
+// Scenario: fleet
+//
+// A station's worth of switches (24 by default, --count) on one broker,
+// each its own firmware in its own process. Every member boots a little
+// after the previous one, takes its own command and state topics and
+// serves a browser polling /state. The parent is the automation host:
+// it sends every member a different antenna once a second and times
+// command -> state at the broker. Halfway through the broker restarts
+// for a few seconds; all members reconnect (the CONNECTs queue at the
+// broker) and republish their state. Reports command throughput,
+// end-to-end latency percentiles, HTTP latency under the load and how
+// the reconnect storm went.
+// --------------------------------------------------
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+
+#include "antenna_switch.h"
+#include "config_store.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+
+namespace {
+
+const uint64_t SEC = 1000000;
+const uint64_t COMMANDS_US   = 10 * SEC;     // after boot and the first connect
+const uint64_t OUTAGE_US     = 40 * SEC;
+const uint64_t OUTAGE_LEN_US = 8 * SEC;
+const uint64_t QUIET_US      = 75 * SEC;     // no commands after, last ones settle
+const uint64_t END_US        = 80 * SEC;
+const uint64_t ANSWER_US     = 1 * SEC;      // a command not answered by then is lost
+
+std::string memberTopic(int i, const char* leaf)
+{
+    char buf[48];
+    snprintf(buf, sizeof(buf), "fleet/sw%02d/%s", i, leaf);
+    return buf;
+}
+
+// Runs in the member's process: configure, boot, poll /state like an
+// open dashboard. Reports "<ok> <failed> <latency us>...".
+void member(int i, uint64_t startUs, uint32_t seed)
+{
+    simNvsErase();
+    configLoad();
+    mqttCfg.topicCmd = memberTopic(i, "cmd").c_str();
+    mqttCfg.topicState = memberTopic(i, "state").c_str();
+    configSave();
+
+    simAdvance(i * 20000ULL);                // power comes up along the rack
+    simBoot();
+
+    std::mt19937 rng(seed + i);
+    uint32_t ok = 0, failed = 0;
+    std::ostringstream latencies;
+    while (simNow() < startUs + END_US) {
+        simRunFor(100000 + rng() % 400000);
+        const uint32_t id = simHttpRequest(HTTP_GET, "/state");
+        simRunUntil([id] { return simHttpResult(id)->respondedUs != 0 || simHttpResult(id)->code < 0; },
+                    5000000);
+        const SimHttpRequest* r = simHttpResult(id);
+        if (r->code != 200) {
+            failed++;
+            continue;
+        }
+        ok++;
+        latencies << ' ' << (r->respondedUs - r->queuedUs);
+    }
+    simFleetReport(std::to_string(ok) + ' ' + std::to_string(failed) + latencies.str());
+}
+
+struct Host
+{
+    int want = 0;            // antenna last commanded
+    uint64_t sentUs = 0;
+    bool waiting = false;    // for the state that answers it
+    uint64_t nextUs = 0;
+    bool republished = false;// state seen since the reconnect after the outage
+};
+
+} // namespace
+
+int scenarioFleet(const SimOptions& opt)
+{
+    int failures = 0;
+    const int count = opt.count ? (int)opt.count : 24;
+    const uint64_t startUs = simNow();
+    const uint32_t seed = opt.seed;
+
+    if (!simFleetStart(count, [startUs, seed](int i) { member(i, startUs, seed); })) {
+        perror("fleet");
+        return 1;
+    }
+    simFleetSubscribe("fleet/+/state");
+
+    std::vector<Host> hosts(count);
+    for (int i = 0; i < count; i++) hosts[i].nextUs = startUs + COMMANDS_US + (uint64_t)i * SEC / count;
+
+    std::vector<double> e2eMs;
+    uint32_t sent = 0, answered = 0, lost = 0, lostInOutage = 0;
+    bool allConnected = false;
+    bool brokerDown = false;
+    uint64_t upUs = 0;
+    std::vector<uint32_t> connectsPerSecond;
+    uint32_t lastConnects = 0;
+
+    const auto lose = [&](Host& h) {
+        h.waiting = false;
+        if (h.sentUs + ANSWER_US > startUs + OUTAGE_US && h.sentUs < startUs + OUTAGE_US + OUTAGE_LEN_US) {
+            lostInOutage++;
+        } else {
+            lost++;
+        }
+    };
+
+    while (simFleetStep()) {
+        const uint64_t now = simFleetNow();
+        const uint64_t t = now - startUs;
+
+        // ---- Broker ----
+        if (!brokerDown && !upUs && t >= OUTAGE_US) {
+            simFleetSetBrokerUp(false);
+            brokerDown = true;
+        } else if (brokerDown && t >= OUTAGE_US + OUTAGE_LEN_US) {
+            simFleetSetBrokerUp(true);
+            brokerDown = false;
+            upUs = now;
+        }
+        const size_t second = t / SEC;
+        if (connectsPerSecond.size() <= second) connectsPerSecond.resize(second + 1);
+        connectsPerSecond[second] += simFleetBrokerStats().connects - lastConnects;
+        lastConnects = simFleetBrokerStats().connects;
+
+        // ---- State from the members ----
+        for (const SimMqttMessage& m : simFleetReceive()) {
+            int i = -1;
+            if (sscanf(m.topic.c_str(), "fleet/sw%d/state", &i) != 1 || i < 0 || i >= count) continue;
+            if (m.topic != memberTopic(i, "state")) continue;    // telemetry and schedule replies
+            Host& h = hosts[i];
+            if (upUs && m.atUs > upUs) h.republished = true;
+            if (h.waiting && m.payload == std::to_string(h.want)) {
+                h.waiting = false;
+                answered++;
+                e2eMs.push_back((m.atUs - h.sentUs) / 1000.0);
+            }
+        }
+
+        // ---- Commands ----
+        if (t == COMMANDS_US) {
+            allConnected = true;
+            for (int i = 0; i < count; i++) allConnected = allConnected && simFleetMemberStats(i).connected;
+        }
+        if (t < COMMANDS_US || t >= QUIET_US) continue;
+        for (int i = 0; i < count; i++) {
+            Host& h = hosts[i];
+            if (h.waiting && now - h.sentUs >= ANSWER_US) lose(h);
+            if (now < h.nextUs) continue;
+            h.nextUs += SEC;
+            // Only to switches whose session is up and subscribed
+            const SimFleetMemberStats ms = simFleetMemberStats(i);
+            if (brokerDown || !ms.connected || now < ms.lastConnectUs + SEC) continue;
+            if (h.waiting) lose(h);
+            h.want = h.want % 4 + 1;
+            h.sentUs = now;
+            h.waiting = true;
+            sent++;
+            simFleetPublish(memberTopic(i, "cmd"), std::to_string(h.want));
+        }
+    }
+    for (Host& h : hosts) {
+        if (h.waiting) lose(h);
+    }
+
+    // ---- Members' reports ----
+    std::vector<double> httpMs;
+    uint32_t httpOk = 0, httpFailed = 0;
+    for (int i = 0; i < count; i++) {
+        std::istringstream in(simFleetReportOf(i));
+        uint32_t ok = 0, failed = 0;
+        in >> ok >> failed;
+        httpOk += ok;
+        httpFailed += failed;
+        for (uint64_t us; in >> us;) httpMs.push_back(us / 1000.0);
+    }
+
+    // ---- Reconnect storm ----
+    uint64_t lastReconnectUs = 0;
+    int reconnected = 0, republished = 0, retainedOk = 0;
+    for (int i = 0; i < count; i++) {
+        const SimFleetMemberStats ms = simFleetMemberStats(i);
+        if (ms.lastConnectUs > upUs) {
+            reconnected++;
+            lastReconnectUs = std::max(lastReconnectUs, ms.lastConnectUs);
+        }
+        if (hosts[i].republished) republished++;
+        std::string retained;
+        if (simFleetRetained(memberTopic(i, "state"), &retained) && retained == std::to_string(hosts[i].want)) {
+            retainedOk++;
+        }
+    }
+    const SimFleetBrokerStats& b = simFleetBrokerStats();
+    uint32_t peakConnects = 0;
+    for (size_t s = (OUTAGE_US + OUTAGE_LEN_US) / SEC; s < connectsPerSecond.size(); s++) {
+        peakConnects = std::max(peakConnects, connectsPerSecond[s]);
+    }
+    const double stormS = upUs && lastReconnectUs > upUs ? (lastReconnectUs - upUs) / 1e6 : 0;
+    const double windowS = (QUIET_US - COMMANDS_US - OUTAGE_LEN_US) / 1e6;
+
+    const SimSummary e2e = simSummarize(e2eMs);
+    const SimSummary http = simSummarize(httpMs);
+    printf("fleet: %d switches, %u commands, %u answered (%.1f/s), %u lost, %u lost to the outage\n", count, sent,
+           answered, answered / windowS, lost, lostInOutage);
+    simPrintSummary("command->state", "ms", e2e);
+    simPrintSummary("http /state", "ms", http);
+    printf("storm: %d/%d reconnected in %.2f s, peak %u CONNECT/s, longest queue %.1f ms, %u refused while down\n",
+           reconnected, count, stormS, peakConnects, b.maxConnectWaitUs / 1000.0, b.refused);
+    printf("broker: %u connects, %u publishes, %u deliveries\n", b.connects, b.publishes, b.deliveries);
+
+    simCheck(allConnected, "every switch connected before the first command", &failures);
+    simCheck(sent > 0 && answered >= (sent - lostInOutage) * 99 / 100,
+             "99% of the commands outside the outage answered", &failures);
+    simCheck(e2e.p99 < 250.0, "command -> state p99 under 250 ms", &failures);
+    simCheck(reconnected == count && stormS < 15.0, "all switches back within 15 s of the broker", &failures);
+    simCheck(republished == count, "... each republished its state", &failures);
+    simCheck(retainedOk == count, "retained state is every switch's last command", &failures);
+    simCheck(httpFailed == 0 && httpOk > 0, "no failed HTTP request", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "fleet")
+            .field("switches", count)
+            .field("commands", sent)
+            .field("answered", answered)
+            .field("commands_per_second", answered / windowS)
+            .field("lost", lost)
+            .field("lost_in_outage", lostInOutage);
+        simWriteSummary(json, "command_to_state_ms", e2e);
+        simWriteSummary(json, "http_state_ms", http);
+        json.beginObject("storm")
+            .field("reconnected", reconnected)
+            .field("seconds", stormS)
+            .field("peak_connects_per_second", peakConnects)
+            .field("max_connect_wait_us", b.maxConnectWaitUs)
+            .field("refused", b.refused)
+            .endObject();
+        json.field("failures", failures).endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,274 @@
+// --------------------------------------------------
+// Scenario: HTTP load
+//
+// Closed-loop clients (each sends its next request as soon as the last
+// response is in) against the firmware's routes: mostly /state and /set
+// with some page loads. Runs 1, 8 and 32 clients with keep-alive and with
+// a new connection per request, reporting requests/s and latency, then
+// checks that a client trickling its headers is timed out without
+// slowing the others and that a firmware upload streams through.
+// --------------------------------------------------
+
+#include <algorithm>
+#include <memory>
+#include <random>
+
+#include "antenna_switch.h"
+#include "http_server.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+
+namespace {
+
+struct LoadClient
+{
+    bool keepAlive = true;
+    bool running = true;
+    int  conn = -1;
+    std::mt19937 rng;
+
+    std::string request;
+    uint64_t sentUs = 0;
+    bool inFlight = false;
+    std::string raw;
+    bool gotHeader = false;
+    bool serverClose = false;
+    bool chunked = false;
+    size_t contentLength = 0;
+
+    uint64_t windowStartUs = 0, windowEndUs = 0;
+    std::vector<double> latencyMs;
+    uint32_t retries = 0;
+    uint32_t errors = 0;
+};
+
+std::string nextRequest(LoadClient& c)
+{
+    const int r = (int)(c.rng() % 100);
+    std::string path;
+    if (r < 60) path = "/state";
+    else if (r < 85) path = "/set?ant=" + std::to_string(c.rng() % 5);
+    else if (r < 95) path = "/";
+    else path = "/settings";
+    return "GET " + path + " HTTP/1.1\r\nHost: flexpilot-switch.local\r\n"
+           "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 Chrome/126.0 Safari/537.36\r\n"
+           "Accept: */*\r\nAccept-Encoding: gzip, deflate\r\nAccept-Language: en-US,en;q=0.9\r\n"
+           "Connection: " + std::string(c.keepAlive ? "keep-alive" : "close") + "\r\n\r\n";
+}
+
+void sendRequest(std::shared_ptr<LoadClient> c);
+
+// A whole chunked body: walk the size lines up to the zero-size chunk.
+bool chunkedComplete(const std::string& raw)
+{
+    size_t pos = 0;
+    for (;;) {
+        const size_t eol = raw.find("\r\n", pos);
+        if (eol == std::string::npos) return false;
+        const size_t size = strtoul(raw.c_str() + pos, nullptr, 16);
+        pos = eol + 2 + size + 2;
+        if (pos > raw.size()) return false;
+        if (size == 0) return true;
+    }
+}
+
+void onData(std::shared_ptr<LoadClient> c, const std::string& data)
+{
+    c->raw += data;
+    if (!c->gotHeader) {
+        const size_t end = c->raw.find("\r\n\r\n");
+        if (end == std::string::npos) return;
+        const size_t cl = c->raw.find("Content-Length: ");
+        c->contentLength = cl < end ? strtoul(c->raw.c_str() + cl + 16, nullptr, 10) : 0;
+        c->serverClose = c->raw.find("Connection: close") < end;
+        c->chunked = c->raw.find("Transfer-Encoding: chunked") < end;
+        c->raw.erase(0, end + 4);
+        c->gotHeader = true;
+    }
+    if (c->chunked ? !chunkedComplete(c->raw) : c->raw.size() < c->contentLength) return;
+
+    if (c->sentUs >= c->windowStartUs && c->sentUs < c->windowEndUs) {
+        c->latencyMs.push_back((simNow() - c->sentUs) / 1000.0);
+    }
+    c->inFlight = false;
+    c->raw.clear();
+    c->gotHeader = false;
+    if (!c->keepAlive || c->serverClose) {
+        simTcpClose(c->conn);
+        c->conn = -1;
+    }
+    if (c->running) sendRequest(c);
+}
+
+void onClose(std::shared_ptr<LoadClient> c, int conn)
+{
+    if (c->conn != conn) return;
+    c->conn = -1;
+    if (!c->inFlight) return;
+    // Closed before any response byte: an idle keep-alive connection was
+    // evicted under our request, which a browser retries.
+    if (c->raw.empty() && !c->gotHeader) c->retries++;
+    else c->errors++;
+    c->raw.clear();
+    c->gotHeader = false;
+    c->inFlight = false;
+    if (c->running) sendRequest(c);
+}
+
+void sendRequest(std::shared_ptr<LoadClient> c)
+{
+    if (c->conn < 0) {
+        c->conn = simTcpConnect(80);
+        if (c->conn < 0) {
+            c->errors++;
+            return;
+        }
+        const int conn = c->conn;
+        simTcpOnReceive(conn, [c](const std::string& d) { onData(c, d); });
+        simTcpOnClose(conn, [c, conn] { onClose(c, conn); });
+    }
+    if (!c->inFlight) {
+        c->request = nextRequest(*c);
+        c->sentUs = simNow();
+    }
+    c->inFlight = true;
+    simTcpSend(c->conn, c->request);
+}
+
+struct Level
+{
+    int clients;
+    bool keepAlive;
+    double rps;
+    SimSummary latency;
+    uint32_t retries, errors;
+    uint64_t loopMaxUs;
+    size_t   minPerClient;       // fewest requests any one client completed
+};
+
+Level runLevel(int clients, bool keepAlive, uint64_t durationUs, uint32_t seed)
+{
+    const uint64_t warmupUs = 1000000;
+    std::vector<std::shared_ptr<LoadClient>> pool;
+    const uint64_t start = simNow();
+    for (int i = 0; i < clients; i++) {
+        auto c = std::make_shared<LoadClient>();
+        c->keepAlive = keepAlive;
+        c->rng.seed(seed * 1000 + i);
+        c->windowStartUs = start + warmupUs;
+        c->windowEndUs = start + warmupUs + durationUs;
+        pool.push_back(c);
+        // Stagger the first requests over 50 ms.
+        simAt(start + (uint64_t)i * 50000 / clients, [c] { sendRequest(c); });
+    }
+
+    simRunFor(warmupUs);
+    simResetLoopStats();
+    simRunFor(durationUs);
+    const uint64_t loopMax = simLoopStats().maxUs;
+
+    for (auto& c : pool) c->running = false;
+    simRunFor(2000000);
+    for (auto& c : pool) {
+        if (c->conn >= 0) simTcpClose(c->conn);
+    }
+    simRunFor(500000);
+
+    Level l = {clients, keepAlive, 0, {}, 0, 0, loopMax, SIZE_MAX};
+    std::vector<double> all;
+    for (auto& c : pool) {
+        l.minPerClient = std::min(l.minPerClient, c->latencyMs.size());
+        all.insert(all.end(), c->latencyMs.begin(), c->latencyMs.end());
+        l.retries += c->retries;
+        l.errors += c->errors;
+    }
+    l.rps = all.size() / (durationUs / 1e6);
+    l.latency = simSummarize(all);
+    return l;
+}
+
+} // namespace
+
+int scenarioHttpLoad(const SimOptions& opt)
+{
+    const uint64_t durationUs = (opt.count ? opt.count : 10) * 1000000ULL;
+    int failures = 0;
+
+    simNvsErase();
+    simBoot();
+    simRunFor(3000000);
+
+    printf("httpload: %.0f s per level\n", durationUs / 1e6);
+    std::vector<Level> levels;
+    for (bool keepAlive : {true, false}) {
+        for (int clients : {1, 8, 32}) {
+            Level l = runLevel(clients, keepAlive, durationUs, opt.seed);
+            printf("  %2d clients %-10s %7.1f req/s  p50=%.1f p99=%.1f max=%.1f ms  retries=%u errors=%u loop max=%.1f ms\n",
+                   clients, keepAlive ? "keep-alive" : "close", l.rps, l.latency.p50, l.latency.p99,
+                   l.latency.max, l.retries, l.errors, l.loopMaxUs / 1000.0);
+            levels.push_back(l);
+        }
+    }
+
+    bool noErrors = true;
+    for (const Level& l : levels) noErrors = noErrors && l.errors == 0;
+    simCheck(noErrors, "no failed requests", &failures);
+    simCheck(levels[1].rps > 2 * levels[0].rps, "8 clients are served concurrently", &failures);
+    simCheck(levels[2].minPerClient > 0, "32 clients on 11 slots: none starved", &failures);
+    simCheck(levels[2].rps >= levels[4].rps, "32 clients keep at least the 8-client close rate", &failures);
+
+    // A client that trickles its headers holds a slot but nobody else.
+    const int slow = simTcpConnect(80);
+    const std::string head = "GET /state HTTP/1.1\r\nHost: flexpilot-switch.local\r\nX-Slow: ";
+    for (size_t i = 0; i < 60; i++) {
+        simAt(simNow() + i * 200000, [slow] { simTcpSend(slow, "a"); });
+    }
+    simTcpSend(slow, head);
+    const Level withSlow = runLevel(8, true, durationUs, opt.seed + 7);
+    printf("  %2d clients + slow client %7.1f req/s  p99=%.1f ms\n", 8, withSlow.rps, withSlow.latency.p99);
+    simCheck(!simTcpOpen(slow), "slow client timed out", &failures);
+    simCheck(withSlow.latency.p99 < levels[1].latency.p99 * 2 + 5, "slow client does not delay others", &failures);
+
+    // Firmware upload: multipart body streamed into Update in chunks.
+    std::vector<uint8_t> image(256 * 1024);
+    std::mt19937 rng(opt.seed);
+    for (uint8_t& b : image) b = (uint8_t)rng();
+    image[0] = 0xE9;                               // app image magic, ESP32, no appended hash
+    image[12] = image[13] = image[23] = 0;
+    const uint32_t restarts = simRestarts();
+    const uint32_t up = simHttpUpload("/update", "firmware.bin", image);
+    simRunUntil([up] { return simHttpResult(up)->code != 0; }, 30000000);
+    simRunFor(1000000);
+    simCheck(simHttpResult(up)->code == 200 && simRestarts() == restarts + 1, "256 KiB upload accepted", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "httpload")
+            .field("seed", opt.seed)
+            .field("duration_s", durationUs / 1e6);
+        json.beginArray("levels");
+        for (const Level& l : levels) {
+            json.beginObject()
+                .field("clients", l.clients)
+                .field("keep_alive", l.keepAlive)
+                .field("rps", l.rps)
+                .field("retries", l.retries)
+                .field("errors", l.errors)
+                .field("loop_max_us", l.loopMaxUs);
+            simWriteSummary(json, "latency_ms", l.latency);
+            json.endObject();
+        }
+        json.endArray();
+        json.field("failures", failures).endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
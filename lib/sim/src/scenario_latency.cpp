@@ -0,0 +1,212 @@
+// --------------------------------------------------
+// Scenario: command -> relay edge latency
+//
+// Boots the firmware, waits for WiFi and MQTT, then issues a random mix of
+// HTTP /set and MQTT commands. Latency is measured from the moment the
+// command reaches the device to the GPIO edge that leaves the outputs in
+// the commanded pattern.
+// --------------------------------------------------
+
+#include <algorithm>
+#include <random>
+
+#include "antenna_switch.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+
+namespace {
+
+const int PINS[] = {16, 17, 18, 19};   // OUTPUT_MAP_DEFAULT
+const int NUM_PINS = 4;
+
+struct Command
+{
+    bool     mqtt;
+    int      antenna;
+    uint64_t issuedUs;
+    uint32_t httpId;
+    uint64_t relayUs;
+    uint64_t replyUs;
+};
+
+bool pinsMatch(const int* levels, int antenna)
+{
+    for (int i = 0; i < NUM_PINS; i++) {
+        if (levels[i] != (antenna == i + 1 ? HIGH : LOW)) return false;
+    }
+    return true;
+}
+
+int pinIndex(int pin)
+{
+    for (int i = 0; i < NUM_PINS; i++) {
+        if (PINS[i] == pin) return i;
+    }
+    return -1;
+}
+
+// Walk the edge log once; for every command find the first edge after it
+// was issued that produces its pattern.
+void matchEdges(std::vector<Command>& cmds)
+{
+    const std::vector<SimGpioEdge>& edges = simGpioEdges();
+    int levels[NUM_PINS] = {};
+    size_t e = 0;
+
+    for (Command& c : cmds) {
+        while (e < edges.size() && edges[e].atUs < c.issuedUs) {
+            int i = pinIndex(edges[e].pin);
+            if (i >= 0) levels[i] = edges[e].level;
+            e++;
+        }
+        int probe[NUM_PINS];
+        memcpy(probe, levels, sizeof(probe));
+        for (size_t j = e; j < edges.size(); j++) {
+            int i = pinIndex(edges[j].pin);
+            if (i < 0) continue;
+            probe[i] = edges[j].level;
+            if (pinsMatch(probe, c.antenna)) {
+                c.relayUs = edges[j].atUs;
+                break;
+            }
+        }
+    }
+}
+
+} // namespace
+
+int scenarioLatency(const SimOptions& opt)
+{
+    const uint32_t count = opt.count ? opt.count : 200;
+    const uint64_t spacingUs = 700000;
+    std::mt19937 rng(opt.seed);
+
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    if (simMqttConnects() == 0) {
+        fprintf(stderr, "latency: MQTT never connected\n");
+        return 1;
+    }
+    simRunFor(500000);
+    simResetLoopStats();
+    simNvsResetStats();
+
+    std::vector<Command> cmds;
+    uint64_t t = simNow();
+    int last = currentAntenna;
+    for (uint32_t i = 0; i < count; i++) {
+        Command c = {};
+        c.mqtt = rng() & 1;
+        do {
+            c.antenna = (int)(rng() % 5);
+        } while (c.antenna == last);
+        last = c.antenna;
+        t += spacingUs + rng() % (spacingUs / 2);
+        c.issuedUs = t;
+        cmds.push_back(c);
+    }
+
+    for (size_t i = 0; i < cmds.size(); i++) {
+        simAt(cmds[i].issuedUs, [&cmds, i] {
+            Command& c = cmds[i];
+            if (c.mqtt) {
+                simMqttInject(mqttCfg.topicCmd.c_str(), c.antenna ? std::to_string(c.antenna) : "off");
+            } else {
+                c.httpId = simHttpRequest(HTTP_GET, "/set?ant=" + std::to_string(c.antenna));
+            }
+        });
+    }
+
+    simRunFor(t - simNow() + 3000000);
+    matchEdges(cmds);
+
+    std::vector<double> http, mqtt, reply;
+    uint32_t missed = 0;
+    for (Command& c : cmds) {
+        if (!c.mqtt) {
+            const SimHttpRequest* r = simHttpResult(c.httpId);
+            if (r && r->respondedUs) {
+                c.replyUs = r->respondedUs;
+                reply.push_back((double)(c.replyUs - c.issuedUs) / 1000.0);
+            }
+        }
+        if (!c.relayUs) {
+            missed++;
+            continue;
+        }
+        double ms = (double)(c.relayUs - c.issuedUs) / 1000.0;
+        (c.mqtt ? mqtt : http).push_back(ms);
+    }
+
+    // How long a single switch holds loop() inside applyRelayState().
+    uint64_t relayBlockUs = 0;
+    for (int i = 0; i < 20; i++) {
+        currentAntenna = 1 + i % 4;
+        const uint64_t t0 = simNow();
+        applyRelayState();
+        relayBlockUs = std::max(relayBlockUs, simNow() - t0);
+        simAdvance(100000);
+    }
+
+    const SimSummary httpSum = simSummarize(http);
+    const SimSummary mqttSum = simSummarize(mqtt);
+    const SimSummary replySum = simSummarize(reply);
+    const SimLoopStats& loops = simLoopStats();
+
+    printf("latency: %u commands, %u without a relay edge\n", count, missed);
+    simPrintSummary("http->relay", "ms", httpSum);
+    simPrintSummary("mqtt->relay", "ms", mqttSum);
+    simPrintSummary("http reply", "ms", replySum);
+    printf("  loop passes=%llu max=%llu us p99=%llu us stalled=%llu us\n",
+           (unsigned long long)loops.passes, (unsigned long long)loops.maxUs,
+           (unsigned long long)loops.percentileUs(99), (unsigned long long)loops.stallUs);
+    printf("  relay block=%llu us per switch\n", (unsigned long long)relayBlockUs);
+    printf("  nvs commits=%llu bytes=%llu\n",
+           (unsigned long long)simNvsStats().commits, (unsigned long long)simNvsStats().bytesWritten);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "latency")
+            .field("seed", opt.seed)
+            .field("missed", missed);
+        json.beginObject("latency_ms");
+        simWriteSummary(json, "http", httpSum);
+        simWriteSummary(json, "mqtt", mqttSum);
+        simWriteSummary(json, "http_reply", replySum);
+        json.endObject();
+        json.beginObject("loop")
+            .field("passes", loops.passes)
+            .field("max_us", loops.maxUs)
+            .field("p99_us", loops.percentileUs(99))
+            .field("stall_us", loops.stallUs)
+            .field("relay_block_us", relayBlockUs)
+            .endObject();
+        json.beginObject("nvs")
+            .field("commits", simNvsStats().commits)
+            .field("bytes", simNvsStats().bytesWritten)
+            .endObject();
+        json.beginArray("commands");
+        for (const Command& c : cmds) {
+            json.beginObject()
+                .field("source", c.mqtt ? "mqtt" : "http")
+                .field("antenna", c.antenna)
+                .field("issued_us", c.issuedUs)
+                .field("relay_us", c.relayUs)
+                .field("latency_us", c.relayUs ? c.relayUs - c.issuedUs : 0)
+                .field("reply_us", c.replyUs)
+                .endObject();
+        }
+        json.endArray();
+        json.endObject();
+        fclose(f);
+    }
+
+    return missed == 0 ? 0 : 1;
+}
@@ -0,0 +1,313 @@
+// --------------------------------------------------
+// Scenario: event log
+//
+// Switches antennas over HTTP and reads the log back through /log the
+// way tools/event_log.py does: everything once, then only what is new.
+// Counts flash writes per record (batched, from the writer task, loop()
+// never waits on an erase), then reboots three ways: a clean restart
+// (nothing lost), a power cut (the unflushed tail lost, no seq reused)
+// and a power cut that tore a record in flash. Last, fills the flash
+// ring past its end and overruns the RAM ring, and times eventLog().
+// --------------------------------------------------
+
+#include <chrono>
+#include <string.h>
+
+#include "antenna_switch.h"
+#include "event_log.h"
+#include "hal.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+#include "wifi_supervisor.h"
+
+namespace {
+
+const SimHttpRequest* request(HTTPMethod method, const std::string& uri, const std::string& body = "")
+{
+    const uint32_t id = simHttpRequest(method, uri, body);
+    simRunUntil([id] { return simHttpResult(id)->respondedUs != 0 || simHttpResult(id)->code < 0; }, 10000000);
+    return simHttpResult(id);
+}
+
+// As documented in event_log.h, decoded without the firmware's code
+struct Rec
+{
+    uint32_t seq;
+    uint32_t ms;
+    uint8_t  type;
+    uint8_t  source;
+    uint8_t  flags;
+    uint32_t value;
+};
+
+uint32_t le32(const uint8_t* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+bool decode(const uint8_t* p, Rec* r)
+{
+    uint8_t crc = 0;
+    for (int i = 0; i < 16; i++) {
+        if (i == 11) continue;
+        crc ^= p[i];
+        for (int b = 0; b < 8; b++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    *r = Rec{le32(p), le32(p + 4), p[8], p[9], p[10], le32(p + 12)};
+    return crc == p[11];
+}
+
+struct Pull
+{
+    bool ok;                 // 200, whole records, every CRC good, seq rising
+    size_t bytes;
+    uint32_t chunks;
+    std::vector<Rec> recs;
+};
+
+Pull pull(uint32_t since)
+{
+    const SimHttpRequest* r = request(HTTP_GET, "/log?since=" + std::to_string(since));
+    Pull p = {r->code == 200 && r->response.size() % 16 == 0, r->response.size(), r->chunks, {}};
+    const uint8_t* b = (const uint8_t*)r->response.data();
+    for (size_t i = 0; p.ok && i + 16 <= r->response.size(); i += 16) {
+        Rec rec;
+        p.ok = decode(b + i, &rec) && rec.seq > since && (p.recs.empty() || rec.seq > p.recs.back().seq);
+        p.recs.push_back(rec);
+    }
+    return p;
+}
+
+size_t count(const std::vector<Rec>& recs, EventType type)
+{
+    size_t n = 0;
+    for (const Rec& r : recs) n += r.type == type;
+    return n;
+}
+
+bool contiguous(const std::vector<Rec>& recs)
+{
+    for (size_t i = 1; i < recs.size(); i++) {
+        if (recs[i].seq != recs[i - 1].seq + 1) return false;
+    }
+    return true;
+}
+
+// Flash offset after the newest record, found the slow way
+size_t flashHead()
+{
+    uint32_t best = 0;
+    size_t at = 0;
+    for (size_t off = 0; off < EVENT_LOG_FLASH_BYTES; off += 16) {
+        uint8_t b[16];
+        Rec r;
+        halLogFlashRead(off, b, sizeof(b));
+        if (decode(b, &r) && r.type && r.seq >= best) {
+            best = r.seq;
+            at = off + 16;
+        }
+    }
+    return at;
+}
+
+void online()
+{
+    simRunUntil([] { return wifiOnline() && bootTimes.mqttUs != 0; }, 30000000);
+    simRunFor(200000);
+}
+
+} // namespace
+
+int scenarioLog(const SimOptions& opt)
+{
+    int failures = 0;
+    const int commands = opt.count > 0 ? opt.count : 400;
+
+    simNvsErase();
+    simLogFlashErase();
+    simLogFlashResetStats();
+    simBoot();
+    online();
+
+    // Boot
+    Pull first = pull(0);
+    printf("event log: boot -> %zu records, %zu bytes\n", first.recs.size(), first.bytes);
+    simCheck(first.ok && !first.recs.empty(), "/log?since=0: whole records, CRCs good, seq rising", &failures);
+    simCheck(!first.recs.empty() && first.recs[0].type == EVENT_BOOT && first.recs[0].value == 1,
+             "first record: boot, power-on", &failures);
+    simCheck(count(first.recs, EVENT_WIFI) == 1 && count(first.recs, EVENT_MQTT) == 1 &&
+                 count(first.recs, EVENT_COMMAND) == 1 && count(first.recs, EVENT_RELAY) == 1,
+             "... then the restore command, its relay change, WiFi up, MQTT up", &failures);
+    uint32_t cursor = first.recs.empty() ? 0 : first.recs.back().seq;
+
+    // The hot path
+    const uint64_t allocs = simHeapAllocs();
+    for (int i = 0; i < 16; i++) eventLog(EVENT_MQTT, 0, 1, 0);
+    simCheck(simHeapAllocs() == allocs, "eventLog() does not allocate", &failures);
+    cursor = pull(cursor).recs.back().seq;
+
+    // Switching
+    simLogFlashResetStats();
+    const EventLogStats s0 = eventLogStats();
+    for (int i = 0; i < commands; i++) {
+        request(HTTP_GET, "/set?ant=" + std::to_string(1 + i % 4));
+        simRunFor(50000);
+    }
+    simRunFor((EVENT_LOG_FLUSH_MS + 1000) * 1000ULL);
+    const EventLogStats s1 = eventLogStats();
+    const SimLogFlashStats fs = simLogFlashStats();
+    const uint32_t records = s1.nextSeq - s0.nextSeq;
+    printf("  %d switches: %u records, %llu flash writes (%.1f records each), %llu bytes, %llu erases\n",
+           commands, records, (unsigned long long)fs.writes,
+           fs.writes ? (double)(s0.pending + records) / fs.writes : 0.0, (unsigned long long)fs.bytesWritten,
+           (unsigned long long)fs.erases);
+    simCheck(records >= 2u * commands && s1.pending == 0 && s1.lost == 0, "two records per command, all in flash",
+             &failures);
+    simCheck(fs.bytesWritten == 16ULL * (s0.pending + records) && fs.writes * 24 <= s0.pending + records,
+             "flash written in batches, 16 bytes a record", &failures);
+    simCheck(fs.erases >= records / 256 && fs.erases <= records / 256 + 1, "a sector erased per 256 records",
+             &failures);
+    simCheck(fs.blockingUs == 0, "all of it from the writer task, loop() never waits on flash", &failures);
+
+    // Incremental pull
+    const Pull whole = pull(0);
+    const Pull fresh = pull(cursor);
+    const Pull none = pull(fresh.recs.empty() ? cursor : fresh.recs.back().seq);
+    printf("  pull everything: %zu bytes in %u chunks; since the last pull: %zu bytes; nothing new: %zu bytes\n",
+           whole.bytes, whole.chunks, fresh.bytes, none.bytes);
+    simCheck(whole.ok && contiguous(whole.recs), "everything, flash then RAM, no gaps", &failures);
+    simCheck(fresh.ok && fresh.recs.size() == records && !fresh.recs.empty() && fresh.recs[0].seq == cursor + 1,
+             "since=N: exactly the new records", &failures);
+    simCheck(none.ok && none.bytes == 0, "... and nothing once caught up", &failures);
+    simCheck(count(fresh.recs, EVENT_COMMAND) == (size_t)commands && count(fresh.recs, EVENT_RELAY) == (size_t)commands,
+             "every command and relay change there", &failures);
+    bool sources = true;
+    for (const Rec& r : fresh.recs) sources = sources && r.source == RELAY_SRC_HTTP;
+    simCheck(sources, "... with its source", &failures);
+    const SimHttpRequest* stats = request(HTTP_GET, "/stats");
+    simCheck(stats->response.find("\"log\":{\"next\":" + std::to_string(s1.nextSeq)) != std::string::npos,
+             "/stats reports the log", &failures);
+    cursor = whole.recs.back().seq;
+
+    // Clean restart: a setting that needs one
+    const uint32_t restarts = simRestarts();
+    request(HTTP_GET, "/set?ant=2");
+    request(HTTP_POST, "/settings", "mqttEnabled=on&udpPort=" + std::to_string(udpCfg.port + 1));
+    online();
+    const Pull restart = pull(cursor);
+    simCheck(simRestarts() == restarts + 1, "settings change restarted", &failures);
+    simCheck(restart.ok && restart.recs.size() >= 3 && restart.recs[0].seq == cursor + 1 &&
+                 restart.recs[1].type == EVENT_RELAY,
+             "clean restart: the last command reached flash first", &failures);
+    bool rebooted = false;
+    uint32_t bootSeq = 0;
+    for (const Rec& r : restart.recs) {
+        if (r.type == EVENT_BOOT && !rebooted) {
+            rebooted = r.value == 3;
+            bootSeq = r.seq;
+        }
+    }
+    simCheck(rebooted, "... then a boot, software reset", &failures);
+    cursor = restart.recs.back().seq;
+
+    // Power cut: a few commands still in RAM, pulled by the client, lost
+    for (int i = 0; i < 5; i++) request(HTTP_GET, "/set?ant=" + std::to_string(1 + i % 4));
+    simRunFor(200000);
+    const Pull before = pull(cursor);
+    const uint32_t seen = before.recs.empty() ? cursor : before.recs.back().seq;
+    const uint32_t unflushed = eventLogStats().pending;
+    simBoot();
+    online();
+    const Pull cut = pull(cursor);
+    const Pull after = pull(seen);
+    printf("  power cut with %u records in RAM: %zu records since, first seq %u (was %u)\n", unflushed,
+           cut.recs.size(), cut.recs.empty() ? 0 : cut.recs[0].seq, seen);
+    simCheck(unflushed >= 10 && before.recs.size() >= 10, "records only in RAM served before the cut", &failures);
+    simCheck(cut.ok && !cut.recs.empty() && cut.recs[0].type == EVENT_BOOT && cut.recs[0].value == 1,
+             "... lost with it; the log resumes at the boot", &failures);
+    simCheck(after.ok && !after.recs.empty() && after.recs[0].seq == cut.recs[0].seq && after.recs[0].seq > seen,
+             "... and no seq the client saw is reused", &failures);
+    simCheck(bootSeq > 0, "restart boot record kept", &failures);
+
+    // Power cut mid-write: half a record where the next batch would go
+    const uint32_t newest = eventLogStats().nextSeq;
+    uint8_t torn[8];
+    memcpy(torn, &newest, 4);
+    memset(torn + 4, 0x00, 4);
+    eventLogFlush();
+    const size_t at = flashHead();
+    simLogFlashPoke(at, torn, sizeof(torn));
+    simBoot();
+    online();
+    const EventLogStats ts = eventLogStats();
+    request(HTTP_GET, "/set?ant=3");
+    simRunFor(100000);
+    eventLogFlush();
+    const Pull afterTear = pull(0);
+    bool past = false;
+    for (const Rec& r : afterTear.recs) past = past || (r.type == EVENT_BOOT && r.seq > newest);
+    printf("  torn record at flash offset %zu: %u damaged at boot, writing went on at %zu\n", at, ts.damaged,
+           (at / HAL_LOG_SECTOR + 1) * HAL_LOG_SECTOR);
+    simCheck(ts.damaged == 1, "torn record found at boot", &failures);
+    simCheck(afterTear.ok && past && flashHead() >= (at / HAL_LOG_SECTOR + 1) * HAL_LOG_SECTOR,
+             "... skipped: every record served is whole, new ones go to the next sector", &failures);
+
+    // Wrap: more records than the flash ring holds
+    const uint32_t capacity = EVENT_LOG_FLASH_BYTES / 16;
+    for (uint32_t i = 0; i < capacity + 1000; i++) {
+        eventLog(EVENT_COMMAND, RELAY_SRC_LOCAL, RELAY_SELECT, i);
+        if (i % 64 == 63) simRunFor(100000);
+    }
+    simRunFor(100000);
+    eventLogFlush();
+    const EventLogStats ws = eventLogStats();
+    const Pull wrapped = pull(0);
+    printf("  wrapped: %u records in flash (capacity %u), oldest seq %u, newest %u\n", ws.flashRecords, capacity,
+           ws.firstSeq, ws.nextSeq - 1);
+    simCheck(ws.flashRecords <= capacity && ws.flashRecords > capacity - 2 * 256 && ws.lost == 0,
+             "flash keeps the newest records, less one sector", &failures);
+    simCheck(wrapped.ok && !wrapped.recs.empty() && wrapped.recs[0].seq == ws.firstSeq &&
+                 wrapped.recs.back().seq == ws.nextSeq - 1 && contiguous(wrapped.recs),
+             "... all served, oldest first, no gaps", &failures);
+
+    // RAM overrun, and the cost of a record
+    const int burst = 1000000;
+    const EventLogStats o0 = eventLogStats();
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < burst; i++) eventLog(EVENT_RELAY, RELAY_SRC_UDP, 0, (uint32_t)i);
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / burst;
+    const EventLogStats o1 = eventLogStats();
+    eventLogFlush();
+    const Pull overrun = pull(o0.nextSeq - 1);
+    printf("  %d records with loop() stalled: %u lost, %u kept; eventLog() %.1f ns a record on this host\n", burst,
+           o1.lost - o0.lost, o1.pending, ns);
+    simCheck(o1.pending == EVENT_LOG_RAM_RECORDS && o1.lost - o0.lost == burst - EVENT_LOG_RAM_RECORDS + o0.pending,
+             "RAM overrun keeps the newest records, counts the rest", &failures);
+    simCheck(overrun.ok && overrun.recs.size() == EVENT_LOG_RAM_RECORDS && overrun.recs.back().seq == o1.nextSeq - 1,
+             "... the gap shows in seq", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "log")
+            .field("commands", commands)
+            .field("records", records)
+            .field("flash_writes", fs.writes)
+            .field("flash_bytes", fs.bytesWritten)
+            .field("erases", fs.erases)
+            .field("pull_all_bytes", (uint64_t)whole.bytes)
+            .field("pull_new_bytes", (uint64_t)fresh.bytes)
+            .field("damaged", ts.damaged)
+            .field("record_ns", ns)
+            .field("failures", failures)
+            .endObject();
+        fclose(f);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,235 @@
+// --------------------------------------------------
+// Scenario: /metrics
+//
+// Drives HTTP and MQTT commands, gateway probes and an MQTT reconnect,
+// then scrapes /metrics like Prometheus would and checks the exposition
+// against what was driven: every histogram well-formed (ascending bounds,
+// cumulative buckets, +Inf equal to _count), command counts per source,
+// probes and reconnects seen. Recording is checked to be allocation-free
+// and timed on the host.
+// --------------------------------------------------
+
+#include <chrono>
+#include <cmath>
+#include <map>
+
+#include "antenna_switch.h"
+#include "metrics.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+#include "wifi_supervisor.h"
+
+namespace {
+
+struct Bucket
+{
+    double le;
+    double count;
+};
+
+struct Histogram
+{
+    std::vector<Bucket> buckets;
+    double sum = -1;
+    double count = -1;
+};
+
+struct Scrape
+{
+    std::map<std::string, Histogram> histograms;     // name + labels without le
+    std::map<std::string, double> samples;           // everything else
+    std::map<std::string, std::string> types;
+    int badLines = 0;
+};
+
+// "name{a="x",le="0.5"} 12" -> series "name{a="x"}", le 0.5
+Scrape parse(const std::string& text)
+{
+    Scrape s;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) end = text.size();
+        const std::string line = text.substr(pos, end - pos);
+        pos = end + 1;
+        if (line.empty()) continue;
+        if (line[0] == '#') {
+            char name[128], type[32];
+            if (sscanf(line.c_str(), "# TYPE %127s %31s", name, type) == 2) s.types[name] = type;
+            continue;
+        }
+
+        const size_t space = line.rfind(' ');
+        char* valueEnd;
+        const double value = space == std::string::npos ? 0 : strtod(line.c_str() + space + 1, &valueEnd);
+        if (space == std::string::npos || *valueEnd) {
+            s.badLines++;
+            continue;
+        }
+        std::string series = line.substr(0, space);
+
+        std::string name = series.substr(0, series.find('{'));
+        std::string labels = series.size() > name.size() ? series.substr(name.size()) : "";
+        auto ends = [&name](const char* suffix) {
+            const size_t n = strlen(suffix);
+            return name.size() > n && name.compare(name.size() - n, n, suffix) == 0;
+        };
+
+        if (ends("_bucket")) {
+            const size_t le = labels.find("le=\"");
+            if (le == std::string::npos) {
+                s.badLines++;
+                continue;
+            }
+            const std::string bound = labels.substr(le + 4, labels.find('"', le + 4) - le - 4);
+            std::string rest = labels.substr(0, le) + labels.substr(labels.find('"', le + 4) + 1);
+            if (rest == "{}") rest = "";
+            else if (rest.size() > 2 && rest[rest.size() - 2] == ',') rest.erase(rest.size() - 2, 1);
+            const double b = bound == "+Inf" ? INFINITY : strtod(bound.c_str(), nullptr);
+            s.histograms[name.substr(0, name.size() - 7) + rest].buckets.push_back(Bucket{b, value});
+        } else if (ends("_sum") && s.types.count(name.substr(0, name.size() - 4))) {
+            s.histograms[name.substr(0, name.size() - 4) + labels].sum = value;
+        } else if (ends("_count") && s.types.count(name.substr(0, name.size() - 6))) {
+            s.histograms[name.substr(0, name.size() - 6) + labels].count = value;
+        } else {
+            s.samples[series] = value;
+        }
+    }
+    return s;
+}
+
+bool wellFormed(const std::string& name, const Histogram& h)
+{
+    bool ok = h.buckets.size() >= 2 && h.sum >= 0 && h.count >= 0 && std::isinf(h.buckets.back().le) &&
+              h.buckets.back().count == h.count;
+    for (size_t i = 1; ok && i < h.buckets.size(); i++) {
+        ok = h.buckets[i].le > h.buckets[i - 1].le && h.buckets[i].count >= h.buckets[i - 1].count;
+    }
+    if (!ok) printf("  malformed histogram %s\n", name.c_str());
+    return ok;
+}
+
+double count(const Scrape& s, const std::string& series)
+{
+    auto it = s.histograms.find(series);
+    return it == s.histograms.end() ? -1 : it->second.count;
+}
+
+// Upper bound of the bucket holding quantile q.
+double quantile(const Scrape& s, const std::string& series, double q)
+{
+    auto it = s.histograms.find(series);
+    if (it == s.histograms.end()) return NAN;
+    for (const Bucket& b : it->second.buckets) {
+        if (b.count >= q * it->second.count) return b.le;
+    }
+    return INFINITY;
+}
+
+} // namespace
+
+int scenarioMetrics(const SimOptions& opt)
+{
+    const uint32_t commands = opt.count ? opt.count : 200;
+    int failures = 0;
+
+    // ---- Recording cost ----
+    const uint32_t observations = 1000000;
+    const uint64_t allocsBefore = simHeapAllocs();
+    const auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < observations; i++) metricsObserve(METRIC_LOOP, (i * 7919) % 2000000);
+    const double nsPerObserve =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / observations;
+    const uint64_t allocs = simHeapAllocs() - allocsBefore;
+    printf("metrics: observe %.1f ns on this host, %llu heap allocations in %u\n", nsPerObserve,
+           (unsigned long long)allocs, observations);
+    simCheck(allocs == 0, "recording does not allocate", &failures);
+
+    // ---- Traffic ----
+    simNvsErase();
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    simMqttSetBrokerUp(false);
+    simRunFor(1000000);
+    simMqttSetBrokerUp(true);
+    simRunUntil([] { return simMqttConnects() > 1; }, 30000000);
+
+    uint32_t http = 0, mqtt = 0;
+    for (uint32_t i = 0; i < commands; i++) {
+        const int ant = (int)(i % 5);
+        if (i & 1) {
+            simMqttInject(mqttCfg.topicCmd.c_str(), std::to_string(ant));
+            mqtt++;
+        } else {
+            simHttpRequest(HTTP_GET, "/set?ant=" + std::to_string(ant));
+            http++;
+        }
+        simRunFor(600000);
+    }
+    const WifiSupervisorStats wifi = wifiSupervisorStats();
+
+    // ---- Scrape ----
+    const uint32_t id = simHttpRequest(HTTP_GET, "/metrics");
+    simRunUntil([id] { return simHttpResult(id)->respondedUs != 0; }, 5000000);
+    const SimHttpRequest* r = simHttpResult(id);
+    const Scrape s = parse(r->response);
+    printf("  scrape: %d, %zu bytes in %.1f ms, %zu histograms, %zu other samples\n", r->code, r->response.size(),
+           (r->respondedUs - r->queuedUs) / 1000.0, s.histograms.size(), s.samples.size());
+    simCheck(r->code == 200 && s.badLines == 0, "exposition parses", &failures);
+
+    int malformed = 0;
+    for (const auto& kv : s.histograms) malformed += !wellFormed(kv.first, kv.second);
+    simCheck(s.histograms.size() == METRIC_HISTOGRAMS && malformed == 0, "every histogram well-formed", &failures);
+
+    const std::string cmdHttp = "antswitch_command_latency_seconds{source=\"http\"}";
+    const std::string cmdMqtt = "antswitch_command_latency_seconds{source=\"mqtt\"}";
+    printf("  commands: http=%.0f mqtt=%.0f (sent %u/%u), p99 <= %g / %g s\n", count(s, cmdHttp),
+           count(s, cmdMqtt), http, mqtt, quantile(s, cmdHttp, 0.99),
+           quantile(s, cmdMqtt, 0.99));
+    simCheck(count(s, cmdHttp) == http && count(s, cmdMqtt) == mqtt, "command latency counted per source", &failures);
+
+    const double probes = count(s, "antswitch_gateway_rtt_seconds");
+    const double connects = count(s, "antswitch_mqtt_connect_seconds");
+    printf("  gateway probes=%.0f (supervisor %u), mqtt connect attempts=%.0f, loop passes=%.0f\n", probes,
+           wifi.probes - wifi.probeMisses, connects, count(s, "antswitch_loop_seconds"));
+    simCheck(probes == wifi.probes - wifi.probeMisses && probes > 0, "every answered probe recorded", &failures);
+    simCheck(connects >= 2, "reconnects recorded", &failures);
+    simCheck(count(s, "antswitch_loop_seconds") > 0 && count(s, "antswitch_http_service_seconds") > 0,
+             "loop() and handleClient() passes recorded", &failures);
+
+    const char* expected[] = {"antswitch_heap_free_bytes", "antswitch_heap_min_free_bytes",
+                              "antswitch_relay_switches_total", "antswitch_antenna", "antswitch_uptime_seconds"};
+    int missing = 0;
+    for (const char* name : expected) {
+        if (!s.samples.count(name) || !s.types.count(name)) {
+            printf("  missing %s\n", name);
+            missing++;
+        }
+    }
+    simCheck(missing == 0, "heap, relay and uptime samples present", &failures);
+    simCheck(s.samples.count("antswitch_relay_switches_total") &&
+                 s.samples.at("antswitch_relay_switches_total") >= commands - commands / 5,
+             "relay switches counted", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "metrics")
+            .field("host_ns_per_observe", nsPerObserve)
+            .field("heap_allocations", allocs)
+            .field("scrape_bytes", (uint64_t)r->response.size())
+            .field("scrape_ms", (r->respondedUs - r->queuedUs) / 1000.0)
+            .field("histograms", (uint64_t)s.histograms.size())
+            .field("failures", failures)
+            .endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+// --------------------------------------------------
+// Scenario: MQTT command path
+//
+// Runs the command grammar through the parser, checks that topic matching
+// and parsing make no heap allocation, times them on the host, then sends
+// every command form through the broker and reads back the antenna and
+// the firmware's per-command counters.
+// --------------------------------------------------
+
+#include <chrono>
+
+#include "antenna_switch.h"
+#include "mqtt_command.h"
+#include "relay_task.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+
+namespace {
+
+struct GrammarCase
+{
+    const char* payload;
+    bool ok;
+    MqttCommandAction action;
+    uint32_t outputs;
+    const char* id;
+};
+
+const GrammarCase CASES[] = {
+    {"1",                                   true,  MQTT_CMD_SELECT, 0x1, ""},
+    {" 4 \r\n",                             true,  MQTT_CMD_SELECT, 0x8, ""},
+    {"0",                                   true,  MQTT_CMD_SELECT, 0, ""},
+    {"OFF",                                 true,  MQTT_CMD_SELECT, 0, ""},
+    {"next",                                true,  MQTT_CMD_NEXT,   0, ""},
+    {"Prev",                                true,  MQTT_CMD_PREV,   0, ""},
+    {"{\"ant\":3}",                         true,  MQTT_CMD_SELECT, 0x4, ""},
+    {"{ \"id\": \"k7\", \"ant\" : 2 }",     true,  MQTT_CMD_SELECT, 0x2, "k7"},
+    {"{\"ant\":\"next\",\"id\":42}",        true,  MQTT_CMD_NEXT,   0, "42"},
+    {"{\"src\":\"flex\",\"ant\":1,\"ok\":true}", true, MQTT_CMD_SELECT, 0x1, ""},
+    {"1+3",                                 true,  MQTT_CMD_SELECT, 0x5, ""},
+    {"2,3,4",                               true,  MQTT_CMD_SELECT, 0xe, ""},
+    {"{\"ant\":\"2+4\"}",                   true,  MQTT_CMD_SELECT, 0xa, ""},
+    {"{\"mask\":9,\"id\":\"pa\"}",            true,  MQTT_CMD_SELECT, 0x9, "pa"},
+    {"1+5",                                 false, MQTT_CMD_SELECT, 0, ""},
+    {"1+",                                  false, MQTT_CMD_SELECT, 0, ""},
+    {"{\"mask\":16}",                       false, MQTT_CMD_SELECT, 0, ""},
+    {"{\"mask\":\"3\"}",                    false, MQTT_CMD_SELECT, 0, ""},
+    {"5",                                   false, MQTT_CMD_SELECT, 0, ""},
+    {"-1",                                  false, MQTT_CMD_SELECT, 0, ""},
+    {"12x",                                 false, MQTT_CMD_SELECT, 0, ""},
+    {"",                                    false, MQTT_CMD_SELECT, 0, ""},
+    {"offf",                                false, MQTT_CMD_SELECT, 0, ""},
+    {"{\"id\":\"x\"}",                      false, MQTT_CMD_SELECT, 0, ""},
+    {"{\"ant\":2",                          false, MQTT_CMD_SELECT, 0, ""},
+    {"{\"ant\":2} 3",                       false, MQTT_CMD_SELECT, 0, ""},
+    {"{\"ant\":{\"n\":2}}",                 false, MQTT_CMD_SELECT, 0, ""},
+    {"{\"ant\":[2]}",                       false, MQTT_CMD_SELECT, 0, ""},
+    {"{\"ant\":2,\"id\":\"0123456789012345678901234567890123\"}", false, MQTT_CMD_SELECT, 0, ""},
+};
+
+bool parse(const char* payload, MqttCommand* cmd)
+{
+    return mqttParseCommand((const uint8_t*)payload, strlen(payload), 4, cmd);   // OUTPUT_MAP_DEFAULT
+}
+
+} // namespace
+
+int scenarioMqtt(const SimOptions& opt)
+{
+    const uint32_t iterations = opt.count ? opt.count : 1000000;
+    int failures = 0;
+
+    // ---- Grammar ----
+    int wrong = 0;
+    for (const GrammarCase& c : CASES) {
+        MqttCommand cmd;
+        const bool ok = parse(c.payload, &cmd);
+        bool match = ok == c.ok;
+        if (ok && c.ok) {
+            match = cmd.action == c.action && strcmp(cmd.id, c.id) == 0 &&
+                    (c.action != MQTT_CMD_SELECT || cmd.outputs == c.outputs);
+        }
+        if (!match) {
+            printf("  grammar: '%s' parsed %s\n", c.payload, ok ? "ok" : "rejected");
+            wrong++;
+        }
+    }
+    printf("mqtt: %zu grammar cases\n", sizeof(CASES) / sizeof(CASES[0]));
+    simCheck(wrong == 0, "command grammar", &failures);
+
+    simNvsErase();
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+
+    // ---- Allocation and host time: matching + parsing ----
+    // An unrouted topic of the same length as the command topic runs the
+    // whole match loop without reaching a handler.
+    std::string other = mqttCfg.topicCmd.c_str();
+    other.back() = other.back() == 'x' ? 'y' : 'x';
+    const char* payloads[] = {"3", "next", "{\"ant\":2,\"id\":\"k7\"}", " off "};
+    const uint64_t allocsBefore = simHeapAllocs();
+    const auto t0 = std::chrono::steady_clock::now();
+    uint32_t parsed = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        const char* p = payloads[i & 3];
+        MqttCommand cmd;
+        parsed += parse(p, &cmd);
+        mqttDispatch(other.c_str(), (const uint8_t*)p, (unsigned int)strlen(p));
+    }
+    const double nsPerCmd = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() /
+                            iterations;
+    const uint64_t allocs = simHeapAllocs() - allocsBefore;
+    printf("  match + parse: %.0f ns per command on this host, %llu heap allocations in %u commands\n",
+           nsPerCmd, (unsigned long long)allocs, iterations);
+    simCheck(parsed == iterations && allocs == 0, "topic match and parse do not allocate", &failures);
+
+    // ---- End to end through the broker ----
+    struct Step
+    {
+        const char* payload;
+        int expect;                      // antenna afterwards
+    };
+    const Step steps[] = {
+        {"2", 2}, {"next", 3}, {"next", 4}, {"next", 1}, {"prev", 4}, {"off", 0}, {"prev", 4},
+        {"{\"ant\":1,\"id\":\"flex-17\"}", 1}, {"{\"ant\":\"next\"}", 2}, {" 3\n", 3},
+        {"9", 3}, {"hello", 3}, {"0", 0},
+    };
+    const MqttCommandStats before = mqttCommandStats();
+    const RelayLatency latencyBefore = relayTaskStats().latency[RELAY_SRC_MQTT];
+    int mismatches = 0;
+    uint32_t expectRejected = 0;
+    for (const Step& s : steps) {
+        simMqttInject(mqttCfg.topicCmd.c_str(), s.payload);
+        simRunFor(50000);
+        if (currentAntenna != s.expect) {
+            printf("  '%s': antenna %d, expected %d\n", s.payload, currentAntenna, s.expect);
+            mismatches++;
+        }
+        MqttCommand cmd;
+        if (!parse(s.payload, &cmd)) expectRejected++;
+    }
+    const MqttCommandStats after = mqttCommandStats();
+    const RelayLatency latency = relayTaskStats().latency[RELAY_SRC_MQTT];
+    const uint32_t received = after.received - before.received;
+    const uint32_t rejected = after.rejected - before.rejected;
+    const uint32_t timed = latency.count - latencyBefore.count;
+    printf("  broker: %u commands, %u rejected, %u timed, avg %.1f us max %u us (simulated clock)\n",
+           received, rejected, timed,
+           timed ? (double)(latency.totalUs - latencyBefore.totalUs) / timed : 0.0, latency.maxUs);
+    simCheck(mismatches == 0, "every command form selects the right antenna", &failures);
+    simCheck(received == sizeof(steps) / sizeof(steps[0]) && rejected == expectRejected,
+             "counters: received and rejected", &failures);
+    simCheck(timed == received - rejected && latency.overBudget == latencyBefore.overBudget,
+             "every command timed, none over budget", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "mqtt")
+            .field("grammar_cases", (int)(sizeof(CASES) / sizeof(CASES[0])))
+            .field("grammar_wrong", wrong)
+            .field("host_ns_per_command", nsPerCmd)
+            .field("heap_allocations", allocs)
+            .field("commands", received)
+            .field("rejected", rejected)
+            .field("timed", timed)
+            .field("max_us", latency.maxUs)
+            .field("failures", failures)
+            .endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
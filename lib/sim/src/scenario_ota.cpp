@@ -0,0 +1,213 @@
+// --------------------------------------------------
+// Scenario: OTA update
+//
+// Uploads a 900 KiB app image (valid header, esptool-style appended
+// SHA-256) with its size and digest in the query and reports throughput
+// and where the time went: the pipelined total against receive and flash
+// back to back. Then the life of an image: it boots pending, is confirmed
+// after OTA_HEALTHY_MS online, rolled back by the firmware when the
+// gateway never answers, and by the bootloader on a reset before the
+// confirmation. Last the refusals, none of which may touch the running
+// image or the boot slot: a declared size over the partition (before
+// anything is erased), a bad magic byte, a digest that does not match
+// and an image whose appended hash is corrupt.
+// --------------------------------------------------
+
+#include <functional>
+#include <random>
+
+#include "ota_update.h"
+#include "sha256.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+#include "wifi_supervisor.h"
+
+namespace {
+
+const size_t IMAGE_SIZE = 900 * 1024;
+
+// Random payload behind an ESP32 app header, SHA-256 of the rest appended.
+std::vector<uint8_t> makeImage(size_t size, uint32_t seed)
+{
+    std::vector<uint8_t> image(size);
+    std::mt19937 rng(seed);
+    for (uint8_t& b : image) b = (uint8_t)rng();
+    image[0] = 0xE9;
+    image[12] = image[13] = 0;       // chip id: ESP32
+    image[23] = 1;                   // hash appended
+    Sha256 ctx;
+    sha256Begin(&ctx);
+    sha256Update(&ctx, image.data(), size - SHA256_SIZE);
+    sha256Finish(&ctx, image.data() + size - SHA256_SIZE);
+    return image;
+}
+
+std::string digestHex(const std::vector<uint8_t>& data)
+{
+    Sha256 ctx;
+    uint8_t digest[SHA256_SIZE];
+    char hex[2 * SHA256_SIZE + 1];
+    sha256Begin(&ctx);
+    sha256Update(&ctx, data.data(), data.size());
+    sha256Finish(&ctx, digest);
+    sha256FormatHex(digest, hex);
+    return hex;
+}
+
+std::string query(const std::vector<uint8_t>& image, const std::string& sha)
+{
+    return "/update?size=" + std::to_string(image.size()) + (sha.empty() ? "" : "&sha256=" + sha);
+}
+
+const SimHttpRequest* upload(const std::string& uri, const std::vector<uint8_t>& image)
+{
+    const uint32_t id = simHttpUpload(uri, "firmware.bin", image);
+    simRunUntil([id] { return simHttpResult(id)->code != 0; }, 60000000);
+    return simHttpResult(id);
+}
+
+} // namespace
+
+int scenarioOta(const SimOptions& opt)
+{
+    int failures = 0;
+
+    simOtaReset();
+    simNvsErase();
+    simNetSetGatewayUp(true);
+    simBoot();
+    simRunUntil([] { return wifiOnline(); }, 30000000);
+    simCheck(!otaStats().pending && simOtaStats().state == SIM_OTA_VALID, "factory image running, confirmed",
+             &failures);
+
+    // ---- Pipelined upload ----
+    // The firmware's stats reset at the restart that follows; keep the
+    // last completed ones.
+    OtaStats done = {};
+    std::function<void()> watch = [&done, &watch] {
+        if (otaStats().state == OTA_DONE) {
+            done = otaStats();
+            return;
+        }
+        simAt(simNow() + 1000, watch);
+    };
+    watch();
+
+    const std::vector<uint8_t> imageA = makeImage(IMAGE_SIZE, opt.seed);
+    const SimOtaStats before = simOtaStats();
+    const uint32_t restarts = simRestarts();
+    const SimHttpRequest* r = upload(query(imageA, digestHex(imageA)), imageA);
+    simRunFor(1000000);
+    const SimOtaStats after = simOtaStats();
+
+    const uint64_t receiveUs = (uint64_t)IMAGE_SIZE * simCosts.wifiByteNs / 1000;
+    const uint64_t serialUs = receiveUs + done.flashUs + done.hashUs;
+    printf("  %u bytes in %.2f s = %u KB/s (flash %.2f s, loop() waited %.2f s in %u waits)\n",
+           done.received, done.totalUs / 1e6, done.kbPerS, done.flashUs / 1e6, done.waitUs / 1e6, done.waits);
+    printf("  receive then flash: %.2f s, pipelined: %.2f s (%.0f%%)\n", serialUs / 1e6, done.totalUs / 1e6,
+           100.0 * done.totalUs / serialUs);
+    simCheck(r->code == 200 && r->response.find("KB/s") != std::string::npos, "upload accepted with its throughput",
+             &failures);
+    simCheck(done.received == IMAGE_SIZE && done.written == IMAGE_SIZE &&
+                 after.sectors - before.sectors == (IMAGE_SIZE + 4095) / 4096,
+             "every byte written, one erase per sector", &failures);
+    simCheck(done.totalUs < serialUs * 0.85, "flash writes overlap the receive", &failures);
+    simCheck(simRestarts() == restarts + 1 && after.running == 1 && simOtaImage(1) == imageA,
+             "reboots into the new image, byte for byte", &failures);
+    simCheck(after.state == SIM_OTA_PENDING && otaStats().pending, "... which runs pending", &failures);
+
+    // ---- Confirmed once WiFi has been healthy ----
+    simRunFor((OTA_HEALTHY_MS - 5000) * 1000ULL);
+    simCheck(simOtaStats().state == SIM_OTA_PENDING, "not confirmed before OTA_HEALTHY_MS online", &failures);
+    simRunFor(10000000);
+    simCheck(simOtaStats().state == SIM_OTA_VALID && simOtaStats().confirms == 1 && otaStats().confirmed,
+             "confirmed after OTA_HEALTHY_MS online", &failures);
+
+    // ---- Never healthy: the firmware rolls back ----
+    const std::vector<uint8_t> imageB = makeImage(IMAGE_SIZE - 4000, opt.seed + 1);
+    simNetSetGatewayUp(false);
+    const uint32_t restartsB = simRestarts();
+    r = upload(query(imageB, ""), imageB);
+    simRunFor(1000000);
+    simCheck(r->code == 200 && simOtaStats().running == 0 && otaStats().pending, "second image boots pending",
+             &failures);
+    simRunFor((OTA_CONFIRM_TIMEOUT_MS - 10000) * 1000ULL);
+    simCheck(simRestarts() == restartsB + 1, "still pending just before OTA_CONFIRM_TIMEOUT_MS", &failures);
+    simRunFor(20000000);
+    simCheck(simRestarts() == restartsB + 2 && simOtaStats().running == 1 && simOtaStats().state == SIM_OTA_VALID &&
+                 simOtaImage(1) == imageA,
+             "gateway never answered: rolled back to the confirmed image", &failures);
+    simNetSetGatewayUp(true);
+    simRunUntil([] { return wifiOnline(); }, 60000000);
+
+    // ---- Reset before confirmation: the bootloader rolls back ----
+    const std::vector<uint8_t> imageC = makeImage(IMAGE_SIZE / 2, opt.seed + 2);
+    const uint32_t rollbacks = simOtaStats().rollbacks;
+    r = upload(query(imageC, digestHex(imageC)), imageC);
+    simRunFor(1000000);
+    simCheck(r->code == 200 && simOtaStats().running == 0 && simOtaStats().state == SIM_OTA_PENDING,
+             "third image boots pending", &failures);
+    simBoot();
+    simRunFor(1000000);
+    simCheck(simOtaStats().running == 1 && simOtaStats().rollbacks == rollbacks + 1 && !otaStats().pending,
+             "reset before confirmation: bootloader went back", &failures);
+    simRunUntil([] { return wifiOnline(); }, 30000000);
+
+    // ---- Refused uploads ----
+    const SimOtaStats base = simOtaStats();
+    const uint32_t restartsD = simRestarts();
+
+    std::vector<uint8_t> big = makeImage(4096, opt.seed + 3);
+    r = upload("/update?size=" + std::to_string(SIM_OTA_PARTITION_SIZE + 1), big);
+    simCheck(r->code == 413 && simOtaStats().sectors == base.sectors,
+             "declared size over the partition: 413, nothing erased", &failures);
+
+    std::vector<uint8_t> bad = makeImage(64 * 1024, opt.seed + 4);
+    bad[0] = 0x7F;
+    r = upload(query(bad, ""), bad);
+    simCheck(r->code == 400 && simOtaStats().sectors == base.sectors, "bad magic: 400, nothing erased", &failures);
+
+    const std::vector<uint8_t> imageD = makeImage(64 * 1024, opt.seed + 5);
+    r = upload(query(imageD, digestHex(imageA)), imageD);
+    simCheck(r->code == 400 && r->response.find("sha256") != std::string::npos, "digest mismatch: 400", &failures);
+
+    std::vector<uint8_t> corrupt = makeImage(64 * 1024, opt.seed + 6);
+    corrupt[40000] ^= 0x01;
+    r = upload(query(corrupt, ""), corrupt);
+    simCheck(r->code == 400 && r->response.find("hash") != std::string::npos, "corrupt appended hash: 400",
+             &failures);
+
+    simRunFor(1000000);
+    const SimOtaStats end = simOtaStats();
+    simCheck(simRestarts() == restartsD && end.images == base.images && end.aborts >= base.aborts + 2,
+             "no reboot, no new boot image, started updates aborted", &failures);
+    simBoot();
+    simCheck(simOtaStats().running == 1 && simOtaStats().state == SIM_OTA_VALID && simOtaImage(1) == imageA,
+             "next boot is still the confirmed image", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "ota")
+            .field("bytes", done.received)
+            .field("total_us", done.totalUs)
+            .field("flash_us", done.flashUs)
+            .field("hash_us", done.hashUs)
+            .field("wait_us", done.waitUs)
+            .field("waits", done.waits)
+            .field("kb_per_s", done.kbPerS)
+            .field("serial_us", serialUs)
+            .field("sectors", after.sectors - before.sectors)
+            .field("failures", failures)
+            .endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,153 @@
+// --------------------------------------------------
+// Scenario: MQTT outbox
+//
+// Floods the command topic at 1 kHz for two seconds and counts what the
+// switch publishes: state updates must stay within the token bucket and
+// the last one must be the final selection. Then the broker goes away
+// while the antenna changes a few times; after the reconnect subscribers
+// get the latest state and a telemetry record, and every publish is
+// confirmed by its echo. A session that drops between a publish and its
+// echo has the value sent again. Last, telemetry keeps coming every
+// MQTT_TELEMETRY_INTERVAL_MS.
+// --------------------------------------------------
+
+#include "antenna_switch.h"
+#include "mqtt_outbox.h"
+#include "relay_task.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+
+namespace {
+
+std::string stateTopic()
+{
+    return mqttCfg.topicState.c_str();
+}
+
+// Publishes to topic from index from on.
+std::vector<SimMqttMessage> publishedSince(size_t from, const std::string& topic)
+{
+    std::vector<SimMqttMessage> out;
+    const std::vector<SimMqttMessage>& pub = simMqttPublished();
+    for (size_t i = from; i < pub.size(); i++) {
+        if (pub[i].topic == topic) out.push_back(pub[i]);
+    }
+    return out;
+}
+
+} // namespace
+
+int scenarioOutbox(const SimOptions& opt)
+{
+    int failures = 0;
+    const std::string cmdTopic = "stationpilot/antennaSwitch/cmd";
+
+    simNvsErase();
+    simMqttSetBrokerUp(true);
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0 && mqttOutboxStats().pending == 0; }, 30000000);
+    simRunFor(1000000);
+    const std::string telemetryTopic = stateTopic() + "/telemetry";
+    simCheck(mqttOutboxStats().delivered >= 2 && mqttOutboxStats().pending == 0,
+             "state and telemetry published on connect and echoed", &failures);
+
+    // ---- Command flood ----
+    const uint32_t floodMs = 2000;
+    const MqttOutboxStats f0 = mqttOutboxStats();
+    size_t from = simMqttPublished().size();
+    uint32_t lcg = opt.seed;
+    int last = 0;
+    const uint64_t t0 = simNow();
+    for (uint32_t i = 0; i < floodMs; i++) {
+        lcg = lcg * 1664525u + 1013904223u;
+        const int ant = 1 + (int)((lcg >> 16) % 4);
+        last = ant;
+        simAt(t0 + i * 1000ULL, [cmdTopic, ant] { simMqttInject(cmdTopic, std::to_string(ant)); });
+    }
+    simRunFor(floodMs * 1000ULL + 500000);
+    const std::vector<SimMqttMessage> flood = publishedSince(from, stateTopic());
+    const MqttOutboxStats f1 = mqttOutboxStats();
+    const uint32_t bound = MQTT_PUBLISH_BURST + (floodMs + 500) / MQTT_PUBLISH_INTERVAL_MS + 1;
+    printf("outbox: %u commands in %u ms -> %zu state publishes (bound %u), %u coalesced\n", floodMs, floodMs,
+           flood.size(), bound, f1.coalesced - f0.coalesced);
+    simCheck(relayTaskStats().latency[RELAY_SRC_MQTT].count >= floodMs * 9 / 10, "flood reached the relay task",
+             &failures);
+    simCheck(!flood.empty() && flood.size() <= bound, "state publishes stay within the token bucket", &failures);
+    simCheck(!flood.empty() && flood.back().payload == std::to_string(last) && currentAntenna == last,
+             "last publish is the final selection", &failures);
+    simCheck(f1.pending == 0 && f1.delivered > f0.delivered, "final state echoed back", &failures);
+
+    // ---- Broker outage ----
+    simMqttSetBrokerUp(false);
+    simRunFor(500000);
+    from = simMqttPublished().size();
+    for (int ant : {2, 3, 1, 4}) {
+        simHttpRequest(HTTP_GET, "/set?ant=" + std::to_string(ant));
+        simRunFor(300000);
+    }
+    simCheck(currentAntenna == 4 && publishedSince(from, stateTopic()).empty(), "switched while the broker was down",
+             &failures);
+    const uint32_t connects = simMqttConnects();
+    simMqttSetBrokerUp(true);
+    simRunUntil([connects] { return simMqttConnects() > connects; }, 10000000);
+    simRunFor(1000000);
+    const std::vector<SimMqttMessage> after = publishedSince(from, stateTopic());
+    const std::vector<SimMqttMessage> tele = publishedSince(from, telemetryTopic);
+    simCheck(after.size() == 1 && after[0].payload == "4" && after[0].retained,
+             "reconnect: one retained publish of the latest state", &failures);
+    simCheck(tele.size() == 1 && tele[0].payload.find("\"uptime\":") != std::string::npos &&
+                 tele[0].payload.find("\"rssi\":") != std::string::npos &&
+                 tele[0].payload.find("\"switches\":") != std::string::npos,
+             "... and a telemetry record", &failures);
+    if (!tele.empty()) printf("  telemetry: %s\n", tele[0].payload.c_str());
+    simCheck(mqttOutboxStats().pending == 0, "... both echoed", &failures);
+
+    // ---- Session lost between publish and echo ----
+    const MqttOutboxStats l0 = mqttOutboxStats();
+    from = simMqttPublished().size();
+    simHttpRequest(HTTP_GET, "/set?ant=2");
+    simRunUntil([from] { return simMqttPublished().size() > from; }, 2000000);
+    simMqttSetBrokerUp(false);                       // the echo is lost with the session
+    simRunFor(200000);
+    simCheck(mqttOutboxStats().pending == 1, "publish without an echo stays pending", &failures);
+    simMqttSetBrokerUp(true);
+    simRunFor(7000000);
+    const MqttOutboxStats l1 = mqttOutboxStats();
+    simCheck(l1.resent > l0.resent && l1.pending == 0 && publishedSince(from, stateTopic()).back().payload == "2",
+             "sent again after the reconnect and confirmed", &failures);
+
+    // ---- Periodic telemetry ----
+    from = simMqttPublished().size();
+    simRunFor(MQTT_TELEMETRY_INTERVAL_MS * 1000ULL * 2 + 1000000);
+    const size_t periodic = publishedSince(from, telemetryTopic).size();
+    simCheck(periodic == 2, "telemetry every MQTT_TELEMETRY_INTERVAL_MS", &failures);
+
+    const MqttOutboxStats s = mqttOutboxStats();
+    printf("outbox: published %u, delivered %u, coalesced %u, resent %u, throttled %u, ack max %.1f ms\n",
+           s.published, s.delivered, s.coalesced, s.resent, s.throttled, s.maxAckUs / 1000.0);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "outbox")
+            .field("flood_commands", floodMs)
+            .field("flood_publishes", (uint32_t)flood.size())
+            .field("flood_bound", bound)
+            .field("published", s.published)
+            .field("delivered", s.delivered)
+            .field("coalesced", s.coalesced)
+            .field("resent", s.resent)
+            .field("ack_max_us", s.maxAckUs)
+            .field("failures", failures)
+            .endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,385 @@
+// --------------------------------------------------
+// Scenario: output map, expander banks and multi-select
+//
+// Boots three maps set through /settings: the default four GPIOs,
+// sixteen outputs on two daisy-chained 74HC595s, and 24 on two MCP23017s.
+// On each it steps through every antenna over HTTP and checks from the
+// pin log that only that output ends up on, that the old one drops a dead
+// time before the new one rises, and that a switch costs one transfer per
+// bank it touches (break, then make) rather than one per pin. Then:
+// several outputs at once over HTTP and MQTT, latched together; a
+// selection surviving a reboot, and a journal record from the
+// four-output firmware; a missing expander; a map that does not parse
+// or drives the flash pins.
+// --------------------------------------------------
+
+#include <string.h>
+
+#include "antenna_switch.h"
+#include "mqtt_outbox.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+#include "state_journal.h"
+
+namespace {
+
+const uint64_t DEAD_US = 10000;          // default relayDeadMs
+
+struct Layout
+{
+    const char*      name;
+    const char*      spec;
+    std::vector<int> pins;               // virtual pin per logical output
+};
+
+Layout gpioLayout()
+{
+    return Layout{"gpio", OUTPUT_MAP_DEFAULT, {16, 17, 18, 19}};
+}
+
+Layout hc595Layout()
+{
+    Layout l{"595", "595 23 18 5 16", {}};
+    for (int i = 0; i < 16; i++) l.pins.push_back(SIM_HC595_PIN_BASE + i);
+    return l;
+}
+
+Layout mcpLayout()
+{
+    Layout l{"mcp23017", "i2c 21 22; mcp23017 0x20; mcp23017 0x21 8", {}};
+    for (int i = 0; i < 16; i++) l.pins.push_back(SIM_MCP23017_PIN_BASE + i);
+    for (int i = 0; i < 8; i++) l.pins.push_back(SIM_MCP23017_PIN_BASE + 16 + i);
+    return l;
+}
+
+std::string formEncode(const std::string& s)
+{
+    std::string out;
+    for (char c : s) {
+        if (c == ' ') out += '+';
+        else if (c == ';') out += "%3B";
+        else out += c;
+    }
+    return out;
+}
+
+const SimHttpRequest* get(const std::string& uri)
+{
+    const uint32_t id = simHttpRequest(HTTP_GET, uri);
+    simRunUntil([id] { return simHttpResult(id)->respondedUs != 0 || simHttpResult(id)->code < 0; }, 5000000);
+    return simHttpResult(id);
+}
+
+// Saves the map through /settings; the device reboots onto it and
+// reconnects to the broker.
+bool applyMap(const char* spec)
+{
+    const uint32_t restarts = simRestarts();
+    const uint32_t connects = simMqttConnects();
+    simHttpRequest(HTTP_POST, "/settings", "mqttEnabled=on&outputMap=" + formEncode(spec));
+    simRunUntil([restarts] { return simRestarts() > restarts; }, 6000000);
+    simRunUntil([connects] { return simMqttConnects() > connects; }, 30000000);
+    simRunFor(500000);
+    return simRestarts() > restarts && relayCfg.outputMap == spec;
+}
+
+uint32_t levels(const Layout& l)
+{
+    uint32_t m = 0;
+    for (size_t i = 0; i < l.pins.size(); i++) {
+        if (simGpioLevel(l.pins[i]) == HIGH) m |= 1u << i;
+    }
+    return m;
+}
+
+// Replays the edges on the layout's pins from edge index `from`: the most
+// outputs on at once, and the gap from the last fall to the first rise.
+struct Replay
+{
+    int      maxOn;
+    int64_t  gapUs;              // -1: nothing fell before the rise
+    uint64_t firstRiseUs;
+    uint64_t lastRiseUs;
+};
+
+Replay replay(const Layout& l, uint32_t before, size_t from)
+{
+    const std::vector<SimGpioEdge>& edges = simGpioEdges();
+    Replay r = {__builtin_popcount(before), -1, 0, 0};
+    uint32_t on = before;
+    uint64_t lastFall = 0;
+    for (size_t e = from; e < edges.size(); e++) {
+        int idx = -1;
+        for (size_t i = 0; i < l.pins.size(); i++) {
+            if (l.pins[i] == edges[e].pin) idx = (int)i;
+        }
+        if (idx < 0) continue;
+        if (edges[e].level) {
+            on |= 1u << idx;
+            if (!r.firstRiseUs) {
+                r.firstRiseUs = edges[e].atUs;
+                if (lastFall) r.gapUs = (int64_t)(edges[e].atUs - lastFall);
+            }
+            r.lastRiseUs = edges[e].atUs;
+        } else {
+            on &= ~(1u << idx);
+            lastFall = edges[e].atUs;
+        }
+        r.maxOn = std::max(r.maxOn, __builtin_popcount(on));
+    }
+    return r;
+}
+
+struct SweepResult
+{
+    int      switches = 0;
+    int      wrong = 0;          // pattern afterwards
+    int      overlap = 0;        // two outputs on at once
+    int      shortGap = 0;       // rise less than a dead time after the fall
+    uint64_t transactions = 0;   // bank writes, all switches
+    uint64_t busBytes = 0;       // shift + I2C bytes on the wire
+};
+
+// Every antenna in turn, then off.
+SweepResult sweep(const Layout& l)
+{
+    SweepResult s;
+    get("/set?ant=0");
+    simRunFor(50000);
+    const OutputStats o0 = outputsStats();
+    const SimBusStats b0 = simBusStats();
+
+    for (int ant = 1; ant <= (int)l.pins.size() + 1; ant++) {
+        const int target = ant <= (int)l.pins.size() ? ant : 0;
+        const uint32_t before = levels(l);
+        const size_t from = simGpioEdges().size();
+        get("/set?ant=" + std::to_string(target));
+        simRunFor(50000);
+
+        const Replay r = replay(l, before, from);
+        s.switches++;
+        if (levels(l) != outputBit(target)) s.wrong++;
+        if (r.maxOn > 1) s.overlap++;
+        if (before && target && r.gapUs < (int64_t)DEAD_US) s.shortGap++;
+    }
+
+    const OutputStats o1 = outputsStats();
+    const SimBusStats b1 = simBusStats();
+    s.transactions = o1.transactions - o0.transactions;
+    s.busBytes = (b1.shiftBits - b0.shiftBits) / 8 + (b1.i2cBytes - b0.i2cBytes);
+    return s;
+}
+
+uint8_t crc8(const uint8_t* p, size_t n)
+{
+    uint8_t crc = 0;
+    while (n--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+std::string lastState()
+{
+    const std::vector<SimMqttMessage>& pub = simMqttPublished();
+    for (auto it = pub.rbegin(); it != pub.rend(); ++it) {
+        if (it->topic == mqttCfg.topicState.c_str()) return it->payload;
+    }
+    return "";
+}
+
+} // namespace
+
+int scenarioOutputs(const SimOptions& opt)
+{
+    int failures = 0;
+
+    // ---- Spec parser ----
+    struct SpecCase
+    {
+        const char* spec;
+        int count;               // 0 = rejected
+    };
+    const SpecCase specs[] = {
+        {OUTPUT_MAP_DEFAULT, 4},
+        {"gpio 16 17; 595 23 18 5 12\n mcp23017 0x27 3", 17},
+        {"595 23 18 5 32", 32},
+        {"mcp23017 32", 16},
+        {"", 0},
+        {"gpio 34", 0},
+        {"595 23 18 5", 0},
+        {"595 23 18 5 33", 0},
+        {"mcp23017 0x28", 0},
+        {"mcp23017 0x20; mcp23017 0x20 4", 0},
+        {"gpio 2; gpio 4; gpio 5; gpio 12; gpio 13", 0},
+        {"gpio 16 17 6", 0},
+        {"gpio 20", 0},
+        {"595 23 18 9 8", 0},
+        {"i2c 21 31; mcp23017 0x20", 0},
+        {"gpio 0 2 4 5 12 13 14 15 16 17 18 19 21 22 23 25 26 27 32 33", 20},
+        {"relay 4", 0},
+    };
+    int wrongSpecs = 0;
+    for (const SpecCase& c : specs) {
+        OutputMap map;
+        char error[64] = "";
+        const bool ok = outputMapParse(c.spec, &map, error, sizeof(error));
+        if (ok != (c.count > 0) || (ok && map.count != c.count)) {
+            printf("  spec '%s': %s %s\n", c.spec, ok ? "parsed" : "rejected", error);
+            wrongSpecs++;
+        }
+    }
+    printf("outputs: %zu map specs\n", sizeof(specs) / sizeof(specs[0]));
+    simCheck(wrongSpecs == 0, "output map grammar", &failures);
+    {
+        OutputMap map;
+        char error[64] = "";
+        outputMapParse("gpio 16; gpio 17 7", &map, error, sizeof(error));
+        simCheck(!strcmp(error, "statement 2: GPIO 7 is not an output pin"), "a flash pin is named in the error",
+                 &failures);
+    }
+
+    simNvsErase();
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    simRunFor(500000);
+
+    // ---- One antenna at a time, per bank type ----
+    const Layout layouts[] = {gpioLayout(), hc595Layout(), mcpLayout()};
+    SweepResult results[3];
+    for (int i = 0; i < 3; i++) {
+        const Layout& l = layouts[i];
+        if (i > 0) {
+            const bool applied = applyMap(l.spec);
+            simCheck(applied && outputCount() == (int)l.pins.size() && levels(l) == 0,
+                     ("/settings reboots onto the " + std::string(l.name) + " map, all off").c_str(), &failures);
+        }
+        const SweepResult s = sweep(l);
+        results[i] = s;
+        printf("  %-9s %2zu outputs  %2d switches  %3llu bank writes  %4llu bus bytes  (per-pin: %zu writes/switch)\n",
+               l.name, l.pins.size(), s.switches, (unsigned long long)s.transactions,
+               (unsigned long long)s.busBytes, l.pins.size());
+
+        char what[96];
+        snprintf(what, sizeof(what), "%s: each switch shows just its antenna, never two at once", l.name);
+        simCheck(s.wrong == 0 && s.overlap == 0, what, &failures);
+        snprintf(what, sizeof(what), "%s: new output rises a dead time after the old one falls", l.name);
+        simCheck(s.shortGap == 0, what, &failures);
+        // First switch from off: make only; last to off: break only.
+        snprintf(what, sizeof(what), "%s: one write per bank for the break and one for the make", l.name);
+        simCheck(s.transactions == (uint64_t)(2 * s.switches - 2), what, &failures);
+    }
+    simCheck(results[1].busBytes == (uint64_t)(2 * results[1].switches - 2) * 2,
+             "595 chain: both registers latched in one 16-bit transfer", &failures);
+
+    // ---- Several outputs at once (on the 24-output expander map) ----
+    const Layout& mcp = layouts[2];
+    get("/set?ant=2");
+    simRunFor(50000);
+    const SimBusStats b0 = simBusStats();
+    uint32_t before = levels(mcp);
+    size_t from = simGpioEdges().size();
+    const SimHttpRequest* r = get("/set?mask=0x30005");
+    simRunFor(50000);
+    Replay rp = replay(mcp, before, from);
+    printf("  /set?mask=0x30005 -> %s\n", r->response.c_str());
+    simCheck(r->code == 200 && r->response == "{\"antenna\":-1,\"outputs\":196613,\"count\":24,"
+                                              "\"result\":\"applied\",\"superseded\":null}",
+             "/set?mask answers with the selection", &failures);
+    simCheck(levels(mcp) == 0x30005 && rp.firstRiseUs == rp.lastRiseUs,
+             "outputs 1, 3, 17 and 18 rise together", &failures);
+    simCheck(simBusStats().i2cTransfers - b0.i2cTransfers == 3, "... one break write, one make write per expander",
+             &failures);
+    simRunFor(MQTT_PUBLISH_INTERVAL_MS * 1000);   // outbox rate limit after the switching above
+    simCheck(lastState() == "1+3+17+18", "MQTT state lists the selection", &failures);
+
+    before = levels(mcp);
+    from = simGpioEdges().size();
+    r = get("/set?ant=2,4");
+    simRunFor(50000);
+    rp = replay(mcp, before, from);
+    simCheck(levels(mcp) == 0xa && rp.maxOn <= 4 && rp.gapUs >= (int64_t)DEAD_US,
+             "/set?ant=2,4 breaks the old set before making the new one", &failures);
+
+    simMqttInject(mqttCfg.topicCmd.c_str(), "{\"mask\":96,\"id\":\"pa\"}");
+    simRunFor(50000);
+    const bool mqttMask = levels(mcp) == 0x60;
+    simMqttInject(mqttCfg.topicCmd.c_str(), "20+24");
+    simRunFor(50000);
+    simCheck(mqttMask && levels(mcp) == (outputBit(20) | outputBit(24)) && lastState() == "20+24",
+             "MQTT {\"mask\":96} and 20+24", &failures);
+    simMqttInject(mqttCfg.topicCmd.c_str(), "next");
+    simRunFor(50000);
+    simCheck(levels(mcp) == outputBit(21) && currentAntenna == 21, "next steps on from the lowest selected", &failures);
+
+    // ---- Reboot keeps a combination ----
+    get("/set?ant=5+9");
+    simRunFor((JOURNAL_QUIET_MS + 1000) * 1000ULL);
+    simBoot();
+    simRunFor(100000);
+    simCheck(currentOutputs == (outputBit(5) | outputBit(9)) && levels(mcp) == currentOutputs,
+             "combination restored after a reboot", &failures);
+
+    // ---- Journal from the four-output firmware ----
+    simNvsErase();
+    uint8_t legacy[4] = {7, 0, 3, 0};    // seq 7, antenna 3
+    legacy[3] = crc8(legacy, 3);
+    simNvsWrite("antJournal", "j7", std::vector<uint8_t>(legacy, legacy + 4));
+    simBoot();
+    simRunFor(100000);
+    simCheck(currentAntenna == 3 && simGpioLevel(18) == HIGH && journalStats().seq == 7,
+             "4-byte journal record restores its antenna", &failures);
+
+    // ---- Missing expander ----
+    simNvsErase();
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    simI2cSetPresent(0x21, false);
+    applyMap(mcp.spec);
+    const uint32_t failuresAtBoot = outputsStats().failures;
+    get("/set?ant=18");
+    simRunFor(50000);
+    const uint32_t failuresAfter = outputsStats().failures;
+    get("/set?ant=2");
+    simRunFor(50000);
+    simI2cSetPresent(0x21, true);
+    simCheck(failuresAtBoot == 1 && failuresAfter == 2 && levels(mcp) == outputBit(2),
+             "absent expander counted, the other one keeps switching", &failures);
+
+    // ---- Bad map ----
+    const uint32_t restarts = simRestarts();
+    const uint32_t bad = simHttpRequest(HTTP_POST, "/settings", "mqttEnabled=on&outputMap=gpio+16%3B+595+1+2");
+    simRunUntil([bad] { return simHttpResult(bad)->respondedUs != 0; }, 5000000);
+    printf("  bad map: %d %s\n", simHttpResult(bad)->code, simHttpResult(bad)->response.c_str());
+    simCheck(simHttpResult(bad)->code == 400 && simRestarts() == restarts && relayCfg.outputMap == mcp.spec,
+             "a map that does not parse is refused, nothing reboots", &failures);
+    const uint32_t flash = simHttpRequest(HTTP_POST, "/settings", "mqttEnabled=on&outputMap=gpio+16+17+11");
+    simRunUntil([flash] { return simHttpResult(flash)->respondedUs != 0; }, 5000000);
+    simCheck(simHttpResult(flash)->code == 400 && simRestarts() == restarts && relayCfg.outputMap == mcp.spec &&
+             simHttpResult(flash)->response.find("GPIO 11 is not an output pin") != std::string::npos,
+             "a map on the flash pins is refused, nothing reboots", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject().field("scenario", "outputs");
+        for (int i = 0; i < 3; i++) {
+            json.beginObject(layouts[i].name)
+                .field("outputs", (uint64_t)layouts[i].pins.size())
+                .field("switches", results[i].switches)
+                .field("bank_writes", results[i].transactions)
+                .field("bus_bytes", results[i].busBytes)
+                .endObject();
+        }
+        json.field("failures", failures).endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
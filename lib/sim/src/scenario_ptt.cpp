@@ -0,0 +1,386 @@
+// --------------------------------------------------
+// Scenario: TX interlock
+//
+// Sets a PTT input (active low) and an amplifier key output through
+// /settings, then replays a seeded minute of operating: long overs,
+// short taps and CW-like bursts on the PTT line while HTTP and MQTT
+// commands keep arriving, during TX as well. From the pin log: no relay
+// edge falls between the PTT interrupt and the end of the release hold,
+// the amplifier is keyed only inside TX, onto a connected antenna that
+// has been still for a dead time, and commands held through TX land as
+// one switch to the last of them. Then the corner cases one at a time:
+// key delay with settled relays and right after a switch, PTT in the
+// middle of a break, PTT with every output off, and a boot with PTT
+// already down.
+// --------------------------------------------------
+
+#include <algorithm>
+
+#include "antenna_switch.h"
+#include "relay_sequencer.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+#include "state_journal.h"
+#include "tx_interlock.h"
+
+namespace {
+
+const uint64_t DEAD_US   = 10000;        // default relayDeadMs
+const int      PTT_PIN   = 4;
+const int      AMP_PIN   = 25;
+
+const SimHttpRequest* request(HTTPMethod method, const std::string& uri, const std::string& body = "")
+{
+    const uint32_t id = simHttpRequest(method, uri, body);
+    simRunUntil([id] { return simHttpResult(id)->respondedUs != 0 || simHttpResult(id)->code < 0; }, 5000000);
+    return simHttpResult(id);
+}
+
+uint32_t levels()
+{
+    uint32_t m = 0;
+    for (int i = 0; i < 4; i++) {
+        if (simGpioLevel(16 + i) == HIGH) m |= 1u << i;   // OUTPUT_MAP_DEFAULT: gpio 16 17 18 19
+    }
+    return m;
+}
+
+bool isRelay(const SimGpioEdge& e)
+{
+    return e.pin >= 16 && e.pin <= 19;
+}
+
+uint32_t lcg(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+uint32_t between(uint32_t* state, uint32_t lo, uint32_t hi)
+{
+    return lo + lcg(state) % (hi - lo + 1);
+}
+
+void ptt(bool down)
+{
+    simGpioSetInput(PTT_PIN, down ? LOW : HIGH);
+}
+
+struct Window
+{
+    uint64_t assertUs;
+    uint64_t releaseUs;
+};
+
+// Relay edges inside [from, to)
+int relayEdges(uint64_t fromUs, uint64_t toUs, int* rises = nullptr)
+{
+    int n = 0;
+    if (rises) *rises = 0;
+    for (const SimGpioEdge& e : simGpioEdges()) {
+        if (!isRelay(e) || e.atUs < fromUs || e.atUs >= toUs) continue;
+        n++;
+        if (rises && e.level) (*rises)++;
+    }
+    return n;
+}
+
+// Rising edges of the amplifier key at or after fromUs
+std::vector<uint64_t> keyRises(uint64_t fromUs)
+{
+    std::vector<uint64_t> r;
+    for (const SimGpioEdge& e : simGpioEdges()) {
+        if (e.pin == AMP_PIN && e.level && e.atUs >= fromUs) r.push_back(e.atUs);
+    }
+    return r;
+}
+
+// Time the interrupt sees an edge made at us; the hold ends TX_RELEASE_HOLD_US after that.
+uint64_t isrAt(uint64_t us)
+{
+    return us + simCosts.isrLatencyUs;
+}
+
+} // namespace
+
+int scenarioPtt(const SimOptions& opt)
+{
+    int failures = 0;
+    const std::string cmdTopic = "stationpilot/antennaSwitch/cmd";
+
+    simNvsErase();
+    ptt(false);
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    simRunFor(500000);
+    simCheck(!txInterlockStats().enabled, "no interlock by default", &failures);
+
+    // ---- Configure: reboots onto the new pins ----
+    const uint32_t restarts = simRestarts();
+    const uint32_t connects = simMqttConnects();
+    simHttpRequest(HTTP_POST, "/settings",
+                   "mqttEnabled=on&pttPin=" + std::to_string(PTT_PIN) + "&pttActiveLow=on&ampKeyPin=" +
+                       std::to_string(AMP_PIN));
+    simRunUntil([restarts] { return simRestarts() > restarts; }, 6000000);
+    simRunUntil([connects] { return simMqttConnects() > connects; }, 30000000);
+    simRunFor(500000);
+    simCheck(simRestarts() == restarts + 1 && txInterlockStats().enabled && txCfg.ampKeyPin == AMP_PIN,
+             "PTT pin set through /settings, applied after the reboot", &failures);
+    simCheck(request(HTTP_GET, "/settings")->response.find("name='pttPin' min='-1' max='39' value='4'") !=
+                 std::string::npos,
+             "settings page shows it", &failures);
+
+    // ---- Corner cases, one at a time ----
+    request(HTTP_GET, "/set?ant=1");
+    simRunFor(100000);
+
+    // Settled relays: keyed from the interrupt itself
+    uint64_t t0 = simNow();
+    ptt(true);
+    simRunFor(50000);
+    const TxInterlockStats settled = txInterlockStats();
+    const std::vector<uint64_t> k0 = keyRises(t0);
+    printf("ptt: settled relays, key %u us after the PTT interrupt\n", settled.lastKeyDelayUs);
+    simCheck(settled.transmitting && settled.keyed && k0.size() == 1 && k0[0] == isrAt(t0),
+             "settled relays: amplifier keyed in the interrupt", &failures);
+    ptt(false);
+    simRunFor(50000);
+    simCheck(simGpioLevel(AMP_PIN) == LOW && !txInterlockStats().held, "released: key drops, hold ends", &failures);
+
+    // PTT 2 ms after a switch made: key waits for the dead time
+    request(HTTP_GET, "/set?ant=2");
+    simRunUntil([] { return levels() == 0x2; }, 100000);
+    uint64_t madeUs = 0;
+    for (const SimGpioEdge& e : simGpioEdges()) {
+        if (isRelay(e)) madeUs = e.atUs;
+    }
+    simRunFor(2000);
+    t0 = simNow();
+    ptt(true);
+    simRunFor(50000);
+    const std::vector<uint64_t> k1 = keyRises(t0);
+    const TxInterlockStats late = txInterlockStats();
+    printf("ptt: 2 ms after a switch, key %u us after the PTT interrupt (%.1f ms after the make)\n",
+           late.lastKeyDelayUs, k1.empty() ? -1.0 : (k1[0] - madeUs) / 1000.0);
+    simCheck(k1.size() == 1 && k1[0] >= madeUs + DEAD_US && k1[0] < madeUs + DEAD_US + 200 && late.keyedLate == 1,
+             "just switched: amplifier keyed once the relays settle", &failures);
+    ptt(false);
+    simRunFor(50000);
+
+    // PTT in the middle of a break: nothing connected, nothing keyed, the
+    // make waits for the release
+    request(HTTP_GET, "/set?ant=3");
+    simRunUntil([] { return levels() == 0; }, 100000);
+    simRunFor(3000);
+    t0 = simNow();
+    ptt(true);
+    simRunFor(300000);
+    const TxInterlockStats inBreak = txInterlockStats();
+    simCheck(levels() == 0 && keyRises(t0).empty() && inBreak.inhibited == 1,
+             "PTT during a break: make held, amplifier not keyed", &failures);
+    const uint64_t upUs = simNow();
+    ptt(false);
+    simRunUntil([] { return levels() == 0x4; }, 200000);
+    const double makeAfterMs = (simNow() - upUs) / 1000.0;
+    printf("ptt: break held through TX, made %.1f ms after release\n", makeAfterMs);
+    simCheck(levels() == 0x4 && simNow() >= isrAt(upUs) + TX_RELEASE_HOLD_US, "... and made after the release hold",
+             &failures);
+
+    // Every output off: transmitting into nothing is not keyed
+    request(HTTP_GET, "/set?ant=0");
+    simRunFor(100000);
+    t0 = simNow();
+    ptt(true);
+    simRunFor(100000);
+    simCheck(keyRises(t0).empty() && txInterlockStats().inhibited == 2, "all outputs off: amplifier not keyed",
+             &failures);
+    ptt(false);
+    simRunFor(100000);
+
+    // Five commands during one over: one switch, to the last
+    request(HTTP_GET, "/set?ant=1");
+    simRunFor(100000);
+    t0 = simNow();
+    ptt(true);
+    simRunFor(20000);
+    const uint32_t deferredBefore = relaySequencerStats().deferred;
+    const uint32_t switchesBefore = relaySequencerStats().transitions;
+    const int over[] = {2, 3, 4, 1, 3};
+    for (size_t i = 0; i < sizeof(over) / sizeof(over[0]); i++) {
+        if (i % 2) simMqttInject(cmdTopic, std::to_string(over[i]));
+        else simHttpRequest(HTTP_GET, "/set?ant=" + std::to_string(over[i]));
+        simRunFor(150000);
+    }
+    simCheck(levels() == 0x1 && currentAntenna == 3 && relayEdges(t0, simNow()) == 0,
+             "commands acknowledged during TX, relays untouched", &failures);
+    const uint64_t overUpUs = simNow();
+    ptt(false);
+    simRunFor(200000);
+    int rises = 0;
+    const int edges = relayEdges(overUpUs, simNow(), &rises);
+    simCheck(levels() == 0x4 && edges == 2 && rises == 1 &&
+                 relaySequencerStats().deferred - deferredBefore == 5 &&
+                 relaySequencerStats().transitions - switchesBefore == 1,
+             "five commands through one over: one switch, to the last", &failures);
+
+    // ---- Seeded replay ----
+    uint32_t seed = opt.seed;
+    const uint64_t startUs = simNow() + 100000;
+    const uint64_t spanUs = (opt.count ? opt.count : 60) * 1000000ULL;
+    std::vector<Window> windows;
+    uint64_t t = startUs;
+    while (t < startUs + spanUs) {
+        t += between(&seed, 20, 900) * 1000ULL;  // receive gap, some shorter than the hold
+        const uint32_t kind = lcg(&seed) % 3;
+        int elements = 1;
+        if (kind == 2) elements = between(&seed, 8, 30);
+        for (int i = 0; i < elements; i++) {
+            uint32_t onMs;
+            if (kind == 0) onMs = between(&seed, 500, 4000);       // an over
+            else if (kind == 1) onMs = between(&seed, 15, 150);    // a tap
+            else onMs = between(&seed, 40, 120);                   // CW, semi break-in
+            windows.push_back(Window{t, t + onMs * 1000ULL});
+            t += onMs * 1000ULL + (kind == 2 ? between(&seed, 10, 120) * 1000ULL : 0);
+        }
+    }
+    const uint64_t endUs = t;
+    for (const Window& w : windows) {
+        simAt(w.assertUs, [] { ptt(true); });
+        simAt(w.releaseUs, [] { ptt(false); });
+    }
+
+    struct Command
+    {
+        uint64_t atUs;
+        int      antenna;
+    };
+    std::vector<Command> cmds;
+    for (uint64_t c = startUs + between(&seed, 0, 100) * 1000ULL; c < endUs; c += between(&seed, 60, 400) * 1000ULL) {
+        const Command cmd{c, (int)between(&seed, 1, 4)};
+        cmds.push_back(cmd);
+        const bool mqtt = lcg(&seed) & 1;
+        simAt(c, [cmd, mqtt, cmdTopic] {
+            if (mqtt) simMqttInject(cmdTopic, std::to_string(cmd.antenna));
+            else simHttpRequest(HTTP_GET, "/set?ant=" + std::to_string(cmd.antenna));
+        });
+    }
+
+    const TxInterlockStats txBefore = txInterlockStats();
+    const RelaySequencerStats seqBefore = relaySequencerStats();
+    const size_t edgeFrom = simGpioEdges().size();
+    simRunFor(endUs - simNow() + 500000);
+    const TxInterlockStats txAfter = txInterlockStats();
+    const RelaySequencerStats seqAfter = relaySequencerStats();
+
+    // Hold periods: from the PTT interrupt to the end of the release
+    // hold; an assert inside the hold extends it
+    std::vector<Window> holds;
+    for (const Window& w : windows) {
+        const uint64_t from = isrAt(w.assertUs), to = isrAt(w.releaseUs) + TX_RELEASE_HOLD_US;
+        if (!holds.empty() && from <= holds.back().releaseUs) holds.back().releaseUs = to;
+        else holds.push_back(Window{from, to});
+    }
+    auto inHold = [&holds](uint64_t us) {
+        auto it = std::upper_bound(holds.begin(), holds.end(), us,
+                                   [](uint64_t v, const Window& h) { return v < h.assertUs; });
+        return it != holds.begin() && us < std::prev(it)->releaseUs;
+    };
+    auto inTx = [&windows](uint64_t us) {
+        auto it = std::upper_bound(windows.begin(), windows.end(), us,
+                                   [](uint64_t v, const Window& w) { return v < w.assertUs; });
+        return it != windows.begin() && us <= isrAt(std::prev(it)->releaseUs) && us >= isrAt(std::prev(it)->assertUs);
+    };
+
+    const std::vector<SimGpioEdge>& log = simGpioEdges();
+    int hotEdges = 0, keyOutsideTx = 0, keyUnsettled = 0, keyOpen = 0, keyRisesSeen = 0;
+    uint64_t lastRelayUs = 0;
+    uint32_t on = 0;
+    for (size_t i = 0; i < log.size(); i++) {
+        const SimGpioEdge& e = log[i];
+        if (isRelay(e)) {
+            if (i >= edgeFrom && inHold(e.atUs)) hotEdges++;
+            lastRelayUs = e.atUs;
+            const uint32_t bit = 1u << (e.pin - 16);
+            on = e.level ? on | bit : on & ~bit;
+        } else if (e.pin == AMP_PIN && i >= edgeFrom) {
+            if (!inTx(e.atUs)) keyOutsideTx++;
+            if (e.level) {
+                keyRisesSeen++;
+                if (e.atUs < lastRelayUs + DEAD_US) keyUnsettled++;
+                if (!on) keyOpen++;
+            }
+        }
+    }
+
+    // Commands that arrived outside every hold can each start a switch;
+    // those inside one add at most one between them
+    int outside = 0, holdsWithCommands = 0;
+    size_t h = 0;
+    bool counted = false;
+    for (const Command& c : cmds) {
+        while (h < holds.size() && holds[h].releaseUs <= c.atUs) {
+            h++;
+            counted = false;
+        }
+        if (h < holds.size() && c.atUs >= holds[h].assertUs) {
+            if (!counted) holdsWithCommands++;
+            counted = true;
+        } else {
+            outside++;
+        }
+    }
+    const uint32_t switches = seqAfter.transitions - seqBefore.transitions;
+    const uint32_t deferred = seqAfter.deferred - seqBefore.deferred;
+
+    printf("ptt: %zu PTT windows (%zu hold periods) over %.1f s, %zu commands\n", windows.size(), holds.size(),
+           (endUs - startUs) / 1e6, cmds.size());
+    printf("ptt: %u switches, %u commands deferred, %d outside TX, %d hold periods with commands\n", switches,
+           deferred, outside, holdsWithCommands);
+    printf("ptt: %d amplifier keys, %u late, %u inhibited\n", keyRisesSeen,
+           txAfter.keyedLate - txBefore.keyedLate, txAfter.inhibited - txBefore.inhibited);
+    simCheck(hotEdges == 0, "no relay edge from the PTT interrupt to the end of the release hold", &failures);
+    simCheck(txAfter.transmissions - txBefore.transmissions == windows.size(), "every PTT edge seen", &failures);
+    simCheck(keyOutsideTx == 0 && keyUnsettled == 0 && keyOpen == 0,
+             "amplifier keyed only inside TX, onto a connected antenna settled for a dead time", &failures);
+    simCheck(deferred > 0 && switches <= (uint32_t)(outside + holdsWithCommands),
+             "commands held through TX coalesce into one switch at release", &failures);
+    simCheck(levels() == outputBit(cmds.back().antenna) && !txAfter.held && simGpioLevel(AMP_PIN) == LOW,
+             "replay ends on the last command, released and unkeyed", &failures);
+
+    // ---- Boot with PTT down: the restored antenna waits for the release ----
+    request(HTTP_GET, "/set?ant=2");
+    simRunFor(JOURNAL_QUIET_MS * 1000ULL + 500000);   // journal flush
+    ptt(true);
+    simBoot();
+    simRunFor(200000);
+    simCheck(levels() == 0 && txInterlockStats().transmitting, "boot during TX: relays stay off", &failures);
+    const uint64_t bootUpUs = simNow();
+    ptt(false);
+    simRunFor(100000);
+    simCheck(levels() == 0x2 && relayEdges(bootUpUs, isrAt(bootUpUs) + TX_RELEASE_HOLD_US) == 0,
+             "... and come up on the restored antenna after the release hold", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject().field("scenario", "ptt");
+        json.field("windows", (uint32_t)windows.size())
+            .field("commands", (uint32_t)cmds.size())
+            .field("switches", switches)
+            .field("deferred", deferred)
+            .field("hot_edges", hotEdges)
+            .field("key_delay_settled_us", settled.lastKeyDelayUs)
+            .field("key_delay_after_switch_us", late.lastKeyDelayUs)
+            .field("max_key_delay_us", txAfter.maxKeyDelayUs)
+            .field("failures", failures)
+            .endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
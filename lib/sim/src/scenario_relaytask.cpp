@@ -0,0 +1,313 @@
+// --------------------------------------------------
+// Scenario: relay task and its hand-off
+//
+// First the two structures on real host threads: producers hammer the
+// ring, serialised by a mutex as posters are by halCritical, while one
+// lock-free consumer checks that nothing is lost or reordered, and
+// readers copy the seqlock snapshot while a writer rewrites it, looking
+// for a torn value. Then the firmware: another task
+// posts relay commands while loop() sits in a blocking MQTT connect, and
+// the relay edges are timed against the post. Last, a burst larger than
+// the ring is dropped and counted rather than blocking the poster.
+// --------------------------------------------------
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "antenna_switch.h"
+#include "hal.h"
+#include "lockfree.h"
+#include "relay_task.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+
+namespace {
+
+const int PINS[] = {16, 17, 18, 19};   // OUTPUT_MAP_DEFAULT
+const int NUM_ANTENNAS = 4;
+
+// ---- Ring: P producers taking turns, one consumer, every item accounted for ----
+struct Item
+{
+    uint32_t producer;
+    uint32_t seq;
+};
+
+struct RingResult
+{
+    uint64_t items;
+    uint64_t fullRetries;
+    uint32_t lost;
+    uint32_t reordered;
+};
+
+RingResult ringStress(int producers, uint32_t ms)
+{
+    static SpscRing<Item, RELAY_QUEUE_LEN> ring;
+    static std::mutex producer;                 // halCritical in post()
+    ring.reset();
+    std::atomic<bool> stop(false);
+    std::atomic<int> running(producers);
+    std::atomic<uint64_t> retries(0);
+    std::vector<uint32_t> pushed(producers, 0);
+    std::vector<std::thread> threads;
+    RingResult r = {};
+
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([p, &stop, &running, &retries, &pushed] {
+            uint64_t full = 0;
+            uint32_t i = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                bool ok;
+                {
+                    std::lock_guard<std::mutex> lock(producer);
+                    ok = ring.push(Item{(uint32_t)p, i});
+                }
+                if (ok) {
+                    i++;
+                } else {
+                    full++;
+                    std::this_thread::yield();
+                }
+            }
+            pushed[p] = i;
+            retries += full;
+            running--;
+        });
+    }
+    std::thread timer([&stop, ms] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        stop = true;
+    });
+
+    std::vector<uint32_t> next(producers, 0);
+    Item item;
+    for (;;) {
+        const bool last = running.load() == 0;      // producers done: drain and stop
+        if (ring.pop(&item)) {
+            if (item.seq != next[item.producer]) r.reordered++;
+            next[item.producer] = item.seq + 1;
+            r.items++;
+        } else if (last) {
+            break;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    timer.join();
+    for (std::thread& t : threads) t.join();
+
+    for (int p = 0; p < producers; p++) {
+        if (next[p] != pushed[p]) r.lost++;
+    }
+    r.fullRetries = retries;
+    return r;
+}
+
+// ---- Seqlock: readers never see a half-written value ----
+struct Wide
+{
+    uint32_t a;
+    uint32_t b;                              // ~a
+    uint32_t c;                              // a * 3
+    uint32_t d;                              // a ^ 0x5a5a5a5a
+};
+
+struct SnapshotResult
+{
+    uint64_t writes;
+    uint64_t reads;
+    uint64_t torn;
+};
+
+SnapshotResult snapshotStress(int readers, uint32_t ms)
+{
+    static SeqLock<Wide> lock;
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> reads(0), torn(0);
+    std::vector<std::thread> threads;
+    lock.write(Wide{0, ~0u, 0, 0x5a5a5a5au});
+
+    for (int i = 0; i < readers; i++) {
+        threads.emplace_back([&] {
+            uint64_t n = 0, bad = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                const Wide w = lock.read();
+                if (w.b != ~w.a || w.c != w.a * 3 || w.d != (w.a ^ 0x5a5a5a5au)) bad++;
+                n++;
+            }
+            reads += n;
+            torn += bad;
+        });
+    }
+    std::thread timer([&stop, ms] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        stop = true;
+    });
+    uint64_t writes = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        const uint32_t a = (uint32_t)++writes;
+        lock.write(Wide{a, ~a, a * 3, a ^ 0x5a5a5a5au});
+    }
+    timer.join();
+    for (std::thread& t : threads) t.join();
+    return SnapshotResult{writes, reads, torn};
+}
+
+// ---- Firmware: commands from another task while loop() is blocked ----
+struct Post
+{
+    uint64_t atUs;
+    int      antenna;
+    uint64_t edgeUs;
+};
+
+bool pinsShow(int antenna)
+{
+    for (int i = 0; i < NUM_ANTENNAS; i++) {
+        if (simGpioLevel(PINS[i]) != (antenna == i + 1 ? HIGH : LOW)) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int scenarioRelayTask(const SimOptions& opt)
+{
+    const int producers = 4;
+    const uint32_t stressMs = opt.count ? opt.count : 1000;      // per host-thread test
+    const uint32_t hw = std::thread::hardware_concurrency();
+    int failures = 0;
+
+    // ---- Host threads ----
+    const RingResult ring = ringStress(producers, stressMs);
+    printf("relaytask: ring of %u, %d producers + 1 consumer for %u ms on %u host CPUs\n", RELAY_QUEUE_LEN,
+           producers, stressMs, hw);
+    printf("  %llu items, %llu pushes found it full, %u lost, %u out of order\n", (unsigned long long)ring.items,
+           (unsigned long long)ring.fullRetries, ring.lost, ring.reordered);
+    simCheck(ring.items > 0 && ring.lost == 0 && ring.reordered == 0, "ring loses and reorders nothing", &failures);
+
+    const SnapshotResult snap = snapshotStress(3, stressMs);
+    printf("  snapshot: %llu writes, %llu reads, %llu torn\n", (unsigned long long)snap.writes,
+           (unsigned long long)snap.reads, (unsigned long long)snap.torn);
+    simCheck(snap.reads > 0 && snap.torn == 0, "snapshot reads are never torn", &failures);
+
+    // ---- Firmware under a blocking MQTT connect ----
+    simNvsErase();
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    simRunFor(500000);
+
+    // A broker that takes 3 s to accept: loop() sits in connect() for all of it.
+    const uint32_t savedConnectUs = simCosts.mqttConnectUs;
+    simCosts.mqttConnectUs = 3000000;
+    simMqttSetBrokerUp(false);
+    simRunFor(100000);
+    simMqttSetBrokerUp(true);
+    simResetLoopStats();
+    const RelayTaskStats before = relayTaskStats();
+
+    // Another task posts every 50 ms for 10 s, covering the next reconnect.
+    std::vector<Post> posts;
+    uint32_t maxLag = 0;
+    const uint64_t start = simNow() + 100000;
+    for (int i = 0; i < 200; i++) posts.push_back(Post{start + (uint64_t)i * 50000, 1 + i % NUM_ANTENNAS, 0});
+    for (size_t i = 0; i < posts.size(); i++) {
+        simAt(posts[i].atUs, [&posts, &maxLag, i] {
+            relayPost(RELAY_SELECT, posts[i].antenna, RELAY_SRC_LOCAL, halMicros());
+            // Snapshot versions the relay task applied that loop() has not handled yet
+            const uint32_t lag = relaySnapshot().version - relayStateVersion;
+            if (lag > maxLag) maxLag = lag;
+        });
+        // Relay edge: sample the pins every 100 us until they show the post.
+        for (uint64_t t = posts[i].atUs; t < posts[i].atUs + 45000; t += 100) {
+            simAt(t, [&posts, i] {
+                if (!posts[i].edgeUs && pinsShow(posts[i].antenna)) posts[i].edgeUs = simNow();
+            });
+        }
+    }
+    simRunFor(start + posts.size() * 50000 - simNow() + 200000);
+    simCosts.mqttConnectUs = savedConnectUs;
+
+    const SimLoopStats loops = simLoopStats();
+    const RelayTaskStats after = relayTaskStats();
+    const RelayLatency& local = after.latency[RELAY_SRC_LOCAL];
+    std::vector<double> edges;
+    uint32_t missed = 0;
+    for (const Post& p : posts) {
+        if (p.edgeUs) edges.push_back((p.edgeUs - p.atUs) / 1000.0);
+        else missed++;
+    }
+    const SimSummary edgeSum = simSummarize(edges);
+    printf("  %zu posts while loop() blocked up to %.0f ms; loop() fell %u snapshots behind\n", posts.size(),
+           loops.maxUs / 1000.0, maxLag);
+    simPrintSummary("post->edge", "ms", edgeSum);
+    printf("  post->sequencer max=%u us, %u over %u us, dead time %u ms\n", local.maxUs,
+           local.overBudget - before.latency[RELAY_SRC_LOCAL].overBudget, RELAY_BUDGET_US, relayCfg.deadTimeMs);
+    simCheck(loops.maxUs >= 3000000 && maxLag > 10, "commands applied while loop() was blocked", &failures);
+    simCheck(missed == 0 && edgeSum.max < relayCfg.deadTimeMs + 1.0, "every edge within the dead time + 1 ms",
+             &failures);
+    simCheck(local.overBudget == before.latency[RELAY_SRC_LOCAL].overBudget, "post -> sequencer within budget",
+             &failures);
+    simCheck(currentAntenna == posts.back().antenna && relaySnapshot().antenna == posts.back().antenna,
+             "loop() catches up with the snapshot", &failures);
+
+    // ---- Burst past the ring ----
+    const uint32_t burst = RELAY_QUEUE_LEN + 4;
+    uint32_t accepted = 0;
+    int lastAccepted = 0;
+    for (uint32_t i = 0; i < burst; i++) {
+        const int ant = (int)(i % (NUM_ANTENNAS + 1));
+        if (relayPost(RELAY_SELECT, ant, RELAY_SRC_LOCAL, halMicros())) {
+            accepted++;
+            lastAccepted = ant;
+        }
+    }
+    simRunFor(100000);
+    const RelayTaskStats burstStats = relayTaskStats();
+    printf("  burst of %u: %u accepted, %u dropped, peak depth %u\n", burst, accepted,
+           burstStats.dropped - after.dropped, burstStats.peakDepth);
+    simCheck(accepted == RELAY_QUEUE_LEN && burstStats.dropped - after.dropped == burst - RELAY_QUEUE_LEN,
+             "overflow is dropped and counted, not waited for", &failures);
+    simCheck(relaySnapshot().antenna == lastAccepted && pinsShow(lastAccepted), "last accepted command wins",
+             &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "relaytask");
+        json.beginObject("ring")
+            .field("producers", producers)
+            .field("items", ring.items)
+            .field("full_retries", ring.fullRetries)
+            .field("lost", ring.lost)
+            .field("reordered", ring.reordered)
+            .endObject();
+        json.beginObject("snapshot")
+            .field("writes", snap.writes)
+            .field("reads", snap.reads)
+            .field("torn", snap.torn)
+            .endObject();
+        json.beginObject("blocked_loop")
+            .field("loop_max_us", loops.maxUs)
+            .field("max_lag", maxLag)
+            .field("sequencer_max_us", local.maxUs)
+            .field("missed", missed);
+        simWriteSummary(json, "edge_ms", edgeSum);
+        json.endObject();
+        json.field("burst_dropped", burstStats.dropped - after.dropped)
+            .field("failures", failures)
+            .endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
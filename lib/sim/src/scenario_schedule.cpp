@@ -0,0 +1,272 @@
+// --------------------------------------------------
+// Scenario: on-device schedule
+//
+// Loads a schedule in one HTTP batch on a Monday morning and lets it run
+// while loop() keeps blocking in refused MQTT connects: every entry and
+// macro step must reach the relay task within its budget of the due
+// time, and the weekend entry must stay quiet. Then: the schedule comes
+// back from NVS after a reboot, entries follow the wall clock when it
+// steps, a running macro is ended by the next entry, a batch larger than
+// PubSubClient's default buffer loads over MQTT (and again, retained,
+// without another NVS write), bad batches are refused with the line at
+// fault, and nothing fires until an unsynced clock syncs.
+// --------------------------------------------------
+
+#include "antenna_switch.h"
+#include "hal.h"
+#include "scheduler.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+
+namespace {
+
+const uint64_t SEC    = 1000000ULL;
+const uint64_t MINUTE = 60 * SEC;
+const uint64_t HOUR   = 60 * MINUTE;
+const uint64_t DAY    = 24 * HOUR;
+const uint64_t MONDAY = 1767571200ULL * SEC;   // 2026-01-05 00:00 UTC
+
+const char BATCH[] =
+    "# morning rotation\n"
+    "macro 1 2/90s 3/1500ms 1\n"
+    "at 06:00 m1\n"
+    "at 6:10:00.250 mon-fri 4; at 06:20 weekends 2\n"
+    "at 06:30 off   # hand over\n";
+
+const char CANONICAL[] =
+    "macro 1 2/90s 3/1500ms 1\n"
+    "at 06:00 m1\n"
+    "at 06:10:00.250 weekdays 4\n"
+    "at 06:20 weekends 2\n"
+    "at 06:30 off\n";
+
+uint64_t utcNow()
+{
+    uint64_t us = 0;
+    halUtcMicros(&us);
+    return us;
+}
+
+void runToUtc(uint64_t utc)
+{
+    const uint64_t now = utcNow();
+    if (utc > now) simRunFor(utc - now);
+}
+
+const SimHttpRequest* request(HTTPMethod method, const std::string& uri, const std::string& body = "",
+                              const std::string& headers = "")
+{
+    const uint32_t id = simHttpRequest(method, uri, body, headers);
+    simRunUntil([id] { return simHttpResult(id)->respondedUs != 0 || simHttpResult(id)->code < 0; }, 5000000);
+    return simHttpResult(id);
+}
+
+std::string scheduleText()
+{
+    return request(HTTP_GET, "/schedule")->response;
+}
+
+size_t blobBytes()
+{
+    std::vector<uint8_t> blob;
+    return simNvsRead("antSwitch", "schedule", &blob) ? blob.size() : 0;
+}
+
+// When the outputs settled on ant after fromUs: its make edge, or for 0
+// the first break.
+uint64_t settledAt(int ant, uint64_t fromUs)
+{
+    const int pin = ant ? 15 + ant : -1;   // OUTPUT_MAP_DEFAULT: gpio 16 17 18 19
+    for (const SimGpioEdge& e : simGpioEdges()) {
+        if (e.atUs < fromUs) continue;
+        if (ant ? e.pin == pin && e.level : !e.level) return e.atUs;
+    }
+    return 0;
+}
+
+RelayLatency scheduleLatency()
+{
+    return relayTaskStats().latency[RELAY_SRC_SCHEDULE];
+}
+
+struct Firing
+{
+    uint64_t    utc;
+    int         antenna;
+    const char* what;
+};
+
+} // namespace
+
+int scenarioSchedule(const SimOptions& opt)
+{
+    int failures = 0;
+
+    simNvsErase();
+    simSetUtcMicros(MONDAY + 5 * HOUR + 58 * MINUTE);
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+
+    // ---- One batch over HTTP ----
+    const SimHttpRequest* post = request(HTTP_POST, "/schedule", BATCH, "Content-Type: text/plain\r\n");
+    printf("schedule: POST %d \"%s\"; %zu bytes of text stored as a %zu byte NVS blob\n", post->code,
+           post->response.c_str(), sizeof(BATCH) - 1, blobBytes());
+    simCheck(post->code == 200 && post->response == "4 entries, 1 macros", "batch loaded over HTTP", &failures);
+    simCheck(scheduleText() == CANONICAL, "GET /schedule returns the canonical text", &failures);
+    simCheck(blobBytes() == 4 + 4 * 6 + 1 + 3 * 4, "stored compactly", &failures);
+
+    // ---- Firing while loop() blocks ----
+    // Refused connects take mqttConnectUs / 10, one every 5 s.
+    const uint32_t savedConnectUs = simCosts.mqttConnectUs;
+    simCosts.mqttConnectUs = 30000000;
+    simMqttSetBrokerUp(false);
+    simResetLoopStats();
+
+    const Firing monday[] = {
+        {MONDAY + 6 * HOUR, 2, "06:00 m1 step 1"},
+        {MONDAY + 6 * HOUR + 90 * SEC, 3, "06:01:30 m1 step 2"},
+        {MONDAY + 6 * HOUR + 91500000ULL, 1, "06:01:31.5 m1 step 3"},
+        {MONDAY + 6 * HOUR + 10 * MINUTE + 250000, 4, "06:10:00.250 weekdays"},
+        {MONDAY + 6 * HOUR + 30 * MINUTE, 0, "06:30 off"},
+    };
+    const uint64_t simAtMonday = simNow() - utcNow();   // sim time = utc + this
+    const RelayLatency before = scheduleLatency();
+    runToUtc(MONDAY + 6 * HOUR + 31 * MINUTE);
+    const RelayLatency after = scheduleLatency();
+    const SimLoopStats loops = simLoopStats();
+
+    simCosts.mqttConnectUs = savedConnectUs;
+    const uint32_t connects = simMqttConnects();
+    simMqttSetBrokerUp(true);
+    simRunUntil([connects] { return simMqttConnects() > connects; }, 30000000);
+
+    const uint64_t deadUs = relayCfg.deadTimeMs * 1000ULL;
+    bool settled = true;
+    for (const Firing& f : monday) {
+        const uint64_t due = f.utc + simAtMonday;
+        const uint64_t at = settledAt(f.antenna, due);
+        const double ms = at ? (at - due) / 1000.0 : -1;
+        printf("  %-24s ant %d  outputs settled %+.3f ms after due\n", f.what, f.antenna, ms);
+        settled &= at && at - due <= deadUs + 1000;
+    }
+    printf("  relay task: %u scheduled commands, max %u us from due time; loop() blocked up to %.1f s\n",
+           after.count - before.count, after.maxUs, loops.maxUs / 1e6);
+    simCheck(after.count - before.count == 5, "every entry and step fired once, weekend entry skipped", &failures);
+    simCheck(after.maxUs <= RELAY_BUDGET_US && after.overBudget == before.overBudget,
+             "each command reached the relay task within budget of its due time", &failures);
+    simCheck(settled, "outputs settled within the dead time + 1 ms of every due time", &failures);
+    simCheck(loops.maxUs >= 3000000, "... while loop() was blocked for seconds", &failures);
+
+    // ---- Reboot: schedule from NVS, clock steps into Tuesday ----
+    const uint32_t beforeBoot = simMqttConnects();
+    simBoot();
+    simRunUntil([beforeBoot] { return simMqttConnects() > beforeBoot; }, 30000000);
+    simCheck(scheduleText() == CANONICAL && schedulerStats().entries == 4, "schedule restored from NVS", &failures);
+
+    const uint64_t tuesday = MONDAY + DAY;
+    simSetUtcMicros(tuesday + 5 * HOUR + 59 * MINUTE + 59 * SEC);
+    const uint64_t dueTuesday = simNow() + SEC;
+    runToUtc(tuesday + 6 * HOUR + 2 * SEC);
+    const uint64_t tuesdayAt = settledAt(2, dueTuesday);
+    printf("  clock stepped to Tue 05:59:59: m1 settled %+.3f ms after due\n",
+           tuesdayAt ? (tuesdayAt - dueTuesday) / 1000.0 : -1);
+    simCheck(tuesdayAt && tuesdayAt - dueTuesday <= deadUs + 1000 && schedulerStats().running == 1,
+             "entries follow a clock step", &failures);
+
+    // Saturday 06:20 arrives by another step while m1 is still on step 1:
+    // the entry ends the macro, so step 2 (ant 3) never comes.
+    const uint64_t saturday = MONDAY + 5 * DAY;
+    simSetUtcMicros(saturday + 6 * HOUR + 19 * MINUTE + 58 * SEC);
+    const uint64_t stepAt = simNow();
+    runToUtc(saturday + 6 * HOUR + 22 * MINUTE);
+    simCheck(settledAt(3, stepAt) == 0 && relaySnapshot().antenna == 2 && schedulerStats().running == 0,
+             "weekend entry fires and ends the running macro", &failures);
+
+    // ---- One batch over MQTT, larger than PubSubClient's default buffer ----
+    std::string plan =
+        "# contest weekend band plan: antenna per band opening, beacons on the hour\n"
+        "macro 2 1/10m 2/10m 3/10m 4\n"
+        "macro 3 4/2m 3\n";
+    const char* const times[] = {"00:00", "03:30", "06:15", "08:00", "11:45", "14:00", "16:30", "19:00",
+                                 "21:15", "23:00"};
+    for (int i = 0; i < 10; i++) {
+        plan += "at " + std::string(times[i]) + (i % 2 ? " sat,sun " : " weekdays ") + std::to_string(i % 4 + 1) +
+                "   # slot " + std::to_string(i) + "\n";
+    }
+    plan += "at 12:00:30.500 m2\nat 18:00 fri m3\n";
+    const std::string stateTopic = std::string(mqttCfg.topicState.c_str()) + "/schedule";
+    const std::string cmdTopic = std::string(mqttCfg.topicCmd.c_str()) + "/schedule";
+
+    auto lastReply = [&stateTopic]() -> std::string {
+        const auto& pub = simMqttPublished();
+        for (auto it = pub.rbegin(); it != pub.rend(); ++it) {
+            if (it->topic == stateTopic) return it->payload;
+        }
+        return "";
+    };
+
+    const size_t published = simMqttPublished().size();
+    simMqttInject(cmdTopic, plan);
+    simRunFor(200000);
+    const std::string reply = lastReply();
+    const bool replied = simMqttPublished().size() > published;
+    printf("  MQTT batch: %zu bytes -> \"%s\", blob %zu bytes\n", plan.size(), reply.c_str(), blobBytes());
+    simCheck(replied && reply == "12 entries, 2 macros" && schedulerStats().entries == 12,
+             "batch loaded over MQTT", &failures);
+
+    const uint64_t writes = simNvsKeyWrites("antSwitch", "schedule");
+    simMqttInject(cmdTopic, plan);
+    simRunFor(200000);
+    simCheck(simNvsKeyWrites("antSwitch", "schedule") == writes, "same batch again: no NVS write", &failures);
+
+    // ---- Bad batches ----
+    const std::string loaded = scheduleText();
+    simMqttInject(cmdTopic, "macro 1 2/90s 3\nat 25:00 m1\n");
+    simRunFor(200000);
+    printf("  bad MQTT batch -> \"%s\"\n", lastReply().c_str());
+    const SimHttpRequest* bad = request(HTTP_POST, "/schedule", "at 06:00 m4\n", "Content-Type: text/plain\r\n");
+    printf("  bad HTTP batch -> %d \"%s\"\n", bad->code, bad->response.c_str());
+    simCheck(lastReply() == "error: line 2: bad time '25:00'" && bad->code == 400 &&
+                 bad->response == "line 1: macro not defined" && scheduleText() == loaded,
+             "bad batches refused with the line, schedule kept", &failures);
+    const SimHttpRequest* longMacro = request(HTTP_POST, "/schedule",
+                                              "macro 8 1/1s 2/1s 3/1s 4/1s 1/1s 2/1s 3/1s 4/1s off\n",
+                                              "Content-Type: text/plain\r\n");
+    printf("  9-step macro -> %d \"%s\"\n", longMacro->code, longMacro->response.c_str());
+    simCheck(longMacro->code == 400 && longMacro->response == "line 1: too many steps" && scheduleText() == loaded,
+             "a macro one step over the limit is refused", &failures);
+
+    // ---- No wall clock ----
+    simSetUtcMicros(0);
+    simBoot();
+    simRunFor(5000000);
+    const SchedulerStats unsynced = schedulerStats();
+    simSetUtcMicros(MONDAY + 2 * DAY + 11 * HOUR + 59 * MINUTE);   // Wednesday
+    simRunFor(100000);
+    const SchedulerStats synced = schedulerStats();
+    printf("  unsynced: next %d ms; after sync: next in %.1f s\n", unsynced.nextInMs, synced.nextInMs / 1000.0);
+    simCheck(!unsynced.clockSynced && unsynced.nextInMs == -1 && synced.clockSynced &&
+                 synced.nextInMs > 90000 && synced.nextInMs <= 90500,
+             "entries wait for the clock", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "schedule")
+            .field("fired", (uint64_t)(after.count - before.count))
+            .field("max_us_from_due", (uint64_t)after.maxUs)
+            .field("loop_max_ms", loops.maxUs / 1000.0)
+            .field("blob_bytes", (uint64_t)blobBytes())
+            .field("failures", failures)
+            .endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
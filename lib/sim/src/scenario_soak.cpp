@@ -0,0 +1,468 @@
+// --------------------------------------------------
+// Scenario: multi-day soak
+//
+// Three simulated days of traffic against one boot: keep-alive HTTP
+// clients switching antennas and reading /state, with the odd /stats,
+// /metrics, /log, schedule and band plan read or rewrite, a settings
+// save (the whole form, as the page posts it), and MQTT
+// commands in every form the firmware takes. Once a day the AP drops
+// for half a minute and the broker restarts. The heap is sampled
+// between loop() passes every simulated hour, after an hour of warm-up
+// has touched every path: the largest free block must never be smaller
+// than it was then, free heap must come back to where it was, and no
+// allocation may fail.
+//
+// --count is the number of commands (HTTP requests plus MQTT messages)
+// spread over the three days, 2 million by default.
+// --------------------------------------------------
+
+#include <algorithm>
+#include <memory>
+#include <random>
+
+#include "antenna_switch.h"
+#include "outputs.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+
+namespace {
+
+const uint64_t SEC  = 1000000ULL;
+const uint64_t HOUR = 3600 * SEC;
+const uint64_t DAY  = 24 * HOUR;
+const int      DAYS = 3;
+const int      HTTP_CLIENTS = 2;
+const double   HTTP_SHARE = 0.6;         // of the commands; MQTT has the rest
+const uint64_t REQUEST_TIMEOUT_US = 10 * SEC;
+const uint64_t OUTAGE_GRACE_US = 60 * SEC;   // failures this soon after an outage are expected
+
+const char* const SCHEDULES[2] = {
+    "macro 1 2/90s 3/1500ms 1\nat 06:00 m1\nat 06:30 off\n",
+    "at 07:15 weekdays 2\nat 22:00 off\n",
+};
+
+const char* const BAND_PLANS[2] = {
+    "7000k-7200k 2\n14000k-14350k 3\n21000k-21450k 4\n",
+    "3500k-3800k 1\n14000k-14350k 3\n28000k-29700k 4\n",
+};
+
+std::string formEncode(const char* s)
+{
+    std::string out;
+    for (; *s; s++) {
+        if (*s == ' ') out += '+';
+        else if (*s == ';') out += "%3B";
+        else out += *s;
+    }
+    return out;
+}
+
+// The settings form as the page posts it, with what is in effect and a
+// band hysteresis that alternates, so every save rewrites the record.
+// Nothing in it reboots.
+std::string settingsForm(uint32_t n)
+{
+    return "wifiSSID=" + formEncode(wifiCfg.ssid.c_str()) + "&wifiPass=" + formEncode(wifiCfg.password.c_str()) +
+           "&gatewayIP=" + wifiCfg.gatewayIP.toString().c_str() + "&staticIP=&subnet=" +
+           wifiCfg.subnet.toString().c_str() + "&mqttEnabled=on&mqttBroker=" + mqttCfg.broker.c_str() +
+           "&mqttPort=" + std::to_string(mqttCfg.port) + "&mqttUser=" + mqttCfg.user.c_str() +
+           "&mqttPass=" + mqttCfg.password.c_str() + "&mqttCmd=" + mqttCfg.topicCmd.c_str() +
+           "&mqttState=" + mqttCfg.topicState.c_str() + "&relayDeadMs=" + std::to_string(relayCfg.deadTimeMs) +
+           "&outputMap=" + formEncode(relayCfg.outputMap.c_str()) +
+           "&cmdWindowMs=" + std::to_string(relayCfg.windowMs) + "&prioHttp=" + std::to_string(relayCfg.priority[1]) +
+           "&radioIP=&radioSlice=" + std::to_string(bandCfg.slice) + "&bandHystHz=" + (n % 2 ? "600" : "500") +
+           "&pttPin=" + std::to_string(txCfg.pttPin) + (txCfg.pttActiveLow ? "&pttActiveLow=on" : "") + "&ampKeyPin=" + std::to_string(txCfg.ampKeyPin) +
+           "&udpPort=" + std::to_string(udpCfg.port) + "&udpKey=" + udpCfg.key.c_str() +
+           "&beaconGroup=" + udpCfg.beaconGroup.toString().c_str() + "&beaconPort=" + std::to_string(udpCfg.beaconPort) +
+           "&beaconHeartbeatS=" + std::to_string(udpCfg.beaconHeartbeatS) +
+           "&swrFwdPin=" + std::to_string(swrCfg.fwdPin) + "&swrReflPin=" + std::to_string(swrCfg.reflPin) +
+           "&swrTrip=" + std::to_string(swrCfg.tripSwr / 100.0) + "&swrFullW=" + std::to_string(swrCfg.fullScaleW);
+}
+
+struct Traffic
+{
+    bool     running = true;
+    uint64_t outageEndUs = 0;            // last AP or broker outage, + grace
+    uint64_t httpSent = 0, httpOk = 0, httpBusy = 0, httpErrors = 0, httpDropped = 0, httpRetries = 0;
+    uint64_t settingsSent = 0;
+    uint64_t mqttSent = 0;
+    uint64_t bytesIn = 0;
+
+    bool inOutage() const { return simNow() < outageEndUs; }
+};
+
+struct SoakClient
+{
+    std::shared_ptr<Traffic> traffic;
+    std::mt19937 rng;
+    double   meanGapUs = 0;
+    int      conn = -1;
+    uint32_t seq = 0;                    // voids a timeout once its request is answered
+    bool     inFlight = false;
+    std::string request;
+    std::string raw;
+    bool     gotHeader = false;
+    bool     chunked = false;
+    bool     serverClose = false;
+    size_t   contentLength = 0;
+    int      code = 0;
+    uint32_t posts = 0;
+};
+
+typedef std::shared_ptr<SoakClient> ClientPtr;
+
+void scheduleNext(ClientPtr c);
+void sendRequest(ClientPtr c, bool retry);
+
+std::string nextRequest(SoakClient& c)
+{
+    const int r = (int)(c.rng() % 100);
+    std::string line, body, type = "text/plain";
+    if (r < 45) {
+        const uint32_t ant = c.rng() % (outputCount() + 1);
+        line = "GET /set?ant=" + std::to_string(ant);
+    } else if (r < 75) {
+        line = "GET /state";
+    } else if (r < 80) {
+        line = "GET /stats";
+    } else if (r < 84) {
+        line = "GET /metrics";
+    } else if (r < 87) {
+        line = "GET /schedule";
+    } else if (r < 90) {
+        line = "GET /bandplan";
+    } else if (r < 93) {
+        line = "GET /log?since=" + std::to_string(c.rng() % 100000);
+    } else if (r < 95) {
+        line = "POST /schedule";
+        body = SCHEDULES[c.posts++ % 2];
+    } else if (r < 97) {
+        line = "POST /bandplan";
+        body = BAND_PLANS[c.posts++ % 2];
+    } else if (r < 98) {
+        line = "POST /settings";
+        body = settingsForm(c.posts++);
+        c.traffic->settingsSent++;
+        type = "application/x-www-form-urlencoded";
+    } else {
+        line = "GET /";
+    }
+    std::string req = line + " HTTP/1.1\r\nHost: flexpilot-switch.local\r\n"
+                      "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 Chrome/126.0 Safari/537.36\r\n"
+                      "Accept: */*\r\nConnection: keep-alive\r\n";
+    if (!body.empty()) {
+        req += "Content-Type: " + type + "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+    return req + "\r\n" + body;
+}
+
+bool chunkedComplete(const std::string& raw)
+{
+    size_t pos = 0;
+    for (;;) {
+        const size_t eol = raw.find("\r\n", pos);
+        if (eol == std::string::npos) return false;
+        const size_t size = strtoul(raw.c_str() + pos, nullptr, 16);
+        pos = eol + 2 + size + 2;
+        if (pos > raw.size()) return false;
+        if (size == 0) return true;
+    }
+}
+
+// A request that never completed: expected around an outage, a failure
+// otherwise.
+void failed(SoakClient& c)
+{
+    if (c.traffic->inOutage()) c.traffic->httpDropped++;
+    else c.traffic->httpErrors++;
+    c.inFlight = false;
+    c.raw.clear();
+    c.gotHeader = false;
+}
+
+void onData(ClientPtr c, const std::string& data)
+{
+    if (!c->inFlight) return;
+    c->traffic->bytesIn += data.size();
+    c->raw += data;
+    if (!c->gotHeader) {
+        const size_t end = c->raw.find("\r\n\r\n");
+        if (end == std::string::npos) return;
+        c->code = atoi(c->raw.c_str() + 9);
+        const size_t cl = c->raw.find("Content-Length: ");
+        c->contentLength = cl < end ? strtoul(c->raw.c_str() + cl + 16, nullptr, 10) : 0;
+        c->serverClose = c->raw.find("Connection: close") < end;
+        c->chunked = c->raw.find("Transfer-Encoding: chunked") < end;
+        c->raw.erase(0, end + 4);
+        c->gotHeader = true;
+    }
+    if (c->chunked ? !chunkedComplete(c->raw) : c->raw.size() < c->contentLength) return;
+
+    if (c->code >= 200 && c->code < 400) c->traffic->httpOk++;
+    else if (c->code == 503) c->traffic->httpBusy++;
+    else c->traffic->httpErrors++;
+    c->inFlight = false;
+    c->seq++;
+    c->raw.clear();
+    c->gotHeader = false;
+    if (c->serverClose) {
+        simTcpClose(c->conn);
+        c->conn = -1;
+    }
+    scheduleNext(c);
+}
+
+void onClose(ClientPtr c, int conn)
+{
+    if (c->conn != conn) return;
+    c->conn = -1;
+    if (!c->inFlight) return;
+    c->seq++;
+    // Closed before any response byte: an idle keep-alive connection was
+    // closed under our request, which a browser retries.
+    if (c->raw.empty() && !c->gotHeader && !c->traffic->inOutage()) {
+        c->traffic->httpRetries++;
+        sendRequest(c, true);
+        return;
+    }
+    failed(*c);
+    scheduleNext(c);
+}
+
+void sendRequest(ClientPtr c, bool retry)
+{
+    if (!c->traffic->running) return;
+    if (c->conn < 0) {
+        c->conn = simTcpConnect(80);
+        if (c->conn < 0) {
+            scheduleNext(c);
+            return;
+        }
+        const int conn = c->conn;
+        simTcpOnReceive(conn, [c](const std::string& d) { onData(c, d); });
+        simTcpOnClose(conn, [c, conn] { onClose(c, conn); });
+    }
+    if (!retry) {
+        c->request = nextRequest(*c);
+        c->traffic->httpSent++;
+    }
+    c->inFlight = true;
+    simTcpSend(c->conn, c->request);
+
+    const uint32_t seq = c->seq;
+    simAt(simNow() + REQUEST_TIMEOUT_US, [c, seq] {
+        if (c->seq != seq || !c->inFlight) return;
+        c->seq++;
+        if (c->conn >= 0) simTcpClose(c->conn);
+        c->conn = -1;
+        failed(*c);
+        scheduleNext(c);
+    });
+}
+
+uint64_t gapUs(std::mt19937& rng, double meanUs)
+{
+    std::exponential_distribution<double> gap(1.0 / meanUs);
+    return 1 + (uint64_t)gap(rng);
+}
+
+void scheduleNext(ClientPtr c)
+{
+    if (!c->traffic->running) return;
+    simAt(simNow() + gapUs(c->rng, c->meanGapUs), [c] { sendRequest(c, false); });
+}
+
+struct MqttSource
+{
+    std::shared_ptr<Traffic> traffic;
+    std::mt19937 rng;
+    double   meanGapUs = 0;
+    uint32_t id = 0;
+};
+
+std::string mqttCommand(MqttSource& m, std::string* topic)
+{
+    const int r = (int)(m.rng() % 100);
+    const uint32_t ant = m.rng() % (outputCount() + 1);
+    *topic = mqttCfg.topicCmd.c_str();
+    if (r < 40) return ant ? std::to_string(ant) : "off";
+    if (r < 55) return "next";
+    if (r < 70) return "prev";
+    if (r < 85) return "{\"ant\":\"" + std::to_string(ant) + "\",\"id\":\"soak-" + std::to_string(m.id++) + "\"}";
+    if (r < 93) return "{\"mask\":" + std::to_string(m.rng() % (1u << outputCount())) + "}";
+    *topic += "/freq";
+    static const char* const FREQS[] = {"7074000", "14.074", "21074000", "28.074"};
+    return FREQS[m.rng() % 4];
+}
+
+void mqttTick(std::shared_ptr<MqttSource> m)
+{
+    if (!m->traffic->running) return;
+    if (!m->traffic->inOutage()) {
+        std::string topic;
+        const std::string payload = mqttCommand(*m, &topic);
+        simMqttInject(topic, payload);
+        m->traffic->mqttSent++;
+    }
+    simAt(simNow() + gapUs(m->rng, m->meanGapUs), [m] { mqttTick(m); });
+}
+
+// Once a day: the AP drops for 30 s at 13:00, the broker restarts at 19:00.
+void scheduleOutages(std::shared_ptr<Traffic> t, uint64_t dayStart)
+{
+    simAt(dayStart + 13 * HOUR, [t] {
+        simWifiSetApUp(false);
+        t->outageEndUs = simNow() + 30 * SEC + OUTAGE_GRACE_US;
+    });
+    simAt(dayStart + 13 * HOUR + 30 * SEC, [] { simWifiSetApUp(true); });
+    simAt(dayStart + 19 * HOUR, [t] {
+        simMqttSetBrokerUp(false);
+        t->outageEndUs = simNow() + 20 * SEC + OUTAGE_GRACE_US;
+    });
+    simAt(dayStart + 19 * HOUR + 20 * SEC, [] { simMqttSetBrokerUp(true); });
+}
+
+struct HeapSample
+{
+    uint64_t atUs;
+    size_t   free;
+    size_t   largest;
+};
+
+HeapSample sampleHeap()
+{
+    return HeapSample{simNow(), ESP.getFreeHeap(), simHeapLargestFree()};
+}
+
+} // namespace
+
+int scenarioSoak(const SimOptions& opt)
+{
+    const uint64_t commands = opt.count ? opt.count : 2000000;
+    const double perSecond = commands / (DAYS * DAY / 1e6);
+    int failures = 0;
+
+    simNvsErase();
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    simRunFor(SEC);
+    const uint32_t restarts = simRestarts();
+
+    auto traffic = std::make_shared<Traffic>();
+    std::vector<ClientPtr> clients;
+    for (int i = 0; i < HTTP_CLIENTS; i++) {
+        auto c = std::make_shared<SoakClient>();
+        c->traffic = traffic;
+        c->rng.seed(opt.seed * 1000 + i);
+        c->meanGapUs = 1e6 * HTTP_CLIENTS / (perSecond * HTTP_SHARE);
+        clients.push_back(c);
+        scheduleNext(c);
+    }
+    auto mqtt = std::make_shared<MqttSource>();
+    mqtt->traffic = traffic;
+    mqtt->rng.seed(opt.seed * 1000 + 999);
+    mqtt->meanGapUs = 1e6 / (perSecond * (1 - HTTP_SHARE));
+    mqttTick(mqtt);
+
+    printf("soak: %d days, %llu commands (%.1f/s), %d HTTP clients\n", DAYS,
+           (unsigned long long)commands, perSecond, HTTP_CLIENTS);
+
+    // An hour of warm-up: every path has run and settled its buffers.
+    simRunFor(HOUR);
+    simDropRecords();
+    const HeapSample base = sampleHeap();
+    printf("  warm: free=%zu largest=%zu\n", base.free, base.largest);
+
+    const uint64_t start = simNow();
+    for (int d = 0; d < DAYS; d++) scheduleOutages(traffic, start + d * DAY);
+    simResetLoopStats();
+    std::vector<HeapSample> samples;
+    HeapSample low = base;
+    for (int h = 0; h < DAYS * 24; h++) {
+        simRunFor(HOUR);
+        simDropRecords();
+        const HeapSample s = sampleHeap();
+        samples.push_back(s);
+        if (s.largest < low.largest) low.largest = s.largest;
+        if (s.free < low.free) low.free = s.free;
+        if (h % 24 == 23) {
+            printf("  day %d: free=%zu largest=%zu http=%llu mqtt=%llu\n", h / 24 + 1, s.free, s.largest,
+                   (unsigned long long)traffic->httpSent, (unsigned long long)traffic->mqttSent);
+        }
+    }
+    const SimLoopStats loop = simLoopStats();
+
+    // Traffic stops; connections go idle and close.
+    traffic->running = false;
+    simRunFor(10 * SEC);
+    for (auto& c : clients) {
+        if (c->conn >= 0) simTcpClose(c->conn);
+    }
+    simRunFor(5 * SEC);
+    simDropRecords();
+    const HeapSample end = sampleHeap();
+
+    const uint64_t sent = traffic->httpSent + traffic->mqttSent;
+    printf("  http: %llu sent, %llu ok, %llu busy, %llu retried, %llu dropped in outages, %llu errors\n",
+           (unsigned long long)traffic->httpSent, (unsigned long long)traffic->httpOk,
+           (unsigned long long)traffic->httpBusy, (unsigned long long)traffic->httpRetries,
+           (unsigned long long)traffic->httpDropped, (unsigned long long)traffic->httpErrors);
+    printf("  settings: %llu saved\n", (unsigned long long)traffic->settingsSent);
+    printf("  mqtt: %llu sent, %u connects\n", (unsigned long long)traffic->mqttSent, simMqttConnects());
+    printf("  heap: warm free=%zu largest=%zu, lowest free=%zu largest=%zu, end free=%zu largest=%zu, failures=%u\n",
+           base.free, base.largest, low.free, low.largest, end.free, end.largest, simHeapFailures());
+    printf("  loop: %llu passes, max %.1f ms\n", (unsigned long long)loop.passes, loop.maxUs / 1000.0);
+
+    simCheck(sent >= commands * 9 / 10, "the commands were sent", &failures);
+    simCheck(traffic->settingsSent > 0 && simRestarts() == restarts, "settings saved throughout, no reboot", &failures);
+    simCheck(traffic->httpErrors == 0, "no HTTP request failed outside an outage", &failures);
+    simCheck(traffic->httpBusy <= traffic->httpSent / 10000, "503 (no body slot) at most 1 in 10000", &failures);
+    simCheck(simMqttConnects() >= 1 + DAYS, "MQTT came back after every outage", &failures);
+    simCheck(low.largest >= base.largest, "largest free block never below its warm-up size", &failures);
+    simCheck(end.free >= base.free, "free heap back to its warm-up level", &failures);
+    simCheck(simHeapFailures() == 0, "no allocation failed", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "soak")
+            .field("seed", opt.seed)
+            .field("days", DAYS)
+            .field("http_sent", traffic->httpSent)
+            .field("http_ok", traffic->httpOk)
+            .field("http_busy", traffic->httpBusy)
+            .field("http_retries", traffic->httpRetries)
+            .field("http_dropped", traffic->httpDropped)
+            .field("http_errors", traffic->httpErrors)
+            .field("mqtt_sent", traffic->mqttSent)
+            .field("bytes_in", traffic->bytesIn)
+            .field("loop_max_us", loop.maxUs);
+        json.beginObject("heap")
+            .field("warm_free", (uint64_t)base.free)
+            .field("warm_largest", (uint64_t)base.largest)
+            .field("low_free", (uint64_t)low.free)
+            .field("low_largest", (uint64_t)low.largest)
+            .field("end_free", (uint64_t)end.free)
+            .field("end_largest", (uint64_t)end.largest)
+            .field("failures", simHeapFailures());
+        json.beginArray("hourly");
+        for (const HeapSample& s : samples) {
+            json.beginObject()
+                .field("hour", (s.atUs - start) / HOUR)
+                .field("free", (uint64_t)s.free)
+                .field("largest", (uint64_t)s.largest)
+                .endObject();
+        }
+        json.endArray().endObject();
+        json.field("failures", failures).endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
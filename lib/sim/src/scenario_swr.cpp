@@ -0,0 +1,286 @@
+// --------------------------------------------------
+// Scenario: SWR monitor
+//
+// Detectors on GPIO34/35 through /settings, then a station made of
+// synthetic sample streams: forward from the transmit power, reflected
+// from the load of whichever antenna the relay pins connect (an open
+// line while none is), plus noise. Transmits into antennas of known SWR
+// and checks the per-antenna power and SWR in /stats, then the things
+// that must not trip: switching under TX, a bad load at QRP levels,
+// single-sample spikes, a trip SWR of 0. Then load faults at random
+// moments: every one turns the outputs off, and the time from the fault
+// to the relay edge is the trip latency. Last, the handler's host time
+// per sample over the whole run.
+// --------------------------------------------------
+
+#include <cmath>
+
+#include "antenna_switch.h"
+#include "hal.h"
+#include "relay_task.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+#include "swr_monitor.h"
+
+namespace {
+
+const int      FWD_PIN   = 34;
+const int      REFL_PIN  = 35;
+const int      FULL_W    = 100;
+const double   LOAD_SWR[4] = {1.2, 1.8, 2.5, 1.0};
+const uint64_t FRAME_US  = HAL_ADC_FRAME * 1000000ULL / SWR_SAMPLE_HZ;
+const uint64_t POINT_US  = 2 * SWR_DECIMATE * 1000000ULL / SWR_SAMPLE_HZ;
+
+const SimHttpRequest* request(HTTPMethod method, const std::string& uri, const std::string& body = "")
+{
+    const uint32_t id = simHttpRequest(method, uri, body);
+    simRunUntil([id] { return simHttpResult(id)->respondedUs != 0 || simHttpResult(id)->code < 0; }, 5000000);
+    return simHttpResult(id);
+}
+
+uint32_t lcg(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// The station
+struct Station
+{
+    double   txW = 0;
+    double   loadSwr[4] = {LOAD_SWR[0], LOAD_SWR[1], LOAD_SWR[2], LOAD_SWR[3]};
+    int      faultAntenna = 0;           // its load goes to faultSwr at faultAtUs
+    double   faultSwr = 0;
+    uint64_t faultAtUs = UINT64_MAX;
+    uint64_t spikeEveryUs = 0;           // one reflected sample at full scale
+    int      noise = 12;                 // +- counts
+    uint32_t rng = 1;
+};
+
+Station station;
+
+double reflection(double swr)
+{
+    return (swr - 1) / (swr + 1);
+}
+
+uint16_t reading(int pin, uint64_t atUs)
+{
+    int connected = 0, count = 0;
+    for (int i = 0; i < 4; i++) {
+        if (simGpioLevel(16 + i) == HIGH) {      // OUTPUT_MAP_DEFAULT: gpio 16 17 18 19
+            connected = i + 1;
+            count++;
+        }
+    }
+    double g = 1;                                // nothing connected: open line
+    if (count == 1) {
+        const bool faulted = connected == station.faultAntenna && atUs >= station.faultAtUs;
+        g = reflection(faulted ? station.faultSwr : station.loadSwr[connected - 1]);
+    }
+    const double fwd = 4095.0 * std::sqrt(station.txW / FULL_W);
+    double v = pin == FWD_PIN ? fwd : fwd * g;
+    if (pin == REFL_PIN && station.spikeEveryUs && atUs % station.spikeEveryUs < 100) v = 4095;
+    v += (int)(lcg(&station.rng) % (2 * station.noise + 1)) - station.noise;
+    return (uint16_t)(v < 0 ? 0 : v > 4095 ? 4095 : v);
+}
+
+// First edge of pin to level at or after fromUs, 0 = none
+uint64_t edgeAfter(int pin, int level, uint64_t fromUs)
+{
+    for (const SimGpioEdge& e : simGpioEdges()) {
+        if (e.pin == pin && e.level == level && e.atUs >= fromUs) return e.atUs;
+    }
+    return 0;
+}
+
+bool near(double v, double want, double tolerance)
+{
+    return std::fabs(v - want) <= tolerance;
+}
+
+} // namespace
+
+int scenarioSwr(const SimOptions& opt)
+{
+    int failures = 0;
+    const uint32_t trials = opt.count ? opt.count : 200;
+    station = Station();
+    station.rng = opt.seed;
+    simAdcSetSource(reading);
+
+    simNvsErase();
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    simCheck(!swrMonitorStats().enabled && simAdcStats().frames == 0, "no monitor by default, the ADC stays off",
+             &failures);
+
+    // ---- Configure: reboots onto the detector pins ----
+    const uint32_t restarts = simRestarts();
+    simHttpRequest(HTTP_POST, "/settings",
+                   "mqttEnabled=on&swrFwdPin=" + std::to_string(FWD_PIN) + "&swrReflPin=" + std::to_string(REFL_PIN) +
+                       "&swrTrip=3.0&swrFullW=" + std::to_string(FULL_W));
+    simRunUntil([restarts] { return simRestarts() > restarts; }, 10000000);
+    simRunFor(2000000);
+    simCheck(simRestarts() == restarts + 1 && swrMonitorStats().enabled && swrCfg.tripSwr == 300 &&
+                 swrCfg.fullScaleW == FULL_W,
+             "pins set in /settings: rebooted, sampling", &failures);
+    simCheck(request(HTTP_GET, "/settings")->response.find("name='swrTrip' min='0' max='99' step='0.1' value='3.00'") !=
+                 std::string::npos,
+             "/settings shows the trip SWR", &failures);
+    const SimAdcStats idle = simAdcStats();
+    const SwrStats idleStats = swrMonitorStats();
+    simCheck(idle.frames > 0 && idleStats.trips == 0 && !idleStats.transmitting, "receive only: no trip", &failures);
+
+    // ---- Known loads ----
+    simAdcResetStats();
+    request(HTTP_GET, "/set?ant=1");
+    simRunFor(200000);
+    station.txW = 50;
+    simRunFor(2000000);
+    station.txW = 0;
+    simRunFor(100000);
+    SwrStats s = swrMonitorStats();
+    const SwrAntennaStats a1 = s.antennas[0];
+    printf("antenna 1: %.2f:1 (load %.2f), %.1f W fwd, %.2f W refl, %u ms TX\n", a1.swr / 100.0, LOAD_SWR[0],
+           a1.fwdMw / 1000.0, a1.reflMw / 1000.0, a1.txMs);
+    simCheck(near(a1.swr / 100.0, LOAD_SWR[0], 0.05) && near(a1.fwdMw / 1000.0, 50, 2.5) && near(a1.txMs, 2000, 20) &&
+                 a1.trips == 0,
+             "antenna 1: SWR, power and TX time as transmitted", &failures);
+    const double reflW = 50 * reflection(LOAD_SWR[0]) * reflection(LOAD_SWR[0]);
+    simCheck(near(a1.reflMw / 1000.0, reflW, 0.1), "... reflected power", &failures);
+
+    // Switch to antenna 2 while transmitting: the dead time reads as an open line
+    station.txW = 50;
+    simRunFor(500000);
+    const uint32_t skippedBefore = swrMonitorStats().skipped;
+    request(HTTP_GET, "/set?ant=2");
+    simRunFor(2000000);
+    station.txW = 0;
+    simRunFor(100000);
+    s = swrMonitorStats();
+    printf("antenna 2: %.2f:1 (load %.2f), peak %.2f, %u points skipped over the switch\n", s.antennas[1].swr / 100.0,
+           LOAD_SWR[1], s.antennas[1].peakSwr / 100.0, s.skipped - skippedBefore);
+    simCheck(s.trips == 0 && s.skipped > skippedBefore, "switching under TX: the open line is skipped, no trip",
+             &failures);
+    simCheck(near(s.antennas[1].swr / 100.0, LOAD_SWR[1], 0.05) && s.antennas[1].peakSwr < 200,
+             "antenna 2: its own SWR, peak unaffected by the switch", &failures);
+    simCheck(s.antennas[0].txMs > a1.txMs && s.antennas[0].swr == a1.swr, "antenna 1 keeps its reading", &failures);
+
+    // A bad load at QRP level: below the forward floor, nothing to judge
+    station.loadSwr[3] = 20;
+    request(HTTP_GET, "/set?ant=4");
+    simRunFor(200000);
+    station.txW = 0.1;
+    simRunFor(1000000);
+    s = swrMonitorStats();
+    simCheck(s.trips == 0 && !s.transmitting && s.antennas[3].txMs == 0, "100 mW into SWR 20: below the floor, no trip",
+             &failures);
+    station.txW = 0;
+    station.loadSwr[3] = LOAD_SWR[3];
+
+    // Spikes: one reflected sample at full scale every 10 ms
+    request(HTTP_GET, "/set?ant=1");
+    simRunFor(200000);
+    station.spikeEveryUs = 10000;
+    station.txW = 50;
+    simRunFor(2000000);
+    station.txW = 0;
+    station.spikeEveryUs = 0;
+    simCheck(swrMonitorStats().trips == 0, "single-sample spikes every 10 ms: no trip", &failures);
+
+    // Trip SWR 0: the monitor only measures
+    request(HTTP_POST, "/settings", "mqttEnabled=on&swrTrip=0");
+    station.faultAntenna = 1;
+    station.faultSwr = 10;
+    station.faultAtUs = simNow() + 100000;
+    station.txW = 50;
+    simRunFor(500000);
+    station.txW = 0;
+    simCheck(swrMonitorStats().trips == 0 && relaySnapshot().antenna == 1, "trip SWR 0: SWR 10 measured, not tripped",
+             &failures);
+    request(HTTP_POST, "/settings", "mqttEnabled=on&swrTrip=3");
+    station.faultAtUs = UINT64_MAX;
+
+    // ---- Trip latency: faults at random moments ----
+    std::vector<double> latencies, detect;
+    uint32_t tripped = 0;
+    const uint32_t swrCommands = relayTaskStats().latency[RELAY_SRC_SWR].count;
+    for (uint32_t i = 0; i < trials; i++) {
+        setAntenna(2, RELAY_SRC_LOCAL);
+        simRunFor(100000);
+        station.txW = 20 + lcg(&station.rng) % 80;
+        station.faultAntenna = 2;
+        station.faultSwr = 4 + lcg(&station.rng) % 60 / 10.0;
+        station.faultAtUs = simNow() + 20000 + lcg(&station.rng) % 50000;
+        const uint64_t faultUs = station.faultAtUs;
+        simRunUntil([faultUs] { return edgeAfter(17, LOW, faultUs) != 0; }, 200000);
+        const uint64_t edgeUs = edgeAfter(17, LOW, faultUs);
+        station.txW = 0;
+        station.faultAtUs = UINT64_MAX;
+        if (!edgeUs) continue;
+        tripped++;
+        latencies.push_back((edgeUs - faultUs) / 1000.0);
+    }
+    s = swrMonitorStats();
+    const RelayLatency swrLatency = relayTaskStats().latency[RELAY_SRC_SWR];
+    const SimSummary trip = simSummarize(latencies);
+    simPrintSummary("fault -> relay off", "ms", trip);
+    const double bound = (FRAME_US + SWR_TRIP_POINTS * POINT_US) / 1000.0 + 0.5;
+    simCheck(tripped == trials && s.trips == trials && s.antennas[1].trips == trials && s.tripsRefused == 0,
+             "every fault tripped, once", &failures);
+    simCheck(trip.max <= bound, "within a frame plus the trip points of the fault", &failures);
+    simCheck(swrLatency.count - swrCommands == trials && s.lastTripAntenna == 2 && s.lastTripSwr >= 300,
+             "posted as RELAY_SRC_SWR, trip SWR recorded", &failures);
+    const std::string stats = request(HTTP_GET, "/stats")->response;
+    simCheck(stats.find("\"swr\":{\"enabled\":true") != std::string::npos &&
+                 stats.find("\"trips\":" + std::to_string(trials)) != std::string::npos,
+             "/stats reports the trips", &failures);
+
+    // ---- Cost per sample (host) ----
+    const SimAdcStats adc = simAdcStats();
+    const double nsPerSample = adc.samples ? (double)adc.handlerNs / adc.samples : 0;
+    printf("handler: %llu frames, %llu samples, %.1f ns/sample, %.2f us/frame on the host; max %u us/frame virtual\n",
+           (unsigned long long)adc.frames, (unsigned long long)adc.samples, nsPerSample,
+           adc.frames ? adc.handlerNs / 1000.0 / adc.frames : 0, s.maxFrameUs);
+    simCheck(adc.frames > 0 && nsPerSample < 500, "handler under 500 ns a sample on the host", &failures);
+
+    simAdcSetSource(nullptr);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "swr")
+            .field("sample_hz", SWR_SAMPLE_HZ)
+            .field("frame_us", FRAME_US)
+            .field("point_us", POINT_US)
+            .field("trials", trials)
+            .field("tripped", tripped);
+        simWriteSummary(json, "trip_ms", trip);
+        json.beginObject("handler")
+            .field("frames", adc.frames)
+            .field("samples", adc.samples)
+            .field("ns_per_sample", nsPerSample)
+            .endObject()
+            .beginArray("antennas");
+        for (int i = 0; i < 4; i++) {
+            json.beginObject()
+                .field("load_swr", LOAD_SWR[i])
+                .field("swr", s.antennas[i].swr / 100.0)
+                .field("peak_swr", s.antennas[i].peakSwr / 100.0)
+                .field("tx_ms", s.antennas[i].txMs)
+                .field("trips", s.antennas[i].trips)
+                .endObject();
+        }
+        json.endArray().field("failures", failures).endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,351 @@
+// --------------------------------------------------
+// Scenario: UDP control
+//
+// The same antenna changes over UDP, HTTP /set (a connection per
+// request, as a logger would) and MQTT (broker on the logging PC), one
+// at a time, timing each from the moment the client sends it to the
+// answer it gets back (UDP ack, HTTP response, state publish) and to the
+// first relay edge. Then the protocol rules: a retry with the same seq
+// is answered from the cache and not applied again, a late older seq is
+// refused as stale, malformed datagrams get no answer, and with a key
+// set only correctly signed requests are served, every ack is signed,
+// and a select has to be signed with the session the switch handed out,
+// so a captured one is not applied again from another port, after its
+// entry was evicted, or after a restart. Last, UDP commands keep their
+// latency while loop() sits in a 3 s MQTT connect.
+// --------------------------------------------------
+
+#include <algorithm>
+
+#include "antenna_switch.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+#include "udp_control.h"
+
+namespace {
+
+const int PINS[] = {16, 17, 18, 19};     // OUTPUT_MAP_DEFAULT
+const uint64_t SPACING_US = 300000;
+
+void put32(std::string& s, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) s += (char)(v >> (8 * i));
+}
+
+uint32_t get32(const std::string& s, size_t at)
+{
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; i--) v = v << 8 | (uint8_t)s[at + i];
+    return v;
+}
+
+std::string request(uint8_t op, uint32_t seq, uint32_t outputs, const char* key = "", uint32_t session = 0)
+{
+    std::string d = "AS";
+    d += (char)UDP_VERSION;
+    d += (char)op;
+    put32(d, seq);
+    put32(d, outputs);
+    if (key[0]) {
+        std::string signedPart = d;
+        put32(signedPart, session);
+        uint8_t mac[UDP_MAC_SIZE];
+        udpControlMac(key, (const uint8_t*)signedPart.data(), signedPart.size(), mac);
+        d.append((const char*)mac, UDP_MAC_SIZE);
+    }
+    return d;
+}
+
+bool macOk(const std::string& ack, const char* key)
+{
+    if (ack.size() != UDP_ACK_SIZE + UDP_MAC_SIZE) return false;
+    uint8_t mac[UDP_MAC_SIZE];
+    udpControlMac(key, (const uint8_t*)ack.data(), UDP_ACK_SIZE, mac);
+    return !memcmp(mac, ack.data() + UDP_ACK_SIZE, UDP_MAC_SIZE);
+}
+
+// Ack for seq received at or after fromUs, or nullptr.
+const SimUdpDatagram* ackFor(uint32_t seq, uint64_t fromUs)
+{
+    for (const SimUdpDatagram& d : simUdpReceived()) {
+        if (d.atUs >= fromUs && d.data.size() >= UDP_ACK_SIZE && get32(d.data, 4) == seq) return &d;
+    }
+    return nullptr;
+}
+
+uint64_t firstEdgeAfter(uint64_t us)
+{
+    for (const SimGpioEdge& e : simGpioEdges()) {
+        if (e.atUs >= us && std::find(std::begin(PINS), std::end(PINS), e.pin) != std::end(PINS)) return e.atUs;
+    }
+    return 0;
+}
+
+uint64_t statePublishAfter(uint64_t us, const std::string& payload)
+{
+    for (const SimMqttMessage& m : simMqttPublished()) {
+        if (m.atUs >= us && m.topic == mqttCfg.topicState.c_str() && m.payload == payload) return m.atUs;
+    }
+    return 0;
+}
+
+struct Sample
+{
+    uint64_t sentUs;
+    uint64_t answerUs;
+    uint64_t edgeUs;
+};
+
+void collect(const std::vector<Sample>& samples, std::vector<double>* answer, std::vector<double>* edge,
+             uint32_t* missing)
+{
+    for (const Sample& s : samples) {
+        if (!s.answerUs || !s.edgeUs) {
+            (*missing)++;
+            continue;
+        }
+        answer->push_back((s.answerUs - s.sentUs) / 1000.0);
+        edge->push_back((s.edgeUs - s.sentUs) / 1000.0);
+    }
+}
+
+} // namespace
+
+int scenarioUdp(const SimOptions& opt)
+{
+    int failures = 0;
+    const int count = opt.count ? (int)opt.count : 100;
+    uint32_t seq = 1000;
+
+    simNvsErase();
+    simMqttSetBrokerUp(true);
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    simRunFor(500000);
+
+    // ---- Benchmark: UDP, HTTP /set, MQTT ----
+    std::vector<Sample> udp, http, mqtt;
+    int ant = currentAntenna;
+    for (int round = 0; round < count; round++) {
+        for (int transport = 0; transport < 3; transport++) {
+            ant = ant % 4 + 1;
+            const uint64_t t0 = simNow();
+            Sample s = {t0, 0, 0};
+            if (transport == 0) {
+                const uint32_t n = ++seq;
+                simUdpSend(UDP_CONTROL_PORT, request(UDP_OP_SELECT, n, outputBit(ant)));
+                simRunFor(SPACING_US);
+                const SimUdpDatagram* a = ackFor(n, t0);
+                if (a && a->data[8] == UDP_OK && get32(a->data, 12) == outputBit(ant)) s.answerUs = a->atUs;
+            } else if (transport == 1) {
+                const uint32_t id = simHttpRequest(HTTP_GET, "/set?ant=" + std::to_string(ant));
+                simRunFor(SPACING_US);
+                if (simHttpResult(id)->code == 200) s.answerUs = simHttpResult(id)->respondedUs;
+            } else {
+                // One hop from the broker to the switch, one back for the state
+                const std::string payload = std::to_string(ant);
+                simAt(t0 + simCosts.tcpLatencyUs,
+                      [payload] { simMqttInject(mqttCfg.topicCmd.c_str(), payload); });
+                simRunFor(SPACING_US);
+                const uint64_t pub = statePublishAfter(t0, payload);
+                if (pub) s.answerUs = pub + simCosts.tcpLatencyUs;
+            }
+            s.edgeUs = firstEdgeAfter(t0);
+            (transport == 0 ? udp : transport == 1 ? http : mqtt).push_back(s);
+        }
+    }
+
+    std::vector<double> udpAck, udpEdge, httpAck, httpEdge, mqttAck, mqttEdge;
+    uint32_t missing = 0;
+    collect(udp, &udpAck, &udpEdge, &missing);
+    collect(http, &httpAck, &httpEdge, &missing);
+    collect(mqtt, &mqttAck, &mqttEdge, &missing);
+    const SimSummary ua = simSummarize(udpAck), ue = simSummarize(udpEdge);
+    const SimSummary ha = simSummarize(httpAck), he = simSummarize(httpEdge);
+    const SimSummary ma = simSummarize(mqttAck), me = simSummarize(mqttEdge);
+    printf("udp: %d commands per transport, sent -> answer / first relay edge\n", count);
+    simPrintSummary("udp ack", "ms", ua);
+    simPrintSummary("udp edge", "ms", ue);
+    simPrintSummary("http reply", "ms", ha);
+    simPrintSummary("http edge", "ms", he);
+    simPrintSummary("mqtt state", "ms", ma);
+    simPrintSummary("mqtt edge", "ms", me);
+    printf("  (the simulated TCP sends the request with its SYN; a real new connection adds %.1f ms to http)\n",
+           2 * simCosts.tcpLatencyUs / 1000.0);
+    simCheck(missing == 0, "every command answered and switched", &failures);
+    simCheck(ua.p99 < 10.0 && ue.p99 < 10.0, "UDP: ack and relay edge p99 under 10 ms", &failures);
+    simCheck(ua.p99 < ha.p50 && ua.p99 < ma.p50, "UDP ack p99 beats the HTTP and MQTT medians", &failures);
+
+    // ---- Retry, late duplicate, malformed ----
+    const UdpControlStats u0 = udpControlStats();
+    const uint32_t posted0 = relayTaskStats().latency[RELAY_SRC_UDP].count;
+    const uint32_t retry = ++seq;
+    ant = ant % 4 + 1;
+    const uint64_t tRetry = simNow();
+    simUdpSend(UDP_CONTROL_PORT, request(UDP_OP_SELECT, retry, outputBit(ant)));
+    simRunFor(20000);
+    simUdpSend(UDP_CONTROL_PORT, request(UDP_OP_SELECT, retry, outputBit(ant)));
+    simRunFor(20000);
+    size_t acks = 0;
+    std::string first, second;
+    for (const SimUdpDatagram& d : simUdpReceived()) {
+        if (d.atUs < tRetry || get32(d.data, 4) != retry) continue;
+        (acks++ ? second : first) = d.data;
+    }
+    simCheck(acks == 2 && first == second && relayTaskStats().latency[RELAY_SRC_UDP].count == posted0 + 1 &&
+                 udpControlStats().duplicates == u0.duplicates + 1,
+             "retry with the same seq: same ack, applied once", &failures);
+
+    const uint64_t tStale = simNow();
+    simUdpSend(UDP_CONTROL_PORT, request(UDP_OP_SELECT, retry - 5, outputBit(ant % 4 + 1)));
+    simRunFor(20000);
+    const SimUdpDatagram* stale = ackFor(retry - 5, tStale);
+    simCheck(stale && stale->data[8] == UDP_STALE && get32(stale->data, 12) == outputBit(ant) &&
+                 currentAntenna == ant && relayTaskStats().latency[RELAY_SRC_UDP].count == posted0 + 1,
+             "late older seq: refused as stale with the current state", &failures);
+
+    const size_t before = simUdpReceived().size();
+    simUdpSend(UDP_CONTROL_PORT, "AS");
+    simUdpSend(UDP_CONTROL_PORT, request(7, ++seq, 0));
+    simUdpSend(UDP_CONTROL_PORT, request(UDP_OP_SELECT, ++seq, 1u << 20));
+    simRunFor(20000);
+    const SimUdpDatagram& last = simUdpReceived().back();
+    simCheck(simUdpReceived().size() == before + 2 && last.data[8] == UDP_BAD_REQUEST &&
+                 udpControlStats().invalid == u0.invalid + 3,
+             "short datagram dropped, unknown op and unmapped output refused", &failures);
+
+    const uint64_t tQuery = simNow();
+    simUdpSend(UDP_CONTROL_PORT, request(UDP_OP_STATE, ++seq, 0));
+    simRunFor(20000);
+    const SimUdpDatagram* q = ackFor(seq, tQuery);
+    simCheck(q && q->data[8] == UDP_OK && (int8_t)q->data[9] == currentAntenna && (uint8_t)q->data[10] == 4,
+             "state query answers the applied selection", &failures);
+
+    // ---- Shared key ----
+    const char* key = "contest-station-key";
+    const uint32_t id = simHttpRequest(HTTP_POST, "/settings", std::string("mqttEnabled=on&udpKey=") + key);
+    simRunUntil([id] { return simHttpResult(id)->code != 0; }, 5000000);
+    const UdpControlStats k0 = udpControlStats();
+    const size_t beforeKey = simUdpReceived().size();
+    ant = ant % 4 + 1;
+    simUdpSend(UDP_CONTROL_PORT, request(UDP_OP_SELECT, ++seq, outputBit(ant)));
+    simUdpSend(UDP_CONTROL_PORT, request(UDP_OP_SELECT, ++seq, outputBit(ant), "wrong-key"));
+    simRunFor(50000);
+    simCheck(simUdpReceived().size() == beforeKey && udpControlStats().badMac == k0.badMac + 1 &&
+                 udpControlStats().invalid == k0.invalid + 1 && currentAntenna != ant,
+             "key set: unsigned and wrongly signed requests get no answer", &failures);
+    const uint64_t tHello = simNow();
+    simUdpSend(UDP_CONTROL_PORT, request(UDP_OP_SELECT, ++seq, outputBit(ant), key));
+    simRunFor(50000);
+    const SimUdpDatagram* hello = ackFor(seq, tHello);
+    const uint32_t session = hello ? get32(hello->data, 16) : 0;
+    simCheck(hello && macOk(hello->data, key) && hello->data[8] == UDP_SESSION && session && currentAntenna != ant,
+             "select signed without a session: not applied, answered with one", &failures);
+    const uint64_t tSigned = simNow();
+    const std::string captured = request(UDP_OP_SELECT, ++seq, outputBit(ant), key, session);
+    simUdpSend(UDP_CONTROL_PORT, captured);
+    simRunFor(50000);
+    const SimUdpDatagram* signedAck = ackFor(seq, tSigned);
+    simCheck(signedAck && macOk(signedAck->data, key) && signedAck->data[8] == UDP_OK &&
+                 get32(signedAck->data, 16) == session && currentAntenna == ant,
+             "select signed with the session applied, ack signed", &failures);
+
+    // ---- Replays of the captured select ----
+    const uint32_t capturedSeq = seq;
+    auto replayed = [capturedSeq](uint64_t fromUs) { return ackFor(capturedSeq, fromUs) != nullptr; };
+    ant = ant % 4 + 1;
+    simUdpSend(UDP_CONTROL_PORT, request(UDP_OP_SELECT, ++seq, outputBit(ant), key, session));
+    simRunFor(50000);
+    const UdpControlStats r0 = udpControlStats();
+    uint64_t tReplay = simNow();
+    simUdpSend(UDP_CONTROL_PORT, captured, SIM_UDP_HOST_PORT + 1);
+    simRunFor(50000);
+    simCheck(!replayed(tReplay) && currentAntenna == ant && udpControlStats().badMac == r0.badMac + 1,
+             "replay from another port: no answer, not applied", &failures);
+    for (int i = 0; i < UDP_CLIENTS; i++) {
+        simUdpSend(UDP_CONTROL_PORT, request(UDP_OP_STATE, 1, 0, key), SIM_UDP_HOST_PORT + 10 + i);
+        simRunFor(5000);
+    }
+    tReplay = simNow();
+    simUdpSend(UDP_CONTROL_PORT, captured);
+    simRunFor(50000);
+    simCheck(!replayed(tReplay) && currentAntenna == ant, "replay after its entry was evicted: no answer, not applied",
+             &failures);
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    simRunFor(500000);
+    ant = currentAntenna;
+    tReplay = simNow();
+    simUdpSend(UDP_CONTROL_PORT, captured);
+    simRunFor(50000);
+    simCheck(!replayed(tReplay) && currentAntenna == ant, "replay after a restart: no answer, not applied", &failures);
+    const uint64_t tAgain = simNow();
+    simUdpSend(UDP_CONTROL_PORT, request(UDP_OP_STATE, ++seq, 0, key));
+    simRunFor(50000);
+    const SimUdpDatagram* again = ackFor(seq, tAgain);
+    const uint32_t newSession = again ? get32(again->data, 16) : 0;
+    ant = ant % 4 + 1;
+    const uint64_t tResumed = simNow();
+    simUdpSend(UDP_CONTROL_PORT, request(UDP_OP_SELECT, ++seq, outputBit(ant), key, newSession));
+    simRunFor(50000);
+    const SimUdpDatagram* resumed = ackFor(seq, tResumed);
+    simCheck(again && again->data[8] == UDP_OK && newSession && newSession != session && resumed &&
+                 resumed->data[8] == UDP_OK && currentAntenna == ant,
+             "after a restart a client starts over with a state query", &failures);
+
+    // ---- loop() blocked in a 3 s MQTT connect ----
+    const uint32_t savedConnectUs = simCosts.mqttConnectUs;
+    simCosts.mqttConnectUs = 3000000;
+    simMqttSetBrokerUp(false);
+    simRunFor(100000);
+    simMqttSetBrokerUp(true);
+    const uint32_t connects = simMqttConnects();
+    simRunUntil([connects] { return simLoopStats().passes && simMqttConnects() > connects; }, 100);
+    simResetLoopStats();
+    std::vector<Sample> blocked;
+    const uint64_t blockStart = simNow();
+    while (simNow() < blockStart + 6000000) {
+        ant = ant % 4 + 1;
+        const uint32_t n = ++seq;
+        const uint64_t t0 = simNow();
+        simUdpSend(UDP_CONTROL_PORT, request(UDP_OP_SELECT, n, outputBit(ant), key, newSession));
+        simRunFor(SPACING_US);
+        const SimUdpDatagram* a = ackFor(n, t0);
+        blocked.push_back(Sample{t0, a ? a->atUs : 0, firstEdgeAfter(t0)});
+    }
+    simCosts.mqttConnectUs = savedConnectUs;
+    std::vector<double> blockedAck, blockedEdge;
+    uint32_t blockedMissing = 0;
+    collect(blocked, &blockedAck, &blockedEdge, &blockedMissing);
+    const SimSummary ba = simSummarize(blockedAck);
+    printf("  loop() blocked up to %.0f ms:\n", simLoopStats().maxUs / 1000.0);
+    simPrintSummary("udp ack", "ms", ba);
+    simCheck(simLoopStats().maxUs >= 3000000 && blockedMissing == 0 && ba.max < 10.0,
+             "UDP acks and switches in under 10 ms while loop() is blocked", &failures);
+
+    const UdpControlStats s = udpControlStats();
+    printf("udp: %u received, %u selects, %u duplicates, %u stale, %u invalid, %u bad MAC, %u sessions, ack max %u us\n",
+           s.received, s.selects, s.duplicates, s.stale, s.invalid, s.badMac, s.sessions, s.maxAckUs);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject().field("scenario", "udp").field("commands", count);
+        simWriteSummary(json, "udp_ack_ms", ua);
+        simWriteSummary(json, "udp_edge_ms", ue);
+        simWriteSummary(json, "http_reply_ms", ha);
+        simWriteSummary(json, "http_edge_ms", he);
+        simWriteSummary(json, "mqtt_state_ms", ma);
+        simWriteSummary(json, "mqtt_edge_ms", me);
+        simWriteSummary(json, "udp_ack_blocked_loop_ms", ba);
+        json.field("failures", failures).endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+// --------------------------------------------------
+// Scenario: web UI bytes and heap
+//
+// Loads each page like a browser and reports bytes on the wire and the
+// firmware's peak heap while serving it. The static pages must arrive
+// gzip-compressed with a strong ETag and be answered with a bodyless 304
+// on reload. /settings must stream in chunks with its values escaped,
+// keep its heap small, and come out the same through a tiny send buffer
+// where every chunk goes out over several passes.
+// --------------------------------------------------
+
+#include "antenna_switch.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+#include "web_assets.h"
+
+namespace {
+
+struct PageLoad
+{
+    int         code;
+    size_t      wire;            // status line, headers and body as sent
+    size_t      peakHeap;        // firmware bytes above what was live before
+    double      ms;
+    uint32_t    chunks;
+    std::string body;
+    std::string encoding;
+    std::string etag;
+};
+
+std::string header(const SimHttpRequest* r, const char* name)
+{
+    for (const auto& h : r->headers) {
+        if (h.first == name) return h.second;
+    }
+    return "";
+}
+
+PageLoad load(const std::string& uri, const std::string& headers = "")
+{
+    simRunFor(50000);
+    const size_t live = simHeapLive();
+    simHeapResetPeak();
+
+    const uint32_t id = simHttpRequest(HTTP_GET, uri, "", headers);
+    simRunUntil([id] { return simHttpResult(id)->respondedUs != 0 || simHttpResult(id)->code < 0; }, 10000000);
+    const SimHttpRequest* r = simHttpResult(id);
+
+    PageLoad p = {};
+    p.code = r->code;
+    for (const SimTcpSegment& s : simTcpReceived(r->conn)) p.wire += s.data.size();
+    p.peakHeap = simHeapPeak() - live;
+    p.ms = r->respondedUs ? (r->respondedUs - r->queuedUs) / 1000.0 : -1;
+    p.chunks = r->chunks;
+    p.body = r->response;
+    p.encoding = header(r, "Content-Encoding");
+    p.etag = header(r, "ETag");
+    return p;
+}
+
+void print(const char* what, const PageLoad& p)
+{
+    printf("  %-22s %3d  %6zu bytes on wire  %6zu bytes peak heap  %5.1f ms%s%s\n", what, p.code, p.wire,
+           p.peakHeap, p.ms, p.encoding.empty() ? "" : "  ", p.encoding.c_str());
+}
+
+// gzip member: magic, deflate, ISIZE trailer (uncompressed length).
+bool gzipOf(const std::string& body, size_t rawLen)
+{
+    if (body.size() < 18 || (uint8_t)body[0] != 0x1f || (uint8_t)body[1] != 0x8b || body[2] != 8) return false;
+    const uint8_t* t = (const uint8_t*)body.data() + body.size() - 4;
+    return (t[0] | t[1] << 8 | t[2] << 16 | (uint32_t)t[3] << 24) == (uint32_t)rawLen;
+}
+
+void writeLoad(SimJson& json, const char* key, const PageLoad& p)
+{
+    json.beginObject(key)
+        .field("code", p.code)
+        .field("wire_bytes", (uint64_t)p.wire)
+        .field("peak_heap_bytes", (uint64_t)p.peakHeap)
+        .field("ms", p.ms)
+        .endObject();
+}
+
+} // namespace
+
+int scenarioWebUi(const SimOptions& opt)
+{
+    int failures = 0;
+
+    simNvsErase();
+    simBoot();
+    simRunUntil([] { return simMqttConnects() > 0; }, 30000000);
+    simRunFor(500000);
+
+    printf("webui: index.html %u bytes, %u gzipped; update.html %u, %u gzipped\n", WEB_INDEX_RAW_LEN,
+           WEB_INDEX_GZ_LEN, WEB_UPDATE_RAW_LEN, WEB_UPDATE_GZ_LEN);
+
+    // ---- Static pages ----
+    const std::string browser = "Accept-Encoding: gzip, deflate, br\r\n";
+    const PageLoad index = load("/", browser);
+    const PageLoad reload = load("/", browser + "If-None-Match: " + index.etag + "\r\n");
+    const PageLoad stale = load("/", browser + "If-None-Match: \"0000000000000000\"\r\n");
+    const PageLoad update = load("/update", browser);
+    const PageLoad updateReload = load("/update", browser + "If-None-Match: " + update.etag + "\r\n");
+    print("/", index);
+    print("/ (reload)", reload);
+    print("/update", update);
+    print("/update (reload)", updateReload);
+
+    simCheck(index.code == 200 && index.encoding == "gzip" && gzipOf(index.body, WEB_INDEX_RAW_LEN),
+             "/ is the gzipped page", &failures);
+    simCheck(index.etag == WEB_INDEX_ETAG && index.etag.size() > 2 && index.etag[0] == '"',
+             "/ carries its strong ETag", &failures);
+    simCheck(reload.code == 304 && reload.body.empty() && reload.wire < 256 && reload.etag == index.etag,
+             "reload with the ETag is a bodyless 304", &failures);
+    simCheck(stale.code == 200 && stale.body == index.body, "stale ETag gets the page", &failures);
+    simCheck(update.code == 200 && gzipOf(update.body, WEB_UPDATE_RAW_LEN) && updateReload.code == 304,
+             "/update gzipped and revalidated", &failures);
+    simCheck(index.peakHeap < 1024 && reload.peakHeap < 1024, "static pages served from flash", &failures);
+
+    // ---- Settings template ----
+    const String savedTopic = mqttCfg.topicState;
+    mqttCfg.topicState = "shack/'a<b>&\"c\"";
+    const PageLoad settings = load("/settings");
+    print("/settings", settings);
+    printf("  /settings: %zu bytes of HTML in %u chunks\n", settings.body.size(), settings.chunks);
+
+    const bool complete = settings.body.rfind("</html>") != std::string::npos &&
+                          settings.body.find(mqttCfg.broker.c_str()) != std::string::npos &&
+                          settings.body.find(mqttCfg.topicCmd.c_str()) != std::string::npos &&
+                          settings.body.find("value='10'") != std::string::npos;
+    simCheck(settings.code == 200 && settings.chunks > 1 && complete, "/settings streams the whole form in chunks",
+             &failures);
+    simCheck(settings.body.find("shack/&#39;a&lt;b&gt;&amp;&quot;c&quot;") != std::string::npos,
+             "values are HTML-escaped", &failures);
+    simCheck(settings.peakHeap < 1024, "/settings peak heap under 1 KiB", &failures);
+
+    // A send buffer smaller than a chunk: the same page, out over many passes.
+    const uint32_t savedSendBuffer = simCosts.tcpSendBuffer;
+    simCosts.tcpSendBuffer = 200;
+    const PageLoad slow = load("/settings");
+    simCosts.tcpSendBuffer = savedSendBuffer;
+    mqttCfg.topicState = savedTopic;
+    print("/settings (200 B buffer)", slow);
+    simCheck(slow.code == 200 && slow.body == settings.body, "partial sends resume mid-chunk", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "webui")
+            .field("index_raw_bytes", (uint64_t)WEB_INDEX_RAW_LEN)
+            .field("index_gzip_bytes", (uint64_t)WEB_INDEX_GZ_LEN);
+        writeLoad(json, "index", index);
+        writeLoad(json, "index_reload", reload);
+        writeLoad(json, "update", update);
+        writeLoad(json, "settings", settings);
+        json.field("settings_chunks", settings.chunks)
+            .field("failures", failures)
+            .endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
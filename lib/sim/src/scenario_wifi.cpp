@@ -0,0 +1,153 @@
+// --------------------------------------------------
+// Scenario: WiFi supervision
+//
+// Boots without waiting for the AP, idles through the periodic gateway
+// probes, then takes the network away three ways: the AP drops for 90 s,
+// the AP stays up but the gateway stops answering, and the AP is gone
+// long enough for the reboot tier. Reports loop() stalls in each phase,
+// the time to notice and the time back online after the network returns.
+// --------------------------------------------------
+
+#include "antenna_switch.h"
+#include "sim.h"
+#include "sim_report.h"
+#include "sim_scenarios.h"
+#include "wifi_supervisor.h"
+
+namespace {
+
+const uint32_t LOOP_BUDGET_US = 5000;
+
+struct Phase
+{
+    const char* name;
+    double   detectS;            // network gone -> wifiOnline() false
+    double   recoverS;           // network back -> wifiOnline() true
+    uint64_t loopMaxUs;          // while the network was down
+    uint64_t stallUs;
+};
+
+// Seconds until done() holds, or -1.
+double waitFor(std::function<bool()> done, uint64_t timeoutUs)
+{
+    const uint64_t t0 = simNow();
+    simRunUntil(done, timeoutUs);
+    return done() ? (simNow() - t0) / 1e6 : -1;
+}
+
+Phase outage(const char* name, std::function<void(bool)> setUp, uint64_t downUs)
+{
+    Phase p = {name, 0, 0, 0, 0};
+    const uint64_t t0 = simNow();
+    simResetLoopStats();
+    setUp(false);
+    p.detectS = waitFor([] { return !wifiOnline(); }, downUs);
+    simRunFor(t0 + downUs - simNow());
+    p.loopMaxUs = simLoopStats().maxUs;
+    p.stallUs = simLoopStats().stallUs;
+    setUp(true);
+    p.recoverS = waitFor([] { return wifiOnline(); }, 120000000);
+    return p;
+}
+
+void printPhase(const Phase& p)
+{
+    printf("  %-14s detect=%.1f s  back online=%.1f s  loop max=%.2f ms stalled=%.1f ms\n",
+           p.name, p.detectS, p.recoverS, p.loopMaxUs / 1000.0, p.stallUs / 1000.0);
+}
+
+} // namespace
+
+int scenarioWifi(const SimOptions& opt)
+{
+    int failures = 0;
+    std::vector<Phase> phases;
+
+    simNvsErase();
+    const uint64_t bootStart = simNow();
+    simBoot();
+    const uint64_t setupUs = simNow() - bootStart;
+    const double onlineS = waitFor([] { return wifiOnline(); }, 30000000);
+    printf("wifi: setup() %.1f ms, online after %.1f s\n", setupUs / 1000.0, onlineS);
+    simCheck(setupUs < simCosts.wifiChannelScanUs + simCosts.wifiJoinUs, "setup() does not wait for the AP", &failures);
+    simCheck(onlineS > 0, "online after boot", &failures);
+
+    // Ten quiet minutes: twenty gateway probes, none of them felt by loop().
+    // (MQTT connects first; its blocking connect is not WiFi supervision.)
+    simRunUntil([] { return simMqttConnects() > 0; }, 10000000);
+    simResetLoopStats();
+    const uint32_t probesBefore = wifiSupervisorStats().probes;
+    simRunFor(600ULL * 1000000);
+    const WifiSupervisorStats idle = wifiSupervisorStats();
+    printf("  idle 10 min: %u probes, %u missed, loop max=%.2f ms\n", idle.probes - probesBefore,
+           idle.probeMisses, simLoopStats().maxUs / 1000.0);
+    simCheck(idle.probes - probesBefore >= 19 && idle.probeMisses == 0, "gateway probed every 30 s", &failures);
+    simCheck(simLoopStats().maxUs < LOOP_BUDGET_US, "probes never block loop()", &failures);
+
+    phases.push_back(outage("AP down 90 s", simWifiSetApUp, 90ULL * 1000000));
+    printPhase(phases.back());
+    simCheck(phases.back().detectS >= 0 && phases.back().detectS < 1, "AP loss noticed from the event", &failures);
+    simCheck(phases.back().recoverS > 0 && phases.back().recoverS < (WIFI_BACKOFF_MAX_MS + 5000) / 1000.0,
+             "back online within one backoff of the AP returning", &failures);
+    simCheck(phases.back().loopMaxUs < LOOP_BUDGET_US, "loop() keeps running while reconnecting", &failures);
+    simRunFor(60ULL * 1000000);
+
+    phases.push_back(outage("gateway silent", simNetSetGatewayUp, 180ULL * 1000000));
+    printPhase(phases.back());
+    simCheck(phases.back().detectS >= 0 &&
+                 phases.back().detectS <
+                     (WIFI_PROBE_INTERVAL_MS + WIFI_PROBE_FAILURES * WIFI_PROBE_RETRY_MS) / 1000.0 + 5,
+             "dead gateway noticed by the probes", &failures);
+    simCheck(phases.back().recoverS > 0, "back online once the gateway answers", &failures);
+    simCheck(phases.back().loopMaxUs < LOOP_BUDGET_US, "loop() keeps running while the gateway is silent", &failures);
+    const WifiSupervisorStats afterGateway = wifiSupervisorStats();
+    simCheck(afterGateway.resets > 0, "silent gateway escalates to a rejoin", &failures);
+    simRunFor(60ULL * 1000000);
+
+    // Long outage: the reboot tier fires once, not before its time.
+    const uint32_t restarts = simRestarts();
+    const uint64_t longStart = simNow();
+    simWifiSetApUp(false);
+    simRunUntil([restarts] { return simRestarts() > restarts; }, (WIFI_REBOOT_AFTER_MS + 120000) * 1000ULL);
+    const uint64_t rebootAtUs = simNow() - longStart;
+    simRunFor((WIFI_REBOOT_AFTER_MS / 2) * 1000ULL);
+    const uint32_t reboots = simRestarts() - restarts;
+    simWifiSetApUp(true);
+    const double longRecoverS = waitFor([] { return wifiOnline(); }, 120000000);
+    printf("  AP down %.0f min: %u reboot(s), first after %.1f min, back online=%.1f s\n",
+           (simNow() - longStart) / 60e6, reboots, rebootAtUs / 60e6, longRecoverS);
+    simCheck(reboots == 1 && rebootAtUs >= WIFI_REBOOT_AFTER_MS * 1000ULL, "one reboot after the offline limit",
+             &failures);
+    simCheck(longRecoverS > 0, "online again after the long outage", &failures);
+
+    if (!opt.out.empty()) {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            perror(opt.out.c_str());
+            return 1;
+        }
+        SimJson json(f);
+        json.beginObject()
+            .field("scenario", "wifi")
+            .field("setup_us", setupUs)
+            .field("online_after_boot_s", onlineS);
+        json.beginArray("outages");
+        for (const Phase& p : phases) {
+            json.beginObject()
+                .field("name", p.name)
+                .field("detect_s", p.detectS)
+                .field("recover_s", p.recoverS)
+                .field("loop_max_us", p.loopMaxUs)
+                .field("stall_us", p.stallUs)
+                .endObject();
+        }
+        json.endArray();
+        json.field("reboots", reboots)
+            .field("reboot_after_s", rebootAtUs / 1e6)
+            .field("failures", failures)
+            .endObject();
+        fclose(f);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,807 @@
+#include <algorithm>
+#include <map>
+#include <new>
+#include <queue>
+#include <random>
+#include <ucontext.h>
+
+#include <Arduino.h>
+
+#include "hal.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+SimCosts simCosts;
+bool simVerbose = false;
+
+HardwareSerial Serial;
+EspClass ESP;
+
+// --------------------------------------------------
+// Heap: allocation counter and firmware live bytes
+//
+// Every block carries its size and whether it was made on the firmware's
+// behalf (setup(), loop(), timers, workers) rather than by the simulator
+// or the scenario, so live and peak bytes show what the board would hold.
+//
+// Firmware blocks also get a place in a model of the board's heap: an
+// arena of ARENA_SIZE, first fit in address order, sizes rounded to 4
+// bytes plus an 8-byte block header like multi_heap's. Free neighbours
+// merge; a block that outlives its neighbours splits the space around
+// it, and the largest free block (ESP.getMaxAllocHeap()) shows it.
+// --------------------------------------------------
+namespace {
+
+const size_t ARENA_SIZE     = 200 * 1024;
+const size_t ARENA_OVERHEAD = 8;
+const size_t ARENA_NONE     = SIZE_MAX;
+
+struct alignas(16) BlockHeader
+{
+    size_t size;
+    bool   firmware;
+    size_t offset;           // in the arena, ARENA_NONE if it did not fit
+    size_t span;
+};
+
+uint64_t heapAllocs = 0;
+bool heapFirmware = false;
+size_t heapLive = 0;
+size_t heapPeak = 0;
+size_t heapPeakEver = 0;
+
+bool arenaBusy = false;      // the free map's own nodes are not the firmware's
+size_t arenaUsed = 0;
+size_t arenaPeakEver = 0;
+uint32_t arenaFailures = 0;
+
+// offset -> length. Never destroyed: statics torn down after it at exit
+// still free firmware blocks.
+std::map<size_t, size_t>& freeRanges()
+{
+    static std::map<size_t, size_t>* ranges = [] {
+        const bool busy = arenaBusy;
+        arenaBusy = true;
+        auto* m = new std::map<size_t, size_t>{{0, ARENA_SIZE}};
+        arenaBusy = busy;
+        return m;
+    }();
+    return *ranges;
+}
+
+size_t arenaTake(size_t span)
+{
+    arenaBusy = true;
+    std::map<size_t, size_t>& ranges = freeRanges();
+    size_t offset = ARENA_NONE;
+    for (auto it = ranges.begin(); it != ranges.end(); ++it) {
+        if (it->second < span) continue;
+        offset = it->first;
+        const size_t rest = it->second - span;
+        ranges.erase(it);
+        if (rest) ranges.emplace(offset + span, rest);
+        arenaUsed += span;
+        arenaPeakEver = std::max(arenaPeakEver, arenaUsed);
+        break;
+    }
+    if (offset == ARENA_NONE) arenaFailures++;
+    arenaBusy = false;
+    return offset;
+}
+
+void arenaGive(size_t offset, size_t span)
+{
+    arenaBusy = true;
+    std::map<size_t, size_t>& ranges = freeRanges();
+    arenaUsed -= span;
+    auto next = ranges.lower_bound(offset);
+    if (next != ranges.end() && next->first == offset + span) {
+        span += next->second;
+        next = ranges.erase(next);
+    }
+    if (next != ranges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += span;
+            arenaBusy = false;
+            return;
+        }
+    }
+    ranges.emplace(offset, span);
+    arenaBusy = false;
+}
+
+} // namespace
+
+SimHeapScope::SimHeapScope(bool firmware) : saved_(heapFirmware)
+{
+    heapFirmware = firmware;
+}
+
+SimHeapScope::~SimHeapScope()
+{
+    heapFirmware = saved_;
+}
+
+// GCC flags free() in a replaced operator delete once new is inlined.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void* operator new(size_t n)
+{
+    heapAllocs++;
+    BlockHeader* b = (BlockHeader*)malloc(sizeof(BlockHeader) + n);
+    if (!b) throw std::bad_alloc();
+    b->size = n;
+    b->firmware = heapFirmware && !arenaBusy;
+    b->offset = ARENA_NONE;
+    if (b->firmware) {
+        heapLive += n;
+        if (heapLive > heapPeak) heapPeak = heapLive;
+        if (heapLive > heapPeakEver) heapPeakEver = heapLive;
+        b->span = ((n + 3) & ~(size_t)3) + ARENA_OVERHEAD;
+        b->offset = arenaTake(b->span);
+    }
+    return b + 1;
+}
+
+void* operator new[](size_t n)
+{
+    return operator new(n);
+}
+
+void operator delete(void* p) noexcept
+{
+    if (!p) return;
+    BlockHeader* b = (BlockHeader*)p - 1;
+    if (b->firmware) heapLive -= b->size;
+    if (b->offset != ARENA_NONE) arenaGive(b->offset, b->span);
+    free(b);
+}
+
+void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+uint64_t simHeapAllocs()
+{
+    return heapAllocs;
+}
+
+size_t simHeapLive()
+{
+    return heapLive;
+}
+
+size_t simHeapPeak()
+{
+    return heapPeak;
+}
+
+void simHeapResetPeak()
+{
+    heapPeak = heapLive;
+}
+
+size_t simHeapLargestFree()
+{
+    size_t largest = 0;
+    for (const auto& r : freeRanges()) largest = std::max(largest, r.second);
+    return largest;
+}
+
+uint32_t simHeapFailures()
+{
+    return arenaFailures;
+}
+
+// --------------------------------------------------
+// Clock and events
+// --------------------------------------------------
+namespace {
+
+struct Event
+{
+    uint64_t atUs;
+    uint64_t order;
+    std::function<void()> fn;
+
+    bool operator>(const Event& o) const
+    {
+        return atUs != o.atUs ? atUs > o.atUs : order > o.order;
+    }
+};
+
+uint64_t nowUs = 0;
+uint64_t eventOrder = 0;
+std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+
+SimLoopStats loopStats;
+uint32_t restarts = 0;
+uint32_t boots = 0;
+uint8_t resetReason = 1;                 // esp_reset_reason_t: power-on
+
+std::map<int, int> gpioLevels;
+std::vector<SimGpioEdge> gpioEdges;
+std::map<int, int> inputLevels;          // outside the board: survive a reboot
+std::map<int, HalGpioIsr> gpioIsrs;
+uint32_t isrGeneration = 0;              // bumped on boot to void edges in flight
+
+struct Mcp23017
+{
+    bool    present = true;
+    uint8_t reg[0x16] = {0xff, 0xff};    // IODIRA/B reset to inputs
+};
+
+Mcp23017 mcp[8];
+SimBusStats busStats;
+
+} // namespace
+
+uint64_t simNow()
+{
+    return nowUs;
+}
+
+static bool workerSuspend(uint64_t us);
+
+void simAdvance(uint64_t us)
+{
+    if (workerSuspend(us)) return;
+    const uint64_t target = nowUs + us;
+    while (!events.empty() && events.top().atUs <= target) {
+        SimHeapScope scope(false);
+        Event ev = events.top();
+        events.pop();
+        if (ev.atUs > nowUs) nowUs = ev.atUs;
+        ev.fn();
+    }
+    nowUs = target;
+}
+
+void simAt(uint64_t atUs, std::function<void()> fn)
+{
+    SimHeapScope scope(false);
+    events.push(Event{atUs, eventOrder++, std::move(fn)});
+}
+
+uint64_t simNextEventUs()
+{
+    return events.empty() ? UINT64_MAX : events.top().atUs;
+}
+
+// --------------------------------------------------
+// Firmware runner
+// --------------------------------------------------
+const uint32_t SimLoopStats::BOUNDS_US[SimLoopStats::BUCKETS] = {
+    10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000,
+    20000, 50000, 100000, 200000, 500000, 1000000, 2000000, 5000000, 10000000, UINT32_MAX
+};
+
+uint64_t SimLoopStats::percentileUs(double p) const
+{
+    if (passes == 0) return 0;
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)passes);
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += counts[i];
+        if (seen > rank) return std::min<uint64_t>(BOUNDS_US[i], maxUs);
+    }
+    return maxUs;
+}
+
+static void recordPass(uint64_t us)
+{
+    loopStats.passes++;
+    loopStats.maxUs = std::max(loopStats.maxUs, us);
+    if (us > SimLoopStats::STALL_US) loopStats.stallUs += us;
+    int b = 0;
+    while (b < SimLoopStats::BUCKETS - 1 && us > SimLoopStats::BOUNDS_US[b]) b++;
+    loopStats.counts[b]++;
+}
+
+static void bootFirmware(uint8_t reason)
+{
+    resetReason = reason;
+    for (auto& kv : gpioLevels) kv.second = LOW;
+    gpioIsrs.clear();
+    isrGeneration++;
+    for (Mcp23017& m : mcp) {
+        const bool present = m.present;
+        m = Mcp23017();
+        m.present = present;
+    }
+    simNetReset();
+    simOtaBoot();
+    simAdcReset();
+    boots++;
+    SimHeapScope scope(true);
+    setup();
+}
+
+static void boot(uint8_t reason)
+{
+    try {
+        bootFirmware(reason);
+    } catch (const SimRestart&) {
+        restarts++;
+        bootFirmware(3);
+    }
+}
+
+void simBoot()
+{
+    boot(1);
+}
+
+static void runPass()
+{
+    const uint64_t t0 = nowUs;
+    try {
+        SimHeapScope scope(true);
+        loop();
+    } catch (const SimRestart&) {
+        restarts++;
+        boot(3);
+        return;
+    }
+    simAdvance(simCosts.loopPassUs);
+    recordPass(nowUs - t0);
+}
+
+void simRunFor(uint64_t us)
+{
+    const uint64_t until = nowUs + us;
+    while (nowUs < until) runPass();
+}
+
+void simRunUntil(std::function<bool()> done, uint64_t timeoutUs)
+{
+    const uint64_t until = nowUs + timeoutUs;
+    while (nowUs < until && !done()) runPass();
+}
+
+const SimLoopStats& simLoopStats()
+{
+    return loopStats;
+}
+
+void simResetLoopStats()
+{
+    loopStats = SimLoopStats();
+}
+
+uint32_t simRestarts()
+{
+    return restarts;
+}
+
+void simDropRecords()
+{
+    gpioEdges.clear();
+    gpioEdges.shrink_to_fit();
+    simTcpDropRecords();
+    simMqttDropRecords();
+}
+
+uint8_t halResetReason()
+{
+    return resetReason;
+}
+
+uint32_t halRandom()
+{
+    static std::mt19937 rng(0x5eed);      // reproducible runs, new values every boot
+    return (uint32_t)rng();
+}
+
+// --------------------------------------------------
+// GPIO
+// --------------------------------------------------
+const std::vector<SimGpioEdge>& simGpioEdges()
+{
+    return gpioEdges;
+}
+
+int simGpioLevel(int pin)
+{
+    auto it = gpioLevels.find(pin);
+    return it == gpioLevels.end() ? LOW : it->second;
+}
+
+void halGpioOutput(int pin)
+{
+    gpioLevels.emplace(pin, LOW);
+}
+
+void halGpioWrite(int pin, bool level)
+{
+    int& cur = gpioLevels[pin];
+    if (cur == (int)level) return;
+    cur = level;
+    SimHeapScope scope(false);
+    gpioEdges.push_back(SimGpioEdge{nowUs, (uint8_t)pin, (uint8_t)level});
+}
+
+void halGpioWriteMask(uint64_t clearMask, uint64_t setMask)
+{
+    for (int pin = 0; pin < 64; pin++) {
+        if (clearMask & (1ULL << pin)) halGpioWrite(pin, false);
+    }
+    for (int pin = 0; pin < 64; pin++) {
+        if (setMask & (1ULL << pin)) halGpioWrite(pin, true);
+    }
+}
+
+void simGpioSetInput(int pin, int level)
+{
+    int& cur = inputLevels[pin];
+    if (cur == level) return;
+    cur = level;
+    const uint32_t gen = isrGeneration;
+    simAt(nowUs + simCosts.isrLatencyUs, [pin, level, gen] {
+        auto it = gpioIsrs.find(pin);
+        if (gen != isrGeneration || it == gpioIsrs.end()) return;
+        SimHeapScope scope(true);
+        it->second(level != LOW);
+    });
+}
+
+void halGpioInput(int pin, bool pullUp)
+{
+    inputLevels.emplace(pin, pullUp ? HIGH : LOW);
+}
+
+bool halGpioRead(int pin)
+{
+    auto it = inputLevels.find(pin);
+    return it != inputLevels.end() ? it->second != LOW : simGpioLevel(pin) != LOW;
+}
+
+void halGpioOnChange(int pin, HalGpioIsr fn)
+{
+    gpioIsrs[pin] = fn;
+}
+
+// --------------------------------------------------
+// Output expanders
+// --------------------------------------------------
+const SimBusStats& simBusStats()
+{
+    return busStats;
+}
+
+void simBusResetStats()
+{
+    busStats = SimBusStats();
+}
+
+void simI2cSetPresent(uint8_t addr, bool present)
+{
+    if (addr >= 0x20 && addr <= 0x27) mcp[addr - 0x20].present = present;
+}
+
+void halShiftOut(int dataPin, int clockPin, int latchPin, const uint8_t* bytes, size_t len)
+{
+    // Register r (0 = next to the MCU) receives the last byte shifted in.
+    busStats.shiftTransfers++;
+    busStats.shiftBits += len * 8;
+    for (size_t r = 0; r < len; r++) {
+        for (int q = 0; q < 8; q++) {
+            halGpioWrite(SIM_HC595_PIN_BASE + (int)r * 8 + q, (bytes[len - 1 - r] >> q) & 1);
+        }
+    }
+}
+
+bool halI2cBegin(int sda, int scl, uint32_t hz)
+{
+    return true;
+}
+
+bool halI2cWrite(uint8_t addr, const uint8_t* data, size_t len)
+{
+    busStats.i2cTransfers++;
+    busStats.i2cBytes += 1 + len;
+    if (addr < 0x20 || addr > 0x27 || !mcp[addr - 0x20].present || len == 0) {
+        busStats.i2cNacks++;
+        return false;
+    }
+
+    // IOCON.BANK = 0, sequential: the pointer steps through the registers.
+    Mcp23017& m = mcp[addr - 0x20];
+    uint8_t ptr = data[0];
+    for (size_t i = 1; i < len; i++, ptr = (uint8_t)((ptr + 1) % sizeof(m.reg))) {
+        if (ptr == 0x12 || ptr == 0x13) m.reg[ptr + 2] = data[i];   // GPIO writes go to OLAT
+        else if (ptr < sizeof(m.reg)) m.reg[ptr] = data[i];
+    }
+    for (int bit = 0; bit < 16; bit++) {
+        const int port = bit >> 3, b = bit & 7;
+        const bool out = !(m.reg[0x00 + port] >> b & 1);
+        halGpioWrite(SIM_MCP23017_PIN_BASE + (addr - 0x20) * 16 + bit, out && (m.reg[0x14 + port] >> b & 1));
+    }
+    return true;
+}
+
+uint64_t halMicros()
+{
+    return nowUs;
+}
+
+// Wall clock: an offset from the virtual clock. Starts synced, reading
+// 2026-01-01 00:00 UTC at virtual time 0.
+namespace {
+uint64_t utcOffsetUs = 1767225600000000ULL;
+bool utcValid = true;
+}
+
+void simSetUtcMicros(uint64_t us)
+{
+    utcValid = us != 0;
+    utcOffsetUs = us - nowUs;
+}
+
+void halClockSyncBegin(const char* server)
+{
+    (void)server;
+}
+
+bool halUtcMicros(uint64_t* us)
+{
+    if (!utcValid) return false;
+    *us = utcOffsetUs + nowUs;
+    return true;
+}
+
+// --------------------------------------------------
+// Timers and workers: events on the virtual clock
+// --------------------------------------------------
+// Timers fire simCosts.timerDispatchUs late.
+struct HalTimer
+{
+    HalTimerFn fn;
+    uint32_t   generation;       // bumped by arm/cancel to void stale events
+};
+
+HalTimerHandle halTimerCreate(const char* name, HalTimerFn fn)
+{
+    (void)name;
+    return new HalTimer{fn, 0};
+}
+
+void halTimerArm(HalTimerHandle timer, uint32_t us)
+{
+    const uint32_t gen = ++timer->generation;
+    simAt(nowUs + us + simCosts.timerDispatchUs, [timer, gen] {
+        SimHeapScope scope(true);
+        if (timer->generation == gen) timer->fn();
+    });
+}
+
+void halTimerCancel(HalTimerHandle timer)
+{
+    timer->generation++;
+}
+
+// Workers: a notification schedules one run simCosts.taskWakeUs later;
+// further notifications before it starts fold into it. Each worker runs
+// on its own stack, as on its own core: time it spends (simAdvance, e.g.
+// a flash write) passes while loop() and the events carry on, and it
+// resumes when that time is up.
+struct HalWorker
+{
+    HalWorkerFn fn;
+    bool        pending;         // a run is scheduled
+    bool        running;         // fn started and has not returned
+    bool        again;           // notified while running
+    uint32_t    boot;            // the boot the run belongs to
+    uint32_t    run;             // bumped per run, voids stale resumes
+    ucontext_t  ctx;
+    ucontext_t  caller;
+    std::vector<char> stack;
+};
+
+namespace {
+
+const size_t WORKER_STACK = 256 * 1024;
+HalWorker* currentWorker = nullptr;
+
+void workerEntry()
+{
+    currentWorker->fn();
+    currentWorker->running = false;
+}                                // back to caller through uc_link
+
+void workerSwitchIn(HalWorker* w)
+{
+    HalWorker* prev = currentWorker;
+    currentWorker = w;
+    {
+        SimHeapScope scope(true);
+        swapcontext(&w->caller, &w->ctx);
+    }
+    currentWorker = prev;
+    if (!w->running && w->again) {
+        w->again = false;
+        halWorkerNotify(w);
+    }
+}
+
+void workerStart(HalWorker* w)
+{
+    if (w->running && w->boot == boots) {
+        w->again = true;
+        return;
+    }
+    w->running = true;
+    w->again = false;
+    w->boot = boots;
+    w->run++;
+    getcontext(&w->ctx);
+    w->ctx.uc_stack.ss_sp = w->stack.data();
+    w->ctx.uc_stack.ss_size = w->stack.size();
+    w->ctx.uc_link = &w->caller;
+    makecontext(&w->ctx, workerEntry, 0);
+    workerSwitchIn(w);
+}
+
+} // namespace
+
+bool simInWorker()
+{
+    return currentWorker != nullptr;
+}
+
+// A worker's simAdvance: back to whoever switched it in, resumed when the
+// time is up. A run cut off by a reboot is dropped with its stack.
+static bool workerSuspend(uint64_t us)
+{
+    HalWorker* w = currentWorker;
+    if (!w) return false;
+    const uint32_t run = w->run;
+    simAt(nowUs + us, [w, run] {
+        if (w->run != run) return;
+        if (w->boot == boots) workerSwitchIn(w);
+        else w->running = w->again = false;
+    });
+    swapcontext(&w->ctx, &w->caller);
+    return true;
+}
+
+HalWorkerHandle halWorkerCreate(const char* name, HalWorkerFn fn, int core, int priority)
+{
+    (void)name;
+    (void)core;
+    (void)priority;
+    static int created = 0;
+    if (created >= HAL_WORKERS_MAX) return nullptr;   // the board's pool
+    created++;
+    SimHeapScope scope(false);           // the simulator's, not the board's
+    HalWorker* w = new HalWorker{fn, false, false, false, 0, 0, {}, {}, {}};
+    w->stack.resize(WORKER_STACK);
+    return w;
+}
+
+void halWorkerNotify(HalWorkerHandle worker)
+{
+    if (worker->pending) return;
+    worker->pending = true;
+    simAt(nowUs + simCosts.taskWakeUs, [worker] {
+        worker->pending = false;
+        workerStart(worker);
+    });
+}
+
+void halWorkerNotifyFromIsr(HalWorkerHandle worker)
+{
+    halWorkerNotify(worker);
+}
+
+void halCriticalEnter()
+{
+}
+
+void halCriticalExit()
+{
+}
+
+// --------------------------------------------------
+// Arduino core
+// --------------------------------------------------
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    if (mode == OUTPUT) halGpioOutput(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    halGpioWrite(pin, val != LOW);
+}
+
+int digitalRead(uint8_t pin)
+{
+    return simGpioLevel(pin);
+}
+
+unsigned long millis()
+{
+    return (unsigned long)(uint32_t)(nowUs / 1000);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)(uint32_t)nowUs;
+}
+
+void delay(uint32_t ms)
+{
+    simAdvance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    simAdvance(us);
+}
+
+void yield()
+{
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+    (void)baud;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    if (simVerbose) fputc(c, stdout);
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t len)
+{
+    if (simVerbose) fwrite(buf, 1, len, stdout);
+    return len;
+}
+
+void EspClass::restart()
+{
+    Serial.println("[sim] ESP.restart()");
+    throw SimRestart();
+}
+
+uint64_t EspClass::getEfuseMac()
+{
+    return 0x0000A1B2C3D4E5F6ULL;
+}
+
+uint32_t EspClass::getHeapSize()
+{
+    return ARENA_SIZE;
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+    return (uint32_t)(ARENA_SIZE - arenaUsed);
+}
+
+uint32_t EspClass::getMinFreeHeap()
+{
+    return (uint32_t)(ARENA_SIZE - arenaPeakEver);
+}
+
+uint32_t EspClass::getMaxAllocHeap()
+{
+    // multi_heap reports what a malloc() could get: the block less its header
+    const size_t largest = simHeapLargestFree();
+    return largest > ARENA_OVERHEAD ? (uint32_t)(largest - ARENA_OVERHEAD) : 0;
+}
@@ -0,0 +1,90 @@
+#include <chrono>
+#include <vector>
+
+#include "hal.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+// --------------------------------------------------
+// Continuous ADC
+// --------------------------------------------------
+namespace {
+
+std::function<uint16_t(int pin, uint64_t atUs)> source;
+HalAdcFn adcFn = nullptr;
+std::vector<int> adcPins;
+uint32_t adcHz = 0;
+uint64_t startUs = 0;
+uint64_t taken = 0;                  // samples since halAdcStart()
+uint32_t generation = 0;             // bumped per boot, voids pending frames
+SimAdcStats stats;
+
+uint64_t sampleAt(uint64_t n)
+{
+    return startUs + n * 1000000 / adcHz;
+}
+
+void scheduleFrame()
+{
+    const uint32_t gen = generation;
+    simAt(sampleAt(taken + HAL_ADC_FRAME - 1), [gen] {
+        if (gen != generation) return;
+        uint16_t buf[HAL_ADC_FRAME];
+        for (size_t i = 0; i < HAL_ADC_FRAME; i++, taken++) {
+            const size_t index = taken % adcPins.size();
+            const uint16_t v = source ? source(adcPins[index], sampleAt(taken)) : 0;
+            buf[i] = (uint16_t)(index << 12 | (v & 0x0fff));
+        }
+        const auto t0 = std::chrono::steady_clock::now();
+        {
+            SimHeapScope scope(true);
+            adcFn(buf, HAL_ADC_FRAME);
+        }
+        stats.handlerNs += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - t0).count();
+        stats.frames++;
+        stats.samples += HAL_ADC_FRAME;
+        scheduleFrame();
+    });
+}
+
+} // namespace
+
+void simAdcReset()
+{
+    generation++;
+    adcFn = nullptr;
+}
+
+void simAdcSetSource(std::function<uint16_t(int pin, uint64_t atUs)> reading)
+{
+    source = reading;
+}
+
+const SimAdcStats& simAdcStats()
+{
+    return stats;
+}
+
+void simAdcResetStats()
+{
+    stats = SimAdcStats();
+}
+
+bool halAdcStart(const int* pins, size_t count, uint32_t sampleHz, HalAdcFn fn, int core, int priority)
+{
+    (void)core;
+    (void)priority;
+    if (adcFn || count == 0 || count > HAL_ADC_PINS || sampleHz == 0) return false;
+    for (size_t i = 0; i < count; i++) {
+        if (pins[i] < 32 || pins[i] > 39) return false;      // ADC1
+    }
+    SimHeapScope scope(false);
+    adcPins.assign(pins, pins + count);
+    adcFn = fn;
+    adcHz = sampleHz;
+    startUs = simNow();
+    taken = 0;
+    scheduleFrame();
+    return true;
+}
@@ -0,0 +1,84 @@
+#include <string.h>
+#include <vector>
+
+#include "hal.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+// --------------------------------------------------
+// Event log partition
+// --------------------------------------------------
+namespace {
+
+std::vector<uint8_t> partition(SIM_LOG_PARTITION_SIZE, 0xff);
+SimLogFlashStats stats;
+
+bool inside(size_t offset, size_t len)
+{
+    return offset <= partition.size() && len <= partition.size() - offset;
+}
+
+void program(size_t offset, const void* data, size_t len)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) partition[offset + i] &= p[i];
+}
+
+} // namespace
+
+const SimLogFlashStats& simLogFlashStats()
+{
+    return stats;
+}
+
+void simLogFlashResetStats()
+{
+    stats = SimLogFlashStats();
+}
+
+void simLogFlashErase()
+{
+    memset(partition.data(), 0xff, partition.size());
+}
+
+void simLogFlashPoke(size_t offset, const void* data, size_t len)
+{
+    if (inside(offset, len)) program(offset, data, len);
+}
+
+size_t halLogFlashSize()
+{
+    return partition.size();
+}
+
+bool halLogFlashErase(size_t offset)
+{
+    if (offset % HAL_LOG_SECTOR || !inside(offset, HAL_LOG_SECTOR)) return false;
+    if (!simInWorker()) stats.blockingUs += simCosts.flashEraseUs;
+    simAdvance(simCosts.flashEraseUs);
+    memset(partition.data() + offset, 0xff, HAL_LOG_SECTOR);
+    stats.erases++;
+    return true;
+}
+
+bool halLogFlashWrite(size_t offset, const void* data, size_t len)
+{
+    if (!inside(offset, len)) return false;
+    const uint64_t us = (uint64_t)len * simCosts.flashWriteByteNs / 1000;
+    if (!simInWorker()) stats.blockingUs += us;
+    simAdvance(us);
+    program(offset, data, len);
+    stats.writes++;
+    stats.bytesWritten += len;
+    return true;
+}
+
+bool halLogFlashRead(size_t offset, void* data, size_t len)
+{
+    if (!inside(offset, len)) return false;
+    simAdvance(((uint64_t)len * simCosts.flashReadByteNs + 999) / 1000);
+    memcpy(data, partition.data() + offset, len);
+    stats.reads++;
+    stats.bytesRead += len;
+    return true;
+}
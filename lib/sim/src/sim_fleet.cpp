@@ -0,0 +1,430 @@
+#include <algorithm>
+#include <map>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "sim_internal.h"
+
+// --------------------------------------------------
+// Fleet: one process per member, the broker in the parent
+//
+// Each member talks to the parent over a socketpair in frames. At every
+// step boundary the member sends what it published, subscribed and
+// connected since the last one, then SYNC, and blocks until the parent
+// has answered with the messages routed to it and GO. The parent serves
+// the frames of all members in time order, so the fleet behaves as if
+// it shared one clock.
+// --------------------------------------------------
+namespace {
+
+enum FrameType : uint8_t {
+    // member -> parent
+    F_SYNC, F_PUB, F_SUB, F_CONN, F_DONE,
+    // parent -> member
+    F_MSG, F_CONNACK, F_DROP, F_GO,
+};
+
+struct FrameHeader
+{
+    uint8_t  type;
+    uint8_t  flag;           // PUB/MSG: retained, CONNACK: accepted
+    uint16_t topicLen;
+    uint32_t payloadLen;
+    uint64_t us;             // when it happened, or when it arrives
+};
+
+struct Frame
+{
+    FrameHeader h;
+    std::string topic;
+    std::string payload;
+};
+
+void encode(std::string& out, FrameType type, uint8_t flag, uint64_t us, const std::string& topic = "",
+            const std::string& payload = "")
+{
+    FrameHeader h = {type, flag, (uint16_t)topic.size(), (uint32_t)payload.size(), us};
+    out.append((const char*)&h, sizeof(h));
+    out += topic;
+    out += payload;
+}
+
+bool writeAll(int fd, const std::string& data)
+{
+    for (size_t done = 0; done < data.size();) {
+        const ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n <= 0) return false;
+        done += (size_t)n;
+    }
+    return true;
+}
+
+bool readAll(int fd, void* buf, size_t len)
+{
+    for (size_t done = 0; done < len;) {
+        const ssize_t n = read(fd, (char*)buf + done, len - done);
+        if (n <= 0) return false;
+        done += (size_t)n;
+    }
+    return true;
+}
+
+bool readFrame(int fd, Frame* f)
+{
+    if (!readAll(fd, &f->h, sizeof(f->h))) return false;
+    f->topic.resize(f->h.topicLen);
+    f->payload.resize(f->h.payloadLen);
+    return readAll(fd, &f->topic[0], f->h.topicLen) && readAll(fd, &f->payload[0], f->h.payloadLen);
+}
+
+// Same rules as the in-process broker: + one level, # the rest.
+bool topicMatches(const std::string& filter, const std::string& topic)
+{
+    size_t f = 0, t = 0;
+    while (f < filter.size()) {
+        if (filter[f] == '#') return true;
+        size_t fEnd = filter.find('/', f);
+        size_t tEnd = topic.find('/', t);
+        if (fEnd == std::string::npos) fEnd = filter.size();
+        if (tEnd == std::string::npos) tEnd = topic.size();
+        if (t > topic.size()) return false;
+        if (filter.compare(f, fEnd - f, "+") != 0 && filter.compare(f, fEnd - f, topic, t, tEnd - t) != 0) {
+            return false;
+        }
+        f = fEnd + 1;
+        t = tEnd + 1;
+    }
+    return t > topic.size();
+}
+
+bool matchesAny(const std::vector<std::string>& filters, const std::string& topic)
+{
+    for (const std::string& f : filters) {
+        if (topicMatches(f, topic)) return true;
+    }
+    return false;
+}
+
+// ---- Member side ----
+int memberFd = -1;
+std::string memberOut;       // frames for the next SYNC
+std::string memberReport;
+bool connackIn = false;
+bool connackOk = false;
+uint64_t connackUs = 0;
+
+void memberSync()
+{
+    encode(memberOut, F_SYNC, 0, simNow());
+    if (!writeAll(memberFd, memberOut)) _exit(3);
+    memberOut.clear();
+
+    Frame f;
+    for (;;) {
+        if (!readFrame(memberFd, &f)) _exit(3);       // parent gone
+        if (f.h.type == F_GO) break;
+        switch (f.h.type) {
+        case F_MSG:
+            simMqttDeliver(SimMqttMessage{f.topic, f.payload, f.h.flag != 0, f.h.us});
+            break;
+        case F_CONNACK:
+            connackIn = true;
+            connackOk = f.h.flag != 0;
+            connackUs = f.h.us;
+            break;
+        case F_DROP:
+            simMqttDropSession();
+            break;
+        default:
+            break;
+        }
+    }
+    simAt(simNow() + SIM_FLEET_STEP_US, memberSync);
+}
+
+// ---- Parent side ----
+struct Member
+{
+    pid_t pid = -1;
+    int fd = -1;
+    std::vector<std::string> subs;
+    std::string out;         // frames to send with the next GO
+    std::string report;
+    SimFleetMemberStats stats;
+};
+
+struct Event
+{
+    uint64_t us;
+    int from;                // member index, -1 = host
+    Frame frame;
+};
+
+std::vector<Member> members;
+uint64_t fleetNow = 0;
+bool brokerUp = true;
+uint64_t brokerFreeUs = 0;   // the CONNECT in service finishes
+std::map<std::string, std::string> retained;
+std::vector<std::string> hostSubs;
+std::vector<SimMqttMessage> hostInbox;
+std::vector<Event> hostOut;
+SimFleetBrokerStats brokerStats;
+
+void route(uint64_t atBrokerUs, const std::string& topic, const std::string& payload, bool retain)
+{
+    const uint64_t arriveUs = atBrokerUs + simCosts.fleetLatencyUs;
+    for (Member& m : members) {
+        if (!m.stats.connected || !matchesAny(m.subs, topic)) continue;
+        encode(m.out, F_MSG, retain, arriveUs, topic, payload);
+        brokerStats.deliveries++;
+    }
+    if (matchesAny(hostSubs, topic)) {
+        hostInbox.push_back(SimMqttMessage{topic, payload, retain, arriveUs});
+        brokerStats.deliveries++;
+    }
+}
+
+void serve(const Event& e)
+{
+    const Frame& f = e.frame;
+    const uint64_t atBrokerUs = e.us + simCosts.fleetLatencyUs;
+    Member* m = e.from >= 0 ? &members[e.from] : nullptr;
+
+    switch (f.h.type) {
+    case F_CONN: {
+        if (!brokerUp) {
+            m->stats.refused++;
+            brokerStats.refused++;
+            encode(m->out, F_CONNACK, 0, atBrokerUs + simCosts.fleetLatencyUs);
+            break;
+        }
+        const uint64_t startUs = std::max(atBrokerUs, brokerFreeUs);
+        brokerStats.maxConnectWaitUs = std::max(brokerStats.maxConnectWaitUs, startUs - atBrokerUs);
+        brokerFreeUs = startUs + simCosts.brokerConnectUs;
+        m->subs.clear();                     // clean session
+        m->stats.connected = true;
+        m->stats.connects++;
+        m->stats.lastConnectUs = brokerFreeUs;
+        brokerStats.connects++;
+        encode(m->out, F_CONNACK, 1, brokerFreeUs + simCosts.fleetLatencyUs);
+        break;
+    }
+    case F_SUB:
+        if (!m->stats.connected) break;
+        m->subs.push_back(f.topic);
+        for (const auto& kv : retained) {
+            if (topicMatches(f.topic, kv.first)) {
+                encode(m->out, F_MSG, 1, atBrokerUs + simCosts.fleetLatencyUs, kv.first, kv.second);
+            }
+        }
+        break;
+    case F_PUB:
+        if (!brokerUp || (m && !m->stats.connected)) break;
+        brokerStats.publishes++;
+        if (f.h.flag) retained[f.topic] = f.payload;
+        route(atBrokerUs, f.topic, f.payload, f.h.flag != 0);
+        break;
+    default:
+        break;
+    }
+}
+
+} // namespace
+
+// --------------------------------------------------
+// Member side
+// --------------------------------------------------
+bool simFleetIsMember()
+{
+    return memberFd >= 0;
+}
+
+bool simFleetMqttConnect()
+{
+    connackIn = false;
+    encode(memberOut, F_CONN, 0, simNow());
+    const uint64_t deadline = simNow() + 15000000;   // PubSubClient's MQTT_SOCKET_TIMEOUT
+    while (!(connackIn && simNow() >= connackUs) && simNow() < deadline) {
+        const uint64_t until = connackIn ? connackUs : std::min(simNextEventUs(), deadline);
+        simAdvance(until > simNow() ? until - simNow() : 1);
+    }
+    return connackIn && connackOk;
+}
+
+void simFleetMqttPublish(const std::string& topic, const std::string& payload, bool retained)
+{
+    encode(memberOut, F_PUB, retained, simNow(), topic, payload);
+}
+
+void simFleetMqttSubscribe(const std::string& filter)
+{
+    encode(memberOut, F_SUB, 0, simNow(), filter);
+}
+
+void simFleetReport(const std::string& text)
+{
+    memberReport = text;
+}
+
+// --------------------------------------------------
+// Parent side
+// --------------------------------------------------
+bool simFleetStart(int count, std::function<void(int index)> member)
+{
+    signal(SIGPIPE, SIG_IGN);
+    members.assign(count, Member());
+    fleetNow = simNow();
+    brokerUp = true;
+    brokerFreeUs = 0;
+    retained.clear();
+    hostSubs.clear();
+    hostInbox.clear();
+    hostOut.clear();
+    brokerStats = SimFleetBrokerStats();
+
+    for (int i = 0; i < count; i++) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) return false;
+        fflush(stdout);
+        fflush(stderr);
+        const pid_t pid = fork();
+        if (pid < 0) return false;
+        if (pid == 0) {
+            close(sv[0]);
+            for (int j = 0; j < i; j++) close(members[j].fd);
+            memberFd = sv[1];
+            simAt(simNow() + SIM_FLEET_STEP_US, memberSync);
+            member(i);
+            encode(memberOut, F_DONE, 0, simNow(), "", memberReport);
+            writeAll(memberFd, memberOut);
+            fflush(stdout);
+            _exit(0);
+        }
+        close(sv[1]);
+        members[i].pid = pid;
+        members[i].fd = sv[0];
+        members[i].stats.active = true;
+    }
+    return true;
+}
+
+bool simFleetStep()
+{
+    const uint64_t target = fleetNow + SIM_FLEET_STEP_US;
+    std::vector<Event> events;
+    events.swap(hostOut);
+
+    bool any = false;
+    for (int i = 0; i < (int)members.size(); i++) {
+        Member& m = members[i];
+        if (!m.stats.active) continue;
+        Event e;
+        e.from = i;
+        for (;;) {
+            if (!readFrame(m.fd, &e.frame)) {
+                fprintf(stderr, "fleet: member %d died\n", i);
+                e.frame.payload.clear();
+                e.frame.h.type = F_DONE;
+            }
+            if (e.frame.h.type == F_SYNC) break;
+            if (e.frame.h.type == F_DONE) {
+                m.report = e.frame.payload;
+                m.stats.active = false;
+                m.stats.connected = false;
+                close(m.fd);
+                waitpid(m.pid, nullptr, 0);
+                break;
+            }
+            e.us = e.frame.h.us;
+            events.push_back(e);
+        }
+        any = any || m.stats.active;
+    }
+
+    std::stable_sort(events.begin(), events.end(),
+                     [](const Event& a, const Event& b) { return a.us != b.us ? a.us < b.us : a.from < b.from; });
+    for (const Event& e : events) serve(e);
+
+    for (Member& m : members) {
+        if (!m.stats.active) continue;
+        encode(m.out, F_GO, 0, target);
+        writeAll(m.fd, m.out);
+        m.out.clear();
+    }
+    fleetNow = target;
+    return any;
+}
+
+uint64_t simFleetNow()
+{
+    return fleetNow;
+}
+
+void simFleetSetBrokerUp(bool up)
+{
+    if (brokerUp && !up) {
+        for (Member& m : members) {
+            if (!m.stats.connected) continue;
+            m.stats.connected = false;
+            m.subs.clear();
+            encode(m.out, F_DROP, 0, fleetNow);
+        }
+    }
+    brokerUp = up;
+}
+
+void simFleetPublish(const std::string& topic, const std::string& payload, bool retain)
+{
+    Event e;
+    e.us = fleetNow;
+    e.from = -1;
+    e.frame.h = FrameHeader{F_PUB, retain, (uint16_t)topic.size(), (uint32_t)payload.size(), fleetNow};
+    e.frame.topic = topic;
+    e.frame.payload = payload;
+    hostOut.push_back(e);
+}
+
+void simFleetSubscribe(const std::string& filter)
+{
+    hostSubs.push_back(filter);
+}
+
+std::vector<SimMqttMessage> simFleetReceive()
+{
+    std::stable_sort(hostInbox.begin(), hostInbox.end(),
+                     [](const SimMqttMessage& a, const SimMqttMessage& b) { return a.atUs < b.atUs; });
+    std::vector<SimMqttMessage> due;
+    size_t n = 0;
+    while (n < hostInbox.size() && hostInbox[n].atUs <= fleetNow) n++;
+    due.assign(hostInbox.begin(), hostInbox.begin() + n);
+    hostInbox.erase(hostInbox.begin(), hostInbox.begin() + n);
+    return due;
+}
+
+bool simFleetRetained(const std::string& topic, std::string* payload)
+{
+    auto it = retained.find(topic);
+    if (it == retained.end()) return false;
+    *payload = it->second;
+    return true;
+}
+
+const SimFleetBrokerStats& simFleetBrokerStats()
+{
+    return brokerStats;
+}
+
+SimFleetMemberStats simFleetMemberStats(int index)
+{
+    return members[index].stats;
+}
+
+const std::string& simFleetReportOf(int index)
+{
+    return members[index].report;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+
+#include "sim.h"
+
+// Hooks shared between the simulated board's translation units.
+
+void simNetReset();          // drop WiFi/MQTT/TCP session state on reboot
+void simTcpReset();          // device sockets vanish; peers see a reset
+void simOtaBoot();           // bootloader: pick the slot, roll back an unconfirmed image
+void simAdcReset();          // sampling stops until the firmware starts it again
+void simTcpDropRecords();    // simDropRecords() for sim_tcp.cpp
+void simMqttDropRecords();   // ... and sim_net.cpp
+uint64_t simNextEventUs();   // UINT64_MAX if nothing is scheduled
+bool simInWorker();          // the caller runs on a halWorker task, not loop() or setup()
+
+// Fleet member (sim_fleet.cpp): PubSubClient talks to the parent's broker.
+bool simFleetIsMember();
+bool simFleetMqttConnect();  // waits on the virtual clock for the CONNACK
+void simFleetMqttPublish(const std::string& topic, const std::string& payload, bool retained);
+void simFleetMqttSubscribe(const std::string& filter);
+// ... and what the parent's broker sends back (sim_net.cpp)
+void simMqttDeliver(const SimMqttMessage& msg);
+void simMqttDropSession();
+
+// Allocations inside the scope count as the firmware's (or not) for
+// simHeapLive(); nests.
+class SimHeapScope
+{
+public:
+    explicit SimHeapScope(bool firmware);
+    ~SimHeapScope();
+
+private:
+    bool saved_;
+};
@@ -0,0 +1,87 @@
+// --------------------------------------------------
+// Native simulator entry point
+//
+//   pio run -e native
+//   .pio/build/native/program --scenario latency --out latency.json
+// --------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+#include "sim_scenarios.h"
+
+namespace {
+
+struct Scenario
+{
+    const char* name;
+    int (*run)(const SimOptions&);
+    const char* help;
+};
+
+const Scenario SCENARIOS[] = {
+    {"latency", scenarioLatency, "HTTP /set and MQTT commands -> relay edge latency"},
+    {"journal", scenarioJournal, "an hour of switching: NVS writes, wear spread, boot recovery"},
+    {"events",  scenarioEvents,  "10 dashboards: /state polling vs. /events push, fan-out cap"},
+    {"httpload", scenarioHttpLoad, "1/8/32 closed-loop HTTP clients: req/s, p99, slow client, upload"},
+    {"wifi",    scenarioWifi,    "AP loss, silent gateway, long outage: detection, recovery, loop() stalls"},
+    {"mqtt",    scenarioMqtt,    "command grammar, allocation-free match + parse, per-command timing"},
+    {"relaytask", scenarioRelayTask, "command ring and snapshot on host threads, relay edges while loop() blocks"},
+    {"metrics",  scenarioMetrics,  "scrape /metrics after mixed traffic: histogram format, counts per source"},
+    {"webui",    scenarioWebUi,    "page loads: bytes on wire and peak heap, gzip + ETag/304, streamed /settings"},
+    {"schedule", scenarioSchedule, "batch-loaded schedule and macros: firing error while loop() blocks, NVS, clock steps"},
+    {"outputs",  scenarioOutputs,  "GPIO, 74HC595 and MCP23017 output maps: one transfer per bank, multi-select, restore"},
+    {"band",     scenarioBand,     "frequency feeds (MQTT, FlexRadio TCP) -> band plan lookup -> relays, hysteresis"},
+    {"ptt",      scenarioPtt,      "replayed PTT windows vs. commands: no relay edge in TX, amp key timing, coalescing"},
+    {"ota",      scenarioOta,      "pipelined, verified firmware upload: KB/s, flash overlap, confirm and rollback"},
+    {"outbox",   scenarioOutbox,   "MQTT publish flood, broker outage and lost echoes: bounded, coalesced, confirmed"},
+    {"fleet",    scenarioFleet,    "24 switches on one broker: command throughput, latency, reconnect storm"},
+    {"udp",      scenarioUdp,      "binary UDP control vs. HTTP /set and MQTT: ack and relay edge latency, retries, MAC"},
+    {"config",   scenarioConfig,   "settings as one NVS record: boot reads, bytes per save, migration, corruption"},
+    {"boot",     scenarioBoot,     "power cycles: relays restored, services, WiFi and MQTT up; cached AP, static IP"},
+    {"log",      scenarioLog,      "binary event log: batched flash writes, /log?since= pulls, reboots, torn record, wrap"},
+    {"swr",      scenarioSwr,      "synthetic detector streams: per-antenna SWR, no false trips, trip latency, cost per sample"},
+    {"soak",     scenarioSoak,     "three days of HTTP and MQTT commands on one boot: largest free block, free heap, failed allocations"},
+    {"arbiter",  scenarioArbiter,  "command bursts, source priority, manual lock: coalescing window, replies, SWR bypass"},
+    {"beacon",   scenarioBeacon,   "multicast state beacons: heartbeat, change latency, device cost vs. 1-64 observers"},
+};
+
+void usage()
+{
+    printf("usage: program --scenario NAME [--out FILE] [--seed N] [--count N] [--verbose]\n\n");
+    for (const Scenario& s : SCENARIOS) printf("  %-12s %s\n", s.name, s.help);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const char* name = nullptr;
+    SimOptions opt;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(a, "--scenario") && v)   { name = v; i++; }
+        else if (!strcmp(a, "--out") && v)   { opt.out = v; i++; }
+        else if (!strcmp(a, "--seed") && v)  { opt.seed = (uint32_t)strtoul(v, nullptr, 0); i++; }
+        else if (!strcmp(a, "--count") && v) { opt.count = (uint32_t)strtoul(v, nullptr, 0); i++; }
+        else if (!strcmp(a, "--verbose"))    { simVerbose = true; }
+        else { usage(); return 2; }
+    }
+
+    if (!name) {
+        usage();
+        return 2;
+    }
+
+    for (const Scenario& s : SCENARIOS) {
+        if (!strcmp(s.name, name)) return s.run(opt);
+    }
+
+    fprintf(stderr, "unknown scenario: %s\n", name);
+    usage();
+    return 2;
+}
@@ -0,0 +1,476 @@
+#include <deque>
+#include <map>
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <PubSubClient.h>
+#include <ESPmDNS.h>
+
+#include "hal.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+WiFiClass WiFi;
+MDNSResponder MDNS;
+
+// --------------------------------------------------
+// WiFi
+// --------------------------------------------------
+namespace {
+
+enum class WifiState { Idle, Associating, Connected, Failed, Lost };
+
+const uint8_t AP_BSSID[6] = {0x24, 0x0a, 0xc4, 0x5e, 0x21, 0x90};
+
+bool apUp = true;
+int apChannel = 6;
+bool gatewayUp = true;
+int32_t pinnedChannel = 0;       // of the last begin(), 0 = scan
+uint8_t pinnedBssid[6] = {};
+uint32_t staticIp = 0;           // config(), 0 = DHCP
+bool autoReconnect = true;
+WifiState wifiState = WifiState::Idle;
+uint32_t wifiEpoch = 0;          // bumped on every attempt; stale completions are dropped
+std::vector<std::pair<WiFiEventCb, arduino_event_id_t>> wifiHandlers;
+SimWifiStats wifiStats;
+
+void wifiEmit(arduino_event_id_t event)
+{
+    for (const auto& h : wifiHandlers) {
+        if (h.second == ARDUINO_EVENT_MAX || h.second == event) h.first(event);
+    }
+}
+
+// Scan (all channels, or the pinned one), join, then DHCP unless the
+// address is static; stale steps of an older attempt are dropped.
+void wifiAssociate()
+{
+    wifiState = WifiState::Associating;
+    wifiStats.associations++;
+    const uint32_t epoch = ++wifiEpoch;
+    const bool pinned = pinnedChannel != 0;
+    if (pinned) wifiStats.channelScans++;
+    else wifiStats.fullScans++;
+
+    const auto fail = [] {
+        wifiState = WifiState::Failed;               // no AP found
+        wifiEmit(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    };
+    simAt(simNow() + (pinned ? simCosts.wifiChannelScanUs : simCosts.wifiScanUs), [epoch, pinned, fail] {
+        if (epoch != wifiEpoch || wifiState != WifiState::Associating) return;
+        if (!apUp || (pinned && (pinnedChannel != apChannel || memcmp(pinnedBssid, AP_BSSID, 6)))) return fail();
+        simAt(simNow() + simCosts.wifiJoinUs, [epoch, fail] {
+            if (epoch != wifiEpoch || wifiState != WifiState::Associating) return;
+            if (!apUp) return fail();
+            wifiEmit(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+            if (!staticIp) wifiStats.dhcp++;
+            simAt(simNow() + (staticIp ? 0 : simCosts.wifiDhcpUs), [epoch] {
+                if (epoch != wifiEpoch || wifiState != WifiState::Associating) return;
+                wifiState = WifiState::Connected;
+                wifiEmit(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+            });
+        });
+    });
+}
+
+bool wifiConnected()
+{
+    return wifiState == WifiState::Connected;
+}
+
+} // namespace
+
+void simWifiSetApUp(bool up)
+{
+    apUp = up;
+    if (!up && wifiState == WifiState::Connected) {
+        wifiState = WifiState::Lost;
+        wifiEmit(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    } else if (up && autoReconnect && (wifiState == WifiState::Lost || wifiState == WifiState::Failed)) {
+        // The Arduino core reconnects by itself unless told not to.
+        wifiAssociate();
+    }
+}
+
+void simWifiSetApChannel(int channel)
+{
+    apChannel = channel;
+    if (wifiState == WifiState::Connected) {
+        wifiState = WifiState::Lost;
+        wifiEmit(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    }
+}
+
+void simNetSetGatewayUp(bool up)
+{
+    gatewayUp = up;
+}
+
+const SimWifiStats& simWifiStats()
+{
+    return wifiStats;
+}
+
+bool WiFiClass::mode(wifi_mode_t m)
+{
+    if (m == WIFI_OFF) {
+        wifiState = WifiState::Idle;
+        wifiEpoch++;
+    }
+    return true;
+}
+
+bool WiFiClass::setHostname(const char* name)
+{
+    (void)name;
+    return true;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* pass, int32_t channel, const uint8_t* bssid, bool connect)
+{
+    (void)ssid;
+    (void)pass;
+    pinnedChannel = bssid ? channel : 0;
+    if (bssid) memcpy(pinnedBssid, bssid, 6);
+    if (connect) wifiAssociate();
+    return WL_DISCONNECTED;
+}
+
+bool WiFiClass::config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress dns2)
+{
+    (void)gateway;
+    (void)subnet;
+    (void)dns1;
+    (void)dns2;
+    staticIp = (uint32_t)local;
+    return true;
+}
+
+wl_status_t WiFiClass::status()
+{
+    switch (wifiState) {
+    case WifiState::Connected: return WL_CONNECTED;
+    case WifiState::Lost:      return WL_CONNECTION_LOST;
+    case WifiState::Failed:    return WL_NO_SSID_AVAIL;
+    case WifiState::Idle:      return WL_IDLE_STATUS;
+    default:                   return WL_DISCONNECTED;
+    }
+}
+
+bool WiFiClass::disconnect(bool wifioff)
+{
+    (void)wifioff;
+    const bool was = wifiState == WifiState::Connected;
+    wifiState = WifiState::Idle;
+    wifiEpoch++;
+    if (was) wifiEmit(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    return true;
+}
+
+bool WiFiClass::reconnect()
+{
+    wifiAssociate();
+    return true;
+}
+
+bool WiFiClass::setAutoReconnect(bool on)
+{
+    autoReconnect = on;
+    return true;
+}
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventCb cb, arduino_event_id_t event)
+{
+    wifiHandlers.emplace_back(cb, event);
+    return wifiHandlers.size();
+}
+
+IPAddress WiFiClass::localIP()
+{
+    if (!wifiConnected()) return IPAddress();
+    return staticIp ? IPAddress(staticIp) : IPAddress(192, 168, 1, 50);
+}
+
+uint8_t* WiFiClass::BSSID()
+{
+    static uint8_t bssid[6];
+    if (!wifiConnected()) return nullptr;
+    memcpy(bssid, AP_BSSID, 6);
+    return bssid;
+}
+
+int32_t WiFiClass::channel()
+{
+    return wifiConnected() ? apChannel : 0;
+}
+
+int8_t WiFiClass::RSSI()
+{
+    return wifiConnected() ? -58 : 0;
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t len)
+{
+    (void)buf;
+    return len;
+}
+
+// --------------------------------------------------
+// ICMP echo: answered after pingRttUs if the gateway is reachable
+// --------------------------------------------------
+namespace {
+
+HalPingResult pingState = HAL_PING_IDLE;
+uint32_t pingEpoch = 0;
+uint32_t pingRttMs = 0;
+
+} // namespace
+
+bool halPingStart(uint32_t ip, uint32_t timeoutMs)
+{
+    (void)ip;
+    if (pingState == HAL_PING_PENDING) return false;
+    simAdvance(simCosts.tcpCallUs);
+    wifiStats.pings++;
+    pingState = HAL_PING_PENDING;
+    const uint32_t epoch = ++pingEpoch;
+    const bool answered = wifiConnected() && gatewayUp;
+    const uint64_t after = answered ? simCosts.pingRttUs : (uint64_t)timeoutMs * 1000;
+    simAt(simNow() + after, [epoch, answered] {
+        if (epoch != pingEpoch) return;
+        // The gateway may have gone away while the echo was out.
+        pingState = answered && wifiConnected() && gatewayUp ? HAL_PING_OK : HAL_PING_TIMEOUT;
+        pingRttMs = simCosts.pingRttUs / 1000;
+    });
+    return true;
+}
+
+HalPingResult halPingResult(uint32_t* rttMs)
+{
+    const HalPingResult r = pingState;
+    if (r == HAL_PING_OK || r == HAL_PING_TIMEOUT) pingState = HAL_PING_IDLE;
+    if (rttMs) *rttMs = pingRttMs;
+    return r;
+}
+
+// --------------------------------------------------
+// MQTT broker
+// --------------------------------------------------
+namespace {
+
+bool brokerUp = true;
+uint32_t brokerEpoch = 1;        // bumped whenever every session is dropped
+uint32_t brokerConnects = 0;
+std::vector<std::string> subscriptions;
+std::deque<SimMqttMessage> inbound;
+std::vector<SimMqttMessage> published;
+std::map<std::string, std::string> retained;
+
+bool topicMatches(const std::string& filter, const std::string& topic)
+{
+    size_t f = 0, t = 0;
+    while (f < filter.size()) {
+        if (filter[f] == '#') return true;
+        size_t fEnd = filter.find('/', f);
+        size_t tEnd = topic.find('/', t);
+        if (fEnd == std::string::npos) fEnd = filter.size();
+        if (tEnd == std::string::npos) tEnd = topic.size();
+        if (t > topic.size()) return false;
+        if (filter.compare(f, fEnd - f, "+") != 0 &&
+            filter.compare(f, fEnd - f, topic, t, tEnd - t) != 0) {
+            return false;
+        }
+        f = fEnd + 1;
+        t = tEnd + 1;
+    }
+    return t > topic.size();
+}
+
+bool subscribed(const std::string& topic)
+{
+    for (const std::string& f : subscriptions) {
+        if (topicMatches(f, topic)) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+void simMqttSetBrokerUp(bool up)
+{
+    if (brokerUp && !up) {
+        brokerEpoch++;
+        inbound.clear();
+    }
+    brokerUp = up;
+}
+
+void simMqttInject(const std::string& topic, const std::string& payload)
+{
+    inbound.push_back(SimMqttMessage{topic, payload, false, simNow()});
+}
+
+const std::vector<SimMqttMessage>& simMqttPublished()
+{
+    return published;
+}
+
+void simMqttDropRecords()
+{
+    published.clear();
+    published.shrink_to_fit();
+}
+
+uint32_t simMqttConnects()
+{
+    return brokerConnects;
+}
+
+PubSubClient& PubSubClient::setServer(const char* domain, uint16_t port)
+{
+    (void)domain;
+    (void)port;
+    return *this;
+}
+
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE)
+{
+    callback_ = callback;
+    return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size)
+{
+    if (size == 0) return false;
+    bufferSize_ = size;
+    return true;
+}
+
+bool PubSubClient::connect(const char* id)
+{
+    return connect(id, nullptr, nullptr);
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass)
+{
+    (void)id;
+    (void)user;
+    (void)pass;
+    if (!wifiConnected() || (!brokerUp && !simFleetIsMember())) {
+        simAdvance(simCosts.mqttConnectUs / 10);   // refused quickly
+        state_ = MQTT_CONNECT_FAILED;
+        return false;
+    }
+    if (!simFleetIsMember()) {
+        simAdvance(simCosts.mqttConnectUs);
+    } else if (!simFleetMqttConnect()) {
+        state_ = MQTT_CONNECT_FAILED;
+        return false;
+    }
+    subscriptions.clear();
+    inbound.clear();
+    session_ = brokerEpoch;
+    state_ = MQTT_CONNECTED;
+    brokerConnects++;
+    return true;
+}
+
+void PubSubClient::disconnect()
+{
+    state_ = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::connected()
+{
+    if (state_ == MQTT_CONNECTED && (session_ != brokerEpoch || !wifiConnected())) {
+        state_ = MQTT_CONNECTION_LOST;
+    }
+    return state_ == MQTT_CONNECTED;
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload, bool retain)
+{
+    return publish(topic, (const uint8_t*)payload, (unsigned int)strlen(payload), retain);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length, bool retain)
+{
+    if (!connected()) return false;
+    simAdvance(simCosts.mqttPublishUs);
+    SimHeapScope scope(false);           // the broker's copies, not the board's
+    SimMqttMessage msg{topic, std::string((const char*)payload, length), retain, simNow()};
+    published.push_back(msg);
+    if (simFleetIsMember()) {
+        simFleetMqttPublish(msg.topic, msg.payload, retain);
+        return true;
+    }
+    if (retain) retained[msg.topic] = msg.payload;
+    if (subscribed(msg.topic)) inbound.push_back(msg);
+    return true;
+}
+
+bool PubSubClient::subscribe(const char* topic, uint8_t qos)
+{
+    (void)qos;
+    if (!connected()) return false;
+    SimHeapScope scope(false);
+    subscriptions.push_back(topic);
+    if (simFleetIsMember()) {
+        simFleetMqttSubscribe(topic);            // retained messages come from the parent
+        return true;
+    }
+    for (const auto& kv : retained) {
+        if (topicMatches(topic, kv.first)) {
+            inbound.push_back(SimMqttMessage{kv.first, kv.second, true, simNow()});
+        }
+    }
+    return true;
+}
+
+bool PubSubClient::loop()
+{
+    if (!connected()) return false;
+    simAdvance(simCosts.mqttLoopUs);
+    if (inbound.empty() || inbound.front().atUs > simNow()) return true;
+
+    SimMqttMessage msg = inbound.front();
+    inbound.pop_front();
+    // Fixed header, topic length and topic come out of the same buffer.
+    const size_t packet = 5 + 2 + msg.topic.size() + msg.payload.size();
+    if (callback_ && subscribed(msg.topic) && packet <= bufferSize_) {
+        std::vector<char> topic(msg.topic.begin(), msg.topic.end());
+        topic.push_back('\0');
+        std::vector<uint8_t> payload(msg.payload.begin(), msg.payload.end());
+        callback_(topic.data(), payload.data(), (unsigned int)payload.size());
+    }
+    return true;
+}
+
+void simMqttDeliver(const SimMqttMessage& msg)
+{
+    inbound.push_back(msg);
+}
+
+void simMqttDropSession()
+{
+    brokerEpoch++;
+    inbound.clear();
+}
+
+// --------------------------------------------------
+// Reboot
+// --------------------------------------------------
+void simNetReset()
+{
+    wifiState = WifiState::Idle;
+    wifiEpoch++;
+    autoReconnect = true;
+    pinnedChannel = 0;
+    staticIp = 0;
+    wifiHandlers.clear();
+    pingState = HAL_PING_IDLE;
+    pingEpoch++;
+    brokerEpoch++;
+    inbound.clear();
+    simTcpReset();
+}
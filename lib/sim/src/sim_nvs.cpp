@@ -0,0 +1,205 @@
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Preferences.h>
+
+#include "sim.h"
+#include "sim_internal.h"
+
+// --------------------------------------------------
+// NVS: namespace -> key -> value, kept across simulated reboots
+// --------------------------------------------------
+namespace {
+
+std::map<std::string, std::map<std::string, std::vector<uint8_t>>> flash;
+std::map<std::string, uint64_t> keyWrites;   // "ns/key" -> commits
+SimNvsStats nvsStats;
+
+} // namespace
+
+const SimNvsStats& simNvsStats()
+{
+    return nvsStats;
+}
+
+void simNvsResetStats()
+{
+    nvsStats = SimNvsStats();
+}
+
+void simNvsErase()
+{
+    flash.clear();
+    keyWrites.clear();
+}
+
+uint64_t simNvsKeyWrites(const std::string& ns, const std::string& key)
+{
+    auto it = keyWrites.find(ns + "/" + key);
+    return it == keyWrites.end() ? 0 : it->second;
+}
+
+bool simNvsRead(const std::string& ns, const std::string& key, std::vector<uint8_t>* value)
+{
+    auto n = flash.find(ns);
+    if (n == flash.end()) return false;
+    auto it = n->second.find(key);
+    if (it == n->second.end()) return false;
+    *value = it->second;
+    return true;
+}
+
+void simNvsWrite(const std::string& ns, const std::string& key, const std::vector<uint8_t>& value)
+{
+    flash[ns][key] = value;
+}
+
+bool Preferences::begin(const char* name, bool readOnly)
+{
+    if (open_) return false;
+    simAdvance(simCosts.nvsOpenUs);
+    ns_ = name;
+    readOnly_ = readOnly;
+    open_ = true;
+    return true;
+}
+
+void Preferences::end()
+{
+    open_ = false;
+}
+
+bool Preferences::clear()
+{
+    if (!open_ || readOnly_) return false;
+    simAdvance(simCosts.nvsWriteUs);
+    nvsStats.commits++;
+    flash[ns_].clear();
+    return true;
+}
+
+bool Preferences::remove(const char* key)
+{
+    if (!open_ || readOnly_) return false;
+    simAdvance(simCosts.nvsWriteUs);
+    nvsStats.commits++;
+    return flash[ns_].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key)
+{
+    if (!open_) return false;
+    simAdvance(simCosts.nvsReadUs);
+    nvsStats.reads++;
+    return flash[ns_].count(key) > 0;
+}
+
+size_t Preferences::put(const char* key, const void* data, size_t len)
+{
+    if (!open_ || readOnly_ || !key) return 0;
+    simAdvance(simCosts.nvsWriteUs);
+    nvsStats.commits++;
+    nvsStats.bytesWritten += len;
+    SimHeapScope scope(false);           // flash, not the board's heap
+    keyWrites[ns_ + "/" + key]++;
+    const uint8_t* p = (const uint8_t*)data;
+    flash[ns_][key].assign(p, p + len);
+    return len;
+}
+
+bool Preferences::get(const char* key, void* data, size_t len)
+{
+    if (!open_ || !key) return false;
+    simAdvance(simCosts.nvsReadUs);
+    nvsStats.reads++;
+    auto ns = flash.find(ns_);
+    if (ns == flash.end()) return false;
+    auto it = ns->second.find(key);
+    if (it == ns->second.end() || it->second.size() != len) return false;
+    memcpy(data, it->second.data(), len);
+    return true;
+}
+
+size_t Preferences::putInt(const char* key, int32_t value)       { return put(key, &value, sizeof(value)); }
+size_t Preferences::putUInt(const char* key, uint32_t value)     { return put(key, &value, sizeof(value)); }
+size_t Preferences::putUShort(const char* key, uint16_t value)   { return put(key, &value, sizeof(value)); }
+size_t Preferences::putUChar(const char* key, uint8_t value)     { return put(key, &value, sizeof(value)); }
+size_t Preferences::putChar(const char* key, int8_t value)       { return put(key, &value, sizeof(value)); }
+size_t Preferences::putBool(const char* key, bool value)
+{
+    uint8_t v = value ? 1 : 0;
+    return put(key, &v, sizeof(v));
+}
+
+size_t Preferences::putString(const char* key, const char* value)
+{
+    return put(key, value, strlen(value) + 1) ? strlen(value) : 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len)
+{
+    return put(key, value, len);
+}
+
+int32_t Preferences::getInt(const char* key, int32_t defaultValue)
+{
+    int32_t v;
+    return get(key, &v, sizeof(v)) ? v : defaultValue;
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue)
+{
+    uint32_t v;
+    return get(key, &v, sizeof(v)) ? v : defaultValue;
+}
+
+uint16_t Preferences::getUShort(const char* key, uint16_t defaultValue)
+{
+    uint16_t v;
+    return get(key, &v, sizeof(v)) ? v : defaultValue;
+}
+
+uint8_t Preferences::getUChar(const char* key, uint8_t defaultValue)
+{
+    uint8_t v;
+    return get(key, &v, sizeof(v)) ? v : defaultValue;
+}
+
+int8_t Preferences::getChar(const char* key, int8_t defaultValue)
+{
+    int8_t v;
+    return get(key, &v, sizeof(v)) ? v : defaultValue;
+}
+
+bool Preferences::getBool(const char* key, bool defaultValue)
+{
+    uint8_t v;
+    return get(key, &v, sizeof(v)) ? v != 0 : defaultValue;
+}
+
+String Preferences::getString(const char* key, const String& defaultValue)
+{
+    size_t len = getBytesLength(key);
+    if (len == 0) return defaultValue;
+    std::vector<char> buf(len);
+    if (!get(key, buf.data(), len)) return defaultValue;
+    buf[len - 1] = '\0';
+    return String(buf.data());
+}
+
+size_t Preferences::getBytesLength(const char* key)
+{
+    if (!open_ || !key) return 0;
+    auto ns = flash.find(ns_);
+    if (ns == flash.end()) return 0;
+    auto it = ns->second.find(key);
+    return it == ns->second.end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen)
+{
+    size_t len = getBytesLength(key);
+    if (len == 0 || len > maxLen) return 0;
+    return get(key, buf, len) ? len : 0;
+}
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <string.h>
+
+#include <Arduino.h>
+#include <Update.h>
+
+#include "hal.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+UpdateClass Update;
+
+// --------------------------------------------------
+// OTA: two app slots and the bootloader's rollback
+// --------------------------------------------------
+namespace {
+
+const size_t SECTOR = 4096;
+
+struct Slot
+{
+    std::vector<uint8_t> image;
+    SimOtaImageState     state = SIM_OTA_VALID;
+};
+
+Slot slots[2];
+int bootSlot = 0;
+int runningSlot = 0;
+SimOtaStats stats;
+std::vector<uint8_t> writing;        // the image Update is receiving
+
+int otherSlot()
+{
+    return 1 - runningSlot;
+}
+
+} // namespace
+
+// Bootloader: a pending image that is booted again was never confirmed.
+void simOtaBoot()
+{
+    Slot& s = slots[bootSlot];
+    if (s.state == SIM_OTA_PENDING) {
+        s.state = SIM_OTA_ABORTED;
+        bootSlot = 1 - bootSlot;
+        stats.rollbacks++;
+    } else if (s.state == SIM_OTA_NEW) {
+        s.state = SIM_OTA_PENDING;
+    }
+    runningSlot = bootSlot;
+    stats.boots++;
+    Update.abort();
+}
+
+SimOtaStats simOtaStats()
+{
+    SimOtaStats s = stats;
+    s.running = runningSlot;
+    s.state = slots[runningSlot].state;
+    return s;
+}
+
+const std::vector<uint8_t>& simOtaImage(int slot)
+{
+    return slots[slot & 1].image;
+}
+
+void simOtaReset()
+{
+    for (Slot& s : slots) s = Slot();
+    bootSlot = runningSlot = 0;
+    stats = SimOtaStats();
+}
+
+size_t halOtaPartitionSize()
+{
+    return SIM_OTA_PARTITION_SIZE;
+}
+
+bool halOtaPending()
+{
+    return slots[runningSlot].state == SIM_OTA_PENDING;
+}
+
+void halOtaConfirm()
+{
+    Slot& s = slots[runningSlot];
+    if (s.state != SIM_OTA_PENDING) return;
+    s.state = SIM_OTA_VALID;
+    stats.confirms++;
+}
+
+void halOtaRollback()
+{
+    slots[runningSlot].state = SIM_OTA_INVALID;
+    bootSlot = otherSlot();
+    stats.rollbacks++;
+    ESP.restart();
+}
+
+// --------------------------------------------------
+// Update
+// --------------------------------------------------
+bool UpdateClass::begin(size_t size)
+{
+    if (active_) {
+        error_ = UPDATE_ERROR_ABORT;   // "already running"
+        return false;
+    }
+    error_ = UPDATE_ERROR_OK;
+    if (size != UPDATE_SIZE_UNKNOWN && size > SIM_OTA_PARTITION_SIZE) {
+        error_ = UPDATE_ERROR_SIZE;
+        return false;
+    }
+    size_ = size;
+    buffered_ = 0;
+    active_ = true;
+    writing.clear();
+    stats.begins++;
+    return true;
+}
+
+void UpdateClass::flush()
+{
+    if (!buffered_) return;
+    simAdvance(simCosts.flashEraseUs + (uint64_t)SECTOR * simCosts.flashWriteByteNs / 1000);
+    stats.sectors++;
+    buffered_ = 0;
+}
+
+size_t UpdateClass::write(uint8_t* data, size_t len)
+{
+    if (!active_ || error_) return 0;
+    if (writing.empty() && len && data[0] != 0xE9) {
+        error_ = UPDATE_ERROR_MAGIC_BYTE;
+        return 0;
+    }
+    if (writing.size() + len > (size_ != UPDATE_SIZE_UNKNOWN ? size_ : SIM_OTA_PARTITION_SIZE)) {
+        error_ = UPDATE_ERROR_SIZE;
+        return 0;
+    }
+    for (size_t done = 0; done < len;) {
+        const size_t n = std::min(len - done, SECTOR - buffered_);
+        writing.insert(writing.end(), data + done, data + done + n);
+        buffered_ += n;
+        done += n;
+        if (buffered_ == SECTOR) flush();
+    }
+    return len;
+}
+
+bool UpdateClass::end(bool evenIfRemaining)
+{
+    if (!active_) return false;
+    if (size_ != UPDATE_SIZE_UNKNOWN && writing.size() != size_ && !evenIfRemaining) {
+        error_ = UPDATE_ERROR_SIZE;
+        active_ = false;
+        writing.clear();
+        return false;
+    }
+    flush();
+    active_ = false;
+    if (error_ || writing.empty()) {
+        if (!error_) error_ = UPDATE_ERROR_ACTIVATE;
+        return false;
+    }
+    Slot& s = slots[otherSlot()];
+    s.image.swap(writing);
+    s.state = SIM_OTA_NEW;
+    bootSlot = otherSlot();
+    stats.images++;
+    return true;
+}
+
+void UpdateClass::abort()
+{
+    if (active_) {
+        stats.aborts++;
+        error_ = UPDATE_ERROR_ABORT;
+    }
+    active_ = false;
+    buffered_ = 0;
+    writing.clear();
+}
+
+void UpdateClass::printError(Print& out)
+{
+    out.printf("Update error %u\n", error_);
+}
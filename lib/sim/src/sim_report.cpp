@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <inttypes.h>
+#include <math.h>
+
+#include "sim_report.h"
+
+void SimJson::prefix(const char* key)
+{
+    if (!first_.empty()) {
+        if (!first_.back()) fputc(',', out_);
+        first_.back() = false;
+    }
+    if (key) fprintf(out_, "\"%s\":", key);
+}
+
+SimJson& SimJson::beginObject(const char* key)
+{
+    prefix(key);
+    fputc('{', out_);
+    first_.push_back(true);
+    return *this;
+}
+
+SimJson& SimJson::endObject()
+{
+    first_.pop_back();
+    fputc('}', out_);
+    if (first_.empty()) fputc('\n', out_);
+    return *this;
+}
+
+SimJson& SimJson::beginArray(const char* key)
+{
+    prefix(key);
+    fputc('[', out_);
+    first_.push_back(true);
+    return *this;
+}
+
+SimJson& SimJson::endArray()
+{
+    first_.pop_back();
+    fputc(']', out_);
+    return *this;
+}
+
+SimJson& SimJson::field(const char* key, const char* v)
+{
+    prefix(key);
+    fputc('"', out_);
+    for (const char* p = v; *p; p++) {
+        if (*p == '"' || *p == '\\') fputc('\\', out_);
+        if ((unsigned char)*p < 0x20) fprintf(out_, "\\u%04x", *p);
+        else fputc(*p, out_);
+    }
+    fputc('"', out_);
+    return *this;
+}
+
+SimJson& SimJson::field(const char* key, double v)
+{
+    prefix(key);
+    if (isfinite(v)) fprintf(out_, "%.3f", v);
+    else fputs("null", out_);
+    return *this;
+}
+
+SimJson& SimJson::field(const char* key, int64_t v)
+{
+    prefix(key);
+    fprintf(out_, "%" PRId64, v);
+    return *this;
+}
+
+SimJson& SimJson::field(const char* key, uint64_t v)
+{
+    prefix(key);
+    fprintf(out_, "%" PRIu64, v);
+    return *this;
+}
+
+SimJson& SimJson::field(const char* key, bool v)
+{
+    prefix(key);
+    fputs(v ? "true" : "false", out_);
+    return *this;
+}
+
+double simPercentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    size_t i = (size_t)ceil(p / 100.0 * (double)sorted.size());
+    if (i > 0) i--;
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+SimSummary simSummarize(std::vector<double> values)
+{
+    SimSummary s;
+    if (values.empty()) return s;
+    std::sort(values.begin(), values.end());
+    s.count = values.size();
+    s.min = values.front();
+    s.max = values.back();
+    double sum = 0;
+    for (double v : values) sum += v;
+    s.mean = sum / (double)values.size();
+    s.p50 = simPercentile(values, 50);
+    s.p90 = simPercentile(values, 90);
+    s.p99 = simPercentile(values, 99);
+    return s;
+}
+
+void simWriteSummary(SimJson& json, const char* key, const SimSummary& s)
+{
+    json.beginObject(key)
+        .field("count", (uint64_t)s.count)
+        .field("min", s.min)
+        .field("mean", s.mean)
+        .field("p50", s.p50)
+        .field("p90", s.p90)
+        .field("p99", s.p99)
+        .field("max", s.max)
+        .endObject();
+}
+
+void simPrintSummary(const char* label, const char* unit, const SimSummary& s)
+{
+    printf("  %-14s n=%-6zu min=%.1f p50=%.1f p90=%.1f p99=%.1f max=%.1f %s\n",
+           label, s.count, s.min, s.p50, s.p90, s.p99, s.max, unit);
+}
+
+bool simCheck(bool ok, const char* what, int* failures)
+{
+    printf("  [%s] %s\n", ok ? "ok" : "FAIL", what);
+    if (!ok) (*failures)++;
+    return ok;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+struct SimOptions
+{
+    std::string out;             // JSON report path, empty = none
+    uint32_t    seed = 1;
+    uint32_t    count = 0;       // scenario-specific size, 0 = default
+};
+
+// Each scenario returns the process exit code: 0 pass, 1 failed check.
+int scenarioLatency(const SimOptions& opt);
+int scenarioJournal(const SimOptions& opt);
+int scenarioEvents(const SimOptions& opt);
+int scenarioHttpLoad(const SimOptions& opt);
+int scenarioWifi(const SimOptions& opt);
+int scenarioMqtt(const SimOptions& opt);
+int scenarioRelayTask(const SimOptions& opt);
+int scenarioMetrics(const SimOptions& opt);
+int scenarioWebUi(const SimOptions& opt);
+int scenarioSchedule(const SimOptions& opt);
+int scenarioOutputs(const SimOptions& opt);
+int scenarioBand(const SimOptions& opt);
+int scenarioPtt(const SimOptions& opt);
+int scenarioOta(const SimOptions& opt);
+int scenarioOutbox(const SimOptions& opt);
+int scenarioFleet(const SimOptions& opt);
+int scenarioUdp(const SimOptions& opt);
+int scenarioConfig(const SimOptions& opt);
+int scenarioBoot(const SimOptions& opt);
+int scenarioLog(const SimOptions& opt);
+int scenarioSwr(const SimOptions& opt);
+int scenarioSoak(const SimOptions& opt);
+int scenarioArbiter(const SimOptions& opt);
+int scenarioBeacon(const SimOptions& opt);
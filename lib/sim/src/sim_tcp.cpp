@@ -0,0 +1,601 @@
+#include <algorithm>
+#include <deque>
+#include <map>
+
+#include <Arduino.h>
+
+#include "hal.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+// --------------------------------------------------
+// TCP: device sockets (hal.h) and their simulated peers
+// --------------------------------------------------
+namespace {
+
+struct Conn
+{
+    bool deviceClosed = false;   // device called close, or reset on reboot
+    bool peerClosed = false;     // the peer's FIN has reached the device
+    bool peerSawClose = false;   // the device's FIN/RST has reached the peer
+    bool peerGone = false;       // peer called close
+    bool reading = true;
+    int connectState = 1;        // device-initiated: 0 until the handshake is over, -1 refused
+    std::string rx;              // arrived at the device, not read yet
+    std::string stream;          // peer data streamed against the window, not sent yet
+    size_t toDevice = 0;         // streamed, on its way to the device
+    bool pumpArmed = false;
+    size_t inFlight = 0;         // sent by the device, not consumed by the peer
+    uint64_t firstReadUs = 0;
+    std::vector<SimTcpSegment> received;
+    std::function<void(const std::string&)> onReceive;
+    std::function<void()> onClose;
+};
+
+struct Listener
+{
+    uint16_t port;
+    std::deque<int> pending;
+};
+
+const size_t MSS = 1436;
+
+int nextId = 3;
+uint64_t airFreeUs = 0;          // the radio carries one segment at a time
+std::map<int, Conn> conns;
+std::map<int, Listener> listeners;
+std::map<uint16_t, std::function<void(int)>> servers;   // peer side, by port
+SimTcpStats stats;
+
+// UDP: the device's one listener and what it sent to the scenario
+uint16_t udpPort = 0;            // 0 = not listening
+HalUdpFn udpFn = nullptr;
+uint32_t udpBoot = 0;            // datagrams in flight across a reboot are lost
+std::vector<SimUdpDatagram> udpReceived;
+std::function<void(const SimUdpDatagram&)> udpOnReceive;
+
+Listener* listenerOn(uint16_t port)
+{
+    for (auto& kv : listeners) {
+        if (kv.second.port == port) return &kv.second;
+    }
+    return nullptr;
+}
+
+void busy(uint64_t us)
+{
+    stats.busyUs += us;
+    simAdvance(us);
+}
+
+uint64_t byteCost(size_t n)
+{
+    return (uint64_t)n * simCosts.tcpByteNs / 1000;
+}
+
+// The device's close reaches the peer one latency later.
+void notifyPeerClosed(int id)
+{
+    simAt(simNow() + simCosts.tcpLatencyUs, [id] {
+        Conn& c = conns[id];
+        if (c.peerSawClose) return;
+        c.peerSawClose = true;
+        if (c.onClose) c.onClose();
+    });
+}
+
+// Sends what the device's receive window takes, one segment after the
+// other over the air; the rest waits for the device to read.
+void pump(int id)
+{
+    Conn& c = conns[id];
+    c.pumpArmed = false;
+    while (!c.stream.empty() && !c.deviceClosed) {
+        const size_t unread = c.rx.size() + c.toDevice;
+        const size_t seg = std::min(MSS, c.stream.size());
+        if (unread + seg > simCosts.tcpRecvWindow) return;
+
+        airFreeUs = std::max(airFreeUs, simNow()) + (uint64_t)seg * simCosts.wifiByteNs / 1000;
+        std::string data = c.stream.substr(0, seg);
+        c.stream.erase(0, seg);
+        c.toDevice += seg;
+        simAt(airFreeUs + simCosts.tcpLatencyUs, [id, data] {
+            Conn& c = conns[id];
+            c.toDevice -= data.size();
+            if (!c.deviceClosed) c.rx += data;
+        });
+    }
+}
+
+// The window update reaches the peer one latency after the device read.
+void windowOpened(int id)
+{
+    Conn& c = conns[id];
+    if (c.stream.empty() || c.pumpArmed) return;
+    c.pumpArmed = true;
+    simAt(simNow() + simCosts.tcpLatencyUs, [id] { pump(id); });
+}
+
+bool readable(int id)
+{
+    auto l = listeners.find(id);
+    if (l != listeners.end()) return !l->second.pending.empty();
+    auto c = conns.find(id);
+    return c != conns.end() && !c->second.deviceClosed && (!c->second.rx.empty() || c->second.peerClosed);
+}
+
+} // namespace
+
+void simTcpReset()
+{
+    for (auto& kv : conns) {
+        if (kv.second.deviceClosed) continue;
+        kv.second.deviceClosed = true;
+        notifyPeerClosed(kv.first);
+    }
+    listeners.clear();
+    udpPort = 0;
+    udpFn = nullptr;
+    udpBoot++;
+}
+
+int halTcpListen(uint16_t port, int backlog)
+{
+    (void)backlog;                       // the simulated backlog is unbounded
+    if (listenerOn(port)) return -1;
+    const int id = nextId++;
+    listeners[id] = Listener{port, {}};
+    return id;
+}
+
+int halTcpAccept(int listener)
+{
+    busy(simCosts.tcpCallUs);
+    auto l = listeners.find(listener);
+    if (l == listeners.end() || l->second.pending.empty()) return -1;
+
+    const int id = l->second.pending.front();
+    l->second.pending.pop_front();
+    busy(simCosts.tcpAcceptUs);
+    stats.accepted++;
+    return id;
+}
+
+int halTcpRecv(int sock, void* buf, size_t len)
+{
+    busy(simCosts.tcpCallUs);
+    auto it = conns.find(sock);
+    if (it == conns.end() || it->second.deviceClosed) return -1;
+    Conn& c = it->second;
+
+    if (c.rx.empty()) return c.peerClosed ? -1 : 0;
+
+    const size_t n = std::min(len, c.rx.size());
+    memcpy(buf, c.rx.data(), n);
+    c.rx.erase(0, n);
+    if (!c.firstReadUs) c.firstReadUs = simNow();
+    stats.bytesIn += n;
+    windowOpened(sock);
+    busy(byteCost(n));
+    return (int)n;
+}
+
+int halTcpSend(int sock, const void* buf, size_t len)
+{
+    busy(simCosts.tcpCallUs);
+    auto it = conns.find(sock);
+    if (it == conns.end() || it->second.deviceClosed || it->second.peerGone) return -1;
+    Conn& c = it->second;
+
+    const size_t room = simCosts.tcpSendBuffer > c.inFlight ? simCosts.tcpSendBuffer - c.inFlight : 0;
+    const size_t n = std::min(len, room);
+    if (n == 0) return 0;
+
+    c.inFlight += n;
+    stats.bytesOut += n;
+    busy(byteCost(n));
+
+    // The segment copy stands in for lwIP's pbufs, not the firmware's heap.
+    SimHeapScope scope(false);
+    std::string data((const char*)buf, n);
+    simAt(simNow() + simCosts.tcpLatencyUs, [sock, data] {
+        Conn& c = conns[sock];
+        if (c.peerGone) return;
+        c.received.push_back(SimTcpSegment{simNow(), data});
+        if (!c.reading) return;
+        c.inFlight -= data.size();
+        if (c.onReceive) c.onReceive(data);
+    });
+    return (int)n;
+}
+
+void halTcpClose(int sock)
+{
+    if (listeners.erase(sock)) return;
+    auto it = conns.find(sock);
+    if (it == conns.end() || it->second.deviceClosed) return;
+    busy(simCosts.tcpCallUs);
+    it->second.deviceClosed = true;
+    notifyPeerClosed(sock);
+}
+
+int halTcpConnect(uint32_t ip, uint16_t port)
+{
+    (void)ip;                            // every address reaches the peer serving port
+    busy(simCosts.tcpCallUs);
+    const int id = nextId++;
+    conns[id] = Conn();
+    conns[id].connectState = 0;
+
+    // SYN to the peer, then its answer back.
+    simAt(simNow() + simCosts.tcpLatencyUs, [id, port] {
+        auto server = servers.find(port);
+        const bool accepted = server != servers.end() && !conns[id].deviceClosed;
+        if (accepted) server->second(id);
+        simAt(simNow() + simCosts.tcpLatencyUs, [id, accepted] {
+            Conn& c = conns[id];
+            if (accepted) {
+                c.connectState = 1;
+            } else {
+                c.connectState = -1;
+                c.peerGone = true;
+                c.peerClosed = true;
+            }
+        });
+    });
+    return id;
+}
+
+int halTcpConnectState(int sock)
+{
+    busy(simCosts.tcpCallUs);
+    auto it = conns.find(sock);
+    if (it == conns.end() || it->second.deviceClosed) return -1;
+    return it->second.connectState;
+}
+
+void halTcpWait(const int* socks, int count, uint32_t timeoutUs, bool* ready)
+{
+    busy(simCosts.tcpCallUs);
+    const uint64_t deadline = simNow() + timeoutUs;
+    for (;;) {
+        bool any = false;
+        for (int i = 0; i < count; i++) {
+            ready[i] = readable(socks[i]);
+            any = any || ready[i];
+        }
+        if (any || simNow() >= deadline) return;
+        simAdvance(std::min(simNextEventUs(), deadline) - simNow());
+    }
+}
+
+// --------------------------------------------------
+// Peer side
+// --------------------------------------------------
+int simTcpConnect(uint16_t port)
+{
+    if (!listenerOn(port)) return -1;
+    const int id = nextId++;
+    conns[id] = Conn();
+    simAt(simNow() + simCosts.tcpLatencyUs, [id, port] {
+        Listener* l = listenerOn(port);
+        Conn& c = conns[id];
+        if (c.peerGone) return;
+        if (l) {
+            l->pending.push_back(id);
+        } else {
+            c.deviceClosed = true;       // refused
+            notifyPeerClosed(id);
+        }
+    });
+    return id;
+}
+
+void simTcpServe(uint16_t port, std::function<void(int conn)> onAccept)
+{
+    if (onAccept) servers[port] = onAccept;
+    else servers.erase(port);
+}
+
+void simTcpSend(int conn, const std::string& data)
+{
+    simAt(simNow() + simCosts.tcpLatencyUs, [conn, data] {
+        Conn& c = conns[conn];
+        if (!c.deviceClosed) c.rx += data;
+    });
+}
+
+void simTcpStream(int conn, const std::string& data)
+{
+    Conn& c = conns[conn];
+    c.stream += data;
+    if (c.pumpArmed) return;
+    c.pumpArmed = true;
+    simAt(simNow(), [conn] { pump(conn); });
+}
+
+void simTcpClose(int conn)
+{
+    Conn& c = conns[conn];
+    if (c.peerGone) return;
+    c.peerGone = true;
+    simAt(simNow() + simCosts.tcpLatencyUs, [conn] { conns[conn].peerClosed = true; });
+}
+
+void simTcpOnReceive(int conn, std::function<void(const std::string&)> fn)
+{
+    conns[conn].onReceive = fn;
+}
+
+void simTcpOnClose(int conn, std::function<void()> fn)
+{
+    conns[conn].onClose = fn;
+}
+
+void simTcpSetReading(int conn, bool reading)
+{
+    Conn& c = conns[conn];
+    c.reading = reading;
+    if (reading) c.inFlight = 0;
+}
+
+bool simTcpOpen(int conn)
+{
+    auto it = conns.find(conn);
+    return it != conns.end() && !it->second.peerSawClose && !it->second.peerGone;
+}
+
+const std::vector<SimTcpSegment>& simTcpReceived(int conn)
+{
+    return conns[conn].received;
+}
+
+void simTcpDropRecords()
+{
+    for (auto& kv : conns) {
+        kv.second.received.clear();
+        kv.second.received.shrink_to_fit();
+    }
+}
+
+const SimTcpStats& simTcpStats()
+{
+    return stats;
+}
+
+void simTcpResetStats()
+{
+    stats = SimTcpStats();
+}
+
+// --------------------------------------------------
+// UDP: a datagram takes simCosts.tcpLatencyUs each way; on the device
+// the receive task wakes and reads it before the handler runs.
+// --------------------------------------------------
+bool halUdpListen(uint16_t port, HalUdpFn fn, int core, int priority)
+{
+    (void)core;
+    (void)priority;
+    if (udpPort) return false;
+    udpPort = port;
+    udpFn = fn;
+    return true;
+}
+
+bool halUdpSend(uint32_t ip, uint16_t port, const void* data, size_t len)
+{
+    (void)ip;                            // everything goes to the scenario
+    if (!udpPort) return false;
+    const uint64_t sendUs = simCosts.tcpCallUs + byteCost(len);
+    stats.busyUs += sendUs;
+    SimUdpDatagram d{simNow() + sendUs + simCosts.tcpLatencyUs, port, std::string((const char*)data, len), 0};
+    simAt(d.atUs, [d] {
+        udpReceived.push_back(d);
+        if (udpOnReceive) udpOnReceive(d);
+    });
+    return true;
+}
+
+bool halUdpMulticast(uint32_t group, uint16_t port, const void* data, size_t len)
+{
+    const uint64_t sendUs = simCosts.tcpCallUs + byteCost(len);
+    stats.busyUs += sendUs;
+    SimUdpDatagram d{simNow() + sendUs + simCosts.tcpLatencyUs, port, std::string((const char*)data, len), group};
+    simAt(d.atUs, [d] {
+        udpReceived.push_back(d);
+        if (udpOnReceive) udpOnReceive(d);
+    });
+    return true;
+}
+
+void simUdpSend(uint16_t port, const std::string& data, uint16_t fromPort)
+{
+    const uint32_t boot = udpBoot;
+    const uint64_t readUs = simCosts.taskWakeUs + simCosts.tcpCallUs + byteCost(data.size());
+    simAt(simNow() + simCosts.tcpLatencyUs + readUs, [port, data, fromPort, boot, readUs] {
+        if (boot != udpBoot || port != udpPort) return;          // nothing listening: dropped
+        stats.busyUs += readUs;
+        const size_t len = std::min(data.size(), HAL_UDP_MAX);
+        std::vector<uint8_t> buf(data.begin(), data.begin() + len);
+        SimHeapScope scope(true);
+        udpFn(buf.data(), len, SIM_UDP_HOST_IP, fromPort);
+    });
+}
+
+void simUdpOnReceive(std::function<void(const SimUdpDatagram&)> fn)
+{
+    udpOnReceive = fn;
+}
+
+const std::vector<SimUdpDatagram>& simUdpReceived()
+{
+    return udpReceived;
+}
+
+// --------------------------------------------------
+// HTTP client
+// --------------------------------------------------
+namespace {
+
+uint32_t nextHttpId = 1;
+std::map<uint32_t, SimHttpRequest> httpRequests;
+
+const char* methodName(HTTPMethod m)
+{
+    switch (m) {
+    case HTTP_POST:    return "POST";
+    case HTTP_HEAD:    return "HEAD";
+    case HTTP_PUT:     return "PUT";
+    case HTTP_PATCH:   return "PATCH";
+    case HTTP_DELETE:  return "DELETE";
+    case HTTP_OPTIONS: return "OPTIONS";
+    default:           return "GET";
+    }
+}
+
+void finishResponse(SimHttpRequest& r)
+{
+    r.respondedUs = simNow();
+    simTcpClose(r.conn);
+}
+
+void parseResponse(SimHttpRequest& r)
+{
+    if (r.code == 0) {
+        const size_t end = r.raw.find("\r\n\r\n");
+        if (end == std::string::npos) return;
+
+        r.code = atoi(r.raw.c_str() + r.raw.find(' ') + 1);
+        size_t pos = r.raw.find("\r\n") + 2;
+        while (pos < end) {
+            const size_t eol = r.raw.find("\r\n", pos);
+            const size_t colon = r.raw.find(':', pos);
+            if (colon < eol) {
+                std::string name = r.raw.substr(pos, colon - pos);
+                std::string value = r.raw.substr(colon + 1, eol - colon - 1);
+                value.erase(0, value.find_first_not_of(' '));
+                if (name == "Content-Length") r.contentLength = strtoul(value.c_str(), nullptr, 10);
+                else if (name == "Content-Type") r.contentType = value;
+                else r.headers.emplace_back(name, value);
+                if (name == "Transfer-Encoding" && value == "chunked") r.chunked = true;
+            }
+            pos = eol + 2;
+        }
+        r.raw.erase(0, end + 4);
+        if (r.method == HTTP_HEAD || r.code == 204 || r.code == 304) {
+            r.contentLength = 0;
+            r.chunked = false;
+        }
+    }
+    // No length: an event stream, which the scenario reads as segments.
+    if (r.contentType == "text/event-stream") {
+        r.raw.clear();
+        return;
+    }
+    if (r.respondedUs) return;
+    if (r.chunked) {
+        // Whole chunks only; the zero-size one ends the body.
+        for (;;) {
+            const size_t eol = r.raw.find("\r\n");
+            if (eol == std::string::npos) return;
+            const size_t size = strtoul(r.raw.c_str(), nullptr, 16);
+            if (r.raw.size() < eol + 2 + size + 2) return;
+            r.response.append(r.raw, eol + 2, size);
+            r.raw.erase(0, eol + 2 + size + 2);
+            r.chunks++;
+            if (size == 0) {
+                finishResponse(r);
+                return;
+            }
+        }
+    }
+    if (r.raw.size() >= r.contentLength) {
+        r.response = r.raw.substr(0, r.contentLength);
+        r.raw.clear();
+        finishResponse(r);
+    }
+}
+
+uint32_t startRequest(HTTPMethod method, const std::string& uri, const std::string& headers,
+                      const std::string& body, bool streamed = false)
+{
+    SimHttpRequest req;
+    req.id = nextHttpId++;
+    req.method = method;
+    req.uri = uri;
+    req.queuedUs = simNow();
+    req.conn = simTcpConnect(80);
+    const uint32_t id = req.id;
+    httpRequests[id] = req;
+
+    if (req.conn < 0) {
+        httpRequests[id].code = -1;
+        return id;
+    }
+
+    simTcpOnReceive(req.conn, [id](const std::string& data) {
+        SimHttpRequest& r = httpRequests[id];
+        r.raw += data;
+        parseResponse(r);
+    });
+    simTcpOnClose(req.conn, [id] {
+        SimHttpRequest& r = httpRequests[id];
+        if (r.code == 0) r.code = -1;
+    });
+
+    std::string msg = std::string(methodName(method)) + " " + uri + " HTTP/1.1\r\n"
+                      "Host: flexpilot-switch.local\r\n"
+                      "Connection: close\r\n" + headers;
+    if (!body.empty()) msg += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    msg += "\r\n";
+    if (!streamed) {
+        simTcpSend(req.conn, msg + body);
+        return id;
+    }
+    // Headers with the handshake, the body once the connection is up
+    simTcpSend(req.conn, msg);
+    const int conn = req.conn;
+    simAt(simNow() + 2 * simCosts.tcpLatencyUs, [conn, body] { simTcpStream(conn, body); });
+    return id;
+}
+
+} // namespace
+
+uint32_t simHttpRequest(HTTPMethod method, const std::string& uri, const std::string& body,
+                        const std::string& headers)
+{
+    // A body is a form unless the caller names another type.
+    const bool form = !body.empty() && headers.find("Content-Type:") == std::string::npos;
+    return startRequest(method, uri, headers + (form ? "Content-Type: application/x-www-form-urlencoded\r\n" : ""),
+                        body);
+}
+
+uint32_t simHttpUpload(const std::string& uri, const std::string& filename, const std::vector<uint8_t>& data)
+{
+    const std::string boundary = "----SimFormBoundary7MA4YWxkTrZu0gW";
+    std::string body = "--" + boundary + "\r\n"
+                       "Content-Disposition: form-data; name=\"firmware\"; filename=\"" + filename + "\"\r\n"
+                       "Content-Type: application/octet-stream\r\n\r\n";
+    body.append(data.begin(), data.end());
+    body += "\r\n--" + boundary + "--\r\n";
+    return startRequest(HTTP_POST, uri, "Content-Type: multipart/form-data; boundary=" + boundary + "\r\n", body,
+                        true);
+}
+
+const SimHttpRequest* simHttpResult(uint32_t id)
+{
+    auto it = httpRequests.find(id);
+    if (it == httpRequests.end()) return nullptr;
+    SimHttpRequest& r = it->second;
+    if (r.conn >= 0) r.startedUs = conns[r.conn].firstReadUs;
+    return &r;
+}
+
+size_t simHttpPending()
+{
+    size_t n = 0;
+    for (const auto& kv : httpRequests) {
+        if (kv.second.code == 0) n++;
+    }
+    return n;
+}
@@ -0,0 +1,331 @@
+#include <Preferences.h>
+#include <string.h>
+
+#include "band_decoder.h"
+#include "hal.h"
+#include "outputs.h"
+#include "relay_task.h"
+
+namespace {
+
+const char     BLOB_KEY[]   = "bandplan";
+const uint8_t  BLOB_VERSION = 1;
+const size_t   BLOB_MAX     = 4 + BAND_MAX * 12;
+
+// loop() only
+BandPlan plan = {};
+BandDecoderStats stats = {};
+
+// --------------------------------------------------
+// NVS blob: version, bands, 0, 0; per band LE32 lowHz, highHz, outputs
+// --------------------------------------------------
+void putLe32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+uint32_t getLe32(const uint8_t* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+size_t encode(const BandPlan& p, uint8_t* b)
+{
+    b[0] = BLOB_VERSION;
+    b[1] = p.bands;
+    b[2] = 0;
+    b[3] = 0;
+    size_t n = 4;
+    for (int i = 0; i < p.bands; i++, n += 12) {
+        putLe32(b + n, p.band[i].lowHz);
+        putLe32(b + n + 4, p.band[i].highHz);
+        putLe32(b + n + 8, p.band[i].outputs);
+    }
+    return n;
+}
+
+bool decode(const uint8_t* b, size_t len, BandPlan* p)
+{
+    *p = BandPlan{};
+    if (len < 4 || b[0] != BLOB_VERSION || b[1] > BAND_MAX || len != 4 + b[1] * 12u) return false;
+    for (int i = 0; i < b[1]; i++) {
+        Band& band = p->band[i];
+        band.lowHz = getLe32(b + 4 + i * 12);
+        band.highHz = getLe32(b + 8 + i * 12);
+        band.outputs = getLe32(b + 12 + i * 12);
+        if (band.lowHz > band.highHz || (i > 0 && band.lowHz <= p->band[i - 1].highHz)) return false;
+    }
+    p->bands = b[1];
+    return true;
+}
+
+// --------------------------------------------------
+// Decoding
+// --------------------------------------------------
+bool withinHysteresis(const Band& b, uint32_t hz)
+{
+    const uint32_t h = stats.hysteresisHz;
+    return hz >= (b.lowHz > h ? b.lowHz - h : 0) && (uint64_t)hz <= (uint64_t)b.highHz + h;
+}
+
+void decodeFrequency(uint32_t hz, uint64_t arrivedUs)
+{
+    // Most updates are tuning inside the band in use: one comparison.
+    if (stats.band >= 0 && withinHysteresis(plan.band[stats.band], hz)) {
+        const Band& b = plan.band[stats.band];
+        if (hz < b.lowHz || hz > b.highHz) stats.held++;
+        return;
+    }
+
+    int probes;
+    const int i = bandPlanFind(plan, hz, &probes);
+    stats.lookups++;
+    if (probes > stats.maxProbes) stats.maxProbes = (uint8_t)probes;
+    if (i < 0) {
+        stats.unmapped++;
+        return;
+    }
+
+    RelayPostResult r;
+    if (!relayPostOutputs(plan.band[i].outputs, RELAY_SRC_BAND, arrivedUs, &r)) {
+        if (r.verdict == RELAY_BUSY) {
+            stats.dropped++; // the band stays unapplied; the next update retries
+            return;
+        }
+        stats.refused++;     // locked or outranked: the operator's choice stands for this band
+    } else {
+        stats.changes++;
+    }
+    stats.band = (int8_t)i;
+}
+
+// --------------------------------------------------
+// Text
+// --------------------------------------------------
+struct Token
+{
+    const char* s;
+    size_t n;
+};
+
+bool fail(char* error, size_t size, int line, const char* what, Token t = Token{nullptr, 0})
+{
+    if (t.s) snprintf(error, size, "line %d: %s '%.*s'", line, what, (int)t.n, t.s);
+    else snprintf(error, size, "line %d: %s", line, what);
+    return false;
+}
+
+void writeFrequency(TextBuffer& out, uint32_t hz)
+{
+    if (hz % 1000 == 0) out.printf("%luk", (unsigned long)(hz / 1000));
+    else out.printf("%lu", (unsigned long)hz);
+}
+
+} // namespace
+
+bool bandParseFrequency(const char* s, size_t n, uint32_t* hz)
+{
+    uint64_t whole = 0, frac = 0, fracScale = 1;
+    size_t i = 0, digits = 0;
+    for (; i < n && s[i] >= '0' && s[i] <= '9'; i++, digits++) {
+        whole = whole * 10 + (s[i] - '0');
+        if (whole > 0xffffffffu) return false;
+    }
+    bool dot = false;
+    if (i < n && s[i] == '.') {
+        dot = true;
+        for (i++; i < n && s[i] >= '0' && s[i] <= '9'; i++, digits++) {
+            if (fracScale >= 1000000000) continue;    // finer than 1 Hz
+            frac = frac * 10 + (s[i] - '0');
+            fracScale *= 10;
+        }
+    }
+    if (digits == 0) return false;
+
+    uint64_t scale = dot ? 1000000 : 1;
+    if (i < n && (s[i] == 'k' || s[i] == 'K')) {
+        scale = 1000;
+        i++;
+    } else if (i < n && s[i] == 'M') {
+        scale = 1000000;
+        i++;
+    }
+    if (i != n) return false;
+
+    const uint64_t v = whole * scale + frac * scale / fracScale;
+    if (v > 0xffffffffu) return false;
+    *hz = (uint32_t)v;
+    return true;
+}
+
+int bandPlanFind(const BandPlan& p, uint32_t hz, int* probes)
+{
+    // First band starting above hz; the one before it may hold hz.
+    int lo = 0, hi = p.bands, n = 0;
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        n++;
+        if (p.band[mid].lowHz <= hz) lo = mid + 1;
+        else hi = mid;
+    }
+    if (probes) *probes = n;
+    return lo > 0 && hz <= p.band[lo - 1].highHz ? lo - 1 : -1;
+}
+
+bool bandPlanParse(const char* text, size_t len, BandPlan* out, char* error, size_t errorSize)
+{
+    const int TOKENS_MAX = 2;
+    int lineOf[BAND_MAX];
+    BandPlan p = {};
+    const char* q = text;
+    const char* end = text + len;
+    int line = 1;
+
+    if (len > BAND_TEXT_MAX) {
+        snprintf(error, errorSize, "band plan longer than %u bytes", (unsigned)BAND_TEXT_MAX);
+        return false;
+    }
+
+    while (q < end) {
+        // One statement: up to ';', a newline or a comment
+        Token tok[TOKENS_MAX];
+        int count = 0;
+        while (q < end && *q != ';' && *q != '\n' && *q != '#') {
+            if (*q == ' ' || *q == '\t' || *q == '\r') {
+                q++;
+                continue;
+            }
+            const char* start = q;
+            while (q < end && *q != ';' && *q != '\n' && *q != '#' && *q != ' ' && *q != '\t' && *q != '\r') q++;
+            if (count == TOKENS_MAX) return fail(error, errorSize, line, "expected: <from>-<to> <selection>");
+            tok[count++] = Token{start, (size_t)(q - start)};
+        }
+        if (q < end && *q == '#') {
+            while (q < end && *q != '\n') q++;
+        }
+        const int stmtLine = line;
+        if (q < end && *q == '\n') line++;
+        q++;
+        if (count == 0) continue;
+        if (count != 2) return fail(error, errorSize, stmtLine, "expected: <from>-<to> <selection>");
+        if (p.bands == BAND_MAX) return fail(error, errorSize, stmtLine, "too many bands");
+
+        // Insert in order of the lower edge
+        Band b;
+        const Token r = tok[0];
+        const char* dash = (const char*)memchr(r.s, '-', r.n);
+        if (!dash || !bandParseFrequency(r.s, dash - r.s, &b.lowHz) ||
+            !bandParseFrequency(dash + 1, r.n - (dash + 1 - r.s), &b.highHz) || b.lowHz > b.highHz) {
+            return fail(error, errorSize, stmtLine, "bad range", r);
+        }
+        if (!outputsParseSelection(tok[1].s, tok[1].n, outputCount(), &b.outputs)) {
+            return fail(error, errorSize, stmtLine, "bad selection", tok[1]);
+        }
+        int i = p.bands;
+        for (; i > 0 && p.band[i - 1].lowHz > b.lowHz; i--) {
+            p.band[i] = p.band[i - 1];
+            lineOf[i] = lineOf[i - 1];
+        }
+        p.band[i] = b;
+        lineOf[i] = stmtLine;
+        p.bands++;
+    }
+
+    for (int i = 1; i < p.bands; i++) {
+        if (p.band[i].lowHz <= p.band[i - 1].highHz) {
+            const int later = lineOf[i] > lineOf[i - 1] ? lineOf[i] : lineOf[i - 1];
+            return fail(error, errorSize, later, "overlaps another band");
+        }
+    }
+    *out = p;
+    return true;
+}
+
+bool bandPlanFormat(const BandPlan& p, uint32_t line, TextBuffer& out)
+{
+    if (line >= p.bands) return false;
+    const Band& band = p.band[line];
+    char buf[OUTPUT_SELECTION_MAX];
+    outputsFormatSelection(band.outputs, buf, sizeof(buf));
+    writeFrequency(out, band.lowHz);
+    out.add("-");
+    writeFrequency(out, band.highHz);
+    out.printf(" %s\n", buf);
+    return true;
+}
+
+void bandDecoderBegin(uint32_t hysteresisHz)
+{
+    uint8_t blob[BLOB_MAX];
+    size_t len = 0;
+    Preferences nvs;
+    if (nvs.begin("antSwitch", true)) {
+        len = nvs.getBytesLength(BLOB_KEY);
+        if (len > sizeof(blob) || nvs.getBytes(BLOB_KEY, blob, len) != len) len = 0;
+        nvs.end();
+    }
+
+    if (len && !decode(blob, len, &plan)) {
+        Serial.println("Band plan in NVS is not valid, ignored");
+        len = 0;
+    }
+    if (!len) plan = BandPlan{};
+
+    stats = BandDecoderStats{};
+    stats.band = -1;
+    stats.bands = plan.bands;
+    stats.hysteresisHz = hysteresisHz;
+    stats.blobBytes = (uint32_t)len;
+    Serial.printf("Band plan: %u bands\n", plan.bands);
+}
+
+void bandDecoderSetHysteresis(uint32_t hz)
+{
+    stats.hysteresisHz = hz;
+}
+
+bool bandDecoderLoad(const BandPlan& p)
+{
+    uint8_t blob[BLOB_MAX];
+    const size_t len = encode(p, blob);
+
+    // A retained topic redelivers the same plan on every reconnect.
+    uint8_t old[BLOB_MAX];
+    if (stats.blobBytes == len && encode(plan, old) == len && !memcmp(old, blob, len)) return true;
+
+    Preferences nvs;
+    bool saved = nvs.begin("antSwitch", false);
+    if (saved) {
+        saved = nvs.putBytes(BLOB_KEY, blob, len) == len;
+        nvs.end();
+    }
+
+    plan = p;
+    stats.bands = p.bands;
+    stats.band = -1;
+    stats.blobBytes = saved ? (uint32_t)len : 0;
+
+    // The radio is still where it was; apply the new plan to it.
+    if (stats.lastHz) decodeFrequency(stats.lastHz, halMicros());
+    return saved;
+}
+
+const BandPlan& bandDecoderPlan()
+{
+    return plan;
+}
+
+void bandDecoderFrequency(uint32_t hz, uint64_t arrivedUs)
+{
+    stats.updates++;
+    stats.lastHz = hz;
+    decodeFrequency(hz, arrivedUs);
+}
+
+BandDecoderStats bandDecoderStats()
+{
+    return stats;
+}
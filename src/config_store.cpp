@@ -0,0 +1,353 @@
+#include <Preferences.h>
+#include <string.h>
+
+#include "antenna_switch.h"
+#include "band_decoder.h"
+#include "config_store.h"
+#include "hal.h"
+#include "udp_control.h"
+
+namespace {
+
+// loop() only
+uint8_t stored[CONFIG_BLOB_MAX];     // the record as in flash
+size_t storedLen = 0;
+ConfigStats stats = {};
+
+uint32_t crc32(const uint8_t* p, size_t n)
+{
+    uint32_t crc = 0xffffffff;
+    while (n--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+void defaults()
+{
+    wifiCfg.ssid      = "Livebox-C3B0";
+    wifiCfg.password  = "";
+    wifiCfg.gatewayIP = IPAddress(192, 168, 1, 1);
+    wifiCfg.staticIP  = IPAddress(0, 0, 0, 0);
+    wifiCfg.subnet    = IPAddress(255, 255, 255, 0);
+
+    mqttCfg.enabled    = true;
+    mqttCfg.broker     = "192.168.1.63";
+    mqttCfg.port       = 1883;
+    mqttCfg.user       = "";
+    mqttCfg.password   = "";
+    mqttCfg.topicCmd   = "stationpilot/antennaSwitch/cmd";
+    mqttCfg.topicState = "stationpilot/antennaSwitch/state";
+
+    relayCfg.deadTimeMs = 10;
+    relayCfg.outputMap  = OUTPUT_MAP_DEFAULT;
+    relayCfg.windowMs   = 0;
+    // Automation over the web UI and front panel; inert while windowMs is 0
+    static const uint8_t PRIORITY[RELAY_SOURCES] = {1, 1, 2, 2, 2, 2, RELAY_PRIORITY_MAX};
+    memcpy(relayCfg.priority, PRIORITY, sizeof(PRIORITY));
+
+    bandCfg.radioIP      = IPAddress(0, 0, 0, 0);
+    bandCfg.slice        = 0;
+    bandCfg.hysteresisHz = BAND_HYSTERESIS_HZ;
+
+    txCfg.pttPin       = -1;
+    txCfg.pttActiveLow = true;
+    txCfg.ampKeyPin    = -1;
+
+    udpCfg.port = UDP_CONTROL_PORT;
+    udpCfg.key  = "";
+    udpCfg.beaconGroup      = IPAddress(UDP_BEACON_GROUP);
+    udpCfg.beaconPort       = 0;
+    udpCfg.beaconHeartbeatS = UDP_BEACON_HEARTBEAT_S;
+
+    swrCfg.fwdPin     = -1;
+    swrCfg.reflPin    = -1;
+    swrCfg.tripSwr    = 300;
+    swrCfg.fullScaleW = 100;
+}
+
+// --------------------------------------------------
+// Encoding
+// --------------------------------------------------
+struct Writer
+{
+    uint8_t* b;
+    size_t n;
+
+    void u8(uint8_t v) { b[n++] = v; }
+    void u16(uint16_t v)
+    {
+        u8((uint8_t)v);
+        u8((uint8_t)(v >> 8));
+    }
+    void u32(uint32_t v)
+    {
+        u16((uint16_t)v);
+        u16((uint16_t)(v >> 16));
+    }
+    void str(const String& s)
+    {
+        const size_t len = s.length() < CONFIG_STRING_MAX ? s.length() : CONFIG_STRING_MAX;
+        u8((uint8_t)len);
+        memcpy(b + n, s.c_str(), len);
+        n += len;
+    }
+};
+
+struct Reader
+{
+    const uint8_t* b;
+    size_t len;
+    size_t n;
+    bool ok;
+
+    bool take(size_t k)
+    {
+        ok = ok && n + k <= len;
+        return ok;
+    }
+    uint8_t u8() { return take(1) ? b[n++] : 0; }
+    uint16_t u16()
+    {
+        const uint16_t lo = u8();
+        return lo | (uint16_t)(u8() << 8);
+    }
+    uint32_t u32()
+    {
+        const uint32_t lo = u16();
+        return lo | (uint32_t)u16() << 16;
+    }
+    String str()
+    {
+        const size_t k = u8();
+        if (k > CONFIG_STRING_MAX || !take(k)) {
+            ok = false;
+            return String();
+        }
+        String s;
+        s.reserve(k);
+        for (size_t i = 0; i < k; i++) s += (char)b[n + i];
+        n += k;
+        return s;
+    }
+};
+
+size_t encode(uint8_t* b)
+{
+    Writer w = {b, CONFIG_HEADER};
+    w.str(wifiCfg.ssid);
+    w.str(wifiCfg.password);
+    w.u32((uint32_t)wifiCfg.gatewayIP);
+
+    w.u8(mqttCfg.enabled ? 1 : 0);
+    w.str(mqttCfg.broker);
+    w.u16(mqttCfg.port);
+    w.str(mqttCfg.user);
+    w.str(mqttCfg.password);
+    w.str(mqttCfg.topicCmd);
+    w.str(mqttCfg.topicState);
+
+    w.u16(relayCfg.deadTimeMs);
+    w.str(relayCfg.outputMap);
+
+    w.u32((uint32_t)bandCfg.radioIP);
+    w.u8(bandCfg.slice);
+    w.u32(bandCfg.hysteresisHz);
+
+    w.u8((uint8_t)txCfg.pttPin);
+    w.u8(txCfg.pttActiveLow ? 1 : 0);
+    w.u8((uint8_t)txCfg.ampKeyPin);
+
+    w.u16(udpCfg.port);
+    w.str(udpCfg.key);
+
+    w.u32((uint32_t)wifiCfg.staticIP);
+    w.u32((uint32_t)wifiCfg.subnet);
+
+    w.u8((uint8_t)swrCfg.fwdPin);
+    w.u8((uint8_t)swrCfg.reflPin);
+    w.u16(swrCfg.tripSwr);
+    w.u16(swrCfg.fullScaleW);
+
+    w.u16(relayCfg.windowMs);
+    for (int i = 0; i < RELAY_SRC_SWR; i++) w.u8(relayCfg.priority[i]);
+
+    w.u32((uint32_t)udpCfg.beaconGroup);
+    w.u16(udpCfg.beaconPort);
+    w.u16(udpCfg.beaconHeartbeatS);
+
+    const size_t payload = w.n - CONFIG_HEADER;
+    const uint32_t crc = crc32(b + CONFIG_HEADER, payload);
+    w.n = 0;
+    w.u8('C');
+    w.u8(CONFIG_VERSION);
+    w.u16((uint16_t)payload);
+    w.u32(crc);
+    return CONFIG_HEADER + payload;
+}
+
+// Into the globals, which hold the defaults; false leaves them partly set.
+bool decode(const uint8_t* b, size_t len)
+{
+    Reader h = {b, len, 0, true};
+    const uint8_t magic = h.u8(), version = h.u8();
+    const uint16_t payload = h.u16();
+    const uint32_t crc = h.u32();
+    if (!h.ok || magic != 'C' || version < 1 || CONFIG_HEADER + payload != len ||
+        crc32(b + CONFIG_HEADER, payload) != crc) {
+        return false;
+    }
+
+    // Version 1
+    Reader r = {b, len, CONFIG_HEADER, true};
+    wifiCfg.ssid      = r.str();
+    wifiCfg.password  = r.str();
+    wifiCfg.gatewayIP = IPAddress(r.u32());
+
+    mqttCfg.enabled    = r.u8() != 0;
+    mqttCfg.broker     = r.str();
+    mqttCfg.port       = r.u16();
+    mqttCfg.user       = r.str();
+    mqttCfg.password   = r.str();
+    mqttCfg.topicCmd   = r.str();
+    mqttCfg.topicState = r.str();
+
+    relayCfg.deadTimeMs = r.u16();
+    relayCfg.outputMap  = r.str();
+
+    bandCfg.radioIP      = IPAddress(r.u32());
+    bandCfg.slice        = r.u8();
+    bandCfg.hysteresisHz = r.u32();
+
+    txCfg.pttPin       = (int8_t)r.u8();
+    txCfg.pttActiveLow = r.u8() != 0;
+    txCfg.ampKeyPin    = (int8_t)r.u8();
+
+    udpCfg.port = r.u16();
+    udpCfg.key  = r.str();
+
+    if (version >= 2) {
+        wifiCfg.staticIP = IPAddress(r.u32());
+        wifiCfg.subnet   = IPAddress(r.u32());
+    }
+    if (version >= 3) {
+        swrCfg.fwdPin     = (int8_t)r.u8();
+        swrCfg.reflPin    = (int8_t)r.u8();
+        swrCfg.tripSwr    = r.u16();
+        swrCfg.fullScaleW = r.u16();
+    }
+    if (version >= 4) {
+        relayCfg.windowMs = r.u16();
+        for (int i = 0; i < RELAY_SRC_SWR; i++) relayCfg.priority[i] = r.u8();
+    }
+    if (version >= 5) {
+        udpCfg.beaconGroup      = IPAddress(r.u32());
+        udpCfg.beaconPort       = r.u16();
+        udpCfg.beaconHeartbeatS = r.u16();
+    }
+
+    // Fields of later versions go here behind "if (version >= N)"; a
+    // newer record than that has more after them.
+    if (!r.ok || (version == CONFIG_VERSION && r.n != len)) return false;
+    stats.version = version;
+    return true;
+}
+
+// One key per setting, as written by firmware before the record.
+void loadLegacy(Preferences& prefs)
+{
+    wifiCfg.ssid      = prefs.getString("wifiSSID", wifiCfg.ssid);
+    wifiCfg.password  = prefs.getString("wifiPass", wifiCfg.password);
+    wifiCfg.gatewayIP = IPAddress(prefs.getUInt("gatewayIP", (uint32_t)wifiCfg.gatewayIP));
+
+    mqttCfg.enabled    = prefs.getBool("mqttEnabled", mqttCfg.enabled);
+    mqttCfg.broker     = prefs.getString("mqttBroker", mqttCfg.broker);
+    mqttCfg.port       = prefs.getUShort("mqttPort", mqttCfg.port);
+    mqttCfg.user       = prefs.getString("mqttUser", mqttCfg.user);
+    mqttCfg.password   = prefs.getString("mqttPass", mqttCfg.password);
+    mqttCfg.topicCmd   = prefs.getString("mqttCmd", mqttCfg.topicCmd);
+    mqttCfg.topicState = prefs.getString("mqttState", mqttCfg.topicState);
+
+    relayCfg.deadTimeMs = prefs.getUShort("relayDeadMs", relayCfg.deadTimeMs);
+    relayCfg.outputMap  = prefs.getString("outputMap", relayCfg.outputMap);
+
+    bandCfg.radioIP      = IPAddress(prefs.getUInt("radioIP", (uint32_t)bandCfg.radioIP));
+    bandCfg.slice        = prefs.getUChar("radioSlice", bandCfg.slice);
+    bandCfg.hysteresisHz = prefs.getUInt("bandHystHz", bandCfg.hysteresisHz);
+
+    txCfg.pttPin       = prefs.getChar("pttPin", txCfg.pttPin);
+    txCfg.pttActiveLow = prefs.getBool("pttActiveLow", txCfg.pttActiveLow);
+    txCfg.ampKeyPin    = prefs.getChar("ampKeyPin", txCfg.ampKeyPin);
+
+    udpCfg.port = prefs.getUShort("udpPort", udpCfg.port);
+    udpCfg.key  = prefs.getString("udpKey", udpCfg.key);
+}
+
+} // namespace
+
+void configLoad()
+{
+    const uint64_t startUs = halMicros();
+    stats = ConfigStats();
+    storedLen = 0;
+    defaults();
+
+    Preferences prefs;
+    bool legacy = false;
+    if (prefs.begin("antSwitch", true)) {
+        const size_t len = prefs.getBytes(CONFIG_KEY, stored, sizeof(stored));
+        if (len && decode(stored, len)) {
+            storedLen = len;
+            stats.source = CONFIG_RECORD;
+        } else {
+            if (len || prefs.getBytesLength(CONFIG_KEY)) {
+                stats.corrupt = true;
+                Serial.println("Settings record in NVS is not valid, ignored");
+                defaults();
+            }
+            // Every save by older firmware wrote every key
+            legacy = prefs.isKey("wifiSSID");
+            if (legacy) loadLegacy(prefs);
+        }
+        prefs.end();
+    }
+    if (legacy) {
+        stats.source = CONFIG_LEGACY;
+        configSave();
+    }
+    stats.bytes = (uint16_t)storedLen;
+    stats.loadUs = (uint32_t)(halMicros() - startUs);
+}
+
+bool configSave()
+{
+    uint8_t blob[CONFIG_BLOB_MAX];
+    const size_t len = encode(blob);
+    if (len == storedLen && !memcmp(blob, stored, len)) {
+        stats.unchanged++;
+        return true;
+    }
+
+    Preferences prefs;
+    bool saved = prefs.begin("antSwitch", false);
+    if (saved) {
+        saved = prefs.putBytes(CONFIG_KEY, blob, len) == len;
+        prefs.end();
+    }
+    if (!saved) {
+        Serial.println("Settings: NVS write failed");
+        return false;
+    }
+    memcpy(stored, blob, len);
+    storedLen = len;
+    stats.saves++;
+    stats.bytesWritten += len;
+    stats.bytes = (uint16_t)len;
+    return true;
+}
+
+ConfigStats configStats()
+{
+    return stats;
+}
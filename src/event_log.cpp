@@ -0,0 +1,395 @@
+#include <Arduino.h>
+#include <string.h>
+
+#include "event_log.h"
+#include "hal.h"
+
+namespace {
+
+// Stored as is: both the ESP32 and the native build are little-endian.
+struct Record
+{
+    uint32_t seq;
+    uint32_t ms;
+    uint8_t  type;
+    uint8_t  source;
+    uint8_t  flags;
+    uint8_t  crc;
+    uint32_t value;
+};
+static_assert(sizeof(Record) == EVENT_LOG_RECORD, "record layout");
+
+const uint32_t SECTOR_RECORDS = HAL_LOG_SECTOR / EVENT_LOG_RECORD;
+
+// Shared, under halCritical. The record with seq s sits in ram[s % N]
+// while s >= nextSeq - N; below flushedSeq it is in flash (or lost).
+Record ram[EVENT_LOG_RAM_RECORDS];
+uint32_t nextSeq = 1;
+uint32_t bootSeq = 1;                // first seq of this boot: older ones are not in ram[]
+uint32_t flushedSeq = 1;
+uint32_t writtenSeq = 1;             // after the newest record in flash
+uint32_t logged = 0;
+uint32_t lost = 0;
+
+// Flash is a ring of capacity records: used of them from tail (a sector
+// start) up to head; head's sector was erased when head entered it.
+// Changed by whoever holds writing, read anywhere under halCritical.
+bool writing = false;
+uint32_t capacity = 0;               // set at boot
+uint32_t head = 0;
+uint32_t tail = 0;
+uint32_t used = 0;
+uint32_t flushes = 0;
+uint32_t flashBytes = 0;
+uint32_t erases = 0;
+uint32_t damaged = 0;
+
+HalWorkerHandle writer = nullptr;
+bool clockLogged = false;            // loop() only
+
+// Under halCritical. Readers get nothing beyond this, so the next boot,
+// which starts there, never hands out a seq a reader has seen.
+uint32_t servedEnd()
+{
+    const uint32_t limit = writtenSeq + EVENT_LOG_RAM_RECORDS;
+    return (int32_t)(nextSeq - limit) > 0 ? limit : nextSeq;
+}
+
+// Under halCritical
+uint32_t ramFirst()
+{
+    return nextSeq - bootSeq > EVENT_LOG_RAM_RECORDS ? nextSeq - EVENT_LOG_RAM_RECORDS : bootSeq;
+}
+
+uint8_t crc8(const Record& r)
+{
+    const uint8_t* p = (const uint8_t*)&r;
+    uint8_t crc = 0;
+    for (size_t i = 0; i < EVENT_LOG_RECORD; i++) {
+        if (i == offsetof(Record, crc)) continue;
+        crc ^= p[i];
+        for (int b = 0; b < 8; b++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+bool valid(const Record& r)
+{
+    return r.type >= EVENT_BOOT && r.type < EVENT_TYPES && r.crc == crc8(r);
+}
+
+bool blank(const Record& r)
+{
+    const uint8_t* p = (const uint8_t*)&r;
+    for (size_t i = 0; i < EVENT_LOG_RECORD; i++) {
+        if (p[i] != 0xff) return false;
+    }
+    return true;
+}
+
+bool readRecords(uint32_t index, Record* out, uint32_t count)
+{
+    return halLogFlashRead((size_t)index * EVENT_LOG_RECORD, out, count * EVENT_LOG_RECORD);
+}
+
+// --------------------------------------------------
+// Boot: find head and tail
+// --------------------------------------------------
+// The newest sector is the one whose first record has the highest seq;
+// records run up from there until a blank slot (head) or a damaged one,
+// a write torn by a power cut, after which head moves to the next sector.
+// Returns the newest seq in flash, 0 if none.
+uint32_t scanFlash()
+{
+    const uint32_t sectors = capacity / SECTOR_RECORDS;
+    int newest = -1;
+    uint32_t newestFirst = 0;
+    for (uint32_t s = 0; s < sectors; s++) {
+        Record r;
+        if (readRecords(s * SECTOR_RECORDS, &r, 1) && valid(r) && (newest < 0 || r.seq > newestFirst)) {
+            newest = (int)s;
+            newestFirst = r.seq;
+        }
+    }
+    if (newest < 0) return 0;
+
+    const uint32_t start = (uint32_t)newest * SECTOR_RECORDS;
+    uint32_t newestSeq = 0;
+    uint32_t inSector = 0;
+    bool torn = false;
+    Record batch[EVENT_LOG_BATCH];
+    while (inSector < SECTOR_RECORDS) {
+        if (!readRecords(start + inSector, batch, EVENT_LOG_BATCH)) break;
+        uint32_t i = 0;
+        while (i < EVENT_LOG_BATCH && valid(batch[i]) && batch[i].seq > newestSeq) newestSeq = batch[i++].seq;
+        inSector += i;
+        if (i < EVENT_LOG_BATCH) {
+            torn = !blank(batch[i]);
+            break;
+        }
+    }
+    if (torn) damaged++;
+    head = torn || inSector == SECTOR_RECORDS ? (start + SECTOR_RECORDS) % capacity : start + inSector;
+
+    // Oldest: the first sector after head's holding older records; head's
+    // own sector counts only when head is past its start (the newest).
+    const uint32_t headSector = head / SECTOR_RECORDS;
+    tail = head;
+    for (uint32_t k = 1; k <= sectors; k++) {
+        const uint32_t s = (headSector + k) % sectors;
+        if (s == headSector && head % SECTOR_RECORDS == 0) break;
+        Record r;
+        if (readRecords(s * SECTOR_RECORDS, &r, 1) && valid(r) && r.seq <= newestSeq) {
+            tail = s * SECTOR_RECORDS;
+            break;
+        }
+    }
+    used = (head + capacity - tail) % capacity;
+    return newestSeq;
+}
+
+// --------------------------------------------------
+// Flush
+// --------------------------------------------------
+// Writes up to one batch, never across a sector; false if nothing was
+// pending. Caller holds writing.
+bool flushBatch()
+{
+    Record batch[EVENT_LOG_BATCH];
+    uint32_t n = 0;
+    uint32_t first = 0;
+    const uint32_t room = capacity ? SECTOR_RECORDS - head % SECTOR_RECORDS : EVENT_LOG_BATCH;
+
+    halCriticalEnter();
+    first = flushedSeq;
+    n = nextSeq - first;
+    if (n > EVENT_LOG_BATCH) n = EVENT_LOG_BATCH;
+    if (n > room) n = room;
+    for (uint32_t i = 0; i < n; i++) batch[i] = ram[(first + i) % EVENT_LOG_RAM_RECORDS];
+    halCriticalExit();
+    if (!n) return false;
+
+    bool erased = false, written = false;
+    if (capacity) {
+        if (head % SECTOR_RECORDS == 0) {
+            // Wrapped: the oldest sector goes
+            halCriticalEnter();
+            if (used && tail == head) {
+                tail = (tail + SECTOR_RECORDS) % capacity;
+                used = used > SECTOR_RECORDS ? used - SECTOR_RECORDS : 0;
+            }
+            halCriticalExit();
+            erased = halLogFlashErase((size_t)head * EVENT_LOG_RECORD);
+        }
+        written = halLogFlashWrite((size_t)head * EVENT_LOG_RECORD, batch, n * EVENT_LOG_RECORD);
+    }
+
+    halCriticalEnter();
+    if (capacity) {
+        head = (head + n) % capacity;
+        used += n;
+    }
+    if (erased) erases++;
+    if (written) {
+        flushes++;
+        flashBytes += n * EVENT_LOG_RECORD;
+    }
+    if (written || !capacity) writtenSeq = batch[n - 1].seq + 1;
+    // The ring may have overrun meanwhile and moved flushedSeq further
+    if ((int32_t)(first + n - flushedSeq) > 0) flushedSeq = first + n;
+    halCriticalExit();
+    return true;
+}
+
+bool claim()
+{
+    halCriticalEnter();
+    const bool ok = !writing;
+    writing = true;
+    halCriticalExit();
+    return ok;
+}
+
+void release()
+{
+    halCriticalEnter();
+    writing = false;
+    halCriticalExit();
+}
+
+// Writer task body; eventLogFlush() may hold the flash already.
+void writerRun()
+{
+    if (!claim()) return;
+    while (flushBatch()) {
+    }
+    release();
+}
+
+// --------------------------------------------------
+// Readers
+// --------------------------------------------------
+// Copies records from flash with seq >= *cursor; 0 once there are none.
+size_t readFlash(Record* out, size_t max, uint32_t* cursor)
+{
+    halCriticalEnter();
+    const uint32_t from = tail, count = used;
+    halCriticalExit();
+
+    uint32_t lo = 0, hi = count;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        // Past a damaged stretch (the rest of a sector after a torn write)
+        // to the next good record, if any before hi
+        uint32_t probe = mid;
+        Record r;
+        do {
+            if (!readRecords((from + probe) % capacity, &r, 1)) return 0;
+        } while (!valid(r) && ++probe < hi);
+        if (probe < hi && r.seq < *cursor) {
+            lo = probe + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // Damaged records are skipped; keep reading until something is kept
+    size_t kept = 0;
+    while (kept == 0 && lo < count) {
+        const uint32_t index = (from + lo) % capacity;
+        uint32_t n = (uint32_t)max;
+        if (n > count - lo) n = count - lo;
+        if (n > capacity - index) n = capacity - index;
+        if (!readRecords(index, out, n)) return 0;
+        lo += n;
+        for (uint32_t i = 0; i < n; i++) {
+            if (valid(out[i]) && out[i].seq >= *cursor) {
+                out[kept++] = out[i];
+                *cursor = out[i].seq + 1;
+            }
+        }
+    }
+    return kept;
+}
+
+size_t readRam(Record* out, size_t max, uint32_t* cursor)
+{
+    size_t n = 0;
+    halCriticalEnter();
+    uint32_t seq = ramFirst();
+    if ((int32_t)(*cursor - seq) > 0) seq = *cursor;
+    const uint32_t end = servedEnd();
+    for (; (int32_t)(end - seq) > 0 && n < max; seq++) out[n++] = ram[seq % EVENT_LOG_RAM_RECORDS];
+    halCriticalExit();
+    *cursor = seq;
+    return n;
+}
+
+} // namespace
+
+void eventLogBegin()
+{
+    size_t bytes = halLogFlashSize();
+    if (bytes > EVENT_LOG_FLASH_BYTES) bytes = EVENT_LOG_FLASH_BYTES;
+    capacity = (uint32_t)(bytes / HAL_LOG_SECTOR * SECTOR_RECORDS);
+    head = tail = used = 0;
+    flushes = flashBytes = erases = damaged = 0;
+    writing = false;                 // a flush cut off by the reboot
+    clockLogged = false;
+    const uint32_t newest = capacity ? scanFlash() : 0;
+
+    halCriticalEnter();
+    writtenSeq = newest + 1;
+    nextSeq = bootSeq = flushedSeq = writtenSeq + EVENT_LOG_RAM_RECORDS;
+    logged = lost = 0;
+    halCriticalExit();
+
+    if (!writer) writer = halWorkerCreate("eventlog", writerRun, EVENT_LOG_TASK_CORE, EVENT_LOG_TASK_PRIORITY);
+    eventLog(EVENT_BOOT, 0, 0, halResetReason());
+    halWorkerNotify(writer);         // nothing of this boot is served until it is in flash
+    if (!capacity) Serial.println("Event log: no flash partition, RAM only");
+}
+
+void eventLog(EventType type, uint8_t source, uint8_t flags, uint32_t value)
+{
+    const uint32_t ms = (uint32_t)(halMicros() / 1000);
+
+    halCriticalEnter();
+    if (nextSeq - flushedSeq == EVENT_LOG_RAM_RECORDS) {
+        flushedSeq++;
+        lost++;
+    }
+    Record& r = ram[nextSeq % EVENT_LOG_RAM_RECORDS];
+    r = Record{nextSeq, ms, type, source, flags, 0, value};
+    r.crc = crc8(r);
+    nextSeq++;
+    logged++;
+    halCriticalExit();
+}
+
+void eventLogService()
+{
+    uint64_t utcUs;
+    if (!clockLogged && halUtcMicros(&utcUs)) {
+        clockLogged = true;
+        eventLog(EVENT_CLOCK, 0, 0, (uint32_t)(utcUs / 1000000));
+    }
+
+    halCriticalEnter();
+    const uint32_t pending = nextSeq - flushedSeq;
+    const uint32_t oldestMs = ram[flushedSeq % EVENT_LOG_RAM_RECORDS].ms;
+    halCriticalExit();
+    if (pending >= EVENT_LOG_BATCH ||
+        (pending && (uint32_t)(halMicros() / 1000) - oldestMs >= EVENT_LOG_FLUSH_MS)) {
+        halWorkerNotify(writer);
+    }
+}
+
+void eventLogFlush()
+{
+    while (!claim()) delay(1);       // the writer task is mid-batch
+    while (flushBatch()) {
+    }
+    release();
+}
+
+size_t eventLogFill(char* buf, size_t size, uint32_t* cursor)
+{
+    Record out[EVENT_LOG_BATCH];     // buf need not be aligned
+    size_t max = size / EVENT_LOG_RECORD;
+    if (max > EVENT_LOG_BATCH) max = EVENT_LOG_BATCH;
+    size_t n = 0;
+
+    halCriticalEnter();
+    const uint32_t first = ramFirst();
+    const bool inFlash = used != 0;
+    halCriticalExit();
+    if (inFlash && (int32_t)(*cursor - first) < 0) n = readFlash(out, max, cursor);
+    if (n == 0) n = readRam(out, max, cursor);
+    memcpy(buf, out, n * EVENT_LOG_RECORD);
+    return n * EVENT_LOG_RECORD;
+}
+
+EventLogStats eventLogStats()
+{
+    EventLogStats s = {};
+    halCriticalEnter();
+    s.nextSeq = nextSeq;
+    s.logged = logged;
+    s.pending = nextSeq - flushedSeq;
+    s.lost = lost;
+    s.firstSeq = ramFirst();
+    s.flashRecords = used;
+    s.flushes = flushes;
+    s.flashBytes = flashBytes;
+    s.erases = erases;
+    s.damaged = damaged;
+    const uint32_t oldest = tail;
+    halCriticalExit();
+
+    Record r;
+    if (s.flashRecords && readRecords(oldest, &r, 1) && valid(r) && (int32_t)(r.seq - s.firstSeq) < 0) {
+        s.firstSeq = r.seq;
+    }
+    return s;
+}
@@ -0,0 +1,85 @@
+#include "event_stream.h"
+
+namespace {
+
+HttpServer* server = nullptr;
+int subscribers[EVENT_MAX_CLIENTS];
+int subscriberCount = 0;
+unsigned long lastHeartbeatMs = 0;
+uint32_t eventId = 0;
+
+const char SSE_HEADER[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n"
+    "retry: 3000\n\n";
+
+// Writes to every subscriber; the server closes those that fall behind.
+void sendAll(const char* buf, size_t len)
+{
+    int kept = 0;
+    for (int i = 0; i < subscriberCount; i++) {
+        if (server->streamWrite(subscribers[i], buf, len)) subscribers[kept++] = subscribers[i];
+    }
+    subscriberCount = kept;
+}
+
+// Forgets streams the server has already closed (peer went away).
+void prune()
+{
+    int kept = 0;
+    for (int i = 0; i < subscriberCount; i++) {
+        if (server->streamOpen(subscribers[i])) subscribers[kept++] = subscribers[i];
+    }
+    subscriberCount = kept;
+}
+
+} // namespace
+
+bool eventStreamFull()
+{
+    return eventStreamClients() >= EVENT_MAX_CLIENTS;
+}
+
+bool eventStreamAdd(HttpServer& http, const char* initialData)
+{
+    if (eventStreamFull()) return false;
+    server = &http;
+
+    char buf[192];
+    int n = snprintf(buf, sizeof(buf), "%sid: %u\ndata: %s\n\n", SSE_HEADER, (unsigned)eventId, initialData);
+    if (n <= 0 || n >= (int)sizeof(buf)) return false;
+
+    const int stream = http.beginStream(buf);
+    if (stream < 0) return false;
+    subscribers[subscriberCount++] = stream;
+    return true;
+}
+
+void eventStreamBroadcast(const char* data)
+{
+    if (!subscriberCount) return;
+    char buf[128];
+    int n = snprintf(buf, sizeof(buf), "id: %u\ndata: %s\n\n", (unsigned)++eventId, data);
+    if (n <= 0 || n >= (int)sizeof(buf)) return;
+    sendAll(buf, (size_t)n);
+}
+
+void eventStreamService()
+{
+    unsigned long now = millis();
+    if (now - lastHeartbeatMs < EVENT_HEARTBEAT_MS) return;
+    lastHeartbeatMs = now;
+
+    // Comment line: keeps proxies from timing out and finds dead peers.
+    static const char ping[] = ": ping\n\n";
+    if (subscriberCount) sendAll(ping, sizeof(ping) - 1);
+}
+
+int eventStreamClients()
+{
+    if (subscriberCount) prune();
+    return subscriberCount;
+}
@@ -0,0 +1,158 @@
+#include <Arduino.h>
+#include <string.h>
+
+#include "band_decoder.h"
+#include "flex_radio.h"
+#include "hal.h"
+
+namespace {
+
+enum State : uint8_t { FLEX_OFF, FLEX_IDLE, FLEX_CONNECTING, FLEX_CONNECTED };
+
+const char     SUBSCRIBE[]   = "C1|sub slice all\n";
+const char     FREQ_KEY[]    = "RF_frequency=";
+const size_t   READ_CHUNK    = 256;
+const int      READS_MAX     = 4;        // per loop() pass
+
+// loop() only
+uint32_t radioIp = 0;
+uint8_t followSlice = 0;
+State state = FLEX_OFF;
+int sock = -1;
+uint64_t connectStartUs = 0;
+uint64_t retryAtUs = 0;
+char line[FLEX_LINE_MAX];
+size_t lineLen = 0;
+bool overlong = false;       // dropping the rest of a line that did not fit
+FlexRadioStats stats = {};
+
+void disconnect(bool failed)
+{
+    if (sock >= 0) halTcpClose(sock);
+    sock = -1;
+    state = FLEX_IDLE;
+    retryAtUs = halMicros() + FLEX_RETRY_MS * 1000ULL;
+    lineLen = 0;
+    overlong = false;
+    if (failed) stats.failures++;
+    stats.connected = false;
+}
+
+// S<handle>|slice <n> key=value ...; everything else is ignored.
+void parseLine(const char* s, size_t n, uint64_t arrivedUs)
+{
+    stats.lines++;
+    const char* end = s + n;
+    const char* bar = (const char*)memchr(s, '|', n);
+    if (n == 0 || s[0] != 'S' || !bar || end - bar < 7 || memcmp(bar + 1, "slice ", 6)) return;
+
+    const char* p = bar + 7;
+    const char* digits = p;
+    uint32_t slice = 0;
+    while (p < end && *p >= '0' && *p <= '9' && p - digits < 3) slice = slice * 10 + (*p++ - '0');
+    if (p == digits || slice != followSlice) return;
+
+    const size_t keyLen = sizeof(FREQ_KEY) - 1;
+    while (p < end) {
+        while (p < end && *p == ' ') p++;
+        const char* tok = p;
+        while (p < end && *p != ' ') p++;
+        if ((size_t)(p - tok) <= keyLen || memcmp(tok, FREQ_KEY, keyLen)) continue;
+
+        uint32_t hz;
+        if (bandParseFrequency(tok + keyLen, p - tok - keyLen, &hz) && hz) {
+            stats.frequencies++;
+            bandDecoderFrequency(hz, arrivedUs);
+        }
+        return;
+    }
+}
+
+void feed(const char* data, size_t n, uint64_t arrivedUs)
+{
+    for (size_t i = 0; i < n; i++) {
+        const char c = data[i];
+        if (c == '\n') {
+            if (!overlong) parseLine(line, lineLen, arrivedUs);
+            lineLen = 0;
+            overlong = false;
+        } else if (c == '\r' || overlong) {
+            continue;
+        } else if (lineLen == sizeof(line)) {
+            overlong = true;
+            stats.skipped++;
+        } else {
+            line[lineLen++] = c;
+        }
+    }
+}
+
+} // namespace
+
+void flexRadioBegin(uint32_t ip, uint8_t slice)
+{
+    if (sock >= 0) halTcpClose(sock);
+    sock = -1;
+    radioIp = ip;
+    followSlice = slice;
+    state = ip ? FLEX_IDLE : FLEX_OFF;
+    retryAtUs = 0;
+    lineLen = 0;
+    overlong = false;
+    stats.connected = false;
+}
+
+void flexRadioService(bool online)
+{
+    if (state == FLEX_OFF) return;
+    if (!online) {
+        if (state != FLEX_IDLE) disconnect(state == FLEX_CONNECTED);
+        return;
+    }
+
+    const uint64_t now = halMicros();
+    if (state == FLEX_IDLE) {
+        if (now < retryAtUs) return;
+        sock = halTcpConnect(radioIp, FLEX_PORT);
+        if (sock < 0) {
+            disconnect(true);
+            return;
+        }
+        state = FLEX_CONNECTING;
+        connectStartUs = now;
+        return;
+    }
+
+    if (state == FLEX_CONNECTING) {
+        const int r = halTcpConnectState(sock);
+        if (r == 0 && now - connectStartUs < FLEX_CONNECT_TIMEOUT_MS * 1000ULL) return;
+        const size_t len = sizeof(SUBSCRIBE) - 1;
+        if (r <= 0 || halTcpSend(sock, SUBSCRIBE, len) != (int)len) {
+            Serial.println("FlexRadio: connect failed");
+            disconnect(true);
+            return;
+        }
+        Serial.println("FlexRadio: connected");
+        state = FLEX_CONNECTED;
+        stats.connected = true;
+        stats.connects++;
+    }
+
+    char buf[READ_CHUNK];
+    for (int i = 0; i < READS_MAX; i++) {
+        const uint64_t arrivedUs = halMicros();
+        const int n = halTcpRecv(sock, buf, sizeof(buf));
+        if (n == 0) return;
+        if (n < 0) {
+            Serial.println("FlexRadio: connection lost");
+            disconnect(true);
+            return;
+        }
+        feed(buf, (size_t)n, arrivedUs);
+    }
+}
+
+FlexRadioStats flexRadioStats()
+{
+    return stats;
+}
@@ -0,0 +1,632 @@
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <driver/adc.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <lwip/sockets.h>
+#include <ping/ping_sock.h>
+#include <soc/gpio_struct.h>
+#include <sys/time.h>
+
+#include "hal.h"
+
+uint64_t IRAM_ATTR halMicros()
+{
+    return (uint64_t)esp_timer_get_time();
+}
+
+void halClockSyncBegin(const char* server)
+{
+    configTime(0, 0, server);   // UTC; lwIP SNTP retries until the network is up
+}
+
+bool halUtcMicros(uint64_t* us)
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (tv.tv_sec < 1600000000) return false;   // still counting from 1970: never synced
+    *us = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    return true;
+}
+
+void halGpioOutput(int pin)
+{
+    pinMode(pin, OUTPUT);
+}
+
+void halGpioWrite(int pin, bool level)
+{
+    digitalWrite(pin, level ? HIGH : LOW);
+}
+
+void IRAM_ATTR halGpioWriteMask(uint64_t clearMask, uint64_t setMask)
+{
+    // W1TC/W1TS: every bit of a bank changes on the same APB write.
+    if ((uint32_t)clearMask)  GPIO.out_w1tc = (uint32_t)clearMask;
+    if (clearMask >> 32)      GPIO.out1_w1tc.val = (uint32_t)(clearMask >> 32);
+    if ((uint32_t)setMask)    GPIO.out_w1ts = (uint32_t)setMask;
+    if (setMask >> 32)        GPIO.out1_w1ts.val = (uint32_t)(setMask >> 32);
+}
+
+void halGpioInput(int pin, bool pullUp)
+{
+    pinMode(pin, pullUp ? INPUT_PULLUP : INPUT);
+}
+
+static inline bool IRAM_ATTR readLevel(int pin)
+{
+    return pin < 32 ? (GPIO.in >> pin) & 1 : (GPIO.in1.data >> (pin - 32)) & 1;
+}
+
+bool halGpioRead(int pin)
+{
+    return readLevel(pin);
+}
+
+struct HalGpioHandler
+{
+    int pin;
+    HalGpioIsr fn;
+};
+
+static HalGpioHandler gpioHandlers[2];
+static int gpioHandlerCount = 0;
+
+static void IRAM_ATTR gpioThunk(void* arg)
+{
+    const HalGpioHandler* h = static_cast<const HalGpioHandler*>(arg);
+    h->fn(readLevel(h->pin));
+}
+
+void halGpioOnChange(int pin, HalGpioIsr fn)
+{
+    if (gpioHandlerCount >= (int)(sizeof(gpioHandlers) / sizeof(gpioHandlers[0]))) return;
+    HalGpioHandler* h = &gpioHandlers[gpioHandlerCount++];
+    h->pin = pin;
+    h->fn = fn;
+    attachInterruptArg(pin, gpioThunk, h, CHANGE);
+}
+
+// --------------------------------------------------
+// Continuous ADC (ADC1 through the I2S DMA, IDF 4.4 adc_digi driver)
+// --------------------------------------------------
+static HalAdcFn adcFn = nullptr;
+static int8_t adcIndex[8];                   // ADC1 channel -> index in pins, -1 = not sampled
+
+static int adc1Channel(int pin)
+{
+    static const int8_t PINS[8] = {36, 37, 38, 39, 32, 33, 34, 35};
+    for (int ch = 0; ch < 8; ch++) {
+        if (PINS[ch] == pin) return ch;
+    }
+    return -1;
+}
+
+static void adcTask(void*)
+{
+    static uint16_t buf[HAL_ADC_FRAME];
+    for (;;) {
+        uint32_t got = 0;
+        // INVALID_STATE: the driver's pool overflowed, but the frame is good
+        const esp_err_t err = adc_digi_read_bytes((uint8_t*)buf, sizeof(buf), &got, ADC_MAX_DELAY);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) continue;
+        size_t n = 0;
+        for (size_t i = 0; i < got / 2; i++) {
+            adc_digi_output_data_t d;
+            memcpy(&d, &buf[i], sizeof(d));
+            const int8_t index = d.type1.channel < 8 ? adcIndex[d.type1.channel] : -1;
+            if (index >= 0) buf[n++] = (uint16_t)(index << 12 | d.type1.data);
+        }
+        if (n) adcFn(buf, n);
+    }
+}
+
+bool halAdcStart(const int* pins, size_t count, uint32_t sampleHz, HalAdcFn fn, int core, int priority)
+{
+    if (adcFn || count == 0 || count > HAL_ADC_PINS) return false;
+    static adc_digi_pattern_config_t pattern[HAL_ADC_PINS];
+    uint16_t mask = 0;
+    memset(adcIndex, -1, sizeof(adcIndex));
+    for (size_t i = 0; i < count; i++) {
+        const int ch = adc1Channel(pins[i]);
+        if (ch < 0) return false;
+        adcIndex[ch] = (int8_t)i;
+        mask |= 1 << ch;
+        pattern[i].atten = ADC_ATTEN_DB_11;
+        pattern[i].channel = ch;
+        pattern[i].unit = 0;                 // ADC1
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+
+    adc_digi_init_config_t init = {};
+    init.max_store_buf_size = HAL_ADC_FRAME * 2 * 4;
+    init.conv_num_each_intr = HAL_ADC_FRAME * 2;
+    init.adc1_chan_mask = mask;
+    if (adc_digi_initialize(&init) != ESP_OK) return false;
+
+    adc_digi_configuration_t dig = {};
+    dig.conv_limit_en = 1;                   // required on the ESP32
+    dig.conv_limit_num = 250;
+    dig.pattern_num = count;
+    dig.adc_pattern = pattern;
+    dig.sample_freq_hz = sampleHz;
+    dig.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    dig.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+    if (adc_digi_controller_configure(&dig) != ESP_OK) {
+        adc_digi_deinitialize();
+        return false;
+    }
+    if (adc_digi_start() != ESP_OK) {
+        adc_digi_deinitialize();
+        return false;
+    }
+    adcFn = fn;
+    if (xTaskCreatePinnedToCore(adcTask, "adc", 3072, nullptr, priority, nullptr, core) != pdPASS) {
+        adc_digi_stop();
+        adc_digi_deinitialize();
+        adcFn = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void halShiftOut(int dataPin, int clockPin, int latchPin, const uint8_t* bytes, size_t len)
+{
+    for (size_t i = 0; i < len; i++) shiftOut(dataPin, clockPin, MSBFIRST, bytes[i]);
+    digitalWrite(latchPin, HIGH);   // storage registers take the chain on this edge
+    digitalWrite(latchPin, LOW);
+}
+
+bool halI2cBegin(int sda, int scl, uint32_t hz)
+{
+    return Wire.begin(sda, scl, hz);
+}
+
+bool halI2cWrite(uint8_t addr, const uint8_t* data, size_t len)
+{
+    Wire.beginTransmission(addr);
+    Wire.write(data, len);
+    return Wire.endTransmission() == 0;
+}
+
+// --------------------------------------------------
+// One-shot timers (esp_timer, task dispatch)
+// --------------------------------------------------
+struct HalTimer
+{
+    esp_timer_handle_t handle;
+    HalTimerFn fn;
+};
+
+static HalTimer timers[4];
+static int timerCount = 0;
+
+static void timerThunk(void* arg)
+{
+    static_cast<HalTimer*>(arg)->fn();
+}
+
+HalTimerHandle halTimerCreate(const char* name, HalTimerFn fn)
+{
+    if (timerCount >= (int)(sizeof(timers) / sizeof(timers[0]))) return nullptr;
+    HalTimer* t = &timers[timerCount];
+
+    esp_timer_create_args_t args = {};
+    args.callback = timerThunk;
+    args.arg = t;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = name;
+    if (esp_timer_create(&args, &t->handle) != ESP_OK) return nullptr;
+
+    t->fn = fn;
+    timerCount++;
+    return t;
+}
+
+void halTimerArm(HalTimerHandle timer, uint32_t us)
+{
+    esp_timer_stop(timer->handle);   // ESP_ERR_INVALID_STATE if idle – fine
+    esp_timer_start_once(timer->handle, us);
+}
+
+void halTimerCancel(HalTimerHandle timer)
+{
+    esp_timer_stop(timer->handle);
+}
+
+static portMUX_TYPE halMux = portMUX_INITIALIZER_UNLOCKED;
+
+// _SAFE: also taken by GPIO interrupt handlers.
+void IRAM_ATTR halCriticalEnter()
+{
+    portENTER_CRITICAL_SAFE(&halMux);
+}
+
+void IRAM_ATTR halCriticalExit()
+{
+    portEXIT_CRITICAL_SAFE(&halMux);
+}
+
+// --------------------------------------------------
+// Worker tasks (FreeRTOS task + direct-to-task notification)
+// --------------------------------------------------
+struct HalWorker
+{
+    TaskHandle_t task;
+    HalWorkerFn fn;
+};
+
+static HalWorker workers[HAL_WORKERS_MAX];
+static int workerCount = 0;
+
+static void workerThunk(void* arg)
+{
+    HalWorker* w = static_cast<HalWorker*>(arg);
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        w->fn();
+    }
+}
+
+HalWorkerHandle halWorkerCreate(const char* name, HalWorkerFn fn, int core, int priority)
+{
+    if (workerCount >= HAL_WORKERS_MAX) return nullptr;
+    HalWorker* w = &workers[workerCount];
+    w->fn = fn;
+    if (xTaskCreatePinnedToCore(workerThunk, name, 4096, w, priority, &w->task, core) != pdPASS) return nullptr;
+    workerCount++;
+    return w;
+}
+
+void halWorkerNotify(HalWorkerHandle worker)
+{
+    xTaskNotifyGive(worker->task);
+}
+
+void IRAM_ATTR halWorkerNotifyFromIsr(HalWorkerHandle worker)
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(worker->task, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+// --------------------------------------------------
+// OTA (esp_ota_ops; the bootloader is built with app rollback)
+// --------------------------------------------------
+// Arduino core hook: keep a new image pending instead of confirming it
+// at startup, so halOtaConfirm() decides. The core declares it weak with
+// C linkage; without extern "C" this would override nothing.
+extern "C" bool verifyRollbackLater()
+{
+    return true;
+}
+
+size_t halOtaPartitionSize()
+{
+    const esp_partition_t* p = esp_ota_get_next_update_partition(nullptr);
+    return p ? p->size : 0;
+}
+
+bool halOtaPending()
+{
+    esp_ota_img_states_t state;
+    return esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) == ESP_OK &&
+           state == ESP_OTA_IMG_PENDING_VERIFY;
+}
+
+void halOtaConfirm()
+{
+    esp_ota_mark_app_valid_cancel_rollback();
+}
+
+void halOtaRollback()
+{
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+    ESP.restart();   // no previous image to go back to
+}
+
+// --------------------------------------------------
+// Event log flash (esp_partition)
+// --------------------------------------------------
+static const esp_partition_t* logPartition()
+{
+    static const esp_partition_t* p =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, nullptr);
+    return p;
+}
+
+size_t halLogFlashSize()
+{
+    return logPartition() ? logPartition()->size : 0;
+}
+
+bool halLogFlashErase(size_t offset)
+{
+    return logPartition() && esp_partition_erase_range(logPartition(), offset, HAL_LOG_SECTOR) == ESP_OK;
+}
+
+bool halLogFlashWrite(size_t offset, const void* data, size_t len)
+{
+    return logPartition() && esp_partition_write(logPartition(), offset, data, len) == ESP_OK;
+}
+
+bool halLogFlashRead(size_t offset, void* data, size_t len)
+{
+    return logPartition() && esp_partition_read(logPartition(), offset, data, len) == ESP_OK;
+}
+
+uint8_t halResetReason()
+{
+    return (uint8_t)esp_reset_reason();
+}
+
+uint32_t halRandom()
+{
+    return esp_random();
+}
+
+// --------------------------------------------------
+// TCP (lwIP BSD sockets, non-blocking)
+// --------------------------------------------------
+static void setNonBlocking(int sock)
+{
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+}
+
+int halTcpListen(uint16_t port, int backlog)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) return -1;
+
+    int one = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(sock, backlog) < 0) {
+        close(sock);
+        return -1;
+    }
+    setNonBlocking(sock);
+    return sock;
+}
+
+int halTcpAccept(int listener)
+{
+    int sock = accept(listener, nullptr, nullptr);
+    if (sock < 0) return -1;
+
+    setNonBlocking(sock);
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return sock;
+}
+
+int halTcpRecv(int sock, void* buf, size_t len)
+{
+    int n = recv(sock, buf, len, MSG_DONTWAIT);
+    if (n > 0) return n;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    return -1;   // orderly shutdown or error
+}
+
+int halTcpSend(int sock, const void* buf, size_t len)
+{
+    int n = send(sock, buf, len, MSG_DONTWAIT);
+    if (n >= 0) return n;
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+}
+
+void halTcpClose(int sock)
+{
+    if (sock >= 0) close(sock);
+}
+
+int halTcpConnect(uint32_t ip, uint16_t port)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) return -1;
+
+    setNonBlocking(sock);
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = ip;           // IPAddress keeps the octets in network order
+    if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int halTcpConnectState(int sock)
+{
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(sock, &writable);
+    struct timeval tv = {0, 0};
+    const int n = select(sock + 1, nullptr, &writable, nullptr, &tv);
+    if (n == 0) return 0;
+
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (n < 0 || getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err) return -1;
+    return 1;
+}
+
+void halTcpWait(const int* socks, int count, uint32_t timeoutUs, bool* readable)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    int maxFd = -1;
+    for (int i = 0; i < count; i++) {
+        if (socks[i] < 0) continue;
+        FD_SET(socks[i], &fds);
+        if (socks[i] > maxFd) maxFd = socks[i];
+    }
+    struct timeval tv;
+    tv.tv_sec = timeoutUs / 1000000;
+    tv.tv_usec = timeoutUs % 1000000;
+    const int n = select(maxFd + 1, &fds, nullptr, nullptr, &tv);
+    for (int i = 0; i < count; i++) {
+        readable[i] = n > 0 && socks[i] >= 0 && FD_ISSET(socks[i], &fds);
+    }
+}
+
+// --------------------------------------------------
+// UDP (lwIP BSD socket, blocking receive on its own task)
+// --------------------------------------------------
+static int udpSock = -1;
+static HalUdpFn udpFn = nullptr;
+
+static void udpTask(void*)
+{
+    static uint8_t buf[HAL_UDP_MAX];
+    for (;;) {
+        struct sockaddr_in from = {};
+        socklen_t fromLen = sizeof(from);
+        const int n = recvfrom(udpSock, buf, sizeof(buf), 0, (struct sockaddr*)&from, &fromLen);
+        if (n > 0) udpFn(buf, (size_t)n, from.sin_addr.s_addr, ntohs(from.sin_port));
+    }
+}
+
+bool halUdpListen(uint16_t port, HalUdpFn fn, int core, int priority)
+{
+    if (udpSock >= 0) return false;
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) return false;
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return false;
+    }
+    const uint8_t ttl = 1;      // beacons go out from here too
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    udpSock = sock;
+    udpFn = fn;
+    if (xTaskCreatePinnedToCore(udpTask, "udp", 4096, nullptr, priority, nullptr, core) != pdPASS) {
+        close(sock);
+        udpSock = -1;
+        return false;
+    }
+    return true;
+}
+
+bool halUdpSend(uint32_t ip, uint16_t port, const void* data, size_t len)
+{
+    if (udpSock < 0) return false;
+    struct sockaddr_in to = {};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    to.sin_addr.s_addr = ip;
+    return sendto(udpSock, data, len, 0, (struct sockaddr*)&to, sizeof(to)) == (int)len;
+}
+
+// Only opened when there is no listener; the two share one socket of the
+// budget (HTTP_RESERVED_SOCKETS).
+static int mcastSock = -1;
+
+bool halUdpMulticast(uint32_t group, uint16_t port, const void* data, size_t len)
+{
+    if (udpSock < 0 && mcastSock < 0) {
+        const int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (sock < 0) return false;
+        const uint8_t ttl = 1;
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+        mcastSock = sock;
+    }
+    struct sockaddr_in to = {};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    to.sin_addr.s_addr = group;
+    const int sock = udpSock >= 0 ? udpSock : mcastSock;
+    return sendto(sock, data, len, MSG_DONTWAIT, (struct sockaddr*)&to, sizeof(to)) == (int)len;
+}
+
+// --------------------------------------------------
+// ICMP echo (esp_ping: its own task, result via callbacks)
+// --------------------------------------------------
+static esp_ping_handle_t pingSession = nullptr;
+static uint32_t pingTarget = 0;
+static uint32_t pingTimeoutMs = 0;
+static volatile uint8_t pingState = HAL_PING_IDLE;
+static volatile uint32_t pingRttMs = 0;
+
+static void pingSuccess(esp_ping_handle_t hdl, void* arg)
+{
+    uint32_t rtt = 0;
+    esp_ping_get_profile(hdl, ESP_PING_PROF_TIMEGAP, &rtt, sizeof(rtt));
+    portENTER_CRITICAL(&halMux);
+    pingRttMs = rtt;
+    pingState = HAL_PING_OK;
+    portEXIT_CRITICAL(&halMux);
+}
+
+static void pingTimeout(esp_ping_handle_t hdl, void* arg)
+{
+    portENTER_CRITICAL(&halMux);
+    pingState = HAL_PING_TIMEOUT;
+    portEXIT_CRITICAL(&halMux);
+}
+
+bool halPingStart(uint32_t ip, uint32_t timeoutMs)
+{
+    if (pingState == HAL_PING_PENDING) return false;
+
+    // The session (and its task) is reused; a new target needs a new one.
+    if (pingSession && (ip != pingTarget || timeoutMs != pingTimeoutMs)) {
+        esp_ping_delete_session(pingSession);
+        pingSession = nullptr;
+    }
+    if (!pingSession) {
+        esp_ping_config_t config = ESP_PING_DEFAULT_CONFIG();
+        ip_addr_t target = IPADDR4_INIT(ip);
+        config.target_addr = target;
+        config.count = 1;
+        config.interval_ms = 10;
+        config.timeout_ms = timeoutMs;
+
+        esp_ping_callbacks_t cbs = {};
+        cbs.on_ping_success = pingSuccess;
+        cbs.on_ping_timeout = pingTimeout;
+        if (esp_ping_new_session(&config, &cbs, &pingSession) != ESP_OK) {
+            pingSession = nullptr;
+            return false;
+        }
+        pingTarget = ip;
+        pingTimeoutMs = timeoutMs;
+    }
+
+    pingState = HAL_PING_PENDING;
+    if (esp_ping_start(pingSession) != ESP_OK) {
+        pingState = HAL_PING_IDLE;
+        return false;
+    }
+    return true;
+}
+
+HalPingResult halPingResult(uint32_t* rttMs)
+{
+    portENTER_CRITICAL(&halMux);
+    HalPingResult r = (HalPingResult)pingState;
+    if (r == HAL_PING_OK || r == HAL_PING_TIMEOUT) pingState = HAL_PING_IDLE;
+    if (rttMs) *rttMs = pingRttMs;
+    portEXIT_CRITICAL(&halMux);
+    return r;
+}
+
+#endif // ARDUINO_ARCH_ESP32
@@ -0,0 +1,45 @@
+#include <Arduino.h>
+
+#include "heap_monitor.h"
+
+namespace {
+
+HeapStats stats = {};
+uint32_t lastSampleMs = 0;
+
+void sample()
+{
+    stats.free = ESP.getFreeHeap();
+    stats.largest = ESP.getMaxAllocHeap();
+    if (stats.free > stats.maxFree) stats.maxFree = stats.free;
+    if (stats.largest < stats.minLargest) stats.minLargest = stats.largest;
+    stats.samples++;
+}
+
+} // namespace
+
+void heapMonitorBegin()
+{
+    stats = HeapStats();
+    stats.size = ESP.getHeapSize();
+    stats.minLargest = UINT32_MAX;
+    sample();
+    stats.bootFree = stats.free;
+    stats.bootLargest = stats.largest;
+    lastSampleMs = millis();
+}
+
+void heapMonitorService()
+{
+    const uint32_t now = millis();
+    if (now - lastSampleMs < HEAP_SAMPLE_MS) return;
+    lastSampleMs = now;
+    sample();
+}
+
+HeapStats heapMonitorStats()
+{
+    sample();
+    stats.minFree = ESP.getMinFreeHeap();
+    return stats;
+}
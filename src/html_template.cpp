@@ -0,0 +1,73 @@
+#include <ctype.h>
+#include <string.h>
+
+#include "html_template.h"
+
+namespace {
+
+// Length of NAME if p starts a %NAME% placeholder, else 0.
+size_t placeholder(const char* p)
+{
+    if (*p != '%') return 0;
+    size_t n = 0;
+    while (n < TEMPLATE_NAME_MAX - 1 && (isalnum((unsigned char)p[n + 1]) || p[n + 1] == '_')) n++;
+    return n && p[n + 1] == '%' ? n : 0;
+}
+
+const char* escape(char c)
+{
+    switch (c) {
+    case '&':  return "&amp;";
+    case '<':  return "&lt;";
+    case '>':  return "&gt;";
+    case '"':  return "&quot;";
+    case '\'': return "&#39;";
+    default:   return nullptr;
+    }
+}
+
+} // namespace
+
+size_t templateRender(const char* tmpl, TemplateLookup lookup, char* buf, size_t size, uint32_t* cursor)
+{
+    uint32_t pos = *cursor & 0xFFFF;
+    uint32_t skip = *cursor >> 16;           // escaped bytes of the current value already sent
+    size_t n = 0;
+
+    while (n < size && tmpl[pos]) {
+        const size_t nameLen = placeholder(tmpl + pos);
+        if (!nameLen) {
+            buf[n++] = tmpl[pos++];
+            continue;
+        }
+
+        char name[TEMPLATE_NAME_MAX];
+        memcpy(name, tmpl + pos + 1, nameLen);
+        name[nameLen] = '\0';
+        char value[TEMPLATE_VALUE_MAX];
+        value[0] = '\0';
+        lookup(name, value, sizeof(value));
+
+        uint32_t done = 0;
+        for (const char* v = value; *v; v++) {
+            const char* e = escape(*v);
+            const size_t len = e ? strlen(e) : 1;
+            if (done < skip) {
+                done += len;
+                continue;
+            }
+            if (n + len > size) {
+                *cursor = pos | done << 16;
+                return n;
+            }
+            if (e) memcpy(buf + n, e, len);
+            else buf[n] = *v;
+            n += len;
+            done += len;
+        }
+        pos += nameLen + 2;
+        skip = 0;
+    }
+    *cursor = pos | skip << 16;
+    return n;
+}
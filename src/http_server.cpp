@@ -0,0 +1,1034 @@
+#include <string.h>
+
+#include "hal.h"
+#include "http_server.h"
+
+namespace {
+
+enum MultipartState : uint8_t { MP_PREAMBLE, MP_HEADERS, MP_DATA, MP_DELIMITER, MP_EPILOGUE };
+
+const size_t LENGTH_CHUNKED = (size_t)-1;       // startResponse(): no Content-Length
+
+static_assert(HTTP_CHUNK_SIZE <= 0xFFF, "chunk size line is three hex digits");
+
+const char* reason(int code)
+{
+    switch (code) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 302: return "Found";
+    case 303: return "See Other";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 413: return "Payload Too Large";
+    case 414: return "URI Too Long";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default:  return "";
+    }
+}
+
+bool parseMethod(const char* s, HTTPMethod* m)
+{
+    if (!strcmp(s, "GET"))     *m = HTTP_GET;
+    else if (!strcmp(s, "POST"))    *m = HTTP_POST;
+    else if (!strcmp(s, "HEAD"))    *m = HTTP_HEAD;
+    else if (!strcmp(s, "PUT"))     *m = HTTP_PUT;
+    else if (!strcmp(s, "DELETE"))  *m = HTTP_DELETE;
+    else if (!strcmp(s, "PATCH"))   *m = HTTP_PATCH;
+    else if (!strcmp(s, "OPTIONS")) *m = HTTP_OPTIONS;
+    else return false;
+    return true;
+}
+
+// Case-insensitive "Name:" match; returns the trimmed value or nullptr.
+char* headerValue(char* line, const char* name)
+{
+    size_t n = strlen(name);
+    if (strncasecmp(line, name, n) != 0 || line[n] != ':') return nullptr;
+    char* v = line + n + 1;
+    while (*v == ' ' || *v == '\t') v++;
+    return v;
+}
+
+// Copies the value of key="value" (or key=value) from a header parameter
+// list into out.
+bool headerParam(const char* s, const char* key, char* out, size_t outLen)
+{
+    const size_t n = strlen(key);
+    for (const char* p = s; (p = strcasestr(p, key)) != nullptr; p += n) {
+        if (p != s && p[-1] != ' ' && p[-1] != ';') continue;
+        if (p[n] != '=') continue;
+        const char* v = p + n + 1;
+        const char* end;
+        if (*v == '"') {
+            end = strchr(++v, '"');
+        } else {
+            end = v + strcspn(v, "; ");
+        }
+        if (!end || (size_t)(end - v) >= outLen) return false;
+        memcpy(out, v, end - v);
+        out[end - v] = '\0';
+        return true;
+    }
+    return false;
+}
+
+int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// The character at s[*i] with '+' and %xx decoded; advances *i past it.
+char urlDecodeChar(const char* s, size_t len, size_t* i)
+{
+    int hi, lo;
+    const char ch = s[(*i)++];
+    if (ch == '+') return ' ';
+    if (ch == '%' && *i + 1 < len && (hi = hexDigit(s[*i])) >= 0 && (lo = hexDigit(s[*i + 1])) >= 0) {
+        *i += 2;
+        return (char)(hi << 4 | lo);
+    }
+    return ch;
+}
+
+// Decodes into out (size bytes with the NUL); returns the decoded length,
+// which may be more than fit.
+size_t urlDecode(const char* s, size_t len, char* out, size_t size)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < len; n++) {
+        const char ch = urlDecodeChar(s, len, &i);
+        if (n + 1 < size) out[n] = ch;
+    }
+    if (size) out[n < size ? n : size - 1] = '\0';
+    return n;
+}
+
+// Looks up name in an application/x-www-form-urlencoded list; *value
+// points at the raw, still encoded value.
+bool findArg(const char* s, size_t len, const char* name, const char** value, size_t* valueLen)
+{
+    const size_t nameLen = strlen(name);
+    size_t pos = 0;
+    while (pos < len) {
+        const char* pair = s + pos;
+        const char* amp = (const char*)memchr(pair, '&', len - pos);
+        const size_t pairLen = amp ? (size_t)(amp - pair) : len - pos;
+        const char* eq = (const char*)memchr(pair, '=', pairLen);
+        const size_t keyLen = eq ? (size_t)(eq - pair) : pairLen;
+
+        // Keys are plain ASCII in this firmware; only values get decoded.
+        if (keyLen == nameLen && !memcmp(pair, name, nameLen)) {
+            *value = eq ? eq + 1 : pair + pairLen;
+            *valueLen = eq ? pairLen - keyLen - 1 : 0;
+            return true;
+        }
+        pos += pairLen + 1;
+    }
+    return false;
+}
+
+} // namespace
+
+// --------------------------------------------------
+// Setup
+// --------------------------------------------------
+void HttpServer::begin()
+{
+    // Also used after a restart of the network stack: forget old sockets.
+    for (Conn& c : conns_) {
+        c.state = FREE;
+        c.sock = -1;
+        c.headLen = 0;
+        c.chunk = nullptr;
+        c.chunkFill = nullptr;
+    }
+    for (Conn*& owner : chunkOwner_) owner = nullptr;
+    for (Conn*& owner : bodyOwner_) owner = nullptr;
+    formOwner_ = nullptr;
+    current_ = nullptr;
+    uploading_ = nullptr;
+    listener_ = halTcpListen(port_, 4);
+}
+
+void HttpServer::on(const char* uri, HTTPMethod method, Handler fn, Handler uploadFn)
+{
+    if (routeCount_ >= HTTP_MAX_ROUTES) return;
+    routes_[routeCount_++] = Route{uri, method, fn, uploadFn};
+}
+
+void HttpServer::collectHeaders(const char* const names[], size_t count)
+{
+    collectCount_ = 0;
+    for (size_t i = 0; i < count && collectCount_ < HTTP_MAX_HEADERS; i++) collect_[collectCount_++] = names[i];
+}
+
+// --------------------------------------------------
+// Connection service
+// --------------------------------------------------
+void HttpServer::handleClient()
+{
+    if (listener_ < 0) return;
+
+    // Sleep until something is readable, unless there is work in hand.
+    int socks[HTTP_MAX_CONNECTIONS + 1];
+    bool readable[HTTP_MAX_CONNECTIONS + 1];
+    Conn* owner[HTTP_MAX_CONNECTIONS + 1];
+    int n = 0;
+    bool busy = false;
+    socks[n] = listener_;
+    owner[n++] = nullptr;
+    for (Conn& c : conns_) {
+        if (c.state == FREE) continue;
+        socks[n] = c.sock;
+        owner[n++] = &c;
+        if (c.state == SENDING || (c.state == HEAD && c.rxLen > 0)) busy = true;
+    }
+    halTcpWait(socks, n, busy ? 0 : HTTP_POLL_US, readable);
+
+    // Clients queued behind a full pool: end one more keep-alive
+    // connection per pass after its current response so slots turn over.
+    if (readable[0] && n == HTTP_MAX_CONNECTIONS + 1) retireBusiest();
+
+    const uint32_t now = millis();
+    for (int i = 1; i < n; i++) {
+        if (owner[i]->state != FREE) service(*owner[i], readable[i], now);
+    }
+    if (readable[0]) acceptClients();
+}
+
+void HttpServer::acceptClients()
+{
+    for (;;) {
+        Conn* slot = nullptr;
+        for (Conn& c : conns_) {
+            if (c.state == FREE) {
+                slot = &c;
+                break;
+            }
+        }
+        if (!slot) return;
+
+        const int sock = halTcpAccept(listener_);
+        if (sock < 0) return;
+
+        slot->sock = sock;
+        slot->state = HEAD;
+        slot->served = 0;
+        slot->retiring = false;
+        slot->rxLen = 0;
+        slot->lastActivityMs = millis();
+        resetRequest(*slot);
+        stats_.accepted++;
+
+        int open = 0;
+        for (const Conn& c : conns_) {
+            if (c.state != FREE) open++;
+        }
+        if (open > stats_.peak) stats_.peak = open;
+        if (open == HTTP_MAX_CONNECTIONS) evictIdle();
+    }
+}
+
+// Keeps one slot free for the next client by closing the keep-alive
+// connection that has been idle longest. Ones idle only briefly probably
+// have their next request on the wire and are left alone.
+void HttpServer::evictIdle()
+{
+    const uint32_t now = millis();
+    Conn* victim = nullptr;
+    for (Conn& c : conns_) {
+        if (c.state != HEAD || c.served == 0 || c.rxLen > 0 || c.requestStartMs) continue;
+        if (now - c.lastActivityMs < HTTP_EVICT_IDLE_MS) continue;
+        if (!victim || (int32_t)(c.lastActivityMs - victim->lastActivityMs) < 0) victim = &c;
+    }
+    if (victim) {
+        closeConn(*victim);
+        stats_.evicted++;
+    }
+}
+
+// Sockets are only read when select() says so; everything else here is
+// bookkeeping on buffered data and timeouts.
+void HttpServer::retireBusiest()
+{
+    Conn* victim = nullptr;
+    for (Conn& c : conns_) {
+        if (c.state == FREE || c.state == STREAM || c.retiring || !c.keepAlive) continue;
+        if (!victim || c.served > victim->served) victim = &c;
+    }
+    if (victim) victim->retiring = true;
+}
+
+void HttpServer::service(Conn& c, bool readable, uint32_t now)
+{
+    if (c.state == SENDING) {
+        // flush() moves lastActivityMs past now, so read the clock again.
+        if (flush(c)) {
+            finishResponse(c);
+        } else if (c.state == SENDING && millis() - c.lastActivityMs > HTTP_REQUEST_TIMEOUT_MS) {
+            closeConn(c);
+            stats_.timedOut++;
+        }
+        return;
+    }
+
+    // Read whatever fits. Streams only look for the peer closing.
+    if (c.state == STREAM) {
+        uint8_t scratch[64];
+        if (readable && halTcpRecv(c.sock, scratch, sizeof(scratch)) < 0) closeConn(c);
+        return;
+    }
+    // A long form body goes straight to formBuf_, and no further.
+    const bool inForm = formOwner_ == &c;
+    uint8_t* to = inForm ? formBuf_ + c.bodyRead : c.rx + c.rxLen;
+    const size_t room = inForm ? c.contentLength - c.bodyRead : sizeof(c.rx) - c.rxLen;
+    if (readable && room) {
+        const int n = halTcpRecv(c.sock, to, room);
+        if (n < 0) {
+            closeConn(c);
+            return;
+        }
+        if (n > 0) {
+            if (inForm) c.bodyRead += n;
+            else c.rxLen += n;
+            c.lastActivityMs = now;
+            if (!c.requestStartMs) c.requestStartMs = now ? now : 1;
+        }
+    }
+
+    // Body bytes may already be buffered behind the headers.
+    bool ready = false;
+    if (c.state == HEAD) ready = readHead(c);
+    if (c.state == BODY) ready = (formOwner_ == &c ? c.bodyRead : c.rxLen) >= c.contentLength;
+    else if (c.state == MULTIPART) ready = readMultipart(c);
+    if (c.state == FREE || c.state == SENDING) return;
+
+    if (ready) {
+        dispatch(c);
+        return;
+    }
+
+    // Headers must arrive promptly; a body only has to keep moving.
+    if (c.requestStartMs) {
+        const bool stalled = c.state == HEAD ? now - c.requestStartMs > HTTP_REQUEST_TIMEOUT_MS
+                                             : now - c.lastActivityMs > HTTP_REQUEST_TIMEOUT_MS;
+        if (stalled) {
+            closeConn(c);
+            stats_.timedOut++;
+        }
+    } else if (c.state == HEAD && now - c.lastActivityMs > HTTP_IDLE_TIMEOUT_MS) {
+        closeConn(c);
+    }
+}
+
+// Consumes header lines from rx. Returns true when a request without a
+// body is complete; otherwise moves to BODY/MULTIPART or keeps waiting.
+bool HttpServer::readHead(Conn& c)
+{
+    while (c.state == HEAD) {
+        uint8_t* nl = (uint8_t*)memchr(c.rx, '\n', c.rxLen);
+        if (!nl) {
+            if (c.rxLen == sizeof(c.rx)) reject(c, 431);
+            return false;
+        }
+
+        char* line = (char*)c.rx;
+        size_t lineLen = nl - c.rx;
+        if (lineLen && line[lineLen - 1] == '\r') lineLen--;
+        line[lineLen] = '\0';
+
+        const bool first = c.target[0] == '\0';
+        const bool end = lineLen == 0 && !first;
+        if (first) {
+            if (lineLen && !parseRequestLine(c, line)) return false;
+        } else if (!end) {
+            parseHeader(c, line);
+        }
+
+        const size_t used = nl - c.rx + 1;
+        memmove(c.rx, c.rx + used, c.rxLen - used);
+        c.rxLen -= used;
+
+        if (!end) continue;
+
+        if (c.boundary[0]) {
+            const Route* route = findRoute(c);
+            if (!route || !route->uploadFn) {
+                reject(c, 404);
+            } else if (uploading_) {
+                reject(c, 503);
+            } else {
+                uploading_ = &c;
+                c.state = MULTIPART;
+                c.multipartState = MP_PREAMBLE;
+                c.partIsFile = false;
+                c.bodyRead = 0;
+            }
+            return false;
+        }
+        if (c.contentLength == 0) return true;
+        if (c.contentLength > sizeof(c.rx)) {
+            if (!c.formBody || c.contentLength > HTTP_FORM_MAX) {
+                reject(c, 413);
+                return false;
+            }
+            if (formOwner_) {
+                reject(c, 503);
+                return false;
+            }
+            // All of rx is body: it is shorter than contentLength.
+            formOwner_ = &c;
+            memcpy(formBuf_, c.rx, c.rxLen);
+            c.bodyRead = c.rxLen;
+            c.rxLen = 0;
+        }
+        c.state = BODY;
+    }
+    return false;
+}
+
+bool HttpServer::parseRequestLine(Conn& c, char* line)
+{
+    char* sp1 = strchr(line, ' ');
+    char* sp2 = sp1 ? strchr(sp1 + 1, ' ') : nullptr;
+    if (!sp2) {
+        reject(c, 400);
+        return false;
+    }
+    *sp1 = '\0';
+    *sp2 = '\0';
+    if (!parseMethod(line, &c.method)) {
+        reject(c, 400);
+        return false;
+    }
+    const size_t len = sp2 - (sp1 + 1);
+    if (len >= sizeof(c.target) || len == 0) {
+        reject(c, len ? 414 : 400);
+        return false;
+    }
+    memcpy(c.target, sp1 + 1, len + 1);
+    c.http10 = strcmp(sp2 + 1, "HTTP/1.0") == 0;
+    c.keepAlive = !c.http10;
+    return true;
+}
+
+void HttpServer::parseHeader(Conn& c, char* line)
+{
+    char* v;
+    for (int i = 0; i < collectCount_; i++) {
+        if ((v = headerValue(line, collect_[i])) && strlen(v) < HTTP_HEADER_VALUE_MAX) strcpy(c.headers[i], v);
+    }
+    if ((v = headerValue(line, "Content-Length"))) {
+        c.contentLength = strtoul(v, nullptr, 10);
+    } else if ((v = headerValue(line, "Content-Type"))) {
+        if (!strncasecmp(v, "application/x-www-form-urlencoded", 33)) {
+            c.formBody = true;
+        } else if (!strncasecmp(v, "multipart/form-data", 19)) {
+            if (!headerParam(v, "boundary", c.boundary, sizeof(c.boundary))) c.boundary[0] = '\0';
+        }
+    } else if ((v = headerValue(line, "Connection"))) {
+        if (!strcasecmp(v, "close")) c.keepAlive = false;
+        else if (!strcasecmp(v, "keep-alive")) c.keepAlive = true;
+    }
+}
+
+// --------------------------------------------------
+// multipart/form-data: file parts go to the route's upload handler in
+// HTTP_UPLOAD_BUFLEN chunks, other parts are skipped
+// --------------------------------------------------
+bool HttpServer::readMultipart(Conn& c)
+{
+    char delim[sizeof(c.boundary) + 4];
+    const size_t delimLen = snprintf(delim, sizeof(delim), "\r\n--%s", c.boundary);
+
+    for (;;) {
+        size_t avail = c.rxLen;
+        if (avail > c.contentLength - c.bodyRead) avail = c.contentLength - c.bodyRead;
+        size_t used = 0;
+
+        if (c.multipartState == MP_PREAMBLE || c.multipartState == MP_HEADERS) {
+            uint8_t* nl = (uint8_t*)memchr(c.rx, '\n', avail);
+            if (!nl) {
+                if (avail == sizeof(c.rx)) reject(c, 431);
+                else if (c.bodyRead + avail >= c.contentLength) reject(c, 400);
+                return false;
+            }
+            char* line = (char*)c.rx;
+            size_t lineLen = nl - c.rx;
+            if (lineLen && line[lineLen - 1] == '\r') lineLen--;
+            line[lineLen] = '\0';
+            used = nl - c.rx + 1;
+
+            if (c.multipartState == MP_PREAMBLE) {
+                if (line[0] == '-' && line[1] == '-' && !strcmp(line + 2, c.boundary)) c.multipartState = MP_HEADERS;
+            } else if (lineLen == 0) {
+                if (c.partIsFile) {
+                    upload_.status = UPLOAD_FILE_START;
+                    upload_.totalSize = 0;
+                    upload_.currentSize = 0;
+                    runUpload(c);
+                }
+                c.multipartState = MP_DATA;
+            } else {
+                char* v = headerValue(line, "Content-Disposition");
+                char value[64];
+                if (v && headerParam(v, "filename", value, sizeof(value))) {
+                    upload_.filename = value;
+                    c.partIsFile = true;
+                    upload_.name = headerParam(v, "name", value, sizeof(value)) ? value : "";
+                } else if ((v = headerValue(line, "Content-Type"))) {
+                    upload_.type = v;
+                }
+            }
+        } else if (c.multipartState == MP_DATA) {
+            // Emit everything that cannot be the start of the delimiter.
+            size_t dataLen = avail;
+            bool found = false;
+            for (size_t i = 0; i + delimLen <= avail; i++) {
+                if (c.rx[i] == '\r' && !memcmp(c.rx + i, delim, delimLen)) {
+                    dataLen = i;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                dataLen = avail >= delimLen ? avail - (delimLen - 1) : 0;
+                if (c.bodyRead + avail >= c.contentLength) {
+                    reject(c, 400);
+                    return false;
+                }
+            }
+            multipartData(c, c.rx, dataLen);
+            used = dataLen + (found ? delimLen : 0);
+            if (found) c.multipartState = MP_DELIMITER;
+        } else if (c.multipartState == MP_DELIMITER) {
+            if (avail < 2) return false;
+            if (c.partIsFile) {
+                if (upload_.currentSize) {
+                    upload_.status = UPLOAD_FILE_WRITE;
+                    runUpload(c);
+                    upload_.totalSize += upload_.currentSize;
+                    upload_.currentSize = 0;
+                }
+                upload_.status = UPLOAD_FILE_END;
+                runUpload(c);
+                c.partIsFile = false;
+            }
+            c.multipartState = c.rx[0] == '-' && c.rx[1] == '-' ? MP_EPILOGUE : MP_HEADERS;
+            used = 2;
+        } else {
+            used = avail;
+        }
+
+        if (used == 0) return false;
+        memmove(c.rx, c.rx + used, c.rxLen - used);
+        c.rxLen -= used;
+        c.bodyRead += used;
+
+        if (c.bodyRead >= c.contentLength) {
+            if (c.multipartState != MP_EPILOGUE) {
+                reject(c, 400);
+                return false;
+            }
+            uploading_ = nullptr;
+            return true;
+        }
+    }
+}
+
+// The upload handler sees the request's query through arg().
+void HttpServer::runUpload(Conn& c)
+{
+    const Route* route = findRoute(c);
+    if (!route || !route->uploadFn) return;
+    Conn* saved = current_;
+    current_ = &c;
+    route->uploadFn();
+    current_ = saved;
+}
+
+void HttpServer::multipartData(Conn& c, const uint8_t* data, size_t len)
+{
+    if (!c.partIsFile) return;
+    while (len) {
+        size_t n = HTTP_UPLOAD_BUFLEN - upload_.currentSize;
+        if (n > len) n = len;
+        memcpy(upload_.buf + upload_.currentSize, data, n);
+        upload_.currentSize += n;
+        data += n;
+        len -= n;
+        if (upload_.currentSize == HTTP_UPLOAD_BUFLEN) {
+            upload_.status = UPLOAD_FILE_WRITE;
+            runUpload(c);
+            upload_.totalSize += upload_.currentSize;
+            upload_.currentSize = 0;
+        }
+    }
+}
+
+// --------------------------------------------------
+// Dispatch and responses
+// --------------------------------------------------
+const HttpServer::Route* HttpServer::findRoute(const Conn& c) const
+{
+    const size_t pathLen = strcspn(c.target, "?");
+    for (int i = 0; i < routeCount_; i++) {
+        const Route& r = routes_[i];
+        if (strlen(r.uri) == pathLen && !strncmp(r.uri, c.target, pathLen) &&
+            (r.method == HTTP_ANY || r.method == c.method)) {
+            return &r;
+        }
+    }
+    return nullptr;
+}
+
+void HttpServer::dispatch(Conn& c)
+{
+    c.bodyLen = c.state == BODY ? c.contentLength : 0;
+    current_ = &c;
+    headersLen_ = 0;
+    stats_.requests++;
+
+    const Route* route = findRoute(c);
+    if (route) route->fn();
+    else if (notFound_) notFound_();
+    else send(404, "text/plain", "Not found");
+
+    if (responding()) send(500, "text/plain", "No response");
+    current_ = nullptr;
+
+    if (c.state == FREE || c.state == STREAM) return;
+
+    // Drop the form body; anything after it is the next request.
+    if (formOwner_ == &c) {
+        formOwner_ = nullptr;
+    } else {
+        memmove(c.rx, c.rx + c.bodyLen, c.rxLen - c.bodyLen);
+        c.rxLen -= c.bodyLen;
+    }
+    c.bodyLen = 0;
+    if (c.state == SENDING && c.txSent == c.txLen) finishResponse(c);
+}
+
+void HttpServer::reject(Conn& c, int code)
+{
+    if (uploading_ == &c) {
+        upload_.status = UPLOAD_FILE_ABORTED;
+        runUpload(c);
+        uploading_ = nullptr;
+    }
+    stats_.rejected++;
+    c.keepAlive = false;
+    c.bodyLen = 0;
+    Conn* saved = current_;
+    current_ = &c;
+    headersLen_ = 0;
+    send(code, "text/plain", reason(code));
+    current_ = saved;
+}
+
+// A header that does not fit HTTP_HEADERS_MAX is left out.
+void HttpServer::sendHeader(const char* name, const char* value)
+{
+    const int n = snprintf(headers_ + headersLen_, sizeof(headers_) - headersLen_, "%s: %s\r\n", name, value);
+    if (n > 0 && (size_t)n < sizeof(headers_) - headersLen_) headersLen_ += n;
+    else headers_[headersLen_] = '\0';
+}
+
+bool HttpServer::responding() const
+{
+    return current_ && (current_->state == HEAD || current_->state == BODY || current_->state == MULTIPART);
+}
+
+// Status line and headers for a body of bodyLen bytes.
+void HttpServer::startResponse(Conn& c, int code, const char* contentType, size_t bodyLen)
+{
+    if (c.retiring) c.keepAlive = false;
+
+    // No length at all: a 204/304, or chunked to an HTTP/1.0 client that
+    // reads to the close.
+    char length[32] = "";
+    if (bodyLen == LENGTH_CHUNKED) {
+        if (!c.http10) strcpy(length, "Transfer-Encoding: chunked\r\n");
+    } else if (code != 204 && code != 304) {
+        snprintf(length, sizeof(length), "Content-Length: %u\r\n", (unsigned)bodyLen);
+    }
+
+    // Fits: 160 bytes at most before the headers, HTTP_HEADERS_MAX of them
+    int n = snprintf(c.head, sizeof(c.head),
+                     "HTTP/1.1 %d %s\r\n%sConnection: %s\r\n%s%s%s",
+                     code, reason(code), length, c.keepAlive ? "keep-alive" : "close",
+                     contentType ? "Content-Type: " : "", contentType ? contentType : "", contentType ? "\r\n" : "");
+    memcpy(c.head + n, headers_, headersLen_);
+    n += headersLen_;
+    memcpy(c.head + n, "\r\n", 2);
+    c.headLen = n + 2;
+    c.txStatic = nullptr;
+    c.txSent = 0;
+    c.closeAfterSend = !c.keepAlive;
+    c.state = SENDING;
+}
+
+void HttpServer::send(int code, const char* contentType, const char* content)
+{
+    sendCopy(code, contentType, content, strlen(content));
+}
+
+void HttpServer::sendCopy(int code, const char* contentType, const char* content, size_t len)
+{
+    if (!responding()) return;
+    Conn& c = *current_;
+    const State requestState = c.state;
+
+    startResponse(c, code, contentType, len);
+    if (c.method != HTTP_HEAD) {
+        if (c.headLen + len <= sizeof(c.head)) {
+            // Short bodies ride in the header segment.
+            memcpy(c.head + c.headLen, content, len);
+            c.headLen += len;
+        } else {
+            char* body = nullptr;
+            for (int i = 0; i < HTTP_BODY_SLOTS && !body && len <= HTTP_BODY_MAX; i++) {
+                if (!bodyOwner_[i]) {
+                    bodyOwner_[i] = &c;
+                    body = bodyBuf_[i];
+                }
+            }
+            if (!body) {
+                // Every slot busy, or a body only sendChunked() can carry
+                c.state = requestState;
+                headersLen_ = 0;
+                const int fallback = len > HTTP_BODY_MAX ? 500 : 503;
+                send(fallback, "text/plain", reason(fallback));
+                return;
+            }
+            memcpy(body, content, len);
+            c.txStatic = body;
+        }
+    }
+    c.txLen = c.headLen + (c.txStatic ? len : 0);
+    flush(c);
+}
+
+void HttpServer::send_P(int code, const char* contentType, const char* content)
+{
+    send_P(code, contentType, content, strlen(content));
+}
+
+void HttpServer::send_P(int code, const char* contentType, const char* content, size_t contentLength)
+{
+    if (!responding()) return;
+    Conn& c = *current_;
+
+    startResponse(c, code, contentType, contentLength);
+    if (c.method != HTTP_HEAD) c.txStatic = content;
+    c.txLen = c.headLen + (c.txStatic ? contentLength : 0);
+    flush(c);
+}
+
+void HttpServer::sendChunked(int code, const char* contentType, ChunkFiller fill, uint32_t cursor)
+{
+    if (!responding()) return;
+    Conn& c = *current_;
+
+    char* buf = nullptr;
+    if (c.method != HTTP_HEAD) {
+        for (int i = 0; i < HTTP_CHUNK_SLOTS && !buf; i++) {
+            if (!chunkOwner_[i]) {
+                chunkOwner_[i] = &c;
+                buf = chunkBuf_[i];
+            }
+        }
+        if (!buf) {
+            send(503, "text/plain", reason(503));
+            return;
+        }
+    }
+
+    if (c.http10) c.keepAlive = false;
+    startResponse(c, code, contentType, LENGTH_CHUNKED);
+    c.chunk = buf;
+    c.chunkFill = buf ? fill : nullptr;
+    c.chunkCursor = cursor;
+    c.chunkLast = false;
+    c.txLen = c.headLen;
+    flush(c);
+}
+
+// Sends as much of the pending response as the socket takes, refilling
+// the chunk buffer as it empties. Returns true once all of it is out.
+bool HttpServer::flush(Conn& c)
+{
+    do {
+        if (!flushSegment(c)) return false;
+    } while (nextChunk(c));
+    return true;
+}
+
+bool HttpServer::flushSegment(Conn& c)
+{
+    while (c.txSent < c.txLen) {
+        const char* p;
+        size_t n;
+        if (c.txSent < c.headLen) {
+            p = c.head + c.txSent;
+            n = c.headLen - c.txSent;
+        } else {
+            p = c.txStatic + (c.txSent - c.headLen);
+            n = c.txLen - c.txSent;
+        }
+
+        const int w = halTcpSend(c.sock, p, n);
+        if (w < 0) {
+            closeConn(c);
+            return false;
+        }
+        if (w == 0) return false;
+        c.txSent += w;
+        c.lastActivityMs = millis();
+    }
+    return true;
+}
+
+// Next chunk of a chunked body into the connection's slot; false once
+// the terminating chunk has gone out.
+bool HttpServer::nextChunk(Conn& c)
+{
+    if (!c.chunkFill || c.chunkLast) return false;
+
+    char* buf = c.chunk;
+    const size_t n = c.chunkFill(buf + 5, HTTP_CHUNK_SIZE, &c.chunkCursor);
+    if (c.http10) {
+        if (n == 0) return false;
+        memmove(buf, buf + 5, n);
+        c.txLen = n;
+    } else if (n == 0) {
+        memcpy(buf, "0\r\n\r\n", 5);
+        c.txLen = 5;
+        c.chunkLast = true;
+    } else {
+        char line[6];
+        snprintf(line, sizeof(line), "%03x\r\n", (unsigned)n);
+        memcpy(buf, line, 5);
+        memcpy(buf + 5 + n, "\r\n", 2);
+        c.txLen = n + 7;
+    }
+    c.headLen = 0;
+    c.txStatic = buf;
+    c.txSent = 0;
+    return true;
+}
+
+void HttpServer::releaseBuffers(Conn& c)
+{
+    for (Conn*& owner : chunkOwner_) {
+        if (owner == &c) owner = nullptr;
+    }
+    for (Conn*& owner : bodyOwner_) {
+        if (owner == &c) owner = nullptr;
+    }
+    if (formOwner_ == &c) formOwner_ = nullptr;
+    c.chunk = nullptr;
+    c.chunkFill = nullptr;
+}
+
+void HttpServer::finishResponse(Conn& c)
+{
+    c.headLen = 0;
+    c.txStatic = nullptr;
+    releaseBuffers(c);
+    if (c.closeAfterSend) {
+        closeConn(c);
+        return;
+    }
+    c.served++;
+    c.state = HEAD;
+    resetRequest(c);
+}
+
+void HttpServer::resetRequest(Conn& c)
+{
+    c.target[0] = '\0';
+    c.boundary[0] = '\0';
+    c.contentLength = 0;
+    c.bodyRead = 0;
+    c.bodyLen = 0;
+    c.formBody = false;
+    c.keepAlive = true;
+    c.http10 = false;
+    for (char* h : c.headers) h[0] = '\0';
+    c.method = HTTP_GET;
+    c.requestStartMs = 0;
+    c.txLen = 0;
+    c.txSent = 0;
+    c.closeAfterSend = false;
+}
+
+void HttpServer::closeConn(Conn& c)
+{
+    if (uploading_ == &c) {
+        upload_.status = UPLOAD_FILE_ABORTED;
+        runUpload(c);
+        uploading_ = nullptr;
+    }
+    halTcpClose(c.sock);
+    c.sock = -1;
+    c.state = FREE;
+    c.generation++;
+    c.rxLen = 0;
+    c.headLen = 0;
+    c.txStatic = nullptr;
+    releaseBuffers(c);
+}
+
+// --------------------------------------------------
+// Request accessors
+// --------------------------------------------------
+String HttpServer::uri() const
+{
+    if (!current_) return String();
+    String path(current_->target);
+    const int q = path.indexOf('?');
+    return q < 0 ? path : path.substring(0, q);
+}
+
+HTTPMethod HttpServer::method() const
+{
+    return current_ ? current_->method : HTTP_ANY;
+}
+
+// Query string first, then a form body. Any other body is "plain", as
+// in the Arduino WebServer.
+bool HttpServer::findArgValue(const char* name, const char** value, size_t* len, bool* encoded) const
+{
+    if (!current_) return false;
+    *encoded = true;
+    const char* q = strchr(current_->target, '?');
+    if (q && findArg(q + 1, strlen(q + 1), name, value, len)) return true;
+    if (!current_->formBody) {
+        if (!current_->bodyLen || strcmp(name, "plain")) return false;
+        *value = (const char*)current_->rx;
+        *len = current_->bodyLen;
+        *encoded = false;
+        return true;
+    }
+    return findArg((const char*)body(*current_), current_->bodyLen, name, value, len);
+}
+
+const char* HttpServer::findHeader(const char* name) const
+{
+    if (!current_) return nullptr;
+    for (int i = 0; i < collectCount_; i++) {
+        if (!strcasecmp(collect_[i], name)) return current_->headers[i][0] ? current_->headers[i] : nullptr;
+    }
+    return nullptr;
+}
+
+bool HttpServer::hasHeader(const char* name) const
+{
+    return findHeader(name) != nullptr;
+}
+
+String HttpServer::header(const char* name) const
+{
+    return String(findHeader(name));
+}
+
+bool HttpServer::hasArg(const char* name) const
+{
+    const char* value;
+    size_t len;
+    bool encoded;
+    return findArgValue(name, &value, &len, &encoded);
+}
+
+String HttpServer::arg(const char* name) const
+{
+    const char* value;
+    size_t len;
+    bool encoded;
+    String out;
+    if (!findArgValue(name, &value, &len, &encoded)) return out;
+    if (!encoded) {
+        out.concat(value, len);
+        return out;
+    }
+    out.reserve(len);
+    for (size_t i = 0; i < len;) out += urlDecodeChar(value, len, &i);
+    return out;
+}
+
+bool HttpServer::arg(const char* name, char* buf, size_t size) const
+{
+    const char* value;
+    size_t len;
+    bool encoded;
+    if (!size || !findArgValue(name, &value, &len, &encoded)) return false;
+    if (!encoded) {
+        if (len >= size) return false;
+        memcpy(buf, value, len);
+        buf[len] = '\0';
+        return true;
+    }
+    return urlDecode(value, len, buf, size) < size;
+}
+
+// --------------------------------------------------
+// Streams
+// --------------------------------------------------
+int HttpServer::beginStream(const char* header)
+{
+    if (!responding()) return -1;
+    Conn& c = *current_;
+    c.state = STREAM;
+    c.keepAlive = false;
+    c.rxLen = 0;
+    c.requestStartMs = 0;
+
+    const int stream = (c.generation << 8) | (int)(&c - conns_);
+    return streamWrite(stream, header, strlen(header)) ? stream : -1;
+}
+
+HttpServer::Conn* HttpServer::streamConn(int stream)
+{
+    const int index = stream & 0xFF;
+    if (stream < 0 || index >= HTTP_MAX_CONNECTIONS) return nullptr;
+    Conn& c = conns_[index];
+    if (c.state != STREAM || c.generation != (uint8_t)(stream >> 8)) return nullptr;
+    return &c;
+}
+
+bool HttpServer::streamWrite(int stream, const char* data, size_t len)
+{
+    Conn* c = streamConn(stream);
+    if (!c) return false;
+    // A partial event would corrupt the stream, so a full socket drops it.
+    if (halTcpSend(c->sock, data, len) != (int)len) {
+        closeConn(*c);
+        return false;
+    }
+    c->lastActivityMs = millis();
+    return true;
+}
+
+void HttpServer::streamClose(int stream)
+{
+    if (Conn* c = streamConn(stream)) closeConn(*c);
+}
+
+HttpServerStats HttpServer::stats() const
+{
+    HttpServerStats s = stats_;
+    s.open = 0;
+    for (const Conn& c : conns_) {
+        if (c.state != FREE) s.open++;
+    }
+    return s;
+}
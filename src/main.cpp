@@ -1,396 +1,762 @@
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WebServer.h>
 #include <PubSubClient.h>
-#include <ESPmDNS.h>
-#include <Update.h>
 #include <Preferences.h>
-#include <ESP32Ping.h>
+
+#include "antenna_switch.h"
+#include "band_decoder.h"
+#include "config_store.h"
+#include "event_log.h"
+#include "event_stream.h"
+#include "flex_radio.h"
+#include "hal.h"
+#include "heap_monitor.h"
+#include "html_template.h"
+#include "http_server.h"
+#include "metrics.h"
+#include "mqtt_command.h"
+#include "mqtt_outbox.h"
+#include "ota_update.h"
+#include "outputs.h"
+#include "relay_sequencer.h"
+#include "relay_task.h"
+#include "scheduler.h"
+#include "state_journal.h"
+#include "swr_monitor.h"
+#include "text_buffer.h"
+#include "tx_interlock.h"
+#include "udp_control.h"
+#include "web_assets.h"
+#include "wifi_supervisor.h"
 
 // --------------------------------------------------
 // WiFi CONFIG (defaults – can be changed in /settings)
 // --------------------------------------------------
 const char* HOSTNAME = "antenna-switch";
+const char* NTP_SERVER = "pool.ntp.org";    // wall clock for the scheduler
 
-struct WiFiSettings
-{
-    String ssid;
-    String password;
-    IPAddress gatewayIP;
-} wifiCfg;
+WiFiSettings wifiCfg;
 
 // --------------------------------------------------
 // MQTT CONFIG (defaults – can be changed in /settings)
 // --------------------------------------------------
-struct MqttSettings
-{
-    bool    enabled;
-    String  broker;
-    uint16_t port;
-    String  user;
-    String  password;
-    String  topicCmd;
-    String  topicState;
-} mqttCfg;
-
-// NVS
-Preferences prefs;
+MqttSettings mqttCfg;
 
 // --------------------------------------------------
-// GPIO – 4 outputs to antenna switch driver (+12 V select)
+// RELAY CONFIG (can be changed in /settings)
 // --------------------------------------------------
-const int ANT1_PIN = 16;
-const int ANT2_PIN = 17;
-const int ANT3_PIN = 18;
-const int ANT4_PIN = 19;
+RelaySettings relayCfg;
 
 // --------------------------------------------------
-// Globals
+// BAND DECODER CONFIG (can be changed in /settings)
 // --------------------------------------------------
-WiFiClient espClient;
-PubSubClient mqttClient(espClient);
-WebServer server(80);
+BandSettings bandCfg;
+TxSettings txCfg;
+UdpSettings udpCfg;
+SwrSettings swrCfg;
 
-int currentAntenna = 0;   // 0 = off, 1..4 = antenna
-
-// WiFi watchdog
-const unsigned long WIFI_CHECK_INTERVAL = 30000;   // Check every 30 seconds
-const int WIFI_MAX_RECONNECT_ATTEMPTS = 10;        // Reboot after this many failures
-unsigned long lastWifiCheck = 0;
-int wifiReconnectAttempts = 0;
+// NVS
+Preferences prefs;
 
 // --------------------------------------------------
-// MAIN UI (waterfall-style buttons, very clear state)
+// Globals
 // --------------------------------------------------
-const char INDEX_HTML[] PROGMEM = R"rawliteral(
-<!DOCTYPE html>
-<html>
-<head>
-<title>StationPilot Antenna Switch</title>
-<meta name="viewport" content="width=device-width, initial-scale=1">
-<style>
-body {
-  font-family: Arial,sans-serif;
-  background:#111;
-  color:#eee;
-  text-align:center;
-  padding:20px;
-}
-h1 { margin-bottom:5px; }
-a { color:#64b5f6; text-decoration:none; }
-.status {
-  font-size:20px;
-  margin:15px;
-  padding:10px 18px;
-  border-radius:10px;
-  background:#222;
-  display:inline-block;
-}
-button {
-  padding:16px;
-  margin:10px;
-  font-size:18px;
-  width:220px;
-  border:none;
-  border-radius:10px;
-  cursor:pointer;
-  background:#333;
-  color:white;
-  transition:0.2s;
-}
-button:hover { background:#444; }
-
-.active {
-  background:#00c853 !important;
-  color:black;
-  font-weight:bold;
-  box-shadow:0 0 20px #00ff00;
-  border:2px solid #afffaf;
-}
-.offActive {
-  background:#ff5252 !important;
-  color:black;
-  font-weight:bold;
-  box-shadow:0 0 20px #ff0000;
-  border:2px solid #ffaaaa;
-}
-.footer {
-  margin-top:20px;
-  font-size:12px;
-  color:#777;
-}
-.linkrow {
-  margin-top:10px;
-}
-</style>
-<script>
-async function setAnt(n){
-  await fetch('/set?ant='+n);
-  setTimeout(update,250);
-}
-
-async function update(){
-  try {
-    const r = await fetch('/state');
-    const j = await r.json();
-    const a = j.antenna;
-
-    const status = document.getElementById("status");
-    if(a === 0){
-      status.innerText = "Status: OFF";
-      status.style.background = "#330000";
-    } else {
-      status.innerText = "Status: ANTENNA " + a + " ACTIVE";
-      status.style.background = "#003300";
-    }
-
-    for(let i=0;i<=4;i++){
-      document.getElementById("btn"+i).classList.remove("active","offActive");
-    }
-
-    if(a === 0) {
-      document.getElementById("btn0").classList.add("offActive");
-    } else {
-      document.getElementById("btn"+a).classList.add("active");
-    }
-  } catch(e) {
-    console.error(e);
-  }
+WiFiClient espClient;
+PubSubClient mqttClient(espClient);
+const uint16_t MQTT_BUFFER_SIZE = SCHED_TEXT_MAX + MQTT_TOPIC_MAX + 8;   // a whole schedule batch
+
+HttpServer server(80);
+
+int currentAntenna = 0;   // 0 = off, n = antenna, -1 = several
+uint32_t currentOutputs = 0;
+uint32_t relayStateVersion = 0;   // last snapshot handled by serviceRelayState()
+uint64_t lastPassUs = 0;          // loop() entry, for the pass-time histogram
+uint64_t bootStartUs = 0;
+BootTimes bootTimes = {};
+unsigned long lastMqttAttemptMs = 0;
+bool mqttAttempted = false;       // since boot: the first attempt does not wait
+bool mqttUp = false;              // as last logged
+
+// Logs a startup milestone once
+void bootMark(uint32_t BootTimes::*field, const char* what)
+{
+    bootTimes.*field = (uint32_t)(halMicros() - bootStartUs);
+    Serial.printf("Boot: %s at %.1f ms\n", what, bootTimes.*field / 1000.0);
 }
 
-setInterval(update, 1500);
-</script>
-</head>
-<body onload="update()">
-
-<h1>StationPilot Antenna Switch</h1>
-<div id="status" class="status">Loading...</div>
-
-<div>
-  <button id="btn1" onclick="setAnt(1)">Antenna 1</button><br>
-  <button id="btn2" onclick="setAnt(2)">Antenna 2</button><br>
-  <button id="btn3" onclick="setAnt(3)">Antenna 3</button><br>
-  <button id="btn4" onclick="setAnt(4)">Antenna 4</button><br>
-  <button id="btn0" onclick="setAnt(0)">ALL OFF</button>
-</div>
-
-<div class="linkrow">
-  <a href="/settings">Settings</a> |
-  <a href="/update">Firmware Update</a>
-</div>
-
-<div class="footer">
-  StationPilot ESP32 Antenna Controller<br/>
-  Host: <span id="host">%HOST%</span>
-</div>
-
-<script>
-document.getElementById("host").textContent = window.location.hostname;
-</script>
-
-</body>
-</html>
-)rawliteral";
-
 // --------------------------------------------------
 // RELAY / ANTENNA CONTROL
 // --------------------------------------------------
 void applyRelayState()
 {
-    const bool ON  = HIGH;   // drive MOSFET/ULN input high
-    const bool OFF = LOW;
+    // The relay task drives the outputs; this returns immediately.
+    relayPostOutputs(currentOutputs, RELAY_SRC_LOCAL, halMicros());
+}
 
-    // First: everything OFF
-    digitalWrite(ANT1_PIN, OFF);
-    digitalWrite(ANT2_PIN, OFF);
-    digitalWrite(ANT3_PIN, OFF);
-    digitalWrite(ANT4_PIN, OFF);
+bool setAntenna(int ant, RelaySource source, RelayPostResult* result)
+{
+    return relayPost(RELAY_SELECT, ant, source, halMicros(), result);
+}
 
-    delay(10); // small safety gap to avoid overlapping contacts
+bool setOutputs(uint32_t outputs, RelaySource source, RelayPostResult* result)
+{
+    return relayPostOutputs(outputs, source, halMicros(), result);
+}
 
-    // Then enable selected antenna
-    if (currentAntenna == 1) digitalWrite(ANT1_PIN, ON);
-    else if (currentAntenna == 2) digitalWrite(ANT2_PIN, ON);
-    else if (currentAntenna == 3) digitalWrite(ANT3_PIN, ON);
-    else if (currentAntenna == 4) digitalWrite(ANT4_PIN, ON);
+void relayStateJson(const RelaySnapshot& s, char* buf, size_t size)
+{
+    snprintf(buf, size, "{\"antenna\":%d,\"outputs\":%lu,\"count\":%d}", s.antenna, (unsigned long)s.outputs,
+             outputCount());
+}
 
-    Serial.printf("Active antenna: %d\n", currentAntenna);
+// A post's verdict for the caller: the selection it was taken as, or why
+// it was refused.
+void postResultJson(const RelayPostResult& r, char* buf, size_t size)
+{
+    if (r.verdict != RELAY_APPLIED && r.verdict != RELAY_HELD) {
+        snprintf(buf, size, "{\"error\":\"%s\",\"by\":\"%s\"}", relayVerdictName(r.verdict),
+                 r.verdict == RELAY_OUTRANKED ? relaySourceName(r.by) : "lock");
+        return;
+    }
+    snprintf(buf, size, "{\"antenna\":%d,\"outputs\":%lu,\"count\":%d,\"result\":\"%s\",\"superseded\":%s%s%s}",
+             outputsAntenna(r.outputs), (unsigned long)r.outputs, outputCount(), relayVerdictName(r.verdict),
+             r.superseded ? "\"" : "", r.superseded ? relaySourceName(r.by) : "null", r.superseded ? "\"" : "");
 }
 
-void setAntenna(int ant)
+// Queued in the outbox, sent once connected (see mqtt_outbox.h)
+void publishRelayState(const RelaySnapshot& s)
 {
-    if (ant < 0 || ant > 4) ant = 0;
-    currentAntenna = ant;
-    applyRelayState();
+    char payload[OUTPUT_SELECTION_MAX];
+    outputsFormatSelection(s.outputs, payload, sizeof(payload));
+    mqttOutboxSet(MQTT_KEY_STATE, payload);
+}
 
-    // Persist selection to NVS
-    prefs.begin("antSwitch", false);
-    prefs.putInt("lastAntenna", currentAntenna);
-    prefs.end();
+// <state topic>/telemetry, on connect and every MQTT_TELEMETRY_INTERVAL_MS
+void publishTelemetry()
+{
+    const RelayTaskStats r = relayTaskStats();
+    char payload[MQTT_OUTBOX_PAYLOAD_MAX + 1];
+    snprintf(payload, sizeof(payload),
+             "{\"uptime\":%lu,\"rssi\":%d,\"switches\":%lu,\"commands\":{\"local\":%lu,\"http\":%lu,"
+             "\"mqtt\":%lu,\"schedule\":%lu,\"band\":%lu,\"udp\":%lu,\"swr\":%lu},\"heap\":%lu}",
+             (unsigned long)(halMicros() / 1000000), (int)WiFi.RSSI(),
+             (unsigned long)relaySequencerStats().transitions, (unsigned long)r.latency[RELAY_SRC_LOCAL].count,
+             (unsigned long)r.latency[RELAY_SRC_HTTP].count, (unsigned long)r.latency[RELAY_SRC_MQTT].count,
+             (unsigned long)r.latency[RELAY_SRC_SCHEDULE].count, (unsigned long)r.latency[RELAY_SRC_BAND].count,
+             (unsigned long)r.latency[RELAY_SRC_UDP].count, (unsigned long)r.latency[RELAY_SRC_SWR].count,
+             (unsigned long)ESP.getFreeHeap());
+    mqttOutboxSet(MQTT_KEY_TELEMETRY, payload);
+}
 
-    if (mqttCfg.enabled && mqttCfg.broker.length() > 0) {
-        String payload = (ant == 0) ? "off" : String(ant);
-        mqttClient.publish(mqttCfg.topicState.c_str(), payload.c_str(), true);
-    }
+// Side effects of what the relay task applied; from loop() only.
+void serviceRelayState()
+{
+    const RelaySnapshot s = relaySnapshot();
+    if (s.version == relayStateVersion) return;
+    relayStateVersion = s.version;
+    currentAntenna = s.antenna;
+    currentOutputs = s.outputs;
+    Serial.printf("Active outputs: 0x%08lx\n", (unsigned long)currentOutputs);
+
+    // Persist selection (written to NVS once the switch goes quiet)
+    journalRecord(currentOutputs);
+
+    // Push to open dashboards
+    char state[64];
+    relayStateJson(s, state, sizeof(state));
+    eventStreamBroadcast(state);
+
+    if (mqttCfg.enabled && mqttCfg.broker.length() > 0) publishRelayState(s);
 }
 
 // --------------------------------------------------
 // HTTP HANDLERS – MAIN
 // --------------------------------------------------
+// Pages from web/, gzipped into flash at build time (tools/embed_web.py).
+// Browsers revalidate on every load and get a 304 while the build is the
+// same.
+void sendStaticPage(const uint8_t* gz, uint32_t len, const char* etag)
+{
+    server.sendHeader("ETag", etag);
+    server.sendHeader("Cache-Control", "no-cache");
+    const char* match = server.collectedHeader("If-None-Match");
+    if (match && strstr(match, etag)) {
+        server.send(304);
+        return;
+    }
+    server.sendHeader("Content-Encoding", "gzip");
+    server.send_P(200, "text/html", (const char*)gz, len);
+}
+
 void handleRoot()
 {
-    server.send_P(200, "text/html", INDEX_HTML);
+    sendStaticPage(WEB_INDEX_GZ, WEB_INDEX_GZ_LEN, WEB_INDEX_ETAG);
 }
 
+// ant=3, ant=1,3 (or 1+3) for several, or mask=<outputs> (decimal or 0x)
 void handleSet()
 {
-    if (!server.hasArg("ant")) {
+    uint32_t outputs = 0;
+    char arg[OUTPUT_SELECTION_MAX];
+    if (server.hasArg("mask")) {
+        char* end;
+        const bool ok = server.arg("mask", arg, sizeof(arg));
+        outputs = strtoul(arg, &end, 0);
+        if (!ok || !arg[0] || *end || (outputs & ~outputsAll())) {
+            server.send(400, "application/json", "{\"error\":\"bad mask\"}");
+            return;
+        }
+    } else if (server.hasArg("ant")) {
+        if (!server.arg("ant", arg, sizeof(arg)) || !outputsParseSelection(arg, strlen(arg), outputCount(), &outputs)) {
+            outputs = 0;
+        }
+    } else {
         server.send(400, "application/json", "{\"error\":\"missing ant parameter\"}");
         return;
     }
-    int ant = server.arg("ant").toInt();
-    setAntenna(ant);
+    RelayPostResult r;
+    setOutputs(outputs, RELAY_SRC_HTTP, &r);
+    if (r.verdict == RELAY_BUSY) {
+        server.send(503, "application/json", "{\"error\":\"relay queue full\"}");
+        return;
+    }
+    char resp[128];
+    postResultJson(r, resp, sizeof(resp));
+    server.send(r.verdict == RELAY_APPLIED || r.verdict == RELAY_HELD ? 200 : 409, "application/json", resp);
+}
 
-    String resp = "{\"antenna\":";
-    resp += String(currentAntenna);
-    resp += "}";
-    server.send(200, "application/json", resp);
+// /lock?on=1 or 0; without on, just the state. See relay_task.h.
+void handleLock()
+{
+    char arg[4];
+    if (server.arg("on", arg, sizeof(arg))) {
+        const bool on = strcmp(arg, "0") != 0;
+        relayArbiterLock(on);
+        eventLog(EVENT_LOCK, RELAY_SRC_HTTP, on, 0);
+    }
+    server.send(200, "application/json", relayTaskStats().locked ? "{\"locked\":true}" : "{\"locked\":false}");
 }
 
 void handleState()
 {
-    String resp = "{\"antenna\":";
-    resp += String(currentAntenna);
-    resp += "}";
+    char resp[64];
+    relayStateJson(relaySnapshot(), resp, sizeof(resp));
     server.send(200, "application/json", resp);
 }
 
-// --------------------------------------------------
-// MQTT SETTINGS (NVS + HTML form)
-// --------------------------------------------------
-void loadSettings()
+void handleEvents()
 {
-    prefs.begin("antSwitch", true); // read-only
+    if (eventStreamFull()) {
+        server.send(503, "text/plain", "Too many event clients");
+        return;
+    }
 
-    // WiFi settings
-    wifiCfg.ssid     = prefs.getString("wifiSSID",    "Livebox-C3B0");
-    wifiCfg.password = prefs.getString("wifiPass",    "");
-    uint32_t gwIP    = prefs.getUInt("gatewayIP",     IPAddress(192, 168, 1, 1));
-    wifiCfg.gatewayIP = IPAddress(gwIP);
+    char state[64];
+    relayStateJson(relaySnapshot(), state, sizeof(state));
+    eventStreamAdd(server, state);
+}
 
-    // MQTT settings
-    mqttCfg.enabled    = prefs.getBool("mqttEnabled", true);
-    mqttCfg.broker     = prefs.getString("mqttBroker",  "192.168.1.63");
-    mqttCfg.port       = prefs.getUShort("mqttPort",    1883);
-    mqttCfg.user       = prefs.getString("mqttUser",    "");
-    mqttCfg.password   = prefs.getString("mqttPass",    "");
-    mqttCfg.topicCmd   = prefs.getString("mqttCmd",     "stationpilot/antennaSwitch/cmd");
-    mqttCfg.topicState = prefs.getString("mqttState",   "stationpilot/antennaSwitch/state");
-    prefs.end();
+// Binary records after seq "since", see event_log.h
+void handleLog()
+{
+    char arg[12];
+    const uint32_t since = server.arg("since", arg, sizeof(arg)) ? strtoul(arg, nullptr, 10) : 0;
+    server.sendChunked(200, "application/octet-stream", eventLogFill, since + 1);
+}
 
-    Serial.println("Loaded settings:");
-    Serial.printf(" WiFi SSID: %s\n", wifiCfg.ssid.c_str());
-    Serial.printf(" Gateway IP: %s\n", wifiCfg.gatewayIP.toString().c_str());
-    Serial.printf(" MQTT enabled: %s\n", mqttCfg.enabled ? "yes" : "no");
-    Serial.printf(" Broker: %s:%u\n", mqttCfg.broker.c_str(), mqttCfg.port);
-    Serial.printf(" Cmd topic: %s\n", mqttCfg.topicCmd.c_str());
-    Serial.printf(" State topic: %s\n", mqttCfg.topicState.c_str());
+const char* jsonBool(bool b)
+{
+    return b ? "true" : "false";
 }
 
-void saveSettings()
+// /stats, a section per item (see textRenderItems); each module's
+// counters are read when their section is written.
+const uint32_t STATS_SWR_ANTENNAS = 15;      // item of the first antenna
+
+bool statsItem(uint32_t i, TextBuffer& out)
 {
-    prefs.begin("antSwitch", false);
+    typedef unsigned long UL;
+    static SwrStats sw;                      // per-antenna tables; off the stack
+    const int antennas = outputCount();
+    if (i >= STATS_SWR_ANTENNAS && i < STATS_SWR_ANTENNAS + (uint32_t)antennas) {
+        sw = swrMonitorStats();
+        const uint32_t n = i - STATS_SWR_ANTENNAS;
+        const SwrAntennaStats& a = sw.antennas[n];
+        out.printf("%s{\"txMs\":%lu,\"fwdMw\":%lu,\"reflMw\":%lu,\"swr\":%u,\"peakSwr\":%u,\"trips\":%lu}",
+                   n ? "," : "", (UL)a.txMs, (UL)a.fwdMw, (UL)a.reflMw, a.swr, a.peakSwr, (UL)a.trips);
+        return true;
+    }
+    if (i > STATS_SWR_ANTENNAS) i -= antennas;
+
+    switch (i) {
+    case 0: {
+        const JournalStats j = journalStats();
+        out.printf("{\"journal\":{\"recorded\":%lu,\"flushes\":%lu,\"bytes\":%lu,\"seq\":%u,\"pending\":%s}",
+                   (UL)j.recorded, (UL)j.flushes, (UL)j.bytesWritten, (unsigned)j.seq, jsonBool(j.pending));
+        return true;
+    }
+    case 1: {
+        const HttpServerStats h = server.stats();
+        out.printf(",\"http\":{\"open\":%u,\"peak\":%u,\"accepted\":%lu,\"requests\":%lu,\"evicted\":%lu,"
+                   "\"timedOut\":%lu,\"rejected\":%lu}",
+                   h.open, h.peak, (UL)h.accepted, (UL)h.requests, (UL)h.evicted, (UL)h.timedOut, (UL)h.rejected);
+        return true;
+    }
+    case 2: {
+        const WifiSupervisorStats w = wifiSupervisorStats();
+        out.printf(",\"wifi\":{\"state\":%d,\"rssi\":%d,\"outages\":%lu,\"attempts\":%lu,\"resets\":%lu,"
+                   "\"probes\":%lu,\"probeMisses\":%lu,\"rttMs\":%lu}",
+                   (int)w.state, (int)WiFi.RSSI(), (UL)w.outages, (UL)w.attempts, (UL)w.resets, (UL)w.probes,
+                   (UL)w.probeMisses, (UL)w.lastRttMs);
+        return true;
+    }
+    case 3: {
+        const MqttCommandStats m = mqttCommandStats();
+        const MqttOutboxStats mo = mqttOutboxStats();
+        const RelayLatency ml = relayTaskStats().latency[RELAY_SRC_MQTT];
+        out.printf(",\"mqtt\":{\"commands\":%lu,\"rejected\":%lu,\"unmatched\":%lu,\"lastUs\":%lu,\"maxUs\":%lu,"
+                   "\"avgUs\":%lu,\"overBudget\":%lu,\"published\":%lu,\"coalesced\":%lu,\"delivered\":%lu,"
+                   "\"resent\":%lu,\"undelivered\":%lu,\"pending\":%lu,\"ackMaxUs\":%lu,\"replied\":%lu,"
+                   "\"replyDropped\":%lu}",
+                   (UL)m.received, (UL)m.rejected, (UL)m.unmatched, (UL)ml.lastUs, (UL)ml.maxUs,
+                   (UL)(ml.count ? ml.totalUs / ml.count : 0), (UL)ml.overBudget, (UL)mo.published,
+                   (UL)mo.coalesced, (UL)mo.delivered, (UL)mo.resent, (UL)mo.undelivered, (UL)mo.pending,
+                   (UL)mo.maxAckUs, (UL)mo.replied, (UL)mo.replyDropped);
+        return true;
+    }
+    case 4: {
+        const RelayTaskStats r = relayTaskStats();
+        out.printf(",\"relay\":{\"posted\":%lu,\"dropped\":%lu,\"applied\":%lu,\"peakDepth\":%lu,\"httpMaxUs\":%lu,"
+                   "\"held\":%lu,\"superseded\":%lu,\"outranked\":%lu,\"lockedOut\":%lu,\"locked\":%s,"
+                   "\"windowMs\":%u}",
+                   (UL)r.posted, (UL)r.dropped, (UL)r.applied, (UL)r.peakDepth,
+                   (UL)r.latency[RELAY_SRC_HTTP].maxUs, (UL)r.held, (UL)r.superseded, (UL)r.outranked,
+                   (UL)r.lockedOut, jsonBool(r.locked), (unsigned)relayCfg.windowMs);
+        return true;
+    }
+    case 5: {
+        const SchedulerStats sc = schedulerStats();
+        out.printf(",\"schedule\":{\"entries\":%u,\"macros\":%u,\"running\":%d,\"clockSynced\":%s,\"fired\":%lu,"
+                   "\"dropped\":%lu,\"nextInMs\":%ld,\"maxLateUs\":%lu}",
+                   (unsigned)sc.entries, (unsigned)sc.macros, (int)sc.running, jsonBool(sc.clockSynced),
+                   (UL)sc.fired, (UL)sc.dropped, (long)sc.nextInMs,
+                   (UL)relayTaskStats().latency[RELAY_SRC_SCHEDULE].maxUs);
+        return true;
+    }
+    case 6: {
+        const OutputStats o = outputsStats();
+        out.printf(",\"outputs\":{\"count\":%d,\"driven\":%lu,\"writes\":%lu,\"transactions\":%lu,\"failures\":%lu}",
+                   outputCount(), (UL)outputsDriven(), (UL)o.writes, (UL)o.transactions, (UL)o.failures);
+        return true;
+    }
+    case 7: {
+        const BandDecoderStats b = bandDecoderStats();
+        const FlexRadioStats f = flexRadioStats();
+        const RelayLatency& bl = relayTaskStats().latency[RELAY_SRC_BAND];
+        out.printf(",\"band\":{\"bands\":%u,\"band\":%d,\"hz\":%lu,\"updates\":%lu,\"changes\":%lu,\"held\":%lu,"
+                   "\"unmapped\":%lu,\"refused\":%lu,\"maxProbes\":%lu,\"lastUs\":%lu,\"maxUs\":%lu,"
+                   "\"radioConnected\":%s,\"radioConnects\":%lu}",
+                   (unsigned)b.bands, (int)b.band, (UL)b.lastHz, (UL)b.updates, (UL)b.changes, (UL)b.held,
+                   (UL)b.unmapped, (UL)b.refused, (UL)b.maxProbes, (UL)bl.lastUs, (UL)bl.maxUs, jsonBool(f.connected),
+                   (UL)f.connects);
+        return true;
+    }
+    case 8: {
+        const TxInterlockStats t = txInterlockStats();
+        out.printf(",\"tx\":{\"enabled\":%s,\"transmitting\":%s,\"held\":%s,\"keyed\":%s,\"transmissions\":%lu,"
+                   "\"deferred\":%lu,\"keyedLate\":%lu,\"inhibited\":%lu,\"keyDelayUs\":%lu,\"maxKeyDelayUs\":%lu}",
+                   jsonBool(t.enabled), jsonBool(t.transmitting), jsonBool(t.held), jsonBool(t.keyed),
+                   (UL)t.transmissions, (UL)relaySequencerStats().deferred, (UL)t.keyedLate, (UL)t.inhibited,
+                   (UL)t.lastKeyDelayUs, (UL)t.maxKeyDelayUs);
+        return true;
+    }
+    case 9: {
+        const OtaStats u = otaStats();
+        out.printf(",\"ota\":{\"pending\":%s,\"confirmed\":%s,\"state\":%d,\"received\":%lu,\"written\":%lu,"
+                   "\"totalUs\":%lu,\"flashUs\":%lu,\"hashUs\":%lu,\"waitUs\":%lu,\"kbPerS\":%lu}",
+                   jsonBool(u.pending), jsonBool(u.confirmed), (int)u.state, (UL)u.received, (UL)u.written,
+                   (UL)u.totalUs, (UL)u.flashUs, (UL)u.hashUs, (UL)u.waitUs, (UL)u.kbPerS);
+        return true;
+    }
+    case 10: {
+        const UdpControlStats ud = udpControlStats();
+        const UdpBeaconStats ub = udpBeaconStats();
+        out.printf(",\"udp\":{\"received\":%lu,\"selects\":%lu,\"queries\":%lu,\"duplicates\":%lu,\"stale\":%lu,"
+                   "\"busy\":%lu,\"refused\":%lu,\"invalid\":%lu,\"badMac\":%lu,\"sessions\":%lu,\"ackMaxUs\":%lu,\"maxUs\":%lu,"
+                   "\"beacon\":{\"seq\":%lu,\"changes\":%lu,\"heartbeats\":%lu,\"coalesced\":%lu,\"failed\":%lu}}",
+                   (UL)ud.received, (UL)ud.selects, (UL)ud.queries, (UL)ud.duplicates, (UL)ud.stale, (UL)ud.busy,
+                   (UL)ud.refused, (UL)ud.invalid, (UL)ud.badMac, (UL)ud.sessions, (UL)ud.maxAckUs,
+                   (UL)relayTaskStats().latency[RELAY_SRC_UDP].maxUs, (UL)ub.seq, (UL)ub.changes, (UL)ub.heartbeats,
+                   (UL)ub.coalesced, (UL)ub.failed);
+        return true;
+    }
+    case 11: {
+        const ConfigStats cs = configStats();
+        out.printf(",\"config\":{\"version\":%u,\"bytes\":%u,\"loadUs\":%lu,\"saves\":%lu,\"unchanged\":%lu,"
+                   "\"bytesWritten\":%lu}",
+                   (unsigned)cs.version, (unsigned)cs.bytes, (UL)cs.loadUs, (UL)cs.saves, (UL)cs.unchanged,
+                   (UL)cs.bytesWritten);
+        return true;
+    }
+    case 12: {
+        const WifiSupervisorStats w = wifiSupervisorStats();
+        out.printf(",\"boot\":{\"relaysUs\":%lu,\"servicesUs\":%lu,\"wifiUs\":%lu,\"mqttUs\":%lu,\"wifiJoinMs\":%lu,"
+                   "\"cachedAp\":%s,\"staticIp\":%s}",
+                   (UL)bootTimes.relaysUs, (UL)bootTimes.servicesUs, (UL)bootTimes.wifiUs, (UL)bootTimes.mqttUs,
+                   (UL)w.joinMs, jsonBool(w.cachedJoin), jsonBool((uint32_t)wifiCfg.staticIP));
+        return true;
+    }
+    case 13: {
+        const EventLogStats el = eventLogStats();
+        out.printf(",\"log\":{\"next\":%lu,\"first\":%lu,\"pending\":%lu,\"lost\":%lu,\"flashRecords\":%lu,"
+                   "\"flushes\":%lu,\"flashBytes\":%lu,\"erases\":%lu,\"damaged\":%lu}",
+                   (UL)el.nextSeq, (UL)el.firstSeq, (UL)el.pending, (UL)el.lost, (UL)el.flashRecords,
+                   (UL)el.flushes, (UL)el.flashBytes, (UL)el.erases, (UL)el.damaged);
+        return true;
+    }
+    case 14:
+        sw = swrMonitorStats();
+        out.printf(",\"swr\":{\"enabled\":%s,\"antenna\":%d,\"transmitting\":%s,\"frames\":%lu,\"points\":%lu,"
+                   "\"skipped\":%lu,\"trips\":%lu,\"tripsRefused\":%lu,\"lastTripSwr\":%u,\"lastTripAntenna\":%d,"
+                   "\"maxFrameUs\":%lu,\"antennas\":[",
+                   jsonBool(sw.enabled), (int)sw.antenna, jsonBool(sw.transmitting), (UL)sw.frames, (UL)sw.points,
+                   (UL)sw.skipped, (UL)sw.trips, (UL)sw.tripsRefused, sw.lastTripSwr, (int)sw.lastTripAntenna,
+                   (UL)sw.maxFrameUs);
+        return true;
+    case STATS_SWR_ANTENNAS: {               // after the last antenna
+        const HeapStats hp = heapMonitorStats();
+        out.printf("]},\"heap\":{\"size\":%lu,\"free\":%lu,\"minFree\":%lu,\"maxFree\":%lu,\"largest\":%lu,"
+                   "\"minLargest\":%lu,\"bootFree\":%lu,\"bootLargest\":%lu},\"eventClients\":%d}",
+                   (UL)hp.size, (UL)hp.free, (UL)hp.minFree, (UL)hp.maxFree, (UL)hp.largest, (UL)hp.minLargest,
+                   (UL)hp.bootFree, (UL)hp.bootLargest, eventStreamClients());
+        return true;
+    }
+    default:
+        return false;
+    }
+}
 
-    // WiFi settings
-    prefs.putString("wifiSSID", wifiCfg.ssid);
-    prefs.putString("wifiPass", wifiCfg.password);
-    prefs.putUInt("gatewayIP", (uint32_t)wifiCfg.gatewayIP);
+size_t renderStats(char* buf, size_t size, uint32_t* cursor)
+{
+    return textRenderItems(statsItem, buf, size, cursor);
+}
 
-    // MQTT settings
-    prefs.putBool("mqttEnabled", mqttCfg.enabled);
-    prefs.putString("mqttBroker", mqttCfg.broker);
-    prefs.putUShort("mqttPort", mqttCfg.port);
-    prefs.putString("mqttUser", mqttCfg.user);
-    prefs.putString("mqttPass", mqttCfg.password);
-    prefs.putString("mqttCmd", mqttCfg.topicCmd);
-    prefs.putString("mqttState", mqttCfg.topicState);
-    prefs.end();
+void handleStats()
+{
+    server.sendChunked(200, "application/json", renderStats);
 }
 
-void handleSettingsGet()
+// Prometheus text format; histograms from metrics.cpp, the rest from the
+// counters the modules already keep, each read when its turn comes.
+const MetricValue METRIC_VALUES[] = {
+    {"antswitch_relay_switches_total", "Break/make cycles started", true,
+     [] { return (int64_t)relaySequencerStats().transitions; }},
+    {"antswitch_relay_retargets_total", "Commands folded into a running break/make", true,
+     [] { return (int64_t)relaySequencerStats().retargets; }},
+    {"antswitch_relay_deferred_total", "Commands held back by the TX interlock", true,
+     [] { return (int64_t)relaySequencerStats().deferred; }},
+    {"antswitch_relay_commands_dropped_total", "Commands refused by a full relay queue", true,
+     [] { return (int64_t)relayTaskStats().dropped; }},
+    {"antswitch_relay_commands_superseded_total", "Held commands replaced inside the coalescing window", true,
+     [] { return (int64_t)relayTaskStats().superseded; }},
+    {"antswitch_relay_commands_outranked_total", "Commands refused for a higher-priority source", true,
+     [] { return (int64_t)relayTaskStats().outranked; }},
+    {"antswitch_relay_commands_locked_out_total", "Commands refused or dropped by the manual lock", true,
+     [] { return (int64_t)relayTaskStats().lockedOut; }},
+    {"antswitch_relay_locked", "1 while the manual lock is on", false,
+     [] { return (int64_t)relayTaskStats().locked; }},
+    {"antswitch_relay_queue_peak", "Most commands waiting at one relay task wake-up", false,
+     [] { return (int64_t)relayTaskStats().peakDepth; }},
+    {"antswitch_antenna", "Selected antenna, 0 = off, -1 = several", false,
+     [] { return (int64_t)relaySnapshot().antenna; }},
+    {"antswitch_outputs", "Driven outputs, bit 0 = antenna 1", false, [] { return (int64_t)outputsDriven(); }},
+    {"antswitch_output_transactions_total", "Output bank writes (GPIO, latch or I2C)", true,
+     [] { return (int64_t)outputsStats().transactions; }},
+    {"antswitch_output_failures_total", "Expander writes not acknowledged", true,
+     [] { return (int64_t)outputsStats().failures; }},
+    {"antswitch_schedule_fired_total", "Schedule entries and macro steps posted", true,
+     [] { return (int64_t)schedulerStats().fired; }},
+    {"antswitch_band_changes_total", "Band changes posted by the band decoder", true,
+     [] { return (int64_t)bandDecoderStats().changes; }},
+    {"antswitch_band_updates_total", "Frequency updates received", true,
+     [] { return (int64_t)bandDecoderStats().updates; }},
+    {"antswitch_band_frequency_hz", "Last frequency received, 0 = none", false,
+     [] { return (int64_t)bandDecoderStats().lastHz; }},
+    {"antswitch_radio_connected", "1 while the FlexRadio status stream is up", false,
+     [] { return (int64_t)flexRadioStats().connected; }},
+    {"antswitch_tx_active", "1 while PTT is asserted", false, [] { return (int64_t)txInterlockStats().transmitting; }},
+    {"antswitch_tx_transmissions_total", "PTT assertions seen by the interlock", true,
+     [] { return (int64_t)txInterlockStats().transmissions; }},
+    {"antswitch_tx_inhibited_total", "Transmissions left unkeyed with no antenna connected", true,
+     [] { return (int64_t)txInterlockStats().inhibited; }},
+    {"antswitch_ota_pending", "1 while a new image waits for confirmation", false,
+     [] { return (int64_t)otaStats().pending; }},
+    {"antswitch_ota_kb_per_second", "Throughput of the last completed update", false,
+     [] { return (int64_t)otaStats().kbPerS; }},
+    {"antswitch_udp_commands_total", "UDP selections posted to the relay task", true,
+     [] { return (int64_t)udpControlStats().selects; }},
+    {"antswitch_udp_duplicates_total", "UDP retries answered from the cache", true,
+     [] { return (int64_t)udpControlStats().duplicates; }},
+    {"antswitch_udp_dropped_total", "UDP datagrams malformed or failing the MAC", true,
+     [] { return (int64_t)udpControlStats().invalid + udpControlStats().badMac; }},
+    {"antswitch_udp_beacons_total", "State beacons sent to the multicast group", true,
+     [] { return (int64_t)udpBeaconStats().seq; }},
+    {"antswitch_swr_trips_total", "High-SWR trips that turned the outputs off", true,
+     [] { return (int64_t)swrMonitorStats().trips; }},
+    {"antswitch_mqtt_messages_total", "Messages on the command topic", true,
+     [] { return (int64_t)mqttCommandStats().received; }},
+    {"antswitch_mqtt_rejected_total", "Command payloads that did not parse", true,
+     [] { return (int64_t)mqttCommandStats().rejected; }},
+    {"antswitch_mqtt_connected", "1 while connected to the broker", false,
+     [] { return (int64_t)mqttClient.connected(); }},
+    {"antswitch_mqtt_published_total", "Publishes sent by the outbox", true,
+     [] { return (int64_t)mqttOutboxStats().published; }},
+    {"antswitch_mqtt_coalesced_total", "Values replaced before they were sent", true,
+     [] { return (int64_t)mqttOutboxStats().coalesced; }},
+    {"antswitch_mqtt_delivered_total", "Publishes echoed back by the broker", true,
+     [] { return (int64_t)mqttOutboxStats().delivered; }},
+    {"antswitch_mqtt_resent_total", "Publishes repeated for want of an echo", true,
+     [] { return (int64_t)mqttOutboxStats().resent; }},
+    {"antswitch_mqtt_outbox_pending", "Keys not delivered yet", false,
+     [] { return (int64_t)mqttOutboxStats().pending; }},
+    {"antswitch_mqtt_replies_total", "Command replies published", true,
+     [] { return (int64_t)mqttOutboxStats().replied; }},
+    {"antswitch_mqtt_replies_dropped_total", "Command replies refused, the queue full", true,
+     [] { return (int64_t)mqttOutboxStats().replyDropped; }},
+    {"antswitch_http_requests_total", "HTTP requests handled", true, [] { return (int64_t)server.stats().requests; }},
+    {"antswitch_http_rejected_total", "HTTP 400/413/503 from the server itself", true,
+     [] { return (int64_t)server.stats().rejected; }},
+    {"antswitch_http_connections", "Open HTTP connections, event streams included", false,
+     [] { return (int64_t)server.stats().open; }},
+    {"antswitch_event_clients", "Open /events streams", false, [] { return (int64_t)eventStreamClients(); }},
+    {"antswitch_wifi_online", "1 while the gateway answers", false, [] { return (int64_t)wifiOnline(); }},
+    {"antswitch_wifi_rssi_dbm", "WiFi signal strength", false, [] { return (int64_t)WiFi.RSSI(); }},
+    {"antswitch_wifi_outages_total", "Online to offline transitions", true,
+     [] { return (int64_t)wifiSupervisorStats().outages; }},
+    {"antswitch_wifi_probe_misses_total", "Gateway probes without an answer", true,
+     [] { return (int64_t)wifiSupervisorStats().probeMisses; }},
+    {"antswitch_journal_flushes_total", "Antenna journal NVS writes", true,
+     [] { return (int64_t)journalStats().flushes; }},
+    {"antswitch_heap_free_bytes", "Free heap", false, [] { return (int64_t)ESP.getFreeHeap(); }},
+    {"antswitch_heap_min_free_bytes", "Lowest free heap since boot", false,
+     [] { return (int64_t)ESP.getMinFreeHeap(); }},
+    {"antswitch_heap_max_free_bytes", "Highest free heap sampled since boot", false,
+     [] { return (int64_t)heapMonitorStats().maxFree; }},
+    {"antswitch_heap_largest_free_block_bytes", "Largest free heap block", false,
+     [] { return (int64_t)ESP.getMaxAllocHeap(); }},
+    {"antswitch_heap_min_largest_free_block_bytes", "Smallest largest free block sampled since boot", false,
+     [] { return (int64_t)heapMonitorStats().minLargest; }},
+    {"antswitch_uptime_seconds", "Time since boot", false, [] { return (int64_t)(halMicros() / 1000000); }},
+};
+
+bool metricsItem(uint32_t i, TextBuffer& out)
 {
-    String html;
-    html.reserve(5000);
+    if (i < METRIC_HISTOGRAMS) return metricsWriteHistogram(i, out);
+    i -= METRIC_HISTOGRAMS;
+    if (i >= sizeof(METRIC_VALUES) / sizeof(METRIC_VALUES[0])) return false;
+    metricsWriteValue(METRIC_VALUES[i], out);
+    return true;
+}
 
-    html += F(
-"<!DOCTYPE html><html><head><title>Settings</title>"
-"<meta name='viewport' content='width=device-width,initial-scale=1'>"
-"<style>body{font-family:Arial;background:#111;color:#eee;padding:20px}"
-"label{display:block;margin-top:10px}"
-"input[type=text],input[type=number],input[type=password]{width:100%;padding:6px;margin-top:4px;border-radius:4px;border:1px solid #555;background:#222;color:#eee}"
-".box{background:#222;padding:15px;border-radius:10px;max-width:480px;margin:10px auto}"
-"h3{margin-top:0;color:#64b5f6;border-bottom:1px solid #444;padding-bottom:8px}"
-"button{margin-top:15px;padding:10px 18px;border:none;border-radius:6px;font-size:16px;cursor:pointer;background:#1e88e5;color:white}"
-".warn{background:#332200;border:1px solid #664400;padding:8px;border-radius:4px;margin-top:10px;font-size:12px}"
-"a{color:#64b5f6}</style></head><body><h2>Settings</h2>");
+size_t renderMetrics(char* buf, size_t size, uint32_t* cursor)
+{
+    return textRenderItems(metricsItem, buf, size, cursor);
+}
 
-    html += F("<form method='POST' action='/settings'>");
+void handleMetrics()
+{
+    server.sendChunked(200, "text/plain; version=0.0.4", renderMetrics);
+}
 
-    // WiFi Settings Section
-    html += F("<div class='box'><h3>WiFi Settings</h3>");
+// Flush write-behind state before any deliberate reboot.
+void restartDevice()
+{
+    journalFlush();
+    eventLogFlush();
+    ESP.restart();
+}
 
-    html += F("<label>SSID</label><input type='text' name='wifiSSID' value='");
-    html += wifiCfg.ssid;
-    html += F("'>");
+// --------------------------------------------------
+// SCHEDULE (batch text, see scheduler.h)
+// --------------------------------------------------
+// result: a summary, or the parse error.
+bool loadSchedule(const char* text, size_t len, char* result, size_t size)
+{
+    static Schedule parsed;   // ~800 bytes, off the loop() stack
+    if (!scheduleParse(text, len, &parsed, result, size)) return false;
 
-    html += F("<label>Password</label><input type='password' name='wifiPass' value='");
-    html += wifiCfg.password;
-    html += F("'>");
+    const bool saved = schedulerLoad(parsed);
+    const SchedulerStats s = schedulerStats();
+    snprintf(result, size, "%u entries, %u macros%s", s.entries, s.macros, saved ? "" : ", not saved to NVS");
+    return true;
+}
 
-    html += F("<label>Gateway IP (for ping check)</label><input type='text' name='gatewayIP' value='");
-    html += wifiCfg.gatewayIP.toString();
-    html += F("'>");
+bool scheduleLine(uint32_t line, TextBuffer& out)
+{
+    return scheduleFormat(schedulerCurrent(), line, out);
+}
 
-    html += F("<div class='warn'>Changing WiFi settings requires a reboot to take effect.</div>");
-    html += F("</div>");
+size_t renderSchedule(char* buf, size_t size, uint32_t* cursor)
+{
+    return textRenderItems(scheduleLine, buf, size, cursor);
+}
 
-    // MQTT Settings Section
-    html += F("<div class='box'><h3>MQTT Settings</h3>");
+void handleScheduleGet()
+{
+    server.sendChunked(200, "text/plain", renderSchedule);
+}
 
-    html += F("<label><input type='checkbox' name='mqttEnabled' ");
-    if (mqttCfg.enabled) html += F("checked");
-    html += F("> Enable MQTT</label>");
+// A request body as text/plain, or the form field; any body fits
+// HTTP_FORM_MAX, so nothing is cut.
+const char* postedText(const char* field, size_t* len)
+{
+    static char text[HTTP_FORM_MAX + 1];   // off the loop() stack
+    if (!server.arg("plain", text, sizeof(text)) && !server.arg(field, text, sizeof(text))) text[0] = '\0';
+    *len = strlen(text);
+    return text;
+}
 
-    html += F("<label>Broker</label><input type='text' name='mqttBroker' value='");
-    html += mqttCfg.broker;
-    html += F("'>");
+// Body as text/plain, or a form field "schedule"
+void handleSchedulePost()
+{
+    size_t len;
+    const char* text = postedText("schedule", &len);
+    char result[96];
+    if (!loadSchedule(text, len, result, sizeof(result))) {
+        server.send(400, "text/plain", result);
+        return;
+    }
+    server.send(200, "text/plain", result);
+}
 
-    html += F("<label>Port</label><input type='number' name='mqttPort' value='");
-    html += String(mqttCfg.port);
-    html += F("'>");
+// --------------------------------------------------
+// BAND PLAN (text, see band_decoder.h)
+// --------------------------------------------------
+bool bandPlanLine(uint32_t line, TextBuffer& out)
+{
+    return bandPlanFormat(bandDecoderPlan(), line, out);
+}
 
-    html += F("<label>User (optional)</label><input type='text' name='mqttUser' value='");
-    html += mqttCfg.user;
-    html += F("'>");
+size_t renderBandPlan(char* buf, size_t size, uint32_t* cursor)
+{
+    return textRenderItems(bandPlanLine, buf, size, cursor);
+}
+
+void handleBandPlanGet()
+{
+    server.sendChunked(200, "text/plain", renderBandPlan);
+}
 
-    html += F("<label>Password (optional)</label><input type='password' name='mqttPass' value='");
-    html += mqttCfg.password;
-    html += F("'>");
+// Body as text/plain, or a form field "bandplan"
+void handleBandPlanPost()
+{
+    static BandPlan parsed;   // ~400 bytes, off the loop() stack
+    size_t len;
+    const char* text = postedText("bandplan", &len);
+    char result[96];
+    if (!bandPlanParse(text, len, &parsed, result, sizeof(result))) {
+        server.send(400, "text/plain", result);
+        return;
+    }
+    const bool saved = bandDecoderLoad(parsed);
+    snprintf(result, sizeof(result), "%u bands%s", parsed.bands, saved ? "" : ", not saved to NVS");
+    server.send(200, "text/plain", result);
+}
+
+// --------------------------------------------------
+// MQTT SETTINGS (NVS + HTML form)
+// --------------------------------------------------
+void loadSettings()
+{
+    configLoad();
+
+    const ConfigStats c = configStats();
+    static const char* const SOURCES[] = {"defaults", "per-key NVS, converted", "record"};
+    Serial.printf("Loaded settings (%s%s, %lu us):\n", SOURCES[c.source], c.corrupt ? ", bad record ignored" : "",
+                  (unsigned long)c.loadUs);
+    Serial.printf(" WiFi SSID: %s\n", wifiCfg.ssid.c_str());
+    Serial.printf(" Gateway IP: %s\n", wifiCfg.gatewayIP.toString().c_str());
+    Serial.printf(" MQTT enabled: %s\n", mqttCfg.enabled ? "yes" : "no");
+    Serial.printf(" Broker: %s:%u\n", mqttCfg.broker.c_str(), mqttCfg.port);
+    Serial.printf(" Cmd topic: %s\n", mqttCfg.topicCmd.c_str());
+    Serial.printf(" State topic: %s\n", mqttCfg.topicState.c_str());
+    Serial.printf(" Relay dead time: %u ms\n", relayCfg.deadTimeMs);
+    Serial.printf(" Output map: %s\n", relayCfg.outputMap.c_str());
+    Serial.printf(" Command window: %u ms, priorities local %u http %u mqtt %u schedule %u band %u udp %u\n",
+                  relayCfg.windowMs, relayCfg.priority[RELAY_SRC_LOCAL], relayCfg.priority[RELAY_SRC_HTTP],
+                  relayCfg.priority[RELAY_SRC_MQTT], relayCfg.priority[RELAY_SRC_SCHEDULE],
+                  relayCfg.priority[RELAY_SRC_BAND], relayCfg.priority[RELAY_SRC_UDP]);
+    Serial.printf(" Radio: %s slice %u\n", bandCfg.radioIP.toString().c_str(), bandCfg.slice);
+    Serial.printf(" PTT pin: %d%s, amp key pin: %d\n", txCfg.pttPin, txCfg.pttActiveLow ? " (active low)" : "",
+                  txCfg.ampKeyPin);
+    Serial.printf(" UDP control port: %u%s\n", udpCfg.port, udpCfg.key.length() ? " (keyed)" : "");
+    Serial.printf(" State beacons: %s:%u, heartbeat %u s\n", udpCfg.beaconGroup.toString().c_str(),
+                  udpCfg.beaconPort, udpCfg.beaconHeartbeatS);
+    Serial.printf(" SWR pins: %d/%d, trip %u.%02u, full scale %u W\n", swrCfg.fwdPin, swrCfg.reflPin,
+                  swrCfg.tripSwr / 100, swrCfg.tripSwr % 100, swrCfg.fullScaleW);
+}
 
-    html += F("<label>Command topic</label><input type='text' name='mqttCmd' value='");
-    html += mqttCfg.topicCmd;
-    html += F("'>");
+void saveSettings()
+{
+    configSave();
+}
 
-    html += F("<label>State topic</label><input type='text' name='mqttState' value='");
-    html += mqttCfg.topicState;
-    html += F("'>");
+// Form fields for relayCfg.priority, by RelaySource
+const char* const PRIORITY_ARGS[RELAY_SRC_SWR] = {"prioLocal", "prioHttp", "prioMqtt", "prioSchedule", "prioBand",
+                                                  "prioUdp"};
 
-    html += F("</div>");
+// Values for web/settings.html
+void settingsValue(const char* name, char* out, size_t size)
+{
+    if (!strcmp(name, "WIFI_SSID"))          snprintf(out, size, "%s", wifiCfg.ssid.c_str());
+    else if (!strcmp(name, "WIFI_PASS"))     snprintf(out, size, "%s", wifiCfg.password.c_str());
+    else if (!strcmp(name, "GATEWAY_IP"))    snprintf(out, size, "%s", wifiCfg.gatewayIP.toString().c_str());
+    else if (!strcmp(name, "STATIC_IP"))
+        snprintf(out, size, "%s", (uint32_t)wifiCfg.staticIP ? wifiCfg.staticIP.toString().c_str() : "");
+    else if (!strcmp(name, "SUBNET"))        snprintf(out, size, "%s", wifiCfg.subnet.toString().c_str());
+    else if (!strcmp(name, "MQTT_CHECKED"))  snprintf(out, size, "%s", mqttCfg.enabled ? "checked" : "");
+    else if (!strcmp(name, "MQTT_BROKER"))   snprintf(out, size, "%s", mqttCfg.broker.c_str());
+    else if (!strcmp(name, "MQTT_PORT"))     snprintf(out, size, "%u", mqttCfg.port);
+    else if (!strcmp(name, "MQTT_USER"))     snprintf(out, size, "%s", mqttCfg.user.c_str());
+    else if (!strcmp(name, "MQTT_PASS"))     snprintf(out, size, "%s", mqttCfg.password.c_str());
+    else if (!strcmp(name, "MQTT_CMD"))      snprintf(out, size, "%s", mqttCfg.topicCmd.c_str());
+    else if (!strcmp(name, "MQTT_STATE"))    snprintf(out, size, "%s", mqttCfg.topicState.c_str());
+    else if (!strcmp(name, "RELAY_DEAD_MS")) snprintf(out, size, "%u", relayCfg.deadTimeMs);
+    else if (!strcmp(name, "OUTPUT_MAP"))    snprintf(out, size, "%s", relayCfg.outputMap.c_str());
+    else if (!strcmp(name, "OUTPUT_COUNT"))  snprintf(out, size, "%d", outputCount());
+    else if (!strcmp(name, "RADIO_IP"))      snprintf(out, size, "%s", (uint32_t)bandCfg.radioIP ? bandCfg.radioIP.toString().c_str() : "");
+    else if (!strcmp(name, "RADIO_SLICE"))   snprintf(out, size, "%u", bandCfg.slice);
+    else if (!strcmp(name, "BAND_HYST_HZ"))  snprintf(out, size, "%lu", (unsigned long)bandCfg.hysteresisHz);
+    else if (!strcmp(name, "PTT_PIN"))       snprintf(out, size, "%d", txCfg.pttPin);
+    else if (!strcmp(name, "PTT_LOW_CHECKED")) snprintf(out, size, "%s", txCfg.pttActiveLow ? "checked" : "");
+    else if (!strcmp(name, "AMP_KEY_PIN"))   snprintf(out, size, "%d", txCfg.ampKeyPin);
+    else if (!strcmp(name, "UDP_PORT"))      snprintf(out, size, "%u", udpCfg.port);
+    else if (!strcmp(name, "UDP_KEY"))       snprintf(out, size, "%s", udpCfg.key.c_str());
+    else if (!strcmp(name, "BEACON_GROUP"))  snprintf(out, size, "%s", udpCfg.beaconGroup.toString().c_str());
+    else if (!strcmp(name, "BEACON_PORT"))   snprintf(out, size, "%u", udpCfg.beaconPort);
+    else if (!strcmp(name, "BEACON_HEARTBEAT_S")) snprintf(out, size, "%u", udpCfg.beaconHeartbeatS);
+    else if (!strcmp(name, "SWR_FWD_PIN"))   snprintf(out, size, "%d", swrCfg.fwdPin);
+    else if (!strcmp(name, "SWR_REFL_PIN"))  snprintf(out, size, "%d", swrCfg.reflPin);
+    else if (!strcmp(name, "SWR_TRIP"))      snprintf(out, size, "%u.%02u", swrCfg.tripSwr / 100, swrCfg.tripSwr % 100);
+    else if (!strcmp(name, "SWR_FULL_W"))    snprintf(out, size, "%u", swrCfg.fullScaleW);
+    else if (!strcmp(name, "CMD_WINDOW_MS")) snprintf(out, size, "%u", relayCfg.windowMs);
+    else if (!strncmp(name, "PRIO_", 5)) {
+        // PRIO_HTTP etc., by relaySourceName()
+        for (int i = 0; i < RELAY_SRC_SWR; i++) {
+            if (!strcasecmp(name + 5, relaySourceName((RelaySource)i))) snprintf(out, size, "%u", relayCfg.priority[i]);
+        }
+    }
+}
 
-    html += F("<div style='text-align:center'><button type='submit'>Save Settings</button></div>");
-    html += F("</form><p style='text-align:center'><a href='/'>Back to switch</a></p></body></html>");
+size_t renderSettings(char* buf, size_t size, uint32_t* cursor)
+{
+    return templateRender(WEB_SETTINGS_TEMPLATE, settingsValue, buf, size, cursor);
+}
 
-    server.send(200, "text/html", html);
+void handleSettingsGet()
+{
+    // Rendered into the server's chunk buffer as the socket drains
+    server.sendChunked(200, "text/html", renderSettings);
 }
 
 void applyMqttConfig()
@@ -403,47 +769,190 @@ void applyMqttConfig()
     mqttClient.setServer(mqttCfg.broker.c_str(), mqttCfg.port);
 }
 
+// Form values without a String (the body is decoded into buf)
+bool argLong(const char* name, long lo, long hi, long* v)
+{
+    char buf[16];
+    if (!server.arg(name, buf, sizeof(buf))) return false;
+    *v = constrain(strtol(buf, nullptr, 10), lo, hi);
+    return true;
+}
+
+// An address, or 0.0.0.0 for an empty field when empty is allowed
+bool argIp(const char* name, bool emptyOk, IPAddress* ip)
+{
+    char buf[16];
+    if (!server.arg(name, buf, sizeof(buf))) return false;
+    if (emptyOk && !buf[0]) {
+        *ip = IPAddress(0, 0, 0, 0);
+        return true;
+    }
+    return ip->fromString(buf);
+}
+
+// Sets *cfg (a String kept for NVS) from the field; true if it changed
+bool argText(const char* name, String* cfg)
+{
+    char buf[CONFIG_STRING_MAX + 1];
+    if (!server.arg(name, buf, sizeof(buf)) || !strcmp(buf, cfg->c_str())) return false;
+    *cfg = buf;
+    return true;
+}
+
 void handleSettingsPost()
 {
     bool wifiChanged = false;
+    bool outputsChanged = false;
+    bool txChanged = false;
+    bool udpChanged = false;
+    bool swrChanged = false;
+    char text[CONFIG_STRING_MAX + 1];
+    long v;
+
+    // Checks first: a bad value refuses the whole form
+    static const char* const TEXT_ARGS[] = {"wifiSSID", "wifiPass", "mqttBroker", "mqttUser", "mqttPass", "mqttCmd",
+                                            "mqttState"};
+    for (const char* name : TEXT_ARGS) {
+        if (server.hasArg(name) && !server.arg(name, text, sizeof(text))) {
+            snprintf(text, sizeof(text), "%s: too long", name);
+            server.send(400, "text/plain", text);
+            return;
+        }
+    }
+    char key[UDP_KEY_MAX + 1];
+    const bool hasKey = server.hasArg("udpKey");
+    if (hasKey && !server.arg("udpKey", key, sizeof(key))) {
+        server.send(400, "text/plain", "UDP key: too long");
+        return;
+    }
+    IPAddress beaconGroup = udpCfg.beaconGroup;
+    if (server.hasArg("beaconGroup") &&
+        (!argIp("beaconGroup", false, &beaconGroup) || ((uint32_t)beaconGroup & 0xF0) != 0xE0)) {
+        server.send(400, "text/plain", "Beacon group: not a multicast address");
+        return;
+    }
+    char spec[OUTPUT_MAP_MAX];
+    if (server.hasArg("outputMap")) {
+        if (!server.arg("outputMap", spec, sizeof(spec))) {
+            server.send(400, "text/plain", "Output map: too long");
+            return;
+        }
+        if (strcmp(spec, relayCfg.outputMap.c_str())) {
+            // Checked here, applied at boot: the banks are set up once.
+            static OutputMap parsed;
+            char error[64];
+            if (!outputMapParse(spec, &parsed, error, sizeof(error))) {
+                snprintf(text, sizeof(text), "Output map: %s", error);
+                server.send(400, "text/plain", text);
+                return;
+            }
+            relayCfg.outputMap = spec;
+            outputsChanged = true;
+        }
+    }
 
     // WiFi settings
-    if (server.hasArg("wifiSSID")) {
-        String newSSID = server.arg("wifiSSID");
-        if (newSSID != wifiCfg.ssid) wifiChanged = true;
-        wifiCfg.ssid = newSSID;
-    }
-    if (server.hasArg("wifiPass")) {
-        String newPass = server.arg("wifiPass");
-        if (newPass != wifiCfg.password) wifiChanged = true;
-        wifiCfg.password = newPass;
-    }
-    if (server.hasArg("gatewayIP")) {
-        IPAddress newGW;
-        if (newGW.fromString(server.arg("gatewayIP"))) {
-            wifiCfg.gatewayIP = newGW;
-        }
+    if (argText("wifiSSID", &wifiCfg.ssid)) wifiChanged = true;
+    if (argText("wifiPass", &wifiCfg.password)) wifiChanged = true;
+    IPAddress ip;
+    if (argIp("gatewayIP", false, &ip)) wifiCfg.gatewayIP = ip;
+    if (argIp("staticIP", true, &ip)) {
+        if ((uint32_t)ip != (uint32_t)wifiCfg.staticIP) wifiChanged = true;
+        wifiCfg.staticIP = ip;
+    }
+    if (argIp("subnet", false, &ip) && (uint32_t)ip != (uint32_t)wifiCfg.subnet) {
+        if ((uint32_t)wifiCfg.staticIP) wifiChanged = true;
+        wifiCfg.subnet = ip;
     }
 
     // MQTT settings
     mqttCfg.enabled = server.hasArg("mqttEnabled");
-    if (server.hasArg("mqttBroker")) mqttCfg.broker = server.arg("mqttBroker");
-    if (server.hasArg("mqttPort"))   mqttCfg.port   = server.arg("mqttPort").toInt();
-    if (server.hasArg("mqttUser"))   mqttCfg.user   = server.arg("mqttUser");
-    if (server.hasArg("mqttPass"))   mqttCfg.password = server.arg("mqttPass");
-    if (server.hasArg("mqttCmd"))    mqttCfg.topicCmd = server.arg("mqttCmd");
-    if (server.hasArg("mqttState"))  mqttCfg.topicState = server.arg("mqttState");
+    argText("mqttBroker", &mqttCfg.broker);
+    if (argLong("mqttPort", 0L, 65535L, &v)) mqttCfg.port = (uint16_t)v;
+    argText("mqttUser", &mqttCfg.user);
+    argText("mqttPass", &mqttCfg.password);
+    argText("mqttCmd", &mqttCfg.topicCmd);
+    argText("mqttState", &mqttCfg.topicState);
+
+    // Relay settings
+    if (argLong("relayDeadMs", 0L, 1000L, &v)) {
+        relayCfg.deadTimeMs = (uint16_t)v;
+        relaySequencerSetDeadTime(relayCfg.deadTimeMs * 1000UL);
+    }
+    if (argLong("cmdWindowMs", 0L, (long)RELAY_WINDOW_MAX_MS, &v)) relayCfg.windowMs = (uint16_t)v;
+    for (int i = 0; i < RELAY_SRC_SWR; i++) {
+        if (argLong(PRIORITY_ARGS[i], 0L, (long)RELAY_PRIORITY_MAX, &v)) relayCfg.priority[i] = (uint8_t)v;
+    }
+    relayArbiterConfigure(relayCfg.windowMs, relayCfg.priority);
+
+    // Band decoder settings; applied without a reboot
+    bool radioChanged = false;
+    if (argIp("radioIP", true, &ip)) {
+        radioChanged = (uint32_t)ip != (uint32_t)bandCfg.radioIP;
+        bandCfg.radioIP = ip;
+    }
+    if (argLong("radioSlice", 0L, (long)FLEX_SLICES - 1, &v)) {
+        radioChanged = radioChanged || v != bandCfg.slice;
+        bandCfg.slice = (uint8_t)v;
+    }
+    if (argLong("bandHystHz", 0L, 100000L, &v)) {
+        bandCfg.hysteresisHz = (uint32_t)v;
+        bandDecoderSetHysteresis(bandCfg.hysteresisHz);
+    }
+    if (radioChanged) flexRadioBegin((uint32_t)bandCfg.radioIP, bandCfg.slice);
+
+    // TX interlock settings; the interrupt is attached at boot. The form
+    // always carries pttPin, which says whether the checkbox was shown.
+    if (argLong("pttPin", -1L, 39L, &v)) {
+        TxSettings tx;
+        tx.pttPin       = (int8_t)v;
+        tx.pttActiveLow = server.hasArg("pttActiveLow");
+        tx.ampKeyPin    = argLong("ampKeyPin", -1L, 33L, &v) ? (int8_t)v : txCfg.ampKeyPin;
+        if (tx.ampKeyPin == tx.pttPin) tx.ampKeyPin = -1;
+        txChanged = tx.pttPin != txCfg.pttPin || tx.pttActiveLow != txCfg.pttActiveLow ||
+                    tx.ampKeyPin != txCfg.ampKeyPin;
+        txCfg = tx;
+    }
+
+    // UDP control; the port is bound at boot, a new key applies at once
+    if (argLong("udpPort", 0L, 65535L, &v)) {
+        udpChanged = v != udpCfg.port;
+        udpCfg.port = (uint16_t)v;
+    }
+    if (hasKey && strcmp(key, udpCfg.key.c_str())) {
+        udpCfg.key = key;
+        udpControlSetKey(key);
+    }
+    udpCfg.beaconGroup = beaconGroup;
+    if (argLong("beaconPort", 0L, 65535L, &v)) udpCfg.beaconPort = (uint16_t)v;
+    if (argLong("beaconHeartbeatS", 0L, 3600L, &v)) udpCfg.beaconHeartbeatS = (uint16_t)v;
+    udpBeaconConfigure((uint32_t)udpCfg.beaconGroup, udpCfg.beaconPort, udpCfg.beaconHeartbeatS);
+
+    // SWR monitor; the ADC starts at boot, limits apply at once
+    if (argLong("swrFwdPin", -1L, 39L, &v)) {
+        const int8_t fwd = (int8_t)v;
+        const int8_t refl = argLong("swrReflPin", -1L, 39L, &v) ? (int8_t)v : swrCfg.reflPin;
+        swrChanged = fwd != swrCfg.fwdPin || refl != swrCfg.reflPin;
+        swrCfg.fwdPin = fwd;
+        swrCfg.reflPin = refl;
+    }
+    if (server.arg("swrTrip", text, 16)) {
+        const double trip = strtod(text, nullptr);
+        swrCfg.tripSwr = trip < 1.1 ? 0 : (uint16_t)(constrain(trip, 1.1, 99.0) * 100 + 0.5);
+    }
+    if (argLong("swrFullW", 1L, 10000L, &v)) swrCfg.fullScaleW = (uint16_t)v;
+    swrMonitorSetLimits(swrCfg.tripSwr, swrCfg.fullScaleW);
 
     saveSettings();
     applyMqttConfig();
 
-    if (wifiChanged) {
-        server.send(200, "text/html",
+    if (wifiChanged || outputsChanged || txChanged || udpChanged || swrChanged) {
+        server.send_P(200, "text/html",
             "<!DOCTYPE html><html><head><meta name='viewport' content='width=device-width,initial-scale=1'>"
             "<style>body{font-family:Arial;background:#111;color:#eee;padding:40px;text-align:center}</style></head>"
-            "<body><h2>Settings Saved</h2><p>WiFi settings changed. Rebooting in 3 seconds...</p></body></html>");
+            "<body><h2>Settings Saved</h2><p>WiFi, output, TX interlock, UDP port or SWR pin settings changed. Rebooting in 3 seconds...</p></body></html>");
         delay(3000);
-        ESP.restart();
+        restartDevice();
     } else {
         server.sendHeader("Location", "/settings");
         server.send(303);
@@ -455,24 +964,51 @@ void handleSettingsPost()
 // --------------------------------------------------
 void mqttCallback(char* topic, byte* payload, unsigned int length)
 {
-    String msg;
-    msg.reserve(length);
-    for (unsigned int i = 0; i < length; i++)
-        msg += (char)payload[i];
+    if (mqttOutboxEcho(topic, payload, length)) return;
+    mqttDispatch(topic, payload, length);
+}
 
-    Serial.print("MQTT [");
-    Serial.print(topic);
-    Serial.print("] ");
-    Serial.println(msg);
+void handleMqttCommand(const MqttCommand& cmd)
+{
+    RelayPostResult r;
+    if (cmd.action == MQTT_CMD_NEXT) relayPost(RELAY_NEXT, 0, RELAY_SRC_MQTT, cmd.receivedUs, &r);
+    else if (cmd.action == MQTT_CMD_PREV) relayPost(RELAY_PREV, 0, RELAY_SRC_MQTT, cmd.receivedUs, &r);
+    else relayPostOutputs(cmd.outputs, RELAY_SRC_MQTT, cmd.receivedUs, &r);
+
+    if (r.verdict == RELAY_BUSY) Serial.printf("MQTT command %s dropped: relay queue full\n", cmd.id);
+    if (!cmd.id[0]) return;
+    Serial.printf("MQTT command %s %s\n", cmd.id, relayVerdictName(r.verdict));
+
+    // <state>/reply, for the caller that gave an id
+    char result[128];
+    char reply[MQTT_REPLY_MAX + 1];
+    postResultJson(r, result, sizeof(result));
+    snprintf(reply, sizeof(reply), "{\"id\":\"%s\",%s", cmd.id, result + 1);
+    if (!mqttOutboxReply(reply)) Serial.printf("MQTT reply to %s dropped: queue full\n", cmd.id);
+}
 
-    if (String(topic) == mqttCfg.topicCmd) {
-        msg.trim();
-        if (msg == "1") setAntenna(1);
-        else if (msg == "2") setAntenna(2);
-        else if (msg == "3") setAntenna(3);
-        else if (msg == "4") setAntenna(4);
-        else if (msg == "0" || msg.equalsIgnoreCase("off")) setAntenna(0);
+// <cmd topic>/schedule; the outcome goes to <state topic>/schedule.
+void handleMqttSchedule(const uint8_t* payload, unsigned int length)
+{
+    char result[96] = "error: ";
+    const bool ok = loadSchedule((const char*)payload, length, result + 7, sizeof(result) - 7);
+    const char* reply = ok ? result + 7 : result;
+    Serial.printf("MQTT schedule: %s\n", reply);
+
+    mqttOutboxSet(MQTT_KEY_SCHEDULE, reply);
+}
+
+// <cmd topic>/freq: the radio's frequency, "14074000" (Hz) or "14.074" (MHz)
+void handleMqttFrequency(const uint8_t* payload, unsigned int length)
+{
+    const uint64_t arrivedUs = halMicros();
+    const char* s = (const char*)payload;
+    while (length && (*s == ' ' || *s == '\t')) s++, length--;
+    while (length && (s[length - 1] == ' ' || s[length - 1] == '\t' || s[length - 1] == '\r' || s[length - 1] == '\n')) {
+        length--;
     }
+    uint32_t hz;
+    if (bandParseFrequency(s, length, &hz) && hz) bandDecoderFrequency(hz, arrivedUs);
 }
 
 void reconnectMqtt()
@@ -481,24 +1017,41 @@ void reconnectMqtt()
     if (mqttClient.connected()) return;
 
     Serial.print("Attempting MQTT connection...");
-    String clientId = String(HOSTNAME) + "-" + String((uint32_t)ESP.getEfuseMac(), HEX);
+    char clientId[48];
+    snprintf(clientId, sizeof(clientId), "%s-%lx", HOSTNAME, (unsigned long)(uint32_t)ESP.getEfuseMac());
 
+    const uint64_t t0 = halMicros();
     bool ok;
     if (mqttCfg.user.length() > 0) {
-        ok = mqttClient.connect(clientId.c_str(),
+        ok = mqttClient.connect(clientId,
                                 mqttCfg.user.c_str(),
                                 mqttCfg.password.c_str());
     } else {
-        ok = mqttClient.connect(clientId.c_str());
+        ok = mqttClient.connect(clientId);
     }
+    metricsObserve(METRIC_MQTT_CONNECT, (uint32_t)(halMicros() - t0));
 
     if (ok) {
         Serial.println("connected.");
+        mqttUp = true;
+        eventLog(EVENT_MQTT, 0, 1, 0);
+        if (!bootTimes.mqttUs) bootMark(&BootTimes::mqttUs, "MQTT up");
         mqttClient.setCallback(mqttCallback);
+        mqttRoutesClear();
+        mqttRouteAdd(mqttCfg.topicCmd.c_str(), handleMqttCommand);
         mqttClient.subscribe(mqttCfg.topicCmd.c_str());
-
-        String payload = (currentAntenna == 0) ? "off" : String(currentAntenna);
-        mqttClient.publish(mqttCfg.topicState.c_str(), payload.c_str(), true);
+        char topic[MQTT_TOPIC_MAX + 16];
+        snprintf(topic, sizeof(topic), "%s/schedule", mqttCfg.topicCmd.c_str());
+        mqttRouteAddPayload(topic, handleMqttSchedule);
+        mqttClient.subscribe(topic);
+        snprintf(topic, sizeof(topic), "%s/freq", mqttCfg.topicCmd.c_str());
+        mqttRouteAddPayload(topic, handleMqttFrequency);
+        mqttClient.subscribe(topic);
+
+        // Latest state and a telemetry record, whatever was missed while down
+        publishRelayState(relaySnapshot());
+        publishTelemetry();
+        mqttOutboxConnected();
     } else {
         Serial.print("failed, rc=");
         Serial.println(mqttClient.state());
@@ -510,52 +1063,45 @@ void reconnectMqtt()
 // --------------------------------------------------
 void handleUpdatePage()
 {
-    const char* page =
-"<!DOCTYPE html><html><head><title>Firmware Update</title>"
-"<meta name='viewport' content='width=device-width,initial-scale=1'>"
-"<style>body{font-family:Arial;background:#111;color:#eee;padding:20px}"
-".box{background:#222;padding:15px;border-radius:10px;max-width:480px;margin:0 auto}"
-"input{margin-top:10px}</style></head><body>"
-"<h2>Firmware Update</h2>"
-"<div class='box'>"
-"<form method='POST' action='/update' enctype='multipart/form-data'>"
-"<input type='file' name='firmware'><br>"
-"<input type='submit' value='Upload & Flash'>"
-"</form></div><p><a href='/'>Back to switch</a></p></body></html>";
-    server.send(200, "text/html", page);
+    sendStaticPage(WEB_UPDATE_GZ, WEB_UPDATE_GZ_LEN, WEB_UPDATE_ETAG);
 }
 
+// /update?size=<bytes>&sha256=<hex> (both optional, set by web/update.html)
 void handleUpdateUpload()
 {
     HTTPUpload& upload = server.upload();
 
     if (upload.status == UPLOAD_FILE_START) {
         Serial.printf("Update: %s\n", upload.filename.c_str());
-        if (!Update.begin()) { // use remaining space
-            Update.printError(Serial);
-        }
+        journalFlush();
+        otaBegin(strtoul(server.arg("size").c_str(), nullptr, 10), server.arg("sha256").c_str());
     } else if (upload.status == UPLOAD_FILE_WRITE) {
-        if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
-            Update.printError(Serial);
-        }
+        otaWrite(upload.buf, upload.currentSize);
     } else if (upload.status == UPLOAD_FILE_END) {
-        if (Update.end(true)) {
-            Serial.printf("Update Success: %u bytes\n", upload.totalSize);
-        } else {
-            Update.printError(Serial);
-        }
+        otaEnd();
+    } else if (upload.status == UPLOAD_FILE_ABORTED) {
+        otaAbort();
     }
 }
 
 void handleUpdateResult()
 {
-    if (Update.hasError()) {
-        server.send(500, "text/plain", "Update failed.");
-    } else {
-        server.send(200, "text/plain", "Update OK, restarting...");
-        delay(500);
-        ESP.restart();
+    const OtaStats o = otaStats();
+    if (o.state != OTA_DONE) {
+        char msg[96];
+        snprintf(msg, sizeof(msg), "Update failed: %s", o.state == OTA_FAILED ? o.error : "no image");
+        server.send(o.state == OTA_FAILED ? o.httpCode : 400, "text/plain", msg);
+        return;
     }
+    char hex[2 * SHA256_SIZE + 1];
+    sha256FormatHex(o.sha256, hex);
+    char msg[192];
+    snprintf(msg, sizeof(msg), "Update OK: %lu bytes in %lu.%03lu s (%lu KB/s), sha256 %s. Restarting...",
+             (unsigned long)o.received, (unsigned long)(o.totalUs / 1000000),
+             (unsigned long)(o.totalUs / 1000 % 1000), (unsigned long)o.kbPerS, hex);
+    server.send(200, "text/plain", msg);
+    delay(500);
+    restartDevice();
 }
 
 // --------------------------------------------------
@@ -563,9 +1109,21 @@ void handleUpdateResult()
 // --------------------------------------------------
 void setupHttpServer()
 {
+    static const char* const headers[] = {"If-None-Match"};
+    server.collectHeaders(headers, 1);
+
     server.on("/", HTTP_GET, handleRoot);
     server.on("/set", HTTP_GET, handleSet);
+    server.on("/lock", HTTP_GET, handleLock);
     server.on("/state", HTTP_GET, handleState);
+    server.on("/stats", HTTP_GET, handleStats);
+    server.on("/metrics", HTTP_GET, handleMetrics);
+    server.on("/events", HTTP_GET, handleEvents);
+    server.on("/log", HTTP_GET, handleLog);
+    server.on("/schedule", HTTP_GET, handleScheduleGet);
+    server.on("/schedule", HTTP_POST, handleSchedulePost);
+    server.on("/bandplan", HTTP_GET, handleBandPlanGet);
+    server.on("/bandplan", HTTP_POST, handleBandPlanPost);
 
     server.on("/settings", HTTP_GET, handleSettingsGet);
     server.on("/settings", HTTP_POST, handleSettingsPost);
@@ -581,155 +1139,138 @@ void setupHttpServer()
     Serial.println("HTTP server started on port 80");
 }
 
-// --------------------------------------------------
-// WIFI / MDNS
-// --------------------------------------------------
-void connectWiFi()
-{
-    Serial.printf("Connecting to WiFi: %s\n", wifiCfg.ssid.c_str());
-
-    WiFi.mode(WIFI_STA);
-    WiFi.setHostname(HOSTNAME);
-    WiFi.begin(wifiCfg.ssid.c_str(), wifiCfg.password.c_str());
-
-    int retries = 0;
-    while (WiFi.status() != WL_CONNECTED && retries < 60) {
-        delay(250);
-        Serial.print(".");
-        retries++;
-    }
-    Serial.println();
-
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("WiFi connected.");
-        Serial.print("IP: ");
-        Serial.println(WiFi.localIP());
-        wifiReconnectAttempts = 0;  // Reset counter on successful connection
-    } else {
-        Serial.println("WiFi connection failed, continuing anyway.");
-    }
-
-    if (MDNS.begin(HOSTNAME)) {
-        MDNS.addService("http", "tcp", 80);
-        Serial.printf("mDNS: http://%s.local\n", HOSTNAME);
-    }
-}
-
-void checkWiFiConnection()
-{
-    unsigned long now = millis();
-
-    // Only check periodically
-    if (now - lastWifiCheck < WIFI_CHECK_INTERVAL) {
-        return;
-    }
-    lastWifiCheck = now;
-
-    // Check WiFi status AND ping gateway to verify real connectivity
-    bool connected = (WiFi.status() == WL_CONNECTED);
-    if (connected) {
-        Serial.print("Pinging gateway... ");
-        connected = Ping.ping(wifiCfg.gatewayIP, 2);  // 2 attempts
-        Serial.println(connected ? "OK" : "FAILED");
-    }
-
-    if (connected) {
-        wifiReconnectAttempts = 0;  // Reset counter when connected
-        return;
-    }
-
-    // WiFi disconnected - attempt reconnect
-    wifiReconnectAttempts++;
-    Serial.printf("WiFi disconnected. Reconnect attempt %d/%d\n",
-                  wifiReconnectAttempts, WIFI_MAX_RECONNECT_ATTEMPTS);
-
-    if (wifiReconnectAttempts >= WIFI_MAX_RECONNECT_ATTEMPTS) {
-        Serial.println("Max reconnect attempts reached. Rebooting...");
-        delay(1000);
-        ESP.restart();
-    }
-
-    // Attempt reconnection
-    WiFi.disconnect();
-    delay(100);
-    WiFi.begin(wifiCfg.ssid.c_str(), wifiCfg.password.c_str());
-
-    // Wait up to 10 seconds for connection
-    int retries = 0;
-    while (WiFi.status() != WL_CONNECTED && retries < 40) {
-        delay(250);
-        Serial.print(".");
-        retries++;
-    }
-    Serial.println();
-
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("WiFi reconnected.");
-        Serial.print("IP: ");
-        Serial.println(WiFi.localIP());
-        wifiReconnectAttempts = 0;
-
-        // Restart mDNS after reconnection
-        MDNS.end();
-        if (MDNS.begin(HOSTNAME)) {
-            MDNS.addService("http", "tcp", 80);
-            Serial.printf("mDNS restarted: http://%s.local\n", HOSTNAME);
-        }
-    } else {
-        Serial.println("WiFi reconnect failed.");
-    }
-}
-
 // --------------------------------------------------
 // SETUP & LOOP
 // --------------------------------------------------
+// The relays come back first, straight from NVS; every service starts
+// listening next and the network joins in the background (see
+// wifi_supervisor.h), so nothing here waits for the AP.
 void setup()
 {
+    bootStartUs = halMicros();
+    bootTimes = BootTimes();
+    mqttAttempted = false;
+    mqttUp = false;
     Serial.begin(115200);
-    delay(300);
     Serial.println("\n=== StationPilot ESP32 Antenna Switch ===");
-
-    pinMode(ANT1_PIN, OUTPUT);
-    pinMode(ANT2_PIN, OUTPUT);
-    pinMode(ANT3_PIN, OUTPUT);
-    pinMode(ANT4_PIN, OUTPUT);
+    eventLogBegin();
 
     loadSettings();
+    metricsBegin();
+    lastPassUs = 0;
+
+    // Output banks, all off; a map that no longer parses falls back to the default
+    static OutputMap outputMap;
+    char error[64];
+    if (!outputMapParse(relayCfg.outputMap.c_str(), &outputMap, error, sizeof(error))) {
+        Serial.printf("Output map: %s, using \"%s\"\n", error, OUTPUT_MAP_DEFAULT);
+        outputMapParse(OUTPUT_MAP_DEFAULT, &outputMap, error, sizeof(error));
+    }
+    outputsBegin(outputMap);
 
-    // Restore last antenna position from NVS
+    // Restore last selection: newest journal record, or the single key
+    // written by older firmware
     prefs.begin("antSwitch", true);
-    int lastAnt = prefs.getInt("lastAntenna", 0);
+    int legacyAnt = prefs.getInt("lastAntenna", 0);
     prefs.end();
-    currentAntenna = lastAnt;
+    currentOutputs = journalBegin(outputBit(legacyAnt)) & outputsAll();
+    currentAntenna = outputsAntenna(currentOutputs);
+    relayTaskBegin(currentOutputs, relayCfg.deadTimeMs * 1000UL);
+    relayArbiterConfigure(relayCfg.windowMs, relayCfg.priority);
+    txInterlockBegin(TxInterlockConfig{txCfg.pttPin, txCfg.pttActiveLow, txCfg.ampKeyPin});
+    swrMonitorBegin(SwrConfig{swrCfg.fwdPin, swrCfg.reflPin, swrCfg.tripSwr, swrCfg.fullScaleW});
+    relayStateVersion = relaySnapshot().version;
     applyRelayState();
-    Serial.printf("Restored antenna position: %d\n", currentAntenna);
-    connectWiFi();
+    bootMark(&BootTimes::relaysUs, "relays restored");
+    Serial.printf("Restored outputs: 0x%08lx of %d\n", (unsigned long)currentOutputs, outputCount());
+    schedulerBegin();
+    bandDecoderBegin(bandCfg.hysteresisHz);
+    flexRadioBegin((uint32_t)bandCfg.radioIP, bandCfg.slice);
+    udpControlSetKey(udpCfg.key.c_str());
+    if (udpCfg.port && !udpControlBegin(udpCfg.port)) Serial.printf("UDP control: port %u unavailable\n", udpCfg.port);
+    udpBeaconBegin((uint32_t)udpCfg.beaconGroup, udpCfg.beaconPort, udpCfg.beaconHeartbeatS);
+    halClockSyncBegin(NTP_SERVER);
+    mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
+    mqttOutboxBegin(mqttClient, mqttCfg.topicState);
     applyMqttConfig();
     setupHttpServer();
+    otaHealthBegin();
+    wifiSupervisorBegin(HOSTNAME, wifiCfg.ssid, wifiCfg.password, wifiCfg.gatewayIP, wifiCfg.staticIP, wifiCfg.subnet);
+    bootMark(&BootTimes::servicesUs, "services up");
+    heapMonitorBegin();
 }
 
 void loop()
 {
+    // Pass-to-pass time, so it includes whatever ran between passes
+    const uint64_t passUs = halMicros();
+    if (lastPassUs) metricsObserve(METRIC_LOOP, (uint32_t)(passUs - lastPassUs));
+    lastPassUs = passUs;
+
     server.handleClient();
+    metricsObserve(METRIC_HTTP_SERVICE, (uint32_t)(halMicros() - passUs));
+
+    // Journal, dashboards and MQTT state for what the relay task applied
+    serviceRelayState();
+
+    // Multicast state beacons: on change, else the heartbeat
+    udpBeaconService();
+
+    // Re-plan the schedule when the wall clock syncs or steps
+    schedulerService();
+
+    // Write the antenna journal once switching has settled
+    journalService();
 
-    // Periodic WiFi check - reconnect or reboot if needed
-    checkWiFiConnection();
+    // Event stream heartbeat
+    eventStreamService();
 
-    // Skip MQTT handling if WiFi is disconnected
-    if (WiFi.status() != WL_CONNECTED) {
+    // Event log: batch to flash
+    eventLogService();
+
+    // Heap watermarks
+    heapMonitorService();
+
+    // WiFi events, gateway probe, reconnect backoff
+    wifiSupervisorService();
+    if (!bootTimes.wifiUs && wifiOnline()) bootMark(&BootTimes::wifiUs, "WiFi up");
+
+    // Radio status stream -> band decoder
+    flexRadioService(wifiOnline());
+
+    // Keep a freshly updated image once it has proven it can stay online
+    if (otaHealthService(wifiOnline())) {
+        Serial.println("OTA: image never got healthy, rolling back");
+        journalFlush();
+        eventLogFlush();
+        halOtaRollback();
+    }
+
+    // Skip MQTT handling while the link is down
+    if (!wifiOnline()) {
         return;
     }
 
     if (mqttCfg.enabled && mqttCfg.broker.length() > 0) {
         if (!mqttClient.connected()) {
-            static unsigned long lastAttempt = 0;
+            if (mqttUp) {
+                mqttUp = false;
+                eventLog(EVENT_MQTT, 0, 0, (uint32_t)mqttClient.state());
+            }
             unsigned long now = millis();
-            if (now - lastAttempt > 5000) {
-                lastAttempt = now;
+            if (!mqttAttempted || now - lastMqttAttemptMs > 5000) {
+                mqttAttempted = true;
+                lastMqttAttemptMs = now;
                 reconnectMqtt();
             }
         } else {
             mqttClient.loop();
+            static unsigned long lastTelemetry = 0;
+            if (millis() - lastTelemetry >= MQTT_TELEMETRY_INTERVAL_MS) {
+                lastTelemetry = millis();
+                publishTelemetry();
+            }
+            mqttOutboxService();
         }
     }
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "hal.h"
+#include "metrics.h"
+
+namespace {
+
+const uint32_t CMD_BOUNDS_US[] = {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+const uint32_t PASS_BOUNDS_US[] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000};
+const uint32_t CONNECT_BOUNDS_US[] = {1000, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000,
+                                      5000000};
+const uint32_t RTT_BOUNDS_US[] = {1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000};
+
+struct HistogramDef
+{
+    const char* name;
+    const char* help;
+    const char* labels;      // "" or key="value"
+    const uint32_t* bounds;
+    uint8_t count;
+};
+
+#define BOUNDS(a) a, (uint8_t)(sizeof(a) / sizeof(a[0]))
+
+const char CMD_NAME[] = "antswitch_command_latency_seconds";
+const char CMD_HELP[] = "Command arrival to relay sequencer request";
+
+// Same order as MetricHistogram; series of one family are adjacent.
+const HistogramDef DEFS[METRIC_HISTOGRAMS] = {
+    {CMD_NAME, CMD_HELP, "source=\"local\"", BOUNDS(CMD_BOUNDS_US)},
+    {CMD_NAME, CMD_HELP, "source=\"http\"", BOUNDS(CMD_BOUNDS_US)},
+    {CMD_NAME, CMD_HELP, "source=\"mqtt\"", BOUNDS(CMD_BOUNDS_US)},
+    {CMD_NAME, CMD_HELP, "source=\"schedule\"", BOUNDS(CMD_BOUNDS_US)},
+    {CMD_NAME, CMD_HELP, "source=\"band\"", BOUNDS(CMD_BOUNDS_US)},
+    {CMD_NAME, CMD_HELP, "source=\"udp\"", BOUNDS(CMD_BOUNDS_US)},
+    {CMD_NAME, CMD_HELP, "source=\"swr\"", BOUNDS(CMD_BOUNDS_US)},
+    {"antswitch_loop_seconds", "Time from one loop() pass to the next", "", BOUNDS(PASS_BOUNDS_US)},
+    {"antswitch_http_service_seconds", "Time in one server.handleClient() pass", "", BOUNDS(PASS_BOUNDS_US)},
+    {"antswitch_mqtt_connect_seconds", "MQTT reconnect attempt duration", "", BOUNDS(CONNECT_BOUNDS_US)},
+    {"antswitch_gateway_rtt_seconds", "Gateway probe round trip", "", BOUNDS(RTT_BOUNDS_US)},
+};
+
+#undef BOUNDS
+
+static_assert(sizeof(PASS_BOUNDS_US) / sizeof(PASS_BOUNDS_US[0]) <= METRIC_BUCKETS_MAX &&
+              sizeof(CONNECT_BOUNDS_US) / sizeof(CONNECT_BOUNDS_US[0]) <= METRIC_BUCKETS_MAX,
+              "raise METRIC_BUCKETS_MAX");
+
+MetricHistogramData histograms[METRIC_HISTOGRAMS];
+
+// Microseconds as decimal seconds without trailing zeros: 2500 -> 0.0025
+void formatSeconds(char* buf, size_t size, uint64_t us)
+{
+    const uint32_t frac = (uint32_t)(us % 1000000);
+    int n = snprintf(buf, size, "%llu", (unsigned long long)(us / 1000000));
+    if (frac) {
+        n += snprintf(buf + n, size - n, ".%06u", (unsigned)frac);
+        while (buf[n - 1] == '0') buf[--n] = '\0';
+    }
+}
+
+void writeHeader(TextBuffer& out, const char* name, const char* help, const char* type)
+{
+    out.printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// name + suffix + {labels,le="..."}, up to the value
+void writeSeries(TextBuffer& out, const char* name, const char* suffix, const char* labels, const char* le)
+{
+    out.add(name).add(suffix);
+    if (labels[0] || le) {
+        out.printf("{%s%s", labels, le && labels[0] ? "," : "");
+        if (le) out.printf("le=\"%s\"", le);
+        out.add("}");
+    }
+    out.add(" ");
+}
+
+} // namespace
+
+void metricsBegin()
+{
+    halCriticalEnter();
+    memset(histograms, 0, sizeof(histograms));
+    halCriticalExit();
+}
+
+void metricsObserve(MetricHistogram h, uint32_t us)
+{
+    const HistogramDef& def = DEFS[h];
+    uint8_t b = 0;
+    while (b < def.count && us > def.bounds[b]) b++;
+
+    halCriticalEnter();
+    MetricHistogramData& d = histograms[h];
+    d.buckets[b]++;
+    d.count++;
+    d.sumUs += us;
+    halCriticalExit();
+}
+
+MetricHistogramData metricsHistogram(MetricHistogram h)
+{
+    halCriticalEnter();
+    MetricHistogramData d = histograms[h];
+    halCriticalExit();
+    return d;
+}
+
+bool metricsWriteHistogram(uint32_t h, TextBuffer& out)
+{
+    if (h >= METRIC_HISTOGRAMS) return false;
+    const HistogramDef& def = DEFS[h];
+    const MetricHistogramData d = metricsHistogram((MetricHistogram)h);
+    if (h == 0 || DEFS[h - 1].name != def.name) writeHeader(out, def.name, def.help, "histogram");
+
+    uint32_t cumulative = 0;
+    for (uint8_t b = 0; b <= def.count; b++) {
+        cumulative += d.buckets[b];
+        char le[24] = "+Inf";
+        if (b < def.count) formatSeconds(le, sizeof(le), def.bounds[b]);
+        writeSeries(out, def.name, "_bucket", def.labels, le);
+        out.printf("%lu\n", (unsigned long)cumulative);
+    }
+    char sum[32];
+    formatSeconds(sum, sizeof(sum), d.sumUs);
+    writeSeries(out, def.name, "_sum", def.labels, nullptr);
+    out.printf("%s\n", sum);
+    writeSeries(out, def.name, "_count", def.labels, nullptr);
+    out.printf("%lu\n", (unsigned long)d.count);
+    return true;
+}
+
+void metricsWriteValue(const MetricValue& v, TextBuffer& out)
+{
+    writeHeader(out, v.name, v.help, v.counter ? "counter" : "gauge");
+    out.printf("%s %lld\n", v.name, (long long)v.read());
+}
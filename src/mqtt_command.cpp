@@ -0,0 +1,257 @@
+#include <string.h>
+
+#include <Arduino.h>
+
+#include "hal.h"
+#include "mqtt_command.h"
+#include "outputs.h"
+
+namespace {
+
+struct Route
+{
+    char     topic[MQTT_TOPIC_MAX];
+    uint16_t len;
+    uint32_t hash;
+    MqttCommandHandler fn;
+    MqttPayloadHandler raw;  // set instead of fn for payload routes
+};
+
+Route routes[MQTT_MAX_ROUTES];
+int routeCount = 0;
+MqttCommandStats stats = {};
+
+// FNV-1a over a NUL-terminated topic; also returns its length.
+uint32_t topicHash(const char* topic, size_t* len)
+{
+    uint32_t h = 2166136261u;
+    const char* p = topic;
+    while (*p) {
+        h ^= (uint8_t)*p++;
+        h *= 16777619u;
+    }
+    *len = (size_t)(p - topic);
+    return h;
+}
+
+// --------------------------------------------------
+// Payload parsing: a cursor over the caller's buffer
+// --------------------------------------------------
+struct Cursor
+{
+    const uint8_t* p;
+    const uint8_t* end;
+};
+
+bool isSpace(uint8_t c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+void skipSpace(Cursor& c)
+{
+    while (c.p < c.end && isSpace(*c.p)) c.p++;
+}
+
+bool consume(Cursor& c, char ch)
+{
+    skipSpace(c);
+    if (c.p >= c.end || *c.p != (uint8_t)ch) return false;
+    c.p++;
+    return true;
+}
+
+bool tokenIs(const uint8_t* s, size_t n, const char* word)
+{
+    size_t i = 0;
+    for (; i < n && word[i]; i++) {
+        uint8_t ch = s[i];
+        if (ch >= 'A' && ch <= 'Z') ch += 'a' - 'A';
+        if (ch != (uint8_t)word[i]) return false;
+    }
+    return i == n && !word[i];
+}
+
+// A bare command word or selection.
+bool parseToken(const uint8_t* s, size_t n, int count, MqttCommand* cmd)
+{
+    if (n == 0) return false;
+
+    if ((s[0] >= '0' && s[0] <= '9') || tokenIs(s, n, "off")) {
+        cmd->action = MQTT_CMD_SELECT;
+        return outputsParseSelection((const char*)s, n, count, &cmd->outputs);
+    }
+    if (tokenIs(s, n, "next")) {
+        cmd->action = MQTT_CMD_NEXT;
+        return true;
+    }
+    if (tokenIs(s, n, "prev")) {
+        cmd->action = MQTT_CMD_PREV;
+        return true;
+    }
+    return false;
+}
+
+// "..." -> contents, escapes left as they are.
+bool scanString(Cursor& c, const uint8_t** s, size_t* n)
+{
+    if (!consume(c, '"')) return false;
+    const uint8_t* start = c.p;
+    while (c.p < c.end && *c.p != '"') {
+        if (*c.p == '\\' && c.p + 1 < c.end) c.p++;
+        c.p++;
+    }
+    if (c.p >= c.end) return false;
+    *s = start;
+    *n = (size_t)(c.p - start);
+    c.p++;
+    return true;
+}
+
+// Number or true/false/null: runs up to the next delimiter.
+bool scanBare(Cursor& c, const uint8_t** s, size_t* n)
+{
+    skipSpace(c);
+    const uint8_t* start = c.p;
+    while (c.p < c.end && *c.p != ',' && *c.p != '}' && !isSpace(*c.p)) {
+        if (*c.p == '{' || *c.p == '[' || *c.p == '"') return false;
+        c.p++;
+    }
+    *s = start;
+    *n = (size_t)(c.p - start);
+    return *n > 0;
+}
+
+// "mask": decimal, at most count bits.
+bool parseMask(const uint8_t* s, size_t n, int count, MqttCommand* cmd)
+{
+    if (n == 0 || n > 10) return false;
+    uint64_t v = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        v = v * 10 + (s[i] - '0');
+    }
+    if (v >> count) return false;
+    cmd->action = MQTT_CMD_SELECT;
+    cmd->outputs = (uint32_t)v;
+    return true;
+}
+
+bool parseJson(Cursor c, int count, MqttCommand* cmd)
+{
+    if (!consume(c, '{')) return false;
+    bool haveAnt = false;
+
+    do {
+        const uint8_t* key;
+        size_t keyLen;
+        if (!scanString(c, &key, &keyLen) || !consume(c, ':')) return false;
+
+        skipSpace(c);
+        const bool quoted = c.p < c.end && *c.p == '"';
+        const uint8_t* val;
+        size_t valLen;
+        if (!(quoted ? scanString(c, &val, &valLen) : scanBare(c, &val, &valLen))) return false;
+
+        if (keyLen == 3 && !memcmp(key, "ant", 3)) {
+            if (!parseToken(val, valLen, count, cmd)) return false;
+            haveAnt = true;
+        } else if (keyLen == 4 && !memcmp(key, "mask", 4)) {
+            if (quoted || !parseMask(val, valLen, count, cmd)) return false;
+            haveAnt = true;
+        } else if (keyLen == 2 && !memcmp(key, "id", 2)) {
+            if (valLen > MQTT_CMD_ID_MAX) return false;
+            memcpy(cmd->id, val, valLen);
+            cmd->id[valLen] = '\0';
+        }
+    } while (consume(c, ','));
+
+    if (!consume(c, '}')) return false;
+    skipSpace(c);
+    return haveAnt && c.p == c.end;
+}
+
+} // namespace
+
+bool mqttParseCommand(const uint8_t* payload, size_t length, int count, MqttCommand* cmd)
+{
+    if (length > MQTT_PAYLOAD_MAX) return false;
+    cmd->action = MQTT_CMD_SELECT;
+    cmd->outputs = 0;
+    cmd->id[0] = '\0';
+    cmd->receivedUs = 0;
+
+    Cursor c = {payload, payload + length};
+    skipSpace(c);
+    while (c.end > c.p && isSpace(c.end[-1])) c.end--;
+
+    if (c.p < c.end && *c.p == '{') return parseJson(c, count, cmd);
+    return parseToken(c.p, (size_t)(c.end - c.p), count, cmd);
+}
+
+void mqttRoutesClear()
+{
+    routeCount = 0;
+}
+
+bool mqttRouteAdd(const char* topic, MqttCommandHandler fn)
+{
+    if (routeCount >= MQTT_MAX_ROUTES) return false;
+    Route& r = routes[routeCount];
+    size_t len;
+    r.hash = topicHash(topic, &len);
+    if (len >= MQTT_TOPIC_MAX) return false;
+    memcpy(r.topic, topic, len + 1);
+    r.len = (uint16_t)len;
+    r.fn = fn;
+    r.raw = nullptr;
+    routeCount++;
+    return true;
+}
+
+bool mqttRouteAddPayload(const char* topic, MqttPayloadHandler fn)
+{
+    if (!mqttRouteAdd(topic, nullptr)) return false;
+    routes[routeCount - 1].raw = fn;
+    return true;
+}
+
+void mqttDispatch(const char* topic, const uint8_t* payload, unsigned int length)
+{
+    const uint64_t t0 = halMicros();
+    size_t len;
+    const uint32_t hash = topicHash(topic, &len);
+
+    const Route* route = nullptr;
+    for (int i = 0; i < routeCount; i++) {
+        const Route& r = routes[i];
+        if (r.len == len && r.hash == hash && !memcmp(r.topic, topic, len)) {
+            route = &r;
+            break;
+        }
+    }
+    if (!route) {
+        stats.unmatched++;
+        return;
+    }
+
+    stats.received++;
+    if (route->raw) {
+        route->raw(payload, length);
+        return;
+    }
+
+    MqttCommand cmd;
+    if (!mqttParseCommand(payload, length, outputCount(), &cmd)) {
+        stats.rejected++;
+        Serial.printf("MQTT [%s] rejected: %.*s\n", topic, (int)(length < 64 ? length : 64), (const char*)payload);
+        return;
+    }
+    cmd.receivedUs = t0;
+    route->fn(cmd);
+}
+
+MqttCommandStats mqttCommandStats()
+{
+    return stats;
+}
@@ -0,0 +1,222 @@
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include <string.h>
+
+#include "hal.h"
+#include "mqtt_command.h"
+#include "mqtt_outbox.h"
+
+namespace {
+
+const char* const SUFFIX[MQTT_KEYS] = {"", "/telemetry", "/schedule"};
+const bool RETAIN[MQTT_KEYS] = {true, true, false};
+const char REPLY_SUFFIX[] = "/reply";
+
+struct Slot
+{
+    char     payload[MQTT_OUTBOX_PAYLOAD_MAX + 1];
+    uint16_t len;
+    uint32_t hash;           // of payload
+    bool     set;            // has a value
+    bool     dirty;          // value not sent yet
+    bool     inFlight;       // sent, no echo yet
+    uint8_t  attempts;       // publishes of this value
+    uint64_t sentUs;
+};
+
+struct Reply
+{
+    char     payload[MQTT_REPLY_MAX + 1];
+    uint16_t len;
+};
+
+PubSubClient* client = nullptr;
+const String* base = nullptr;
+Slot slots[MQTT_KEYS];
+Reply replies[MQTT_REPLY_QUEUE];
+uint8_t replyHead = 0;
+uint8_t replyCount = 0;
+uint8_t tokens = MQTT_PUBLISH_BURST;
+uint64_t refillUs = 0;
+MqttOutboxStats stats = {};
+
+uint32_t fnv1a(const uint8_t* p, size_t len)
+{
+    uint32_t h = 2166136261u;
+    while (len--) h = (h ^ *p++) * 16777619u;
+    return h;
+}
+
+void topicFor(int key, char* buf, size_t size)
+{
+    snprintf(buf, size, "%s%s", base->c_str(), SUFFIX[key]);
+}
+
+void refill(uint64_t now)
+{
+    const uint64_t intervalUs = (uint64_t)MQTT_PUBLISH_INTERVAL_MS * 1000;
+    if (tokens >= MQTT_PUBLISH_BURST) {
+        refillUs = now;
+        return;
+    }
+    const uint64_t earned = (now - refillUs) / intervalUs;
+    if (!earned) return;
+    tokens = earned >= (uint64_t)(MQTT_PUBLISH_BURST - tokens) ? MQTT_PUBLISH_BURST : tokens + (uint8_t)earned;
+    refillUs += earned * intervalUs;
+}
+
+} // namespace
+
+void mqttOutboxBegin(PubSubClient& c, const String& stateTopic)
+{
+    client = &c;
+    base = &stateTopic;
+    for (Slot& s : slots) s = Slot();
+    replyHead = replyCount = 0;
+    stats = MqttOutboxStats();
+    tokens = MQTT_PUBLISH_BURST;
+    refillUs = halMicros();
+}
+
+bool mqttOutboxSet(MqttKey key, const char* payload)
+{
+    const size_t len = strlen(payload);
+    if (len > MQTT_OUTBOX_PAYLOAD_MAX) return false;
+    Slot& s = slots[key];
+    const uint32_t hash = fnv1a((const uint8_t*)payload, len);
+    stats.queued++;
+
+    // Same value already sent or waiting: nothing new for subscribers
+    if (s.set && s.hash == hash && s.len == len && !memcmp(s.payload, payload, len)) return true;
+
+    if (s.dirty) stats.coalesced++;
+    memcpy(s.payload, payload, len + 1);
+    s.len = (uint16_t)len;
+    s.hash = hash;
+    s.set = true;
+    s.dirty = true;
+    s.inFlight = false;
+    s.attempts = 0;
+    return true;
+}
+
+bool mqttOutboxReply(const char* payload)
+{
+    const size_t len = strlen(payload);
+    if (len > MQTT_REPLY_MAX || replyCount == MQTT_REPLY_QUEUE) {
+        stats.replyDropped++;
+        return false;
+    }
+    Reply& r = replies[(replyHead + replyCount) % MQTT_REPLY_QUEUE];
+    memcpy(r.payload, payload, len + 1);
+    r.len = (uint16_t)len;
+    replyCount++;
+    return true;
+}
+
+void mqttOutboxConnected()
+{
+    char topic[MQTT_TOPIC_MAX + 16];
+    for (int k = 0; k < MQTT_KEYS; k++) {
+        topicFor(k, topic, sizeof(topic));
+        client->subscribe(topic);
+
+        Slot& s = slots[k];
+        if (!s.set) continue;
+        if (s.inFlight) stats.resent++;
+        if (s.inFlight || RETAIN[k]) s.dirty = true;
+        s.inFlight = false;
+        s.attempts = 0;
+    }
+}
+
+void mqttOutboxService()
+{
+    if (!client || !client->connected()) return;
+    const uint64_t now = halMicros();
+    refill(now);
+
+    for (Slot& s : slots) {
+        if (!s.inFlight || now - s.sentUs < (uint64_t)MQTT_ACK_TIMEOUT_MS * 1000) continue;
+        s.inFlight = false;
+        if (s.attempts >= MQTT_ACK_ATTEMPTS) {
+            stats.undelivered++;     // until the next value or reconnect
+            continue;
+        }
+        s.dirty = true;
+        stats.resent++;
+    }
+
+    char topic[MQTT_TOPIC_MAX + 16];
+    for (int k = 0; k < MQTT_KEYS; k++) {
+        Slot& s = slots[k];
+        if (!s.dirty) continue;
+        if (!tokens) {
+            stats.throttled++;
+            return;
+        }
+        topicFor(k, topic, sizeof(topic));
+        if (!client->publish(topic, (const uint8_t*)s.payload, s.len, RETAIN[k])) {
+            stats.failed++;
+            return;
+        }
+        tokens--;
+        stats.published++;
+        s.dirty = false;
+        s.inFlight = true;
+        s.attempts++;
+        s.sentUs = halMicros();
+    }
+
+    // Replies, oldest first; one that cannot go out now waits at the head
+    if (!replyCount) return;
+    snprintf(topic, sizeof(topic), "%s%s", base->c_str(), REPLY_SUFFIX);
+    while (replyCount) {
+        if (!tokens) {
+            stats.throttled++;
+            return;
+        }
+        const Reply& r = replies[replyHead];
+        if (!client->publish(topic, (const uint8_t*)r.payload, r.len, false)) {
+            stats.failed++;
+            return;
+        }
+        tokens--;
+        stats.published++;
+        stats.replied++;
+        replyHead = (replyHead + 1) % MQTT_REPLY_QUEUE;
+        replyCount--;
+    }
+}
+
+bool mqttOutboxEcho(const char* topic, const uint8_t* payload, unsigned int length)
+{
+    if (!base) return false;
+    const size_t n = base->length();
+    if (strncmp(topic, base->c_str(), n) != 0) return false;
+
+    for (int k = 0; k < MQTT_KEYS; k++) {
+        if (strcmp(topic + n, SUFFIX[k]) != 0) continue;
+        Slot& s = slots[k];
+        if (s.inFlight && s.len == length && s.hash == fnv1a(payload, length)) {
+            const uint32_t us = (uint32_t)(halMicros() - s.sentUs);
+            s.inFlight = false;
+            stats.delivered++;
+            stats.lastAckUs = us;
+            if (us > stats.maxAckUs) stats.maxAckUs = us;
+        }
+        return true;
+    }
+    return false;
+}
+
+MqttOutboxStats mqttOutboxStats()
+{
+    MqttOutboxStats s = stats;
+    s.pending = 0;
+    for (const Slot& slot : slots) {
+        if (slot.dirty || slot.inFlight) s.pending++;
+    }
+    s.replyQueued = replyCount;
+    return s;
+}
@@ -0,0 +1,283 @@
+#include <Arduino.h>
+#include <Update.h>
+#include <atomic>
+#include <string.h>
+
+#include "hal.h"
+#include "ota_update.h"
+
+namespace {
+
+const uint8_t  IMAGE_MAGIC = 0xE9;
+const uint16_t CHIP_ESP32  = 0x0000;
+
+struct Buffer
+{
+    uint8_t data[OTA_BUFFER_SIZE];
+    size_t  len;
+    std::atomic<bool> queued;
+};
+
+HalWorkerHandle worker = nullptr;
+Buffer buffers[OTA_BUFFERS];
+int fillIndex = 0;           // loop()
+int writeIndex = 0;          // OTA task
+std::atomic<bool> writeFailed(false);
+
+// OTA task while receiving, loop() once drained. The image's last
+// SHA256_SIZE bytes are its appended hash, so they are held back in tail
+// until the next data shows they were not the end.
+Sha256 hash;
+uint8_t tail[SHA256_SIZE];
+size_t tailLen = 0;
+
+bool hashAppended = false;
+bool haveExpected = false;
+uint8_t expected[SHA256_SIZE];
+uint64_t startUs = 0;
+OtaStats stats = {};
+
+// Health
+uint64_t bootUs = 0;
+uint64_t onlineSinceUs = 0;
+
+void hashLagged(const uint8_t* p, size_t n)
+{
+    if (n >= SHA256_SIZE) {
+        sha256Update(&hash, tail, tailLen);
+        sha256Update(&hash, p, n - SHA256_SIZE);
+        memcpy(tail, p + n - SHA256_SIZE, SHA256_SIZE);
+        tailLen = SHA256_SIZE;
+        return;
+    }
+    const size_t over = tailLen + n > SHA256_SIZE ? tailLen + n - SHA256_SIZE : 0;
+    sha256Update(&hash, tail, over);
+    memmove(tail, tail + over, tailLen - over);
+    tailLen -= over;
+    memcpy(tail + tailLen, p, n);
+    tailLen += n;
+}
+
+// OTA task body: hashes and writes every queued buffer, in order.
+void otaTaskRun()
+{
+    while (buffers[writeIndex].queued.load()) {
+        Buffer& b = buffers[writeIndex];
+        if (!writeFailed.load()) {
+            const uint64_t t0 = halMicros();
+            hashLagged(b.data, b.len);
+            const uint64_t t1 = halMicros();
+            const bool ok = Update.write(b.data, b.len) == b.len;
+            const uint64_t t2 = halMicros();
+            if (!ok) writeFailed = true;
+
+            halCriticalEnter();
+            stats.hashUs += (uint32_t)(t1 - t0);
+            stats.flashUs += (uint32_t)(t2 - t1);
+            if (ok) stats.written += b.len;
+            halCriticalExit();
+        }
+        b.queued = false;
+        writeIndex = (writeIndex + 1) % OTA_BUFFERS;
+    }
+}
+
+// Waits for the OTA task to finish everything queued.
+void drain()
+{
+    for (Buffer& b : buffers) {
+        while (b.queued.load()) delay(1);
+    }
+}
+
+bool fail(uint16_t code, const char* error)
+{
+    drain();
+    Update.abort();
+    halCriticalEnter();
+    stats.state = OTA_FAILED;
+    stats.httpCode = code;
+    snprintf(stats.error, sizeof(stats.error), "%s", error);
+    halCriticalExit();
+    Serial.printf("OTA: %s\n", error);
+    return false;
+}
+
+// Header of the first buffer, before anything reaches the flash.
+bool checkHeader(const Buffer& b)
+{
+    if (b.len < OTA_HEADER_SIZE || b.data[0] != IMAGE_MAGIC) return fail(400, "not an ESP32 app image");
+    if ((uint16_t)(b.data[12] | b.data[13] << 8) != CHIP_ESP32) return fail(400, "image is for another chip");
+    hashAppended = b.data[23] == 1;
+    return true;
+}
+
+// Hands buffers[fillIndex] to the OTA task and waits for the next one.
+bool submit()
+{
+    Buffer& b = buffers[fillIndex];
+    if (!b.len) return true;
+    if (stats.received == b.len && !checkHeader(b)) return false;
+
+    b.queued = true;
+    halWorkerNotify(worker);
+    fillIndex = (fillIndex + 1) % OTA_BUFFERS;
+
+    Buffer& next = buffers[fillIndex];
+    if (next.queued.load()) {
+        const uint64_t t0 = halMicros();
+        while (next.queued.load()) delay(1);
+        const uint32_t us = (uint32_t)(halMicros() - t0);
+        halCriticalEnter();
+        stats.waits++;
+        stats.waitUs += us;
+        halCriticalExit();
+    }
+    next.len = 0;
+    return true;
+}
+
+} // namespace
+
+bool otaBegin(size_t size, const char* sha256Hex)
+{
+    if (!worker) worker = halWorkerCreate("ota", otaTaskRun, OTA_TASK_CORE, OTA_TASK_PRIORITY);
+    if (stats.state == OTA_RECEIVING) otaAbort();
+
+    const bool pending = stats.pending, confirmed = stats.confirmed;
+    halCriticalEnter();
+    stats = OtaStats();
+    stats.state = OTA_RECEIVING;
+    stats.httpCode = 200;
+    stats.size = size;
+    stats.pending = pending;
+    stats.confirmed = confirmed;
+    halCriticalExit();
+
+    for (Buffer& b : buffers) b.len = 0;
+    fillIndex = writeIndex = 0;
+    writeFailed = false;
+    sha256Begin(&hash);
+    tailLen = 0;
+    hashAppended = false;
+    startUs = halMicros();
+
+    haveExpected = sha256Hex && *sha256Hex;
+    if (haveExpected && !sha256ParseHex(sha256Hex, strlen(sha256Hex), expected)) {
+        return fail(400, "sha256 must be 64 hex digits");
+    }
+    if (!worker) return fail(500, "no OTA task");
+    const size_t partition = halOtaPartitionSize();
+    if (!partition) return fail(500, "no OTA partition");
+    if (size > partition) return fail(413, "image larger than the OTA partition");
+    if (!Update.begin(size ? size : UPDATE_SIZE_UNKNOWN)) return fail(500, "flash: cannot start update");
+    return true;
+}
+
+bool otaWrite(const uint8_t* data, size_t len)
+{
+    if (stats.state != OTA_RECEIVING) return false;
+    const size_t limit = stats.size ? stats.size : halOtaPartitionSize();
+    if (stats.received + len > limit) {
+        if (stats.size) return fail(400, "more data than declared");
+        return fail(413, "image larger than the OTA partition");
+    }
+    if (writeFailed.load()) return fail(500, "flash write failed");
+
+    while (len) {
+        Buffer& b = buffers[fillIndex];
+        const size_t n = len < OTA_BUFFER_SIZE - b.len ? len : OTA_BUFFER_SIZE - b.len;
+        memcpy(b.data + b.len, data, n);
+        b.len += n;
+        data += n;
+        len -= n;
+        halCriticalEnter();
+        stats.received += n;
+        halCriticalExit();
+        if (b.len == OTA_BUFFER_SIZE && !submit()) return false;
+    }
+    return true;
+}
+
+bool otaEnd()
+{
+    if (stats.state != OTA_RECEIVING) return false;
+    if (stats.received < OTA_HEADER_SIZE) return fail(400, "image too short");
+    if (!submit()) return false;
+    drain();
+    if (writeFailed.load()) return fail(500, "flash write failed");
+    if (stats.size && stats.received != stats.size) return fail(400, "less data than declared");
+
+    // body = all but the appended hash, all = the whole file
+    uint8_t body[SHA256_SIZE], all[SHA256_SIZE];
+    Sha256 whole = hash;
+    sha256Finish(&hash, body);
+    sha256Update(&whole, tail, tailLen);
+    sha256Finish(&whole, all);
+    if (hashAppended && (tailLen != SHA256_SIZE || memcmp(body, tail, SHA256_SIZE) != 0)) {
+        return fail(400, "image hash does not match its contents");
+    }
+    if (haveExpected && memcmp(all, expected, SHA256_SIZE) != 0) return fail(400, "sha256 mismatch");
+    if (!Update.end(true)) return fail(500, "flash: cannot activate image");
+
+    const uint32_t totalUs = (uint32_t)(halMicros() - startUs);
+    halCriticalEnter();
+    stats.state = OTA_DONE;
+    stats.totalUs = totalUs;
+    stats.kbPerS = totalUs ? (uint32_t)((uint64_t)stats.received * 1000000 / 1024 / totalUs) : 0;
+    memcpy(stats.sha256, all, SHA256_SIZE);
+    halCriticalExit();
+    Serial.printf("OTA: %lu bytes in %lu ms (%lu KB/s), flash %lu ms, waited %lu ms\n",
+                  (unsigned long)stats.received, (unsigned long)(totalUs / 1000), (unsigned long)stats.kbPerS,
+                  (unsigned long)(stats.flashUs / 1000), (unsigned long)(stats.waitUs / 1000));
+    return true;
+}
+
+void otaAbort()
+{
+    if (stats.state == OTA_RECEIVING) fail(400, "upload aborted");
+}
+
+OtaStats otaStats()
+{
+    halCriticalEnter();
+    OtaStats s = stats;
+    halCriticalExit();
+    return s;
+}
+
+// --------------------------------------------------
+// Boot health
+// --------------------------------------------------
+void otaHealthBegin()
+{
+    for (Buffer& b : buffers) b.queued = false;
+    stats = OtaStats();
+    stats.pending = halOtaPending();
+    bootUs = halMicros();
+    onlineSinceUs = 0;
+    if (stats.pending) {
+        Serial.printf("OTA: new image, confirming after %lu s online\n", (unsigned long)(OTA_HEALTHY_MS / 1000));
+    }
+}
+
+bool otaHealthService(bool online)
+{
+    if (!stats.pending) return false;
+    const uint64_t now = halMicros();
+
+    if (!online) {
+        onlineSinceUs = 0;
+    } else if (!onlineSinceUs) {
+        onlineSinceUs = now;
+    } else if (now - onlineSinceUs >= (uint64_t)OTA_HEALTHY_MS * 1000) {
+        halOtaConfirm();
+        halCriticalEnter();
+        stats.pending = false;
+        stats.confirmed = true;
+        halCriticalExit();
+        Serial.println("OTA: image confirmed");
+        return false;
+    }
+    return now - bootUs >= (uint64_t)OTA_CONFIRM_TIMEOUT_MS * 1000;
+}
@@ -0,0 +1,364 @@
+#include <Arduino.h>
+#include <string.h>
+
+#include "hal.h"
+#include "outputs.h"
+
+namespace {
+
+// ESP32 GPIOs that can drive an output: not 1 and 3 (UART0, the serial
+// console), 6..11 (the SPI flash), 20, 24, 28..31 (not bonded out) or
+// 34..39 (input only).
+const uint64_t GPIO_OUTPUTS = (1ull << 0) | (1ull << 2) | (1ull << 4) | (1ull << 5) |
+                              (0xffull << 12) | (0x7ull << 21) | (0x7ull << 25) | (0x3ull << 32);
+const uint32_t GPIO_MAX     = 39;
+const uint8_t MCP_IODIRA    = 0x00;      // IOCON.BANK = 0: A/B registers interleaved
+const uint8_t MCP_OLATA     = 0x14;
+const uint8_t MCP_ADDR_MIN  = 0x20;
+const uint8_t MCP_ADDR_MAX  = 0x27;
+
+OutputMap outMap = {};
+uint32_t allMask = 0;
+uint32_t driven = 0;
+OutputStats stats = {};
+char pinError[40];               // parse only: setup() or the settings POST
+
+uint32_t lowBits(int n)
+{
+    return n >= 32 ? 0xffffffffu : (1u << n) - 1;
+}
+
+// --------------------------------------------------
+// Spec text
+// --------------------------------------------------
+struct Token
+{
+    const char* s;
+    size_t n;
+};
+
+bool tokenIs(Token t, const char* word)
+{
+    return strlen(word) == t.n && !strncasecmp(t.s, word, t.n);
+}
+
+// Decimal or 0x hex.
+bool parseNumber(Token t, uint32_t max, uint32_t* v)
+{
+    uint32_t base = 10;
+    size_t i = 0;
+    if (t.n > 2 && t.s[0] == '0' && (t.s[1] == 'x' || t.s[1] == 'X')) {
+        base = 16;
+        i = 2;
+    }
+    if (i >= t.n || t.n - i > 8) return false;
+    uint64_t x = 0;
+    for (; i < t.n; i++) {
+        const char c = t.s[i];
+        int d;
+        if (c >= '0' && c <= '9') d = c - '0';
+        else if (base == 16 && c >= 'a' && c <= 'f') d = c - 'a' + 10;
+        else if (base == 16 && c >= 'A' && c <= 'F') d = c - 'A' + 10;
+        else return false;
+        x = x * base + d;
+    }
+    if (x > max) return false;
+    *v = (uint32_t)x;
+    return true;
+}
+
+// One pin of an output or the I2C bus; the error to return, or nullptr.
+const char* parsePin(Token t, uint8_t* pin)
+{
+    uint32_t v;
+    if (!parseNumber(t, GPIO_MAX, &v)) return "bad GPIO";
+    if (!(GPIO_OUTPUTS >> v & 1)) {
+        snprintf(pinError, sizeof(pinError), "GPIO %u is not an output pin", (unsigned)v);
+        return pinError;
+    }
+    *pin = (uint8_t)v;
+    return nullptr;
+}
+
+// Splits one statement into tokens; false if it has more than max.
+bool tokenize(const char* s, size_t n, Token* tok, int max, int* count)
+{
+    *count = 0;
+    size_t i = 0;
+    while (i < n) {
+        while (i < n && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r')) i++;
+        if (i >= n) break;
+        const size_t start = i;
+        while (i < n && s[i] != ' ' && s[i] != '\t' && s[i] != '\r') i++;
+        if (*count >= max) return false;
+        tok[(*count)++] = Token{s + start, i - start};
+    }
+    return true;
+}
+
+const char* parseStatement(const Token* tok, int n, OutputMap* map)
+{
+    if (tokenIs(tok[0], "i2c")) {
+        if (n != 3) return "expected i2c <sda> <scl>";
+        const char* err = parsePin(tok[1], &map->sda);
+        return err ? err : parsePin(tok[2], &map->scl);
+    }
+
+    if (map->banks >= OUTPUT_BANKS_MAX) return "too many banks";
+    OutputBank& b = map->bank[map->banks];
+    b = OutputBank{};
+    b.first = map->count;
+    uint32_t v;
+
+    if (tokenIs(tok[0], "gpio")) {
+        if (n < 2) return "expected gpio <pin> ...";
+        b.type = BANK_GPIO;
+        b.count = (uint8_t)(n - 1);
+        if (map->count + b.count > OUTPUTS_MAX) return "too many outputs";
+        for (int i = 1; i < n; i++) {
+            const char* err = parsePin(tok[i], &map->gpio[map->count + i - 1]);
+            if (err) return err;
+        }
+    } else if (tokenIs(tok[0], "595")) {
+        if (n != 5) return "expected 595 <data> <clock> <latch> <outputs>";
+        b.type = BANK_HC595;
+        for (int i = 0; i < 3; i++) {
+            const char* err = parsePin(tok[1 + i], &b.pin[i]);
+            if (err) return err;
+        }
+        if (!parseNumber(tok[4], OUTPUTS_MAX, &v) || v == 0) return "bad output count";
+        b.count = (uint8_t)v;
+    } else if (tokenIs(tok[0], "mcp23017")) {
+        if (n < 2 || n > 3) return "expected mcp23017 <address> [<outputs>]";
+        b.type = BANK_MCP23017;
+        if (!parseNumber(tok[1], MCP_ADDR_MAX, &v) || v < MCP_ADDR_MIN) return "address must be 0x20..0x27";
+        b.pin[0] = (uint8_t)v;
+        v = 16;
+        if (n == 3 && (!parseNumber(tok[2], 16, &v) || v == 0)) return "bad output count";
+        b.count = (uint8_t)v;
+        for (int i = 0; i < map->banks; i++) {
+            if (map->bank[i].type == BANK_MCP23017 && map->bank[i].pin[0] == b.pin[0]) return "address used twice";
+        }
+    } else {
+        return "unknown bank type";
+    }
+
+    if (map->count + b.count > OUTPUTS_MAX) return "too many outputs";
+    map->count += b.count;
+    map->banks++;
+    return nullptr;
+}
+
+// --------------------------------------------------
+// Bank writes
+// --------------------------------------------------
+bool writeBank(const OutputBank& b, uint32_t bits, uint32_t changed)
+{
+    switch (b.type) {
+    case BANK_GPIO: {
+        uint64_t clear = 0, set = 0;
+        for (int i = 0; i < b.count; i++) {
+            if (!(changed & (1u << i))) continue;
+            const uint64_t pin = 1ULL << outMap.gpio[b.first + i];
+            if (bits & (1u << i)) set |= pin;
+            else clear |= pin;
+        }
+        halGpioWriteMask(clear, set);
+        return true;
+    }
+    case BANK_HC595: {
+        // Register r (0 = next to the MCU) holds outputs 8r..8r+7 and is
+        // shifted in last.
+        uint8_t bytes[OUTPUTS_MAX / 8];
+        const int len = (b.count + 7) / 8;
+        for (int r = 0; r < len; r++) bytes[len - 1 - r] = (uint8_t)(bits >> (8 * r));
+        halShiftOut(b.pin[0], b.pin[1], b.pin[2], bytes, len);
+        return true;
+    }
+    case BANK_MCP23017: {
+        // Sequential addressing: OLATA then OLATB in one transfer.
+        const uint8_t msg[3] = {MCP_OLATA, (uint8_t)bits, (uint8_t)(bits >> 8)};
+        return halI2cWrite(b.pin[0], msg, b.count > 8 ? 3 : 2);
+    }
+    }
+    return false;
+}
+
+} // namespace
+
+bool outputMapParse(const char* spec, OutputMap* map, char* error, size_t errorSize)
+{
+    *map = OutputMap{};
+    map->sda = 21;
+    map->scl = 22;
+
+    const char* p = spec;
+    int statement = 0;
+    while (*p) {
+        const char* end = p;
+        while (*end && *end != ';' && *end != '\n') end++;
+        statement++;
+
+        Token tok[OUTPUTS_MAX + 1];
+        int n;
+        if (!tokenize(p, (size_t)(end - p), tok, OUTPUTS_MAX + 1, &n)) {
+            snprintf(error, errorSize, "statement %d: too many outputs", statement);
+            return false;
+        }
+        if (n > 0) {
+            const char* err = parseStatement(tok, n, map);
+            if (err) {
+                snprintf(error, errorSize, "statement %d: %s", statement, err);
+                return false;
+            }
+        }
+        p = *end ? end + 1 : end;
+    }
+
+    if (map->count == 0) {
+        snprintf(error, errorSize, "no outputs");
+        return false;
+    }
+    return true;
+}
+
+bool outputsBegin(const OutputMap& map)
+{
+    outMap = map;
+    allMask = lowBits(map.count);
+    driven = 0;
+    stats = OutputStats{};
+
+    bool ok = true;
+    bool i2cUp = false;
+    for (int i = 0; i < outMap.banks; i++) {
+        const OutputBank& b = outMap.bank[i];
+        switch (b.type) {
+        case BANK_GPIO:
+            for (int k = 0; k < b.count; k++) {
+                halGpioOutput(outMap.gpio[b.first + k]);
+                halGpioWrite(outMap.gpio[b.first + k], false);
+            }
+            break;
+        case BANK_HC595:
+            for (int k = 0; k < 3; k++) {
+                halGpioOutput(b.pin[k]);
+                halGpioWrite(b.pin[k], false);
+            }
+            writeBank(b, 0, lowBits(b.count));
+            break;
+        case BANK_MCP23017: {
+            if (!i2cUp) i2cUp = halI2cBegin(outMap.sda, outMap.scl, OUTPUT_I2C_HZ);
+            // Latches low first, then the used ports to outputs: no glitch.
+            const uint8_t dir[3] = {MCP_IODIRA, (uint8_t)~lowBits(b.count), (uint8_t)~(lowBits(b.count) >> 8)};
+            if (!writeBank(b, 0, lowBits(b.count)) || !halI2cWrite(b.pin[0], dir, 3)) {
+                Serial.printf("Outputs: no MCP23017 at 0x%02x\n", b.pin[0]);
+                stats.failures++;
+                ok = false;
+            }
+            break;
+        }
+        }
+    }
+    return ok;
+}
+
+int outputCount()
+{
+    return outMap.count;
+}
+
+uint32_t outputsAll()
+{
+    return allMask;
+}
+
+void outputsWrite(uint32_t pattern)
+{
+    pattern &= allMask;
+    if (pattern == driven) return;
+
+    uint32_t now = driven;
+    uint32_t transactions = 0, failures = 0;
+    for (int i = 0; i < outMap.banks; i++) {
+        const OutputBank& b = outMap.bank[i];
+        const uint32_t mask = lowBits(b.count) << b.first;
+        const uint32_t changed = (pattern ^ driven) & mask;
+        if (!changed) continue;
+
+        transactions++;
+        if (writeBank(b, (pattern & mask) >> b.first, changed >> b.first)) {
+            now = (now & ~mask) | (pattern & mask);
+        } else {
+            failures++;   // left as it was; the next write retries it
+        }
+    }
+
+    halCriticalEnter();
+    driven = now;
+    stats.writes++;
+    stats.transactions += transactions;
+    stats.failures += failures;
+    halCriticalExit();
+}
+
+uint32_t outputsDriven()
+{
+    halCriticalEnter();
+    const uint32_t d = driven;
+    halCriticalExit();
+    return d;
+}
+
+OutputStats outputsStats()
+{
+    halCriticalEnter();
+    const OutputStats s = stats;
+    halCriticalExit();
+    return s;
+}
+
+int outputsAntenna(uint32_t mask)
+{
+    if (!mask) return 0;
+    if (mask & (mask - 1)) return -1;
+    return __builtin_ctz(mask) + 1;
+}
+
+bool outputsParseSelection(const char* s, size_t n, int count, uint32_t* mask)
+{
+    if (n == 3 && !strncasecmp(s, "off", 3)) {
+        *mask = 0;
+        return true;
+    }
+
+    if (n == 0) return false;
+    uint32_t m = 0;
+    size_t i = 0;
+    while (i < n) {
+        int v = 0;
+        const size_t start = i;
+        while (i < n && s[i] >= '0' && s[i] <= '9' && i - start < 3) v = v * 10 + (s[i++] - '0');
+        if (i == start || v > count) return false;
+        m |= outputBit(v);
+        if (i == n) break;
+        if (s[i] != '+' && s[i] != ',' && s[i] != ' ') return false;
+        if (++i == n) return false;
+    }
+    *mask = m;
+    return true;
+}
+
+void outputsFormatSelection(uint32_t mask, char* buf, size_t size)
+{
+    if (!mask) {
+        snprintf(buf, size, "off");
+        return;
+    }
+    size_t n = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < OUTPUTS_MAX && n < size; i++) {
+        if (!(mask & (1u << i))) continue;
+        n += snprintf(buf + n, size - n, n ? "+%d" : "%d", i + 1);
+    }
+}
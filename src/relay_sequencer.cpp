@@ -0,0 +1,167 @@
+#include <Arduino.h>
+
+#include "relay_sequencer.h"
+#include "hal.h"
+#include "outputs.h"
+
+namespace {
+
+enum Phase : uint8_t { PHASE_IDLE, PHASE_BREAK };
+
+HalTimerHandle makeTimer = nullptr;
+RelaySequencerWake wakeOwner = nullptr;
+uint32_t deadTimeUs = 10000;
+
+// Owner task only; readers of driven and stats go through halCritical.
+volatile Phase phase = PHASE_IDLE;
+volatile uint32_t driven = 0;        // what the outputs show now
+uint32_t target = 0;                 // pattern to make at the end of the break
+uint64_t releasedAtUs = 0;           // last time any output was de-energised
+RelaySequencerStats stats = {};
+
+// Shared with the TX interlock interrupt, under halCritical
+bool held = false;
+bool writing = false;
+uint64_t wroteAtUs = 0;              // end of the last output write
+
+// False, and nothing written, while the interlock holds the outputs.
+bool drive(uint32_t pattern)
+{
+    halCriticalEnter();
+    const bool allowed = !held;
+    writing = allowed;
+    halCriticalExit();
+    if (!allowed) return false;
+
+    outputsWrite(pattern);
+    halCriticalEnter();
+    driven = pattern;
+    writing = false;
+    wroteAtUs = halMicros();
+    halCriticalExit();
+    return true;
+}
+
+// Starts a break/make towards target; the owner's only entry to it.
+void start()
+{
+    const uint64_t now = halMicros();
+    if (target == driven) return;
+
+    if (driven) {
+        if (!drive(0)) return;
+        releasedAtUs = now;
+    }
+    halCriticalEnter();
+    stats.transitions++;
+    halCriticalExit();
+
+    // Contacts released less than a dead time ago may still be closed.
+    const uint64_t sinceRelease = now - releasedAtUs;
+    if (target == 0 || sinceRelease >= deadTimeUs) {
+        if (!drive(target)) phase = PHASE_BREAK;   // held in between: made on release
+        return;
+    }
+
+    phase = PHASE_BREAK;
+    halTimerArm(makeTimer, (uint32_t)(deadTimeUs - sinceRelease));
+}
+
+// Timer callback: the dead time is over; the make happens on the owner's task.
+void onDeadTimeElapsed()
+{
+    if (wakeOwner) wakeOwner();
+}
+
+} // namespace
+
+void relaySequencerBegin(uint32_t deadUs, RelaySequencerWake wake)
+{
+    deadTimeUs = deadUs;
+    wakeOwner = wake;
+    if (!makeTimer) makeTimer = halTimerCreate("relay", onDeadTimeElapsed);
+
+    halTimerCancel(makeTimer);
+    halCriticalEnter();
+    held = false;
+    halCriticalExit();
+    drive(0);
+    target = 0;
+    phase = PHASE_IDLE;
+    releasedAtUs = halMicros();
+}
+
+void relaySequencerSetDeadTime(uint32_t deadUs)
+{
+    deadTimeUs = deadUs;
+}
+
+void relaySequencerRequest(uint32_t mask)
+{
+    target = mask & outputsAll();
+
+    halCriticalEnter();
+    const bool deferred = held;
+    if (deferred) stats.deferred++;
+    else if (phase == PHASE_BREAK) stats.retargets++;
+    halCriticalExit();
+
+    // Held: the latest target waits for the release. In the dead time:
+    // the pending make picks up the new target.
+    if (deferred || phase == PHASE_BREAK) return;
+    start();
+}
+
+void relaySequencerService()
+{
+    if (phase != PHASE_BREAK) {
+        start();             // a target held back by the interlock
+        return;
+    }
+    const uint64_t sinceRelease = halMicros() - releasedAtUs;
+    if (sinceRelease < deadTimeUs) {
+        halTimerArm(makeTimer, (uint32_t)(deadTimeUs - sinceRelease));
+        return;
+    }
+    if (drive(target)) phase = PHASE_IDLE;
+}
+
+void IRAM_ATTR relaySequencerHold(bool hold)
+{
+    halCriticalEnter();
+    held = hold;
+    halCriticalExit();
+}
+
+uint32_t IRAM_ATTR relaySequencerSettleUs()
+{
+    halCriticalEnter();
+    const uint64_t since = halMicros() - wroteAtUs;
+    uint32_t us;
+    if (phase == PHASE_BREAK || !driven) us = UINT32_MAX;
+    else if (writing) us = deadTimeUs;
+    else us = since >= deadTimeUs ? 0 : (uint32_t)(deadTimeUs - since);
+    halCriticalExit();
+    return us;
+}
+
+bool relaySequencerBusy()
+{
+    return phase != PHASE_IDLE;
+}
+
+uint32_t relaySequencerOutputs()
+{
+    halCriticalEnter();
+    uint32_t d = driven;
+    halCriticalExit();
+    return d;
+}
+
+RelaySequencerStats relaySequencerStats()
+{
+    halCriticalEnter();
+    RelaySequencerStats s = stats;
+    halCriticalExit();
+    return s;
+}
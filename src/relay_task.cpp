@@ -0,0 +1,273 @@
+#include <Arduino.h>
+#include <atomic>
+
+#include "event_log.h"
+#include "hal.h"
+#include "lockfree.h"
+#include "metrics.h"
+#include "outputs.h"
+#include "relay_sequencer.h"
+#include "relay_task.h"
+#include "tx_interlock.h"
+
+namespace {
+
+struct RelayCommand
+{
+    RelaySource source;
+    uint32_t outputs;
+    uint32_t arrivedUs;      // low 32 bits of halMicros()
+};
+
+// Shared with every poster; halCritical
+struct Arbiter
+{
+    uint32_t windowUs;
+    uint8_t  priority[RELAY_SOURCES];
+    bool     locked;
+    uint32_t target;         // latest accepted selection
+    uint32_t committed;      // ... of those posted to the relay task
+    uint64_t endUs;          // of the window; open while halMicros() is below
+    RelaySource owner;
+    bool     held;
+    RelayCommand pending;
+};
+
+HalWorkerHandle worker = nullptr;
+HalTimerHandle windowTimer = nullptr;
+SpscRing<RelayCommand, RELAY_QUEUE_LEN> queue;   // pushed under halCritical
+SeqLock<RelaySnapshot> snapshot;
+std::atomic<uint32_t> posted(0);
+std::atomic<uint32_t> dropped(0);
+Arbiter arb = {};
+
+// Relay task only
+RelaySnapshot state = {};
+RelayTaskStats stats = {};   // counters written by posters too; halCritical
+
+const char* const SOURCE_NAMES[RELAY_SOURCES] = {"local", "http", "mqtt", "schedule", "band", "udp", "swr"};
+const char* const VERDICT_NAMES[] = {"applied", "held", "busy", "locked", "outranked"};
+
+bool manual(RelaySource source)
+{
+    return source == RELAY_SRC_HTTP || source == RELAY_SRC_LOCAL;
+}
+
+uint32_t resolve(RelayAction action, uint32_t outputs)
+{
+    const int count = outputCount();
+    const int lowest = arb.target ? __builtin_ctz(arb.target) + 1 : 0;
+    switch (action) {
+    case RELAY_NEXT: return outputBit(lowest % count + 1);
+    case RELAY_PREV: return outputBit(lowest <= 1 ? count : lowest - 1);
+    default:         return outputs;
+    }
+}
+
+void apply(const RelayCommand& cmd)
+{
+    relaySequencerRequest(cmd.outputs);
+    const uint32_t us = (uint32_t)halMicros() - cmd.arrivedUs;
+
+    state.version++;
+    state.outputs = cmd.outputs;
+    state.antenna = (int8_t)outputsAntenna(cmd.outputs);
+    state.source = cmd.source;
+    snapshot.write(state);
+    eventLog(EVENT_RELAY, cmd.source, 0, cmd.outputs);
+
+    halCriticalEnter();
+    RelayLatency& l = stats.latency[cmd.source];
+    l.count++;
+    l.lastUs = us;
+    l.totalUs += us;
+    if (us > l.maxUs) l.maxUs = us;
+    if (us > RELAY_BUDGET_US) l.overBudget++;
+    stats.applied++;
+    halCriticalExit();
+    metricsObserve((MetricHistogram)(METRIC_CMD_LOCAL + cmd.source), us);
+}
+
+// The command held through a window that has ended; it opens the next.
+bool takeHeld(RelayCommand* cmd)
+{
+    const uint64_t now = halMicros();
+    halCriticalEnter();
+    const bool due = arb.held && now >= arb.endUs;
+    if (due) {
+        *cmd = arb.pending;
+        arb.held = false;
+        arb.committed = cmd->outputs;
+        arb.endUs = now + arb.windowUs;
+        arb.owner = cmd->source;
+    }
+    halCriticalExit();
+    return due;
+}
+
+// Relay task body: runs once per wake-up and drains the ring.
+void relayTaskRun()
+{
+    const uint32_t depth = queue.depth();
+    RelayCommand cmd;
+
+    while (queue.pop(&cmd)) apply(cmd);
+    if (takeHeld(&cmd) && cmd.outputs != state.outputs) apply(cmd);
+    relaySequencerService();
+    txInterlockService();
+
+    halCriticalEnter();
+    stats.wakeups++;
+    if (depth > stats.peakDepth) stats.peakDepth = depth;
+    halCriticalExit();
+}
+
+bool post(RelayAction action, uint32_t outputs, RelaySource source, uint32_t arrivedUs, RelayPostResult* result)
+{
+    RelayPostResult r = {RELAY_APPLIED, false, source, outputs};
+    const uint64_t now = halMicros();
+    const bool swr = source == RELAY_SRC_SWR;
+    uint32_t holdUs = 0;
+
+    halCriticalEnter();
+    const bool windowOpen = now < arb.endUs;
+    if (!swr && arb.locked && !manual(source)) {
+        r.verdict = RELAY_LOCKED;
+        stats.lockedOut++;
+    } else if (!swr && !arb.locked && windowOpen && arb.priority[source] < arb.priority[arb.owner]) {
+        r.verdict = RELAY_OUTRANKED;
+        r.by = arb.owner;
+        stats.outranked++;
+    } else {
+        const RelayCommand cmd = {source, resolve(action, outputs), arrivedUs};
+        r.outputs = cmd.outputs;
+        if (windowOpen && !swr) {
+            r.verdict = RELAY_HELD;
+            holdUs = (uint32_t)(arb.endUs - now);
+            stats.held++;
+        } else if (!queue.push(cmd)) {
+            r.verdict = RELAY_BUSY;
+        }
+        if (r.verdict != RELAY_BUSY) {
+            if (arb.held) {
+                r.superseded = true;
+                r.by = arb.pending.source;
+                stats.superseded++;
+            }
+            arb.held = r.verdict == RELAY_HELD;
+            arb.pending = cmd;
+            arb.target = cmd.outputs;
+            arb.owner = source;
+            if (r.verdict == RELAY_APPLIED) {
+                arb.committed = cmd.outputs;
+                arb.endUs = swr ? now : now + arb.windowUs;
+            }
+        }
+    }
+    halCriticalExit();
+
+    if (result) *result = r;
+    const bool accepted = r.verdict == RELAY_APPLIED || r.verdict == RELAY_HELD;
+    eventLog(EVENT_COMMAND, source, action | (accepted ? 0 : EVENT_REFUSED), r.outputs);
+    if (r.verdict == RELAY_BUSY) dropped.fetch_add(1, std::memory_order_relaxed);
+    if (!accepted) return false;
+    posted.fetch_add(1, std::memory_order_relaxed);
+    if (r.verdict == RELAY_HELD) halTimerArm(windowTimer, holdUs);
+    else halWorkerNotify(worker);
+    return true;
+}
+
+} // namespace
+
+void relayTaskBegin(uint32_t outputs, uint32_t deadTimeUs)
+{
+    queue.reset();
+    outputs &= outputsAll();
+    state = RelaySnapshot{0, outputs, (int8_t)outputsAntenna(outputs), RELAY_SRC_LOCAL};
+    snapshot.write(state);
+    halCriticalEnter();
+    arb.target = arb.committed = outputs;
+    arb.endUs = 0;
+    arb.held = false;
+    halCriticalExit();
+    if (!worker) worker = halWorkerCreate("relay", relayTaskRun, RELAY_TASK_CORE, RELAY_TASK_PRIORITY);
+    if (!windowTimer) windowTimer = halTimerCreate("arbiter", relayTaskWake);
+    relaySequencerBegin(deadTimeUs, relayTaskWake);
+}
+
+bool relayPost(RelayAction action, int antenna, RelaySource source, uint64_t arrivedUs, RelayPostResult* result)
+{
+    if (antenna < 0 || antenna > outputCount()) antenna = 0;
+    return post(action, outputBit(antenna), source, (uint32_t)arrivedUs, result);
+}
+
+bool relayPostOutputs(uint32_t outputs, RelaySource source, uint64_t arrivedUs, RelayPostResult* result)
+{
+    return post(RELAY_SELECT, outputs & outputsAll(), source, (uint32_t)arrivedUs, result);
+}
+
+void relayArbiterConfigure(uint16_t windowMs, const uint8_t* priority)
+{
+    halCriticalEnter();
+    arb.windowUs = (windowMs < RELAY_WINDOW_MAX_MS ? windowMs : RELAY_WINDOW_MAX_MS) * 1000UL;
+    for (int i = 0; i < RELAY_SOURCES; i++) {
+        arb.priority[i] = priority[i] < RELAY_PRIORITY_MAX ? priority[i] : RELAY_PRIORITY_MAX;
+    }
+    halCriticalExit();
+}
+
+void relayArbiterLock(bool on)
+{
+    halCriticalEnter();
+    arb.locked = on;
+    if (on && arb.held && !manual(arb.pending.source)) {
+        arb.held = false;
+        arb.target = arb.committed;
+        stats.lockedOut++;
+    }
+    halCriticalExit();
+}
+
+bool relayArbiterLocked()
+{
+    halCriticalEnter();
+    const bool locked = arb.locked;
+    halCriticalExit();
+    return locked;
+}
+
+const char* relaySourceName(RelaySource source)
+{
+    return source < RELAY_SOURCES ? SOURCE_NAMES[source] : "?";
+}
+
+const char* relayVerdictName(RelayVerdict verdict)
+{
+    return VERDICT_NAMES[verdict];
+}
+
+void relayTaskWake()
+{
+    halWorkerNotify(worker);
+}
+
+void IRAM_ATTR relayTaskWakeFromIsr()
+{
+    halWorkerNotifyFromIsr(worker);
+}
+
+RelaySnapshot relaySnapshot()
+{
+    return snapshot.read();
+}
+
+RelayTaskStats relayTaskStats()
+{
+    halCriticalEnter();
+    RelayTaskStats s = stats;
+    s.locked = arb.locked;
+    halCriticalExit();
+    s.posted = posted.load(std::memory_order_relaxed);
+    s.dropped = dropped.load(std::memory_order_relaxed);
+    return s;
+}
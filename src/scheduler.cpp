@@ -0,0 +1,681 @@
+#include <Preferences.h>
+#include <string.h>
+
+#include "hal.h"
+#include "outputs.h"
+#include "relay_task.h"
+#include "scheduler.h"
+
+namespace {
+
+const uint64_t DAY_US     = 86400000000ULL;
+const uint32_t DAY_MS     = 86400000;
+const uint32_t ARM_MAX_US = 3600000000u;     // further out: wake, find nothing due, re-arm
+const uint8_t  WEEKDAYS   = 0x3e;
+const uint8_t  WEEKENDS   = 0x41;
+
+const char     BLOB_KEY[]   = "schedule";
+const uint8_t  BLOB_VERSION = 2;            // 1: antenna << 27 in macro steps
+const size_t   BLOB_MAX     = 4 + SCHED_MAX_ENTRIES * 6 + SCHED_MAX_MACROS * (1 + SCHED_MAX_STEPS * 4);
+
+const char* const DAY_NAMES[7] = {"sun", "mon", "tue", "wed", "thu", "fri", "sat"};
+
+enum ItemKind : uint8_t { ITEM_ENTRY, ITEM_MACRO };
+
+struct Item
+{
+    uint64_t dueUs;          // halMicros()
+    ItemKind kind;
+    uint8_t  index;          // entry, or macro number - 1
+    uint8_t  step;           // ITEM_MACRO: the step to apply
+    uint8_t  weekday;        // ITEM_ENTRY: of this occurrence, 0 = Sunday
+};
+
+const int HEAP_MAX = SCHED_MAX_ENTRIES + 1;            // every entry + the running macro
+const int FIRE_MAX = SCHED_MAX_ENTRIES + SCHED_MAX_STEPS;
+
+// Shared with the timer callback, under halCritical
+Schedule current = {};
+Item heap[HEAP_MAX];
+int heapLen = 0;
+SchedulerStats stats = {};
+
+// loop() only
+HalTimerHandle timer = nullptr;
+bool planned = false;
+int64_t planOffsetUs = 0;    // UTC - halMicros() the heap was planned with
+
+// --------------------------------------------------
+// Min-heap on dueUs
+// --------------------------------------------------
+void swapItems(int a, int b)
+{
+    const Item t = heap[a];
+    heap[a] = heap[b];
+    heap[b] = t;
+}
+
+void siftUp(int i)
+{
+    while (i > 0) {
+        const int parent = (i - 1) / 2;
+        if (heap[parent].dueUs <= heap[i].dueUs) break;
+        swapItems(parent, i);
+        i = parent;
+    }
+}
+
+void siftDown(int i)
+{
+    for (;;) {
+        const int l = 2 * i + 1, r = l + 1;
+        int m = i;
+        if (l < heapLen && heap[l].dueUs < heap[m].dueUs) m = l;
+        if (r < heapLen && heap[r].dueUs < heap[m].dueUs) m = r;
+        if (m == i) return;
+        swapItems(m, i);
+        i = m;
+    }
+}
+
+void heapPush(const Item& it)
+{
+    if (heapLen >= HEAP_MAX) return;
+    heap[heapLen] = it;
+    siftUp(heapLen++);
+}
+
+void heapRemove(int i)
+{
+    heap[i] = heap[--heapLen];
+    if (i < heapLen) {
+        siftDown(i);
+        siftUp(i);
+    }
+}
+
+void cancelMacro()
+{
+    for (int i = 0; i < heapLen; i++) {
+        if (heap[i].kind == ITEM_MACRO) {
+            heapRemove(i);
+            break;
+        }
+    }
+    stats.running = 0;
+}
+
+// Days from weekday wd to the next one in the mask, at least from.
+int daysUntil(uint8_t days, int wd, int from)
+{
+    for (int k = from; k <= 7; k++) {
+        if (days & (1 << (wd + k) % 7)) return k;
+    }
+    return 7;
+}
+
+// --------------------------------------------------
+// Firing (esp_timer task)
+// --------------------------------------------------
+// Arms the timer for the top of the heap. Runs after every change, from
+// loop() or the callback; an arm made from a stale view only wakes the
+// callback early, and it re-arms.
+void arm()
+{
+    halCriticalEnter();
+    const bool any = heapLen > 0;
+    const uint64_t due = any ? heap[0].dueUs : 0;
+    halCriticalExit();
+
+    if (!any) {
+        halTimerCancel(timer);
+        return;
+    }
+    const uint64_t now = halMicros();
+    uint64_t wait = due > now ? due - now : 0;
+    if (wait > ARM_MAX_US) wait = ARM_MAX_US;
+    halTimerArm(timer, (uint32_t)wait);
+}
+
+struct Firing
+{
+    uint8_t  antenna;
+    uint64_t dueUs;
+};
+
+void fire()
+{
+    Firing due[FIRE_MAX];
+    int n = 0;
+
+    halCriticalEnter();
+    const uint64_t now = halMicros();
+    while (heapLen && heap[0].dueUs <= now && n < FIRE_MAX) {
+        const Item it = heap[0];
+        heapRemove(0);
+
+        if (it.kind == ITEM_MACRO) {
+            const SchedMacro& m = current.macro[it.index];
+            const SchedStep& step = m.step[it.step];
+            due[n++] = Firing{step.antenna, it.dueUs};
+            if (step.ms && it.step + 1 < m.steps) {
+                heapPush(Item{it.dueUs + step.ms * 1000ULL, ITEM_MACRO, it.index, (uint8_t)(it.step + 1), 0});
+            } else {
+                stats.running = 0;
+            }
+            continue;
+        }
+
+        const SchedEntry& e = current.entry[it.index];
+        const int k = daysUntil(e.days, it.weekday, 1);
+        heapPush(Item{it.dueUs + k * DAY_US, ITEM_ENTRY, it.index, 0, (uint8_t)((it.weekday + k) % 7)});
+        cancelMacro();
+        if (e.action & SCHED_MACRO) {
+            // Its first step is due now and comes off the heap next.
+            const uint8_t number = e.action & ~SCHED_MACRO;
+            heapPush(Item{it.dueUs, ITEM_MACRO, (uint8_t)(number - 1), 0, 0});
+            stats.running = number;
+        } else {
+            due[n++] = Firing{e.action, it.dueUs};
+        }
+    }
+    halCriticalExit();
+    arm();
+
+    // Latency is measured from the due time, so it is the firing error.
+    uint32_t fired = 0;
+    for (int i = 0; i < n; i++) fired += relayPost(RELAY_SELECT, due[i].antenna, RELAY_SRC_SCHEDULE, due[i].dueUs);
+
+    halCriticalEnter();
+    stats.fired += fired;
+    stats.dropped += n - fired;
+    halCriticalExit();
+}
+
+// --------------------------------------------------
+// Planning (loop)
+// --------------------------------------------------
+// The next occurrence of an entry after utcUs, on the monotonic clock.
+Item nextOccurrence(const SchedEntry& e, uint8_t index, uint64_t utcUs, int64_t offsetUs)
+{
+    const uint64_t dayStart = utcUs - utcUs % DAY_US;
+    const int wd = (int)((utcUs / DAY_US + 4) % 7);   // 1970-01-01 was a Thursday
+    int k = daysUntil(e.days, wd, 0);
+    if (k == 0 && dayStart + e.msOfDay * 1000ULL <= utcUs) k = daysUntil(e.days, wd, 1);
+    const uint64_t at = dayStart + k * DAY_US + e.msOfDay * 1000ULL;
+    return Item{(uint64_t)((int64_t)at - offsetUs), ITEM_ENTRY, index, 0, (uint8_t)((wd + k) % 7)};
+}
+
+void plan(uint64_t utcUs, uint64_t nowUs)
+{
+    const int64_t offsetUs = (int64_t)(utcUs - nowUs);
+
+    // current only changes in loop(), so it is read here without the lock.
+    Item next[SCHED_MAX_ENTRIES];
+    for (int i = 0; i < current.entries; i++) next[i] = nextOccurrence(current.entry[i], (uint8_t)i, utcUs, offsetUs);
+
+    halCriticalEnter();
+    int macro = -1;
+    for (int i = 0; i < heapLen; i++) {
+        if (heap[i].kind == ITEM_MACRO) macro = i;
+    }
+    const Item running = macro >= 0 ? heap[macro] : Item{};
+    heapLen = 0;
+    for (int i = 0; i < current.entries; i++) heapPush(next[i]);
+    if (macro >= 0) heapPush(running);   // steps are relative; the clock does not move them
+    stats.replans++;
+    stats.clockSynced = true;
+    halCriticalExit();
+
+    planned = true;
+    planOffsetUs = offsetUs;
+    arm();
+}
+
+// --------------------------------------------------
+// NVS blob: version, entries, macros defined, 0; per entry msOfDay
+// (LE32), days, action; per defined macro number << 4 | steps, then per
+// step LE32 antenna << 26 | ms.
+// --------------------------------------------------
+void putLe32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+uint32_t getLe32(const uint8_t* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+size_t encode(const Schedule& s, uint8_t* b)
+{
+    size_t n = 4;
+    uint8_t macros = 0;
+    for (int i = 0; i < s.entries; i++) {
+        putLe32(b + n, s.entry[i].msOfDay);
+        b[n + 4] = s.entry[i].days;
+        b[n + 5] = s.entry[i].action;
+        n += 6;
+    }
+    for (int m = 0; m < SCHED_MAX_MACROS; m++) {
+        const SchedMacro& mac = s.macro[m];
+        if (!mac.steps) continue;
+        macros++;
+        b[n++] = (uint8_t)((m + 1) << 4 | mac.steps);
+        for (int i = 0; i < mac.steps; i++, n += 4) putLe32(b + n, (uint32_t)mac.step[i].antenna << 26 | mac.step[i].ms);
+    }
+    b[0] = BLOB_VERSION;
+    b[1] = s.entries;
+    b[2] = macros;
+    b[3] = 0;
+    return n;
+}
+
+bool validAction(const Schedule& s, uint8_t action)
+{
+    if (action & SCHED_MACRO) {
+        const int m = action & ~SCHED_MACRO;
+        return m >= 1 && m <= SCHED_MAX_MACROS && s.macro[m - 1].steps;
+    }
+    return action <= OUTPUTS_MAX;    // a smaller map turns the rest into off
+}
+
+bool decode(const uint8_t* b, size_t len, Schedule* s)
+{
+    *s = Schedule{};
+    if (len < 4 || b[0] < 1 || b[0] > BLOB_VERSION || b[1] > SCHED_MAX_ENTRIES || b[2] > SCHED_MAX_MACROS) return false;
+    size_t n = 4 + b[1] * 6;
+    if (len < n) return false;
+
+    for (int i = 0; i < b[2]; i++) {
+        if (n >= len) return false;
+        const int m = b[n] >> 4, steps = b[n] & 0x0f;
+        n++;
+        if (m < 1 || m > SCHED_MAX_MACROS || steps < 1 || steps > SCHED_MAX_STEPS || n + steps * 4 > len) return false;
+        SchedMacro& mac = s->macro[m - 1];
+        mac.steps = (uint8_t)steps;
+        for (int k = 0; k < steps; k++, n += 4) {
+            const uint32_t v = getLe32(b + n);
+            const int shift = b[0] == 1 ? 27 : 26;
+            mac.step[k].antenna = (uint8_t)(v >> shift);
+            mac.step[k].ms = v & ((1u << shift) - 1);
+            if (mac.step[k].antenna > OUTPUTS_MAX || mac.step[k].ms > SCHED_STEP_MAX_MS) return false;
+            if ((mac.step[k].ms == 0) != (k == steps - 1)) return false;
+        }
+    }
+    if (n != len) return false;
+
+    for (int i = 0; i < b[1]; i++) {
+        const uint8_t* p = b + 4 + i * 6;
+        SchedEntry& e = s->entry[i];
+        e.msOfDay = getLe32(p);
+        e.days = p[4];
+        e.action = p[5];
+        if (e.msOfDay >= DAY_MS || !e.days || e.days > SCHED_DAILY || !validAction(*s, e.action)) return false;
+    }
+    s->entries = b[1];
+    return true;
+}
+
+// --------------------------------------------------
+// Text
+// --------------------------------------------------
+struct Token
+{
+    const char* s;
+    size_t n;
+};
+
+bool tokenIs(Token t, const char* word)
+{
+    return strlen(word) == t.n && !strncasecmp(t.s, word, t.n);
+}
+
+bool parseUint(const char* s, size_t n, uint32_t max, uint32_t* v)
+{
+    if (n == 0 || n > 10) return false;
+    uint64_t x = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        x = x * 10 + (s[i] - '0');
+    }
+    if (x > max) return false;
+    *v = (uint32_t)x;
+    return true;
+}
+
+bool parseAntenna(Token t, uint8_t* ant)
+{
+    uint32_t v;
+    if (tokenIs(t, "off")) v = 0;
+    else if (!parseUint(t.s, t.n, outputCount(), &v)) return false;
+    *ant = (uint8_t)v;
+    return true;
+}
+
+// 90s, 1500ms, 2m, 1h; bare numbers are seconds
+bool parseDuration(Token t, uint32_t* ms)
+{
+    size_t digits = 0;
+    while (digits < t.n && t.s[digits] >= '0' && t.s[digits] <= '9') digits++;
+    const Token unit = {t.s + digits, t.n - digits};
+    uint64_t scale;
+    if (unit.n == 0 || tokenIs(unit, "s")) scale = 1000;
+    else if (tokenIs(unit, "ms")) scale = 1;
+    else if (tokenIs(unit, "m")) scale = 60000;
+    else if (tokenIs(unit, "h")) scale = 3600000;
+    else return false;
+
+    uint32_t v;
+    if (!parseUint(t.s, digits, SCHED_STEP_MAX_MS, &v) || v == 0 || v * scale > SCHED_STEP_MAX_MS) return false;
+    *ms = (uint32_t)(v * scale);
+    return true;
+}
+
+// hh:mm[:ss[.mmm]]
+bool parseTime(Token t, uint32_t* ms)
+{
+    uint32_t h, m, s = 0, frac = 0;
+    const char* end = t.s + t.n;
+    const char* c1 = (const char*)memchr(t.s, ':', t.n);
+    if (!c1 || !parseUint(t.s, c1 - t.s, 23, &h)) return false;
+    const char* p = c1 + 1;
+    const char* c2 = (const char*)memchr(p, ':', end - p);
+    if (!parseUint(p, (c2 ? c2 : end) - p, 59, &m) || (c2 ? c2 : end) - p != 2) return false;
+    if (c2) {
+        p = c2 + 1;
+        const char* dot = (const char*)memchr(p, '.', end - p);
+        if (!parseUint(p, (dot ? dot : end) - p, 59, &s) || (dot ? dot : end) - p != 2) return false;
+        if (dot && (end - dot - 1 != 3 || !parseUint(dot + 1, 3, 999, &frac))) return false;
+    }
+    *ms = ((h * 60 + m) * 60 + s) * 1000 + frac;
+    return true;
+}
+
+int dayIndex(const char* s, size_t n)
+{
+    for (int d = 0; d < 7; d++) {
+        if (tokenIs(Token{s, n}, DAY_NAMES[d])) return d;
+    }
+    return -1;
+}
+
+// daily | weekdays | weekends | mon,wed,fri | mon-fri (ranges may wrap)
+bool parseDays(Token t, uint8_t* days)
+{
+    if (tokenIs(t, "daily")) *days = SCHED_DAILY;
+    else if (tokenIs(t, "weekdays")) *days = WEEKDAYS;
+    else if (tokenIs(t, "weekends")) *days = WEEKENDS;
+    else {
+        uint8_t mask = 0;
+        const char* p = t.s;
+        const char* end = t.s + t.n;
+        while (p < end) {
+            const char* comma = (const char*)memchr(p, ',', end - p);
+            const char* itemEnd = comma ? comma : end;
+            const char* dash = (const char*)memchr(p, '-', itemEnd - p);
+            const int from = dayIndex(p, (dash ? dash : itemEnd) - p);
+            const int to = dash ? dayIndex(dash + 1, itemEnd - dash - 1) : from;
+            if (from < 0 || to < 0) return false;
+            for (int d = from;; d = (d + 1) % 7) {
+                mask |= 1 << d;
+                if (d == to) break;
+            }
+            p = itemEnd + 1;
+        }
+        *days = mask;
+    }
+    return true;
+}
+
+bool fail(char* error, size_t size, int line, const char* what, Token t = Token{nullptr, 0})
+{
+    if (t.s) snprintf(error, size, "line %d: %s '%.*s'", line, what, (int)t.n, t.s);
+    else snprintf(error, size, "line %d: %s", line, what);
+    return false;
+}
+
+void writeDuration(TextBuffer& out, uint32_t ms)
+{
+    if (ms % 3600000 == 0) out.printf("/%uh", (unsigned)(ms / 3600000));
+    else if (ms % 60000 == 0) out.printf("/%um", (unsigned)(ms / 60000));
+    else if (ms % 1000 == 0) out.printf("/%us", (unsigned)(ms / 1000));
+    else out.printf("/%ums", (unsigned)ms);
+}
+
+void writeAntenna(TextBuffer& out, uint8_t ant)
+{
+    if (ant == 0) out.add(" off");
+    else out.printf(" %u", ant);
+}
+
+} // namespace
+
+bool scheduleParse(const char* text, size_t len, Schedule* out, char* error, size_t errorSize)
+{
+    const int TOKENS_MAX = 2 + SCHED_MAX_STEPS + 1;   // one over, to say "too many steps"
+    int refLine[SCHED_MAX_ENTRIES];
+    Schedule s = {};
+    const char* p = text;
+    const char* end = text + len;
+    int line = 1;
+
+    if (len > SCHED_TEXT_MAX) {
+        snprintf(error, errorSize, "schedule longer than %u bytes", (unsigned)SCHED_TEXT_MAX);
+        return false;
+    }
+
+    while (p < end) {
+        // One statement: up to ';', a newline or a comment
+        Token tok[TOKENS_MAX];
+        int count = 0;
+        const char* q = p;
+        while (q < end && *q != ';' && *q != '\n' && *q != '#') {
+            if (*q == ' ' || *q == '\t' || *q == '\r') {
+                q++;
+                continue;
+            }
+            const char* start = q;
+            while (q < end && *q != ';' && *q != '\n' && *q != '#' && *q != ' ' && *q != '\t' && *q != '\r') q++;
+            if (count == TOKENS_MAX) return fail(error, errorSize, line, "too many words");
+            tok[count++] = Token{start, (size_t)(q - start)};
+        }
+        if (q < end && *q == '#') {
+            while (q < end && *q != '\n') q++;
+        }
+        const int stmtLine = line;
+        if (q < end && *q == '\n') line++;
+        p = q + 1;
+        if (count == 0) continue;
+
+        if (tokenIs(tok[0], "macro")) {
+            uint32_t m;
+            if (count < 3) return fail(error, errorSize, stmtLine, "macro needs a number and steps");
+            if (count - 2 > SCHED_MAX_STEPS) return fail(error, errorSize, stmtLine, "too many steps");
+            if (!parseUint(tok[1].s, tok[1].n, SCHED_MAX_MACROS, &m) || m == 0) {
+                return fail(error, errorSize, stmtLine, "bad macro number", tok[1]);
+            }
+            SchedMacro& mac = s.macro[m - 1];
+            if (mac.steps) return fail(error, errorSize, stmtLine, "macro defined twice", tok[1]);
+            for (int i = 2; i < count; i++) {
+                const Token t = tok[i];
+                const char* slash = (const char*)memchr(t.s, '/', t.n);
+                SchedStep& step = mac.step[i - 2];
+                if (!parseAntenna(Token{t.s, slash ? (size_t)(slash - t.s) : t.n}, &step.antenna)) {
+                    return fail(error, errorSize, stmtLine, "bad antenna", t);
+                }
+                step.ms = 0;
+                if (slash && !parseDuration(Token{slash + 1, t.n - (slash + 1 - t.s)}, &step.ms)) {
+                    return fail(error, errorSize, stmtLine, "bad duration", t);
+                }
+                const bool last = i == count - 1;
+                if (!last && !step.ms) return fail(error, errorSize, stmtLine, "only the last step holds", t);
+                if (last && step.ms) return fail(error, errorSize, stmtLine, "the last step holds, no duration", t);
+            }
+            mac.steps = (uint8_t)(count - 2);
+        } else if (tokenIs(tok[0], "at")) {
+            if (count < 3 || count > 4) return fail(error, errorSize, stmtLine, "expected: at <time> [<days>] <action>");
+            if (s.entries == SCHED_MAX_ENTRIES) return fail(error, errorSize, stmtLine, "too many entries");
+            SchedEntry& e = s.entry[s.entries];
+            if (!parseTime(tok[1], &e.msOfDay)) return fail(error, errorSize, stmtLine, "bad time", tok[1]);
+            e.days = SCHED_DAILY;
+            if (count == 4 && !parseDays(tok[2], &e.days)) return fail(error, errorSize, stmtLine, "bad days", tok[2]);
+
+            const Token a = tok[count - 1];
+            uint32_t m;
+            if (a.n >= 2 && (a.s[0] == 'm' || a.s[0] == 'M') && parseUint(a.s + 1, a.n - 1, SCHED_MAX_MACROS, &m) && m) {
+                e.action = SCHED_MACRO | (uint8_t)m;
+            } else if (!parseAntenna(a, &e.action)) {
+                return fail(error, errorSize, stmtLine, "bad action", a);
+            }
+            refLine[s.entries++] = stmtLine;
+        } else {
+            return fail(error, errorSize, stmtLine, "unknown statement", tok[0]);
+        }
+    }
+
+    for (int i = 0; i < s.entries; i++) {
+        if (!validAction(s, s.entry[i].action)) return fail(error, errorSize, refLine[i], "macro not defined");
+    }
+    *out = s;
+    return true;
+}
+
+bool scheduleFormat(const Schedule& s, uint32_t line, TextBuffer& out)
+{
+    for (int m = 0; m < SCHED_MAX_MACROS; m++) {
+        const SchedMacro& mac = s.macro[m];
+        if (!mac.steps) continue;
+        if (line) {
+            line--;
+            continue;
+        }
+        out.printf("macro %d", m + 1);
+        for (int i = 0; i < mac.steps; i++) {
+            writeAntenna(out, mac.step[i].antenna);
+            if (mac.step[i].ms) writeDuration(out, mac.step[i].ms);
+        }
+        out.add("\n");
+        return true;
+    }
+    if (line >= s.entries) return false;
+
+    const SchedEntry& e = s.entry[line];
+    const uint32_t sec = e.msOfDay / 1000;
+    out.printf("at %02u:%02u", (unsigned)(sec / 3600), (unsigned)(sec / 60 % 60));
+    if (e.msOfDay % 60000) {
+        out.printf(":%02u", (unsigned)(sec % 60));
+        if (e.msOfDay % 1000) out.printf(".%03u", (unsigned)(e.msOfDay % 1000));
+    }
+
+    if (e.days == WEEKDAYS) out.add(" weekdays");
+    else if (e.days == WEEKENDS) out.add(" weekends");
+    else if (e.days != SCHED_DAILY) {
+        char sep = ' ';
+        for (int d = 0; d < 7; d++) {
+            if (!(e.days & (1 << d))) continue;
+            out.printf("%c%s", sep, DAY_NAMES[d]);
+            sep = ',';
+        }
+    }
+
+    if (e.action & SCHED_MACRO) out.printf(" m%u", (unsigned)(e.action & ~SCHED_MACRO));
+    else writeAntenna(out, e.action);
+    out.add("\n");
+    return true;
+}
+
+void schedulerBegin()
+{
+    if (!timer) timer = halTimerCreate("sched", fire);
+
+    uint8_t blob[BLOB_MAX];
+    size_t len = 0;
+    Preferences nvs;
+    if (nvs.begin("antSwitch", true)) {
+        len = nvs.getBytesLength(BLOB_KEY);
+        if (len > sizeof(blob) || nvs.getBytes(BLOB_KEY, blob, len) != len) len = 0;
+        nvs.end();
+    }
+
+    Schedule s;
+    if (len && !decode(blob, len, &s)) {
+        Serial.println("Schedule in NVS is not valid, ignored");
+        len = 0;
+    }
+    if (!len) s = Schedule{};
+
+    halCriticalEnter();
+    current = s;
+    heapLen = 0;
+    stats = SchedulerStats{};
+    stats.entries = s.entries;
+    for (int m = 0; m < SCHED_MAX_MACROS; m++) stats.macros += s.macro[m].steps != 0;
+    stats.blobBytes = (uint32_t)len;
+    halCriticalExit();
+
+    planned = false;
+    arm();
+    Serial.printf("Schedule: %u entries, %u macros\n", stats.entries, stats.macros);
+}
+
+bool schedulerLoad(const Schedule& s)
+{
+    uint8_t blob[BLOB_MAX];
+    const size_t len = encode(s, blob);
+
+    // A retained topic redelivers the same batch on every reconnect.
+    uint8_t old[BLOB_MAX];
+    if (stats.blobBytes == len && encode(current, old) == len && !memcmp(old, blob, len)) return true;
+
+    Preferences nvs;
+    bool saved = nvs.begin("antSwitch", false);
+    if (saved) {
+        saved = nvs.putBytes(BLOB_KEY, blob, len) == len;
+        nvs.end();
+    }
+
+    halCriticalEnter();
+    current = s;
+    heapLen = 0;             // a running macro ends with the schedule it came from
+    stats.running = 0;
+    stats.entries = blob[1];
+    stats.macros = blob[2];
+    stats.blobBytes = saved ? (uint32_t)len : 0;
+    halCriticalExit();
+
+    planned = false;
+    arm();
+    schedulerService();
+    return saved;
+}
+
+const Schedule& schedulerCurrent()
+{
+    return current;
+}
+
+void schedulerService()
+{
+    uint64_t utcUs;
+    if (!halUtcMicros(&utcUs)) return;
+    const uint64_t nowUs = halMicros();
+    const int64_t drift = (int64_t)(utcUs - nowUs) - planOffsetUs;
+    if (planned && drift <= (int64_t)SCHED_RESYNC_US && drift >= -(int64_t)SCHED_RESYNC_US) return;
+    plan(utcUs, nowUs);
+}
+
+SchedulerStats schedulerStats()
+{
+    halCriticalEnter();
+    SchedulerStats s = stats;
+    const uint64_t next = heapLen ? heap[0].dueUs : 0;
+    halCriticalExit();
+
+    const uint64_t now = halMicros();
+    s.nextInMs = !next ? -1 : next > now ? (int32_t)((next - now) / 1000) : 0;
+    return s;
+}
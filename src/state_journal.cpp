@@ -0,0 +1,145 @@
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include "outputs.h"
+#include "state_journal.h"
+
+namespace {
+
+struct JournalRecord
+{
+    uint16_t seq;
+    uint8_t  reserved;
+    uint8_t  crc;            // CRC-8 of the other seven bytes
+    uint32_t outputs;
+};
+
+struct LegacyRecord          // before the output map: 1..4 only
+{
+    uint16_t seq;
+    uint8_t  antenna;
+    uint8_t  crc;            // CRC-8 of the first three bytes
+};
+
+Preferences journal;
+bool opened = false;
+
+uint32_t shadow = 0;         // latest selection (RAM)
+uint32_t persisted = 0;      // what the newest record holds
+bool dirty = false;
+unsigned long firstChangeMs = 0;
+unsigned long lastChangeMs = 0;
+JournalStats stats = {};
+
+uint8_t crc8(const uint8_t* p, size_t n)
+{
+    uint8_t crc = 0;
+    while (n--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+void slotKey(int slot, char* key)
+{
+    snprintf(key, 8, "j%d", slot);
+}
+
+uint8_t recordCrc(const JournalRecord& rec)
+{
+    const uint8_t* p = (const uint8_t*)&rec;
+    uint8_t b[7];
+    memcpy(b, p, 3);
+    memcpy(b + 3, p + 4, 4);
+    return crc8(b, sizeof(b));
+}
+
+bool newer(uint16_t a, uint16_t b)
+{
+    return (int16_t)(a - b) > 0;
+}
+
+bool readSlot(const char* key, JournalRecord* rec)
+{
+    const size_t len = journal.getBytesLength(key);
+    if (len == sizeof(JournalRecord)) {
+        return journal.getBytes(key, rec, sizeof(*rec)) == sizeof(*rec) && rec->crc == recordCrc(*rec);
+    }
+    LegacyRecord old;
+    if (len != sizeof(old) || journal.getBytes(key, &old, sizeof(old)) != sizeof(old)) return false;
+    if (old.crc != crc8((const uint8_t*)&old, 3) || old.antenna > OUTPUTS_MAX) return false;
+    *rec = JournalRecord{old.seq, 0, 0, outputBit(old.antenna)};
+    return true;
+}
+
+} // namespace
+
+uint32_t journalBegin(uint32_t fallback)
+{
+    if (!opened) opened = journal.begin("antJournal", false);
+
+    bool found = false;
+    JournalRecord newest = {};
+    for (int slot = 0; opened && slot < JOURNAL_SLOTS; slot++) {
+        char key[8];
+        JournalRecord rec;
+        slotKey(slot, key);
+        if (!readSlot(key, &rec)) continue;
+        if (!found || newer(rec.seq, newest.seq)) {
+            newest = rec;
+            found = true;
+        }
+    }
+
+    shadow = persisted = found ? newest.outputs : fallback;
+    stats.seq = found ? newest.seq : 0;
+    dirty = false;
+    return shadow;
+}
+
+void journalRecord(uint32_t outputs)
+{
+    unsigned long now = millis();
+    stats.recorded++;
+    if (!dirty) firstChangeMs = now;
+    lastChangeMs = now;
+    shadow = outputs;
+    dirty = (shadow != persisted);
+}
+
+void journalService()
+{
+    if (!dirty) return;
+    unsigned long now = millis();
+    if (now - lastChangeMs < JOURNAL_QUIET_MS && now - firstChangeMs < JOURNAL_MAX_DELAY_MS) return;
+    journalFlush();
+}
+
+void journalFlush()
+{
+    if (!dirty || !opened) return;
+
+    JournalRecord rec;
+    rec.seq = (uint16_t)(stats.seq + 1);
+    rec.reserved = 0;
+    rec.outputs = shadow;
+    rec.crc = recordCrc(rec);
+
+    char key[8];
+    slotKey(rec.seq % JOURNAL_SLOTS, key);
+    if (journal.putBytes(key, &rec, sizeof(rec)) != sizeof(rec)) return;
+
+    stats.seq = rec.seq;
+    stats.flushes++;
+    stats.bytesWritten += sizeof(rec);
+    persisted = shadow;
+    dirty = false;
+}
+
+JournalStats journalStats()
+{
+    JournalStats s = stats;
+    s.pending = dirty;
+    return s;
+}
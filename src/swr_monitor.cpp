@@ -0,0 +1,186 @@
+#include <Arduino.h>
+#include <string.h>
+
+#include "event_log.h"
+#include "hal.h"
+#include "outputs.h"
+#include "relay_sequencer.h"
+#include "relay_task.h"
+#include "swr_monitor.h"
+
+namespace {
+
+enum { FWD, REFL };
+
+const uint32_t POINTS_PER_S = SWR_SAMPLE_HZ / 2 / SWR_DECIMATE;
+
+struct Track
+{
+    int32_t  fwd;            // rolling point sums, << 8
+    int32_t  refl;
+    uint32_t txPoints;
+    uint16_t peakSwr;
+    uint32_t trips;
+};
+
+bool enabled = false;
+
+// ADC task only
+uint32_t sum[2] = {};
+uint32_t taken = 0;                  // samples in the point being summed
+uint32_t over = 0;                   // points in a row above the trip SWR
+uint32_t tripOutputs = 0;            // what a posted trip is dropping, 0 = none pending
+
+// Shared with loop(), under halCritical
+uint16_t tripSwr = 0;
+uint16_t fullScaleW = 0;
+Track tracks[OUTPUTS_MAX] = {};
+SwrStats stats = {};
+
+uint16_t swrOf(uint32_t fwd, uint32_t refl)
+{
+    if (refl >= fwd) return SWR_MAX;
+    const uint64_t swr = (uint64_t)(fwd + refl) * 100 / (fwd - refl);
+    return swr < SWR_MAX ? (uint16_t)swr : SWR_MAX;
+}
+
+// A rolling point sum -> mW, with full scale at fullScaleW
+uint32_t powerMw(int32_t q, uint16_t scaleW)
+{
+    const uint64_t v = ((uint32_t)q + 128) >> 8;
+    return (uint32_t)(v * v * scaleW * 1000 / ((uint64_t)SWR_FULL_SCALE * SWR_FULL_SCALE));
+}
+
+// ADC task: one frame from the DMA
+void onFrame(const uint16_t* samples, size_t count)
+{
+    const uint64_t startUs = halMicros();
+
+    // Relays moving or all off: the detectors say nothing about an antenna
+    const bool still = relaySequencerSettleUs() == 0;
+    const uint32_t driven = relaySequencerOutputs();
+    const int antenna = still ? outputsAntenna(driven) : 0;
+    if (driven != tripOutputs) tripOutputs = 0;
+
+    halCriticalEnter();
+    const uint32_t limit = tripSwr;
+    halCriticalExit();
+
+    Track t = antenna > 0 ? tracks[antenna - 1] : Track();
+    uint32_t points = 0, skipped = 0, txPoints = 0;
+    uint32_t tripFwd = 0, tripRefl = 0;
+    bool tx = stats.transmitting;
+
+    for (size_t i = 0; i < count; i++) {
+        const uint16_t s = samples[i];
+        sum[s >> 12 & 1] += s & 0x0fff;
+        if (++taken < 2 * SWR_DECIMATE) continue;
+
+        const uint32_t fwd = sum[FWD], refl = sum[REFL];
+        sum[FWD] = sum[REFL] = 0;
+        taken = 0;
+        points++;
+        if (!still) {
+            skipped++;
+            over = 0;
+            continue;
+        }
+        tx = fwd >= SWR_MIN_FWD;
+        if (!tx) {
+            over = 0;
+            continue;
+        }
+        txPoints++;
+        if (antenna > 0) {
+            t.fwd += ((int32_t)(fwd << 8) - t.fwd) >> SWR_FILTER_SHIFT;
+            t.refl += ((int32_t)(refl << 8) - t.refl) >> SWR_FILTER_SHIFT;
+        }
+        // refl / fwd > (S - 1) / (S + 1), S = limit / 100
+        if (limit && refl * (limit + 100) > fwd * (limit - 100)) {
+            if (++over >= SWR_TRIP_POINTS && !tripOutputs && !tripFwd) {
+                tripFwd = fwd;
+                tripRefl = refl;
+            }
+        } else {
+            over = 0;
+        }
+    }
+
+    bool refused = false;
+    uint16_t swr = 0;
+    if (tripFwd) {
+        swr = swrOf(tripFwd, tripRefl);
+        refused = !relayPostOutputs(0, RELAY_SRC_SWR, startUs);
+        if (!refused) {
+            tripOutputs = driven;
+            over = 0;
+            eventLog(EVENT_SWR, 0, (uint8_t)(antenna > 0 ? antenna : 0), swr);
+            if (antenna > 0) t.trips++;
+        }
+    }
+    if (antenna > 0 && txPoints) {
+        t.txPoints += txPoints;
+        const uint16_t rolling = swrOf((uint32_t)t.fwd, (uint32_t)t.refl);
+        if (rolling > t.peakSwr) t.peakSwr = rolling;
+    }
+
+    const uint32_t us = (uint32_t)(halMicros() - startUs);
+    halCriticalEnter();
+    if (antenna > 0) tracks[antenna - 1] = t;
+    stats.antenna = (int8_t)(still ? antenna : 0);
+    stats.transmitting = tx;
+    stats.frames++;
+    stats.points += points;
+    stats.skipped += skipped;
+    if (tripFwd && refused) {
+        stats.tripsRefused++;
+    } else if (tripFwd) {
+        stats.trips++;
+        stats.lastTripSwr = swr;
+        stats.lastTripAntenna = (int8_t)antenna;
+    }
+    if (us > stats.maxFrameUs) stats.maxFrameUs = us;
+    halCriticalExit();
+}
+
+} // namespace
+
+void swrMonitorBegin(const SwrConfig& cfg)
+{
+    swrMonitorSetLimits(cfg.tripSwr, cfg.fullScaleW);
+    if (enabled || cfg.fwdPin < 0 || cfg.reflPin < 0) return;
+    const int pins[2] = {cfg.fwdPin, cfg.reflPin};
+    enabled = halAdcStart(pins, 2, SWR_SAMPLE_HZ, onFrame, SWR_TASK_CORE, SWR_TASK_PRIORITY);
+    if (!enabled) Serial.printf("SWR monitor: pins %d/%d are not ADC1 inputs\n", cfg.fwdPin, cfg.reflPin);
+}
+
+void swrMonitorSetLimits(uint16_t trip, uint16_t scaleW)
+{
+    halCriticalEnter();
+    tripSwr = trip && trip < 110 ? 110 : trip;
+    fullScaleW = scaleW;
+    halCriticalExit();
+}
+
+SwrStats swrMonitorStats()
+{
+    static Track copy[OUTPUTS_MAX];      // loop() only; off its stack
+    halCriticalEnter();
+    SwrStats s = stats;
+    const uint16_t scaleW = fullScaleW;
+    memcpy(copy, tracks, sizeof(copy));
+    halCriticalExit();
+
+    s.enabled = enabled;
+    for (int i = 0; i < OUTPUTS_MAX; i++) {
+        const Track& t = copy[i];
+        SwrAntennaStats& a = s.antennas[i];
+        a.txMs = (uint32_t)((uint64_t)t.txPoints * 1000 / POINTS_PER_S);
+        a.fwdMw = powerMw(t.fwd, scaleW);
+        a.reflMw = powerMw(t.refl, scaleW);
+        a.swr = t.txPoints ? swrOf((uint32_t)t.fwd, (uint32_t)t.refl) : 0;
+        a.peakSwr = t.peakSwr;
+        a.trips = t.trips;
+    }
+    return s;
+}
@@ -0,0 +1,58 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "text_buffer.h"
+
+TextBuffer& TextBuffer::printf(const char* fmt, ...)
+{
+    if (full_) return *this;
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = vsnprintf(buf_ + len_, size_ - len_, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= size_ - len_) {
+        full_ = true;
+        buf_[len_] = '\0';
+    } else {
+        len_ += n;
+    }
+    return *this;
+}
+
+TextBuffer& TextBuffer::add(const char* s)
+{
+    if (full_) return *this;
+    const size_t n = strlen(s);
+    if (n >= size_ - len_) {
+        full_ = true;
+    } else {
+        memcpy(buf_ + len_, s, n + 1);
+        len_ += n;
+    }
+    return *this;
+}
+
+void TextBuffer::truncate(size_t len)
+{
+    if (len > len_) return;
+    len_ = len;
+    buf_[len_] = '\0';
+    full_ = false;
+}
+
+size_t textRenderItems(TextItemFn item, char* buf, size_t size, uint32_t* cursor)
+{
+    // Up to size - 1 bytes: vsnprintf wants room for the NUL.
+    TextBuffer out(buf, size);
+    for (;;) {
+        const size_t mark = out.length();
+        if (!item(*cursor, out)) break;
+        if (out.full()) {
+            out.truncate(mark);
+            break;
+        }
+        ++*cursor;
+    }
+    return out.length();
+}
@@ -0,0 +1,128 @@
+#include <Arduino.h>
+
+#include "hal.h"
+#include "relay_sequencer.h"
+#include "relay_task.h"
+#include "tx_interlock.h"
+
+namespace {
+
+HalTimerHandle timer = nullptr;
+TxInterlockConfig cfg = {-1, true, -1};
+uint64_t ampMask = 0;
+
+// Shared with the PTT interrupt, under halCritical
+bool transmitting = false;
+bool keyPending = false;             // key once the relays settle
+uint64_t assertedAtUs = 0;
+uint64_t releaseAtUs = 0;            // end of the release hold, 0 = none
+TxInterlockStats stats = {};
+
+void IRAM_ATTR key(uint64_t now)
+{
+    halGpioWriteMask(0, ampMask);
+    const uint32_t us = (uint32_t)(now - assertedAtUs);
+    stats.keyed = true;
+    stats.lastKeyDelayUs = us;
+    if (us > stats.maxKeyDelayUs) stats.maxKeyDelayUs = us;
+}
+
+void IRAM_ATTR onPtt(bool level)
+{
+    const bool active = level != cfg.activeLow;
+    const uint64_t now = halMicros();
+    bool wake = false;
+
+    halCriticalEnter();
+    if (active && !transmitting) {
+        relaySequencerHold(true);
+        transmitting = true;
+        assertedAtUs = now;
+        releaseAtUs = 0;
+        stats.transmissions++;
+        if (ampMask) {
+            if (relaySequencerSettleUs() == 0) key(now);
+            else keyPending = wake = true;
+        }
+    } else if (!active && transmitting) {
+        if (stats.keyed) halGpioWriteMask(ampMask, 0);
+        stats.keyed = false;
+        transmitting = false;
+        keyPending = false;
+        releaseAtUs = now + TX_RELEASE_HOLD_US;
+        wake = true;
+    }
+    halCriticalExit();
+
+    if (wake) relayTaskWakeFromIsr();
+}
+
+void onTimer()
+{
+    relayTaskWake();
+}
+
+} // namespace
+
+void txInterlockBegin(const TxInterlockConfig& c)
+{
+    cfg = c;
+    if (cfg.pttPin < 0) return;
+    if (!timer) timer = halTimerCreate("ptt", onTimer);
+
+    if (cfg.ampKeyPin >= 0) {
+        ampMask = 1ULL << cfg.ampKeyPin;
+        halGpioOutput(cfg.ampKeyPin);
+        halGpioWrite(cfg.ampKeyPin, false);
+    }
+    halGpioInput(cfg.pttPin, cfg.activeLow);
+    halGpioOnChange(cfg.pttPin, onPtt);
+    onPtt(halGpioRead(cfg.pttPin));
+}
+
+void txInterlockService()
+{
+    if (cfg.pttPin < 0) return;
+    const uint64_t now = halMicros();
+    uint64_t armUs = 0;
+    bool released = false;
+
+    halCriticalEnter();
+    if (keyPending) {
+        // halCritical nests, so the interrupt cannot slip between the
+        // settle check and the key
+        const uint32_t settleUs = relaySequencerSettleUs();
+        if (settleUs == 0) {
+            key(now);
+            stats.keyedLate++;
+            keyPending = false;
+        } else if (settleUs == UINT32_MAX) {
+            stats.inhibited++;
+            keyPending = false;
+        } else {
+            armUs = settleUs;
+        }
+    }
+    if (releaseAtUs && now >= releaseAtUs) {
+        releaseAtUs = 0;
+        relaySequencerHold(false);
+        released = true;
+    } else if (releaseAtUs && (!armUs || releaseAtUs - now < armUs)) {
+        armUs = releaseAtUs - now;
+    }
+    halCriticalExit();
+
+    if (armUs) halTimerArm(timer, (uint32_t)armUs);
+    if (released) relaySequencerService();   // the switch deferred through TX
+}
+
+TxInterlockStats txInterlockStats()
+{
+    halCriticalEnter();
+    TxInterlockStats s = stats;
+    s.transmitting = transmitting;
+    s.held = transmitting || releaseAtUs;
+    halCriticalExit();
+    s.enabled = cfg.pttPin >= 0;
+    return s;
+}
@@ -0,0 +1,347 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "hal.h"
+#include "outputs.h"
+#include "relay_task.h"
+#include "sha256.h"
+#include "udp_control.h"
+
+namespace {
+
+struct Client
+{
+    uint32_t ip;
+    uint16_t port;
+    bool     used;
+    bool     answered;       // seq is valid
+    uint32_t session;        // nonzero; bound into its requests' MAC
+    uint32_t seq;            // last one answered
+    uint64_t seenUs;
+    uint8_t  ack[UDP_ACK_SIZE + UDP_MAC_SIZE];
+    uint8_t  ackLen;
+};
+
+// Receive task only, apart from udpControlBegin()
+Client clients[UDP_CLIENTS];
+
+// Shared with loop(); under halCritical
+char key[UDP_KEY_MAX + 1] = "";
+UdpControlStats stats = {};
+
+uint32_t get32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+void put32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+void count(uint32_t UdpControlStats::*field)
+{
+    halCriticalEnter();
+    stats.*field += 1;
+    halCriticalExit();
+}
+
+Client* findClient(uint32_t ip, uint16_t port)
+{
+    for (Client& c : clients) {
+        if (c.used && c.ip == ip && c.port == port) return &c;
+    }
+    return nullptr;
+}
+
+// A new session for ip and port: in c if given, else in the least
+// recently seen entry.
+Client* startClient(Client* c, uint32_t ip, uint16_t port)
+{
+    if (!c) {
+        c = &clients[0];
+        for (Client& e : clients) {
+            if (!e.used || (c->used && e.seenUs < c->seenUs)) c = &e;
+        }
+    }
+    *c = Client();
+    c->ip = ip;
+    c->port = port;
+    c->used = true;
+    do {
+        c->session = halRandom();
+    } while (!c->session);
+    count(&UdpControlStats::sessions);
+    return c;
+}
+
+bool requestMacOk(const char* k, const uint8_t* data, uint32_t session)
+{
+    uint8_t signedPart[UDP_REQUEST_SIZE + 4];
+    memcpy(signedPart, data, UDP_REQUEST_SIZE);
+    put32(signedPart + UDP_REQUEST_SIZE, session);
+    uint8_t mac[UDP_MAC_SIZE];
+    udpControlMac(k, signedPart, sizeof(signedPart), mac);
+    uint8_t diff = 0;
+    for (size_t i = 0; i < UDP_MAC_SIZE; i++) diff |= mac[i] ^ data[UDP_REQUEST_SIZE + i];
+    return !diff;
+}
+
+size_t buildAck(uint8_t* ack, const char* k, uint8_t op, uint32_t seq, UdpStatus status, uint32_t outputs,
+                uint32_t session, uint8_t flags = 0)
+{
+    ack[0] = 'A';
+    ack[1] = 'S';
+    ack[2] = UDP_VERSION;
+    ack[3] = op | 0x80;
+    put32(ack + 4, seq);
+    ack[8] = status;
+    ack[9] = (uint8_t)(int8_t)outputsAntenna(outputs);
+    ack[10] = (uint8_t)outputCount();
+    ack[11] = flags;
+    put32(ack + 12, outputs);
+    put32(ack + 16, session);
+    if (!k[0]) return UDP_ACK_SIZE;
+    udpControlMac(k, ack, UDP_ACK_SIZE, ack + UDP_ACK_SIZE);
+    return UDP_ACK_SIZE + UDP_MAC_SIZE;
+}
+
+void onDatagram(const uint8_t* data, size_t len, uint32_t ip, uint16_t port)
+{
+    const uint64_t arrivedUs = halMicros();
+    char k[UDP_KEY_MAX + 1];
+    halCriticalEnter();
+    memcpy(k, key, sizeof(k));
+    stats.received++;
+    halCriticalExit();
+
+    const size_t expected = UDP_REQUEST_SIZE + (k[0] ? UDP_MAC_SIZE : 0);
+    if (len != expected || data[0] != 'A' || data[1] != 'S' || data[2] != UDP_VERSION) {
+        count(&UdpControlStats::invalid);
+        return;
+    }
+
+    // With a key, the MAC covers the client's session too: a request
+    // verifies for its own entry, or with 0 as a client starting over.
+    Client* c = findClient(ip, port);
+    bool fresh = !c;
+    if (k[0] && !(c && requestMacOk(k, data, c->session))) {
+        if (!requestMacOk(k, data, 0)) {
+            count(&UdpControlStats::badMac);
+            return;
+        }
+        fresh = true;
+    }
+    if (fresh) c = startClient(c, ip, port);
+    c->seenUs = arrivedUs;
+
+    const uint8_t op = data[3];
+    const uint32_t seq = get32(data + 4);
+    const uint32_t outputs = get32(data + 8);
+    const bool known = c->answered;
+
+    uint8_t ack[UDP_ACK_SIZE + UDP_MAC_SIZE];
+    if (known && seq == c->seq) {
+        halUdpSend(ip, port, c->ack, c->ackLen);
+        count(&UdpControlStats::duplicates);
+        return;
+    }
+    if (known && (int32_t)(seq - c->seq) < 0) {
+        halUdpSend(ip, port, ack, buildAck(ack, k, op, seq, UDP_STALE, relaySnapshot().outputs, c->session));
+        count(&UdpControlStats::stale);
+        return;
+    }
+    if (k[0] && fresh && op == UDP_OP_SELECT) {
+        // Signed without a session: could be a replay, so not applied
+        halUdpSend(ip, port, ack, buildAck(ack, k, op, seq, UDP_SESSION, relaySnapshot().outputs, c->session));
+        return;
+    }
+
+    UdpStatus status = UDP_OK;
+    uint32_t state = 0;
+    uint8_t flags = 0;
+    if (op == UDP_OP_SELECT && !(outputs & ~outputsAll())) {
+        RelayPostResult r;
+        state = outputs;
+        relayPostOutputs(outputs, RELAY_SRC_UDP, arrivedUs, &r);
+        if (r.verdict == RELAY_BUSY) {
+            status = UDP_BUSY;
+        } else if (r.verdict == RELAY_LOCKED || r.verdict == RELAY_OUTRANKED) {
+            status = r.verdict == RELAY_LOCKED ? UDP_LOCKED : UDP_OUTRANKED;
+            state = relaySnapshot().outputs;
+        }
+        if (r.verdict == RELAY_HELD) flags |= UDP_ACK_HELD;
+        if (r.superseded) flags |= UDP_ACK_SUPERSEDED;
+    } else if (op == UDP_OP_STATE) {
+        state = relaySnapshot().outputs;
+    } else {
+        status = UDP_BAD_REQUEST;
+        state = relaySnapshot().outputs;
+    }
+    const size_t n = buildAck(ack, k, op, seq, status, state, c->session, flags);
+    halUdpSend(ip, port, ack, n);
+
+    // A busy post is not remembered, so its retry is posted again
+    if (status != UDP_BUSY) {
+        c->answered = true;
+        c->seq = seq;
+        memcpy(c->ack, ack, n);
+        c->ackLen = (uint8_t)n;
+    }
+
+    const uint32_t us = (uint32_t)(halMicros() - arrivedUs);
+    halCriticalEnter();
+    if (status == UDP_BUSY) stats.busy++;
+    else if (status == UDP_LOCKED || status == UDP_OUTRANKED) stats.refused++;
+    else if (status == UDP_BAD_REQUEST) stats.invalid++;
+    else if (op == UDP_OP_SELECT) stats.selects++;
+    else stats.queries++;
+    stats.lastAckUs = us;
+    if (us > stats.maxAckUs) stats.maxAckUs = us;
+    halCriticalExit();
+}
+
+} // namespace
+
+bool udpControlBegin(uint16_t port)
+{
+    for (Client& c : clients) c = Client();
+    halCriticalEnter();
+    stats = UdpControlStats();
+    halCriticalExit();
+    return halUdpListen(port, onDatagram, UDP_TASK_CORE, UDP_TASK_PRIORITY);
+}
+
+void udpControlSetKey(const char* k)
+{
+    halCriticalEnter();
+    snprintf(key, sizeof(key), "%s", k);
+    halCriticalExit();
+}
+
+UdpControlStats udpControlStats()
+{
+    halCriticalEnter();
+    const UdpControlStats s = stats;
+    halCriticalExit();
+    return s;
+}
+
+// HMAC-SHA256 (RFC 2104); keys are at most one block, so never hashed.
+void udpControlMac(const char* k, const uint8_t* data, size_t len, uint8_t mac[UDP_MAC_SIZE])
+{
+    uint8_t pad[64] = {};
+    memcpy(pad, k, strnlen(k, UDP_KEY_MAX));
+    uint8_t digest[SHA256_SIZE];
+    Sha256 ctx;
+
+    for (uint8_t& b : pad) b ^= 0x36;
+    sha256Begin(&ctx);
+    sha256Update(&ctx, pad, sizeof(pad));
+    sha256Update(&ctx, data, len);
+    sha256Finish(&ctx, digest);
+
+    for (uint8_t& b : pad) b ^= 0x36 ^ 0x5c;
+    sha256Begin(&ctx);
+    sha256Update(&ctx, pad, sizeof(pad));
+    sha256Update(&ctx, digest, sizeof(digest));
+    sha256Finish(&ctx, digest);
+    memcpy(mac, digest, UDP_MAC_SIZE);
+}
+
+// --------------------------------------------------
+// State beacons (loop() only)
+// --------------------------------------------------
+namespace {
+
+struct Beacon
+{
+    uint32_t group;
+    uint16_t port;           // 0 = off
+    uint32_t heartbeatUs;    // 0 = changes only
+    uint32_t version;        // relay snapshot last sent
+    bool     locked;         // ... and the lock with it
+    bool     due;            // send the current state once the gap allows
+    uint64_t sentUs;
+};
+
+Beacon beacon = {};
+UdpBeaconStats beaconStats = {};
+
+void sendBeacon(const RelaySnapshot& s, uint8_t flags, uint64_t now)
+{
+    char k[UDP_KEY_MAX + 1];
+    halCriticalEnter();
+    memcpy(k, key, sizeof(k));
+    halCriticalExit();
+
+    uint8_t b[UDP_BEACON_SIZE + UDP_MAC_SIZE];
+    b[0] = 'A';
+    b[1] = 'S';
+    b[2] = UDP_VERSION;
+    b[3] = UDP_OP_BEACON;
+    put32(b + 4, ++beaconStats.seq);     // used even if the send fails: listeners see the loss
+    b[8] = (uint8_t)s.antenna;
+    b[9] = (uint8_t)outputCount();
+    b[10] = flags | (beacon.locked ? UDP_BEACON_LOCKED : 0);
+    b[11] = s.source;
+    put32(b + 12, s.outputs);
+    put32(b + 16, s.version);
+    put32(b + 20, (uint32_t)(now / 1000000));
+    size_t n = UDP_BEACON_SIZE;
+    if (k[0]) {
+        udpControlMac(k, b, n, b + n);
+        n += UDP_MAC_SIZE;
+    }
+    beacon.sentUs = now;
+    if (!halUdpMulticast(beacon.group, beacon.port, b, n)) beaconStats.failed++;
+}
+
+} // namespace
+
+void udpBeaconBegin(uint32_t group, uint16_t port, uint16_t heartbeatS)
+{
+    beacon = Beacon();
+    beaconStats = UdpBeaconStats();
+    udpBeaconConfigure(group, port, heartbeatS);
+}
+
+void udpBeaconConfigure(uint32_t group, uint16_t port, uint16_t heartbeatS)
+{
+    if (group != beacon.group || port != beacon.port) {
+        beacon.version = relaySnapshot().version;
+        beacon.due = true;
+    }
+    beacon.group = group;
+    beacon.port = port;
+    beacon.heartbeatUs = heartbeatS * 1000000UL;
+}
+
+void udpBeaconService()
+{
+    if (!beacon.port) return;
+    const uint64_t now = halMicros();
+    const RelaySnapshot s = relaySnapshot();
+    const bool locked = relayArbiterLocked();
+    if (s.version != beacon.version || locked != beacon.locked) beacon.due = true;
+    if (beacon.due) {
+        if (now - beacon.sentUs < UDP_BEACON_GAP_MS * 1000ULL) return;
+        if (s.version - beacon.version > 1) beaconStats.coalesced += s.version - beacon.version - 1;
+        beacon.version = s.version;
+        beacon.locked = locked;
+        beacon.due = false;
+        sendBeacon(s, UDP_BEACON_CHANGE, now);
+        beaconStats.changes++;
+    } else if (beacon.heartbeatUs && now - beacon.sentUs >= beacon.heartbeatUs) {
+        sendBeacon(s, 0, now);
+        beaconStats.heartbeats++;
+    }
+}
+
+UdpBeaconStats udpBeaconStats()
+{
+    return beaconStats;
+}
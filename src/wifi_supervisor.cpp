@@ -0,0 +1,328 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <ESPmDNS.h>
+#include <Preferences.h>
+
+#include "antenna_switch.h"
+#include "event_log.h"
+#include "hal.h"
+#include "metrics.h"
+#include "wifi_supervisor.h"
+
+namespace {
+
+const uint8_t EV_GOT_IP       = 0x01;
+const uint8_t EV_DISCONNECTED = 0x02;
+const uint8_t EV_ASSOCIATED   = 0x04;
+
+struct ApCache
+{
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t check;           // CRC-8 of the SSID and the bytes above
+};
+
+const char*   host = nullptr;
+const String* ssid = nullptr;
+const String* pass = nullptr;
+uint32_t gatewayIp = 0;
+
+volatile uint8_t events = 0;     // set on the WiFi event task
+WifiLinkState state = WIFI_LINK_CONNECTING;
+unsigned long stateSinceMs = 0;
+unsigned long offlineSinceMs = 0;
+uint32_t backoffMs = WIFI_BACKOFF_MIN_MS;     // wait before the next attempt
+bool mdnsStarted = false;
+unsigned long joinStartMs = 0;
+bool pinned = false;             // WiFi is configured for the cached AP; reconnect() goes there too
+bool associated = false;         // this attempt got past the join (DHCP may still be running)
+ApCache cache = {};
+bool cacheValid = false;
+
+bool verified = false;           // the gateway has answered since the link came up
+bool probing = false;
+uint8_t missesInRow = 0;
+unsigned long nextProbeMs = 0;
+
+WifiSupervisorStats stats = {};
+
+void onWifiEvent(arduino_event_id_t event)
+{
+    halCriticalEnter();
+    if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) events |= EV_GOT_IP;
+    else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) events |= EV_DISCONNECTED;
+    else if (event == ARDUINO_EVENT_WIFI_STA_CONNECTED) events |= EV_ASSOCIATED;
+    halCriticalExit();
+}
+
+uint8_t takeEvents()
+{
+    halCriticalEnter();
+    uint8_t ev = events;
+    events = 0;
+    halCriticalExit();
+    return ev;
+}
+
+uint8_t cacheCheck(const ApCache& c)
+{
+    uint8_t crc = 0;
+    const auto add = [&crc](const uint8_t* p, size_t n) {
+        while (n--) {
+            crc ^= *p++;
+            for (int i = 0; i < 8; i++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    };
+    add((const uint8_t*)ssid->c_str(), ssid->length());
+    add(c.bssid, sizeof(c.bssid));
+    add(&c.channel, 1);
+    return crc;
+}
+
+void loadCache()
+{
+    cacheValid = false;
+    Preferences nvs;
+    if (!nvs.begin("antSwitch", true)) return;
+    cacheValid = nvs.getBytes(WIFI_AP_CACHE_KEY, &cache, sizeof(cache)) == sizeof(cache) &&
+                 cache.channel >= 1 && cache.channel <= 14 && cache.check == cacheCheck(cache);
+    nvs.end();
+}
+
+void saveCache()
+{
+    const uint8_t* bssid = WiFi.BSSID();
+    const int32_t channel = WiFi.channel();
+    if (!bssid || channel < 1 || channel > 14) return;
+    if (cacheValid && cache.channel == channel && !memcmp(cache.bssid, bssid, sizeof(cache.bssid))) return;
+
+    memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+    cache.channel = (uint8_t)channel;
+    cache.check = cacheCheck(cache);
+    Preferences nvs;
+    if (!nvs.begin("antSwitch", false)) return;
+    cacheValid = nvs.putBytes(WIFI_AP_CACHE_KEY, &cache, sizeof(cache)) == sizeof(cache);
+    nvs.end();
+}
+
+void join(bool useCache)
+{
+    pinned = useCache && cacheValid;
+    associated = false;
+    stats.cachedJoin = pinned;
+    if (pinned) WiFi.begin(ssid->c_str(), pass->c_str(), cache.channel, cache.bssid);
+    else WiFi.begin(ssid->c_str(), pass->c_str());
+}
+
+void enter(WifiLinkState s, unsigned long now)
+{
+    state = s;
+    stateSinceMs = now;
+}
+
+// Recovery only counts once traffic gets through: until then an
+// associated link with a dead gateway keeps escalating.
+void linkVerified()
+{
+    verified = true;
+    stats.failures = 0;
+    backoffMs = WIFI_BACKOFF_MIN_MS;
+}
+
+void goOnline(unsigned long now)
+{
+    enter(WIFI_LINK_ONLINE, now);
+    missesInRow = 0;
+    nextProbeMs = now;
+    if (gatewayIp == 0) linkVerified();
+    stats.joinMs = now - joinStartMs;
+    saveCache();
+    eventLog(EVENT_WIFI, 0, 1, (uint32_t)WiFi.localIP());
+
+    Serial.printf("WiFi connected in %lu ms%s, IP: ", (unsigned long)stats.joinMs,
+                  stats.cachedJoin ? " (cached AP)" : "");
+    Serial.println(WiFi.localIP());
+
+    // mDNS has to be restarted on the new interface after every reconnect.
+    if (mdnsStarted) MDNS.end();
+    mdnsStarted = MDNS.begin(host);
+    if (mdnsStarted) {
+        MDNS.addService("http", "tcp", 80);
+        Serial.printf("mDNS: http://%s.local\n", host);
+    }
+}
+
+void goOffline(unsigned long now, const char* why)
+{
+    Serial.printf("WiFi lost: %s\n", why);
+    eventLog(EVENT_WIFI, 0, 0, 0);
+    stats.outages++;
+    offlineSinceMs = now;
+    verified = false;
+    enter(WIFI_LINK_BACKOFF, now);
+}
+
+void attemptFailed(unsigned long now, const char* why)
+{
+    if (stats.failures < 255) stats.failures++;
+    backoffMs = backoffMs * 2 < WIFI_BACKOFF_MAX_MS ? backoffMs * 2 : WIFI_BACKOFF_MAX_MS;
+    Serial.printf("WiFi attempt failed (%s), retry in %lu ms\n", why, (unsigned long)backoffMs);
+    enter(WIFI_LINK_BACKOFF, now);
+}
+
+// The cached AP is gone (or moved channel): scan at once.
+void cacheMissed(unsigned long now)
+{
+    stats.cacheMisses++;
+    cacheValid = false;
+    Serial.println("WiFi: cached AP not found, scanning");
+    WiFi.disconnect();
+    join(false);
+    enter(WIFI_LINK_CONNECTING, now);
+}
+
+void attempt(unsigned long now)
+{
+    stats.attempts++;
+    joinStartMs = now;
+    if (stats.failures >= WIFI_RESET_AFTER) {
+        stats.resets++;
+        Serial.printf("WiFi: rejoining %s\n", ssid->c_str());
+        WiFi.disconnect();
+        join(false);
+    } else {
+        Serial.println("WiFi: reconnecting");
+        associated = false;
+        WiFi.reconnect();
+    }
+    enter(WIFI_LINK_CONNECTING, now);
+}
+
+void serviceProbe(unsigned long now)
+{
+    if (probing) {
+        uint32_t rttMs = 0;
+        HalPingResult r = halPingResult(&rttMs);
+        if (r == HAL_PING_PENDING) return;
+        probing = false;
+        if (state != WIFI_LINK_ONLINE) return;       // answer to a probe from before the outage
+
+        if (r == HAL_PING_OK) {
+            if (!verified) linkVerified();
+            missesInRow = 0;
+            stats.lastRttMs = rttMs;
+            metricsObserve(METRIC_GATEWAY_RTT, rttMs * 1000);
+            nextProbeMs = now + WIFI_PROBE_INTERVAL_MS;
+        } else {
+            missesInRow++;
+            stats.probeMisses++;
+            if (missesInRow >= WIFI_PROBE_FAILURES) {
+                if (verified) goOffline(now, "gateway not answering");
+                else attemptFailed(now, "gateway not answering");
+                return;
+            }
+            nextProbeMs = now + WIFI_PROBE_RETRY_MS;
+        }
+        return;
+    }
+
+    if (state == WIFI_LINK_ONLINE && gatewayIp != 0 && (long)(now - nextProbeMs) >= 0) {
+        if (halPingStart(gatewayIp, WIFI_PROBE_TIMEOUT_MS)) {
+            probing = true;
+            stats.probes++;
+        }
+    }
+}
+
+} // namespace
+
+void wifiSupervisorBegin(const char* hostname, const String& ssidRef, const String& passRef, IPAddress gateway,
+                         IPAddress staticIP, IPAddress subnet)
+{
+    host = hostname;
+    ssid = &ssidRef;
+    pass = &passRef;
+    gatewayIp = (uint32_t)gateway;
+
+    const unsigned long now = millis();
+    events = 0;
+    verified = false;
+    probing = false;
+    mdnsStarted = false;
+    backoffMs = WIFI_BACKOFF_MIN_MS;
+    stats = WifiSupervisorStats();
+    offlineSinceMs = now;
+    joinStartMs = now;
+    enter(WIFI_LINK_CONNECTING, now);
+    loadCache();
+
+    Serial.printf("Connecting to WiFi: %s%s%s\n", ssid->c_str(), cacheValid ? ", cached AP" : "",
+                  (uint32_t)staticIP ? ", static IP" : "");
+    WiFi.onEvent(onWifiEvent);
+    WiFi.mode(WIFI_STA);
+    WiFi.setHostname(hostname);
+    WiFi.setAutoReconnect(false);      // retries follow our backoff instead
+    if ((uint32_t)staticIP) WiFi.config(staticIP, gateway, subnet, gateway);
+    join(true);
+}
+
+void wifiSupervisorService()
+{
+    const unsigned long now = millis();
+    const uint8_t ev = takeEvents();
+
+    switch (state) {
+    case WIFI_LINK_ONLINE:
+        if ((ev & EV_DISCONNECTED) && WiFi.status() != WL_CONNECTED) {
+            goOffline(now, "disconnected");
+        }
+        break;
+
+    case WIFI_LINK_CONNECTING:
+        if (ev & EV_ASSOCIATED) associated = true;
+        if ((ev & EV_GOT_IP) && WiFi.status() == WL_CONNECTED) {
+            goOnline(now);
+        } else if (ev & EV_DISCONNECTED) {
+            // The disconnect of a rejoin also raises this; only a verdict
+            // on the new attempt counts.
+            wl_status_t st = WiFi.status();
+            if (st == WL_NO_SSID_AVAIL || st == WL_CONNECT_FAILED) {
+                if (pinned) cacheMissed(now);
+                else attemptFailed(now, "no AP");
+            }
+        } else if (pinned && !associated && now - stateSinceMs >= WIFI_CACHED_TIMEOUT_MS) {
+            cacheMissed(now);
+        } else if (now - stateSinceMs >= WIFI_CONNECT_TIMEOUT_MS) {
+            attemptFailed(now, "timeout");
+        }
+        break;
+
+    case WIFI_LINK_BACKOFF:
+        if ((ev & EV_GOT_IP) && WiFi.status() == WL_CONNECTED) {
+            goOnline(now);
+        } else if (now - stateSinceMs >= backoffMs) {
+            attempt(now);
+        }
+        break;
+    }
+
+    serviceProbe(now);
+
+    if (state != WIFI_LINK_ONLINE && now - offlineSinceMs >= WIFI_REBOOT_AFTER_MS) {
+        Serial.println("WiFi offline too long. Rebooting...");
+        restartDevice();
+    }
+}
+
+bool wifiOnline()
+{
+    return state == WIFI_LINK_ONLINE;
+}
+
+WifiSupervisorStats wifiSupervisorStats()
+{
+    WifiSupervisorStats s = stats;
+    s.state = state;
+    s.offlineMs = state == WIFI_LINK_ONLINE ? 0 : millis() - offlineSinceMs;
+    return s;
+}
@@ -0,0 +1,83 @@
+# Embeds the web UI in the firmware: include/web_assets.h from web/.
+#
+# Static pages are stored gzip-compressed with a strong ETag (a hash of
+# the compressed bytes), templates as plain strings. Runs before every
+# PlatformIO build (extra_scripts = pre:tools/embed_web.py) and only
+# rewrites the header when its content changes; also runs standalone:
+#   python3 tools/embed_web.py
+
+import gzip
+import hashlib
+import os
+
+STATIC = [("index.html", "WEB_INDEX"), ("update.html", "WEB_UPDATE")]
+TEMPLATES = [("settings.html", "WEB_SETTINGS_TEMPLATE")]
+
+
+def c_string(text):
+    out = []
+    for line in text.splitlines(True):
+        line = line.replace("\\", "\\\\").replace('"', '\\"').replace("\n", "\\n")
+        out.append('    "%s"' % line)
+    return "\n".join(out)
+
+
+def c_bytes(data):
+    rows = []
+    for i in range(0, len(data), 16):
+        rows.append("    " + " ".join("0x%02x," % b for b in data[i:i + 16]))
+    return "\n".join(rows)
+
+
+def generate(root):
+    web = os.path.join(root, "web")
+    parts = [
+        "// Generated by tools/embed_web.py from web/ -- edit the sources there.",
+        "#pragma once",
+        "",
+        "#include <Arduino.h>",
+        "",
+    ]
+    for name, symbol in STATIC:
+        with open(os.path.join(web, name), "rb") as f:
+            raw = f.read()
+        gz = gzip.compress(raw, 9, mtime=0)
+        etag = hashlib.sha256(gz).hexdigest()[:16]
+        parts += [
+            "// web/%s" % name,
+            "const uint32_t %s_RAW_LEN = %d;" % (symbol, len(raw)),
+            "const uint32_t %s_GZ_LEN = %d;" % (symbol, len(gz)),
+            'const char %s_ETAG[] = "\\"%s\\"";' % (symbol, etag),
+            "const uint8_t %s_GZ[] PROGMEM = {" % symbol,
+            c_bytes(gz),
+            "};",
+            "",
+        ]
+    for name, symbol in TEMPLATES:
+        with open(os.path.join(web, name), encoding="utf-8") as f:
+            text = f.read()
+        parts += [
+            "// web/%s" % name,
+            "const char %s[] PROGMEM =" % symbol,
+            c_string(text) + ";",
+            "",
+        ]
+
+    header = "\n".join(parts)
+    path = os.path.join(root, "include", "web_assets.h")
+    try:
+        with open(path, encoding="utf-8") as f:
+            if f.read() == header:
+                return
+    except OSError:
+        pass
+    with open(path, "w", encoding="utf-8") as f:
+        f.write(header)
+    print("embed_web: wrote", os.path.relpath(path, root))
+
+
+try:
+    Import("env")  # noqa: F821 -- PlatformIO/SCons
+    generate(env.subst("$PROJECT_DIR"))  # noqa: F821
+except NameError:
+    generate(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
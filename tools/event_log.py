@@ -0,0 +1,143 @@
+# Reader for the switch's event log (include/event_log.h):
+#   python3 tools/event_log.py HOST                  (everything still on the switch)
+#   python3 tools/event_log.py HOST --since 1234     (only records after seq 1234)
+#   python3 tools/event_log.py HOST --follow         (poll, print what is new)
+#   python3 tools/event_log.py --file log.bin        (a saved /log body)
+# --save FILE appends the raw records, so a later --since run can carry on
+# from the last seq printed.
+
+import argparse
+import struct
+import sys
+import time
+import urllib.request
+
+RECORD = 16
+SOURCES = ["local", "http", "mqtt", "schedule", "band", "udp", "swr"]
+ACTIONS = ["select", "next", "prev"]
+REFUSED = 0x80
+RESETS = {1: "power-on", 3: "software", 4: "panic", 5: "interrupt watchdog", 6: "task watchdog",
+          7: "watchdog", 8: "deep sleep", 9: "brownout", 10: "SDIO"}
+
+
+def crc8(data):
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def outputs(mask):
+    ants = [str(i + 1) for i in range(32) if mask >> i & 1]
+    return "+".join(ants) if ants else "off"
+
+
+def ip(value):
+    return ".".join(str(value >> s & 0xFF) for s in (0, 8, 16, 24))
+
+
+def decode(data):
+    """Yields dicts for the whole, good records in data."""
+    for i in range(0, len(data) - RECORD + 1, RECORD):
+        rec = data[i:i + RECORD]
+        seq, ms, kind, source, flags, crc, value = struct.unpack("<IIBBBBI", rec)
+        if crc8(rec[:11] + rec[12:]) != crc:
+            print("bad CRC at byte %d" % i, file=sys.stderr)
+            continue
+        yield {"seq": seq, "ms": ms, "type": kind, "source": source, "flags": flags, "value": value}
+
+
+def describe(r):
+    kind, flags, value = r["type"], r["flags"], r["value"]
+    source = SOURCES[r["source"]] if r["source"] < len(SOURCES) else str(r["source"])
+    if kind == 1:
+        return "boot (%s reset)" % RESETS.get(value, value)
+    if kind == 2:
+        action = ACTIONS[flags & 0x7F] if flags & 0x7F < len(ACTIONS) else str(flags & 0x7F)
+        text = "%s %s from %s" % (action, outputs(value), source) if action == "select" else \
+            "%s (to %s) from %s" % (action, outputs(value), source)
+        return text + (", REFUSED (queue full, locked or outranked)" if flags & REFUSED else "")
+    if kind == 3:
+        return "relays -> %s (%s)" % (outputs(value), source)
+    if kind == 4:
+        return "wifi up, %s" % ip(value) if flags else "wifi down"
+    if kind == 5:
+        return "mqtt up" if flags else "mqtt down (state %d)" % struct.unpack("<i", struct.pack("<I", value))[0]
+    if kind == 6:
+        return "clock synced: %s UTC" % time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(value))
+    if kind == 7:
+        return "SWR trip on antenna %d: %d.%02d:1, relays off" % (flags, value // 100, value % 100)
+    if kind == 8:
+        return "manual lock %s" % ("on" if flags else "off")
+    return "type %d flags 0x%02x value %u" % (kind, flags, value)
+
+
+class Printer:
+    def __init__(self):
+        self.last = None
+        self.utc = None     # (ms, UTC seconds) from this boot's clock record
+
+    def show(self, r):
+        # Each boot skips ahead (see event_log.h), so a gap before one is expected
+        if self.last is not None and r["seq"] != self.last + 1 and r["type"] != 1:
+            print("        ... %d record(s) lost" % (r["seq"] - self.last - 1))
+        self.last = r["seq"]
+        if r["type"] == 1:
+            self.utc = None
+        elif r["type"] == 6:
+            self.utc = (r["ms"], r["value"])
+        when = "%10.3f s" % (r["ms"] / 1000.0)
+        if self.utc:
+            when = time.strftime("%H:%M:%S", time.gmtime(self.utc[1] + (r["ms"] - self.utc[0]) / 1000.0))
+            when = "%10s  " % when
+        print("%7u %s  %s" % (r["seq"], when, describe(r)))
+
+
+def fetch(host, since):
+    with urllib.request.urlopen("http://%s/log?since=%d" % (host, since), timeout=10) as resp:
+        return resp.read()
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("host", nargs="?")
+    ap.add_argument("--since", type=int, default=0, help="last seq already seen")
+    ap.add_argument("--follow", action="store_true")
+    ap.add_argument("--interval", type=float, default=2.0, help="seconds between polls with --follow")
+    ap.add_argument("--file", help="decode a saved /log body instead")
+    ap.add_argument("--save", help="append the raw records to this file")
+    args = ap.parse_args()
+    if not args.host and not args.file:
+        ap.error("a host or --file")
+
+    printer = Printer()
+    if args.file:
+        with open(args.file, "rb") as f:
+            for r in decode(f.read()):
+                printer.show(r)
+        return
+
+    since = args.since
+    while True:
+        try:
+            data = fetch(args.host, since)
+        except OSError as e:
+            print("%s: %s" % (args.host, e), file=sys.stderr)
+            if not args.follow:
+                sys.exit(1)
+            data = b""
+        if args.save and data:
+            with open(args.save, "ab") as f:
+                f.write(data)
+        for r in decode(data):
+            printer.show(r)
+            since = r["seq"]
+        if not args.follow:
+            break
+        time.sleep(args.interval)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,73 @@
+# Stand-in for a FlexRadio's status stream, for bench testing the band
+# decoder without a radio. Listens on the SmartSDR API port, answers the
+# switch's subscription and sends a slice status line for every frequency
+# typed on stdin (MHz, e.g. 14.074):
+#   python3 tools/flex_standin.py [--port 4992] [--slice 0]
+# then set the switch's FlexRadio IP to this machine in /settings.
+
+import argparse
+import socket
+import sys
+import threading
+
+HANDLE = "2A7F10B3"
+
+
+def serve(conn, clients, lock):
+    conn.sendall(("V1.4.0.0\nH%s\n" % HANDLE).encode())
+    buf = b""
+    while True:
+        data = conn.recv(1024)
+        if not data:
+            break
+        buf += data
+        while b"\n" in buf:
+            line, buf = buf.split(b"\n", 1)
+            text = line.decode(errors="replace").strip()
+            print("<", text)
+            if "|" in text and text.startswith("C"):
+                seq = text[1:text.index("|")]
+                conn.sendall(("R%s|0|\n" % seq).encode())
+    with lock:
+        clients.remove(conn)
+    conn.close()
+    print("switch disconnected")
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--port", type=int, default=4992)
+    ap.add_argument("--slice", type=int, default=0)
+    args = ap.parse_args()
+
+    clients = []
+    lock = threading.Lock()
+    srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    srv.bind(("", args.port))
+    srv.listen(4)
+
+    def accept():
+        while True:
+            conn, addr = srv.accept()
+            print("switch connected from %s:%d" % addr)
+            with lock:
+                clients.append(conn)
+            threading.Thread(target=serve, args=(conn, clients, lock), daemon=True).start()
+
+    threading.Thread(target=accept, daemon=True).start()
+    print("listening on port %d; type a frequency in MHz" % args.port)
+    for line in sys.stdin:
+        try:
+            mhz = float(line.strip())
+        except ValueError:
+            continue
+        status = "S%s|slice %d in_use=1 RF_frequency=%.6f mode=USB\n" % (HANDLE, args.slice, mhz)
+        with lock:
+            for c in clients:
+                c.sendall(status.encode())
+        print(">", status.strip())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,147 @@
+# Listener for the switch's multicast state beacons (include/udp_control.h):
+#   python3 tools/udp_beacon.py                       (prints each change)
+#   python3 tools/udp_beacon.py --json                (one JSON object per beacon)
+#   python3 tools/udp_beacon.py --listeners 50 --seconds 60
+# The last joins the group on 50 sockets at once and reports what each
+# received, for checking a LAN (or a switch's IGMP snooping) with many
+# observers; the device sends the same one datagram either way.
+# --key K checks the MAC when the switch has a shared key set. Turn
+# beacons on in Settings, UDP Control (port 4211 here by default).
+
+import argparse
+import hashlib
+import hmac
+import json
+import select
+import socket
+import struct
+import sys
+import time
+
+VERSION = 2
+OP_BEACON = 0x40
+SIZE = 24
+MAC_SIZE = 8
+CHANGE, LOCKED = 0x01, 0x02
+SOURCES = ["local", "http", "mqtt", "schedule", "band", "udp", "swr"]
+
+
+def parse(data, key=b""):
+    """The beacon as a dict, or None if it is not one (or fails the MAC)."""
+    if len(data) != SIZE + (MAC_SIZE if key else 0) or data[:2] != b"AS" or data[2] != VERSION:
+        return None
+    if data[3] != OP_BEACON:
+        return None
+    if key and not hmac.compare_digest(data[SIZE:], hmac.new(key, data[:SIZE], hashlib.sha256).digest()[:MAC_SIZE]):
+        return None
+    seq, antenna, count, flags, source, outputs, version, uptime = struct.unpack("<IbBBBIII", data[4:SIZE])
+    return {"seq": seq, "antenna": antenna, "count": count, "change": bool(flags & CHANGE),
+            "locked": bool(flags & LOCKED), "source": SOURCES[source] if source < len(SOURCES) else source,
+            "outputs": outputs, "version": version, "uptime": uptime}
+
+
+def listen_socket(group, port):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    if hasattr(socket, "SO_REUSEPORT"):
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+    sock.bind(("", port))
+    mreq = struct.pack("4s4s", socket.inet_aton(group), socket.inet_aton("0.0.0.0"))
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+    return sock
+
+
+def selection(b):
+    if b["outputs"] == 0:
+        return "off"
+    return "+".join(str(i + 1) for i in range(32) if b["outputs"] >> i & 1)
+
+
+class Tracker:
+    """Per sender: lost beacons (seq gaps) and reboots (seq back to 1)."""
+
+    def __init__(self):
+        self.last = {}
+        self.received = self.lost = self.reboots = 0
+
+    def update(self, sender, b):
+        self.received += 1
+        prev = self.last.get(sender)
+        self.last[sender] = b
+        if prev is None:
+            return "first"
+        if b["seq"] <= prev["seq"] or b["uptime"] < prev["uptime"]:
+            self.reboots += 1
+            return "reboot"
+        gap = b["seq"] - prev["seq"] - 1
+        self.lost += gap
+        return "lost %d" % gap if gap else ""
+
+
+def follow(args, key):
+    sock = listen_socket(args.group, args.port)
+    tracker = Tracker()
+    deadline = time.monotonic() + args.seconds if args.seconds else None
+    silent_since = time.monotonic()
+    while deadline is None or time.monotonic() < deadline:
+        ready, _, _ = select.select([sock], [], [], 1.0)
+        if not ready:
+            if args.timeout and time.monotonic() - silent_since > args.timeout:
+                print("no beacon for %d s" % args.timeout, file=sys.stderr)
+                silent_since = time.monotonic()
+            continue
+        data, (ip, _) = sock.recvfrom(256)
+        b = parse(data, key)
+        if not b:
+            continue
+        silent_since = time.monotonic()
+        note = tracker.update(ip, b)
+        if args.json:
+            b["from"] = ip
+            print(json.dumps(b), flush=True)
+        elif b["change"] or note or args.verbose:
+            print("%s %s seq %u: %s (by %s%s) uptime %u s%s" % (
+                time.strftime("%H:%M:%S"), ip, b["seq"], selection(b), b["source"],
+                ", locked" if b["locked"] else "", b["uptime"], " [" + note + "]" if note else ""), flush=True)
+    print("%d beacons, %d lost, %d reboots" % (tracker.received, tracker.lost, tracker.reboots), file=sys.stderr)
+
+
+def many(args, key):
+    socks = [listen_socket(args.group, args.port) for _ in range(args.listeners)]
+    trackers = {s: Tracker() for s in socks}
+    deadline = time.monotonic() + (args.seconds or 60)
+    while time.monotonic() < deadline:
+        ready, _, _ = select.select(socks, [], [], 0.5)
+        for s in ready:
+            data, (ip, _) = s.recvfrom(256)
+            b = parse(data, key)
+            if b:
+                trackers[s].update(ip, b)
+    got = sorted(t.received for t in trackers.values())
+    lost = sum(t.lost for t in trackers.values())
+    print("%d listeners: %d-%d beacons each, %d lost in total" % (len(socks), got[0], got[-1], lost))
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--group", default="239.255.42.1")
+    ap.add_argument("--port", type=int, default=4211)
+    ap.add_argument("--key", default="")
+    ap.add_argument("--json", action="store_true")
+    ap.add_argument("--verbose", action="store_true", help="heartbeats too")
+    ap.add_argument("--seconds", type=float, default=0, help="stop after; 0 = run until interrupted")
+    ap.add_argument("--timeout", type=int, default=35, help="warn after this long without a beacon")
+    ap.add_argument("--listeners", type=int, default=0)
+    args = ap.parse_args()
+
+    try:
+        if args.listeners:
+            many(args, args.key.encode())
+        else:
+            follow(args, args.key.encode())
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
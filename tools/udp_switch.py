@@ -0,0 +1,195 @@
+# Client for the switch's binary UDP control protocol (include/udp_control.h),
+# for logging software and for benchmarking it against /set and MQTT:
+#   python3 tools/udp_switch.py HOST select 2        (or 1,3 for several, 0 = off)
+#   python3 tools/udp_switch.py HOST state
+#   python3 tools/udp_switch.py HOST bench [--count 200] [--broker IP]
+# --key K signs requests when the switch has a shared key set. The MQTT
+# part of bench needs paho-mqtt and the switch's default topics (or
+# --cmd-topic/--state-topic).
+
+import argparse
+import hashlib
+import hmac
+import socket
+import struct
+import sys
+import time
+import urllib.request
+
+VERSION = 2
+OP_SELECT, OP_STATE = 1, 2
+STATUS = {0: "ok", 1: "bad request", 2: "busy", 3: "stale", 4: "locked", 5: "outranked", 6: "session"}
+ACK_HELD, ACK_SUPERSEDED = 0x01, 0x02
+MAC_SIZE = 8
+ACK_SIZE = 20
+
+
+class UdpSwitch:
+    def __init__(self, host, port=4210, key="", timeout=0.05, attempts=3):
+        self.addr = (host, port)
+        self.key = key.encode()
+        self.timeout = timeout
+        self.attempts = attempts
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        # Milliseconds, so a restarted client never goes back
+        self.seq = int(time.time() * 1000) & 0xFFFFFFFF
+        # From the last verified ack; 0 until there is one
+        self.session = 0
+
+    def _mac(self, data):
+        return hmac.new(self.key, data, hashlib.sha256).digest()[:MAC_SIZE]
+
+    def request(self, op, outputs=0):
+        """Sends op, retrying with the same seq; returns the ack as a dict.
+        A select signed without a session gets one and is sent again; a
+        session the switch no longer knows (it restarted) goes unanswered,
+        so after a timeout it starts over once with none."""
+        for _ in range(3):
+            try:
+                ack = self._send(op, outputs)
+            except TimeoutError:
+                if not self.key or not self.session:
+                    raise
+                self.session = 0
+                ack = self._send(op, outputs)
+            if ack["status"] != "session":
+                return ack
+        raise TimeoutError("no session for seq %u" % self.seq)
+
+    def _send(self, op, outputs):
+        self.seq = (self.seq + 1) & 0xFFFFFFFF
+        data = b"AS" + struct.pack("<BBII", VERSION, op, self.seq, outputs)
+        if self.key:
+            data += self._mac(data + struct.pack("<I", self.session))
+        self.sock.settimeout(self.timeout)
+        for _ in range(self.attempts):
+            self.sock.sendto(data, self.addr)
+            deadline = time.monotonic() + self.timeout
+            while time.monotonic() < deadline:
+                try:
+                    ack, _ = self.sock.recvfrom(64)
+                except socket.timeout:
+                    break
+                parsed = self._parse(ack)
+                if parsed and parsed["seq"] == self.seq:
+                    self.session = parsed["session"]
+                    return parsed
+        raise TimeoutError("no ack for seq %u" % self.seq)
+
+    def _parse(self, ack):
+        if len(ack) < ACK_SIZE or ack[:2] != b"AS" or ack[2] != VERSION:
+            return None
+        if self.key and (len(ack) != ACK_SIZE + MAC_SIZE or
+                         not hmac.compare_digest(ack[ACK_SIZE:], self._mac(ack[:ACK_SIZE]))):
+            return None
+        _, op, seq, status, antenna, count, flags, outputs, session = struct.unpack("<BBIBbBBII", ack[2:ACK_SIZE])
+        return {"seq": seq, "status": STATUS.get(status, status), "antenna": antenna, "count": count,
+                "outputs": outputs, "held": bool(flags & ACK_HELD), "superseded": bool(flags & ACK_SUPERSEDED),
+                "session": session}
+
+    def select(self, outputs):
+        return self.request(OP_SELECT, outputs)
+
+    def state(self):
+        return self.request(OP_STATE)
+
+
+def parse_selection(text):
+    mask = 0
+    for part in text.replace("+", ",").split(","):
+        n = int(part)
+        if n > 0:
+            mask |= 1 << (n - 1)
+    return mask
+
+
+def summary(label, ms):
+    if not ms:
+        print("  %-12s no samples" % label)
+        return
+    ms = sorted(ms)
+    pick = lambda p: ms[min(len(ms) - 1, int(p / 100.0 * len(ms)))]
+    print("  %-12s n=%-5d p50=%.2f p90=%.2f p99=%.2f max=%.2f ms" % (label, len(ms), pick(50), pick(90), pick(99),
+                                                                      ms[-1]))
+
+
+def bench(sw, args):
+    count = sw.state()["count"] or 4
+    udp, http, mqtt = [], [], []
+    for i in range(args.count):
+        ant = 1 + i % count
+        t0 = time.perf_counter()
+        sw.select(1 << (ant - 1))
+        udp.append((time.perf_counter() - t0) * 1000)
+        time.sleep(args.gap)
+
+        ant = 1 + (i + 1) % count
+        t0 = time.perf_counter()
+        urllib.request.urlopen("http://%s/set?ant=%d" % (args.host, ant), timeout=2).read()
+        http.append((time.perf_counter() - t0) * 1000)
+        time.sleep(args.gap)
+
+    if args.broker:
+        import queue
+        import paho.mqtt.client as paho
+
+        states = queue.Queue()
+        client = paho.Client()
+        client.on_message = lambda c, u, m: states.put((time.perf_counter(), m.payload.decode()))
+        client.connect(args.broker)
+        client.subscribe(args.state_topic)
+        client.loop_start()
+        time.sleep(0.5)
+        while not states.empty():
+            states.get()
+        for i in range(args.count):
+            ant = 1 + i % count
+            t0 = time.perf_counter()
+            client.publish(args.cmd_topic, str(ant))
+            try:
+                while True:
+                    t, payload = states.get(timeout=2)
+                    if payload == str(ant):
+                        mqtt.append((t - t0) * 1000)
+                        break
+            except queue.Empty:
+                pass
+            time.sleep(args.gap)
+        client.loop_stop()
+
+    print("%d commands each, sent -> answer:" % args.count)
+    summary("udp ack", udp)
+    summary("http /set", http)
+    if args.broker:
+        summary("mqtt state", mqtt)
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("host")
+    ap.add_argument("command", choices=["select", "state", "bench"])
+    ap.add_argument("selection", nargs="?", default="0")
+    ap.add_argument("--port", type=int, default=4210)
+    ap.add_argument("--key", default="")
+    ap.add_argument("--count", type=int, default=200)
+    ap.add_argument("--gap", type=float, default=0.2, help="seconds between commands")
+    ap.add_argument("--broker")
+    ap.add_argument("--cmd-topic", default="stationpilot/antennaSwitch/cmd")
+    ap.add_argument("--state-topic", default="stationpilot/antennaSwitch/state")
+    args = ap.parse_args()
+
+    sw = UdpSwitch(args.host, args.port, args.key)
+    try:
+        if args.command == "select":
+            print(sw.select(parse_selection(args.selection)))
+        elif args.command == "state":
+            print(sw.state())
+        else:
+            bench(sw, args)
+    except TimeoutError as e:
+        print(e, file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()